@@ -1,9 +1,11 @@
 ﻿#include <Windows.h>
 #include <balor/graphics/all.hpp>
 #include <balor/gui/all.hpp>
+#include <balor/system/TaskScheduler.hpp>
 
 using namespace balor::graphics;
 using namespace balor::gui;
+using namespace balor::system;
 
 
 int APIENTRY WinMain(HINSTANCE , HINSTANCE , LPSTR , int ) 
@@ -30,11 +32,17 @@ int APIENTRY WinMain(HINSTANCE , HINSTANCE , LPSTR , int )
 				OpenFileDialog dialog;
 				dialog.filter(L"그림 파일\n*.bmp;*.gif;*.png;*.jpg;*.jpeg;*.tiff\n\n");
 				if (dialog.show(frame)) {
-					bitmap = Bitmap(dialog.filePath());
-					if (bitmap != nullptr) {
-						frame.scrollMinSize(bitmap.size()); // 윈도우 사이즈가 그림 사이즈보다 작으면 스크롤 할 수 있도록 한다
-						frame.invalidate();
-					}
+					balor::String filePath = dialog.filePath();
+					auto task = TaskScheduler::global().run([filePath] () { // 그림 읽기는 워커 스레드에서 하고 UI 를 멈추지 않는다
+						return Bitmap(filePath);
+					});
+					task.thenOn(frame, [&] (Task<Bitmap>& task) { // frame 의 메시지 루프에서 실행된다
+						bitmap = std::move(task.get());
+						if (bitmap != nullptr) {
+							frame.scrollMinSize(bitmap.size()); // 윈도우 사이즈가 그림 사이즈보다 작으면 스크롤 할 수 있도록 한다
+							frame.invalidate();
+						}
+					});
 				}
 				e.handled(true);
 			} break;
@@ -1,5 +1,6 @@
 ﻿#include "Singleton.hpp"
 
+#include <atomic>
 #include <typeinfo>
 #define BOOST_DATE_TIME_NO_LIB
 #define BOOST_THREAD_NO_LIB
@@ -45,17 +46,33 @@ recursive_mutex& getSingletonMutex() { // mutex 를 전역 변수 초기화에
 
 
 recursive_mutex& singletonMutex = getSingletonMutex(); // 이 전역 변수로 멀티스레드에서 접근했을 때 mutex 초기화가 보증된다.
+std::atomic<BalorSingletonModule*> singletonModule; // 정적 영역이므로 동적 초기화보다 먼저 nullptr 로 초기화된다.
+
+
+BalorSingletonModule& getSingletonModule() {
+	BalorSingletonModule* module = singletonModule.load(std::memory_order_acquire);
+	if (!module) {
+		recursive_mutex::scoped_lock lock(getSingletonMutex());
+		module = singletonModule.load(std::memory_order_relaxed);
+		if (!module) {
+			static BalorSingletonModule instance; // このインスタンスは DLL ごとに作成される。LoadLibrary は単に DLL ごとにカウンタを増やすだけ。
+			module = &instance;
+			singletonModule.store(module, std::memory_order_release);
+		}
+	}
+	return *module;
+}
 } // namespace
 
 
 
 void* getSingletonInstance(const type_info& info, void* (*createInstanceFunction)()) {
-	recursive_mutex::scoped_lock lock(getSingletonMutex()); // mutex のインスタンスは DLL ごとに作成されるので唯一ではなく DLL ごとにロックされてしまう。
-	static BalorSingletonModule module; // このインスタンスは DLL ごとに作成されるので DLL ごとのロックで問題ない。LoadLibrary は単に DLL ごとにカウンタを増やすだけ。
+	BalorSingletonModule& module = getSingletonModule();
 	if (module.empty()) {
-		return (*createInstanceFunction)(); // balor_singletone.dll が無い場合は DLL を使わないとみなす。よってロックは唯一であり、この関数を超えてメモリ最適化は起きないので呼び出し元でメモリバリアは必要ない。
+		recursive_mutex::scoped_lock lock(getSingletonMutex()); // balor_singletone.dll が無い場合は DLL を使わないとみなす。よってロックは唯一である。
+		return (*createInstanceFunction)();
 	} else {
-		return module.getSingletonInstance(info, createInstanceFunction); // この関数処理は呼び出し先の DLL 内であらためてロックされる。
+		return module.getSingletonInstance(info, createInstanceFunction); // 登録済みならロックせずに返り、未登録なら呼び出し先の DLL 内でロックされる。
 	}
 }
 
@@ -1,5 +1,7 @@
 ﻿#pragma once
 
+#include <atomic>
+
 
 namespace balor {
 
@@ -60,8 +62,9 @@ void* getSingletonInstance(const type_info& info, void* (*createInstanceFunction
  * DLL마다 따로 연결된 각각의 코드 내부에서 같은 형에 대해서 &typeid(형명)을 수행하면 제각각 다른 어드레스를 반환하지만,
  * 양쪽에서 typeid::operator== 을 수행하면 제대로 true를 돌려준다.
  * 이걸로 다른 DLL 사이에서도 동일한 어드레스를 돌려주는 것이 보증된다.
- * 또한 이 DLL 함수처리는 boost::mutex로 완전히 락을 거는 '여러번 실행되어도 문제가 없는 처리이기도 해서'
- *  락으로 메모리 배리어를 포함하기 위한 'DLCP같은 방법이 불필요하게 된다.
+ * 등록부는 type_info 의 장식된 이름(raw_name)의 해시값으로 인덱스하고, 이미 등록된 형의 검색은 락을 걸지 않는다.
+ * 새로운 등록만 boost::recursive_mutex 로 락을 걸고, 등록된 인스턴스는 release 로 공개한다.
+ * Singleton::get 은 얻은 포인터를 std::atomic 에 release 로 보존하고 acquire 로 읽으므로, 초기화되지 않은 인스턴스가 보이는 일은 없다.
  * DLL의 글로벌 변수는 프로세스에 Attach하기 전에 초기화되는 것이 보증되기 때문에,
  * (http://msdn.microsoft.com/ja-jp/library/988ye33t(VS.80).aspx)
  *  mutex의 초기화에는 문제가 없다.
@@ -70,11 +73,10 @@ void* getSingletonInstance(const type_info& info, void* (*createInstanceFunction
  *
  * <h3>결점：</h3>
  * 작은 dll을 exe 파일에 붙이지 않으면 안된다.
- * 글로벌 변수 mutex를 사용하기 때문에 모든 형의 초기화 처리가 공통으로 락된다.
- * 또한, type_info 구조체에는 operator== 밖에 없기 때문에 map을 사용하지 않고 vector로 전체 검색을 수행한다.
- * 이를 위해 static 변수의 초기화때만 퍼포먼스가 희생된다.
+ * 글로벌 변수 mutex를 사용하기 때문에 모든 형의 새로운 등록 처리가 공통으로 락된다. 이미 등록된 형의 취득은 락되지 않는다.
  * 덧붙여 type_info::name 함수는 형 비교에 사용하는 것은 가능하지 않다.
  * 이름없는 네임스페이스를 사용해서 중복되는 형명을 정의하는 경우, type_info::name 함수로는 양자를 식별할 수 없다.
+ * 그래서 해시값은 raw_name 으로 계산하고 최종적인 비교는 type_info::operator== 로 수행한다.
  *
  * <h3>샘플코드</h3>
  * <pre><code>
@@ -94,14 +96,14 @@ class Singleton {
 public:
 	/// 싱글톤 인스턴스 취득
 	static T& get() {
-		static T* instance = nullptr;
-
-		if (!instance) {
+		T* pointer = instance.load(std::memory_order_acquire);
+		if (!pointer) {
 			// 이 함수는 복수회 실행되어도 괜찮다.
-			instance = static_cast<T*>(::balor::detail::getSingletonInstance(typeid(T), Singleton<T>::createInstance));
-			// lock 으로 메모리 베리어가 포함되므로 메모리 최적화는 되지 않는다
+			pointer = static_cast<T*>(::balor::detail::getSingletonInstance(typeid(T), Singleton<T>::createInstance));
+			// 생성이 끝난 인스턴스를 release 로 공개하므로 acquire 로 읽은 스레드에서는 초기화가 끝난 것이 보인다
+			instance.store(pointer, std::memory_order_release);
 		}
-		return *instance;
+		return *pointer;
 	}
 
 	// 라이브러리를 멀티쓰레드에서 사용하지 않고, DLL 프로젝트에서도 사용하지 않는 경우는 이 구현체로 좋다. 간단한 어플리케이션 대부분에 해당될 것이다.
@@ -120,11 +122,16 @@ private: // 절대 생성, 복사, 파괴를 금지한다
 
 private:
 	static void* createInstance() {
-		static T instance;
-		return &instance;
+		static T object; // 멤버 instance 를 가리지 않도록 다른 이름을 쓴다
+		return &object;
 	}
+
+	static std::atomic<T*> instance;
 };
 
 
+template<typename T> std::atomic<T*> Singleton<T>::instance; // 정적 영역이므로 동적 초기화보다 먼저 nullptr 로 초기화된다.
+
+
 
 }
\ No newline at end of file
@@ -1,8 +1,12 @@
 ﻿#include "Control.hpp"
 
 #include <algorithm>
+#include <atomic>
 #include <functional>
 #include <type_traits>
+#define BOOST_DATE_TIME_NO_LIB
+#define BOOST_THREAD_NO_LIB
+#include <boost/thread/mutex.hpp>
 
 #include <balor/graphics/Brush.hpp>
 #include <balor/graphics/Cursor.hpp>
@@ -14,6 +18,7 @@
 #include <balor/gui/Menu.hpp>
 #include <balor/gui/Scaler.hpp>
 #include <balor/io/File.hpp>
+#include <balor/system/InvokeQueue.hpp>
 #include <balor/system/Module.hpp>
 #include <balor/system/windows.hpp>
 #include <balor/test/verify.hpp>
@@ -74,6 +79,159 @@ namespace gui {
 
 		const int wmInvokeAsynchronous = WM_USER + 0x6000;
 		const int wmInvoke = WM_USER + 0x6001;
+		const int wmInvokeQueue = WM_USER + 0x6002;
+		const int invokeQueueTimeBudget = 30; // 一回のメッセージ処理で invoke された関数を実行し続けるミリ秒
+
+
+		/// UI スレッドごとの非同期 invoke のキュー。
+		/// UI スレッドの数は少ないので固定長のブロックから線形に探し、一杯になったらブロックを継ぎ足す。登録はロックして行い、登録後の検索はロックしない。
+		/// 終了したスレッドのエントリはメッセージ専用ウインドウが破棄されているので、次に登録するスレッドが再利用する。
+		class ThreadInvokeQueues {
+			friend Singleton<ThreadInvokeQueues>;
+
+			ThreadInvokeQueues() {}
+			~ThreadInvokeQueues() {
+				Block* block = first.next.load(std::memory_order_acquire);
+				while (block) {
+					Block* next = block->next.load(std::memory_order_acquire);
+					delete block;
+					block = next;
+				}
+			}
+
+		public:
+			enum { blockSize = 64 };
+
+			struct Entry {
+				Entry() : threadId(0), window(nullptr) {}
+
+				std::atomic<DWORD> threadId;
+				std::atomic<HWND> window; // キューを起こすメッセージ専用ウインドウ。コントロールが破棄されても残る
+				InvokeQueue queue;
+			};
+
+			/// 現在のスレッドのキューを登録して返す。既に登録されていればそれを返す。
+			Entry* add() {
+				const DWORD threadId = GetCurrentThreadId();
+				boost::mutex::scoped_lock lock(addMutex);
+				Entry* found = find(threadId);
+				if (found) {
+					return found;
+				}
+				for (Block* block = &first; ; block = block->next.load(std::memory_order_acquire)) {
+					for (int i = 0; i < blockSize; ++i) {
+						Entry& entry = block->entries[i];
+						const DWORD id = entry.threadId.load(std::memory_order_acquire);
+						if (id) {
+							// ウインドウを作成する前のエントリは使用中。ウインドウが無くなっていればスレッドは終了している
+							const HWND window = entry.window.load(std::memory_order_acquire);
+							if (!window || IsWindow(window)) {
+								continue;
+							}
+						}
+						entry.window.store(nullptr, std::memory_order_relaxed); // ウインドウを作成するまで他のスレッドに再利用させない
+						entry.threadId.store(threadId, std::memory_order_release);
+						return &entry;
+					}
+					if (!block->next.load(std::memory_order_acquire)) {
+						block->next.store(new Block(), std::memory_order_release);
+					}
+				}
+			}
+
+			/// スレッドのキューを返す。登録されていなければ nullptr を返す。
+			Entry* find(DWORD threadId) {
+				assert("Invalid threadId" && threadId);
+				for (Block* block = &first; block; block = block->next.load(std::memory_order_acquire)) {
+					for (int i = 0; i < blockSize; ++i) {
+						Entry& entry = block->entries[i];
+						if (entry.threadId.load(std::memory_order_acquire) == threadId) {
+							return &entry;
+						}
+					}
+				}
+				return nullptr;
+			}
+
+		private:
+			struct Block {
+				Block() : next(nullptr) {}
+
+				Entry entries[blockSize];
+				std::atomic<Block*> next;
+			};
+
+			Block first;
+			boost::mutex addMutex;
+		};
+
+
+		void runInvokeQueue(HWND handle);
+
+
+		VOID CALLBACK invokeQueueTimerProcedure(HWND handle, UINT , UINT_PTR id, DWORD ) {
+			KillTimer(handle, id);
+			runInvokeQueue(handle);
+		}
+
+
+		void runInvokeQueue(HWND handle) {
+			auto entry = Singleton<ThreadInvokeQueues>::get().find(GetCurrentThreadId());
+			assert(entry);
+			if (entry->queue.run(invokeQueueTimeBudget)) {
+				// 続きはタイマーで実行する。WM_TIMER は入力や描画より後に処理されるので、大量の invoke で UI が固まることはない。
+				verify(SetTimer(handle, reinterpret_cast<UINT_PTR>(entry), USER_TIMER_MINIMUM, &invokeQueueTimerProcedure));
+			}
+		}
+
+
+		LRESULT CALLBACK invokeQueueWindowProcedure(HWND handle, UINT message, WPARAM wparam, LPARAM lparam) {
+			if (message == wmInvokeQueue) {
+				runInvokeQueue(handle);
+				return 0;
+			}
+			return DefWindowProcW(handle, message, wparam, lparam);
+		}
+
+
+		/// キューを起こすメッセージ専用ウインドウのクラス。
+		class InvokeQueueWindowClass {
+			friend Singleton<InvokeQueueWindowClass>;
+
+			InvokeQueueWindowClass() {
+				WNDCLASSEXW wndclass;
+				memset(&wndclass, 0, sizeof(wndclass));
+				wndclass.cbSize = sizeof(wndclass);
+				wndclass.lpfnWndProc = invokeQueueWindowProcedure;
+				wndclass.hInstance = GetModuleHandleW(nullptr);
+				wndclass.lpszClassName = L"balor::gui::Control::InvokeQueue";
+				atom = RegisterClassExW(&wndclass);
+				assert(atom);
+			}
+			~InvokeQueueWindowClass() {}
+
+		public:
+			ATOM atom;
+		};
+
+
+		/// 現在のスレッドのキューを起こすメッセージ専用ウインドウが無ければ作成する。ウインドウはスレッドが終了するまで破棄されない。
+		void createInvokeQueueWindow() {
+			const DWORD threadId = GetCurrentThreadId();
+			auto entry = Singleton<ThreadInvokeQueues>::get().add();
+			HWND window = entry->window.load(std::memory_order_acquire);
+			if (window && GetWindowThreadProcessId(window, nullptr) == threadId) {
+				return;
+			}
+			// 初めての作成か、終了したスレッドのエントリか ID を再利用した
+			window = CreateWindowExW(0, MAKEINTATOM(Singleton<InvokeQueueWindowClass>::get().atom), nullptr, 0, 0, 0, 0, 0
+				, HWND_MESSAGE, nullptr, GetModuleHandleW(nullptr), nullptr);
+			assert("Failed to CreateWindowExW for invoke queue" && window);
+			entry->window.store(window, std::memory_order_release);
+			if (!entry->queue.empty()) { // 起こす前にスレッドが終了して取り残された関数を実行する
+				verify(PostMessageW(window, wmInvokeQueue, 0, 0));
+			}
+		}
 
 		const Rectangle hugeBox(-100000, -100000, 200000, 200000);
 	} // namespace
@@ -1086,8 +1244,25 @@ namespace gui {
 			verify(SendMessageTimeoutW(*this, wmInvoke, (WPARAM)&function, 0, SMTO_NOTIMEOUTIFNOTHUNG, 5000, &lresult));
 		}
 		else {
-			std::function<void()>* newFunction = new std::function<void()>(function);
-			verify(PostMessageW(*this, wmInvokeAsynchronous, (WPARAM)newFunction, 0));
+			// 関数ごとにメッセージを送らずにスレッドのキューに溜め、キューが空だった時だけ起こす。
+			const HWND handle = *this;
+			auto entry = Singleton<ThreadInvokeQueues>::get().find(GetWindowThreadProcessId(handle, nullptr));
+			if (!entry) { // 別のモジュールで作成したコントロールなどキューが無い場合は関数ごとにメッセージを送る
+				std::function<void()>* newFunction = new std::function<void()>(function);
+				verify(PostMessageW(handle, wmInvokeAsynchronous, (WPARAM)newFunction, 0));
+				return;
+			}
+			const bool wake = entry->queue.push([handle, function] () {
+				if (IsWindow(handle)) { // 実行前にウインドウが破棄されていたら何もしない
+					function();
+				}
+			});
+			if (wake) {
+				// コントロールではなくメッセージ専用ウインドウを起こすので、その前にコントロールが破棄されても起こすメッセージは失われない
+				const HWND window = entry->window.load(std::memory_order_acquire);
+				assert("Invoke queue window not created" && window);
+				verify(PostMessageW(window, wmInvokeQueue, 0, 0));
+			}
 		}
 	}
 
@@ -1431,6 +1606,7 @@ namespace gui {
 		assert("handle already created" && !*this);
 		assert("Null handle" && handle);
 		assert("handle already attached" && !Handle(handle).control());
+		createInvokeQueueWindow(); // 非同期の invoke に備えて、このスレッドのキューを起こすウインドウを用意しておく
 		_handle = Handle(handle);
 		_handle.control(this);
 		_defaultProcedure = _handle.procedure(Handle::standardProcedure);
@@ -1,6 +1,8 @@
 ﻿#pragma once
 
 #include <functional>
+#include <future>
+#include <memory>
 
 #include <balor/graphics/Graphics.hpp>
 #include <balor/gui/Key.hpp>
@@ -580,7 +582,20 @@ public:
 	void invalidate(HRGN region, bool invalidateChildren = false);
 	/// コントロールが属するメッセージループのスレッドで function を実行する。他のスレッドからコントロールを操作する場合に使う。
 	/// synchronous は function の実行が終わるまで待つかどうか。引数や戻り値はラムダ式を使って受け渡しすれば良い。
+	/// 非同期の場合は UI スレッドごとのキューに溜められ、キューが空の時だけメッセージを送る。
+	/// 溜まった関数は一回のメッセージ処理で一定時間まとめて実行され、残りは入力や描画を処理した後に実行される。
+	/// 実行される前にコントロールが破棄された場合は実行されない。
 	void invoke(const std::tr1::function<void()>& function, bool synchronous = true);
+	/// 非同期に invoke して、function の戻り値または例外を std::future で返す。呼び出し側は待たずに済む。
+	/// 実行される前にコントロールが破棄された場合、future は std::future_error（broken_promise）を投げる。
+	template<typename Function>
+	std::future<typename std::result_of<Function()>::type> invokeAsync(Function function) {
+		typedef typename std::result_of<Function()>::type Result;
+		auto task = std::make_shared<std::packaged_task<Result()> >(function);
+		auto future = task->get_future();
+		invoke([task] () { (*task)(); }, false);
+		return future;
+	}
 	/// コントロールを現在のスレッドから操作すべきではないかどうか。true の場合は invoke() 関数を使う必要がある。
 	bool invokeRequired() const;
 	/// onMouseHover イベントが発生するまでのマウス静止の時間（ミリ秒）。初期値は 100。
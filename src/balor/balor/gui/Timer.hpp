@@ -21,6 +21,7 @@ class Control;
 * executor()  がメッセージループで処理されていないとタイマーは動かない。
 * Timer への操作はスレッドセーフではないので、複数のスレッドから Timer を操作する場合は自分でロックを行うこと。
 * タイマーの精度は 55 ミリ秒程度で、メッセージが混雑している時には処理されない場合もある。
+* 一つごとに USER タイマーを作成するので、多数のタイマーを使う場合は TimerService を使うと良い。
 *
 * <h3>・サンプルコード</h3>
 * <pre><code>
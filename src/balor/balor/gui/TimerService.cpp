@@ -0,0 +1,92 @@
+﻿#include "TimerService.hpp"
+
+#include <algorithm>
+
+#include <balor/system/windows.hpp>
+#include <balor/test/verify.hpp>
+
+
+namespace balor {
+	namespace gui {
+
+using std::max;
+
+
+namespace {
+__declspec(thread) TimerService* currentService = nullptr;
+} // namespace
+
+
+
+TimerService::TimerService(int resolution)
+	: _lastTickCount(GetTickCount())
+	, _elapsed(0)
+	, _id(0)
+	, _wheel([this] () { return elapsed(); }, resolution, [this] () { update(); }) {
+	assert("TimerService already exists in this thread" && !currentService);
+	currentService = this;
+}
+
+
+TimerService::~TimerService() {
+	if (_id) {
+		verify(KillTimer(nullptr, _id));
+	}
+	currentService = nullptr;
+}
+
+
+TimerService* TimerService::current() {
+	return currentService;
+}
+
+
+system::TimerWheel& TimerService::wheel() {
+	return _wheel;
+}
+
+
+TimerService::operator system::TimerWheel&() {
+	return _wheel;
+}
+
+
+void CALLBACK TimerService::procedure(HWND //handle
+									, UINT //message
+									, UINT_PTR id
+									, DWORD //time
+									) {
+	TimerService* service = currentService;
+	if (!service || service->_id != id) {
+		return;
+	}
+	service->_wheel.advance();
+	service->update();
+}
+
+
+__int64 TimerService::elapsed() {
+	const DWORD tickCount = GetTickCount(); // GetTickCount64 は Vista 以降なので一周しても差分で積算する
+	_elapsed += static_cast<DWORD>(tickCount - _lastTickCount);
+	_lastTickCount = tickCount;
+	return _elapsed;
+}
+
+
+void TimerService::update() {
+	const int delay = _wheel.nextExpiration();
+	if (delay < 0) {
+		if (_id) {
+			verify(KillTimer(nullptr, _id));
+			_id = 0;
+		}
+		return;
+	}
+	_id = SetTimer(nullptr, _id, max(static_cast<int>(USER_TIMER_MINIMUM), delay), &procedure); // 同じ ID ならば設定し直す
+	assert(_id);
+}
+
+
+
+	}
+}
@@ -0,0 +1,79 @@
+﻿#pragma once
+
+#include <balor/gui/Message.hpp>
+#include <balor/system/TimerWheel.hpp>
+#include <balor/NonCopyable.hpp>
+
+struct HWND__;
+
+
+namespace balor {
+	namespace gui {
+
+
+
+/**
+ * 一つの OS のタイマーで多数の軽量なタイマーを駆動する。
+ *
+ * Timer は一つごとに USER タイマーを作成して WM_TIMER を処理するが、TimerService は作成したスレッドにスレッドタイマーを一つだけ作成し、
+ * その中で balor::system::TimerWheel を進めて、満了した TimerService::Timer の onRun イベントを発生させる。
+ * タイマーの開始と停止はタイマーの数によらず定数時間で終わり、OS のタイマーは次にタイマーが満了する時刻に合わせて設定し直すので、開始しているタイマーが無い間は起床しない。
+ * onRun イベントが実行されるのは TimerService を作成したスレッドのメッセージループで、メッセージループで処理されていないとタイマーは動かない。
+ * 一つのスレッドに作成できる TimerService は一つまで。操作はスレッドセーフではないので作成したスレッドから行うこと。
+ * TimerService は全てのタイマーより後に破棄すること。
+ *
+ * <h3>・サンプルコード</h3>
+ * <pre><code>
+	Frame frame(L"TimerService Sample");
+	TimerService service;
+
+	std::vector<std::unique_ptr<Label> > labels;
+	std::vector<std::unique_ptr<TimerService::Timer> > timers;
+	for (int i = 0; i < 300; ++i) {
+		labels.push_back(std::unique_ptr<Label>(new Label(frame, (i % 20) * 40, (i / 20) * 20, 40, 20, L"0")));
+		Label& label = *labels.back();
+		timers.push_back(std::unique_ptr<TimerService::Timer>(new TimerService::Timer(service, 1000 + i, [&] (TimerService::Timer::Run& ) {
+			label.text(String() + (to<int>(label.text()) + 1));
+		})));
+		timers.back()->tolerance(100); // 近い時刻の他のタイマーとまとめて更新して良い
+		timers.back()->start();
+	}
+
+	frame.runMessageLoop();
+ * </code></pre>
+ */
+class TimerService : private NonCopyable {
+public:
+	/// TimerService で駆動するタイマー。
+	typedef system::TimerWheel::Timer Timer;
+
+public:
+	/// 現在のスレッドに作成する。resolution はタイマーの分解能（ミリ秒）。
+	explicit TimerService(int resolution = 10);
+	~TimerService();
+
+public:
+	/// 現在のスレッドの TimerService。作成していなければ nullptr。
+	static TimerService* current();
+	/// タイマーを駆動する TimerWheel。
+	system::TimerWheel& wheel();
+	/// TimerWheel への変換。TimerService::Timer の作成に使う。
+	operator system::TimerWheel&();
+
+private:
+	typedef ::HWND__* HWND;
+
+	static void __stdcall procedure(HWND handle, unsigned int message, Message::WPARAM id, unsigned long time);
+	__int64 elapsed();
+	void update();
+
+	unsigned long _lastTickCount;
+	__int64 _elapsed;
+	Message::WPARAM _id;
+	system::TimerWheel _wheel;
+};
+
+
+
+	}
+}
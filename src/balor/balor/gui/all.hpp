@@ -58,6 +58,7 @@ namespace gui {
 #include <balor/gui/Splitter.hpp>
 #include <balor/gui/Tab.hpp>
 #include <balor/gui/Timer.hpp>
+#include <balor/gui/TimerService.hpp>
 #include <balor/gui/ToolBar.hpp>
 #include <balor/gui/ToolTip.hpp>
 #include <balor/gui/TrackBar.hpp>
@@ -0,0 +1,321 @@
+﻿#include "AsyncFile.hpp"
+
+#include <cstddef>
+#include <new>
+#include <utility>
+
+#define BOOST_DATE_TIME_NO_LIB
+#define BOOST_THREAD_NO_LIB
+#include <boost/thread.hpp>
+
+#include <balor/system/windows.hpp>
+#include <balor/test/verify.hpp>
+#include <balor/Singleton.hpp>
+
+
+namespace balor {
+	namespace io {
+
+using boost::condition_variable;
+using boost::mutex;
+using boost::thread;
+using std::exception_ptr;
+using std::move;
+using system::Task;
+using system::TaskScheduler;
+
+
+namespace detail {
+struct AsyncFileState {
+	AsyncFileState() : count(0) {}
+
+	mutex guard;
+	condition_variable condition;
+	int count; // 完了していない要求の数
+};
+
+
+struct AsyncFileRequest {
+	OVERLAPPED overlapped; // GetQueuedCompletionStatus の OVERLAPPED* から戻せるように先頭に置く
+	AsyncFileState* state;
+	AsyncFile::HANDLE handle;
+	bool write;
+	__int64 position;
+	char* buffer;
+	int count;
+	int transferred;
+	AsyncFile::Callback callback;
+};
+} // namespace detail
+
+
+namespace {
+typedef detail::AsyncFileRequest Request;
+typedef detail::AsyncFileState State;
+
+
+static_assert(offsetof(Request, overlapped) == 0, "Invalid Request layout");
+
+
+void checkError(DWORD errorCode) {
+	switch (errorCode) {
+		case ERROR_FILE_NOT_FOUND    :
+		case ERROR_PATH_NOT_FOUND    : throw AsyncFile::NotFoundException();
+		case ERROR_FILE_EXISTS       : throw AsyncFile::AlreadyExistsException();
+		case ERROR_ACCESS_DENIED     : throw AsyncFile::AccessDeniedException();
+		case ERROR_SHARING_VIOLATION : throw AsyncFile::SharingViolationException();
+		default                      : assert("Failed to async file function" && false); break;
+	}
+}
+
+
+/// I/O 完了ポートと完了を処理するスレッド。
+class CompletionPort {
+	friend Singleton<CompletionPort>;
+
+	CompletionPort() : _port(CreateIoCompletionPort(INVALID_HANDLE_VALUE, nullptr, 0, 1)) {
+		assert("Failed to CreateIoCompletionPort" && _port);
+		_thread = thread([&] () {
+			run();
+		});
+	}
+	~CompletionPort() {
+		verify(PostQueuedCompletionStatus(_port, 0, exitKey, nullptr));
+		_thread.join();
+		verify(CloseHandle(_port));
+	}
+
+public:
+	/// ファイルを完了ポートに関連付ける。
+	void associate(AsyncFile::HANDLE handle) {
+		verify(CreateIoCompletionPort(handle, _port, 0, 0) == _port);
+	}
+
+	/// 要求の残りを発行する。
+	static void issue(Request* request) {
+		ZeroMemory(&request->overlapped, sizeof(request->overlapped));
+		const __int64 position = request->position + request->transferred;
+		request->overlapped.Offset = static_cast<DWORD>(position);
+		request->overlapped.OffsetHigh = static_cast<DWORD>(position >> 32);
+		char* const buffer = request->buffer + request->transferred;
+		const DWORD count = request->count - request->transferred;
+		const BOOL result = request->write ? WriteFile(request->handle, buffer, count, nullptr, &request->overlapped)
+										   : ReadFile (request->handle, buffer, count, nullptr, &request->overlapped);
+		if (!result) { // 同期的に完了しても完了ポートに通知されるが、失敗した場合は通知されない
+			const DWORD errorCode = GetLastError();
+			if (errorCode != ERROR_IO_PENDING) {
+				verify(transferred(request, errorCode == ERROR_HANDLE_EOF ? 0 : -1));
+			}
+		}
+	}
+
+private:
+	static const ULONG_PTR exitKey = 1;
+
+	/// bytes バイトを転送した結果を反映する。bytes が負ならば失敗。
+	/// 要求を完了して削除したら true を、残りを読み書きする必要があれば false を返す。
+	static bool transferred(Request* request, int bytes) {
+		exception_ptr error;
+		if (bytes < 0) {
+			error = std::make_exception_ptr(AsyncFile::TransferFailedException());
+		} else {
+			request->transferred += bytes;
+			if (0 < bytes && request->transferred < request->count) { // 読み込みがファイルの終わりに達しても転送したバイト数が０になるまでは続ける
+				return false;
+			}
+			if (request->write && request->transferred < request->count) {
+				error = std::make_exception_ptr(AsyncFile::TransferFailedException());
+			}
+		}
+
+		State* state = request->state;
+		try {
+			request->callback(request->transferred, error);
+		} catch (...) {
+			assert("AsyncFile callback must not throw" && false);
+		}
+		delete request;
+		mutex::scoped_lock lock(state->guard);
+		if (--state->count == 0) {
+			state->condition.notify_all(); // ロックしたまま通知しないと待っている AsyncFile が State を破棄してしまう
+		}
+		return true;
+	}
+
+	void run() {
+		for (;;) {
+			DWORD bytes = 0;
+			ULONG_PTR key = 0;
+			OVERLAPPED* overlapped = nullptr;
+			const BOOL result = GetQueuedCompletionStatus(_port, &bytes, &key, &overlapped, INFINITE);
+			if (!overlapped) {
+				if (key == exitKey) {
+					break;
+				}
+				continue;
+			}
+			Request* request = reinterpret_cast<Request*>(overlapped);
+			const int count = result || GetLastError() == ERROR_HANDLE_EOF ? static_cast<int>(bytes) : -1;
+			if (!transferred(request, count)) {
+				issue(request);
+			}
+		}
+	}
+
+	HANDLE _port;
+	thread _thread;
+};
+
+
+AsyncFile::Callback toCallback(std::shared_ptr<system::detail::TaskState<int> > state) {
+	return [state] (int transferred, exception_ptr error) {
+		if (!error) {
+			state->value.reset(new int(transferred));
+		}
+		state->complete(error);
+	};
+}
+
+
+AsyncFile::Callback toCallback(std::shared_ptr<system::detail::TaskState<void> > state) {
+	return [state] (int , exception_ptr error) {
+		state->complete(error);
+	};
+}
+} // namespace
+
+
+
+AsyncFile::AsyncFile() : _handle(nullptr) {
+}
+
+
+AsyncFile::AsyncFile(StringRange path, FileStream::Mode mode, FileStream::Access access, FileStream::Share share, FileStream::Options options) : _handle(nullptr) {
+	assert("Empty path" && !path.empty());
+	assert("Invalid mode" && FileStream::Mode::_validate(mode));
+	assert("Append mode unsupported" && mode != FileStream::Mode::append);
+	assert("Invalid access" && FileStream::Access::_validate(access));
+	assert("Invalid share" && FileStream::Share::_validate(share));
+	assert("Invalid options" && FileStream::Options::_validate(options));
+
+	CompletionPort& port = Singleton<CompletionPort>::get();
+	const DWORD flags = (options & FILE_ATTRIBUTE_ENCRYPTED) == FILE_ATTRIBUTE_ENCRYPTED ? options : (options | FILE_ATTRIBUTE_NORMAL);
+	_handle = CreateFileW(path.c_str(), access, share, nullptr, mode, flags | FILE_FLAG_OVERLAPPED, nullptr);
+	if (_handle == INVALID_HANDLE_VALUE) {
+		_handle = nullptr;
+		checkError(GetLastError());
+	}
+	port.associate(_handle);
+	_state.reset(new detail::AsyncFileState());
+}
+
+
+AsyncFile::AsyncFile(AsyncFile&& value) : _handle(value._handle), _state(move(value._state)) {
+	value._handle = nullptr;
+}
+
+
+AsyncFile::~AsyncFile() {
+	if (_handle) {
+		wait();
+		verify(CloseHandle(_handle));
+		//_handle = nullptr;
+	}
+}
+
+
+AsyncFile& AsyncFile::operator=(AsyncFile&& value) {
+	if (&value != this) {
+		this->~AsyncFile();
+		new (this) AsyncFile(move(value));
+	}
+	return *this;
+}
+
+
+void AsyncFile::flush() {
+	assert("Null AsyncFile" && *this);
+	if (!FlushFileBuffers(_handle)) {
+		checkError(GetLastError());
+	}
+}
+
+
+__int64 AsyncFile::length() const {
+	assert("Null AsyncFile" && *this);
+	LARGE_INTEGER size;
+	verify(GetFileSizeEx(_handle, &size));
+	return size.QuadPart;
+}
+
+
+int AsyncFile::pendingCount() const {
+	if (!_state) {
+		return 0;
+	}
+	mutex::scoped_lock lock(_state->guard);
+	return _state->count;
+}
+
+
+void AsyncFile::readAsync(__int64 position, void* buffer, int offset, int count, AsyncFile::Callback callback) {
+	CompletionPort::issue(createRequest(false, position, buffer, offset, count, move(callback)));
+}
+
+
+Task<int> AsyncFile::readAsync(__int64 position, void* buffer, int offset, int count) {
+	auto state = std::make_shared<system::detail::TaskState<int> >(system::CancellationToken());
+	readAsync(position, buffer, offset, count, toCallback(state));
+	return Task<int>(state);
+}
+
+
+void AsyncFile::wait() const {
+	if (!_state) {
+		return;
+	}
+	mutex::scoped_lock lock(_state->guard);
+	while (0 < _state->count) {
+		_state->condition.wait(lock);
+	}
+}
+
+
+void AsyncFile::writeAsync(__int64 position, const void* buffer, int offset, int count, AsyncFile::Callback callback) {
+	CompletionPort::issue(createRequest(true, position, buffer, offset, count, move(callback)));
+}
+
+
+Task<void> AsyncFile::writeAsync(__int64 position, const void* buffer, int offset, int count) {
+	auto state = std::make_shared<system::detail::TaskState<void> >(system::CancellationToken());
+	writeAsync(position, buffer, offset, count, toCallback(state));
+	return Task<void>(state);
+}
+
+
+detail::AsyncFileRequest* AsyncFile::createRequest(bool write, __int64 position, const void* buffer, int offset, int count, AsyncFile::Callback callback) {
+	assert("Null AsyncFile" && *this);
+	assert("Negative position" && 0 <= position);
+	assert("Null buffer" && buffer);
+	assert("Negative offset" && 0 <= offset);
+	assert("Negative count" && 0 <= count);
+	assert("Empty callback" && callback);
+
+	Request* request = new Request();
+	request->state = _state.get();
+	request->handle = _handle;
+	request->write = write;
+	request->position = position;
+	request->buffer = const_cast<char*>(static_cast<const char*>(buffer)) + offset;
+	request->count = count;
+	request->transferred = 0;
+	request->callback = move(callback);
+	mutex::scoped_lock lock(_state->guard);
+	++_state->count;
+	return request;
+}
+
+
+
+	}
+}
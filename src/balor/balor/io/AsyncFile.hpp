@@ -0,0 +1,115 @@
+﻿#pragma once
+
+#include <exception>
+#include <functional>
+#include <memory>
+
+#include <balor/io/FileStream.hpp>
+#include <balor/system/TaskScheduler.hpp>
+#include <balor/Exception.hpp>
+#include <balor/NonCopyable.hpp>
+#include <balor/StringRange.hpp>
+
+
+namespace balor {
+	namespace io {
+
+
+
+namespace detail {
+struct AsyncFileRequest;
+struct AsyncFileState;
+}
+
+
+
+/**
+ * ファイルの指定した位置に非同期で読み書きする。
+ *
+ * FileStream と違ってファイル位置を持たず、読み書きの度に位置を指定する。読み書きの関数は直ちに戻り、完了すると system::Task が完了するかコールバック関数が呼ばれる。
+ * 同時にいくつでも要求を発行できる。
+ * FILE_FLAG_OVERLAPPED で開いたハンドルを I/O 完了ポートに関連付け、完了は専用のスレッドで処理する。
+ * コールバック関数と Task の継続は完了を処理するスレッドで呼ばれるので、時間のかかる処理や UI の操作は Task::thenOn や TaskScheduler に回すこと。コールバック関数は例外を投げてはならない。
+ * 読み込みがファイルの終わりに達した場合は要求より短いバイト数で完了する。読み書きに失敗した場合は TransferFailedException で完了する。
+ * 完了するまでバッファを破棄してはならない。AsyncFile を破棄すると発行中の要求が全て完了するまで待つ。
+ *
+ * <h3>・サンプルコード</h3>
+ * <pre><code>
+	Frame frame(L"AsyncFile Sample");
+	Label label(frame, 20, 10, 0, 0, L"読み込み中...");
+
+	AsyncFile file(L"huge.bin", FileStream::Mode::open, FileStream::Access::read);
+	std::vector<char> buffer(static_cast<int>(file.length()));
+	auto task = file.readAsync(0, buffer.data(), 0, buffer.size());
+	task.thenOn(frame, [&] (Task<int>& task) { // frame のメッセージループで実行される
+		label.text(String() + task.get() + L" バイト読み込みました");
+	});
+
+	frame.runMessageLoop();
+ * </code></pre>
+ */
+class AsyncFile : private NonCopyable {
+public:
+	typedef void* HANDLE;
+	/// 完了した時に呼ばれる関数。読み書きしたバイト数と、失敗した場合は例外を受け取る。
+	typedef std::function<void (int, std::exception_ptr)> Callback;
+
+	/// アクセス権が無かった。
+	class AccessDeniedException : public Exception {};
+
+	/// ファイルが既に存在している。
+	class AlreadyExistsException : public Exception {};
+
+	/// ファイルが見つからなかった。
+	class NotFoundException : public Exception {};
+
+	/// 共有方式に反する競合があった。
+	class SharingViolationException : public Exception {};
+
+	/// 読み書きに失敗した。
+	class TransferFailedException : public Exception {};
+
+public:
+	/// ヌルハンドルで作成する。
+	AsyncFile();
+	/// 指定したパラメータでファイルをオープンする。Mode::append は指定できない。
+	AsyncFile(StringRange path, FileStream::Mode mode, FileStream::Access access = FileStream::Access::read, FileStream::Share share = FileStream::Share::read, FileStream::Options options = FileStream::Options::none);
+	AsyncFile(AsyncFile&& value);
+	/// 発行中の要求が全て完了するのを待ってファイルをクローズする。
+	~AsyncFile();
+
+	AsyncFile& operator=(AsyncFile&& value);
+
+public:
+	/// 書き込みをディスクに反映する。発行中の書き込みは含まない。
+	void flush();
+	/// ファイルのバイト数。
+	__int64 length() const;
+	/// 発行して完了していない要求の数。
+	int pendingCount() const;
+	/// position の位置から最大 count バイトを読み込み、完了したら読み込んだバイト数で callback を呼ぶ。
+	void readAsync(__int64 position, void* buffer, int offset, int count, AsyncFile::Callback callback);
+	/// position の位置から最大 count バイトを読み込み、読み込んだバイト数を Task で返す。
+	system::Task<int> readAsync(__int64 position, void* buffer, int offset, int count);
+	/// 発行中の要求が全て完了するまで待つ。
+	void wait() const;
+	/// position の位置に count バイト書き込み、完了したら callback を呼ぶ。
+	void writeAsync(__int64 position, const void* buffer, int offset, int count, AsyncFile::Callback callback);
+	/// position の位置に count バイト書き込み、完了を Task で返す。
+	system::Task<void> writeAsync(__int64 position, const void* buffer, int offset, int count);
+
+public:
+	/// HANDLE への自動変換 ＆ null チェック用。
+	operator HANDLE() const { return _handle; }
+
+private:
+	detail::AsyncFileRequest* createRequest(bool write, __int64 position, const void* buffer, int offset, int count, AsyncFile::Callback callback);
+
+	HANDLE _handle;
+	std::unique_ptr<detail::AsyncFileState> _state; // 要求から参照するので AsyncFile を移動しても動かないようにする
+};
+
+
+
+	}
+}
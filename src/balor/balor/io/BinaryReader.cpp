@@ -0,0 +1,401 @@
+﻿#include "BinaryReader.hpp"
+
+#include <climits>
+#include <cstring>
+#include <string>
+#include <utility>
+#include <vector>
+#include <cstdlib>
+
+#include <balor/system/windows.hpp> // IsBadWritePtr の assert
+#include <balor/test/verify.hpp>
+
+
+namespace balor {
+	namespace io {
+
+using std::move;
+using std::vector;
+using std::wstring;
+
+
+namespace {
+inline unsigned short swap16(unsigned short value) {
+	return static_cast<unsigned short>((value >> 8) | (value << 8));
+}
+
+
+inline unsigned int swap32(unsigned int value) {
+	return _byteswap_ulong(value);
+}
+
+
+inline unsigned __int64 swap64(unsigned __int64 value) {
+	return _byteswap_uint64(value);
+}
+
+
+inline void appendCode(wstring& result, unsigned long code) {
+	if (sizeof(wchar_t) == 2 && 0x10000 <= code) {
+		code -= 0x10000;
+		result += static_cast<wchar_t>(0xd800 + (code >> 10));
+		result += static_cast<wchar_t>(0xdc00 + (code & 0x3ff));
+	} else {
+		result += static_cast<wchar_t>(code);
+	}
+}
+
+
+wstring decodeUtf8(const unsigned char* i, const unsigned char* end) {
+	wstring result;
+	result.reserve(end - i);
+	while (i != end) {
+		unsigned long code = *i++;
+		if (code < 0x80) {
+			result += static_cast<wchar_t>(code);
+			continue;
+		}
+		int followCount = code < 0xc0 ? -1 : code < 0xe0 ? 1 : code < 0xf0 ? 2 : code < 0xf8 ? 3 : -1;
+		if (followCount < 0) {
+			result += static_cast<wchar_t>(0xfffd);
+			continue;
+		}
+		code &= 0x7f >> followCount;
+		for (; 0 < followCount && i != end && (*i & 0xc0) == 0x80; --followCount) {
+			code = (code << 6) | (*i++ & 0x3f);
+		}
+		if (followCount || 0x10ffff < code) {
+			code = 0xfffd;
+		}
+		appendCode(result, code);
+	}
+	return result;
+}
+
+
+wstring decodeUtf16(const unsigned char* data, int count, bool swap) { // count は符号単位の数
+	wstring result;
+	if (sizeof(wchar_t) == 2) {
+		result.resize(count);
+		if (count) {
+			if (swap) {
+				BinaryWriter::swapByteOrder(&result[0], data, count, 2);
+			} else {
+				std::memcpy(&result[0], data, count * 2);
+			}
+		}
+		return result;
+	}
+	result.reserve(count);
+	for (int i = 0; i < count; ++i) {
+		unsigned short unit;
+		std::memcpy(&unit, data + i * 2, 2);
+		unsigned long code = swap ? swap16(unit) : unit;
+		if (0xd800 <= code && code < 0xdc00 && i + 1 < count) {
+			std::memcpy(&unit, data + (i + 1) * 2, 2);
+			const unsigned long low = swap ? swap16(unit) : unit;
+			if (0xdc00 <= low && low < 0xe000) {
+				code = 0x10000 + ((code - 0xd800) << 10) + (low - 0xdc00);
+				++i;
+			}
+		}
+		appendCode(result, code);
+	}
+	return result;
+}
+} // namespace
+
+
+
+BinaryReader::BinaryReader(Stream& stream, BinaryReader::ByteOrder byteOrder, int bufferSize)
+	: _stream(&stream)
+	, _buffer(nullptr)
+	, _bufferSize(bufferSize)
+	, _byteOrder(byteOrder) {
+	assert("Invalid BinaryReader::ByteOrder" && ByteOrder::_validate(byteOrder));
+	assert("bufferSize too small" && 16 <= bufferSize);
+	assert("read unsupported" && stream.readable());
+
+	_buffer = new unsigned char[bufferSize];
+	_current = _buffer;
+	_end = _buffer;
+}
+
+
+BinaryReader::BinaryReader(BinaryReader&& value)
+	: _stream(value._stream)
+	, _buffer(value._buffer)
+	, _bufferSize(value._bufferSize)
+	, _current(value._current)
+	, _end(value._end)
+	, _byteOrder(value._byteOrder) {
+	value._stream = nullptr;
+	value._buffer = nullptr;
+	value._current = nullptr;
+	value._end = nullptr;
+}
+
+
+BinaryReader::~BinaryReader() {
+	delete [] _buffer;
+}
+
+
+BinaryReader& BinaryReader::operator=(BinaryReader&& value) {
+	if (&value != this) {
+		this->~BinaryReader();
+		new (this) BinaryReader(move(value));
+	}
+	return *this;
+}
+
+
+int BinaryReader::bufferSize() const {
+	return _bufferSize;
+}
+
+
+BinaryReader::ByteOrder BinaryReader::byteOrder() const {
+	return _byteOrder;
+}
+
+
+void BinaryReader::byteOrder(BinaryReader::ByteOrder value) {
+	assert("Invalid BinaryReader::ByteOrder" && ByteOrder::_validate(value));
+	_byteOrder = value;
+}
+
+
+int BinaryReader::read(void* buffer, int offset, int count) {
+	assert("Null stream" && _stream);
+	assert("Null buffer" && (buffer || !count));
+	assert("Negative offset" && 0 <= offset);
+	assert("Negative count" && 0 <= count);
+	assert("buffer is bad write pointer" && (!count || !IsBadWritePtr(buffer, offset + count)));
+
+	unsigned char* destination = static_cast<unsigned char*>(buffer) + offset;
+	int result = static_cast<int>(_end - _current) < count ? static_cast<int>(_end - _current) : count;
+	if (result) {
+		std::memcpy(destination, _current, result);
+		_current += result;
+	}
+	while (result < count) {
+		if (_bufferSize <= count - result) { // バッファより大きければ直接読む
+			const int readCount = _stream->read(destination, result, count - result);
+			if (!readCount) {
+				break;
+			}
+			result += readCount;
+		} else {
+			const int readCount = _stream->read(_buffer, 0, _bufferSize);
+			if (!readCount) {
+				break;
+			}
+			_current = _buffer;
+			_end = _buffer + readCount;
+			const int copyCount = readCount < count - result ? readCount : count - result;
+			std::memcpy(destination + result, _current, copyCount);
+			_current += copyCount;
+			result += copyCount;
+		}
+	}
+	return result;
+}
+
+
+double BinaryReader::readDouble() {
+	const unsigned __int64 bits = readUInt64();
+	double value;
+	std::memcpy(&value, &bits, sizeof(value));
+	return value;
+}
+
+
+float BinaryReader::readFloat() {
+	const unsigned int bits = readUInt32();
+	float value;
+	std::memcpy(&value, &bits, sizeof(value));
+	return value;
+}
+
+
+short BinaryReader::readInt16() {
+	return static_cast<short>(readUInt16());
+}
+
+
+int BinaryReader::readInt32() {
+	return static_cast<int>(readUInt32());
+}
+
+
+__int64 BinaryReader::readInt64() {
+	return static_cast<__int64>(readUInt64());
+}
+
+
+String BinaryReader::readString(BinaryReader::Encoding encoding) {
+	assert("Invalid BinaryReader::Encoding" && Encoding::_validate(encoding));
+
+	const unsigned __int64 length = readVarUInt();
+	if (INT_MAX < length || (encoding == Encoding::utf16 && length % 2)) {
+		throw FormatException();
+	}
+	const int count = static_cast<int>(length);
+	vector<unsigned char> large;
+	const unsigned char* data;
+	if (count <= _bufferSize) {
+		if (_end - _current < count) {
+			fill(count);
+		}
+		data = _current;
+		_current += count;
+	} else { // バッファに入りきらない
+		large.resize(count);
+		readExactly(large.data(), count);
+		data = large.data();
+	}
+	if (encoding == Encoding::utf16) {
+		return decodeUtf16(data, count / 2, _byteOrder == ByteOrder::bigEndian);
+	}
+	return decodeUtf8(data, data + count);
+}
+
+
+unsigned short BinaryReader::readUInt16() {
+	unsigned short value;
+	readFixed(&value, sizeof(value));
+	return _byteOrder == ByteOrder::bigEndian ? swap16(value) : value; // ホストはリトルエンディアン
+}
+
+
+unsigned int BinaryReader::readUInt32() {
+	unsigned int value;
+	readFixed(&value, sizeof(value));
+	return _byteOrder == ByteOrder::bigEndian ? swap32(value) : value;
+}
+
+
+unsigned __int64 BinaryReader::readUInt64() {
+	unsigned __int64 value;
+	readFixed(&value, sizeof(value));
+	return _byteOrder == ByteOrder::bigEndian ? swap64(value) : value;
+}
+
+
+__int64 BinaryReader::readVarInt() {
+	unsigned __int64 result = 0;
+	for (int shift = 0; ; shift += 7) {
+		const unsigned char byte = readByte();
+		if (shift == 63 && byte != 0x00 && byte != 0x7f) { // 10 バイト目は最上位ビットと同じ符号ビットだけで、続きも無い
+			throw FormatException();
+		}
+		result |= static_cast<unsigned __int64>(byte & 0x7f) << shift;
+		if (!(byte & 0x80)) {
+			if (shift + 7 < 64 && (byte & 0x40)) { // 符号拡張
+				result |= ~0ULL << (shift + 7);
+			}
+			return static_cast<__int64>(result);
+		}
+	}
+}
+
+
+unsigned __int64 BinaryReader::readVarUInt() {
+	unsigned __int64 result = 0;
+	for (int shift = 0; ; shift += 7) {
+		const unsigned char byte = readByte();
+		if (shift == 63 && 1 < byte) { // 64 ビットに収まらない
+			throw FormatException();
+		}
+		result |= static_cast<unsigned __int64>(byte & 0x7f) << shift;
+		if (!(byte & 0x80)) {
+			return result;
+		}
+	}
+}
+
+
+void BinaryReader::skip(__int64 count) {
+	assert("Null stream" && _stream);
+	assert("Negative count" && 0 <= count);
+
+	const __int64 buffered = _end - _current;
+	if (count <= buffered) {
+		_current += count;
+		return;
+	}
+	_current = _buffer;
+	_end = _buffer;
+	_stream->skip(count - buffered);
+}
+
+
+Stream& BinaryReader::stream() const {
+	assert("Null stream" && _stream);
+	return *_stream;
+}
+
+
+void BinaryReader::sync() {
+	assert("Null stream" && _stream);
+
+	if (_current != _end) {
+		const __int64 remaining = _end - _current;
+		_current = _buffer;
+		_end = _buffer;
+		_stream->skip(-remaining);
+	}
+}
+
+
+void BinaryReader::fill(int count) {
+	assert("Null stream" && _stream);
+	assert(count <= _bufferSize);
+
+	const int remaining = static_cast<int>(_end - _current);
+	if (remaining && _current != _buffer) {
+		std::memmove(_buffer, _current, remaining);
+	}
+	_current = _buffer;
+	_end = _buffer + remaining;
+	while (_end - _current < count) {
+		const int readCount = _stream->read(_end, 0, static_cast<int>(_buffer + _bufferSize - _end));
+		if (!readCount) {
+			throw EndOfStreamException();
+		}
+		_end += readCount;
+	}
+}
+
+
+void BinaryReader::readElements(void* values, int count, int elementSize) {
+	assert("Null values" && (values || !count));
+	assert("Negative count" && 0 <= count);
+
+	readExactly(values, count * elementSize);
+	if (_byteOrder == ByteOrder::bigEndian && 1 < elementSize) {
+		BinaryWriter::swapByteOrder(values, values, count, elementSize);
+	}
+}
+
+
+void BinaryReader::readExactly(void* buffer, int count) {
+	if (count && read(buffer, 0, count) < count) {
+		throw EndOfStreamException();
+	}
+}
+
+
+void BinaryReader::readFixed(void* value, int size) {
+	if (_end - _current < size) {
+		fill(size);
+	}
+	std::memcpy(value, _current, size);
+	_current += size;
+}
+
+
+
+	}
+}
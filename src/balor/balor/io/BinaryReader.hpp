@@ -0,0 +1,115 @@
+﻿#pragma once
+
+#include <balor/io/BinaryWriter.hpp>
+#include <balor/io/Stream.hpp>
+#include <balor/ArrayRange.hpp>
+#include <balor/Exception.hpp>
+#include <balor/NonCopyable.hpp>
+#include <balor/String.hpp>
+
+
+namespace balor {
+	namespace io {
+
+
+
+/**
+ * 他のストリームから BinaryWriter で書き込んだ数値や文字列を読み込む。
+ *
+ * 内部のバッファにまとめて読み込むので、フィールドごとにラップしたストリームの仮想関数を呼ばない。
+ * バイトオーダー、可変長整数、文字列の形式は BinaryWriter を参照。
+ * データが足りなければ EndOfStreamException を、可変長整数が長すぎたり文字列のバイト数がおかしければ FormatException を投げる。
+ * UTF-8 として正しくないバイト列は U+FFFD に置き換える。
+ * ラップしたストリームの位置はバッファに先読みした分だけ進んでいる。続けてラップしたストリームから直接読み込むには、シークできるストリームなら sync 関数で読み残したバイト数だけ戻す。
+ * ラップしたストリームは BinaryReader より後に破棄すること。
+ *
+ * <h3>・サンプルコード</h3>
+ * <pre><code>
+	FileStream file(L"scene.bin", FileStream::Mode::open, FileStream::Access::read);
+	BinaryReader reader(file);
+	if (reader.readUInt32() != 0x4e435342) {
+		return false;
+	}
+	String name = reader.readString();
+	std::vector<float> vertices(static_cast<int>(reader.readVarUInt()));
+	reader.readArray<float>(vertices);
+ * </code></pre>
+ */
+class BinaryReader : private NonCopyable {
+public:
+	typedef BinaryWriter::ByteOrder ByteOrder;
+	typedef BinaryWriter::Encoding Encoding;
+
+	/// 読み込むデータが足りなかった。
+	class EndOfStreamException : public Exception {};
+
+	/// 可変長整数や文字列の形式が正しくなかった。
+	class FormatException : public Exception {};
+
+public:
+	/// ラップするストリーム、バイトオーダー、バッファの大きさから作成。
+	explicit BinaryReader(Stream& stream, BinaryReader::ByteOrder byteOrder = ByteOrder::littleEndian, int bufferSize = 4096);
+	BinaryReader(BinaryReader&& value);
+	~BinaryReader();
+
+	BinaryReader& operator=(BinaryReader&& value);
+
+public:
+	/// バッファの大きさ。
+	int bufferSize() const;
+	/// 固定長の数値と UTF-16 のバイトオーダー。
+	BinaryReader::ByteOrder byteOrder() const;
+	void byteOrder(BinaryReader::ByteOrder value);
+	/// 読み込んだバイト数を返す。ストリームの終わりに達していれば count より少なくなる。
+	int read(void* buffer, int offset, int count);
+	/// 数値の配列をまとめて読み込む。T は 1、2、4、8 バイトの整数か float、double。
+	template<typename T> void readArray(ArrayRange<T> values) {
+		static_assert(sizeof(T) == 1 || sizeof(T) == 2 || sizeof(T) == 4 || sizeof(T) == 8, "Unsupported element size");
+		readElements(values.begin(), values.length(), sizeof(T));
+	}
+	/// １バイト読み込む。バッファにデータがあれば関数を呼ばない。
+	unsigned char readByte() {
+		if (_current == _end) {
+			fill(1);
+		}
+		return *_current++;
+	}
+	double readDouble();
+	float readFloat();
+	short readInt16();
+	int readInt32();
+	__int64 readInt64();
+	/// LEB128 のバイト数に続く文字列を読み込む。
+	String readString(BinaryReader::Encoding encoding = Encoding::utf8);
+	unsigned short readUInt16();
+	unsigned int readUInt32();
+	unsigned __int64 readUInt64();
+	/// 符号付き LEB128 を読み込む。
+	__int64 readVarInt();
+	/// 符号無し LEB128 を読み込む。
+	unsigned __int64 readVarUInt();
+	/// count バイト読み飛ばす。ストリームの終わりを越えたかどうかはラップしたストリームの skip に従い、続く読み込みで分かる。
+	void skip(__int64 count);
+	/// ラップしたストリーム。
+	Stream& stream() const;
+	/// バッファに読み残したバイト数だけラップしたストリームの位置を戻してバッファを空にする。ラップしたストリームは後ろへの skip をサポートしなければならない。
+	void sync();
+
+private:
+	void fill(int count);
+	void readElements(void* values, int count, int elementSize);
+	void readExactly(void* buffer, int count);
+	void readFixed(void* value, int size);
+
+	Stream* _stream;
+	unsigned char* _buffer;
+	int _bufferSize;
+	unsigned char* _current; // [_current, _end) がまだ読んでいないデータ
+	unsigned char* _end;
+	ByteOrder _byteOrder;
+};
+
+
+
+	}
+}
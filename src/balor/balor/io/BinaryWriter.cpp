@@ -0,0 +1,419 @@
+﻿#include "BinaryWriter.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <utility>
+#if defined(_M_X64) || defined(_M_IX86)
+#include <emmintrin.h>
+#define BALOR_BYTE_SWAP_SSE2
+#endif
+#include <cstdlib>
+
+#include <balor/system/windows.hpp> // IsBadReadPtr の assert
+#include <balor/test/verify.hpp>
+
+
+namespace balor {
+	namespace io {
+
+using std::min;
+using std::move;
+
+
+namespace {
+inline unsigned short swap16(unsigned short value) {
+	return static_cast<unsigned short>((value >> 8) | (value << 8));
+}
+
+
+inline unsigned int swap32(unsigned int value) {
+	return _byteswap_ulong(value);
+}
+
+
+inline unsigned __int64 swap64(unsigned __int64 value) {
+	return _byteswap_uint64(value);
+}
+
+
+inline int getUtf8Length(StringRange value) { // UTF-8 に変換した場合のバイト数
+	int result = 0;
+	const wchar_t* i = value.c_str();
+	const wchar_t* const end = i + value.length();
+	for (; i != end; ++i) {
+		const unsigned long code = static_cast<unsigned long>(*i);
+		if (code < 0x80) {
+			result += 1;
+		} else if (code < 0x800) {
+			result += 2;
+		} else if (0xd800 <= code && code < 0xdc00 && i + 1 != end && 0xdc00 <= static_cast<unsigned long>(i[1]) && static_cast<unsigned long>(i[1]) < 0xe000) {
+			result += 4;
+			++i;
+		} else if (code < 0x10000) {
+			result += 3;
+		} else {
+			result += 4;
+		}
+	}
+	return result;
+}
+
+
+inline int getUtf16Length(StringRange value) { // UTF-16 に変換した場合の符号単位の数
+	if (sizeof(wchar_t) == 2) {
+		return value.length();
+	}
+	int result = value.length();
+	for (const wchar_t* i = value.c_str(), * end = i + value.length(); i != end; ++i) {
+		if (0x10000 <= static_cast<unsigned long>(*i)) {
+			++result;
+		}
+	}
+	return result;
+}
+} // namespace
+
+
+
+bool BinaryWriter::ByteOrder::_validate(ByteOrder value) {
+	return littleEndian <= value && value <= bigEndian;
+}
+
+
+bool BinaryWriter::Encoding::_validate(Encoding value) {
+	return utf8 <= value && value <= utf16;
+}
+
+
+
+BinaryWriter::BinaryWriter(Stream& stream, BinaryWriter::ByteOrder byteOrder, int bufferSize)
+	: _stream(&stream)
+	, _buffer(nullptr)
+	, _bufferSize(bufferSize)
+	, _byteOrder(byteOrder) {
+	assert("Invalid BinaryWriter::ByteOrder" && ByteOrder::_validate(byteOrder));
+	assert("bufferSize too small" && 16 <= bufferSize);
+	assert("write unsupported" && stream.writable());
+
+	_buffer = new unsigned char[bufferSize];
+	_current = _buffer;
+	_end = _buffer + bufferSize;
+}
+
+
+BinaryWriter::BinaryWriter(BinaryWriter&& value)
+	: _stream(value._stream)
+	, _buffer(value._buffer)
+	, _bufferSize(value._bufferSize)
+	, _current(value._current)
+	, _end(value._end)
+	, _byteOrder(value._byteOrder) {
+	value._stream = nullptr;
+	value._buffer = nullptr;
+	value._current = nullptr;
+	value._end = nullptr;
+}
+
+
+BinaryWriter::~BinaryWriter() {
+	if (_stream) {
+		try {
+			flushBuffer();
+		} catch (...) {
+		}
+	}
+	delete [] _buffer;
+}
+
+
+BinaryWriter& BinaryWriter::operator=(BinaryWriter&& value) {
+	if (&value != this) {
+		this->~BinaryWriter();
+		new (this) BinaryWriter(move(value));
+	}
+	return *this;
+}
+
+
+int BinaryWriter::bufferSize() const {
+	return _bufferSize;
+}
+
+
+BinaryWriter::ByteOrder BinaryWriter::byteOrder() const {
+	return _byteOrder;
+}
+
+
+void BinaryWriter::byteOrder(BinaryWriter::ByteOrder value) {
+	assert("Invalid BinaryWriter::ByteOrder" && ByteOrder::_validate(value));
+	_byteOrder = value;
+}
+
+
+void BinaryWriter::flush() {
+	assert("Null stream" && _stream);
+	flushBuffer();
+	_stream->flush();
+}
+
+
+Stream& BinaryWriter::stream() const {
+	assert("Null stream" && _stream);
+	return *_stream;
+}
+
+
+void BinaryWriter::swapByteOrder(void* destination, const void* source, int count, int elementSize) {
+	assert("Null destination" && (destination || !count));
+	assert("Null source" && (source || !count));
+	assert("Negative count" && 0 <= count);
+	assert("Invalid elementSize" && (elementSize == 1 || elementSize == 2 || elementSize == 4 || elementSize == 8));
+
+	unsigned char* output = static_cast<unsigned char*>(destination);
+	const unsigned char* input = static_cast<const unsigned char*>(source);
+	const unsigned char* const end = input + count * elementSize;
+	if (elementSize == 1) {
+		if (count && output != input) {
+			std::memmove(output, input, count);
+		}
+		return;
+	}
+#if defined(BALOR_BYTE_SWAP_SSE2)
+	// 16 ビット単位のバイト交換に、32、64 ビットでは 16 ビット単位の並べ替えを組み合わせる
+	for (; 16 <= end - input; input += 16, output += 16) {
+		__m128i value = _mm_loadu_si128(reinterpret_cast<const __m128i*>(input));
+		if (elementSize == 4) {
+			value = _mm_shufflehi_epi16(_mm_shufflelo_epi16(value, _MM_SHUFFLE(2, 3, 0, 1)), _MM_SHUFFLE(2, 3, 0, 1));
+		} else if (elementSize == 8) {
+			value = _mm_shufflehi_epi16(_mm_shufflelo_epi16(value, _MM_SHUFFLE(0, 1, 2, 3)), _MM_SHUFFLE(0, 1, 2, 3));
+		}
+		value = _mm_or_si128(_mm_slli_epi16(value, 8), _mm_srli_epi16(value, 8));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(output), value);
+	}
+#endif
+	for (; input != end; input += elementSize, output += elementSize) {
+		if (elementSize == 2) {
+			unsigned short value;
+			std::memcpy(&value, input, 2);
+			value = swap16(value);
+			std::memcpy(output, &value, 2);
+		} else if (elementSize == 4) {
+			unsigned int value;
+			std::memcpy(&value, input, 4);
+			value = swap32(value);
+			std::memcpy(output, &value, 4);
+		} else {
+			unsigned __int64 value;
+			std::memcpy(&value, input, 8);
+			value = swap64(value);
+			std::memcpy(output, &value, 8);
+		}
+	}
+}
+
+
+void BinaryWriter::write(const void* buffer, int offset, int count) {
+	assert("Null stream" && _stream);
+	assert("Null buffer" && (buffer || !count));
+	assert("Negative offset" && 0 <= offset);
+	assert("Negative count" && 0 <= count);
+	assert("buffer is bad read pointer" && (!count || !IsBadReadPtr(buffer, offset + count)));
+
+	if (!count) {
+		return;
+	}
+	const unsigned char* source = static_cast<const unsigned char*>(buffer) + offset;
+	if (_end - _current < count) {
+		flushBuffer();
+		if (_bufferSize <= count) { // バッファに入りきらないので直接書く
+			_stream->write(source, 0, count);
+			return;
+		}
+	}
+	std::memcpy(_current, source, count);
+	_current += count;
+}
+
+
+void BinaryWriter::writeDouble(double value) {
+	unsigned __int64 bits;
+	std::memcpy(&bits, &value, sizeof(bits));
+	writeUInt64(bits);
+}
+
+
+void BinaryWriter::writeFloat(float value) {
+	unsigned int bits;
+	std::memcpy(&bits, &value, sizeof(bits));
+	writeUInt32(bits);
+}
+
+
+void BinaryWriter::writeInt16(short value) {
+	writeUInt16(static_cast<unsigned short>(value));
+}
+
+
+void BinaryWriter::writeInt32(int value) {
+	writeUInt32(static_cast<unsigned int>(value));
+}
+
+
+void BinaryWriter::writeInt64(__int64 value) {
+	writeUInt64(static_cast<unsigned __int64>(value));
+}
+
+
+void BinaryWriter::writeString(StringRange value, BinaryWriter::Encoding encoding) {
+	assert("Invalid BinaryWriter::Encoding" && Encoding::_validate(encoding));
+
+	const wchar_t* i = value.c_str();
+	const wchar_t* const end = i + value.length();
+	if (encoding == Encoding::utf16) {
+		writeVarUInt(static_cast<unsigned __int64>(getUtf16Length(value)) * 2);
+		if (sizeof(wchar_t) == 2) {
+			writeElements(i, value.length(), 2);
+			return;
+		}
+		for (; i != end; ++i) {
+			unsigned long code = static_cast<unsigned long>(*i);
+			if (0x10000 <= code) {
+				code -= 0x10000;
+				writeUInt16(static_cast<unsigned short>(0xd800 + (code >> 10)));
+				code = 0xdc00 + (code & 0x3ff);
+			}
+			writeUInt16(static_cast<unsigned short>(code));
+		}
+		return;
+	}
+
+	writeVarUInt(getUtf8Length(value));
+	for (; i != end; ++i) {
+		if (_end - _current < 4) {
+			flushBuffer();
+		}
+		unsigned long code = static_cast<unsigned long>(*i);
+		if (code < 0x80) {
+			*_current++ = static_cast<unsigned char>(code);
+			continue;
+		}
+		if (0xd800 <= code && code < 0xdc00 && i + 1 != end && 0xdc00 <= static_cast<unsigned long>(i[1]) && static_cast<unsigned long>(i[1]) < 0xe000) {
+			code = 0x10000 + ((code - 0xd800) << 10) + (static_cast<unsigned long>(*++i) - 0xdc00);
+		}
+		if (code < 0x800) {
+			*_current++ = static_cast<unsigned char>(0xc0 | (code >> 6));
+		} else {
+			if (code < 0x10000) {
+				*_current++ = static_cast<unsigned char>(0xe0 | (code >> 12));
+			} else {
+				*_current++ = static_cast<unsigned char>(0xf0 | (code >> 18));
+				*_current++ = static_cast<unsigned char>(0x80 | ((code >> 12) & 0x3f));
+			}
+			*_current++ = static_cast<unsigned char>(0x80 | ((code >> 6) & 0x3f));
+		}
+		*_current++ = static_cast<unsigned char>(0x80 | (code & 0x3f));
+	}
+}
+
+
+void BinaryWriter::writeUInt16(unsigned short value) {
+	if (_byteOrder == ByteOrder::bigEndian) { // ホストはリトルエンディアン
+		value = swap16(value);
+	}
+	writeFixed(&value, sizeof(value));
+}
+
+
+void BinaryWriter::writeUInt32(unsigned int value) {
+	if (_byteOrder == ByteOrder::bigEndian) {
+		value = swap32(value);
+	}
+	writeFixed(&value, sizeof(value));
+}
+
+
+void BinaryWriter::writeUInt64(unsigned __int64 value) {
+	if (_byteOrder == ByteOrder::bigEndian) {
+		value = swap64(value);
+	}
+	writeFixed(&value, sizeof(value));
+}
+
+
+void BinaryWriter::writeVarInt(__int64 value) {
+	reserve(10);
+	for (;;) {
+		const unsigned char byte = static_cast<unsigned char>(value & 0x7f);
+		value >>= 7; // 算術シフト
+		if ((value == 0 && !(byte & 0x40)) || (value == -1 && (byte & 0x40))) {
+			*_current++ = byte;
+			break;
+		}
+		*_current++ = byte | 0x80;
+	}
+}
+
+
+void BinaryWriter::writeVarUInt(unsigned __int64 value) {
+	reserve(10);
+	for (; 0x80 <= value; value >>= 7) {
+		*_current++ = static_cast<unsigned char>(value | 0x80);
+	}
+	*_current++ = static_cast<unsigned char>(value);
+}
+
+
+void BinaryWriter::flushBuffer() {
+	const int count = static_cast<int>(_current - _buffer);
+	_current = _buffer; // 書き出しに失敗してもデストラクタで再び投げないように先に空にする
+	if (count) {
+		_stream->write(_buffer, 0, count);
+	}
+}
+
+
+void BinaryWriter::reserve(int count) {
+	assert("Null stream" && _stream);
+	if (_end - _current < count) {
+		flushBuffer();
+	}
+}
+
+
+void BinaryWriter::writeElements(const void* values, int count, int elementSize) {
+	assert("Null stream" && _stream);
+	assert("Null values" && (values || !count));
+
+	if (_byteOrder == ByteOrder::littleEndian || elementSize == 1) {
+		write(values, 0, count * elementSize);
+		return;
+	}
+	const unsigned char* source = static_cast<const unsigned char*>(values);
+	while (count) { // バッファに入る分ずつ変換する
+		int copyCount = min(count, static_cast<int>(_end - _current) / elementSize);
+		if (!copyCount) {
+			flushBuffer();
+			copyCount = min(count, _bufferSize / elementSize);
+		}
+		swapByteOrder(_current, source, copyCount, elementSize);
+		_current += copyCount * elementSize;
+		source += copyCount * elementSize;
+		count -= copyCount;
+	}
+}
+
+
+void BinaryWriter::writeFixed(const void* value, int size) {
+	assert("Null stream" && _stream);
+	if (_end - _current < size) {
+		flushBuffer();
+	}
+	std::memcpy(_current, value, size);
+	_current += size;
+}
+
+
+
+	}
+}
@@ -0,0 +1,123 @@
+﻿#pragma once
+
+#include <balor/io/Stream.hpp>
+#include <balor/ArrayRange.hpp>
+#include <balor/Enum.hpp>
+#include <balor/NonCopyable.hpp>
+#include <balor/StringRange.hpp>
+
+
+namespace balor {
+	namespace io {
+
+
+
+/**
+ * 他のストリームに数値や文字列をバイナリ形式で書き込む。
+ *
+ * 内部のバッファにまとめてから書き込むので、フィールドごとにラップしたストリームの仮想関数を呼ばない。
+ * 固定長の整数と浮動小数点数は byteOrder のバイトオーダーで書き込む。
+ * writeVarUInt, writeVarInt は LEB128 形式の可変長整数を書き込み、小さい値ほど短くなる。
+ * writeString は LEB128 のバイト数に続けて UTF-8 か UTF-16 で文字列を書き込む。UTF-16 の場合は byteOrder に従う。
+ * writeArray は数値の配列をまとめて書き込み、バイトオーダーの変換が必要なら SIMD 命令で変換する。
+ * バッファは flush 関数かデストラクタで書き出される。ラップしたストリームは BinaryWriter より後に破棄すること。
+ * BinaryReader で読み込める。
+ *
+ * <h3>・サンプルコード</h3>
+ * <pre><code>
+	FileStream file(L"scene.bin", FileStream::Mode::create, FileStream::Access::write);
+	BinaryWriter writer(file);
+	writer.writeUInt32(0x4e435342);
+	writer.writeString(L"scene");
+	writer.writeVarUInt(vertices.size());
+	writer.writeArray<float>(vertices);
+ * </code></pre>
+ */
+class BinaryWriter : private NonCopyable {
+public:
+	/// 固定長の数値と UTF-16 のバイトオーダー。
+	struct ByteOrder {
+		enum _enum {
+			littleEndian = 0, /// 下位バイトから並べる。
+			bigEndian    = 1, /// 上位バイトから並べる。
+		};
+		BALOR_NAMED_ENUM_MEMBERS(ByteOrder);
+	};
+
+	/// 文字列の符号化方式。
+	struct Encoding {
+		enum _enum {
+			utf8  = 0, /// UTF-8。
+			utf16 = 1, /// UTF-16。byteOrder に従う。
+		};
+		BALOR_NAMED_ENUM_MEMBERS(Encoding);
+	};
+
+public:
+	/// ラップするストリーム、バイトオーダー、バッファの大きさから作成。
+	explicit BinaryWriter(Stream& stream, BinaryWriter::ByteOrder byteOrder = ByteOrder::littleEndian, int bufferSize = 4096);
+	BinaryWriter(BinaryWriter&& value);
+	/// バッファを書き出す。書き込みに失敗しても例外は投げないので、失敗を知るには破棄する前に flush する。
+	~BinaryWriter();
+
+	BinaryWriter& operator=(BinaryWriter&& value);
+
+public:
+	/// バッファの大きさ。
+	int bufferSize() const;
+	/// 固定長の数値と UTF-16 のバイトオーダー。
+	BinaryWriter::ByteOrder byteOrder() const;
+	void byteOrder(BinaryWriter::ByteOrder value);
+	/// バッファを書き出してからラップしたストリームをフラッシュする。
+	void flush();
+	/// ラップしたストリーム。
+	Stream& stream() const;
+	/// elementSize バイトの要素 count 個のバイト順を反転して destination にコピーする。destination と source は同じでも良い。
+	static void swapByteOrder(void* destination, const void* source, int count, int elementSize);
+	/// バイト列をそのまま書き込む。
+	void write(const void* buffer, int offset, int count);
+	/// 数値の配列をまとめて書き込む。T は 1、2、4、8 バイトの整数か float、double。
+	template<typename T> void writeArray(ArrayRange<const T> values) {
+		static_assert(sizeof(T) == 1 || sizeof(T) == 2 || sizeof(T) == 4 || sizeof(T) == 8, "Unsupported element size");
+		writeElements(values.begin(), values.length(), sizeof(T));
+	}
+	/// １バイト書き込む。バッファに空きがあれば関数を呼ばない。
+	void writeByte(unsigned char value) {
+		if (_current == _end) {
+			flushBuffer();
+		}
+		*_current++ = value;
+	}
+	void writeDouble(double value);
+	void writeFloat(float value);
+	void writeInt16(short value);
+	void writeInt32(int value);
+	void writeInt64(__int64 value);
+	/// LEB128 のバイト数に続けて文字列を書き込む。
+	void writeString(StringRange value, BinaryWriter::Encoding encoding = Encoding::utf8);
+	void writeUInt16(unsigned short value);
+	void writeUInt32(unsigned int value);
+	void writeUInt64(unsigned __int64 value);
+	/// 符号付き LEB128 で書き込む。
+	void writeVarInt(__int64 value);
+	/// 符号無し LEB128 で書き込む。
+	void writeVarUInt(unsigned __int64 value);
+
+private:
+	void flushBuffer();
+	void reserve(int count);
+	void writeElements(const void* values, int count, int elementSize);
+	void writeFixed(const void* value, int size);
+
+	Stream* _stream;
+	unsigned char* _buffer;
+	int _bufferSize;
+	unsigned char* _current; // [_buffer, _current) が書き出し待ちのデータ
+	unsigned char* _end;
+	ByteOrder _byteOrder;
+};
+
+
+
+	}
+}
@@ -0,0 +1,268 @@
+﻿#include "BufferedStream.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <utility>
+
+#include <balor/system/windows.hpp> // IsBadWritePtr, IsBadReadPtrのassertの為だけに必要
+#include <balor/test/verify.hpp>
+
+
+namespace balor {
+	namespace io {
+
+using std::max;
+using std::min;
+using std::move;
+
+
+
+BufferedStream::BufferedStream(Stream& stream, int bufferSize)
+	: _stream(&stream)
+	, _buffer(nullptr)
+	, _bufferSize(bufferSize) {
+	assert("Invalid bufferSize" && 0 < bufferSize);
+
+	_buffer = new unsigned char[bufferSize];
+	_readCurrent = _buffer;
+	_readEnd = _buffer;
+	_writeCurrent = _buffer;
+	_writeEnd = _buffer;
+}
+
+
+BufferedStream::BufferedStream(BufferedStream&& value)
+	: _stream(value._stream)
+	, _buffer(value._buffer)
+	, _bufferSize(value._bufferSize)
+	, _readCurrent(value._readCurrent)
+	, _readEnd(value._readEnd)
+	, _writeCurrent(value._writeCurrent)
+	, _writeEnd(value._writeEnd) {
+	value._stream = nullptr;
+	value._buffer = nullptr;
+	value._readCurrent = nullptr;
+	value._readEnd = nullptr;
+	value._writeCurrent = nullptr;
+	value._writeEnd = nullptr;
+}
+
+
+BufferedStream::~BufferedStream() {
+	if (_stream) {
+		flushWriteBuffer();
+		discardReadBuffer();
+	}
+	delete [] _buffer;
+}
+
+
+BufferedStream& BufferedStream::operator=(BufferedStream&& value) {
+	if (&value != this) {
+		this->~BufferedStream();
+		new (this) BufferedStream(move(value));
+	}
+	return *this;
+}
+
+
+int BufferedStream::bufferSize() const {
+	return _bufferSize;
+}
+
+
+void BufferedStream::flush() {
+	assert("Null stream" && _stream);
+
+	flushWriteBuffer();
+	_stream->flush();
+}
+
+
+__int64 BufferedStream::length() const {
+	assert("Null stream" && _stream);
+
+	const __int64 length = _stream->length();
+	if (_buffer < _writeCurrent) { // 書き出し待ちのデータで伸びるかもしれない
+		return max(length, _stream->position() + (_writeCurrent - _buffer));
+	}
+	return length;
+}
+
+
+__int64 BufferedStream::position() const {
+	assert("Null stream" && _stream);
+
+	return _stream->position() - (_readEnd - _readCurrent) + (_writeCurrent - _buffer);
+}
+
+
+void BufferedStream::position(__int64 value) {
+	assert("Null stream" && _stream);
+	assert("Negative position" && 0 <= value);
+
+	if (_buffer < _readEnd) {
+		const __int64 first = _stream->position() - (_readEnd - _buffer);
+		if (first <= value && value <= first + (_readEnd - _buffer)) { // 読み込みバッファの範囲内
+			_readCurrent = _buffer + (value - first);
+			return;
+		}
+		_readCurrent = _buffer;
+		_readEnd = _buffer;
+	}
+	flushWriteBuffer();
+	_stream->position(value);
+}
+
+
+int BufferedStream::read() {
+	return readByte();
+}
+
+
+int BufferedStream::read(void* buffer, int offset, int count) {
+	assert("Null stream" && _stream);
+	assert("Null buffer" && buffer);
+	assert("Negative offset" && 0 <= offset);
+	assert("Negative count" && 0 <= count);
+	assert("buffer is bad write pointer" && !IsBadWritePtr(buffer, offset + count));
+	assert("read unsupported" && readable());
+
+	unsigned char* destination = static_cast<unsigned char*>(buffer) + offset;
+	const int available = _readEnd - _readCurrent;
+	if (count <= available) {
+		std::memcpy(destination, _readCurrent, count);
+		_readCurrent += count;
+		return count;
+	}
+	flushWriteBuffer();
+	std::memcpy(destination, _readCurrent, available);
+	_readCurrent = _buffer;
+	_readEnd = _buffer;
+	destination += available;
+	count -= available;
+	if (_bufferSize <= count) { // バッファに入りきらないので直接読む
+		return available + _stream->read(destination, 0, count);
+	}
+	_readEnd = _buffer + _stream->read(_buffer, 0, _bufferSize);
+	const int copyCount = min(count, static_cast<int>(_readEnd - _buffer));
+	std::memcpy(destination, _buffer, copyCount);
+	_readCurrent = _buffer + copyCount;
+	return available + copyCount;
+}
+
+
+bool BufferedStream::readable() const {
+	assert("Null stream" && _stream);
+	return _stream->readable();
+}
+
+
+__int64 BufferedStream::skip(__int64 offset) {
+	assert("Null stream" && _stream);
+
+	if (_buffer < _readEnd) {
+		const __int64 newIndex = (_readCurrent - _buffer) + offset;
+		if (0 <= newIndex && newIndex <= _readEnd - _buffer) { // 読み込みバッファの範囲内
+			_readCurrent = _buffer + newIndex;
+			return offset;
+		}
+	}
+	const __int64 oldPosition = position();
+	flushWriteBuffer();
+	const int unreadCount = _readEnd - _readCurrent;
+	_readCurrent = _buffer;
+	_readEnd = _buffer;
+	_stream->skip(offset - unreadCount);
+	return _stream->position() - oldPosition;
+}
+
+
+Stream& BufferedStream::stream() const {
+	assert("Null stream" && _stream);
+	return *_stream;
+}
+
+
+void BufferedStream::write(unsigned char value) {
+	writeByte(value);
+}
+
+
+void BufferedStream::write(const void* buffer, int offset, int count) {
+	assert("Null stream" && _stream);
+	assert("Null buffer" && buffer);
+	assert("Negative offset" && 0 <= offset);
+	assert("Negative count" && 0 <= count);
+	assert("buffer is bad read pointer" && !IsBadReadPtr(buffer, offset + count));
+	assert("write unsupported" && writable());
+
+	const unsigned char* source = static_cast<const unsigned char*>(buffer) + offset;
+	if (count <= _writeEnd - _writeCurrent) {
+		std::memcpy(_writeCurrent, source, count);
+		_writeCurrent += count;
+		return;
+	}
+	discardReadBuffer();
+	flushWriteBuffer();
+	if (_bufferSize <= count) { // バッファに入りきらないので直接書く
+		_stream->write(source, 0, count);
+		return;
+	}
+	std::memcpy(_buffer, source, count);
+	_writeCurrent = _buffer + count;
+	_writeEnd = _buffer + _bufferSize;
+}
+
+
+bool BufferedStream::writable() const {
+	assert("Null stream" && _stream);
+	return _stream->writable();
+}
+
+
+void BufferedStream::discardReadBuffer() {
+	const int unreadCount = _readEnd - _readCurrent;
+	_readCurrent = _buffer;
+	_readEnd = _buffer;
+	if (unreadCount) { // 読み残した分だけ戻す
+		_stream->skip(-unreadCount);
+	}
+}
+
+
+void BufferedStream::flushWriteBuffer() {
+	const int count = _writeCurrent - _buffer;
+	_writeCurrent = _buffer; // 書き出しに失敗してもデストラクタで再び投げないように先に空にする
+	_writeEnd = _buffer;
+	if (count) {
+		_stream->write(_buffer, 0, count);
+	}
+}
+
+
+int BufferedStream::readByteWithFill() {
+	assert("Null stream" && _stream);
+	assert("read unsupported" && readable());
+
+	flushWriteBuffer();
+	_readCurrent = _buffer;
+	_readEnd = _buffer + _stream->read(_buffer, 0, _bufferSize);
+	return _readCurrent < _readEnd ? *_readCurrent++ : -1;
+}
+
+
+void BufferedStream::writeByteWithFlush(unsigned char value) {
+	assert("Null stream" && _stream);
+	assert("write unsupported" && writable());
+
+	discardReadBuffer();
+	flushWriteBuffer();
+	_writeEnd = _buffer + _bufferSize;
+	*_writeCurrent++ = value;
+}
+
+
+
+	}
+}
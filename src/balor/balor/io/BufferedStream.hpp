@@ -0,0 +1,98 @@
+﻿#pragma once
+
+#include <balor/io/Stream.hpp>
+
+
+namespace balor {
+	namespace io {
+
+
+
+/**
+ * 他のストリームをバッファリングして小さな読み書きをまとめるストリーム。
+ *
+ * FileStream に１バイトずつ読み書きするとその度にシステムコールが発生するが、BufferedStream を通せばバッファが空になるか一杯になった時だけになる。
+ * readByte, writeByte 関数は仮想関数を経由せずにインライン展開されるので、バイト単位のパーサーではこちらを使うと良い。
+ * バッファより大きな読み書きはバッファを経由せずに直接ラップしたストリームに対して行う。
+ * 一つのバッファを読み込みと書き込みで共有し、読み込みから書き込みに切り替える時には読み残したバイト数だけラップしたストリームの位置を戻す。
+ * position, skip, length はバッファの中身を考慮した値になり、読み込みバッファの範囲内での移動はラップしたストリームにアクセスしない。
+ * 書き込みバッファは flush 関数かデストラクタで書き出される。デストラクタではラップしたストリームの位置を BufferedStream の position に合わせる。
+ * ラップしたストリームは BufferedStream より後に破棄すること。BufferedStream を使っている間はラップしたストリームを直接操作してはならない。
+ *
+ * <h3>・サンプルコード</h3>
+ * <pre><code>
+	FileStream file(L"data.bin", FileStream::Mode::open, FileStream::Access::read);
+	BufferedStream stream(file);
+	int lineCount = 0;
+	for (int c = stream.readByte(); c != -1; c = stream.readByte()) {
+		if (c == '\n') {
+			++lineCount;
+		}
+	}
+ * </code></pre>
+ */
+class BufferedStream : public Stream {
+public:
+	// オーバーロード関数のオーバーライド用
+	using Stream::read;
+	using Stream::write;
+
+public:
+	/// ラップするストリームとバッファの大きさから作成。
+	explicit BufferedStream(Stream& stream, int bufferSize = 4096);
+	BufferedStream(BufferedStream&& value);
+	/// 書き込みバッファを書き出し、ラップしたストリームの位置を合わせる。
+	virtual ~BufferedStream();
+
+	BufferedStream& operator=(BufferedStream&& value);
+
+public:
+	/// バッファの大きさ。
+	int bufferSize() const;
+	/// 書き込みバッファを書き出してからラップしたストリームをフラッシュする。
+	virtual void flush();
+	virtual __int64 length() const;
+	virtual __int64 position() const;
+	virtual void position(__int64 value);
+	virtual int read();
+	virtual int read(void* buffer, int offset, int count);
+	virtual bool readable() const;
+	/// １バイト読み出して返す。ファイルの終わりに達していたら -1 を返す。バッファにデータがあれば仮想関数を呼ばない。
+	int readByte() {
+		return _readCurrent < _readEnd ? *_readCurrent++ : readByteWithFill();
+	}
+	/// 実際に移動したバイト数を返す。
+	virtual __int64 skip(__int64 offset);
+	/// ラップしたストリーム。
+	Stream& stream() const;
+	virtual void write(unsigned char value);
+	virtual void write(const void* buffer, int offset, int count);
+	virtual bool writable() const;
+	/// １バイト書き込む。バッファに空きがあれば仮想関数を呼ばない。
+	void writeByte(unsigned char value) {
+		if (_writeCurrent < _writeEnd) {
+			*_writeCurrent++ = value;
+		} else {
+			writeByteWithFlush(value);
+		}
+	}
+
+private:
+	void discardReadBuffer();
+	void flushWriteBuffer();
+	int readByteWithFill();
+	void writeByteWithFlush(unsigned char value);
+
+	Stream* _stream;
+	unsigned char* _buffer;
+	int _bufferSize;
+	unsigned char* _readCurrent; // [_buffer, _readEnd) が読み込み済みのデータ
+	unsigned char* _readEnd;
+	unsigned char* _writeCurrent; // [_buffer, _writeCurrent) が書き出し待ちのデータ。書き込み中でなければ _writeEnd == _buffer
+	unsigned char* _writeEnd;
+};
+
+
+
+	}
+}
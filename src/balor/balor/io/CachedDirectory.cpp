@@ -0,0 +1,278 @@
+﻿#include "CachedDirectory.hpp"
+
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+#define BOOST_DATE_TIME_NO_LIB
+#define BOOST_THREAD_NO_LIB
+#include <boost/thread.hpp>
+
+#include <balor/io/DirectoryWalker.hpp>
+#include <balor/test/verify.hpp>
+
+
+namespace balor {
+	namespace io {
+
+using boost::mutex;
+using std::move;
+using std::vector;
+
+
+namespace {
+typedef std::map<std::wstring, File::Info> Index; // パスの順に並ぶので、ディレクトリの下は連続した範囲になる
+typedef DirectoryWatcher::Action Action;
+
+
+const wchar_t separator = L'\\';
+
+
+Index::iterator findChildren(Index& index, const std::wstring& path) { // path の下の最初の要素
+	return index.lower_bound(path + separator);
+}
+
+
+bool isChild(const std::wstring& key, const std::wstring& path) {
+	return path.length() < key.length() && key[path.length()] == separator && key.compare(0, path.length(), path) == 0;
+}
+
+
+void eraseChildren(Index& index, const std::wstring& path) {
+	auto end = findChildren(index, path);
+	auto begin = end;
+	while (end != index.end() && isChild(end->first, path)) {
+		++end;
+	}
+	index.erase(begin, end);
+}
+
+
+void eraseTree(Index& index, const std::wstring& path) {
+	index.erase(path);
+	eraseChildren(index, path);
+}
+
+
+void moveTree(Index& index, const std::wstring& from, const std::wstring& to) { // ディレクトリの下の情報はパスだけを付け替える
+	vector<File::Info> moved;
+	auto found = index.find(from);
+	if (found != index.end()) {
+		moved.push_back(move(found->second));
+		index.erase(found);
+	}
+	auto end = findChildren(index, from);
+	auto begin = end;
+	for (; end != index.end() && isChild(end->first, from); ++end) {
+		moved.push_back(move(end->second));
+	}
+	index.erase(begin, end);
+	eraseTree(index, to);
+	for (auto i = moved.begin(), movedEnd = moved.end(); i != movedEnd; ++i) {
+		const std::wstring path = to + (i->file().path() + from.length());
+		index[path] = File::Info(File(path), i->attributes(), i->length(), i->creationTime(), i->lastAccessTime(), i->lastWriteTime());
+	}
+}
+} // namespace
+
+
+
+CachedDirectory::Update::Update(CachedDirectory& sender, const vector<DirectoryWatcher::Change>& changes, bool rescanned)
+	: EventWithSender<CachedDirectory>(sender), _changes(changes), _rescanned(rescanned) {
+}
+
+
+const vector<DirectoryWatcher::Change>& CachedDirectory::Update::changes() const {
+	return _changes;
+}
+
+
+bool CachedDirectory::Update::rescanned() const {
+	return _rescanned;
+}
+
+
+
+struct CachedDirectory::Impl {
+	Impl(CachedDirectory& owner, bool recursive, Listener<CachedDirectory::Update&>&& onUpdate)
+		: owner(owner)
+		, recursive(recursive)
+		, onUpdate(move(onUpdate))
+		, rescanCount(0) {
+	}
+
+	void scan(const File& directory, Index& result) const { // ディレクトリが無くなっていたら何もしない
+		try {
+			if (recursive) {
+				DirectoryWalker walker(directory);
+				File::Info info;
+				while (walker.next(info)) {
+					const std::wstring path(info.file().path());
+					result[path] = move(info);
+				}
+			} else {
+				const auto infos = File::infos(directory.getFiles());
+				for (auto i = infos.begin(), end = infos.end(); i != end; ++i) {
+					if (i->exists()) {
+						result[i->file().path()] = *i;
+					}
+				}
+			}
+		} catch (File::NotFoundException& ) {
+		}
+	}
+
+	void rescan() {
+		mutex::scoped_lock updateLock(updateMutex);
+		Index newIndex;
+		scan(directory, newIndex);
+		mutex::scoped_lock lock(indexMutex);
+		index.swap(newIndex);
+		++rescanCount;
+	}
+
+	void apply(const vector<DirectoryWatcher::Change>& changes) {
+		mutex::scoped_lock updateLock(updateMutex);
+		vector<File> queries; // 削除以外は変更後の情報を問い合わせ直す
+		{
+			mutex::scoped_lock lock(indexMutex);
+			for (auto i = changes.begin(), end = changes.end(); i != end; ++i) {
+				switch (i->action()) {
+					case Action::removed : eraseTree(index, i->file().path()); break;
+					case Action::renamed : moveTree(index, i->oldFile().path(), i->file().path()); // fall through
+					default              : queries.push_back(i->file()); break;
+				}
+			}
+		}
+		if (queries.empty()) {
+			return;
+		}
+		const auto infos = File::infos(queries);
+		vector<File> newDirectories; // 索引に無かったディレクトリは下を列挙する
+		{
+			mutex::scoped_lock lock(indexMutex);
+			for (int i = 0, end = infos.size(); i < end; ++i) {
+				const std::wstring path(queries[i].path());
+				const File::Info& info = infos[i];
+				if (!info.exists()) { // 通知した後に削除された
+					eraseTree(index, path);
+					continue;
+				}
+				auto found = index.find(path);
+				const bool wasDirectory = found != index.end() && found->second.isDirectory();
+				if (wasDirectory && !info.isDirectory()) {
+					eraseChildren(index, path);
+				}
+				if (recursive && info.isDirectory() && !wasDirectory && !(info.attributes() & File::Attributes::reparsePoint)) {
+					newDirectories.push_back(queries[i]);
+				}
+				index[path] = info;
+			}
+		}
+		for (auto i = newDirectories.begin(), end = newDirectories.end(); i != end; ++i) {
+			Index added;
+			scan(*i, added);
+			mutex::scoped_lock lock(indexMutex);
+			for (auto j = added.begin(), addedEnd = added.end(); j != addedEnd; ++j) {
+				index[j->first] = move(j->second);
+			}
+		}
+	}
+
+	void onChanges(DirectoryWatcher::Changes& e) {
+		if (e.overflowed()) {
+			rescan();
+		} else {
+			apply(e.changes());
+		}
+		Update event(owner, e.changes(), e.overflowed());
+		onUpdate(event);
+	}
+
+	CachedDirectory& owner;
+	File directory;
+	bool recursive;
+	Listener<CachedDirectory::Update&> onUpdate;
+
+	mutex updateMutex; // 索引の更新を一つずつ行う
+	mutable mutex indexMutex; // 以下のメンバを保護する
+	Index index;
+	int rescanCount;
+
+	std::unique_ptr<DirectoryWatcher> watcher;
+};
+
+
+
+CachedDirectory::CachedDirectory(const File& directory, bool recursive, int delay, Listener<CachedDirectory::Update&> onUpdate)
+	: _impl(new Impl(*this, recursive, move(onUpdate))) {
+	assert("Empty directory" && !directory.empty());
+	assert("Negative delay" && 0 <= delay);
+
+	if (!directory.isDirectory()) {
+		throw File::NotFoundException();
+	}
+	_impl->directory = directory.fullPathFile();
+
+	Impl* impl = _impl.get();
+	mutex::scoped_lock updateLock(impl->updateMutex); // 列挙している間の変更は列挙し終わってから反映する
+	impl->watcher.reset(new DirectoryWatcher(impl->directory, recursive, delay, [impl] (DirectoryWatcher::Changes& e) {
+		impl->onChanges(e);
+	}));
+	impl->scan(impl->directory, impl->index);
+}
+
+
+CachedDirectory::~CachedDirectory() {
+	_impl->watcher.reset(); // 監視用のスレッドを先に止める
+}
+
+
+const File& CachedDirectory::directory() const {
+	return _impl->directory;
+}
+
+
+bool CachedDirectory::find(StringRange path, File::Info& info) const {
+	mutex::scoped_lock lock(_impl->indexMutex);
+	auto found = _impl->index.find(std::wstring(path.c_str(), path.length()));
+	if (found == _impl->index.end()) {
+		return false;
+	}
+	info = found->second;
+	return true;
+}
+
+
+vector<File::Info> CachedDirectory::infos() const {
+	vector<File::Info> result;
+	mutex::scoped_lock lock(_impl->indexMutex);
+	result.reserve(_impl->index.size());
+	for (auto i = _impl->index.begin(), end = _impl->index.end(); i != end; ++i) {
+		result.push_back(i->second);
+	}
+	return result;
+}
+
+
+void CachedDirectory::rescan() {
+	_impl->rescan();
+}
+
+
+int CachedDirectory::rescanCount() const {
+	mutex::scoped_lock lock(_impl->indexMutex);
+	return _impl->rescanCount;
+}
+
+
+int CachedDirectory::size() const {
+	mutex::scoped_lock lock(_impl->indexMutex);
+	return _impl->index.size();
+}
+
+
+
+	}
+}
@@ -0,0 +1,84 @@
+﻿#pragma once
+
+#include <memory>
+#include <vector>
+
+#include <balor/io/DirectoryWatcher.hpp>
+#include <balor/io/File.hpp>
+#include <balor/Event.hpp>
+#include <balor/Listener.hpp>
+#include <balor/NonCopyable.hpp>
+#include <balor/StringRange.hpp>
+
+
+namespace balor {
+	namespace io {
+
+
+
+/**
+ * ディレクトリの下のファイルとディレクトリの File::Info をメモリに保持し、DirectoryWatcher の通知で少しずつ更新する。
+ *
+ * 作成時に DirectoryWalker で一度だけ列挙し、その後は変更のあったパスだけを File::infos でまとめて問い合わせ直す。
+ * 新しく作られたディレクトリや移動してきたディレクトリはその下だけを列挙し、名前を変更したディレクトリはその下の情報のパスを付け替える。
+ * 変更を取りこぼした場合に限ってディレクトリ全体を列挙し直す。
+ * 定期的に列挙し直して比較する代わりに使えば、変更の無いディレクトリを何度も列挙しなくて済む。
+ * infos や find は任意のスレッドから呼べる。onUpdate イベントは監視用のスレッドから呼ばれる。
+ *
+ * <h3>・サンプルコード</h3>
+ * <pre><code>
+	CachedDirectory cache(L"assets", true, 100, [&] (CachedDirectory::Update& e) {
+		invokeQueue.push([&] () { // UI のスレッドで一覧を作り直す
+			auto infos = cache.infos();
+			// ...
+		});
+	});
+ * </code></pre>
+ */
+class CachedDirectory : private NonCopyable {
+public:
+	/// 索引を更新した時のイベント。
+	class Update : public EventWithSender<CachedDirectory> {
+	public:
+		Update(CachedDirectory& sender, const std::vector<DirectoryWatcher::Change>& changes, bool rescanned);
+
+	public:
+		/// 索引に反映した変更。
+		const std::vector<DirectoryWatcher::Change>& changes() const;
+		/// 変更を取りこぼしたので全体を列挙し直したかどうか。
+		bool rescanned() const;
+
+	private:
+		const std::vector<DirectoryWatcher::Change>& _changes;
+		bool _rescanned;
+	};
+
+public:
+	/// directory の下を列挙して監視を開始する。recursive が false なら直下だけを保持する。delay は DirectoryWatcher に渡す。
+	CachedDirectory(const File& directory, bool recursive = true, int delay = 100, Listener<CachedDirectory::Update&> onUpdate = Listener<CachedDirectory::Update&>());
+	~CachedDirectory();
+
+public:
+	/// 監視しているディレクトリの絶対パス。
+	const File& directory() const;
+	/// 絶対パスが path の情報を info に取り出す。索引に無ければ false を返す。
+	bool find(StringRange path, File::Info& info) const;
+	/// 索引にある全ての情報をパスの順に並べたコピー。
+	std::vector<File::Info> infos() const;
+	/// ディレクトリ全体を列挙し直して索引を作り直す。
+	void rescan();
+	/// 作成してから全体を列挙し直した回数。
+	int rescanCount() const;
+	/// 索引にある情報の数。
+	int size() const;
+
+private:
+	struct Impl;
+
+	std::unique_ptr<Impl> _impl;
+};
+
+
+
+	}
+}
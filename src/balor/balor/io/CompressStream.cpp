@@ -0,0 +1,470 @@
+﻿#include "CompressStream.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <utility>
+#include <vector>
+
+#include <balor/system/clock.hpp>
+#include <balor/system/TaskScheduler.hpp>
+#include <balor/system/windows.hpp> // IsBadReadPtr の assert
+#include <balor/test/verify.hpp>
+
+
+namespace balor {
+	namespace io {
+
+using std::min;
+using std::move;
+using std::vector;
+using system::detail::getSeconds;
+using system::Task;
+using system::TaskScheduler;
+
+
+namespace {
+const unsigned char headerMagic[] = {'B', 'L', 'Z', '4'};
+const unsigned char trailerMagic[] = {'B', 'L', 'Z', 'I'};
+const unsigned char version = 1;
+const unsigned int uncompressedFlag = 0x80000000; // ブロックの圧縮後のバイト数に立てて、圧縮していないことを表す
+
+// LZ4 のブロック形式のパラメータ
+const int minMatch = 4;
+const int lastLiterals = 5; // 最後の 5 バイトは必ずリテラルにする
+const int matchFindLimit = 12; // 最後の 12 バイトからは一致を探さない
+const int maxDistance = 65535;
+const int hashLog = 12; // ハッシュ表は 16KB で L1 キャッシュに収まる
+const int skipTrigger = 6; // 一致が見つからない回数が 2 の 6 乗を越えるごとに探す間隔を広げる
+
+
+inline unsigned int read32(const unsigned char* pointer) {
+	unsigned int value;
+	std::memcpy(&value, pointer, sizeof(value));
+	return value;
+}
+
+
+inline unsigned int hash(unsigned int value) {
+	return (value * 2654435761U) >> (32 - hashLog);
+}
+
+
+inline unsigned char* writeLength(unsigned char* pointer, int length) { // 15 以上の長さの残りを 255 ずつ書き込む
+	for (; 255 <= length; length -= 255) {
+		*pointer++ = 255;
+	}
+	*pointer++ = static_cast<unsigned char>(length);
+	return pointer;
+}
+
+
+void store32(unsigned char* pointer, unsigned int value) {
+	for (int i = 0; i < 4; ++i) {
+		pointer[i] = static_cast<unsigned char>(value >> (i * 8));
+	}
+}
+
+
+void store64(unsigned char* pointer, unsigned __int64 value) {
+	for (int i = 0; i < 8; ++i) {
+		pointer[i] = static_cast<unsigned char>(value >> (i * 8));
+	}
+}
+} // namespace
+
+
+
+struct CompressStream::Impl {
+	struct Block { // 並行して圧縮する一つのブロックの結果
+		vector<unsigned char> buffer;
+		int length;
+		bool compressed;
+	};
+
+	Impl(Stream& stream, int blockSize, int threadCount)
+		: stream(&stream)
+		, blockSize(blockSize)
+		, threadCount(threadCount)
+		, input(blockSize * threadCount)
+		, inputLength(0)
+		, blocks(threadCount)
+		, originalLength(0)
+		, compressedLength(0)
+		, seconds(0)
+		, finished(false) {
+		for (auto i = blocks.begin(), end = blocks.end(); i != end; ++i) {
+			i->buffer.resize(maxCompressedLength(blockSize));
+		}
+	}
+
+	void write(const void* buffer, int count) {
+		stream->write(buffer, 0, count);
+		compressedLength += count;
+	}
+
+	void compress(Block& block, const unsigned char* source, int length) {
+		block.length = compressBlock(ArrayRange<const unsigned char>(source, length), block.buffer);
+		block.compressed = 0 < block.length && block.length < length;
+	}
+
+	void flushInput() { // たまっているデータを圧縮して書き出す
+		if (!inputLength) {
+			return;
+		}
+		const int count = (inputLength + blockSize - 1) / blockSize;
+		const double start = getSeconds();
+		if (count == 1) {
+			compress(blocks[0], input.data(), inputLength);
+		} else {
+			vector<Task<void> > tasks;
+			tasks.reserve(count - 1);
+			for (int i = 1; i < count; ++i) { // 最初のブロックは自分で圧縮する
+				const unsigned char* source = input.data() + i * blockSize;
+				const int length = min(blockSize, inputLength - i * blockSize);
+				Block* block = &blocks[i];
+				tasks.push_back(TaskScheduler::global().run([this, block, source, length] () {
+					compress(*block, source, length);
+				}));
+			}
+			compress(blocks[0], input.data(), blockSize);
+			for (auto i = tasks.begin(), end = tasks.end(); i != end; ++i) { // ワーカースレッドから呼ばれた場合も get は他のタスクを実行しながら待つのでデッドロックしない
+				i->get();
+			}
+		}
+		seconds += getSeconds() - start;
+
+		for (int i = 0; i < count; ++i) {
+			const Block& block = blocks[i];
+			const int length = min(blockSize, inputLength - i * blockSize);
+			const unsigned char* source = input.data() + i * blockSize;
+			unsigned char header[8];
+			store32(header, block.compressed ? block.length : (length | uncompressedFlag));
+			store32(header + 4, length);
+			index.push_back(std::make_pair(compressedLength, originalLength));
+			const Stream::ConstSlice slices[] = {
+				Stream::ConstSlice(header, 0, sizeof(header)),
+				block.compressed ? Stream::ConstSlice(block.buffer.data(), 0, block.length) : Stream::ConstSlice(source, 0, length),
+			};
+			stream->writev(slices);
+			compressedLength += sizeof(header) + slices[1].count;
+			originalLength += length;
+		}
+		inputLength = 0;
+	}
+
+	Stream* stream;
+	int blockSize;
+	int threadCount;
+	vector<unsigned char> input; // threadCount 個のブロックがたまるまで入れておく
+	int inputLength;
+	vector<Block> blocks;
+	vector<std::pair<__int64, __int64> > index; // ブロックごとのフレームの先頭からのオフセットと圧縮前のオフセット
+	__int64 originalLength; // 書き出したブロックの圧縮前のバイト数
+	__int64 compressedLength;
+	double seconds;
+	bool finished;
+};
+
+
+
+CompressStream::CompressStream(Stream& stream, int blockSize, int threadCount)
+	: _impl(new Impl(stream, blockSize, threadCount)) {
+	assert("Invalid blockSize" && 0 < blockSize);
+	assert("Invalid blockSize" && blockSize <= maxBlockSize);
+	assert("Non positive threadCount" && 0 < threadCount);
+	assert("write unsupported" && stream.writable());
+
+	unsigned char header[12] = {};
+	std::memcpy(header, headerMagic, sizeof(headerMagic));
+	header[4] = version;
+	store32(header + 8, blockSize);
+	_impl->write(header, sizeof(header));
+}
+
+
+CompressStream::CompressStream(CompressStream&& value)
+	: _impl(move(value._impl)) {
+}
+
+
+CompressStream::~CompressStream() {
+	if (_impl && !_impl->finished) {
+		try {
+			finish();
+		} catch (...) {
+		}
+	}
+}
+
+
+CompressStream& CompressStream::operator=(CompressStream&& value) {
+	if (&value != this) {
+		this->~CompressStream();
+		new (this) CompressStream(move(value));
+	}
+	return *this;
+}
+
+
+int CompressStream::blockSize() const {
+	assert("Null stream" && _impl);
+	return _impl->blockSize;
+}
+
+
+int CompressStream::compressBlock(ArrayRange<const unsigned char> source, ArrayRange<unsigned char> destination) {
+	const unsigned char* const base = source.begin();
+	const unsigned char* const end = source.end();
+	const unsigned char* anchor = base; // まだ書き出していないリテラルの先頭
+	unsigned char* output = destination.begin();
+	unsigned char* const outputEnd = destination.end();
+
+	if (matchFindLimit < source.length()) { // 短すぎるデータは全てリテラルにする
+		vector<int> table(1 << hashLog, -(maxDistance + 1)); // ハッシュごとに最後に現れた位置
+		const unsigned char* const matchLimit = end - lastLiterals;
+		const unsigned char* const findLimit = end - matchFindLimit;
+		const unsigned char* current = base;
+		for (;;) {
+			const unsigned char* match = nullptr;
+			int attempts = 1 << skipTrigger;
+			for (;;) { // 4 バイト一致する位置を探す。見つからない間は少しずつ飛ばして探す
+				if (findLimit < current) {
+					break;
+				}
+				const unsigned int value = read32(current);
+				int& entry = table[hash(value)];
+				const int distance = static_cast<int>(current - base) - entry;
+				const int candidate = entry;
+				entry = static_cast<int>(current - base);
+				if (distance <= maxDistance && read32(base + candidate) == value) {
+					match = base + candidate;
+					break;
+				}
+				current += attempts++ >> skipTrigger;
+			}
+			if (!match) { // 残りは全てリテラルにする
+				break;
+			}
+			while (anchor < current && base < match && current[-1] == match[-1]) { // 一致を前に伸ばす
+				--current;
+				--match;
+			}
+			const unsigned char* matchEnd = current + minMatch;
+			const unsigned char* reference = match + minMatch;
+			while (matchEnd + 4 <= matchLimit && read32(matchEnd) == read32(reference)) { // 一致を後ろに伸ばす
+				matchEnd += 4;
+				reference += 4;
+			}
+			while (matchEnd < matchLimit && *matchEnd == *reference) {
+				++matchEnd;
+				++reference;
+			}
+
+			const int literalLength = static_cast<int>(current - anchor);
+			const int matchLength = static_cast<int>(matchEnd - current) - minMatch;
+			if (outputEnd - output < 1 + literalLength / 255 + 1 + literalLength + 2 + matchLength / 255 + 1 + lastLiterals) {
+				return 0;
+			}
+			unsigned char* token = output++;
+			if (15 <= literalLength) {
+				*token = 15 << 4;
+				output = writeLength(output, literalLength - 15);
+			} else {
+				*token = static_cast<unsigned char>(literalLength << 4);
+			}
+			std::memcpy(output, anchor, literalLength);
+			output += literalLength;
+			const int offset = static_cast<int>(current - match);
+			*output++ = static_cast<unsigned char>(offset);
+			*output++ = static_cast<unsigned char>(offset >> 8);
+			if (15 <= matchLength) {
+				*token |= 15;
+				output = writeLength(output, matchLength - 15);
+			} else {
+				*token |= static_cast<unsigned char>(matchLength);
+			}
+			current = matchEnd;
+			anchor = current;
+			if (findLimit < current) {
+				break;
+			}
+			table[hash(read32(current - 2))] = static_cast<int>(current - 2 - base); // 一致の終わりの近くも次の候補にする
+		}
+	}
+
+	const int literalLength = static_cast<int>(end - anchor);
+	if (outputEnd - output < 1 + literalLength / 255 + 1 + literalLength) {
+		return 0;
+	}
+	if (15 <= literalLength) {
+		*output++ = 15 << 4;
+		output = writeLength(output, literalLength - 15);
+	} else {
+		*output++ = static_cast<unsigned char>(literalLength << 4);
+	}
+	if (literalLength) {
+		std::memcpy(output, anchor, literalLength);
+		output += literalLength;
+	}
+	return static_cast<int>(output - destination.begin());
+}
+
+
+__int64 CompressStream::compressedLength() const {
+	assert("Null stream" && _impl);
+	return _impl->compressedLength;
+}
+
+
+void CompressStream::finish() {
+	assert("Null stream" && _impl);
+	assert("Already finished" && !_impl->finished);
+
+	_impl->finished = true; // 書き込みに失敗してもデストラクタで再び書き込まないように先に終える
+	_impl->flushInput();
+	unsigned char terminator[4] = {};
+	_impl->write(terminator, sizeof(terminator));
+
+	const __int64 indexOffset = _impl->compressedLength;
+	vector<unsigned char> index(4 + 8 + _impl->index.size() * 16);
+	store32(index.data(), _impl->index.size());
+	store64(index.data() + 4, _impl->originalLength);
+	unsigned char* entry = index.data() + 12;
+	for (auto i = _impl->index.begin(), end = _impl->index.end(); i != end; ++i, entry += 16) {
+		store64(entry, i->first);
+		store64(entry + 8, i->second);
+	}
+	unsigned char trailer[12];
+	store64(trailer, indexOffset);
+	std::memcpy(trailer + 8, trailerMagic, sizeof(trailerMagic));
+	const Stream::ConstSlice slices[] = {
+		Stream::ConstSlice(index.data(), 0, index.size()),
+		Stream::ConstSlice(trailer, 0, sizeof(trailer)),
+	};
+	_impl->stream->writev(slices);
+	_impl->compressedLength += index.size() + sizeof(trailer);
+	_impl->stream->flush();
+}
+
+
+bool CompressStream::finished() const {
+	assert("Null stream" && _impl);
+	return _impl->finished;
+}
+
+
+void CompressStream::flush() {
+	assert("Null stream" && _impl);
+	assert("Already finished" && !_impl->finished);
+
+	_impl->flushInput();
+	_impl->stream->flush();
+}
+
+
+__int64 CompressStream::length() const {
+	return originalLength();
+}
+
+
+int CompressStream::maxCompressedLength(int length) {
+	assert("Negative length" && 0 <= length);
+	return length + length / 255 + 16;
+}
+
+
+__int64 CompressStream::originalLength() const {
+	assert("Null stream" && _impl);
+	return _impl->originalLength + _impl->inputLength;
+}
+
+
+__int64 CompressStream::position() const {
+	return originalLength();
+}
+
+
+void CompressStream::position(__int64 value) {
+	assert("Can't seek CompressStream" && value == position());
+}
+
+
+int CompressStream::read(void* , int , int ) {
+	assert("read unsupported" && false);
+	return 0;
+}
+
+
+bool CompressStream::readable() const {
+	return false;
+}
+
+
+double CompressStream::ratio() const {
+	assert("Null stream" && _impl);
+	return _impl->originalLength ? static_cast<double>(_impl->compressedLength) / _impl->originalLength : 0;
+}
+
+
+double CompressStream::seconds() const {
+	assert("Null stream" && _impl);
+	return _impl->seconds;
+}
+
+
+__int64 CompressStream::skip(__int64 offset) {
+	assert("Can't seek CompressStream" && !offset);
+	return 0;
+}
+
+
+Stream& CompressStream::stream() const {
+	assert("Null stream" && _impl);
+	return *_impl->stream;
+}
+
+
+int CompressStream::threadCount() const {
+	assert("Null stream" && _impl);
+	return _impl->threadCount;
+}
+
+
+double CompressStream::throughput() const {
+	assert("Null stream" && _impl);
+	return 0 < _impl->seconds ? _impl->originalLength / _impl->seconds : 0;
+}
+
+
+void CompressStream::write(const void* buffer, int offset, int count) {
+	assert("Null stream" && _impl);
+	assert("Null buffer" && buffer);
+	assert("Negative offset" && 0 <= offset);
+	assert("Negative count" && 0 <= count);
+	assert("buffer is bad read pointer" && !IsBadReadPtr(buffer, offset + count));
+	assert("Already finished" && !_impl->finished);
+
+	const unsigned char* source = static_cast<const unsigned char*>(buffer) + offset;
+	const int capacity = _impl->input.size();
+	while (count) {
+		const int copyCount = min(count, capacity - _impl->inputLength);
+		std::memcpy(_impl->input.data() + _impl->inputLength, source, copyCount);
+		_impl->inputLength += copyCount;
+		source += copyCount;
+		count -= copyCount;
+		if (_impl->inputLength == capacity) {
+			_impl->flushInput();
+		}
+	}
+}
+
+
+bool CompressStream::writable() const {
+	assert("Null stream" && _impl);
+	return !_impl->finished;
+}
+
+
+
+	}
+}
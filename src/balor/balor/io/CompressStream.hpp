@@ -0,0 +1,111 @@
+﻿#pragma once
+
+#include <memory>
+
+#include <balor/io/Stream.hpp>
+#include <balor/ArrayRange.hpp>
+
+
+namespace balor {
+	namespace io {
+
+
+
+/**
+ * 書き込んだデータを LZ4 形式のブロック圧縮で圧縮して他のストリームに書き込むストリーム。
+ *
+ * データを blockSize バイトずつのブロックに分けて互いに独立に圧縮するので、threadCount 個のブロックを TaskScheduler::global() で並行して圧縮できる。
+ * 圧縮しても小さくならないブロックはそのまま書き込む。圧縮、展開とも LZ4 と同程度に速く、ディスクやネットワークの帯域が足りない場合に向く。
+ * finish 関数かデストラクタで最後のブロック、ブロックの索引、終端を書き込む。索引があれば DecompressStream で任意の位置から展開できる。
+ * flush 関数は書き込み途中のブロックを短いブロックとして書き出すので、頻繁に呼ぶと圧縮率が下がる。
+ * originalLength, compressedLength, ratio, throughput 関数で圧縮率と速さを確認できる。
+ * ラップしたストリームは CompressStream より後に破棄すること。
+ *
+ * フォーマットは全てリトルエンディアンで、以下の順に並ぶ。オフセットはフレームの先頭からのバイト数。
+ * <pre>
+ * ヘッダ   : "BLZ4"、バージョン (1 バイト)、予約 (3 バイト)、blockSize (4 バイト)
+ * ブロック : 圧縮後のバイト数 (4 バイト。最上位ビットが立っていれば圧縮していない)、圧縮前のバイト数 (4 バイト)、データ
+ * 終端     : 0 (4 バイト)
+ * 索引     : ブロック数 (4 バイト)、圧縮前の全体のバイト数 (8 バイト)、ブロックごとにブロックのオフセット (8 バイト) と圧縮前のオフセット (8 バイト)
+ * 末尾     : 索引のオフセット (8 バイト)、"BLZI"
+ * </pre>
+ *
+ * <h3>・サンプルコード</h3>
+ * <pre><code>
+	FileStream file(L"snapshot.blz", FileStream::Mode::create, FileStream::Access::write);
+	CompressStream stream(file, CompressStream::defaultBlockSize, 4);
+	memoryStream.position(0);
+	memoryStream.copyTo(stream);
+	stream.finish();
+	Debug::writeLine(String() + L"ratio " + stream.ratio() + L", " + stream.throughput() / (1024 * 1024) + L"MB/s");
+ * </code></pre>
+ */
+class CompressStream : public Stream {
+public:
+	// オーバーロード関数のオーバーライド用
+	using Stream::read;
+	using Stream::write;
+
+	/// 既定のブロックのバイト数。
+	static const int defaultBlockSize = 64 * 1024;
+	/// ブロックの最大のバイト数。
+	static const int maxBlockSize = 4 * 1024 * 1024;
+
+public:
+	/// ラップするストリーム、ブロックのバイト数、並行して圧縮するブロックの数から作成し、ヘッダを書き込む。
+	explicit CompressStream(Stream& stream, int blockSize = defaultBlockSize, int threadCount = 1);
+	CompressStream(CompressStream&& value);
+	/// finish していなければ finish する。書き込みに失敗しても例外は投げない。
+	virtual ~CompressStream();
+
+	CompressStream& operator=(CompressStream&& value);
+
+public:
+	/// ブロックのバイト数。
+	int blockSize() const;
+	/// source を LZ4 のブロック形式で destination に圧縮し、圧縮後のバイト数を返す。destination に入りきらなければ 0 を返す。
+	static int compressBlock(ArrayRange<const unsigned char> source, ArrayRange<unsigned char> destination);
+	/// ラップしたストリームに書き込んだバイト数。
+	__int64 compressedLength() const;
+	/// 残りのデータと索引を書き込んで圧縮を終える。以降は書き込めない。
+	void finish();
+	/// 圧縮を終えたかどうか。
+	bool finished() const;
+	/// 書き込み途中のブロックを書き出してからラップしたストリームをフラッシュする。
+	virtual void flush();
+	/// 書き込んだ圧縮前のバイト数。
+	virtual __int64 length() const;
+	/// compressBlock の destination に必要な最大のバイト数。
+	static int maxCompressedLength(int length);
+	/// 書き込んだ圧縮前のバイト数。
+	__int64 originalLength() const;
+	virtual __int64 position() const;
+	/// 現在位置にしか移動できない。
+	virtual void position(__int64 value);
+	virtual int read(void* buffer, int offset, int count);
+	virtual bool readable() const;
+	/// 圧縮後のバイト数 ÷ 圧縮前のバイト数。0.25 なら 4 分の 1 になった。ヘッダと索引も含む。
+	double ratio() const;
+	/// 圧縮にかかった秒数。並行して圧縮した場合は経過時間。
+	double seconds() const;
+	/// 0 以外には移動できない。
+	virtual __int64 skip(__int64 offset);
+	/// ラップしたストリーム。
+	Stream& stream() const;
+	/// 並行して圧縮するブロックの数。
+	int threadCount() const;
+	/// 一秒当たりに圧縮した圧縮前のバイト数。
+	double throughput() const;
+	virtual void write(const void* buffer, int offset, int count);
+	virtual bool writable() const;
+
+private:
+	struct Impl;
+
+	std::unique_ptr<Impl> _impl;
+};
+
+
+
+	}
+}
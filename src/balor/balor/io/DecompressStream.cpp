@@ -0,0 +1,457 @@
+﻿#include "DecompressStream.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <utility>
+#include <vector>
+
+#include <balor/io/CompressStream.hpp>
+#include <balor/system/clock.hpp>
+#include <balor/system/windows.hpp> // IsBadWritePtr の assert
+#include <balor/test/verify.hpp>
+
+
+namespace balor {
+	namespace io {
+
+using std::min;
+using std::move;
+using std::vector;
+using system::detail::getSeconds;
+
+
+namespace {
+const unsigned char headerMagic[] = {'B', 'L', 'Z', '4'};
+const unsigned char trailerMagic[] = {'B', 'L', 'Z', 'I'};
+const unsigned char version = 1;
+const unsigned int uncompressedFlag = 0x80000000;
+const int headerSize = 12;
+const int trailerSize = 12;
+const int minMatch = 4;
+
+
+unsigned int load32(const unsigned char* pointer) {
+	return pointer[0] | (pointer[1] << 8) | (pointer[2] << 16) | (static_cast<unsigned int>(pointer[3]) << 24);
+}
+
+
+__int64 load64(const unsigned char* pointer) {
+	return static_cast<__int64>(load32(pointer)) | (static_cast<__int64>(load32(pointer + 4)) << 32);
+}
+
+
+inline bool readLength(const unsigned char*& current, const unsigned char* end, size_t& length) { // 15 以上の長さの残りを読む。データが足りなければ false を返す
+	unsigned char value;
+	do {
+		if (current == end) {
+			return false;
+		}
+		value = *current++;
+		length += value;
+	} while (value == 255);
+	return true;
+}
+} // namespace
+
+
+
+struct DecompressStream::Impl {
+	Impl(Stream& stream)
+		: stream(&stream)
+		, blockSize(0)
+		, indexed(false)
+		, frameStart(0)
+		, totalLength(0)
+		, blockPosition(0)
+		, blockLength(0)
+		, cursor(0)
+		, ended(false)
+		, compressedLength(0)
+		, originalLength(0)
+		, seconds(0) {
+	}
+
+	void readExactly(void* buffer, int count) {
+		char* destination = static_cast<char*>(buffer);
+		while (count) {
+			const int result = stream->read(destination, 0, count);
+			if (!result) { // 途中で終わっている
+				throw FormatException();
+			}
+			destination += result;
+			count -= result;
+		}
+		compressedLength += destination - static_cast<char*>(buffer);
+	}
+
+	bool loadBlock() { // 次のブロックを展開する。終端に達していたら false を返す
+		blockPosition += blockLength;
+		blockLength = 0;
+		cursor = 0;
+		unsigned char header[8];
+		readExactly(header, 4);
+		const unsigned int size = load32(header);
+		if (!size) {
+			ended = true;
+			return false;
+		}
+		readExactly(header + 4, 4);
+		const int length = static_cast<int>(load32(header + 4));
+		const bool compressed = !(size & uncompressedFlag);
+		const int storedLength = static_cast<int>(size & ~uncompressedFlag);
+		if (length <= 0 || blockSize < length || (!compressed && storedLength != length) || CompressStream::maxCompressedLength(blockSize) < storedLength) {
+			throw FormatException();
+		}
+		if (compressed) {
+			readExactly(source.data(), storedLength);
+			const double start = getSeconds();
+			decompressBlock(ArrayRange<const unsigned char>(source.data(), storedLength), ArrayRange<unsigned char>(block.data(), length));
+			seconds += getSeconds() - start;
+		} else {
+			readExactly(block.data(), length);
+		}
+		blockLength = length;
+		originalLength += length;
+		return true;
+	}
+
+	void seek(__int64 value) { // 索引を使って value を含むブロックを展開する
+		if (blockPosition <= value && value < blockPosition + blockLength) {
+			cursor = static_cast<int>(value - blockPosition);
+			return;
+		}
+		if (value == totalLength) { // 終わりに移動する
+			blockPosition = totalLength;
+			blockLength = 0;
+			cursor = 0;
+			ended = true;
+			return;
+		}
+		auto found = std::upper_bound(index.begin(), index.end(), value, [&] (__int64 lhs, const std::pair<__int64, __int64>& rhs) {
+			return lhs < rhs.second;
+		}) - 1;
+		stream->position(frameStart + found->first);
+		blockPosition = found->second;
+		blockLength = 0;
+		ended = false;
+		if (!loadBlock() || blockLength <= value - blockPosition) { // 索引とブロックが食い違っている
+			throw FormatException();
+		}
+		cursor = static_cast<int>(value - blockPosition);
+	}
+
+	__int64 skipForward(__int64 offset) { // 展開して読み飛ばし、実際に移動したバイト数を返す
+		__int64 remaining = offset;
+		while (remaining) {
+			if (cursor == blockLength && (ended || !loadBlock())) {
+				break;
+			}
+			const int count = static_cast<int>(min(remaining, static_cast<__int64>(blockLength - cursor)));
+			cursor += count;
+			remaining -= count;
+		}
+		return offset - remaining;
+	}
+
+	Stream* stream;
+	int blockSize;
+	bool indexed;
+	__int64 frameStart; // 索引を読み込んだ場合のフレームの先頭のストリームの位置
+	vector<std::pair<__int64, __int64> > index; // ブロックごとのフレームの先頭からのオフセットと圧縮前のオフセット
+	__int64 totalLength;
+	vector<unsigned char> source; // 圧縮されたブロック
+	vector<unsigned char> block; // 展開したブロック
+	__int64 blockPosition; // 展開したブロックの圧縮前のオフセット
+	int blockLength;
+	int cursor; // 展開したブロックの中の現在位置
+	bool ended;
+	__int64 compressedLength;
+	__int64 originalLength;
+	double seconds;
+};
+
+
+
+DecompressStream::DecompressStream(Stream& stream, bool loadIndex)
+	: _impl(new Impl(stream)) {
+	assert("read unsupported" && stream.readable());
+
+	Impl& impl = *_impl;
+	if (loadIndex) {
+		impl.frameStart = stream.position();
+	}
+	unsigned char header[headerSize];
+	impl.readExactly(header, headerSize);
+	if (std::memcmp(header, headerMagic, sizeof(headerMagic)) != 0 || header[4] != version) {
+		throw FormatException();
+	}
+	impl.blockSize = static_cast<int>(load32(header + 8));
+	if (impl.blockSize <= 0 || CompressStream::maxBlockSize < impl.blockSize) {
+		throw FormatException();
+	}
+	impl.source.resize(CompressStream::maxCompressedLength(impl.blockSize));
+	impl.block.resize(impl.blockSize);
+
+	if (loadIndex) {
+		const __int64 frameLength = stream.length() - impl.frameStart;
+		if (frameLength < headerSize + 4 + 12 + trailerSize) {
+			throw FormatException();
+		}
+		unsigned char trailer[trailerSize];
+		stream.position(impl.frameStart + frameLength - trailerSize);
+		impl.readExactly(trailer, trailerSize);
+		const __int64 indexOffset = load64(trailer);
+		if (std::memcmp(trailer + 8, trailerMagic, sizeof(trailerMagic)) != 0 || indexOffset < headerSize + 4 || frameLength - trailerSize - 12 < indexOffset) {
+			throw FormatException();
+		}
+		stream.position(impl.frameStart + indexOffset);
+		unsigned char indexHeader[12];
+		impl.readExactly(indexHeader, sizeof(indexHeader));
+		const int count = static_cast<int>(load32(indexHeader));
+		impl.totalLength = load64(indexHeader + 4);
+		if (count < 0 || (frameLength - trailerSize - indexOffset - 12) != static_cast<__int64>(count) * 16) {
+			throw FormatException();
+		}
+		vector<unsigned char> entries(count * 16);
+		if (count) {
+			impl.readExactly(entries.data(), entries.size());
+		}
+		impl.index.reserve(count);
+		for (int i = 0; i < count; ++i) { // オフセットは増え続けなければならない
+			const __int64 compressedOffset = load64(entries.data() + i * 16);
+			const __int64 originalOffset = load64(entries.data() + i * 16 + 8);
+			const bool valid = i ? (impl.index.back().first < compressedOffset && impl.index.back().second < originalOffset) : (compressedOffset == headerSize && originalOffset == 0);
+			if (!valid || indexOffset <= compressedOffset || impl.totalLength <= originalOffset) {
+				throw FormatException();
+			}
+			impl.index.push_back(std::make_pair(compressedOffset, originalOffset));
+		}
+		if (!count && impl.totalLength) {
+			throw FormatException();
+		}
+		stream.position(impl.frameStart + headerSize);
+		impl.indexed = true;
+		impl.compressedLength = headerSize;
+	}
+}
+
+
+DecompressStream::DecompressStream(DecompressStream&& value)
+	: _impl(move(value._impl)) {
+}
+
+
+DecompressStream::~DecompressStream() {
+}
+
+
+DecompressStream& DecompressStream::operator=(DecompressStream&& value) {
+	if (&value != this) {
+		_impl = move(value._impl);
+	}
+	return *this;
+}
+
+
+int DecompressStream::blockCount() const {
+	assert("Null stream" && _impl);
+	assert("Not indexed" && _impl->indexed);
+	return static_cast<int>(_impl->index.size());
+}
+
+
+int DecompressStream::blockSize() const {
+	assert("Null stream" && _impl);
+	return _impl->blockSize;
+}
+
+
+__int64 DecompressStream::compressedLength() const {
+	assert("Null stream" && _impl);
+	return _impl->compressedLength;
+}
+
+
+void DecompressStream::decompressBlock(ArrayRange<const unsigned char> source, ArrayRange<unsigned char> destination) {
+	const unsigned char* current = source.begin();
+	const unsigned char* const end = source.end();
+	unsigned char* const outputBegin = destination.begin();
+	unsigned char* output = outputBegin;
+	unsigned char* const outputEnd = destination.end();
+	for (;;) {
+		if (current == end) {
+			throw FormatException();
+		}
+		const unsigned char token = *current++;
+		size_t literalLength = token >> 4;
+		if (literalLength == 15 && !readLength(current, end, literalLength)) {
+			throw FormatException();
+		}
+		if (static_cast<size_t>(end - current) < literalLength || static_cast<size_t>(outputEnd - output) < literalLength) {
+			throw FormatException();
+		}
+		if (literalLength <= 16 && 16 <= end - current && 16 <= outputEnd - output) { // 余裕があれば固定長でコピーする
+			std::memcpy(output, current, 16);
+			output += literalLength;
+			current += literalLength;
+		} else if (literalLength) {
+			std::memcpy(output, current, literalLength);
+			output += literalLength;
+			current += literalLength;
+		}
+		if (current == end) { // 最後のシーケンスはリテラルだけ
+			break;
+		}
+
+		if (end - current < 2) {
+			throw FormatException();
+		}
+		const size_t offset = current[0] | (current[1] << 8);
+		current += 2;
+		size_t matchLength = token & 15;
+		if (matchLength == 15 && !readLength(current, end, matchLength)) {
+			throw FormatException();
+		}
+		matchLength += minMatch;
+		if (!offset || static_cast<size_t>(output - outputBegin) < offset || static_cast<size_t>(outputEnd - output) < matchLength) {
+			throw FormatException();
+		}
+		const unsigned char* match = output - offset;
+		if (8 <= offset && matchLength + 8 <= static_cast<size_t>(outputEnd - output)) { // 8 バイトずつはみ出してコピーする
+			unsigned char* const matchEnd = output + matchLength;
+			do {
+				std::memcpy(output, match, 8);
+				output += 8;
+				match += 8;
+			} while (output < matchEnd);
+			output = matchEnd;
+		} else if (matchLength <= offset) {
+			std::memcpy(output, match, matchLength);
+			output += matchLength;
+		} else { // 自分自身と重なるので前から順にコピーする
+			for (unsigned char* matchEnd = output + matchLength; output < matchEnd; ) {
+				*output++ = *match++;
+			}
+		}
+	}
+	if (output != outputEnd) {
+		throw FormatException();
+	}
+}
+
+
+void DecompressStream::flush() {
+}
+
+
+bool DecompressStream::indexed() const {
+	assert("Null stream" && _impl);
+	return _impl->indexed;
+}
+
+
+__int64 DecompressStream::length() const {
+	assert("Null stream" && _impl);
+	assert("Not indexed" && _impl->indexed);
+	return _impl->totalLength;
+}
+
+
+__int64 DecompressStream::originalLength() const {
+	assert("Null stream" && _impl);
+	return _impl->originalLength;
+}
+
+
+__int64 DecompressStream::position() const {
+	assert("Null stream" && _impl);
+	return _impl->blockPosition + _impl->cursor;
+}
+
+
+void DecompressStream::position(__int64 value) {
+	assert("Null stream" && _impl);
+	assert("Negative position" && 0 <= value);
+
+	if (_impl->indexed) {
+		assert("position out of range" && value <= _impl->totalLength);
+		_impl->seek(value);
+	} else {
+		assert("Can't seek backward without index" && position() <= value);
+		_impl->skipForward(value - position());
+	}
+}
+
+
+int DecompressStream::read(void* buffer, int offset, int count) {
+	assert("Null stream" && _impl);
+	assert("Null buffer" && buffer);
+	assert("Negative offset" && 0 <= offset);
+	assert("Negative count" && 0 <= count);
+	assert("buffer is bad write pointer" && !IsBadWritePtr(buffer, offset + count));
+
+	Impl& impl = *_impl;
+	unsigned char* destination = static_cast<unsigned char*>(buffer) + offset;
+	int result = 0;
+	while (result < count) {
+		if (impl.cursor == impl.blockLength && (impl.ended || !impl.loadBlock())) {
+			break;
+		}
+		const int copyCount = min(count - result, impl.blockLength - impl.cursor);
+		std::memcpy(destination + result, impl.block.data() + impl.cursor, copyCount);
+		impl.cursor += copyCount;
+		result += copyCount;
+	}
+	return result;
+}
+
+
+bool DecompressStream::readable() const {
+	return true;
+}
+
+
+double DecompressStream::seconds() const {
+	assert("Null stream" && _impl);
+	return _impl->seconds;
+}
+
+
+__int64 DecompressStream::skip(__int64 offset) {
+	assert("Null stream" && _impl);
+
+	const __int64 oldPosition = position();
+	if (_impl->indexed) {
+		position(std::max(static_cast<__int64>(0), std::min(oldPosition + offset, _impl->totalLength)));
+		return position() - oldPosition;
+	}
+	assert("Can't seek backward without index" && 0 <= offset);
+	return _impl->skipForward(offset);
+}
+
+
+Stream& DecompressStream::stream() const {
+	assert("Null stream" && _impl);
+	return *_impl->stream;
+}
+
+
+double DecompressStream::throughput() const {
+	assert("Null stream" && _impl);
+	return 0 < _impl->seconds ? _impl->originalLength / _impl->seconds : 0;
+}
+
+
+void DecompressStream::write(const void* , int , int ) {
+	assert("write unsupported" && false);
+}
+
+
+bool DecompressStream::writable() const {
+	return false;
+}
+
+
+
+	}
+}
@@ -0,0 +1,92 @@
+﻿#pragma once
+
+#include <memory>
+
+#include <balor/io/Stream.hpp>
+#include <balor/ArrayRange.hpp>
+#include <balor/Exception.hpp>
+
+
+namespace balor {
+	namespace io {
+
+
+
+/**
+ * CompressStream で圧縮したデータを他のストリームから読み込んで展開するストリーム。
+ *
+ * ブロックを一つずつ読み込んで展開する。フォーマットは CompressStream を参照。
+ * loadIndex が true の場合は作成時にストリームの終わりからブロックの索引を読み込み、position や skip で任意の位置に移動できる。
+ * 移動先のブロックだけを展開するので、大きなデータの一部だけを読む場合も先頭から展開し直さなくて良い。
+ * 索引を読み込まない場合はシークできないストリームからも読み込めるが、前にしか移動できず、移動先まで展開して読み飛ばす。
+ * originalLength, compressedLength, throughput 関数で展開した量と速さを確認できる。
+ * ラップしたストリームは DecompressStream より後に破棄すること。
+ *
+ * <h3>・サンプルコード</h3>
+ * <pre><code>
+	FileStream file(L"snapshot.blz", FileStream::Mode::open, FileStream::Access::read);
+	DecompressStream stream(file);
+	stream.position(stream.length() / 2); // 真ん中のブロックだけを展開する
+	char buffer[256];
+	stream.read(buffer, 0, sizeof(buffer));
+ * </code></pre>
+ */
+class DecompressStream : public Stream {
+public:
+	// オーバーロード関数のオーバーライド用
+	using Stream::read;
+	using Stream::write;
+
+	/// 圧縮データの形式が正しくなかった。
+	class FormatException : public Exception {};
+
+public:
+	/// ラップするストリームから作成してヘッダを読み込む。loadIndex が true ならストリームの終わりから索引も読み込む。圧縮データはストリームの終わりまで続いていなければならない。
+	explicit DecompressStream(Stream& stream, bool loadIndex = true);
+	DecompressStream(DecompressStream&& value);
+	virtual ~DecompressStream();
+
+	DecompressStream& operator=(DecompressStream&& value);
+
+public:
+	/// ブロックの数。索引を読み込んだ場合だけ使える。
+	int blockCount() const;
+	/// CompressStream が書き込んだブロックのバイト数。
+	int blockSize() const;
+	/// ラップしたストリームから読み込んだ圧縮データのバイト数。
+	__int64 compressedLength() const;
+	/// LZ4 のブロック形式の source を destination に展開する。destination の大きさが展開後のバイト数と一致しなければ FormatException を投げる。
+	static void decompressBlock(ArrayRange<const unsigned char> source, ArrayRange<unsigned char> destination);
+	virtual void flush();
+	/// 索引を読み込んだかどうか。
+	bool indexed() const;
+	/// 展開後の全体のバイト数。索引を読み込んだ場合だけ使える。
+	virtual __int64 length() const;
+	/// 展開したバイト数。
+	__int64 originalLength() const;
+	virtual __int64 position() const;
+	/// 索引を読み込んでいない場合は前にしか移動できない。
+	virtual void position(__int64 value);
+	virtual int read(void* buffer, int offset, int count);
+	virtual bool readable() const;
+	/// 展開にかかった秒数。
+	double seconds() const;
+	/// 実際に移動したバイト数を返す。索引を読み込んでいない場合は前にしか移動できない。
+	virtual __int64 skip(__int64 offset);
+	/// ラップしたストリーム。
+	Stream& stream() const;
+	/// 一秒当たりに展開したバイト数。
+	double throughput() const;
+	virtual void write(const void* buffer, int offset, int count);
+	virtual bool writable() const;
+
+private:
+	struct Impl;
+
+	std::unique_ptr<Impl> _impl;
+};
+
+
+
+	}
+}
@@ -0,0 +1,334 @@
+﻿#include "DirectoryWalker.hpp"
+
+#include <algorithm>
+#include <deque>
+#include <exception>
+#include <string>
+#include <utility>
+#include <vector>
+
+#define BOOST_DATE_TIME_NO_LIB
+#define BOOST_THREAD_NO_LIB
+#include <boost/thread.hpp>
+
+#include <Shlwapi.h>
+#pragma comment (lib,"Shlwapi.lib")
+
+#include <balor/io/LongPath.hpp>
+#include <balor/system/windows.hpp>
+#include <balor/test/verify.hpp>
+#include <balor/scopeExit.hpp>
+#include <balor/String.hpp>
+
+
+namespace balor {
+	namespace io {
+
+using boost::condition_variable;
+using boost::mutex;
+using boost::thread;
+using std::deque;
+using std::move;
+using std::unique_ptr;
+using std::vector;
+using detail::LongPath;
+
+
+namespace {
+const int batchSize = 64; // スレッドがまとめて結果のキューに入れる数。ロックの回数を減らす
+
+
+const FINDEX_INFO_LEVELS findExInfoBasic = static_cast<FINDEX_INFO_LEVELS>(1); // FindExInfoBasic。_WIN32_WINNT が Windows 7 未満だと定義されない
+const DWORD findFirstExLargeFetch = 2; // FIND_FIRST_EX_LARGE_FETCH
+
+
+void checkError(DWORD errorCode) { // 下を列挙しないで続ける場合は何もしない
+	switch (errorCode) {
+		case ERROR_ACCESS_DENIED  : // アクセス権がない
+		case ERROR_FILE_NOT_FOUND : // 列挙中に削除された
+		case ERROR_PATH_NOT_FOUND : break;
+		case ERROR_INVALID_NAME   : throw File::InvalidPathException();
+		default                   : assert("Failed to FindFirstFileExW" && false);
+	}
+}
+
+
+__int64 toInt64(const FILETIME& time) {
+	return (static_cast<__int64>(time.dwHighDateTime) << 32) | time.dwLowDateTime;
+}
+} // namespace
+
+
+
+struct DirectoryWalker::Impl {
+	struct Worker {
+		mutex directoriesMutex;
+		deque<File> directories; // 自分は後ろから取り出し、他のスレッドは前から盗む
+	};
+
+	Impl(StringRange pattern, const DirectoryWalker::Filter& filter, int queueCapacity)
+		: pattern(pattern.c_str(), pattern.length())
+		, matchAll(String::equals(pattern, L"*"))
+		, filter(filter)
+		, queueCapacity(queueCapacity)
+		, queuedCount(0)
+		, pendingCount(0)
+		, runningCount(0)
+		, canceled(false) {
+	}
+
+	bool match(const wchar_t* name) const {
+		return matchAll || PathMatchSpecW(name, pattern.c_str()) != FALSE;
+	}
+
+	void push(int index, const File& directory) {
+		Worker& worker = *workers[index];
+		{
+			mutex::scoped_lock lock(worker.directoriesMutex);
+			worker.directories.push_back(directory);
+		}
+		mutex::scoped_lock lock(stateMutex);
+		++queuedCount;
+		++pendingCount;
+		workAdded.notify_one();
+	}
+
+	bool take(int index, File& directory) {
+		const int count = workers.size();
+		for (;;) {
+			for (int i = 0; i < count; ++i) { // 自分のキューが空なら隣から順に盗む
+				Worker& worker = *workers[(index + i) % count];
+				mutex::scoped_lock lock(worker.directoriesMutex);
+				if (!worker.directories.empty()) {
+					if (i == 0) {
+						directory = move(worker.directories.back());
+						worker.directories.pop_back();
+					} else {
+						directory = move(worker.directories.front());
+						worker.directories.pop_front();
+					}
+					lock.unlock();
+					mutex::scoped_lock stateLock(stateMutex);
+					--queuedCount;
+					return true;
+				}
+			}
+			mutex::scoped_lock lock(stateMutex);
+			while (!canceled && pendingCount && !queuedCount) {
+				workAdded.wait(lock);
+			}
+			if (canceled || !pendingCount) {
+				return false;
+			}
+		}
+	}
+
+	void finish() {
+		mutex::scoped_lock lock(stateMutex);
+		if (!--pendingCount) {
+			workAdded.notify_all();
+		}
+	}
+
+	bool flush(vector<File::Info>& batch) { // 中止されていたら false を返す
+		mutex::scoped_lock lock(stateMutex);
+		for (auto i = batch.begin(), end = batch.end(); i != end; ++i) {
+			while (!canceled && queueCapacity <= static_cast<int>(results.size())) {
+				resultsRemoved.wait(lock);
+			}
+			if (canceled) {
+				batch.clear();
+				return false;
+			}
+			results.push_back(move(*i));
+			resultsAdded.notify_one();
+		}
+		batch.clear();
+		return true;
+	}
+
+	bool add(int index, const File::Info& info, const wchar_t* name, vector<File::Info>& batch) { // 中止されていたら false を返す
+		if (info.isDirectory()) {
+			if (filter && !filter(info)) {
+				return true;
+			}
+			if (!(info.attributes() & File::Attributes::reparsePoint)) {
+				push(index, info.file());
+			}
+			if (!match(name)) {
+				return true;
+			}
+		} else if (!match(name) || (filter && !filter(info))) {
+			return true;
+		}
+		batch.push_back(info);
+		return static_cast<int>(batch.size()) < batchSize || flush(batch);
+	}
+
+	void walk(int index, const File& directory, vector<File::Info>& batch) {
+		const File all(directory, L"*");
+		const LongPath search(all);
+		WIN32_FIND_DATAW data;
+		HANDLE handle = FindFirstFileExW(search.c_str(), findExInfoBasic, &data, FindExSearchNameMatch, nullptr, findFirstExLargeFetch); // 短いファイル名を取得せず、まとめて読み込む
+		if (handle == INVALID_HANDLE_VALUE && GetLastError() == ERROR_INVALID_PARAMETER) { // Windows 7 より前は FindExInfoBasic と FIND_FIRST_EX_LARGE_FETCH をサポートしない
+			handle = FindFirstFileW(search.c_str(), &data);
+		}
+		if (handle == INVALID_HANDLE_VALUE) {
+			checkError(GetLastError());
+			return;
+		}
+		scopeExit([&] () {
+			verify(FindClose(handle));
+		});
+		do {
+			if (String::equals(L".", data.cFileName) || String::equals(L"..", data.cFileName)) {
+				continue;
+			}
+			const File::Info info(File(directory, data.cFileName)
+								 , static_cast<File::Attributes>(data.dwFileAttributes)
+								 , (data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) ? 0 : (static_cast<__int64>(data.nFileSizeHigh) << 32) | data.nFileSizeLow
+								 , toInt64(data.ftCreationTime)
+								 , toInt64(data.ftLastAccessTime)
+								 , toInt64(data.ftLastWriteTime));
+			if (!add(index, info, data.cFileName, batch)) {
+				return;
+			}
+		} while (FindNextFileW(handle, &data));
+		const DWORD errorCode = GetLastError();
+		if (errorCode != ERROR_NO_MORE_FILES) {
+			checkError(errorCode);
+		}
+	}
+
+	void run(int index) {
+		try {
+			vector<File::Info> batch;
+			batch.reserve(batchSize);
+			File directory;
+			while (take(index, directory)) {
+				walk(index, directory, batch);
+				flush(batch);
+				finish();
+			}
+		} catch (...) {
+			mutex::scoped_lock lock(stateMutex);
+			if (!error) {
+				error = std::current_exception();
+			}
+			canceled = true; // 他のスレッドも止める
+			workAdded.notify_all();
+			resultsRemoved.notify_all();
+		}
+		mutex::scoped_lock lock(stateMutex);
+		if (!--runningCount) {
+			resultsAdded.notify_all();
+		}
+	}
+
+	std::wstring pattern;
+	bool matchAll;
+	DirectoryWalker::Filter filter;
+	int queueCapacity;
+	vector<unique_ptr<Worker>> workers;
+	vector<unique_ptr<thread>> threads;
+
+	mutex stateMutex; // 以下のメンバを保護する
+	condition_variable workAdded;
+	condition_variable resultsAdded;
+	condition_variable resultsRemoved;
+	deque<File::Info> results;
+	int queuedCount; // ワーカーのキューに入っているディレクトリの数
+	int pendingCount; // 列挙し終わっていないディレクトリの数
+	int runningCount; // 終了していないスレッドの数
+	bool canceled;
+	std::exception_ptr error;
+};
+
+
+
+DirectoryWalker::DirectoryWalker(const File& directory, StringRange pattern, const DirectoryWalker::Filter& filter, int threadCount, int queueCapacity)
+	: _impl(new Impl(pattern, filter, queueCapacity)) {
+	assert("Empty directory" && !directory.empty());
+	assert("Negative threadCount" && 0 <= threadCount);
+	assert("Non positive queueCapacity" && 0 < queueCapacity);
+
+	if (!directory.isDirectory()) {
+		throw File::NotFoundException();
+	}
+	if (!threadCount) {
+		threadCount = std::max(1, static_cast<int>(thread::hardware_concurrency()));
+	}
+	for (int i = 0; i < threadCount; ++i) {
+		_impl->workers.push_back(unique_ptr<Impl::Worker>(new Impl::Worker()));
+	}
+	_impl->push(0, directory.fullPathFile());
+
+	Impl* impl = _impl.get();
+	_impl->threads.reserve(threadCount);
+	try {
+		for (int i = 0; i < threadCount; ++i) {
+			{
+				mutex::scoped_lock lock(impl->stateMutex);
+				++impl->runningCount;
+			}
+			try {
+				_impl->threads.push_back(unique_ptr<thread>(new thread([impl, i] () {
+					impl->run(i);
+				})));
+			} catch (...) {
+				mutex::scoped_lock lock(impl->stateMutex);
+				--impl->runningCount;
+				throw;
+			}
+		}
+	} catch (...) {
+		cancel();
+		for (auto i = _impl->threads.begin(), end = _impl->threads.end(); i != end; ++i) {
+			(*i)->join();
+		}
+		throw;
+	}
+}
+
+
+DirectoryWalker::~DirectoryWalker() {
+	cancel();
+	for (auto i = _impl->threads.begin(), end = _impl->threads.end(); i != end; ++i) {
+		(*i)->join();
+	}
+}
+
+
+void DirectoryWalker::cancel() {
+	mutex::scoped_lock lock(_impl->stateMutex);
+	_impl->canceled = true;
+	_impl->results.clear();
+	_impl->workAdded.notify_all();
+	_impl->resultsAdded.notify_all();
+	_impl->resultsRemoved.notify_all();
+}
+
+
+bool DirectoryWalker::next(File::Info& info) {
+	mutex::scoped_lock lock(_impl->stateMutex);
+	while (_impl->results.empty() && _impl->runningCount) {
+		_impl->resultsAdded.wait(lock);
+	}
+	if (!_impl->results.empty()) {
+		info = move(_impl->results.front());
+		_impl->results.pop_front();
+		_impl->resultsRemoved.notify_one();
+		return true;
+	}
+	if (_impl->error) {
+		const std::exception_ptr error = _impl->error;
+		_impl->error = nullptr;
+		std::rethrow_exception(error);
+	}
+	return false;
+}
+
+
+
+	}
+}
@@ -0,0 +1,64 @@
+﻿#pragma once
+
+#include <functional>
+#include <memory>
+
+#include <balor/io/File.hpp>
+#include <balor/NonCopyable.hpp>
+#include <balor/StringRange.hpp>
+
+
+namespace balor {
+	namespace io {
+
+
+
+/**
+ * ディレクトリの下を再帰的に列挙する。
+ *
+ * 複数のスレッドがそれぞれサブディレクトリを列挙し、自分のキューが空になると他のスレッドのキューからディレクトリを盗んで続ける。
+ * 列挙したファイルとディレクトリは File::Info として next 関数で順に取り出す。ファイルの大きさ、日時、属性は列挙した時に一緒に取得するので、一つずつ問い合わせ直す必要は無い。
+ * 取り出されていない結果が queueCapacity 個たまると列挙を止めて待つので、巨大なディレクトリでも使うメモリは一定に収まる。
+ * 結果の順番は決まっていない。結果には名前がワイルドカードの pattern に一致するものだけを含めるが、ディレクトリは pattern に一致しなくても下を列挙する。
+ * filter が false を返したディレクトリは結果に含めず、その下も列挙しない。filter は複数のスレッドから同時に呼ばれる。
+ * シンボリックリンクや再解析ポイントのディレクトリ、アクセス権限の無いディレクトリ、列挙中に削除されたディレクトリの下は列挙しない。
+ *
+ * <h3>・サンプルコード</h3>
+ * <pre><code>
+	DirectoryWalker walker(L"assets", L"*.png", [&] (const File::Info& info) -> bool {
+		return !info.isDirectory() || info.file().name() != L".git"; // .git の下は列挙しない
+	});
+	__int64 total = 0;
+	File::Info info;
+	while (walker.next(info)) {
+		total += info.length();
+	}
+ * </code></pre>
+ */
+class DirectoryWalker : private NonCopyable {
+public:
+	/// 列挙したファイルまたはディレクトリを結果に含めるかどうかを返す関数。ディレクトリで false を返すとその下も列挙しない。
+	typedef std::function<bool (const File::Info&)> Filter;
+
+public:
+	/// directory の下の列挙を開始する。threadCount が 0 の場合は CPU の数に合わせる。
+	DirectoryWalker(const File& directory, StringRange pattern = L"*", const DirectoryWalker::Filter& filter = Filter(), int threadCount = 0, int queueCapacity = 4096);
+	/// 列挙を中止してスレッドの終了を待つ。
+	~DirectoryWalker();
+
+public:
+	/// 列挙を中止する。取り出されていない結果は捨てる。
+	void cancel();
+	/// 次の結果を info に取り出す。全て取り出し終わったら false を返す。列挙中に例外が発生した場合は、それまでの結果を取り出した後に例外を投げる。
+	bool next(File::Info& info);
+
+private:
+	struct Impl;
+
+	std::unique_ptr<Impl> _impl;
+};
+
+
+
+	}
+}
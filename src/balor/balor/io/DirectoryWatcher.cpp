@@ -0,0 +1,374 @@
+﻿#include "DirectoryWatcher.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#define BOOST_DATE_TIME_NO_LIB
+#define BOOST_THREAD_NO_LIB
+#include <boost/thread.hpp>
+
+#include <balor/io/LongPath.hpp>
+#include <balor/system/windows.hpp>
+#include <balor/test/verify.hpp>
+#include <balor/scopeExit.hpp>
+#include <balor/String.hpp>
+
+
+namespace balor {
+	namespace io {
+
+using boost::thread;
+using detail::LongPath;
+using std::move;
+using std::vector;
+
+
+namespace {
+const int maxDelayFactor = 10; // 変更が続いても delay のこの倍数以上は通知を遅らせない
+
+
+const int bufferSize = 64 * 1024; // ネットワークドライブの ReadDirectoryChangesW は 64KB を越えると失敗する
+
+
+unsigned int getTickCount() { // 差分だけを使うので一周しても構わない
+	return GetTickCount();
+}
+
+
+void checkError(DWORD errorCode) {
+	switch (errorCode) {
+		case ERROR_ACCESS_DENIED  : throw File::AccessDeniedException();
+		case ERROR_FILE_NOT_FOUND :
+		case ERROR_PATH_NOT_FOUND : throw File::NotFoundException();
+		case ERROR_INVALID_NAME   : throw File::InvalidPathException();
+		default                   : assert("Failed to CreateFileW" && false);
+	}
+}
+} // namespace
+
+
+
+bool DirectoryWatcher::Action::_validate(Action value) {
+	return added <= value && value <= renamed;
+}
+
+
+
+DirectoryWatcher::Change::Change() : _action(Action::modified) {
+}
+
+
+DirectoryWatcher::Change::Change(DirectoryWatcher::Action action, const File& file, const File& oldFile)
+	: _action(action), _file(file), _oldFile(oldFile) {
+	assert("Invalid DirectoryWatcher::Action" && DirectoryWatcher::Action::_validate(action));
+}
+
+
+DirectoryWatcher::Action DirectoryWatcher::Change::action() const {
+	return _action;
+}
+
+
+const File& DirectoryWatcher::Change::file() const {
+	return _file;
+}
+
+
+const File& DirectoryWatcher::Change::oldFile() const {
+	return _oldFile;
+}
+
+
+
+DirectoryWatcher::Changes::Changes(DirectoryWatcher& sender, const vector<DirectoryWatcher::Change>& changes, bool overflowed)
+	: EventWithSender<DirectoryWatcher>(sender), _changes(changes), _overflowed(overflowed) {
+}
+
+
+const vector<DirectoryWatcher::Change>& DirectoryWatcher::Changes::changes() const {
+	return _changes;
+}
+
+
+bool DirectoryWatcher::Changes::overflowed() const {
+	return _overflowed;
+}
+
+
+
+struct DirectoryWatcher::Impl {
+	Impl(DirectoryWatcher& owner, const File& directory, bool recursive, int delay, Listener<DirectoryWatcher::Changes&>&& onChanges)
+		: owner(owner)
+		, directory(directory)
+		, recursive(recursive)
+		, delay(delay)
+		, onChanges(move(onChanges))
+		, pending(false)
+		, overflowed(false)
+		, firstTime(0)
+		, lastTime(0)
+		, handle(INVALID_HANDLE_VALUE)
+		, stopEvent(nullptr)
+		{
+	}
+
+	~Impl() {
+		if (handle != INVALID_HANDLE_VALUE) {
+			verify(CloseHandle(handle));
+		}
+		if (stopEvent) {
+			verify(CloseHandle(stopEvent));
+		}
+	}
+
+	void touch() { // 通知を待つ時間を延ばす
+		const unsigned int now = getTickCount();
+		if (!pending) {
+			pending = true;
+			firstTime = now;
+		}
+		lastTime = now;
+	}
+
+	void add(DirectoryWatcher::Action action, const File& file, File oldFile = File()) { // 同じパスの変更が続く場合はまとめる
+		touch();
+		const std::wstring key(file.path());
+		auto found = indices.find(key);
+		if (found != indices.end()) {
+			Change& last = changes[found->second];
+			const Action lastAction = last.action();
+			if (action == Action::modified && lastAction != Action::removed) { // 作成、名前の変更、変更の後の変更は一つで良い
+				return;
+			}
+			if (action == Action::added && lastAction == Action::added) {
+				return;
+			}
+			if (action == Action::removed && lastAction == Action::added) { // 作成してすぐに削除したものは通知しない
+				last = Change();
+				indices.erase(found);
+				return;
+			}
+			if (action == Action::removed && lastAction == Action::modified) {
+				last = Change(Action::removed, file);
+				return;
+			}
+		}
+		bool modified = false;
+		if (action == Action::renamed) { // 変更前のパスにためている変更は変更後のパスの変更に書き換える
+			auto oldFound = indices.find(std::wstring(oldFile.path()));
+			if (oldFound != indices.end()) {
+				Change& last = changes[oldFound->second];
+				const Action lastAction = last.action();
+				if (lastAction == Action::added) { // 作成してすぐに名前を変えたものは変更後のパスの作成にする
+					action = Action::added;
+				} else if (lastAction == Action::renamed) { // 名前の変更が続いたものは最初の名前からの変更にする
+					oldFile = last.oldFile();
+					if (String::equals(oldFile.path(), file.path())) { // 元の名前に戻したものは通知しない
+						last = Change();
+						indices.erase(oldFound);
+						return;
+					}
+				} else if (lastAction == Action::modified) { // 名前を変えた後のパスの変更として残す
+					modified = true;
+				}
+				last = Change();
+				indices.erase(oldFound);
+			}
+		}
+		indices[key] = changes.size();
+		changes.push_back(action == Action::added ? Change(action, file) : Change(action, file, oldFile));
+		if (modified) {
+			indices[key] = changes.size();
+			changes.push_back(Change(Action::modified, file));
+		}
+	}
+
+	int remaining() const { // 通知するまでのミリ秒。ためている変更が無ければ -1
+		if (!pending) {
+			return -1;
+		}
+		const unsigned int now = getTickCount();
+		const int untilQuiet = delay - static_cast<int>(now - lastTime);
+		const int untilLimit = delay * maxDelayFactor - static_cast<int>(now - firstTime);
+		return std::max(0, std::min(untilQuiet, untilLimit));
+	}
+
+	void notify() {
+		vector<Change> result;
+		result.reserve(changes.size());
+		for (auto i = changes.begin(), end = changes.end(); i != end; ++i) {
+			if (!i->file().empty()) { // まとめて無くなった変更は飛ばす
+				result.push_back(move(*i));
+			}
+		}
+		const bool lost = overflowed;
+		changes.clear();
+		indices.clear();
+		pending = false;
+		overflowed = false;
+		if (!result.empty() || lost) {
+			Changes event(owner, result, lost);
+			onChanges(event);
+		}
+	}
+
+	void overflow() {
+		touch();
+		overflowed = true;
+	}
+
+	void start() {
+		handle = CreateFileW(LongPath(directory).c_str(), FILE_LIST_DIRECTORY, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE
+							, nullptr, OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OVERLAPPED, nullptr);
+		if (handle == INVALID_HANDLE_VALUE) {
+			checkError(GetLastError());
+		}
+		stopEvent = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+		assert("Failed to CreateEventW" && stopEvent);
+		Impl* impl = this;
+		watchThread.reset(new thread([impl] () {
+			impl->run();
+		}));
+	}
+
+	void stop() {
+		verify(SetEvent(stopEvent));
+	}
+
+	void run() {
+		vector<DWORD> buffer(bufferSize / sizeof(DWORD)); // FILE_NOTIFY_INFORMATION は DWORD 境界に置く
+		HANDLE ioEvent = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+		assert("Failed to CreateEventW" && ioEvent);
+		scopeExit([&] () {
+			verify(CloseHandle(ioEvent));
+		});
+		const DWORD filter = FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_DIR_NAME | FILE_NOTIFY_CHANGE_ATTRIBUTES
+						   | FILE_NOTIFY_CHANGE_SIZE | FILE_NOTIFY_CHANGE_LAST_WRITE | FILE_NOTIFY_CHANGE_CREATION;
+		for (;;) {
+			OVERLAPPED overlapped = {};
+			overlapped.hEvent = ioEvent;
+			if (!ReadDirectoryChangesW(handle, buffer.data(), bufferSize, recursive ? TRUE : FALSE, filter, nullptr, &overlapped, nullptr)) { // 監視しているディレクトリが削除された
+				overflow();
+				notify();
+				return;
+			}
+			for (;;) {
+				HANDLE handles[] = {ioEvent, stopEvent};
+				const int wait = remaining();
+				const DWORD result = WaitForMultipleObjects(2, handles, FALSE, wait == -1 ? INFINITE : wait);
+				if (result == WAIT_TIMEOUT) {
+					notify();
+					continue;
+				}
+				if (result != WAIT_OBJECT_0) {
+					assert("Failed to WaitForMultipleObjects" && result == WAIT_OBJECT_0 + 1);
+					CancelIo(handle);
+					DWORD transferred;
+					GetOverlappedResult(handle, &overlapped, &transferred, TRUE); // 取り消した要求の終了を待ってからバッファを解放する
+					return;
+				}
+				break;
+			}
+			DWORD transferred = 0;
+			if (!GetOverlappedResult(handle, &overlapped, &transferred, FALSE)) {
+				if (GetLastError() != ERROR_NOTIFY_ENUM_DIR) {
+					overflow();
+					notify();
+					return;
+				}
+				overflow();
+			} else if (!transferred) { // バッファに入りきらなかった
+				overflow();
+			} else {
+				File renamedFrom;
+				const char* current = reinterpret_cast<const char*>(buffer.data());
+				for (;;) {
+					const FILE_NOTIFY_INFORMATION& information = *reinterpret_cast<const FILE_NOTIFY_INFORMATION*>(current);
+					const std::wstring name(information.FileName, information.FileNameLength / sizeof(wchar_t));
+					const File file(directory, name.c_str());
+					switch (information.Action) {
+						case FILE_ACTION_ADDED            : add(Action::added, file); break;
+						case FILE_ACTION_REMOVED          : add(Action::removed, file); break;
+						case FILE_ACTION_MODIFIED         : add(Action::modified, file); break;
+						case FILE_ACTION_RENAMED_OLD_NAME : renamedFrom = file; break;
+						case FILE_ACTION_RENAMED_NEW_NAME : {
+							if (renamedFrom.empty()) {
+								add(Action::added, file);
+							} else {
+								add(Action::renamed, file, renamedFrom);
+								renamedFrom = File();
+							}
+						} break;
+					}
+					if (!information.NextEntryOffset) {
+						break;
+					}
+					current += information.NextEntryOffset;
+				}
+			}
+		}
+	}
+
+	DirectoryWatcher& owner;
+	File directory;
+	bool recursive;
+	int delay;
+	Listener<DirectoryWatcher::Changes&> onChanges;
+	std::unique_ptr<thread> watchThread;
+
+	// 以下は監視用のスレッドだけが使う
+	vector<Change> changes;
+	std::unordered_map<std::wstring, int> indices; // パスごとに最後の変更の changes の位置
+	bool pending;
+	bool overflowed;
+	unsigned int firstTime;
+	unsigned int lastTime;
+	HANDLE handle;
+	HANDLE stopEvent;
+};
+
+
+
+DirectoryWatcher::DirectoryWatcher(const File& directory, bool recursive, int delay, Listener<DirectoryWatcher::Changes&> onChanges)
+	: _impl(new Impl(*this, directory, recursive, delay, move(onChanges))) {
+	assert("Empty directory" && !directory.empty());
+	assert("Negative delay" && 0 <= delay);
+
+	if (!directory.isDirectory()) {
+		throw File::NotFoundException();
+	}
+	_impl->directory = directory.fullPathFile();
+	_impl->start();
+}
+
+
+DirectoryWatcher::~DirectoryWatcher() {
+	assert("Can't destroy DirectoryWatcher in onChanges" && boost::this_thread::get_id() != _impl->watchThread->get_id());
+	_impl->stop();
+	_impl->watchThread->join();
+}
+
+
+int DirectoryWatcher::delay() const {
+	return _impl->delay;
+}
+
+
+const File& DirectoryWatcher::directory() const {
+	return _impl->directory;
+}
+
+
+bool DirectoryWatcher::recursive() const {
+	return _impl->recursive;
+}
+
+
+
+	}
+}
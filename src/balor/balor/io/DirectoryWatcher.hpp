@@ -0,0 +1,118 @@
+﻿#pragma once
+
+#include <memory>
+#include <vector>
+
+#include <balor/io/File.hpp>
+#include <balor/Enum.hpp>
+#include <balor/Event.hpp>
+#include <balor/Exception.hpp>
+#include <balor/Listener.hpp>
+#include <balor/NonCopyable.hpp>
+
+
+namespace balor {
+	namespace io {
+
+
+
+/**
+ * ディレクトリの下の変更を監視する。
+ *
+ * ReadDirectoryChangesW で変更を受け取る。
+ * 変更は最後の変更から delay ミリ秒の間、新しい変更が無くなるまでためてからまとめて onChanges イベントに渡す。変更が続く場合でも delay の 10 倍以上は待たない。
+ * ためている間に同じファイルの変更が続いた場合は一つにまとめ、作成してすぐに削除したファイルは通知しない。
+ * システムのバッファがあふれて変更を取りこぼした場合は Changes::overflowed() が true になるので、必要ならディレクトリを列挙し直すこと。
+ * 監視しているディレクトリ自身が削除されると overflowed() が true のイベントを発生させて監視を終える。
+ * onChanges イベントは監視用のスレッドから呼ばれ、例外を投げてはならない。UI に反映する場合は InvokeQueue などで UI のスレッドに渡すこと。onChanges イベントの中でこのオブジェクトを破棄してはならない。
+ *
+ * <h3>・サンプルコード</h3>
+ * <pre><code>
+	DirectoryWatcher watcher(L"assets", true, 100, [&] (DirectoryWatcher::Changes& e) {
+		if (e.overflowed()) {
+			Debug::writeLine(L"取りこぼしたので列挙し直す");
+		}
+		for (auto i = e.changes().begin(), end = e.changes().end(); i != end; ++i) {
+			Debug::writeLine(String() + i->file().path());
+		}
+	});
+ * </code></pre>
+ */
+class DirectoryWatcher : private NonCopyable {
+public:
+	/// 変更の種類。
+	struct Action {
+		enum _enum {
+			added    = 1, /// 作成された、または監視するディレクトリに移動してきた。
+			removed  = 2, /// 削除された、または監視するディレクトリの外に移動した。
+			modified = 3, /// 内容、大きさ、日時または属性が変更された。
+			renamed  = 4, /// 名前が変更された。oldFile が変更前のパス。
+		};
+		BALOR_NAMED_ENUM_MEMBERS(Action);
+	};
+
+	/// 一つの変更。
+	class Change {
+	public:
+		/// 空のパスの変更を作成。
+		Change();
+		/// 変更の種類、パス、名前を変更した場合は変更前のパスから作成。
+		Change(DirectoryWatcher::Action action, const File& file, const File& oldFile = File());
+
+	public:
+		/// 変更の種類。
+		DirectoryWatcher::Action action() const;
+		/// 変更されたファイルまたはディレクトリ。
+		const File& file() const;
+		/// 名前を変更した場合は変更前のパス。その他の場合は空。
+		const File& oldFile() const;
+
+	private:
+		DirectoryWatcher::Action _action;
+		File _file;
+		File _oldFile;
+	};
+
+	/// ためた変更をまとめて通知するイベント。
+	class Changes : public EventWithSender<DirectoryWatcher> {
+	public:
+		Changes(DirectoryWatcher& sender, const std::vector<DirectoryWatcher::Change>& changes, bool overflowed);
+
+	public:
+		/// 起きた順番の変更。
+		const std::vector<DirectoryWatcher::Change>& changes() const;
+		/// 変更を取りこぼしたかどうか。
+		bool overflowed() const;
+
+	private:
+		const std::vector<DirectoryWatcher::Change>& _changes;
+		bool _overflowed;
+	};
+
+	/// 監視できるディレクトリの数などのシステムの上限を越えた。
+	class LimitExceededException : public Exception {};
+
+public:
+	/// directory の監視を開始する。recursive が true ならサブディレクトリの下も監視する。
+	DirectoryWatcher(const File& directory, bool recursive, int delay, Listener<DirectoryWatcher::Changes&> onChanges);
+	/// 監視を終了してスレッドの終了を待つ。ためていた変更は通知しない。
+	~DirectoryWatcher();
+
+public:
+	/// 変更をまとめるまで待つミリ秒。
+	int delay() const;
+	/// 監視しているディレクトリの絶対パス。
+	const File& directory() const;
+	/// サブディレクトリの下も監視しているかどうか。
+	bool recursive() const;
+
+private:
+	struct Impl;
+
+	std::unique_ptr<Impl> _impl;
+};
+
+
+
+	}
+}
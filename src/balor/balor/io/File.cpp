@@ -1,11 +1,23 @@
 ﻿#include "File.hpp"
 
+#include <algorithm>
+#include <cstring>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <string>
 #include <utility>
 #include <vector>
+
+#define BOOST_DATE_TIME_NO_LIB
+#define BOOST_THREAD_NO_LIB
+#include <boost/thread.hpp>
+
 #include <Shlwapi.h>
 #pragma comment (lib,"Shlwapi.lib")
 
 #include <balor/graphics/Icon.hpp>
+#include <balor/io/LongPath.hpp>
 #include <balor/system/windows.hpp>
 #include <balor/test/verify.hpp>
 #include <balor/scopeExit.hpp>
@@ -18,13 +30,30 @@
 namespace balor {
 	namespace io {
 
+using boost::condition_variable;
+using boost::mutex;
+using boost::thread;
+using std::max;
+using std::min;
 using std::move;
 using std::swap;
+using std::unique_ptr;
 using std::vector;
 using namespace balor::graphics;
+using detail::LongPath;
 
 
 namespace {
+/// copyFile でコピーする度にコピーしたバイト数を受け取る。false を返すとコピーを中断する。
+typedef std::function<bool (__int64)> CopyCallback;
+
+wchar_t emptyPath[] = L""; // 空のパスの File が共有する。書き換えない
+const int infosPerThread = 16; // File::infos でスレッドを一つ増やす情報の数
+
+
+const __int64 noBufferingSize = 256 * 1024 * 1024; // これ以上のファイルはシステムキャッシュを経由せずにコピーする
+
+
 static_assert(File::Attributes::readOnly          == FILE_ATTRIBUTE_READONLY           , "Invalid enum value");
 static_assert(File::Attributes::hidden            == FILE_ATTRIBUTE_HIDDEN             , "Invalid enum value");
 static_assert(File::Attributes::system            == FILE_ATTRIBUTE_SYSTEM             , "Invalid enum value");
@@ -103,6 +132,7 @@ void checkError(DWORD errorCode) {
 		case ERROR_FILE_NOT_FOUND               :
 		case ERROR_PATH_NOT_FOUND               : throw File::NotFoundException();
 		case ERROR_INVALID_NAME                 : throw File::InvalidPathException();
+		case ERROR_FILENAME_EXCED_RANGE         : throw File::PathTooLongException();
 		case ERROR_SHARING_VIOLATION            : throw File::SharingViolationException(); // 移動先が自分のサブディレクトリ
 		case ERROR_UNABLE_TO_REMOVE_REPLACED    : // バックアップファイルを削除できなかった
 		case ERROR_UNABLE_TO_MOVE_REPLACEMENT   : // リネームができなかった
@@ -112,6 +142,76 @@ void checkError(DWORD errorCode) {
 }
 
 
+__int64 toInt64(const FILETIME& time) {
+	return (static_cast<__int64>(time.dwHighDateTime) << 32) | time.dwLowDateTime;
+}
+
+
+bool queryInfo(const File& file, File::Info& info) { // 存在しなければ false を返す
+	WIN32_FILE_ATTRIBUTE_DATA data;
+	if (!GetFileAttributesExW(LongPath(file).c_str(), GetFileExInfoStandard, &data)) {
+		const DWORD errorCode = GetLastError();
+		if (errorCode == ERROR_FILE_NOT_FOUND
+		 || errorCode == ERROR_PATH_NOT_FOUND) {
+			return false;
+		}
+		checkError(errorCode);
+	}
+	info = File::Info(file
+					, static_cast<File::Attributes>(data.dwFileAttributes)
+					, (data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) ? 0 : (static_cast<__int64>(data.nFileSizeHigh) << 32) | data.nFileSizeLow
+					, toInt64(data.ftCreationTime)
+					, toInt64(data.ftLastAccessTime)
+					, toInt64(data.ftLastWriteTime));
+	return true;
+}
+
+
+#if !defined(COPY_FILE_NO_BUFFERING)
+#define COPY_FILE_NO_BUFFERING 0x00001000
+#endif
+
+
+struct CopyProgressData {
+	const CopyCallback* callback;
+	__int64 transferred;
+};
+
+
+DWORD CALLBACK copyProgressRoutine(LARGE_INTEGER , LARGE_INTEGER totalBytesTransferred, LARGE_INTEGER , LARGE_INTEGER , DWORD , DWORD , HANDLE , HANDLE , LPVOID data) {
+	CopyProgressData& progress = *static_cast<CopyProgressData*>(data);
+	const __int64 count = totalBytesTransferred.QuadPart - progress.transferred;
+	progress.transferred = totalBytesTransferred.QuadPart;
+	if (count && !(*progress.callback)(count)) {
+		return PROGRESS_CANCEL;
+	}
+	return PROGRESS_CONTINUE;
+}
+
+
+bool copyFile(const File& source, const File& destination, bool overwrite, const CopyCallback& callback, __int64 length, bool noBuffering) { // 中断したら false を返す
+	CopyProgressData progress = {&callback, 0};
+	DWORD flags = overwrite ? 0 : COPY_FILE_FAIL_IF_EXISTS;
+	if (noBuffering && noBufferingSize <= length) {
+		flags |= COPY_FILE_NO_BUFFERING; // 大きなファイルでシステムキャッシュを追い出さない
+	}
+	for (;;) {
+		if (CopyFileExW(LongPath(source).c_str(), LongPath(destination).c_str(), callback ? copyProgressRoutine : nullptr, &progress, nullptr, flags)) {
+			return true;
+		}
+		const DWORD errorCode = GetLastError();
+		if (errorCode == ERROR_REQUEST_ABORTED) {
+			return false;
+		}
+		if (errorCode == ERROR_INVALID_PARAMETER && (flags & COPY_FILE_NO_BUFFERING)) { // Windows Vista より前は COPY_FILE_NO_BUFFERING が無い
+			flags &= ~COPY_FILE_NO_BUFFERING;
+			continue;
+		}
+		checkError(errorCode);
+	}
+}
+
+
 void getFilesToVector(vector<File>& files, const File& file, StringRange searchPettern, bool recursive) {
 	if (recursive) {
 		auto i = file.getFilesIterator(); // サブディレクトリを再帰的に検索していく
@@ -129,6 +229,154 @@ void getFilesToVector(vector<File>& files, const File& file, StringRange searchP
 		++i;
 	}
 }
+
+
+struct CopyEntry {
+	CopyEntry(const File& source, const File& destination, __int64 length) : source(source), destination(destination), length(length) {}
+
+	File source;
+	File destination;
+	__int64 length;
+};
+
+
+/// ディレクトリを作成しながらコピーするファイルを集める。
+void collectCopyEntries(const File& source, File destination, bool overwrite, vector<CopyEntry>& entries) {
+	if (source.isDirectory()) {
+		if (!overwrite && destination.exists()) {
+			throw File::AlreadyExistsException();
+		}
+		destination.createDirectory();
+		for (auto i = source.getFilesIterator(); i; ++i) {
+			collectCopyEntries(*i, File(destination, i->name()), overwrite, entries);
+		}
+	} else {
+		entries.push_back(CopyEntry(source, destination, source.info().length()));
+	}
+}
+
+
+/// File::copyTo でファイルを複数のスレッドで並行してコピーする。進み具合は呼び出したスレッドに集めて報告する。
+class ParallelCopy : private NonCopyable {
+public:
+	ParallelCopy(const vector<CopyEntry>& entries, bool overwrite, bool noBuffering)
+		: _entries(entries), _overwrite(overwrite), _noBuffering(noBuffering), _next(0), _copied(0), _runningCount(0), _canceled(false) {
+	}
+
+	void run(int threadCount, const File::CopyProgress& progress, __int64 total) {
+		vector<unique_ptr<thread> > threads;
+		scopeExit([&] () { // progress が例外を投げた場合もコピーを中断してスレッドを終わらせる
+			{
+				mutex::scoped_lock lock(_mutex);
+				_canceled = true;
+			}
+			for (auto i = threads.begin(), end = threads.end(); i != end; ++i) {
+				(*i)->join();
+			}
+		});
+		_runningCount = threadCount;
+		for (int i = 0; i < threadCount; ++i) {
+			threads.push_back(unique_ptr<thread>(new thread([this] () { work(); })));
+		}
+		__int64 reported = 0;
+		mutex::scoped_lock lock(_mutex);
+		for (;;) {
+			if (progress && _copied != reported) {
+				reported = _copied;
+				lock.unlock();
+				progress(reported, total);
+				lock.lock();
+				continue;
+			}
+			if (!_runningCount) {
+				break;
+			}
+			_condition.wait(lock);
+		}
+		if (_error) {
+			std::rethrow_exception(_error);
+		}
+	}
+
+private:
+	void work() {
+		for (;;) {
+			std::size_t index = 0;
+			{
+				mutex::scoped_lock lock(_mutex);
+				if (_canceled || _next == _entries.size()) {
+					break;
+				}
+				index = _next++;
+			}
+			const CopyEntry& entry = _entries[index];
+			try {
+				copyFile(entry.source, entry.destination, _overwrite, [&] (__int64 count) -> bool {
+					mutex::scoped_lock lock(_mutex);
+					_copied += count;
+					_condition.notify_all();
+					return !_canceled;
+				}, entry.length, _noBuffering);
+			} catch (...) {
+				mutex::scoped_lock lock(_mutex);
+				if (!_error) {
+					_error = std::current_exception();
+				}
+				_canceled = true;
+			}
+		}
+		mutex::scoped_lock lock(_mutex);
+		--_runningCount;
+		_condition.notify_all();
+	}
+
+	const vector<CopyEntry>& _entries;
+	const bool _overwrite;
+	const bool _noBuffering;
+	mutex _mutex;
+	condition_variable _condition;
+	std::size_t _next;
+	__int64 _copied;
+	int _runningCount;
+	bool _canceled;
+	std::exception_ptr _error;
+};
+
+
+void copyEntries(const File& source, StringRange destPath, bool overwrite, const File::CopyProgress& progress, int threadCount, bool noBuffering) {
+	vector<CopyEntry> entries;
+	collectCopyEntries(source, File(destPath), overwrite, entries);
+	__int64 total = 0;
+	for (auto i = entries.begin(), end = entries.end(); i != end; ++i) {
+		total += i->length;
+	}
+	if (progress) {
+		progress(0, total);
+	}
+	threadCount = std::min(threadCount, static_cast<int>(entries.size()));
+	if (1 < threadCount) {
+		ParallelCopy(entries, overwrite, noBuffering).run(threadCount, progress, total);
+		return;
+	}
+
+	__int64 copied = 0; // スレッドを使わずにコピーする。progress の例外は CopyFileExW のコールバックを越えて投げられないので一旦止めて投げ直す
+	std::exception_ptr error;
+	const CopyCallback callback = [&] (__int64 count) -> bool {
+		copied += count;
+		try {
+			progress(copied, total);
+		} catch (...) {
+			error = std::current_exception();
+			return false;
+		}
+		return true;
+	};
+	for (auto i = entries.begin(), end = entries.end(); i != end; ++i) {
+		if (!copyFile(i->source, i->destination, overwrite, progress ? callback : CopyCallback(), i->length, noBuffering)) {
+			std::rethrow_exception(error);
+		}
+	}
+}
 } // namespace
 
 
@@ -198,6 +446,57 @@ bool File::SpecialOption::_validate(SpecialOption value) {
 
 
 
+File::Info::Info()
+	: _attributes(Attributes::none), _length(0), _creationTime(0), _lastAccessTime(0), _lastWriteTime(0) {
+}
+
+
+File::Info::Info(const File& file, File::Attributes attributes, __int64 length, __int64 creationTime, __int64 lastAccessTime, __int64 lastWriteTime)
+	: _file(file), _attributes(attributes), _length(length), _creationTime(creationTime), _lastAccessTime(lastAccessTime), _lastWriteTime(lastWriteTime) {
+}
+
+
+File::Attributes File::Info::attributes() const {
+	return _attributes;
+}
+
+
+__int64 File::Info::creationTime() const {
+	return _creationTime;
+}
+
+
+const File& File::Info::file() const {
+	return _file;
+}
+
+
+bool File::Info::exists() const {
+	return _attributes != Attributes::none;
+}
+
+
+bool File::Info::isDirectory() const {
+	return (_attributes & Attributes::directory) != 0;
+}
+
+
+__int64 File::Info::lastAccessTime() const {
+	return _lastAccessTime;
+}
+
+
+__int64 File::Info::lastWriteTime() const {
+	return _lastWriteTime;
+}
+
+
+__int64 File::Info::length() const {
+	return _length;
+}
+
+
+
 File::FilesIterator::FilesIterator(FilesIterator&& value)
 	: current(value.current), nameIndex(value.nameIndex), handle(value.handle) {
 	value.handle = nullptr;
@@ -231,7 +530,7 @@ File::FilesIterator::FilesIterator(const File& file, StringRange searchPettern)
 	}
 
 	WIN32_FIND_DATAW data;
-	handle = FindFirstFileW(current._path, &data);
+	handle = FindFirstFileW(LongPath(current).c_str(), &data);
 	current._path[nameIndex] = L'\0';
 	if (handle == INVALID_HANDLE_VALUE) {
 		handle = nullptr;
@@ -303,38 +602,59 @@ File::FilesIterator::operator bool() const {
 
 
 
-File::File() {
-	_path[0] = L'\0';
-	_pathLength = 0;
+File::File() : _path(emptyPath), _pathLength(0), _capacity(0) {
 }
 
 
-File::File(const File& value) : _pathLength(value._pathLength) {
-	String::refer(value._path, value._pathLength).copyTo(_path);
+File::File(const File& value) : _path(emptyPath), _pathLength(0), _capacity(0) {
+	path(value);
 }
 
 
-File::File(StringRange path) {
+File::File(File&& value) : _path(value._path), _pathLength(value._pathLength), _capacity(value._capacity) {
+	value._path = emptyPath;
+	value._pathLength = 0;
+	value._capacity = 0;
+}
+
+
+File::File(StringRange path) : _path(emptyPath), _pathLength(0), _capacity(0) {
 	this->path(path);
 }
 
 
-File::File(StringRange directoryName, StringRange fileName) {
+File::File(StringRange directoryName, StringRange fileName) : _path(emptyPath), _pathLength(0), _capacity(0) {
 	path(directoryName, fileName);
 }
 
 
+File::~File() {
+	if (_capacity) {
+		delete [] _path;
+	}
+}
+
+
 File& File::operator=(const File& value) {
 	if (this != &value) {
-		String::refer(value._path, value._pathLength).copyTo(_path);
-		_pathLength = value._pathLength;
+		path(value);
+	}
+	return *this;
+}
+
+
+File& File::operator=(File&& value) {
+	if (this != &value) {
+		swap(_path, value._path);
+		swap(_pathLength, value._pathLength);
+		swap(_capacity, value._capacity);
 	}
 	return *this;
 }
 
 
 File::Attributes File::attributes() const {
-	DWORD result = GetFileAttributesW(_path);
+	DWORD result = GetFileAttributesW(LongPath(*this).c_str());
 	if (result == INVALID_FILE_ATTRIBUTES) {
 		checkError(GetLastError());
 	}
@@ -343,7 +663,7 @@ File::Attributes File::attributes() const {
 
 
 void File::attributes(File::Attributes value) {
-	if (!SetFileAttributesW(_path, value)) {
+	if (!SetFileAttributesW(LongPath(*this).c_str(), value)) {
 		checkError(GetLastError());
 	}
 }
@@ -351,25 +671,19 @@ void File::attributes(File::Attributes value) {
 
 void File::copyTo(StringRange destPath, bool overwrite) const {
 	assert("Empty destPath" && !destPath.empty());
-	if (isDirectory()) {
-		File dest(destPath);
-		if (!overwrite && dest.exists()) {
-			throw AlreadyExistsException();
-		}
-		dest.createDirectory();
-		for (auto i = getFilesIterator(); i; ++i) {
-			i->copyTo(File(dest, i->name()), overwrite);
-		}
-	} else {
-		if (!CopyFileW(_path, destPath.c_str(), overwrite ? FALSE : TRUE)) {
-			checkError(GetLastError());
-		}
-	}
+	copyEntries(*this, destPath, overwrite, CopyProgress(), 1, false);
+}
+
+
+void File::copyTo(StringRange destPath, bool overwrite, const File::CopyProgress& progress, int threadCount) const {
+	assert("Empty destPath" && !destPath.empty());
+	assert("Non positive threadCount" && 0 < threadCount);
+	copyEntries(*this, destPath, overwrite, progress, threadCount, true);
 }
 
 
 FileStream File::create() {
-	return FileStream(_path, FileStream::Mode::createAlways, FileStream::Access::readWrite);
+	return FileStream(LongPath(*this).c_str(), FileStream::Mode::createAlways, FileStream::Access::readWrite);
 }
 
 
@@ -380,13 +694,13 @@ void File::createDirectory() {
 		}
 		return;
 	}
-	if (!CreateDirectoryW(_path, nullptr)) {
+	if (!CreateDirectoryW(LongPath(*this).c_str(), nullptr)) {
 		const DWORD errorCode = GetLastError();
 		if (errorCode == ERROR_PATH_NOT_FOUND) {
 			auto parentDir = parent();
 			if (parentDir._pathLength) {
 				parentDir.createDirectory(); // 親ディレクトリから再帰的に作成を試みる
-				verify(CreateDirectoryW(_path, nullptr)); // 親が作成されたから再び作成を試みる
+				verify(CreateDirectoryW(LongPath(*this).c_str(), nullptr)); // 親が作成されたから再び作成を試みる
 				return;
 			}
 			throw NotFoundException(); // 親ディレクトリ作成の再帰がルートディレクトリに到達した
@@ -401,18 +715,18 @@ File File::createTempFile() {
 	wchar_t tempPathBuffer[MAX_PATH];
 	tempPathBuffer[0] = 0;
 	verify(GetTempPathW(MAX_PATH, tempPathBuffer));
-	File file;
-	verify(GetTempFileNameW(tempPathBuffer, L"tmp", 0, file._path));
-	file._pathLength = String::getLength(file._path);
-	return file;
+	wchar_t path[MAX_PATH];
+	verify(GetTempFileNameW(tempPathBuffer, L"tmp", 0, path));
+	return File(path);
 }
 
 
 File File::current() {
 	File file;
-	file._pathLength = GetCurrentDirectoryW(MAX_PATH, file._path);
+	file.reserve(GetCurrentDirectoryW(0, nullptr)); // 終端文字を含んだ長さが返る
+	file._pathLength = GetCurrentDirectoryW(file._capacity, file._path);
 	assert(file._pathLength);
-	assert(file._pathLength < MAX_PATH);
+	assert(file._pathLength < file._capacity);
 	return file;
 }
 
@@ -436,12 +750,12 @@ bool File::empty() const {
 
 
 bool File::exists() const {
-	return PathFileExistsW(_path) != FALSE;
+	return GetFileAttributesW(LongPath(*this).c_str()) != INVALID_FILE_ATTRIBUTES;
 }
 
 
 bool File::exists(StringRange path) {
-	return PathFileExistsW(path.c_str()) != FALSE;
+	return File(path).exists();
 }
 
 
@@ -466,11 +780,14 @@ void File::extensionToBuffer(StringBuffer& buffer) const {
 File File::fullPathFile() const {
 	File file;
 	wchar_t* fileName;
-	file._pathLength = GetFullPathNameW(_path, maxPath, file._path, &fileName);
-	if (MAX_PATH < file._pathLength) {
-		throw PathTooLongException();
+	file.reserve(max(_pathLength, maxPath));
+	DWORD length = GetFullPathNameW(_path, file._capacity, file._path, &fileName);
+	if (static_cast<DWORD>(file._capacity) <= length) { // バッファが足りない場合は終端文字を含んだ長さが返る
+		file.reserve(length);
+		length = GetFullPathNameW(_path, file._capacity, file._path, &fileName);
 	}
-	assert(L"Failed to GetFullPathNameW" && file._pathLength);
+	assert(L"Failed to GetFullPathNameW" && length);
+	file._pathLength = length;
 	return file;
 }
 
@@ -494,10 +811,10 @@ File::FilesIterator File::getFilesIterator(StringRange searchPettern) const {
 File File::getSpecial(File::Special special, File::SpecialOption option) {
 	assert("Invalid Directory::Special" && File::Special::_validate(special));
 	assert("Invalid Directory::SpecialOption" && File::SpecialOption::_validate(option));
-	File file;
+	wchar_t path[MAX_PATH];
+	path[0] = L'\0';
 	if (special == Special::temporary) {
-		file._pathLength = GetTempPathW(MAX_PATH, file._path);
-		assert(file._pathLength);
+		verify(GetTempPathW(MAX_PATH, path));
 	} else {
 		struct ResultChecker {
 			ResultChecker(HRESULT result) : result(result) {
@@ -506,15 +823,14 @@ File File::getSpecial(File::Special special, File::SpecialOption option) {
 			HRESULT result;
 		};
 
-		ResultChecker(SHGetFolderPathW(nullptr, special | option, nullptr, SHGFP_TYPE_CURRENT, file._path));
-		file.resetPathLength();
+		ResultChecker(SHGetFolderPathW(nullptr, special | option, nullptr, SHGFP_TYPE_CURRENT, path));
 	}
-	return file;
+	return File(path);
 }
 
 
 Icon File::icon() const {
-	if (!exists()) {
+	if (!exists() || MAX_PATH <= _pathLength) { // ExtractAssociatedIconW は MAX_PATH のバッファを必要とする
 		return Icon();
 	}
 	wchar_t path[MAX_PATH];
@@ -525,8 +841,70 @@ Icon File::icon() const {
 }
 
 
+File::Info File::info() const {
+	Info result;
+	if (!queryInfo(*this, result)) {
+		throw NotFoundException();
+	}
+	return result;
+}
+
+
+vector<File::Info> File::infos(StringRangeArray paths, int threadCount) {
+	assert("Non positive threadCount" && 0 < threadCount);
+
+	const int count = paths.length();
+	vector<Info> result(count);
+	std::exception_ptr error;
+	mutex infosMutex;
+	int next = 0;
+	auto work = [&] () { // 一つずつ取り出して問い合わせる。問い合わせの待ち時間に比べてロックは短い
+		for (;;) {
+			int index;
+			{
+				mutex::scoped_lock lock(infosMutex);
+				if (error || next == count) {
+					break;
+				}
+				index = next++;
+			}
+			try {
+				const File file(paths[index]);
+				if (!queryInfo(file, result[index])) {
+					result[index] = Info(file, Attributes::none, 0, 0, 0, 0);
+				}
+			} catch (...) {
+				mutex::scoped_lock lock(infosMutex);
+				if (!error) {
+					error = std::current_exception();
+				}
+			}
+		}
+	};
+
+	threadCount = min(threadCount, (count + infosPerThread - 1) / infosPerThread); // 少なければスレッドを作らない
+	vector<unique_ptr<thread>> threads;
+	{
+		scopeExit([&] () {
+			for (auto i = threads.begin(), end = threads.end(); i != end; ++i) {
+				(*i)->join();
+			}
+		});
+		for (int i = 1; i < threadCount; ++i) {
+			threads.push_back(unique_ptr<thread>(new thread(work)));
+		}
+		work(); // 呼び出したスレッドも問い合わせる
+	}
+	if (error) {
+		std::rethrow_exception(error);
+	}
+	return result;
+}
+
+
 bool File::isDirectory() const {
-	return PathIsDirectoryW(_path) != 0;
+	const DWORD attributes = GetFileAttributesW(LongPath(*this).c_str());
+	return attributes != INVALID_FILE_ATTRIBUTES && (attributes & FILE_ATTRIBUTE_DIRECTORY);
 }
 
 
@@ -536,7 +914,7 @@ void File::moveTo(StringRange destPath) {
 	if (!exists()) { // ”ファイル”として存在するかチェック
 		throw NotFoundException();
 	}
-	if (!MoveFileW(_path, destPath.c_str())) {
+	if (!MoveFileW(LongPath(*this).c_str(), LongPath(File(destPath)).c_str())) {
 		checkError(GetLastError());
 	}
 }
@@ -581,38 +959,57 @@ void File::nameWithoutExtensionToBuffer(StringBuffer& buffer) const {
 
 
 FileStream File::openAppend() {
-	return FileStream(_path, FileStream::Mode::append, FileStream::Access::write);
+	return FileStream(LongPath(*this).c_str(), FileStream::Mode::append, FileStream::Access::write);
 }
 
 
 FileStream File::openRead() const {
-	return FileStream(_path, FileStream::Mode::open, FileStream::Access::read);
+	return FileStream(LongPath(*this).c_str(), FileStream::Mode::open, FileStream::Access::read);
 }
 
 
 FileStream File::openWrite() {
-	return FileStream(_path, FileStream::Mode::open, FileStream::Access::write);
+	return FileStream(LongPath(*this).c_str(), FileStream::Mode::open, FileStream::Access::write);
 }
 
 
 void File::path(StringRange value) {
-	if (maxPath <= value.length()) {
-		throw PathTooLongException();
+	const int length = value.length();
+	if (!length && !_capacity) {
+		_pathLength = 0;
+		return;
+	}
+	wchar_t* path = _capacity <= length ? new wchar_t[length + 1] : _path; // value が自分のパスを指していても良いように先にコピーする
+	std::memmove(path, value.c_str(), length * sizeof(wchar_t));
+	path[length] = L'\0';
+	if (path != _path) {
+		if (_capacity) {
+			delete [] _path;
+		}
+		_path = path;
+		_capacity = length + 1;
 	}
-	String::refer(value).copyTo(_path);
-	_pathLength = value.length();
+	_pathLength = length;
 }
 
 
 void File::path(StringRange directoryName, StringRange fileName) {
 	if (*fileName.c_str() == L'\\') { // PathCombine 関数は Vista と XP で挙動が異なる。XP ではこの処理がなくともこのような結果を返すが、Vistaでは関数が失敗する。
 		path(fileName);
-	} else {
-		if (!PathCombineW(_path, directoryName.c_str(), fileName.c_str())) {
-			throw PathTooLongException(); // おそらくはMAX_PATHオーバー
-		}
-		resetPathLength();
+		return;
+	}
+	wchar_t buffer[MAX_PATH];
+	if (directoryName.length() + fileName.length() + 1 < MAX_PATH && PathCombineW(buffer, directoryName.c_str(), fileName.c_str())) {
+		path(buffer);
+		return;
 	}
+	const wchar_t separator = L'\\'; // PathCombineW は MAX_PATH を越えると失敗するので . と .. は解釈せずにつなぐ
+	std::wstring combined(directoryName.c_str(), directoryName.length());
+	if (!combined.empty() && combined.back() != L'/' && combined.back() != L'\\') {
+		combined += separator;
+	}
+	combined.append(fileName.c_str(), fileName.length());
+	path(combined);
 }
 
 
@@ -652,11 +1049,11 @@ void File::remove(bool recursive) {
 				i->remove(true);
 			}
 		}
-		if (!RemoveDirectoryW(_path)) {
+		if (!RemoveDirectoryW(LongPath(*this).c_str())) {
 			checkError(GetLastError());
 		}
 	} else {
-		if (!DeleteFileW(_path)) {
+		if (!DeleteFileW(LongPath(*this).c_str())) {
 			const DWORD errorCode = GetLastError();
 			if (errorCode != ERROR_FILE_NOT_FOUND) {
 				checkError(errorCode);
@@ -676,6 +1073,20 @@ void File::replace(StringRange destFilePath, StringRange backupFilePath) {
 }
 
 
+void File::reserve(int length) {
+	if (length < _capacity) {
+		return;
+	}
+	wchar_t* path = new wchar_t[length + 1];
+	std::memcpy(path, _path, (_pathLength + 1) * sizeof(wchar_t));
+	if (_capacity) {
+		delete [] _path;
+	}
+	_path = path;
+	_capacity = length + 1;
+}
+
+
 void File::resetPathLength() {
 	_pathLength = String::getLength(_path);
 }
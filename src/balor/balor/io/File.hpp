@@ -1,10 +1,13 @@
 ﻿#pragma once
 
+#include <functional>
+
 #include <balor/io/FileStream.hpp>
 #include <balor/Enum.hpp>
 #include <balor/Exception.hpp>
 #include <balor/NonCopyable.hpp>
 #include <balor/StringRange.hpp>
+#include <balor/StringRangeArray.hpp>
 
 namespace std {
 template<typename T> class allocator;
@@ -25,10 +28,16 @@ namespace balor {
 
 /**
  * ファイルまたはディレクトリを表す。パスを保持し、パスに対する操作もサポートする。
+ *
+ * パスの長さに制限は無い。248 文字以上の長さのパスに \\?\ を付けて Win32 API に渡す。
+ * attributes や isDirectory などの関数は呼ぶ度にシステムに問い合わせるので、複数の情報を使う場合は info 関数で File::Info にまとめて取得した方が速い。
+ * 多数のファイルの情報は infos 関数で複数のスレッドから並行して問い合わせられる。
  */
 class File {
 public:
 	typedef ::balor::graphics::Icon Icon;
+	/// copyTo の進み具合を受け取る関数。コピーし終わったバイト数と全体のバイト数を受け取る。
+	typedef std::function<void (__int64, __int64)> CopyProgress;
 
 	/// ファイル属性。組み合わせで指定する。
 	struct Attributes {
@@ -121,6 +130,9 @@ public:
 	/// ファイルを列挙するイテレータ。再帰検索はサポートしない。再帰検索をするにはスタックなどの処理が必要になるのでそれならば getFiles で配列に入れたほうが早いだろう。
 	struct FilesIterator;
 
+	/// ファイルまたはディレクトリの情報のスナップショット。
+	class Info;
+
 
 	/// アクセス権限がなかった。あるいは異なるボリュームに移動しようとした。
 	class AccessDeniedException : public Exception {};
@@ -143,25 +155,31 @@ public:
 	/// 他スレッドとの Share アクセス競合があった。あるいは移動先が自分のサブディレクトリだった。
 	class SharingViolationException : public Exception {};
 
-	/// パス文字列の最大長。
+	/// Win32 API の MAX_PATH。パスの長さはこれを越えても良い。
 	static const int maxPath = 260;
 
 public:
 	/// 空文字列のパスから作成。
 	File();
 	File(const File& value);
+	File(File&& value);
 	/// ファイルパスから作成。
 	File(StringRange path);
 	/// ディレクトリ名とファイル名から作成。
 	File(StringRange direcotryName, StringRange fileName);
+	~File();
 	File& operator=(const File& value);
+	File& operator=(File&& value);
 
 public:
 	/// ファイル属性。
 	File::Attributes attributes() const;
 	void attributes(File::Attributes value);
-	/// ファイルをコピーする。
+	/// ファイルをコピーする。ディレクトリの場合は中身を再帰的にコピーする。
 	void copyTo(StringRange destPath, bool overwrite = false) const;
+	/// ファイルをコピーする。ディレクトリの場合は先にディレクトリを全て作成してから、threadCount に 2 以上を指定すれば最大 threadCount 個のスレッドでファイルを並行してコピーする。
+	/// 256MB 以上のファイルはシステムキャッシュを経由せずにコピーする。progress はコピーの途中で何度か呼び出したスレッドで呼ばれる。progress が例外を投げるとコピーを中断してその例外を投げる。
+	void copyTo(StringRange destPath, bool overwrite, const File::CopyProgress& progress, int threadCount = 1) const;
 	/// ファイルを作成し、ファイルストリームを返す。
 	FileStream create();
 	/// ディレクトリを作成する。
@@ -189,6 +207,10 @@ public:
 	static File getSpecial(File::Special special, File::SpecialOption option = SpecialOption::create);
 	/// エクスプローラ上でこのファイルが表示される時のアイコン。
 	Icon icon() const;
+	/// ファイルの情報を一度の問い合わせでまとめて取得する。
+	File::Info info() const;
+	/// paths のファイルの情報を最大 threadCount 個のスレッドで並行して問い合わせ、paths と同じ順番で返す。存在しないファイルの情報は File::Info::exists が false になる。
+	static std::vector<File::Info, std::allocator<File::Info> > infos(StringRangeArray paths, int threadCount = 4);
 	/// ディレクトリかどうか。存在しない場合は false を返す。
 	bool isDirectory() const;
 	/// ファイルまたはディレクトリを移動する。ディレクトリのボリュームをまたいだ移動はできない。
@@ -227,8 +249,49 @@ public:
 	operator StringRange() const { return StringRange(_path, _pathLength); }
 
 private:
-	wchar_t _path[maxPath];
+	void reserve(int length);
+
+	wchar_t* _path;
 	int _pathLength;
+	int _capacity; // 0 の場合 _path は共有の空文字列を指している
+};
+
+
+
+/// ファイルまたはディレクトリの情報のスナップショット。作成した時点の値を保持し、後でファイルが変更されても変わらない。
+/// 日時は FILETIME と同じ 1601 年 1 月 1 日からの 100 ナノ秒単位の UTC。
+class File::Info {
+public:
+	/// 空のパスの情報を作成。
+	Info();
+	/// 全ての値を指定して作成。
+	Info(const File& file, File::Attributes attributes, __int64 length, __int64 creationTime, __int64 lastAccessTime, __int64 lastWriteTime);
+
+public:
+	/// ファイル属性。
+	File::Attributes attributes() const;
+	/// 作成日時。
+	__int64 creationTime() const;
+	/// 情報を取得したファイル。
+	const File& file() const;
+	/// 情報を取得した時に存在したかどうか。
+	bool exists() const;
+	/// ディレクトリかどうか。
+	bool isDirectory() const;
+	/// 最終アクセス日時。
+	__int64 lastAccessTime() const;
+	/// 最終更新日時。
+	__int64 lastWriteTime() const;
+	/// ファイルのバイト数。ディレクトリは 0。
+	__int64 length() const;
+
+private:
+	File _file;
+	File::Attributes _attributes;
+	__int64 _length;
+	__int64 _creationTime;
+	__int64 _lastAccessTime;
+	__int64 _lastWriteTime;
 };
 
 
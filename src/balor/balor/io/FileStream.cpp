@@ -1,6 +1,8 @@
 ﻿#include "FileStream.hpp"
 
 #include <algorithm>
+#include <climits>
+#include <cstring>
 #include <type_traits>
 #include <utility>
 
@@ -53,6 +55,22 @@ void checkError(DWORD errorCode) {
 		default                      : assert("Failed to file stream function" && false); break;
 	}
 }
+
+
+const int gatherBufferSize = 16 * 1024; // これ以下の readv, writev はスタック上のバッファを経由して一度に読み書きする
+
+
+template<typename Slice>
+int getTotalCount(ArrayRange<const Slice> slices) {
+	int total = 0;
+	for (auto i = slices.begin(), end = slices.end(); i != end; ++i) {
+		assert("Null slice buffer" && (i->buffer || !i->count));
+		assert("Negative slice count" && 0 <= i->count);
+		assert("Slices too large" && i->count <= INT_MAX - total);
+		total += i->count;
+	}
+	return total;
+}
 } // namespace
 
 
@@ -249,6 +267,32 @@ int FileStream::read(void* buffer, int offset, int count) {
 }
 
 
+int FileStream::readv(ArrayRange<const Stream::Slice> slices) {
+	assert("Null _handle" && _handle);
+	assert("read unsupported" && readable());
+
+	const int total = getTotalCount(slices);
+	if (gatherBufferSize < total) {
+		return Stream::readv(slices);
+	}
+	char buffer[gatherBufferSize];
+	DWORD readCount = 0;
+	if (!ReadFile(_handle, buffer, total, &readCount, nullptr)) {
+		checkError(GetLastError());
+	}
+	const char* current = buffer;
+	const char* const last = buffer + readCount;
+	for (auto i = slices.begin(), end = slices.end(); i != end && current != last; ++i) {
+		const int count = std::min(i->count, static_cast<int>(last - current));
+		if (count) {
+			std::memcpy(i->buffer, current, count);
+			current += count;
+		}
+	}
+	return readCount;
+}
+
+
 bool FileStream::readable() const {
 	return (_access & FileStream::Access::read) != 0;
 }
@@ -303,6 +347,30 @@ void FileStream::write(const void* buffer, int offset, int count) {
 }
 
 
+void FileStream::writev(ArrayRange<const Stream::ConstSlice> slices) {
+	assert("Null _handle" && _handle);
+	assert("write unsupported" && writable());
+
+	const int total = getTotalCount(slices);
+	if (gatherBufferSize < total) {
+		Stream::writev(slices);
+		return;
+	}
+	char buffer[gatherBufferSize];
+	char* current = buffer;
+	for (auto i = slices.begin(), end = slices.end(); i != end; ++i) {
+		if (i->count) {
+			std::memcpy(current, i->buffer, i->count);
+			current += i->count;
+		}
+	}
+	DWORD writeCount = 0;
+	if (!WriteFile(_handle, buffer, total, &writeCount, nullptr)) {
+		checkError(GetLastError());
+	}
+}
+
+
 bool FileStream::writable() const {
 	return (_access & FileStream::Access::write) != 0;
 }
@@ -13,6 +13,7 @@ namespace balor {
 
 /**
  * Win32 API のファイルアクセス機能をサポートするストリーム。
+ * read, write の度にシステムコールが発生するので、小さな読み書きを繰り返す場合は BufferedStream でラップすると良い。
  */
 class FileStream : public Stream {
 public:
@@ -126,11 +127,15 @@ public:
 	virtual void position(__int64 value);
 	virtual int read(void* buffer, int offset, int count);
 	virtual bool readable() const;
+	/// ReadFileScatter はバッファリングしないハンドルとページ単位のバッファが必要なので、小さな読み込みは一度の ReadFile で読んでから分配する。
+	virtual int readv(ArrayRange<const Stream::Slice> slices);
 	virtual __int64 skip(__int64 offset);
 	/// ファイルの終端に移動する。
 	virtual __int64 skipToEnd();
 	virtual void write(const void* buffer, int offset, int count);
 	virtual bool writable() const;
+	/// WriteFileGather は ReadFileScatter と同じ理由で使えないので、小さな書き込みは連結して一度の WriteFile で書き込む。
+	virtual void writev(ArrayRange<const Stream::ConstSlice> slices);
 
 public:
 	/// HANDLE への自動変換 ＆ null チェック用
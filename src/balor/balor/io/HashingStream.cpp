@@ -0,0 +1,514 @@
+﻿#include "HashingStream.hpp"
+
+#include <cstring>
+#include <utility>
+#if defined(_M_X64)
+#include <intrin.h>
+#endif
+
+#include <balor/system/windows.hpp> // IsBadReadPtr, IsBadWritePtr の assert
+#include <balor/test/verify.hpp>
+
+
+namespace balor {
+	namespace io {
+
+using std::move;
+
+
+namespace {
+#if defined(_M_X64)
+#define BALOR_CRC32C_HARDWARE
+#endif
+
+const unsigned int crc32cPolynomial = 0x82f63b78; // 0x1edc6f41 のビットを反転したもの
+const int longLength = 8192; // 三つに分けて並行して計算する範囲の長さ
+const int shortLength = 256;
+
+
+inline unsigned int read32(const unsigned char* pointer) {
+	unsigned int value;
+	std::memcpy(&value, pointer, sizeof(value));
+	return value;
+}
+
+
+inline unsigned __int64 read64(const unsigned char* pointer) {
+	unsigned __int64 value;
+	std::memcpy(&value, pointer, sizeof(value));
+	return value;
+}
+
+
+unsigned int multiply(const unsigned int* matrix, unsigned int vector) { // GF(2) の 32x32 行列とベクトルの積
+	unsigned int result = 0;
+	for (; vector; vector >>= 1, ++matrix) {
+		if (vector & 1) {
+			result ^= *matrix;
+		}
+	}
+	return result;
+}
+
+
+void square(unsigned int* result, const unsigned int* matrix) {
+	for (int i = 0; i < 32; ++i) {
+		result[i] = multiply(matrix, matrix[i]);
+	}
+}
+
+
+void createShiftTable(unsigned int (&table)[4][256], int length) { // CRC の後ろに length バイトの 0 を加える演算のテーブルを作る。length は 2 のべき乗
+	unsigned int odd[32]; // 1 ビットの 0 を加える演算から始めて二乗を繰り返す
+	unsigned int even[32];
+	odd[0] = crc32cPolynomial;
+	for (int i = 1; i < 32; ++i) {
+		odd[i] = 1u << (i - 1);
+	}
+	square(even, odd); // 2 ビット
+	square(odd, even); // 4 ビット
+	const unsigned int* op = nullptr;
+	for (int bytes = 1; ; bytes <<= 1) {
+		if (bytes & 0x55555555) {
+			square(even, odd);
+			op = even;
+		} else {
+			square(odd, even);
+			op = odd;
+		}
+		if (bytes == length) {
+			break;
+		}
+	}
+	for (unsigned int i = 0; i < 256; ++i) {
+		table[0][i] = multiply(op, i);
+		table[1][i] = multiply(op, i << 8);
+		table[2][i] = multiply(op, i << 16);
+		table[3][i] = multiply(op, i << 24);
+	}
+}
+
+
+inline unsigned int shift(const unsigned int (&table)[4][256], unsigned int crc) {
+	return table[0][crc & 0xff] ^ table[1][(crc >> 8) & 0xff] ^ table[2][(crc >> 16) & 0xff] ^ table[3][crc >> 24];
+}
+
+
+bool supportsCrc32Instruction() {
+#if defined(BALOR_CRC32C_HARDWARE)
+	int info[4];
+	__cpuid(info, 1);
+	return (info[2] & (1 << 20)) != 0;
+#else
+	return false;
+#endif
+}
+
+
+struct Crc32cTables { // 静的初期化で作るので、他の静的オブジェクトの初期化中には crc32c を呼ばないこと
+	Crc32cTables() : hardware(supportsCrc32Instruction()) {
+		for (unsigned int i = 0; i < 256; ++i) {
+			unsigned int crc = i;
+			for (int j = 0; j < 8; ++j) {
+				crc = crc & 1 ? (crc >> 1) ^ crc32cPolynomial : crc >> 1;
+			}
+			slicing[0][i] = crc;
+		}
+		for (int i = 0; i < 256; ++i) {
+			for (int j = 1; j < 8; ++j) {
+				slicing[j][i] = (slicing[j - 1][i] >> 8) ^ slicing[0][slicing[j - 1][i] & 0xff];
+			}
+		}
+		createShiftTable(longShift, longLength);
+		createShiftTable(shortShift, shortLength);
+	}
+
+	unsigned int slicing[8][256];
+	unsigned int longShift[4][256];
+	unsigned int shortShift[4][256];
+	bool hardware;
+};
+const Crc32cTables tables;
+
+
+unsigned int crc32cSoftware(unsigned int crc, const unsigned char* current, const unsigned char* end) { // slicing-by-8
+	const unsigned int (&t)[8][256] = tables.slicing;
+	for (; 8 <= end - current; current += 8) {
+		crc ^= read32(current);
+		const unsigned int high = read32(current + 4);
+		crc = t[7][crc & 0xff] ^ t[6][(crc >> 8) & 0xff] ^ t[5][(crc >> 16) & 0xff] ^ t[4][crc >> 24]
+			^ t[3][high & 0xff] ^ t[2][(high >> 8) & 0xff] ^ t[1][(high >> 16) & 0xff] ^ t[0][high >> 24];
+	}
+	for (; current < end; ++current) {
+		crc = t[0][(crc ^ *current) & 0xff] ^ (crc >> 8);
+	}
+	return crc;
+}
+
+
+#if defined(BALOR_CRC32C_HARDWARE)
+unsigned int crc32cHardware(unsigned int crc, const unsigned char* current, const unsigned char* end) {
+	// crc32 命令は 3 サイクルの遅延があるが毎サイクル発行できるので、三つの範囲を並行して計算して後で連結する
+	unsigned __int64 crc0 = crc;
+	for (; current < end && (reinterpret_cast<size_t>(current) & 7); ++current) {
+		crc0 = _mm_crc32_u8(static_cast<unsigned int>(crc0), *current);
+	}
+	while (longLength * 3 <= end - current) {
+		unsigned __int64 crc1 = 0;
+		unsigned __int64 crc2 = 0;
+		for (const unsigned char* blockEnd = current + longLength; current < blockEnd; current += 8) {
+			crc0 = _mm_crc32_u64(crc0, read64(current));
+			crc1 = _mm_crc32_u64(crc1, read64(current + longLength));
+			crc2 = _mm_crc32_u64(crc2, read64(current + longLength * 2));
+		}
+		crc0 = shift(tables.longShift, static_cast<unsigned int>(crc0)) ^ static_cast<unsigned int>(crc1);
+		crc0 = shift(tables.longShift, static_cast<unsigned int>(crc0)) ^ static_cast<unsigned int>(crc2);
+		current += longLength * 2;
+	}
+	while (shortLength * 3 <= end - current) {
+		unsigned __int64 crc1 = 0;
+		unsigned __int64 crc2 = 0;
+		for (const unsigned char* blockEnd = current + shortLength; current < blockEnd; current += 8) {
+			crc0 = _mm_crc32_u64(crc0, read64(current));
+			crc1 = _mm_crc32_u64(crc1, read64(current + shortLength));
+			crc2 = _mm_crc32_u64(crc2, read64(current + shortLength * 2));
+		}
+		crc0 = shift(tables.shortShift, static_cast<unsigned int>(crc0)) ^ static_cast<unsigned int>(crc1);
+		crc0 = shift(tables.shortShift, static_cast<unsigned int>(crc0)) ^ static_cast<unsigned int>(crc2);
+		current += shortLength * 2;
+	}
+	for (; 8 <= end - current; current += 8) {
+		crc0 = _mm_crc32_u64(crc0, read64(current));
+	}
+	for (; current < end; ++current) {
+		crc0 = _mm_crc32_u8(static_cast<unsigned int>(crc0), *current);
+	}
+	return static_cast<unsigned int>(crc0);
+}
+#endif
+
+
+unsigned int updateCrc32c(unsigned int crc, const unsigned char* data, int length) {
+	crc = ~crc;
+#if defined(BALOR_CRC32C_HARDWARE)
+	if (tables.hardware) {
+		return ~crc32cHardware(crc, data, data + length);
+	}
+#endif
+	return ~crc32cSoftware(crc, data, data + length);
+}
+
+
+// xxHash64
+const unsigned __int64 prime1 = 11400714785074694791ULL;
+const unsigned __int64 prime2 = 14029467366897019727ULL;
+const unsigned __int64 prime3 =  1609587929392839161ULL;
+const unsigned __int64 prime4 =  9650029242287828579ULL;
+const unsigned __int64 prime5 =  2870177450012600261ULL;
+
+
+inline unsigned __int64 rotateLeft(unsigned __int64 value, int count) {
+	return (value << count) | (value >> (64 - count));
+}
+
+
+inline unsigned __int64 accumulate(unsigned __int64 accumulator, unsigned __int64 input) {
+	accumulator += input * prime2;
+	return rotateLeft(accumulator, 31) * prime1;
+}
+
+
+inline unsigned __int64 mergeRound(unsigned __int64 hash, unsigned __int64 accumulator) {
+	hash ^= accumulate(0, accumulator);
+	return hash * prime1 + prime4;
+}
+
+
+void initializeAccumulators(unsigned __int64 (&accumulators)[4], unsigned __int64 seed) {
+	accumulators[0] = seed + prime1 + prime2;
+	accumulators[1] = seed + prime2;
+	accumulators[2] = seed;
+	accumulators[3] = seed - prime1;
+}
+
+
+const unsigned char* consumeStripes(unsigned __int64 (&accumulators)[4], const unsigned char* current, const unsigned char* end) { // 32 バイト単位で処理して残りの先頭を返す
+	unsigned __int64 v1 = accumulators[0];
+	unsigned __int64 v2 = accumulators[1];
+	unsigned __int64 v3 = accumulators[2];
+	unsigned __int64 v4 = accumulators[3];
+	for (; 32 <= end - current; current += 32) {
+		v1 = accumulate(v1, read64(current));
+		v2 = accumulate(v2, read64(current + 8));
+		v3 = accumulate(v3, read64(current + 16));
+		v4 = accumulate(v4, read64(current + 24));
+	}
+	accumulators[0] = v1;
+	accumulators[1] = v2;
+	accumulators[2] = v3;
+	accumulators[3] = v4;
+	return current;
+}
+
+
+unsigned __int64 digest(const unsigned __int64 (&accumulators)[4], unsigned __int64 seed, unsigned __int64 totalLength, const unsigned char* current, const unsigned char* end) {
+	unsigned __int64 hash;
+	if (32 <= totalLength) {
+		hash = rotateLeft(accumulators[0], 1) + rotateLeft(accumulators[1], 7) + rotateLeft(accumulators[2], 12) + rotateLeft(accumulators[3], 18);
+		for (int i = 0; i < 4; ++i) {
+			hash = mergeRound(hash, accumulators[i]);
+		}
+	} else {
+		hash = seed + prime5;
+	}
+	hash += totalLength;
+	for (; 8 <= end - current; current += 8) {
+		hash ^= accumulate(0, read64(current));
+		hash = rotateLeft(hash, 27) * prime1 + prime4;
+	}
+	if (4 <= end - current) {
+		hash ^= read32(current) * prime1;
+		hash = rotateLeft(hash, 23) * prime2 + prime3;
+		current += 4;
+	}
+	for (; current < end; ++current) {
+		hash ^= *current * prime5;
+		hash = rotateLeft(hash, 11) * prime1;
+	}
+	hash ^= hash >> 33;
+	hash *= prime2;
+	hash ^= hash >> 29;
+	hash *= prime3;
+	hash ^= hash >> 32;
+	return hash;
+}
+} // namespace
+
+
+
+bool HashingStream::Algorithm::_validate(Algorithm value) {
+	return crc32c <= value && value <= xxhash64;
+}
+
+
+
+HashingStream::HashingStream(Stream& stream, HashingStream::Algorithm algorithm, unsigned __int64 seed)
+	: _stream(&stream)
+	, _algorithm(algorithm)
+	, _seed(seed) {
+	assert("Invalid HashingStream::Algorithm" && Algorithm::_validate(algorithm));
+
+	reset();
+}
+
+
+HashingStream::HashingStream(HashingStream&& value)
+	: _stream(value._stream)
+	, _algorithm(value._algorithm)
+	, _seed(value._seed)
+	, _hashedLength(value._hashedLength)
+	, _crc(value._crc)
+	, _pendingLength(value._pendingLength) {
+	std::memcpy(_accumulators, value._accumulators, sizeof(_accumulators));
+	std::memcpy(_pending, value._pending, sizeof(_pending));
+	value._stream = nullptr;
+}
+
+
+HashingStream::~HashingStream() {
+}
+
+
+HashingStream& HashingStream::operator=(HashingStream&& value) {
+	if (&value != this) {
+		this->~HashingStream();
+		new (this) HashingStream(move(value));
+	}
+	return *this;
+}
+
+
+HashingStream::Algorithm HashingStream::algorithm() const {
+	return _algorithm;
+}
+
+
+unsigned int HashingStream::crc32c(ArrayRange<const unsigned char> data, unsigned int crc) {
+	return updateCrc32c(crc, data.begin(), data.length());
+}
+
+
+bool HashingStream::crc32cAccelerated() {
+#if defined(BALOR_CRC32C_HARDWARE)
+	return tables.hardware;
+#else
+	return false;
+#endif
+}
+
+
+void HashingStream::flush() {
+	assert("Null stream" && _stream);
+	_stream->flush();
+}
+
+
+unsigned __int64 HashingStream::hash() const {
+	if (_algorithm == Algorithm::crc32c) {
+		return _crc;
+	}
+	return digest(_accumulators, _seed, _hashedLength, _pending, _pending + _pendingLength);
+}
+
+
+__int64 HashingStream::hashedLength() const {
+	return _hashedLength;
+}
+
+
+__int64 HashingStream::length() const {
+	assert("Null stream" && _stream);
+	return _stream->length();
+}
+
+
+__int64 HashingStream::position() const {
+	assert("Null stream" && _stream);
+	return _stream->position();
+}
+
+
+void HashingStream::position(__int64 value) {
+	assert("Null stream" && _stream);
+	_stream->position(value);
+}
+
+
+int HashingStream::read(void* buffer, int offset, int count) {
+	assert("Null stream" && _stream);
+	assert("Null buffer" && buffer);
+	assert("Negative offset" && 0 <= offset);
+	assert("Negative count" && 0 <= count);
+	assert("buffer is bad write pointer" && !IsBadWritePtr(buffer, offset + count));
+
+	const int result = _stream->read(buffer, offset, count);
+	update(static_cast<char*>(buffer) + offset, result);
+	return result;
+}
+
+
+bool HashingStream::readable() const {
+	assert("Null stream" && _stream);
+	return _stream->readable();
+}
+
+
+int HashingStream::readv(ArrayRange<const Stream::Slice> slices) {
+	assert("Null stream" && _stream);
+
+	int remaining = _stream->readv(slices);
+	const int result = remaining;
+	for (auto i = slices.begin(), end = slices.end(); i != end && remaining; ++i) { // 読み込んだ範囲だけを順に加える
+		const int count = remaining < i->count ? remaining : i->count;
+		update(i->buffer, count);
+		remaining -= count;
+	}
+	return result;
+}
+
+
+void HashingStream::reset() {
+	_hashedLength = 0;
+	_crc = static_cast<unsigned int>(_seed);
+	initializeAccumulators(_accumulators, _seed);
+	_pendingLength = 0;
+}
+
+
+unsigned __int64 HashingStream::seed() const {
+	return _seed;
+}
+
+
+__int64 HashingStream::skip(__int64 offset) {
+	assert("Null stream" && _stream);
+	return _stream->skip(offset);
+}
+
+
+Stream& HashingStream::stream() const {
+	assert("Null stream" && _stream);
+	return *_stream;
+}
+
+
+void HashingStream::write(const void* buffer, int offset, int count) {
+	assert("Null stream" && _stream);
+	assert("Null buffer" && buffer);
+	assert("Negative offset" && 0 <= offset);
+	assert("Negative count" && 0 <= count);
+	assert("buffer is bad read pointer" && !IsBadReadPtr(buffer, offset + count));
+
+	_stream->write(buffer, offset, count);
+	update(static_cast<const char*>(buffer) + offset, count); // 書き込みに失敗した範囲は加えない
+}
+
+
+bool HashingStream::writable() const {
+	assert("Null stream" && _stream);
+	return _stream->writable();
+}
+
+
+void HashingStream::writev(ArrayRange<const Stream::ConstSlice> slices) {
+	assert("Null stream" && _stream);
+
+	_stream->writev(slices);
+	for (auto i = slices.begin(), end = slices.end(); i != end; ++i) {
+		update(i->buffer, i->count);
+	}
+}
+
+
+unsigned __int64 HashingStream::xxhash64(ArrayRange<const unsigned char> data, unsigned __int64 seed) {
+	unsigned __int64 accumulators[4];
+	initializeAccumulators(accumulators, seed);
+	const unsigned char* rest = consumeStripes(accumulators, data.begin(), data.end());
+	return digest(accumulators, seed, data.length(), rest, data.end());
+}
+
+
+void HashingStream::update(const void* buffer, int count) {
+	if (!count) {
+		return;
+	}
+	const unsigned char* current = static_cast<const unsigned char*>(buffer);
+	const unsigned char* const end = current + count;
+	_hashedLength += count;
+	if (_algorithm == Algorithm::crc32c) {
+		_crc = updateCrc32c(_crc, current, count);
+		return;
+	}
+
+	if (_pendingLength) { // 前回の残りを 32 バイトにしてから処理する
+		const int copyCount = 32 - _pendingLength < count ? 32 - _pendingLength : count;
+		std::memcpy(_pending + _pendingLength, current, copyCount);
+		_pendingLength += copyCount;
+		current += copyCount;
+		if (_pendingLength < 32) {
+			return;
+		}
+		consumeStripes(_accumulators, _pending, _pending + 32);
+		_pendingLength = 0;
+	}
+	current = consumeStripes(_accumulators, current, end);
+	_pendingLength = static_cast<int>(end - current);
+	if (_pendingLength) {
+		std::memcpy(_pending, current, _pendingLength);
+	}
+}
+
+
+
+	}
+}
@@ -0,0 +1,103 @@
+﻿#pragma once
+
+#include <balor/io/Stream.hpp>
+#include <balor/ArrayRange.hpp>
+#include <balor/Enum.hpp>
+
+
+namespace balor {
+	namespace io {
+
+
+
+/**
+ * 他のストリームに読み書きするデータのハッシュ値を読み書きしながら計算するストリーム。
+ *
+ * 書き込んだファイルを読み直してハッシュ値を計算しなくても、書き込みと同時に計算できる。読み込みも同様。
+ * read, readv で読み込んだバイトと write, writev で書き込んだバイトを通った順にハッシュ値に加える。position や skip で移動した範囲は加えない。
+ * アルゴリズムは CRC32C と xxHash64 から選ぶ。CRC32C は SSE4.2 の crc32 命令が使えれば三つの範囲を並行して計算し、使えなければテーブルで計算する。
+ * xxHash64 は命令セットによらず CRC32C のテーブル版より速い。値はどちらも他の実装と互換性がある。
+ * ストリームを通さずにメモリ上のデータのハッシュ値を計算する場合は crc32c, xxhash64 関数を使う。
+ * ラップしたストリームは HashingStream より後に破棄すること。
+ *
+ * <h3>・サンプルコード</h3>
+ * <pre><code>
+	FileStream file(L"data.bin", FileStream::Mode::create, FileStream::Access::write);
+	HashingStream stream(file);
+	memoryStream.position(0);
+	memoryStream.copyTo(stream);
+	Debug::writeLine(String() + L"crc32c " + stream.hash());
+ * </code></pre>
+ */
+class HashingStream : public Stream {
+public:
+	// オーバーロード関数のオーバーライド用
+	using Stream::read;
+	using Stream::write;
+
+	/// ハッシュ関数の種類。
+	struct Algorithm {
+		enum _enum {
+			crc32c   = 0, /// CRC-32C (Castagnoli)。iSCSI や ext4 などと同じ値になる。
+			xxhash64 = 1, /// xxHash の 64 ビット版。
+		};
+		BALOR_NAMED_ENUM_MEMBERS(Algorithm);
+	};
+
+public:
+	/// ラップするストリーム、アルゴリズム、初期値から作成。CRC32C の初期値は下位 32 ビットを使う。
+	explicit HashingStream(Stream& stream, HashingStream::Algorithm algorithm = Algorithm::crc32c, unsigned __int64 seed = 0);
+	HashingStream(HashingStream&& value);
+	virtual ~HashingStream();
+
+	HashingStream& operator=(HashingStream&& value);
+
+public:
+	/// アルゴリズム。
+	HashingStream::Algorithm algorithm() const;
+	/// data の CRC32C を返す。crc に前の範囲の結果を渡せば続きから計算する。
+	static unsigned int crc32c(ArrayRange<const unsigned char> data, unsigned int crc = 0);
+	/// crc32c 関数が SSE4.2 の crc32 命令を使うかどうか。
+	static bool crc32cAccelerated();
+	virtual void flush();
+	/// これまでに通ったバイトのハッシュ値。CRC32C の場合は下位 32 ビット。計算の状態は変えないので何度でも呼べる。
+	unsigned __int64 hash() const;
+	/// ハッシュ値に加えたバイト数。
+	__int64 hashedLength() const;
+	virtual __int64 length() const;
+	virtual __int64 position() const;
+	virtual void position(__int64 value);
+	virtual int read(void* buffer, int offset, int count);
+	virtual bool readable() const;
+	virtual int readv(ArrayRange<const Stream::Slice> slices);
+	/// ハッシュ値を初期値に戻す。
+	void reset();
+	/// 初期値。
+	unsigned __int64 seed() const;
+	/// 実際に移動したバイト数を返す。移動した範囲はハッシュ値に加えない。
+	virtual __int64 skip(__int64 offset);
+	/// ラップしたストリーム。
+	Stream& stream() const;
+	virtual void write(const void* buffer, int offset, int count);
+	virtual bool writable() const;
+	virtual void writev(ArrayRange<const Stream::ConstSlice> slices);
+	/// data の xxHash64 を返す。
+	static unsigned __int64 xxhash64(ArrayRange<const unsigned char> data, unsigned __int64 seed = 0);
+
+private:
+	void update(const void* buffer, int count);
+
+	Stream* _stream;
+	Algorithm _algorithm;
+	unsigned __int64 _seed;
+	__int64 _hashedLength;
+	unsigned int _crc;
+	unsigned __int64 _accumulators[4]; // xxHash64 の四つのレーン
+	unsigned char _pending[32]; // xxHash64 で 32 バイトに満たない残り
+	int _pendingLength;
+};
+
+
+
+	}
+}
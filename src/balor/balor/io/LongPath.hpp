@@ -0,0 +1,48 @@
+﻿#pragma once
+
+#include <cwchar>
+#include <string>
+
+#include <balor/io/File.hpp>
+
+
+namespace balor {
+	namespace io {
+		namespace detail {
+
+
+
+/// File や DirectoryWalker の実装で使う。パスが 248 文字以上の長さの場合は \\?\ を付けた絶対パスにして Win32 API に渡す。
+/// CreateDirectoryW は 8.3 形式のファイル名を入れる余地を残して MAX_PATH - 12 文字から失敗するので MAX_PATH ではなく 248 文字で切り替える。
+class LongPath {
+public:
+	/// \\?\ を付けるパスの長さ。
+	static const int threshold = 248;
+
+	explicit LongPath(const File& file) : _path(file.path()) {
+		if (threshold <= file.pathLength() && std::wcsncmp(_path, L"\\\\?\\", 4) != 0) {
+			const File full = file.fullPathFile();
+			if (full.path()[0] == L'\\' && full.path()[1] == L'\\') { // UNC パス
+				_extended = std::wstring(L"\\\\?\\UNC\\") + (full.path() + 2);
+			} else {
+				_extended = std::wstring(L"\\\\?\\") + full.path();
+			}
+			_path = _extended.c_str();
+		}
+	}
+
+	const wchar_t* c_str() const { return _path; }
+
+private:
+	LongPath(const LongPath& );
+	LongPath& operator=(const LongPath& );
+
+	const wchar_t* _path;
+	std::wstring _extended;
+};
+
+
+
+		}
+	}
+}
@@ -0,0 +1,431 @@
+﻿#include "MappedFile.hpp"
+
+#include <algorithm>
+#include <climits>
+#include <cstring>
+#include <utility>
+
+#include <balor/system/windows.hpp>
+#include <balor/test/verify.hpp>
+
+
+namespace balor {
+	namespace io {
+
+using std::min;
+using std::move;
+
+
+namespace {
+void checkError(DWORD errorCode) {
+	switch (errorCode) {
+		case ERROR_FILE_NOT_FOUND     :
+		case ERROR_PATH_NOT_FOUND     : throw MappedFile::NotFoundException();
+		case ERROR_ACCESS_DENIED      : throw MappedFile::AccessDeniedException();
+		case ERROR_SHARING_VIOLATION  : throw MappedFile::SharingViolationException();
+		case ERROR_NOT_ENOUGH_MEMORY  :
+		case ERROR_COMMITMENT_LIMIT   : throw MappedFile::AddressSpaceExhaustedException();
+		default                       : assert("Failed to mapped file function" && false); break;
+	}
+}
+
+
+struct MemoryRangeEntry { // WIN32_MEMORY_RANGE_ENTRY は _WIN32_WINNT が Windows 8 以降でないと定義されない
+	void* virtualAddress;
+	SIZE_T numberOfBytes;
+};
+typedef BOOL (WINAPI *PrefetchVirtualMemoryFunction)(HANDLE, ULONG_PTR, MemoryRangeEntry*, ULONG);
+
+
+PrefetchVirtualMemoryFunction getPrefetchVirtualMemory() {
+	static PrefetchVirtualMemoryFunction prefetchVirtualMemory = reinterpret_cast<PrefetchVirtualMemoryFunction>(GetProcAddress(GetModuleHandleW(L"kernel32.dll"), "PrefetchVirtualMemory"));
+	return prefetchVirtualMemory;
+}
+
+
+PrefetchVirtualMemoryFunction prefetchVirtualMemory = getPrefetchVirtualMemory(); // マルチスレッドになるまえに初期化されることを保証する
+
+
+int getGranularity() {
+	static int granularity = 0;
+	if (!granularity) {
+		SYSTEM_INFO info;
+		GetSystemInfo(&info);
+		granularity = static_cast<int>(info.dwAllocationGranularity);
+	}
+	return granularity;
+}
+
+
+int allocationGranularity = getGranularity(); // マルチスレッドになるまえに初期化されることを保証する
+
+
+void advise(void* address, std::size_t length, MappedFile::Hint hint) {
+	if (hint != MappedFile::Hint::sequential && hint != MappedFile::Hint::willNeed) {
+		return;
+	}
+	PrefetchVirtualMemoryFunction function = getPrefetchVirtualMemory();
+	if (function) { // Windows 8 より前では何もしない
+		MemoryRangeEntry entry = {address, length};
+		function(GetCurrentProcess(), 1, &entry, 0);
+	}
+}
+} // namespace
+
+
+bool MappedFile::Hint::_validate(Hint value) {
+	return normal <= value && value <= willNeed;
+}
+
+
+
+MappedFile::View::View()
+	: _address(nullptr)
+	, _mappedLength(0)
+	, _begin(nullptr)
+	, _length(0)
+	, _offset(0) {
+}
+
+
+MappedFile::View::View(void* address, std::size_t mappedLength, const unsigned char* begin, int length, __int64 offset)
+	: _address(address)
+	, _mappedLength(mappedLength)
+	, _begin(begin)
+	, _length(length)
+	, _offset(offset) {
+}
+
+
+MappedFile::View::View(View&& value)
+	: _address(value._address)
+	, _mappedLength(value._mappedLength)
+	, _begin(value._begin)
+	, _length(value._length)
+	, _offset(value._offset) {
+	value._address = nullptr;
+	value._mappedLength = 0;
+	value._begin = nullptr;
+	value._length = 0;
+}
+
+
+MappedFile::View::~View() {
+	if (_address) {
+		verify(UnmapViewOfFile(_address));
+		//_address = nullptr;
+	}
+}
+
+
+MappedFile::View& MappedFile::View::operator=(View&& value) {
+	if (&value != this) {
+		this->~View();
+		new (this) View(move(value));
+	}
+	return *this;
+}
+
+
+void MappedFile::View::hint(MappedFile::Hint value) const {
+	assert("Invalid MappedFile::Hint" && Hint::_validate(value));
+
+	if (_address) {
+		advise(_address, _mappedLength, value);
+	}
+}
+
+
+const unsigned char& MappedFile::View::operator[](int index) const {
+	assert("index out of range" && 0 <= index);
+	assert("index out of range" && index < _length);
+	return _begin[index];
+}
+
+
+
+MappedFile::MappedFile() : _handle(nullptr), _mapping(nullptr), _length(0) {
+}
+
+
+MappedFile::MappedFile(StringRange path, MappedFile::Hint hint) : _handle(nullptr), _mapping(nullptr), _length(0) {
+	assert("Empty path" && !path.empty());
+	assert("Invalid MappedFile::Hint" && Hint::_validate(hint));
+
+	const DWORD flags = hint == Hint::sequential ? FILE_FLAG_SEQUENTIAL_SCAN
+					  : hint == Hint::random     ? FILE_FLAG_RANDOM_ACCESS
+					  : FILE_ATTRIBUTE_NORMAL;
+	HANDLE handle = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, flags, nullptr);
+	if (handle == INVALID_HANDLE_VALUE) {
+		checkError(GetLastError());
+	}
+	_handle = handle;
+
+	LARGE_INTEGER size;
+	size.QuadPart = 0;
+	if (!GetFileSizeEx(_handle, &size)) {
+		const DWORD errorCode = GetLastError();
+		verify(CloseHandle(_handle));
+		_handle = nullptr;
+		checkError(errorCode);
+	}
+	_length = size.QuadPart;
+
+	if (_length) { // 長さ０のファイルはマップできない
+		_mapping = CreateFileMappingW(_handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (!_mapping) {
+			const DWORD errorCode = GetLastError();
+			verify(CloseHandle(_handle));
+			_handle = nullptr;
+			checkError(errorCode);
+		}
+	}
+}
+
+
+MappedFile::MappedFile(MappedFile&& value) : _handle(value._handle), _mapping(value._mapping), _length(value._length) {
+	value._handle = nullptr;
+	value._mapping = nullptr;
+	value._length = 0;
+}
+
+
+MappedFile::~MappedFile() {
+	if (_mapping) {
+		verify(CloseHandle(_mapping));
+		//_mapping = nullptr;
+	}
+	if (_handle) {
+		verify(CloseHandle(_handle));
+		//_handle = nullptr;
+	}
+}
+
+
+MappedFile& MappedFile::operator=(MappedFile&& value) {
+	if (&value != this) {
+		this->~MappedFile();
+		new (this) MappedFile(move(value));
+	}
+	return *this;
+}
+
+
+int MappedFile::granularity() {
+	return getGranularity();
+}
+
+
+__int64 MappedFile::length() const {
+	assert("Null handle" && *this);
+	return _length;
+}
+
+
+MappedFile::View MappedFile::view(MappedFile::Hint hint) const {
+	assert("Null handle" && *this);
+	assert("File too large" && _length <= INT_MAX);
+	return view(0, static_cast<int>(_length), hint);
+}
+
+
+MappedFile::View MappedFile::view(__int64 offset, int length, MappedFile::Hint hint) const {
+	assert("Null handle" && *this);
+	assert("Negative offset" && 0 <= offset);
+	assert("Negative length" && 0 <= length);
+	assert("offset + length out of range" && offset + length <= _length);
+	assert("Invalid MappedFile::Hint" && Hint::_validate(hint));
+
+	if (!length) {
+		return View(nullptr, 0, nullptr, 0, offset);
+	}
+	const __int64 mapOffset = offset - offset % granularity();
+	const std::size_t mappedLength = static_cast<std::size_t>(offset - mapOffset) + static_cast<std::size_t>(length);
+	void* address = MapViewOfFile(_mapping, FILE_MAP_READ, static_cast<DWORD>(mapOffset >> 32), static_cast<DWORD>(mapOffset & 0xffffffff), mappedLength);
+	if (!address) {
+		checkError(GetLastError());
+	}
+	View result(address, mappedLength, static_cast<const unsigned char*>(address) + (offset - mapOffset), length, offset);
+	advise(address, mappedLength, hint);
+	return result;
+}
+
+
+MappedFile::operator bool() const {
+	return _handle != nullptr;
+}
+
+
+
+MappedFileStream::MappedFileStream()
+	: _file(nullptr)
+	, _position(0)
+	, _windowSize(0)
+	, _hint(MappedFile::Hint::normal) {
+}
+
+
+MappedFileStream::MappedFileStream(MappedFile& file, int windowSize, MappedFile::Hint hint)
+	: _file(&file)
+	, _position(0)
+	, _windowSize(0)
+	, _hint(hint) {
+	assert("Null file" && file);
+	assert("Invalid windowSize" && 0 < windowSize);
+	assert("Invalid MappedFile::Hint" && MappedFile::Hint::_validate(hint));
+
+	const int granularity = MappedFile::granularity();
+	_windowSize = windowSize <= INT_MAX - granularity + 1 ? ((windowSize + granularity - 1) / granularity) * granularity
+													  : (INT_MAX / granularity) * granularity;
+}
+
+
+MappedFileStream::MappedFileStream(MappedFileStream&& value)
+	: _file(value._file)
+	, _window(move(value._window))
+	, _position(value._position)
+	, _windowSize(value._windowSize)
+	, _hint(value._hint) {
+	value._file = nullptr;
+	value._position = 0;
+}
+
+
+MappedFileStream::~MappedFileStream() {
+}
+
+
+MappedFileStream& MappedFileStream::operator=(MappedFileStream&& value) {
+	if (&value != this) {
+		this->~MappedFileStream();
+		new (this) MappedFileStream(move(value));
+	}
+	return *this;
+}
+
+
+MappedFile& MappedFileStream::file() const {
+	assert("Null file" && _file);
+	return *_file;
+}
+
+
+void MappedFileStream::flush() {
+	assert("Null file" && _file);
+}
+
+
+__int64 MappedFileStream::length() const {
+	assert("Null file" && _file);
+	return _file->length();
+}
+
+
+__int64 MappedFileStream::position() const {
+	assert("Null file" && _file);
+	return _position;
+}
+
+
+void MappedFileStream::position(__int64 value) {
+	assert("Null file" && _file);
+	assert("Negative position" && 0 <= value);
+	_position = value;
+}
+
+
+int MappedFileStream::read() {
+	assert("Null file" && _file);
+
+	if (!moveWindow()) {
+		return -1;
+	}
+	return _window.begin()[_position++ - _window.offset()];
+}
+
+
+int MappedFileStream::read(void* buffer, int offset, int count) {
+	assert("Null file" && _file);
+	assert("Null buffer" && buffer);
+	assert("Negative offset" && 0 <= offset);
+	assert("Negative count" && 0 <= count);
+	assert("buffer is bad write pointer" && !IsBadWritePtr(buffer, offset + count));
+
+	unsigned char* destination = static_cast<unsigned char*>(buffer) + offset;
+	int total = 0;
+	while (total < count && moveWindow()) { // ウィンドウの境界をまたぐ読み込みは分けてコピーする
+		const int windowIndex = static_cast<int>(_position - _window.offset());
+		const int copyCount = min(count - total, _window.length() - windowIndex);
+		std::memcpy(destination + total, _window.begin() + windowIndex, copyCount);
+		total += copyCount;
+		_position += copyCount;
+	}
+	return total;
+}
+
+
+bool MappedFileStream::readable() const {
+	assert("Null file" && _file);
+	return true;
+}
+
+
+ArrayRange<const unsigned char> MappedFileStream::readView(int count) {
+	assert("Null file" && _file);
+	assert("Negative count" && 0 <= count);
+
+	if (!count || !moveWindow()) {
+		return ArrayRange<const unsigned char>(nullptr, 0);
+	}
+	const int windowIndex = static_cast<int>(_position - _window.offset());
+	const int viewCount = min(count, _window.length() - windowIndex);
+	_position += viewCount;
+	return ArrayRange<const unsigned char>(_window.begin() + windowIndex, viewCount);
+}
+
+
+__int64 MappedFileStream::skip(__int64 offset) {
+	assert("Null file" && _file);
+
+	const __int64 oldPosition = _position;
+	_position = std::max(static_cast<__int64>(0), _position + offset);
+	return _position - oldPosition;
+}
+
+
+int MappedFileStream::windowSize() const {
+	assert("Null file" && _file);
+	return _windowSize;
+}
+
+
+void MappedFileStream::write(const void* , int , int ) {
+	assert("write unsupported" && writable());
+}
+
+
+bool MappedFileStream::writable() const {
+	assert("Null file" && _file);
+	return false;
+}
+
+
+bool MappedFileStream::moveWindow() {
+	if (_window.offset() <= _position && _position < _window.offset() + _window.length()) {
+		return true;
+	}
+	const __int64 fileLength = _file->length();
+	if (fileLength <= _position) {
+		return false;
+	}
+	_window = MappedFile::View(); // アドレス空間を使い切らないように新しいウィンドウより先に解除する
+	const __int64 windowOffset = _position - _position % _windowSize;
+	const int windowLength = static_cast<int>(min(static_cast<__int64>(_windowSize), fileLength - windowOffset));
+	_window = _file->view(windowOffset, windowLength, _hint);
+	return true;
+}
+
+
+
+	}
+}
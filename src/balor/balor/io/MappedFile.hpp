@@ -0,0 +1,215 @@
+﻿#pragma once
+
+#include <cstddef>
+
+#include <balor/io/Stream.hpp>
+#include <balor/ArrayRange.hpp>
+#include <balor/Enum.hpp>
+#include <balor/Exception.hpp>
+#include <balor/NonCopyable.hpp>
+#include <balor/StringRange.hpp>
+
+
+namespace balor {
+	namespace io {
+
+
+
+/**
+ * ファイルを MapViewOfFile でメモリにマップして読み出し専用のビューを作成する。
+ *
+ * FileStream::read ではシステムのキャッシュから呼び出し側のバッファへのコピーが発生するが、ビューはシステムのキャッシュを直接参照するのでコピーが発生しない。
+ * view 関数でファイルの任意の範囲を ArrayRange<const unsigned char> として参照できる。範囲の先頭は内部で割り当て粒度に揃えてマップする。
+ * 一つのビューの大きさは int の範囲まで。アドレス空間より大きなファイルはビューを作り直しながら読むか MappedFileStream を使う。
+ * Hint はアクセスパターンをシステムに指示する。ファイルを開く時のフラグと Windows 8 以降の PrefetchVirtualMemory になる。
+ * 長さ０のファイルも開けるが、作成できるのは長さ０のビューだけになる。ファイルの長さは開いた時点のもので、後からファイルが伸びても反映されない。
+ * ビューは MappedFile を破棄した後も有効。
+ * 他のプロセスがファイルを切り詰めるとビューへのアクセスでハードウェア例外が発生するので、書き換えられる可能性のあるファイルには使わないこと。
+ *
+ * <h3>・サンプルコード</h3>
+ * <pre><code>
+	MappedFile file(L"data.bin", MappedFile::Hint::random);
+	MappedFile::View header = file.view(0, 16);
+	ArrayRange<const unsigned char> bytes = header;
+	if (bytes[0] == 'B' && bytes[1] == 'M') {
+		int total = 0;
+		for (auto i = header.begin(), end = header.end(); i != end; ++i) {
+			total += *i;
+		}
+	}
+ * </code></pre>
+ */
+class MappedFile : private NonCopyable {
+public:
+	typedef void* HANDLE;
+
+	/// アクセスパターンのヒント。
+	struct Hint {
+		enum _enum {
+			normal     = 0, /// 特に指示しない。
+			sequential = 1, /// 先頭から順に読む。先読みを積極的に行う。
+			random     = 2, /// ランダムに読む。先読みを抑制する。
+			willNeed   = 3, /// すぐに読む。ビューの範囲を先に読み込んでおく。ファイルを開く時には normal と同じ。
+		};
+		BALOR_NAMED_ENUM_MEMBERS(Hint);
+	};
+
+	/// アクセス権がなかった。
+	class AccessDeniedException : public Exception {};
+
+	/// アドレス空間が足りずにマップできなかった。
+	class AddressSpaceExhaustedException : public Exception {};
+
+	/// ファイルが見つからなかった。
+	class NotFoundException : public Exception {};
+
+	/// 共有方式に反する競合があった。
+	class SharingViolationException : public Exception {};
+
+	/// ファイルのマップした範囲。MappedFile::view 関数で作成し、破棄するとマップを解除する。
+	class View : private NonCopyable {
+		friend MappedFile;
+
+		View(void* address, std::size_t mappedLength, const unsigned char* begin, int length, __int64 offset);
+
+	public:
+		/// 長さ０のビューを作成。
+		View();
+		View(View&& value);
+		/// マップを解除する。
+		~View();
+
+		View& operator=(View&& value);
+
+	public:
+		/// 先頭のポインタ。
+		const unsigned char* begin() const { return _begin; }
+		/// 長さが０かどうか。
+		bool empty() const { return _length == 0; }
+		/// 終端のポインタ。
+		const unsigned char* end() const { return _begin + _length; }
+		/// バイト数。
+		int length() const { return _length; }
+		/// ファイル先頭からの位置。
+		__int64 offset() const { return _offset; }
+		/// 範囲のアクセスパターンをシステムに指示する。
+		void hint(MappedFile::Hint value) const;
+		/// ArrayRange を返す。ArrayRange はビューより先に破棄すること。
+		ArrayRange<const unsigned char> range() const { return ArrayRange<const unsigned char>(_begin, _length); }
+
+	public:
+		/// ArrayRange への変換。
+		operator ArrayRange<const unsigned char>() const { return range(); }
+		/// 指定した位置のバイト。
+		const unsigned char& operator[](int index) const;
+
+	private:
+		void* _address; // マップした先頭。割り当て粒度に揃っている
+		std::size_t _mappedLength;
+		const unsigned char* _begin;
+		int _length;
+		__int64 _offset;
+	};
+
+public:
+	/// ヌルハンドルで作成。
+	MappedFile();
+	/// ファイルを読み込み専用で開く。他のプロセスは読み込みだけできる。
+	explicit MappedFile(StringRange path, MappedFile::Hint hint = Hint::normal);
+	MappedFile(MappedFile&& value);
+	/// ファイルを閉じる。作成したビューはそのまま使える。
+	~MappedFile();
+
+	MappedFile& operator=(MappedFile&& value);
+
+public:
+	/// ビューの先頭を揃える割り当て粒度。
+	static int granularity();
+	/// ファイルのバイト数。
+	__int64 length() const;
+	/// ファイル全体のビューを作成する。ファイルが int の範囲に収まる必要がある。
+	MappedFile::View view(MappedFile::Hint hint = Hint::normal) const;
+	/// ファイルの指定した範囲のビューを作成する。
+	MappedFile::View view(__int64 offset, int length, MappedFile::Hint hint = Hint::normal) const;
+
+public:
+	/// ヌルハンドルでないかどうか。
+	operator bool() const;
+
+private:
+	HANDLE _handle;
+	HANDLE _mapping; // 長さ０のファイルでは nullptr
+	__int64 _length;
+};
+
+
+
+/**
+ * MappedFile を先頭からウィンドウをずらしながらマップして読み込むストリーム。
+ *
+ * 常に現在位置を含む windowSize バイトのウィンドウだけをマップするので、アドレス空間より大きなファイルも読める。
+ * ウィンドウの先頭は MappedFile::granularity() に揃い、ウィンドウを移動する時は新しくマップする前に古いウィンドウのマップを解除する。
+ * read 関数はウィンドウからコピーするだけでシステムコールを呼ばない。readView 関数はコピーせずにウィンドウ内のビューを返す。
+ * 書き込みはできない。MappedFile は MappedFileStream より後に破棄すること。
+ *
+ * <h3>・サンプルコード</h3>
+ * <pre><code>
+	MappedFile file(L"huge.log", MappedFile::Hint::sequential);
+	MappedFileStream stream(file);
+	int lineCount = 0;
+	for (auto bytes = stream.readView(65536); !bytes.empty(); bytes = stream.readView(65536)) {
+		lineCount += std::count(bytes.begin(), bytes.end(), '\n');
+	}
+ * </code></pre>
+ */
+class MappedFileStream : public Stream {
+public:
+	// オーバーロード関数のオーバーライド用
+	using Stream::read;
+	using Stream::write;
+
+public:
+	/// ヌルストリームを作成。
+	MappedFileStream();
+	/// 読み込むファイルとウィンドウの大きさ、各ウィンドウに与えるヒントから作成。windowSize は MappedFile::granularity() の倍数に切り上げる。
+	explicit MappedFileStream(MappedFile& file, int windowSize = 16 * 1024 * 1024, MappedFile::Hint hint = MappedFile::Hint::sequential);
+	MappedFileStream(MappedFileStream&& value);
+	virtual ~MappedFileStream();
+
+	MappedFileStream& operator=(MappedFileStream&& value);
+
+public:
+	/// 読み込むファイル。
+	MappedFile& file() const;
+	/// 何もしない。
+	virtual void flush();
+	virtual __int64 length() const;
+	virtual __int64 position() const;
+	virtual void position(__int64 value);
+	virtual int read();
+	virtual int read(void* buffer, int offset, int count);
+	virtual bool readable() const;
+	/// 現在位置から最大 count バイトをコピーせずに返して位置を進める。ウィンドウの終わりを越えないので count より短い場合がある。ファイルの終わりに達していたら空を返す。
+	/// 戻り値は次に readView か read 等でウィンドウが移動するまで有効。
+	ArrayRange<const unsigned char> readView(int count);
+	/// 実際に移動したバイト数を返す。ファイルの終わりを越えて移動できる。
+	virtual __int64 skip(__int64 offset);
+	/// ウィンドウの大きさ。
+	int windowSize() const;
+	virtual void write(const void* buffer, int offset, int count);
+	virtual bool writable() const;
+
+private:
+	bool moveWindow();
+
+	MappedFile* _file;
+	MappedFile::View _window;
+	__int64 _position;
+	int _windowSize;
+	MappedFile::Hint _hint;
+};
+
+
+
+	}
+}
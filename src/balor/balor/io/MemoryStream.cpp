@@ -160,6 +160,30 @@ int MemoryStream::read(void* buffer, int offset, int count) {
 }
 
 
+int MemoryStream::readv(ArrayRange<const Stream::Slice> slices) {
+	assert("Invalid MemoryStream" && _first);
+	assert("read unsupported" && readable());
+	for (auto i = slices.begin(), end = slices.end(); i != end; ++i) {
+		assert("Null slice buffer" && (i->buffer || !i->count));
+		assert("Negative slice count" && 0 <= i->count);
+		assert("slice buffer is bad write pointer" && !IsBadWritePtr(i->buffer, i->count));
+	}
+	int total = 0;
+	for (auto i = slices.begin(), end = slices.end(); i != end; ++i) {
+		const int readCount = std::min(std::max(0, (int)(_last - _current)), i->count);
+		if (readCount) {
+			std::memcpy(i->buffer, _current, readCount);
+		}
+		_current += readCount;
+		total += readCount;
+		if (readCount < i->count) {
+			break;
+		}
+	}
+	return total;
+}
+
+
 bool MemoryStream::readable() const {
 	return true;
 }
@@ -202,6 +226,32 @@ bool MemoryStream::writable() const {
 }
 
 
+void MemoryStream::writev(ArrayRange<const Stream::ConstSlice> slices) {
+	assert("Invalid MemoryStream" && _first);
+	assert("write unsupported" && writable());
+	int total = 0;
+	for (auto i = slices.begin(), end = slices.end(); i != end; ++i) {
+		assert("Null slice buffer" && (i->buffer || !i->count));
+		assert("Negative slice count" && 0 <= i->count);
+		assert("slice buffer is bad read pointer" && !IsBadReadPtr(i->buffer, i->count));
+		assert("Slices too large" && i->count <= INT_MAX - total);
+		total += i->count;
+	}
+	unsigned char* newCurrent = _current + total;
+	if (_last < newCurrent) {
+		if (_end < newCurrent && !_allocatable) {
+			throw BufferOverrunException();
+		}
+		length(newCurrent - _first);
+	}
+	for (auto i = slices.begin(), end = slices.end(); i != end; ++i) {
+		if (i->count) {
+			std::memcpy(_current, i->buffer, i->count);
+			_current += i->count;
+		}
+	}
+}
+
 
 	}
-}
\ No newline at end of file
+}
@@ -49,9 +49,12 @@ public:
 	virtual void position(__int64 value);
 	virtual int read(void* buffer, int offset, int count);
 	virtual bool readable() const;
+	virtual int readv(ArrayRange<const Stream::Slice> slices);
 	virtual __int64 skip(__int64 offset);
 	virtual void write(const void* buffer, int offset, int count);
 	virtual bool writable() const;
+	/// 書き込むバイト数の合計でバッファを一度だけ拡張してから書き込む。
+	virtual void writev(ArrayRange<const Stream::ConstSlice> slices);
 
 private:
 	unsigned char* _first;
@@ -0,0 +1,392 @@
+﻿#include "PrefetchStream.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <exception>
+#include <utility>
+#include <vector>
+
+#define BOOST_DATE_TIME_NO_LIB
+#define BOOST_THREAD_NO_LIB
+#include <boost/thread.hpp>
+
+#include <balor/system/windows.hpp> // IsBadWritePtr の assert
+#include <balor/test/verify.hpp>
+
+
+namespace balor {
+	namespace io {
+
+using boost::condition_variable;
+using boost::mutex;
+using boost::thread;
+using std::exception_ptr;
+using std::min;
+using std::move;
+using std::vector;
+
+
+namespace {
+/// count バイトになるか終わりに達するまで読み込みを繰り返す。
+int readFully(Stream& stream, unsigned char* buffer, int count) {
+	int total = 0;
+	while (total < count) {
+		const int readCount = stream.read(buffer, total, count - total);
+		if (!readCount) {
+			break;
+		}
+		total += readCount;
+	}
+	return total;
+}
+} // namespace
+
+
+
+/// リングの [head, head + filled) が先読みしたブロック。スレッドは (head + filled) のブロックに読み込み、読み込み側は head のブロックから読む。
+/// ブロックの追加と解放は guard をロックして行うので、読み込み中のブロックと読み込み側が読んでいるブロックが重なることはない。
+struct PrefetchStream::Impl {
+	struct Block {
+		explicit Block(int size) : buffer(size), length(0), position(0) {}
+
+		vector<unsigned char> buffer;
+		int length;
+		__int64 position; // ブロックの先頭のラップしたストリームでの位置
+	};
+
+	Impl(Stream& stream, int blockSize, int blockCount)
+		: stream(&stream)
+		, blockSize(blockSize)
+		, blockCount(blockCount)
+		, blocks(blockCount, Block(blockSize))
+		, head(0)
+		, filled(0)
+		, window(blockCount)
+		, streamPosition(stream.position())
+		, reading(false)
+		, endOfStream(false)
+		, exit(false)
+		, holding(false)
+		, current(0)
+		, position(streamPosition)
+		, seekCount(0)
+		, stallCount(0)
+		, worker([this] () { run(); }) {
+	}
+
+	~Impl() {
+		stop();
+	}
+
+	/// head のブロックに読んでいないデータがある状態にする。読み終わったブロックは手放してスレッドに返す。
+	/// 終わりに達していれば false を返す。rethrow が false ならスレッドの例外を投げ直さずに false を返す。
+	bool acquire(bool rethrow) {
+		if (holding && current < blocks[head].length) {
+			return true;
+		}
+		mutex::scoped_lock lock(guard);
+		if (holding) {
+			holding = false;
+			head = (head + 1) % blockCount;
+			--filled;
+			current = 0;
+			window = min(window * 2, blockCount); // 順に読んでいるので先読みを戻していく
+			condition.notify_all();
+		}
+		if (!filled && !endOfStream && !error) {
+			++stallCount;
+			do {
+				condition.wait(lock);
+			} while (!filled && !endOfStream && !error);
+		}
+		if (!filled) {
+			if (error && rethrow) {
+				exception_ptr thrown = error;
+				error = exception_ptr(); // 次の読み込みでやり直す
+				condition.notify_all();
+				std::rethrow_exception(thrown);
+			}
+			return false;
+		}
+		holding = true;
+		return true;
+	}
+
+	/// value がリング上にあればラップしたストリームにアクセスせずに移動して true を返す。
+	bool moveInRing(__int64 value) {
+		if (value == position) {
+			return true;
+		}
+		mutex::scoped_lock lock(guard);
+		for (int i = 0; i < filled; ++i) {
+			const Block& block = blocks[(head + i) % blockCount];
+			if (value < block.position) {
+				return false;
+			}
+			if (value < block.position + block.length || (i == filled - 1 && value == block.position + block.length)) {
+				if (i) { // 手前のブロックを手放す
+					head = (head + i) % blockCount;
+					filled -= i;
+					condition.notify_all();
+				}
+				holding = true;
+				current = static_cast<int>(value - block.position);
+				position = value;
+				return true;
+			}
+		}
+		return false;
+	}
+
+	void run() {
+		mutex::scoped_lock lock(guard);
+		for (;;) {
+			while (!exit && (endOfStream || error || window <= filled)) {
+				condition.wait(lock);
+			}
+			if (exit) {
+				return;
+			}
+			Block& block = blocks[(head + filled) % blockCount];
+			reading = true;
+			lock.unlock();
+			int length = 0;
+			exception_ptr readError;
+			try {
+				length = readFully(*stream, block.buffer.data(), blockSize);
+			} catch (...) {
+				readError = std::current_exception();
+			}
+			lock.lock();
+			reading = false;
+			block.length = length;
+			block.position = streamPosition;
+			streamPosition += length;
+			if (readError) {
+				error = readError;
+			} else if (length < blockSize) {
+				endOfStream = true;
+			}
+			if (length) {
+				++filled;
+			}
+			condition.notify_all();
+		}
+	}
+
+	/// 先読みしたブロックを捨ててラップしたストリームを value に移動し、先読みを１ブロックに減らす。
+	void seek(__int64 value) {
+		mutex::scoped_lock lock(guard);
+		while (reading) {
+			condition.wait(lock);
+		}
+		holding = false;
+		head = 0;
+		filled = 0;
+		current = 0;
+		window = 1;
+		endOfStream = false;
+		error = exception_ptr();
+		++seekCount;
+		stream->position(value);
+		streamPosition = value;
+		position = value;
+		condition.notify_all();
+	}
+
+	void stop() {
+		if (worker.joinable()) {
+			{
+				mutex::scoped_lock lock(guard);
+				exit = true;
+			}
+			condition.notify_all();
+			worker.join();
+		}
+	}
+
+	Stream* stream;
+	int blockSize;
+	int blockCount;
+	vector<Block> blocks;
+	mutex guard;
+	condition_variable condition;
+	// 以下 guard で保護する
+	int head;
+	int filled;
+	int window; // 先読みするブロック数。ランダムアクセスで１に減らし、順に読み終わるごとに倍にする
+	__int64 streamPosition; // スレッドが次に読み込むラップしたストリームの位置
+	bool reading;
+	bool endOfStream;
+	bool exit;
+	exception_ptr error;
+	// 以下読み込み側だけが使う
+	bool holding; // head のブロックを読んでいる
+	int current; // head のブロックの中の読み込み位置
+	__int64 position;
+	int seekCount;
+	int stallCount;
+	thread worker; // 他のメンバーの初期化が終わってから開始する
+};
+
+
+
+PrefetchStream::PrefetchStream(Stream& stream, int blockSize, int blockCount) {
+	assert("Non positive blockSize" && 0 < blockSize);
+	assert("Non positive blockCount" && 0 < blockCount);
+	assert("read unsupported" && stream.readable());
+
+	_impl.reset(new Impl(stream, blockSize, blockCount));
+}
+
+
+PrefetchStream::PrefetchStream(PrefetchStream&& value)
+	: _impl(move(value._impl)) {
+}
+
+
+PrefetchStream::~PrefetchStream() {
+	if (_impl) {
+		_impl->stop();
+		if (_impl->position != _impl->streamPosition) { // 先読みした分だけ戻す
+			_impl->stream->skip(_impl->position - _impl->streamPosition);
+		}
+	}
+}
+
+
+PrefetchStream& PrefetchStream::operator=(PrefetchStream&& value) {
+	if (&value != this) {
+		this->~PrefetchStream();
+		new (this) PrefetchStream(move(value));
+	}
+	return *this;
+}
+
+
+int PrefetchStream::blockCount() const {
+	assert("Null stream" && _impl);
+	return _impl->blockCount;
+}
+
+
+int PrefetchStream::blockSize() const {
+	assert("Null stream" && _impl);
+	return _impl->blockSize;
+}
+
+
+void PrefetchStream::flush() {
+}
+
+
+__int64 PrefetchStream::length() const {
+	assert("Null stream" && _impl);
+
+	mutex::scoped_lock lock(_impl->guard);
+	while (_impl->reading) { // ラップしたストリームを同時に操作しない
+		_impl->condition.wait(lock);
+	}
+	return _impl->stream->length();
+}
+
+
+__int64 PrefetchStream::position() const {
+	assert("Null stream" && _impl);
+	return _impl->position;
+}
+
+
+void PrefetchStream::position(__int64 value) {
+	assert("Null stream" && _impl);
+	assert("Negative position" && 0 <= value);
+
+	if (!_impl->moveInRing(value)) {
+		_impl->seek(value);
+	}
+}
+
+
+int PrefetchStream::read(void* buffer, int offset, int count) {
+	assert("Null stream" && _impl);
+	assert("Null buffer" && buffer);
+	assert("Negative offset" && 0 <= offset);
+	assert("Negative count" && 0 <= count);
+	assert("buffer is bad write pointer" && !IsBadWritePtr(buffer, offset + count));
+
+	unsigned char* destination = static_cast<unsigned char*>(buffer) + offset;
+	Impl& impl = *_impl;
+	int total = 0;
+	while (total < count && impl.acquire(!total)) { // 読み込んだデータがあれば例外は次の呼び出しで投げる
+		const Impl::Block& block = impl.blocks[impl.head];
+		const int copyCount = min(count - total, block.length - impl.current);
+		std::memcpy(destination + total, block.buffer.data() + impl.current, copyCount);
+		impl.current += copyCount;
+		impl.position += copyCount;
+		total += copyCount;
+	}
+	return total;
+}
+
+
+ArrayRange<const unsigned char> PrefetchStream::readBlock() {
+	assert("Null stream" && _impl);
+
+	Impl& impl = *_impl;
+	if (!impl.acquire(true)) {
+		return ArrayRange<const unsigned char>(nullptr, 0);
+	}
+	const Impl::Block& block = impl.blocks[impl.head];
+	const ArrayRange<const unsigned char> result(block.buffer.data() + impl.current, block.length - impl.current);
+	impl.position += result.length();
+	impl.current = block.length; // 次の呼び出しでブロックを手放す
+	return result;
+}
+
+
+bool PrefetchStream::readable() const {
+	return true;
+}
+
+
+int PrefetchStream::seekCount() const {
+	assert("Null stream" && _impl);
+	return _impl->seekCount;
+}
+
+
+__int64 PrefetchStream::skip(__int64 offset) {
+	assert("Null stream" && _impl);
+
+	const __int64 oldPosition = _impl->position;
+	const __int64 newPosition = std::max(static_cast<__int64>(0), oldPosition + offset);
+	position(newPosition);
+	return newPosition - oldPosition;
+}
+
+
+int PrefetchStream::stallCount() const {
+	assert("Null stream" && _impl);
+	return _impl->stallCount;
+}
+
+
+Stream& PrefetchStream::stream() const {
+	assert("Null stream" && _impl);
+	return *_impl->stream;
+}
+
+
+void PrefetchStream::write(const void* , int , int ) {
+	assert("write unsupported" && false);
+}
+
+
+bool PrefetchStream::writable() const {
+	return false;
+}
+
+
+
+	}
+}
@@ -0,0 +1,90 @@
+﻿#pragma once
+
+#include <memory>
+
+#include <balor/io/Stream.hpp>
+#include <balor/ArrayRange.hpp>
+
+
+namespace balor {
+	namespace io {
+
+
+
+/**
+ * 他のストリームを別のスレッドで先読みして、読み込みと処理を並行させる読み込み専用のストリーム。
+ *
+ * blockSize バイトのブロックを blockCount 個のリングに持ち、読み込み側がブロックを処理している間にスレッドが次のブロックを読み込んでおく。
+ * ディスクの読み込みを待つ間にパースが止まらないので、CPU を使う処理で順に読み込む場合に向く。
+ * readBlock 関数はコピーせずにリング上のデータをそのまま返す。返した範囲は次に readBlock, read, position, skip を呼ぶまで有効。
+ * リング上にある範囲の position, skip はラップしたストリームにアクセスしない。
+ * リングの外への移動はランダムアクセスとみなして先読みしたブロックを捨て、先読みを１ブロックに減らす。以降ブロックを順に読み終わるごとに先読みするブロック数を倍にして blockCount まで戻す。
+ * ラップしたストリームの読み込みが投げた例外は、それまでに読み込んだデータを読み終わった時に読み込み側で投げ直す。
+ * デストラクタではスレッドを止めて、ラップしたストリームの位置を PrefetchStream の position に合わせる。
+ * ラップしたストリームは PrefetchStream より後に破棄すること。PrefetchStream を使っている間はラップしたストリームを直接操作してはならない。
+ *
+ * <h3>・サンプルコード</h3>
+ * <pre><code>
+	FileStream file(L"access.log", FileStream::Mode::open, FileStream::Access::read);
+	PrefetchStream stream(file, 1024 * 1024, 4);
+	int lineCount = 0;
+	for (auto block = stream.readBlock(); !block.empty(); block = stream.readBlock()) {
+		lineCount += static_cast<int>(std::count(block.begin(), block.end(), '\n'));
+	}
+ * </code></pre>
+ */
+class PrefetchStream : public Stream {
+public:
+	// オーバーロード関数のオーバーライド用
+	using Stream::read;
+	using Stream::write;
+
+	/// 既定のブロックのバイト数。
+	static const int defaultBlockSize = 256 * 1024;
+
+public:
+	/// ラップするストリーム、ブロックのバイト数、リングのブロック数から作成し、先読みを始める。
+	explicit PrefetchStream(Stream& stream, int blockSize = defaultBlockSize, int blockCount = 4);
+	PrefetchStream(PrefetchStream&& value);
+	/// スレッドを止めて、ラップしたストリームの位置を合わせる。
+	virtual ~PrefetchStream();
+
+	PrefetchStream& operator=(PrefetchStream&& value);
+
+public:
+	/// リングのブロック数。
+	int blockCount() const;
+	/// ブロックのバイト数。
+	int blockSize() const;
+	/// 何もしない。
+	virtual void flush();
+	virtual __int64 length() const;
+	virtual __int64 position() const;
+	/// リングの外に移動すると先読みを減らす。
+	virtual void position(__int64 value);
+	virtual int read(void* buffer, int offset, int count);
+	/// 現在のブロックの読んでいない残りをコピーせずに返して、その分だけ位置を進める。終わりに達していれば空の範囲を返す。
+	ArrayRange<const unsigned char> readBlock();
+	virtual bool readable() const;
+	/// リングの外への移動で先読みしたブロックを捨てた回数。
+	int seekCount() const;
+	/// 実際に移動したバイト数を返す。リングの外に移動すると先読みを減らす。
+	virtual __int64 skip(__int64 offset);
+	/// 先読みが間に合わずに読み込み側が待った回数。
+	int stallCount() const;
+	/// ラップしたストリーム。
+	Stream& stream() const;
+	/// サポートしない。
+	virtual void write(const void* buffer, int offset, int count);
+	virtual bool writable() const;
+
+private:
+	struct Impl;
+
+	std::unique_ptr<Impl> _impl;
+};
+
+
+
+	}
+}
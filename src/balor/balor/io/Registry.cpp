@@ -1,11 +1,16 @@
 ﻿#include "Registry.hpp"
 
+#include <string>
 #include <type_traits>
+#include <unordered_map>
 #include <vector>
 
+#include <balor/io/RegistryBatch.hpp>
+#include <balor/io/RegistrySnapshot.hpp>
 #include <balor/system/System.hpp>
 #include <balor/system/windows.hpp>
 #include <balor/test/verify.hpp>
+#include <balor/scopeExit.hpp>
 #include <balor/String.hpp>
 #include <balor/StringBuffer.hpp>
 
@@ -15,7 +20,9 @@ namespace balor {
 
 using std::move;
 using std::swap;
+using std::unordered_map;
 using std::vector;
+using std::wstring;
 using namespace balor::system;
 
 
@@ -42,6 +49,106 @@ void checkResult(const LONG result) {
 		}
 	}
 }
+
+
+/// KTM のトランザクションを使う関数。Windows Vista より前には無いので動的に読み込む。
+struct TransactionFunctions {
+	typedef HANDLE (WINAPI *CreateTransactionFunction)(LPSECURITY_ATTRIBUTES, LPGUID, DWORD, DWORD, DWORD, DWORD, LPWSTR);
+	typedef BOOL (WINAPI *CommitTransactionFunction)(HANDLE);
+	typedef LONG (WINAPI *RegCreateKeyTransactedFunction)(HKEY, LPCWSTR, DWORD, LPWSTR, DWORD, REGSAM, const LPSECURITY_ATTRIBUTES, PHKEY, LPDWORD, HANDLE, PVOID);
+	typedef LONG (WINAPI *RegOpenKeyTransactedFunction)(HKEY, LPCWSTR, DWORD, REGSAM, PHKEY, HANDLE, PVOID);
+	typedef LONG (WINAPI *RegDeleteKeyTransactedFunction)(HKEY, LPCWSTR, REGSAM, DWORD, HANDLE, PVOID);
+
+	bool available() const {
+		return createTransaction && commitTransaction && regCreateKeyTransacted && regOpenKeyTransacted && regDeleteKeyTransacted;
+	}
+
+	CreateTransactionFunction createTransaction;
+	CommitTransactionFunction commitTransaction;
+	RegCreateKeyTransactedFunction regCreateKeyTransacted;
+	RegOpenKeyTransactedFunction regOpenKeyTransacted;
+	RegDeleteKeyTransactedFunction regDeleteKeyTransacted;
+};
+
+
+TransactionFunctions loadTransactionFunctions() {
+	TransactionFunctions functions = {};
+	HMODULE ktmw32 = LoadLibraryW(L"ktmw32.dll"); // プロセスが終わるまで解放しない
+	if (ktmw32) {
+		functions.createTransaction = reinterpret_cast<TransactionFunctions::CreateTransactionFunction>(GetProcAddress(ktmw32, "CreateTransaction"));
+		functions.commitTransaction = reinterpret_cast<TransactionFunctions::CommitTransactionFunction>(GetProcAddress(ktmw32, "CommitTransaction"));
+	}
+	HMODULE advapi32 = GetModuleHandleW(L"advapi32.dll");
+	functions.regCreateKeyTransacted = reinterpret_cast<TransactionFunctions::RegCreateKeyTransactedFunction>(GetProcAddress(advapi32, "RegCreateKeyTransactedW"));
+	functions.regOpenKeyTransacted = reinterpret_cast<TransactionFunctions::RegOpenKeyTransactedFunction>(GetProcAddress(advapi32, "RegOpenKeyTransactedW"));
+	functions.regDeleteKeyTransacted = reinterpret_cast<TransactionFunctions::RegDeleteKeyTransactedFunction>(GetProcAddress(advapi32, "RegDeleteKeyTransactedW"));
+	return functions;
+}
+
+
+const TransactionFunctions& getTransactionFunctions() {
+	static const TransactionFunctions functions = loadTransactionFunctions();
+	return functions;
+}
+
+
+// マルチスレッドになるまえに初期化されることを保証する
+const TransactionFunctions& transactionFunctions = getTransactionFunctions();
+
+
+// 以下の関数は transaction が nullptr ならトランザクションを使わない。
+LONG createKey(HKEY parent, const wchar_t* keyPath, HANDLE transaction, HKEY* result) {
+	if (transaction) {
+		return transactionFunctions.regCreateKeyTransacted(parent, keyPath, 0, nullptr, REG_OPTION_NON_VOLATILE
+			, KEY_ALL_ACCESS, nullptr, result, nullptr, transaction, nullptr);
+	}
+	return RegCreateKeyExW(parent, keyPath, 0, nullptr, REG_OPTION_NON_VOLATILE, KEY_ALL_ACCESS, nullptr, result, nullptr);
+}
+
+
+LONG openKey(HKEY parent, const wchar_t* keyPath, HANDLE transaction, HKEY* result) {
+	if (transaction) {
+		return transactionFunctions.regOpenKeyTransacted(parent, keyPath, 0, KEY_ALL_ACCESS, result, transaction, nullptr);
+	}
+	return RegOpenKeyExW(parent, keyPath, 0, KEY_ALL_ACCESS, result);
+}
+
+
+void removeKeyTree(HKEY parent, const wchar_t* keyPath, HANDLE transaction) {
+	HKEY key = nullptr;
+	const LONG result = openKey(parent, keyPath, transaction, &key);
+	if (result == ERROR_FILE_NOT_FOUND) {
+		return;
+	}
+	checkResult(result);
+	{
+		scopeExit([&] () {
+			verify(RegCloseKey(key) == ERROR_SUCCESS);
+		});
+		wchar_t name[256]; // キー名の最大長は 255 文字
+		for (;;) { // 先頭のサブキーを削除し続ける
+			DWORD size = sizeof(name) / sizeof(name[0]);
+			const LONG enumResult = RegEnumKeyExW(key, 0, name, &size, nullptr, nullptr, nullptr, nullptr);
+			if (enumResult == ERROR_NO_MORE_ITEMS) {
+				break;
+			}
+			checkResult(enumResult);
+			removeKeyTree(key, name, transaction);
+		}
+	}
+	if (transaction) {
+		checkResult(transactionFunctions.regDeleteKeyTransacted(parent, keyPath, 0, 0, transaction, nullptr));
+	} else {
+		checkResult(RegDeleteKeyW(parent, keyPath));
+	}
+}
+
+
+/// 大文字と小文字を区別せずに比べるために大文字にする。
+wstring fold(StringRange value) {
+	const String upper = String::refer(value).toUpper();
+	return wstring(upper.c_str(), upper.length());
+}
 } // namespace
 
 
@@ -166,6 +273,72 @@ Registry Registry::classesRoot() {
 }
 
 
+void Registry::commit(const RegistryBatch& batch) {
+	assert("Empty Registry" && *this);
+
+	if (batch.empty()) {
+		return;
+	}
+	const TransactionFunctions& functions = transactionFunctions;
+	HANDLE transaction = nullptr;
+	if (functions.available()) {
+		transaction = functions.createTransaction(nullptr, nullptr, 0, 0, 0, 0, nullptr);
+		if (transaction == INVALID_HANDLE_VALUE) {
+			throw CommitFailedException();
+		}
+	}
+	scopeExit([&] () { // コミットせずに閉じればロールバックされる
+		if (transaction) {
+			verify(CloseHandle(transaction));
+		}
+	});
+	unordered_map<wstring, HKEY> keys; // 大文字にしたキーのパスごとに一度だけ開く
+	scopeExit([&] () {
+		for (auto i = keys.begin(), end = keys.end(); i != end; ++i) {
+			verify(RegCloseKey(i->second) == ERROR_SUCCESS);
+		}
+	});
+
+	// RegistryBatch は削除したキー以下への前の変更を取り除いているので、キーの削除を先にまとめて行っても結果は同じ
+	const vector<RegistryBatch::Operation>& operations = batch.operations();
+	for (auto i = operations.begin(), end = operations.end(); i != end; ++i) {
+		if (i->kind == RegistryBatch::OperationKind::removeKey) {
+			removeKeyTree(_handle, i->keyPath.c_str(), transaction);
+		}
+	}
+	for (auto i = operations.begin(), end = operations.end(); i != end; ++i) {
+		if (i->kind == RegistryBatch::OperationKind::removeKey) {
+			continue;
+		}
+		const wstring path = fold(i->keyPath);
+		auto found = keys.find(path);
+		HKEY key = found != keys.end() ? found->second : nullptr;
+		if (!key) {
+			if (i->kind == RegistryBatch::OperationKind::removeValue) {
+				const LONG result = openKey(_handle, i->keyPath.c_str(), transaction, &key);
+				if (result == ERROR_FILE_NOT_FOUND) {
+					continue;
+				}
+				checkResult(result);
+			} else {
+				checkResult(createKey(_handle, i->keyPath.c_str(), transaction, &key));
+			}
+			keys[path] = key;
+		}
+		if (i->kind == RegistryBatch::OperationKind::setValue) {
+			checkResult(RegSetValueExW(key, i->valueName.c_str(), 0, i->valueKind
+				, i->data.empty() ? nullptr : i->data.data(), i->data.size()));
+		} else if (i->kind == RegistryBatch::OperationKind::removeValue) {
+			checkResult(RegDeleteValueW(key, i->valueName.c_str()));
+		}
+	}
+
+	if (transaction && !functions.commitTransaction(transaction)) {
+		throw CommitFailedException();
+	}
+}
+
+
 Registry Registry::createKey(StringRange keyName, bool writable) {
 	assert("Empty Registry" && *this);
 	assert("Empty keyName" && !keyName.empty());
@@ -398,6 +571,12 @@ void Registry::setString(StringRange valueName, StringRange value, Registry::Val
 }
 
 
+RegistrySnapshot Registry::snapshot(bool recursive) const {
+	assert("Empty Registry" && *this);
+	return RegistrySnapshot(*this, recursive);
+}
+
+
 Registry Registry::users() {
 	Registry registry;
 	registry._handle = HKEY_USERS;
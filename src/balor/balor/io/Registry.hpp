@@ -17,10 +17,17 @@ template<typename T, typename A> class vector;
 namespace balor {
 	namespace io {
 
+class RegistryBatch;
+class RegistrySnapshot;
+
 
 
 /**
  * レジストリにアクセスするクラス。
+ *
+ * 多くの値を読むときは snapshot 関数でキー以下をまとめて読み込むと、値ごとにレジストリにアクセスしなくて済む。
+ * 多くの値を書くときは RegistryBatch にまとめて commit 関数で一度に反映できる。
+ * RegistryFile を使うとレジストリの代わりにファイルで同じ RegistrySnapshot と RegistryBatch を扱える。
  */
 class Registry : private NonCopyable {
 public:
@@ -64,6 +71,9 @@ public:
 	/// キーや値にアクセス権が無かった。あるいはサブキーをもつレジストリを削除しようとした。
 	class AccessDeniedException : public Exception {};
 
+	/// commit のトランザクションを作成またはコミットできなかった。他のトランザクションと競合した場合等。
+	class CommitFailedException : public Exception {};
+
 	/// HKEY_LOCAL_MACHINE 直下にキーを作成しようとした場合等。
 	class InvalidParameterException : public Exception {};
 
@@ -88,6 +98,8 @@ public:
 public:
 	/// HKEY_CLASSES_ROOT で作成。
 	static Registry classesRoot();
+	/// batch をこのキーに反映する。キーのパスはこのキーからの相対パス。Windows Vista 以降では一つのトランザクションで反映し、例外を投げた場合は何も変更しない。
+	void commit(const RegistryBatch& batch);
 	/// サブキーを作成して返す。
 	Registry createKey(StringRange keyName, bool writable = false);
 	/// HKEY_CURRENT_CONFIG で作成。
@@ -127,6 +139,8 @@ public:
 	void setQword(StringRange valueName, unsigned __int64 value);
 	/// String 型 の値を設定する。
 	void setString(StringRange valueName, StringRange value, Registry::ValueKind kind = ValueKind::string);
+	/// キーの値と recursive が true ならサブキー以下全てを読み込んだスナップショットを作成する。アクセス権が無くて開けないサブキーは含まない。
+	RegistrySnapshot snapshot(bool recursive = true) const;
 	/// HKEY_USERS で作成。
 	static Registry users();
 	/// 値の数。
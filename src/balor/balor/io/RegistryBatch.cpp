@@ -0,0 +1,217 @@
+﻿#include "RegistryBatch.hpp"
+
+#include <cstdint>
+#include <cstring>
+#include <utility>
+
+#include <balor/test/verify.hpp>
+
+
+namespace balor {
+	namespace io {
+
+using std::move;
+using std::vector;
+using std::wstring;
+
+
+namespace {
+/// 大文字と小文字を区別せずに比べるために大文字にする。
+wstring fold(StringRange value) {
+	const String upper = String::refer(value).toUpper();
+	return wstring(upper.c_str(), upper.length());
+}
+
+
+bool isValidKeyPath(StringRange keyPath) { // 先頭、末尾、連続した "\\" を許さない
+	const wchar_t* const path = keyPath.c_str();
+	const int length = keyPath.length();
+	for (int i = 0; i < length; ++i) {
+		if (path[i] == L'\\' && (!i || i == length - 1 || path[i + 1] == L'\\')) {
+			return false;
+		}
+	}
+	return true;
+}
+
+
+bool isUnder(const wstring& foldedPath, const wstring& foldedKeyPath) { // foldedPath が foldedKeyPath かその下のキーか
+	return !foldedPath.compare(0, foldedKeyPath.length(), foldedKeyPath)
+		&& (foldedPath.length() == foldedKeyPath.length() || foldedPath[foldedKeyPath.length()] == L'\\');
+}
+
+
+wstring valueIndex(const wstring& foldedKeyPath, StringRange valueName) { // キーのパスとは '\0' で区別する
+	return foldedKeyPath + L'\0' + fold(valueName);
+}
+} // namespace
+
+
+
+bool RegistryBatch::OperationKind::_validate(OperationKind value) {
+	switch (value) {
+		case createKey   :
+		case removeKey   :
+		case setValue    :
+		case removeValue : return true;
+		default          : return false;
+	}
+}
+
+
+
+RegistryBatch::RegistryBatch() {
+}
+
+
+RegistryBatch::RegistryBatch(RegistryBatch&& value)
+	: _operations(move(value._operations))
+	, _indices(move(value._indices)) {
+}
+
+
+RegistryBatch::~RegistryBatch() {
+}
+
+
+RegistryBatch& RegistryBatch::operator=(RegistryBatch&& value) {
+	if (&value != this) {
+		_operations = move(value._operations);
+		_indices = move(value._indices);
+	}
+	return *this;
+}
+
+
+void RegistryBatch::clear() {
+	_operations.clear();
+	_indices.clear();
+}
+
+
+void RegistryBatch::createKey(StringRange keyPath) {
+	assert("Invalid keyPath" && isValidKeyPath(keyPath));
+
+	const wstring index = fold(keyPath);
+	if (_indices.find(index) != _indices.end()) {
+		return;
+	}
+	Operation operation;
+	operation.kind = OperationKind::createKey;
+	operation.keyPath = String(keyPath.c_str(), keyPath.length());
+	operation.valueKind = Registry::ValueKind::notFound;
+	add(operation, index);
+}
+
+
+bool RegistryBatch::empty() const {
+	return _operations.empty();
+}
+
+
+const vector<RegistryBatch::Operation>& RegistryBatch::operations() const {
+	return _operations;
+}
+
+
+void RegistryBatch::removeKey(StringRange keyPath) {
+	assert("Empty keyPath" && !keyPath.empty());
+	assert("Invalid keyPath" && isValidKeyPath(keyPath));
+
+	// このキー以下への変更は削除すれば意味が無いので取り消す
+	const wstring foldedKeyPath = fold(keyPath);
+	vector<Operation> operations;
+	operations.reserve(_operations.size() + 1);
+	_indices.clear();
+	for (auto i = _operations.begin(), end = _operations.end(); i != end; ++i) {
+		const wstring foldedPath = fold(i->keyPath);
+		if (isUnder(foldedPath, foldedKeyPath)) {
+			continue;
+		}
+		if (i->kind == OperationKind::createKey) {
+			_indices[foldedPath] = operations.size();
+		} else if (i->kind != OperationKind::removeKey) {
+			_indices[valueIndex(foldedPath, i->valueName)] = operations.size();
+		}
+		operations.push_back(move(*i));
+	}
+	_operations.swap(operations);
+
+	Operation operation;
+	operation.kind = OperationKind::removeKey;
+	operation.keyPath = String(keyPath.c_str(), keyPath.length());
+	operation.valueKind = Registry::ValueKind::notFound;
+	_operations.push_back(move(operation));
+}
+
+
+void RegistryBatch::removeValue(StringRange keyPath, StringRange valueName) {
+	assert("Invalid keyPath" && isValidKeyPath(keyPath));
+
+	Operation operation;
+	operation.kind = OperationKind::removeValue;
+	operation.keyPath = String(keyPath.c_str(), keyPath.length());
+	operation.valueName = String(valueName.c_str(), valueName.length());
+	operation.valueKind = Registry::ValueKind::notFound;
+	add(operation, valueIndex(fold(keyPath), valueName));
+}
+
+
+void RegistryBatch::setBinary(StringRange keyPath, StringRange valueName, ArrayRange<const unsigned char> value, Registry::ValueKind kind) {
+	assert("Invalid keyPath" && isValidKeyPath(keyPath));
+	assert("Invalid Registry::ValueKind" && Registry::ValueKind::_validate(kind));
+
+	Operation operation;
+	operation.kind = OperationKind::setValue;
+	operation.keyPath = String(keyPath.c_str(), keyPath.length());
+	operation.valueName = String(valueName.c_str(), valueName.length());
+	operation.valueKind = kind;
+	operation.data.assign(value.begin(), value.end());
+	add(operation, valueIndex(fold(keyPath), valueName));
+}
+
+
+void RegistryBatch::setDword(StringRange keyPath, StringRange valueName, unsigned long value) {
+	const std::uint32_t dword = static_cast<std::uint32_t>(value); // unsigned long が 64 ビットの環境でも 4 バイト
+	unsigned char data[sizeof(dword)];
+	std::memcpy(data, &dword, sizeof(dword));
+	setBinary(keyPath, valueName, data, Registry::ValueKind::dword);
+}
+
+
+void RegistryBatch::setQword(StringRange keyPath, StringRange valueName, unsigned __int64 value) {
+	unsigned char data[sizeof(value)];
+	std::memcpy(data, &value, sizeof(value));
+	setBinary(keyPath, valueName, data, Registry::ValueKind::qword);
+}
+
+
+void RegistryBatch::setString(StringRange keyPath, StringRange valueName, StringRange value, Registry::ValueKind kind) {
+	assert("Invalid Registry::ValueKind" && (kind == Registry::ValueKind::string || kind == Registry::ValueKind::expandString || kind == Registry::ValueKind::multiString));
+
+	// RegSetValueExW の説明どおり終端のヌル文字も含める
+	vector<unsigned char> data((value.length() + 1) * sizeof(wchar_t), 0);
+	std::memcpy(data.data(), value.c_str(), value.length() * sizeof(wchar_t));
+	setBinary(keyPath, valueName, data, kind);
+}
+
+
+int RegistryBatch::size() const {
+	return _operations.size();
+}
+
+
+void RegistryBatch::add(RegistryBatch::Operation& operation, const wstring& index) {
+	auto found = _indices.find(index);
+	if (found != _indices.end()) { // 同じ値への前の変更を置き換える
+		_operations[found->second] = move(operation);
+	} else {
+		_indices[index] = _operations.size();
+		_operations.push_back(move(operation));
+	}
+}
+
+
+
+	}
+}
@@ -0,0 +1,100 @@
+﻿#pragma once
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <balor/io/Registry.hpp>
+#include <balor/ArrayRange.hpp>
+#include <balor/Enum.hpp>
+#include <balor/String.hpp>
+#include <balor/StringRange.hpp>
+
+
+namespace balor {
+	namespace io {
+
+
+
+/**
+ * レジストリへの変更をためておき、まとめて反映する。
+ *
+ * キーのパスは反映先のキーからの相対パスを "\\" で区切って指定する。空文字列は反映先のキー自身を表す。キー名と値名は大文字と小文字を区別しない。
+ * 同じ値への set や removeValue は最後の一つにまとめ、removeKey はそれより前のそのキー以下への変更を取り消す。
+ * Registry::commit では一つのトランザクションとして、RegistryFile::commit ではファイルの一度の書き換えとして反映する。
+ * RegistrySnapshot::apply で反映した結果のスナップショットを作ることもできる。
+ *
+ * <h3>・サンプルコード</h3>
+ * <pre><code>
+	RegistryBatch batch;
+	batch.setDword(L"Window", L"Width", 800);
+	batch.setDword(L"Window", L"Height", 600);
+	batch.setString(L"", L"LastFile", file.path());
+	batch.removeKey(L"Obsolete");
+	Registry(L"HKEY_CURRENT_USER\\Software\\MyApp", true).commit(batch);
+ * </code></pre>
+ */
+class RegistryBatch {
+public:
+	/// 変更の種類。
+	struct OperationKind {
+		enum _enum {
+			createKey   = 0, /// キーを作成する。
+			removeKey   = 1, /// キーをサブキーごと削除する。
+			setValue    = 2, /// 値を設定する。
+			removeValue = 3, /// 値を削除する。
+		};
+		BALOR_NAMED_ENUM_MEMBERS(OperationKind);
+	};
+
+	/// 一つの変更。
+	struct Operation {
+		RegistryBatch::OperationKind kind;
+		String keyPath;
+		String valueName;
+		Registry::ValueKind valueKind;
+		std::vector<unsigned char> data;
+	};
+
+public:
+	RegistryBatch();
+	RegistryBatch(RegistryBatch&& value);
+	~RegistryBatch();
+
+	RegistryBatch& operator=(RegistryBatch&& value);
+
+public:
+	/// 全ての変更を捨てる。
+	void clear();
+	/// キーが無ければ作成する。
+	void createKey(StringRange keyPath);
+	/// 変更が無いかどうか。
+	bool empty() const;
+	/// まとめた後の変更を追加した順に並べたもの。
+	const std::vector<RegistryBatch::Operation>& operations() const;
+	/// キーをサブキーごと削除する。
+	void removeKey(StringRange keyPath);
+	/// 値を削除する。
+	void removeValue(StringRange keyPath, StringRange valueName);
+	/// 任意の種類の値を設定する。
+	void setBinary(StringRange keyPath, StringRange valueName, ArrayRange<const unsigned char> value, Registry::ValueKind kind = Registry::ValueKind::binary);
+	/// Registry::ValueKind::dword の値を設定する。
+	void setDword(StringRange keyPath, StringRange valueName, unsigned long value);
+	/// Registry::ValueKind::qword の値を設定する。
+	void setQword(StringRange keyPath, StringRange valueName, unsigned __int64 value);
+	/// 文字列の値を設定する。
+	void setString(StringRange keyPath, StringRange valueName, StringRange value, Registry::ValueKind kind = Registry::ValueKind::string);
+	/// まとめた後の変更の数。
+	int size() const;
+
+private:
+	void add(RegistryBatch::Operation& operation, const std::wstring& index);
+
+	std::vector<Operation> _operations;
+	std::unordered_map<std::wstring, int> _indices; // 大文字にしたキーのパス（と値名）ごとの _operations の位置
+};
+
+
+
+	}
+}
@@ -0,0 +1,86 @@
+﻿#include "RegistryFile.hpp"
+
+#include <utility>
+
+#include <balor/io/File.hpp>
+#include <balor/io/FileStream.hpp>
+#include <balor/io/RegistryBatch.hpp>
+#include <balor/test/verify.hpp>
+
+
+namespace balor {
+	namespace io {
+
+using std::move;
+
+
+
+RegistryFile::RegistryFile(StringRange filePath)
+	: _filePath(filePath.c_str(), filePath.length()) {
+	assert("Empty filePath" && !filePath.empty());
+
+	if (File::exists(filePath)) {
+		FileStream stream(filePath, FileStream::Mode::open, FileStream::Access::read, FileStream::Share::read, FileStream::Options::sequentialScan);
+		_snapshot = RegistrySnapshot::read(stream);
+	} else {
+		_snapshot = RegistrySnapshot().apply(RegistryBatch());
+	}
+}
+
+
+RegistryFile::RegistryFile(RegistryFile&& value)
+	: _filePath(move(value._filePath))
+	, _snapshot(move(value._snapshot)) {
+}
+
+
+RegistryFile::~RegistryFile() {
+}
+
+
+RegistryFile& RegistryFile::operator=(RegistryFile&& value) {
+	if (&value != this) {
+		_filePath = move(value._filePath);
+		_snapshot = move(value._snapshot);
+	}
+	return *this;
+}
+
+
+void RegistryFile::commit(const RegistryBatch& batch) {
+	assert("Empty RegistryFile" && _snapshot);
+
+	if (batch.empty()) {
+		return;
+	}
+	RegistrySnapshot snapshot = _snapshot.apply(batch);
+	const String tempPath = _filePath + L".tmp";
+	{
+		FileStream stream(tempPath, FileStream::Mode::createAlways, FileStream::Access::write, FileStream::Share::none);
+		snapshot.write(stream);
+		stream.flush();
+	}
+	File temp(tempPath);
+	if (File::exists(_filePath)) {
+		temp.replace(_filePath, L"");
+	} else {
+		temp.moveTo(_filePath);
+	}
+	_snapshot = move(snapshot);
+}
+
+
+const String& RegistryFile::filePath() const {
+	return _filePath;
+}
+
+
+RegistrySnapshot RegistryFile::snapshot() const {
+	assert("Empty RegistryFile" && _snapshot);
+	return _snapshot;
+}
+
+
+
+	}
+}
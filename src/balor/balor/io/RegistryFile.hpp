@@ -0,0 +1,58 @@
+﻿#pragma once
+
+#include <balor/io/RegistrySnapshot.hpp>
+#include <balor/NonCopyable.hpp>
+#include <balor/String.hpp>
+#include <balor/StringRange.hpp>
+
+
+namespace balor {
+	namespace io {
+
+class RegistryBatch;
+
+
+
+/**
+ * レジストリの代わりにキーと値をファイルに保存する。
+ *
+ * Registry と同じく snapshot で RegistrySnapshot を作り、commit で RegistryBatch を反映するので、設定を読み書きするコードをレジストリの無い環境やテストでも動かせる。
+ * ファイルの内容は作成時に読み込み、snapshot は読み込んだ内容をそのまま返す。ファイルが無ければ空のキーとして扱う。
+ * commit は反映した結果を一時ファイルに書き込んでから元のファイルと置き換えるので、途中で失敗してもファイルは前の内容のまま残る。
+ * 他のプロセスによるファイルの書き換えは考慮しない。
+ *
+ * <h3>・サンプルコード</h3>
+ * <pre><code>
+	RegistryFile file(L"settings.breg");
+	RegistryBatch batch;
+	batch.setDword(L"Window", L"Width", 800);
+	file.commit(batch);
+	int width = file.snapshot().openKey(L"Window").getDword(L"Width");
+ * </code></pre>
+ */
+class RegistryFile : private NonCopyable {
+public:
+	/// ファイルパスから作成し、ファイルがあれば読み込む。
+	explicit RegistryFile(StringRange filePath);
+	RegistryFile(RegistryFile&& value);
+	~RegistryFile();
+
+	RegistryFile& operator=(RegistryFile&& value);
+
+public:
+	/// batch を反映してファイルを書き換える。
+	void commit(const RegistryBatch& batch);
+	/// ファイルパス。
+	const String& filePath() const;
+	/// ファイルの内容全体のスナップショット。
+	RegistrySnapshot snapshot() const;
+
+private:
+	String _filePath;
+	RegistrySnapshot _snapshot;
+};
+
+
+
+	}
+}
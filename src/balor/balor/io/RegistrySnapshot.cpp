@@ -0,0 +1,577 @@
+﻿#include "RegistrySnapshot.hpp"
+
+#include <algorithm>
+#include <climits>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+
+#include <balor/io/BinaryReader.hpp>
+#include <balor/io/BinaryWriter.hpp>
+#include <balor/io/RegistryBatch.hpp>
+#include <balor/io/Stream.hpp>
+#include <balor/system/windows.hpp>
+#include <balor/test/verify.hpp>
+#include <balor/scopeExit.hpp>
+
+
+namespace balor {
+	namespace io {
+
+using std::make_shared;
+using std::move;
+using std::shared_ptr;
+using std::unordered_map;
+using std::unordered_set;
+using std::vector;
+using std::wstring;
+
+
+namespace {
+const unsigned char magic[] = {'B', 'R', 'E', 'G'};
+const unsigned char version = 1;
+const int maxDepth = 512; // レジストリのキーの最大の深さ
+const int readChunkSize = 64 * 1024; // 値のデータはこの大きさずつ読んで、壊れたバイト数で大きなメモリを確保しない
+
+
+/// 大文字と小文字を区別せずに比べるために大文字にする。
+wstring fold(StringRange value) {
+	const String upper = String::refer(value).toUpper();
+	return wstring(upper.c_str(), upper.length());
+}
+} // namespace
+
+
+
+/// 一つのキー。スナップショットに含めた後は変更しない。
+struct RegistrySnapshot::Node {
+	struct Value {
+		String name;
+		wstring foldedName;
+		ValueKind kind;
+		vector<unsigned char> data;
+	};
+
+	struct Key {
+		String name;
+		wstring foldedName;
+		shared_ptr<Node> node;
+	};
+
+	const Value* findValue(StringRange name) const {
+		auto i = valueIndices.find(fold(name));
+		return i != valueIndices.end() ? &values[i->second] : nullptr;
+	}
+
+	const Value& getValue(StringRange name) const {
+		const Value* value = findValue(name);
+		if (!value) {
+			throw ValueNotFoundException();
+		}
+		return *value;
+	}
+
+	int findKey(const wstring& foldedName) const {
+		auto i = keyIndices.find(foldedName);
+		return i != keyIndices.end() ? i->second : -1;
+	}
+
+	void addKey(const String& name, const wstring& foldedName, const shared_ptr<Node>& node) {
+		keyIndices[foldedName] = keys.size();
+		Key key;
+		key.name = name;
+		key.foldedName = foldedName;
+		key.node = node;
+		keys.push_back(move(key));
+	}
+
+	void removeKey(int index) { // 順番を保つので後ろの位置を詰める
+		keyIndices.erase(keys[index].foldedName);
+		keys.erase(keys.begin() + index);
+		for (int i = index, end = keys.size(); i < end; ++i) {
+			keyIndices[keys[i].foldedName] = i;
+		}
+	}
+
+	void setValue(const String& name, ValueKind kind, const vector<unsigned char>& data) {
+		wstring foldedName = fold(name);
+		auto i = valueIndices.find(foldedName);
+		if (i != valueIndices.end()) {
+			Value& value = values[i->second];
+			value.kind = kind;
+			value.data = data;
+			return;
+		}
+		valueIndices[foldedName] = values.size();
+		Value value;
+		value.name = name;
+		value.foldedName = move(foldedName);
+		value.kind = kind;
+		value.data = data;
+		values.push_back(move(value));
+	}
+
+	void removeValue(StringRange name) {
+		auto found = valueIndices.find(fold(name));
+		if (found == valueIndices.end()) {
+			return;
+		}
+		const int index = found->second;
+		valueIndices.erase(found);
+		values.erase(values.begin() + index);
+		for (int i = index, end = values.size(); i < end; ++i) {
+			valueIndices[values[i].foldedName] = i;
+		}
+	}
+
+	vector<Value> values; // レジストリで列挙した順
+	unordered_map<wstring, int> valueIndices; // 大文字にした値名ごとの values の位置
+	vector<Key> keys;
+	unordered_map<wstring, int> keyIndices;
+};
+
+
+namespace {
+typedef RegistrySnapshot::Node Node;
+
+
+/// apply で書き換えるキーだけを複製し、他のキーは元のスナップショットと共有する。
+class Builder {
+public:
+	explicit Builder(const Node* root) : _root(root ? make_shared<Node>(*root) : make_shared<Node>()) {
+		_copies.insert(_root.get());
+	}
+
+	/// keyPath のキーを書き換えられるようにして返す。create が false でキーが無ければ nullptr を返す。
+	Node* getKey(StringRange keyPath, bool create) {
+		Node* node = _root.get();
+		const wchar_t* const path = keyPath.c_str();
+		const int length = keyPath.length();
+		for (int begin = 0; begin < length; ) {
+			int end = begin;
+			while (end < length && path[end] != L'\\') {
+				++end;
+			}
+			const String name(path + begin, end - begin);
+			const wstring foldedName = fold(name);
+			const int index = node->findKey(foldedName);
+			if (0 <= index) {
+				shared_ptr<Node>& child = node->keys[index].node;
+				if (!_copies.count(child.get())) { // 共有しているキーは複製してから書き換える
+					child = make_shared<Node>(*child);
+					_copies.insert(child.get());
+				}
+				node = child.get();
+			} else if (create) {
+				shared_ptr<Node> child = make_shared<Node>();
+				_copies.insert(child.get());
+				node->addKey(name, foldedName, child);
+				node = child.get();
+			} else {
+				return nullptr;
+			}
+			begin = end + 1;
+		}
+		return node;
+	}
+
+	shared_ptr<Node> root() const { return _root; }
+
+private:
+	shared_ptr<Node> _root;
+	unordered_set<const Node*> _copies; // この apply で作成したキー
+};
+
+
+void writeNode(BinaryWriter& writer, const Node& node) {
+	writer.writeVarUInt(node.values.size());
+	for (auto i = node.values.begin(), end = node.values.end(); i != end; ++i) {
+		writer.writeString(i->name);
+		writer.writeVarInt(i->kind);
+		writer.writeVarUInt(i->data.size());
+		if (!i->data.empty()) {
+			writer.write(i->data.data(), 0, i->data.size());
+		}
+	}
+	writer.writeVarUInt(node.keys.size());
+	for (auto i = node.keys.begin(), end = node.keys.end(); i != end; ++i) {
+		writer.writeString(i->name);
+		writeNode(writer, *i->node);
+	}
+}
+
+
+int readCount(BinaryReader& reader) {
+	const unsigned __int64 count = reader.readVarUInt();
+	if (INT_MAX < count) {
+		throw RegistrySnapshot::FormatException();
+	}
+	return static_cast<int>(count);
+}
+
+
+shared_ptr<Node> readNode(BinaryReader& reader, int depth) {
+	if (maxDepth < depth) {
+		throw RegistrySnapshot::FormatException();
+	}
+	shared_ptr<Node> node = make_shared<Node>();
+	const int valueCount = readCount(reader);
+	for (int i = 0; i < valueCount; ++i) {
+		const String name = reader.readString();
+		const __int64 kind = reader.readVarInt();
+		if (kind < REG_NONE || REG_QWORD < kind) { // RegEnumValueW が返す種類をそのまま保存している
+			throw RegistrySnapshot::FormatException();
+		}
+		const int size = readCount(reader);
+		vector<unsigned char> data;
+		while (static_cast<int>(data.size()) < size) { // 実際に読めた分だけ広げる
+			const int offset = data.size();
+			const int count = std::min(size - offset, readChunkSize);
+			data.resize(offset + count);
+			if (reader.read(data.data(), offset, count) < count) {
+				throw RegistrySnapshot::FormatException();
+			}
+		}
+		node->setValue(name, Registry::ValueKind(static_cast<int>(kind)), data);
+	}
+	const int keyCount = readCount(reader);
+	for (int i = 0; i < keyCount; ++i) {
+		const String name = reader.readString();
+		const wstring foldedName = fold(name);
+		if (0 <= node->findKey(foldedName)) {
+			throw RegistrySnapshot::FormatException();
+		}
+		node->addKey(name, foldedName, readNode(reader, depth + 1));
+	}
+	return node;
+}
+
+
+void checkResult(LONG result) {
+	switch (result) {
+		case ERROR_SUCCESS         : break;
+		case ERROR_ACCESS_DENIED   : throw Registry::AccessDeniedException();
+		case ERROR_KEY_DELETED     : throw Registry::KeyDeletedException();
+		default                    : assert("failed to Registry function" && false);
+	}
+}
+
+
+/// キーの値とサブキーを一度の列挙で読み込む。RegEnumValueW は名前と種類とデータを一度に返すので値ごとに問い合わせない。
+void loadNode(Node& node, HKEY key, bool recursive) {
+	DWORD subKeyCount = 0;
+	DWORD maxSubKeyNameLength = 0;
+	DWORD valueCount = 0;
+	DWORD maxValueNameLength = 0;
+	DWORD maxDataSize = 0;
+	checkResult(RegQueryInfoKeyW(key, nullptr, nullptr, nullptr, &subKeyCount, &maxSubKeyNameLength, nullptr
+		, &valueCount, &maxValueNameLength, &maxDataSize, nullptr, nullptr));
+
+	node.values.reserve(valueCount);
+	vector<wchar_t> name(maxValueNameLength + 1);
+	vector<unsigned char> data(maxDataSize);
+	for (DWORD index = 0; ; ) {
+		DWORD nameLength = name.size();
+		DWORD type = REG_NONE;
+		DWORD dataSize = data.size();
+		const LONG result = RegEnumValueW(key, index, name.data(), &nameLength, nullptr, &type, data.empty() ? nullptr : data.data(), &dataSize);
+		if (result == ERROR_NO_MORE_ITEMS) {
+			break;
+		}
+		if (result == ERROR_MORE_DATA) { // 列挙している間に大きな値が書き込まれた
+			name.resize(name.size() * 2);
+			data.resize(dataSize < data.size() ? data.size() * 2 : dataSize);
+			continue;
+		}
+		checkResult(result);
+		node.setValue(String(name.data(), nameLength), Registry::ValueKind(static_cast<int>(type))
+			, vector<unsigned char>(data.begin(), data.begin() + dataSize));
+		++index;
+	}
+
+	if (!recursive) {
+		return;
+	}
+	node.keys.reserve(subKeyCount);
+	vector<wchar_t> keyName(maxSubKeyNameLength + 1);
+	for (DWORD index = 0; ; ++index) {
+		DWORD keyNameLength = keyName.size();
+		LONG result = RegEnumKeyExW(key, index, keyName.data(), &keyNameLength, nullptr, nullptr, nullptr, nullptr);
+		if (result == ERROR_NO_MORE_ITEMS) {
+			break;
+		}
+		if (result == ERROR_MORE_DATA) {
+			keyName.resize(keyName.size() * 2);
+			--index;
+			continue;
+		}
+		checkResult(result);
+		HKEY subKey = nullptr;
+		result = RegOpenKeyExW(key, keyName.data(), 0, KEY_READ, &subKey);
+		if (result == ERROR_FILE_NOT_FOUND) { // 列挙している間に削除された
+			continue;
+		}
+		if (result == ERROR_ACCESS_DENIED) { // 読めないサブキーは飛ばしてスナップショット全体は失敗させない
+			continue;
+		}
+		checkResult(result);
+		scopeExit([&] () {
+			verify(RegCloseKey(subKey) == ERROR_SUCCESS);
+		});
+		const String subKeyName(keyName.data(), keyNameLength);
+		shared_ptr<Node> child = make_shared<Node>();
+		loadNode(*child, subKey, true);
+		node.addKey(subKeyName, fold(subKeyName), child);
+	}
+}
+} // namespace
+
+
+
+RegistrySnapshot::RegistrySnapshot() {
+}
+
+
+RegistrySnapshot::RegistrySnapshot(const RegistrySnapshot& value)
+	: _node(value._node) {
+}
+
+
+RegistrySnapshot::RegistrySnapshot(RegistrySnapshot&& value)
+	: _node(move(value._node)) {
+}
+
+
+RegistrySnapshot::RegistrySnapshot(const shared_ptr<const Node>& node)
+	: _node(node) {
+}
+
+
+RegistrySnapshot::RegistrySnapshot(const Registry& key, bool recursive) {
+	assert("Empty Registry" && key);
+
+	shared_ptr<Node> node = make_shared<Node>();
+	loadNode(*node, key, recursive);
+	_node = node;
+}
+
+
+RegistrySnapshot::~RegistrySnapshot() {
+}
+
+
+RegistrySnapshot& RegistrySnapshot::operator=(const RegistrySnapshot& value) {
+	_node = value._node;
+	return *this;
+}
+
+
+RegistrySnapshot& RegistrySnapshot::operator=(RegistrySnapshot&& value) {
+	if (&value != this) {
+		_node = move(value._node);
+	}
+	return *this;
+}
+
+
+RegistrySnapshot RegistrySnapshot::apply(const RegistryBatch& batch) const {
+	if (_node && batch.empty()) {
+		return *this;
+	}
+	Builder builder(_node.get());
+	const vector<RegistryBatch::Operation>& operations = batch.operations();
+	for (auto i = operations.begin(), end = operations.end(); i != end; ++i) {
+		switch (i->kind) {
+			case RegistryBatch::OperationKind::createKey : {
+				builder.getKey(i->keyPath, true);
+			} break;
+			case RegistryBatch::OperationKind::removeKey : {
+				const int separator = i->keyPath.lastIndexOf(L'\\');
+				Node* parent = builder.getKey(separator < 0 ? String() : i->keyPath.substring(0, separator), false);
+				if (parent) {
+					const int index = parent->findKey(fold(i->keyPath.c_str() + separator + 1));
+					if (0 <= index) {
+						parent->removeKey(index);
+					}
+				}
+			} break;
+			case RegistryBatch::OperationKind::setValue : {
+				builder.getKey(i->keyPath, true)->setValue(i->valueName, i->valueKind, i->data);
+			} break;
+			case RegistryBatch::OperationKind::removeValue : {
+				Node* node = builder.getKey(i->keyPath, false);
+				if (node) {
+					node->removeValue(i->valueName);
+				}
+			} break;
+		}
+	}
+	return RegistrySnapshot(builder.root());
+}
+
+
+vector<unsigned char> RegistrySnapshot::getBinary(StringRange valueName) const {
+	assert("Null RegistrySnapshot" && _node);
+	return _node->getValue(valueName).data;
+}
+
+
+unsigned long RegistrySnapshot::getDword(StringRange valueName) const {
+	assert("Null RegistrySnapshot" && _node);
+
+	const Node::Value& value = _node->getValue(valueName);
+	std::uint32_t result;
+	if (value.data.size() != sizeof(result)) {
+		throw ValueKindMismatchException();
+	}
+	std::memcpy(&result, value.data.data(), sizeof(result));
+	return result;
+}
+
+
+unsigned __int64 RegistrySnapshot::getQword(StringRange valueName) const {
+	assert("Null RegistrySnapshot" && _node);
+
+	const Node::Value& value = _node->getValue(valueName);
+	unsigned __int64 result;
+	if (value.data.size() != sizeof(result)) {
+		throw ValueKindMismatchException();
+	}
+	std::memcpy(&result, value.data.data(), sizeof(result));
+	return result;
+}
+
+
+String RegistrySnapshot::getString(StringRange valueName) const {
+	assert("Null RegistrySnapshot" && _node);
+
+	const Node::Value& value = _node->getValue(valueName);
+	if (value.kind != ValueKind::string
+	 && value.kind != ValueKind::expandString
+	 && value.kind != ValueKind::multiString) {
+		throw ValueKindMismatchException();
+	}
+	int length = value.data.size() / sizeof(wchar_t);
+	if (!length) {
+		return String();
+	}
+	const wchar_t* data = reinterpret_cast<const wchar_t*>(value.data.data());
+	if (!data[length - 1]) { // 終端のヌル文字
+		--length;
+	}
+	return String(data, length);
+}
+
+
+RegistrySnapshot::ValueKind RegistrySnapshot::getValueKind(StringRange valueName) const {
+	assert("Null RegistrySnapshot" && _node);
+
+	const Node::Value* value = _node->findValue(valueName);
+	if (!value) {
+		return ValueKind::notFound;
+	}
+	if (!ValueKind::_validate(value->kind)) {
+		return ValueKind::unknown;
+	}
+	return value->kind;
+}
+
+
+int RegistrySnapshot::keyCount() const {
+	assert("Null RegistrySnapshot" && _node);
+	return _node->keys.size();
+}
+
+
+vector<String> RegistrySnapshot::keyNames() const {
+	assert("Null RegistrySnapshot" && _node);
+
+	vector<String> names;
+	names.reserve(_node->keys.size());
+	for (auto i = _node->keys.begin(), end = _node->keys.end(); i != end; ++i) {
+		names.push_back(i->name);
+	}
+	return names;
+}
+
+
+RegistrySnapshot RegistrySnapshot::openKey(StringRange keyPath) const {
+	assert("Null RegistrySnapshot" && _node);
+	assert("Empty keyPath" && !keyPath.empty());
+
+	shared_ptr<const Node> node = _node;
+	const wchar_t* const path = keyPath.c_str();
+	const int length = keyPath.length();
+	for (int begin = 0; begin < length; ) {
+		int end = begin;
+		while (end < length && path[end] != L'\\') {
+			++end;
+		}
+		const int index = node->findKey(fold(StringRange(path + begin, end - begin)));
+		if (index < 0) {
+			return RegistrySnapshot();
+		}
+		node = node->keys[index].node;
+		begin = end + 1;
+	}
+	return RegistrySnapshot(node);
+}
+
+
+RegistrySnapshot RegistrySnapshot::read(Stream& stream) {
+	BinaryReader reader(stream);
+	try {
+		unsigned char header[sizeof(magic) + 1];
+		if (reader.read(header, 0, sizeof(header)) < static_cast<int>(sizeof(header))
+		 || std::memcmp(header, magic, sizeof(magic)) || header[sizeof(magic)] != version) {
+			throw FormatException();
+		}
+		return RegistrySnapshot(readNode(reader, 0));
+	} catch (BinaryReader::EndOfStreamException& ) {
+		throw FormatException();
+	} catch (BinaryReader::FormatException& ) {
+		throw FormatException();
+	}
+}
+
+
+int RegistrySnapshot::valueCount() const {
+	assert("Null RegistrySnapshot" && _node);
+	return _node->values.size();
+}
+
+
+vector<String> RegistrySnapshot::valueNames() const {
+	assert("Null RegistrySnapshot" && _node);
+
+	vector<String> names;
+	names.reserve(_node->values.size());
+	for (auto i = _node->values.begin(), end = _node->values.end(); i != end; ++i) {
+		names.push_back(i->name);
+	}
+	return names;
+}
+
+
+void RegistrySnapshot::write(Stream& stream) const {
+	assert("Null RegistrySnapshot" && _node);
+
+	BinaryWriter writer(stream);
+	writer.write(magic, 0, sizeof(magic));
+	writer.writeByte(version);
+	writeNode(writer, *_node);
+	writer.flush();
+}
+
+
+RegistrySnapshot::operator bool() const {
+	return _node != nullptr;
+}
+
+
+
+	}
+}
@@ -0,0 +1,104 @@
+﻿#pragma once
+
+#include <memory>
+#include <vector>
+
+#include <balor/io/Registry.hpp>
+#include <balor/Exception.hpp>
+#include <balor/String.hpp>
+#include <balor/StringRange.hpp>
+
+
+namespace balor {
+	namespace io {
+
+class RegistryBatch;
+class Stream;
+
+
+
+/**
+ * レジストリのキー以下を一度に読み込んだ変更できないツリー。
+ *
+ * Registry::snapshot や RegistryFile::snapshot で作成する。値の取得はメモリ上のハッシュテーブルを引くだけで、レジストリにアクセスしない。
+ * キー名と値名は Registry と同じく大文字と小文字を区別しない。値の取得関数の例外も Registry と同じ。
+ * 変更できないので複数のスレッドから同時に読んでよい。コピーはツリーを共有するだけなので軽い。
+ * apply 関数は RegistryBatch を反映した新しいスナップショットを返し、変更の無いサブキーは元のスナップショットと共有する。
+ * write 関数と read 関数でストリームに保存して読み込める。
+ *
+ * <h3>・サンプルコード</h3>
+ * <pre><code>
+	RegistrySnapshot settings = Registry(L"HKEY_CURRENT_USER\\Software\\MyApp").snapshot(true);
+	RegistrySnapshot window = settings.openKey(L"Window");
+	if (window && window.getValueKind(L"Width") == Registry::ValueKind::dword) {
+		width = window.getDword(L"Width");
+	}
+ * </code></pre>
+ */
+class RegistrySnapshot {
+public:
+	typedef Registry::ValueKind ValueKind;
+	typedef Registry::ValueKindMismatchException ValueKindMismatchException;
+	typedef Registry::ValueNotFoundException ValueNotFoundException;
+
+	/// read で読み込んだデータの形式が正しくなかった。
+	class FormatException : public Exception {};
+
+	struct Node;
+
+public:
+	/// null 状態。apply すると空のキーに反映したものになる。
+	RegistrySnapshot();
+	RegistrySnapshot(const RegistrySnapshot& value);
+	RegistrySnapshot(RegistrySnapshot&& value);
+	~RegistrySnapshot();
+
+	RegistrySnapshot& operator=(const RegistrySnapshot& value);
+	RegistrySnapshot& operator=(RegistrySnapshot&& value);
+
+public:
+	/// batch を反映したスナップショットを返す。キーのパスはこのスナップショットのキーからの相対パス。
+	RegistrySnapshot apply(const RegistryBatch& batch) const;
+	/// あらゆる種類の値をバイナリ形式で返す。
+	std::vector<unsigned char> getBinary(StringRange valueName) const;
+	/// DWORD 型の値を返す。
+	unsigned long getDword(StringRange valueName) const;
+	/// QWORD 型の値を返す。
+	unsigned __int64 getQword(StringRange valueName) const;
+	/// String 型で受け取れる値を返す。
+	String getString(StringRange valueName) const;
+	/// 値の種類を返す。値が見つからなければ Registry::ValueKind::notFound を返す。
+	RegistrySnapshot::ValueKind getValueKind(StringRange valueName) const;
+	/// サブキーの数。
+	int keyCount() const;
+	/// サブキー名の配列。
+	std::vector<String> keyNames() const;
+	/// "\\" で区切ったサブキーのパスのスナップショット。存在しなかった場合は null の RegistrySnapshot を返す。
+	RegistrySnapshot openKey(StringRange keyPath) const;
+	/// write で書き込んだスナップショットを読み込む。
+	static RegistrySnapshot read(Stream& stream);
+	/// 値の数。
+	int valueCount() const;
+	/// 値名の配列。
+	std::vector<String> valueNames() const;
+	/// スナップショットをストリームに書き込む。
+	void write(Stream& stream) const;
+
+public:
+	/// null チェック用。
+	operator bool() const;
+
+private:
+	friend Registry;
+
+	explicit RegistrySnapshot(const std::shared_ptr<const Node>& node);
+	/// Registry::snapshot の実装。
+	RegistrySnapshot(const Registry& key, bool recursive);
+
+	std::shared_ptr<const Node> _node;
+};
+
+
+
+	}
+}
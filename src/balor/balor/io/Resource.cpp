@@ -6,6 +6,7 @@
 #include <balor/graphics/Cursor.hpp>
 #include <balor/graphics/Icon.hpp>
 #include <balor/io/MemoryStream.hpp>
+#include <balor/io/StringTable.hpp>
 #include <balor/system/windows.hpp>
 #include <balor/test/verify.hpp>
 #include <balor/scopeExit.hpp>
@@ -175,30 +176,13 @@ MemoryStream Resource::getRawData(int id) {
 
 
 MemoryStream Resource::getRawData(StringRange name) {
-	HRSRC resource = nullptr;
-	if (locale() != Locale::invariant() && !isId(name)) {
-		resource = FindResourceW(_module, getLocalName(name, _localeName), reinterpret_cast<LPWSTR>(RT_RCDATA));
-	}
-	if (!resource) {
-		resource = FindResourceW(_module, name.c_str(), reinterpret_cast<LPWSTR>(RT_RCDATA));
-	}
-	if (!resource) {
-		throw NotFoundException();
-	}
-	HGLOBAL const global = LoadResource(_module, resource);
-	assert("Failed to LoadResource" && global);
-	void* const buffer = LockResource(global);
-	assert("Failed to LockResource" && buffer);
-	const DWORD size = SizeofResource(_module, resource);
-	assert(size <= INT_MAX);
-	return MemoryStream(buffer, 0, size, false);
+	const ArrayRange<const unsigned char> data = view(name);
+	return MemoryStream(const_cast<unsigned char*>(data.begin()), 0, data.size(), false); // 書き込み不可なので const を外しても変更されない
 }
 
 
 String Resource::getString(int id) {
-	StringBuffer buffer;
-	getStringToBuffer(buffer, id);
-	return move(buffer);
+	return StringTable::shared(_module, _locale).getString(id);
 }
 
 
@@ -210,13 +194,7 @@ String Resource::getString(StringRange name) {
 
 
 void Resource::getStringToBuffer(StringBuffer& buffer, int id) {
-	assert("Invalid resource id" && 0 <= id && id <= USHRT_MAX);
-	wchar_t array[2048];
-	int length = LoadStringW(_module, id, array, sizeof(array) / sizeof(array[0]));
-	if (!length) {
-		throw NotFoundException();
-	}
-	buffer += String::refer(array, length);
+	buffer += StringTable::shared(_module, _locale).getString(id);
 }
 
 
@@ -310,6 +288,32 @@ Locale Resource::locale() const {
 }
 
 
+ArrayRange<const unsigned char> Resource::view(int id) {
+	return view(idToName(id));
+}
+
+
+ArrayRange<const unsigned char> Resource::view(StringRange name) {
+	HRSRC resource = nullptr;
+	if (locale() != Locale::invariant() && !isId(name)) {
+		resource = FindResourceW(_module, getLocalName(name, _localeName), reinterpret_cast<LPWSTR>(RT_RCDATA));
+	}
+	if (!resource) {
+		resource = FindResourceW(_module, name.c_str(), reinterpret_cast<LPWSTR>(RT_RCDATA));
+	}
+	if (!resource) {
+		throw NotFoundException();
+	}
+	HGLOBAL const global = LoadResource(_module, resource);
+	assert("Failed to LoadResource" && global);
+	const void* const buffer = LockResource(global);
+	assert("Failed to LockResource" && buffer);
+	const DWORD size = SizeofResource(_module, resource);
+	assert(size <= INT_MAX);
+	return ArrayRange<const unsigned char>(static_cast<const unsigned char*>(buffer), size);
+}
+
+
 
 	}
 }
\ No newline at end of file
@@ -3,6 +3,7 @@
 #include <hash_map>
 
 #include <balor/locale/Locale.hpp>
+#include <balor/ArrayRange.hpp>
 #include <balor/OutOfMemoryException.hpp>
 #include <balor/String.hpp>
 
@@ -33,6 +34,8 @@ class MemoryStream;
  * 文字列リソースについては特別で、リソース ID を使用する場合は従来どおり STRINGTABLE リソースを使うがリソース名を使用する場合は
  * namedStringTable という名前の RCDATA リソースを探す。この名前にもロケール名の修飾が付く。
  * RCDATA リソースの内容として文字列名と文字列の二つのカラムを持つユニコードの CSV テキストファイルを用意する必要がある。
+ * STRINGTABLE リソースはモジュールとロケールごとに共有する StringTable でキャッシュし、ロケールの言語のものを優先する。
+ * getString(int) はキャッシュした文字列を参照する String を返すのでメモリを割り当てない。
  */
 class Resource {
 public:
@@ -72,12 +75,16 @@ public:
 	MemoryStream getRawData(int id);
 	MemoryStream getRawData(StringRange name);
 	/// 文字列リソースを取得する。名前を指定する文字列リソースの作り方についてはクラスドキュメントを参照。
+	/// ID を指定した場合は StringTable::shared の文字列を参照して返すので、返した String はプロセスが終わるまで有効。
 	String getString(int id);
 	String getString(StringRange name);
 	void getStringToBuffer(StringBuffer& buffer, int id);
 	void getStringToBuffer(StringBuffer& buffer, StringRange name);
 	/// リソースのロケール。
 	Locale locale() const;
+	/// RCDATA リソースのメモリをコピーせずに返す。メモリはリソースの入ったモジュールがアンロードされるまで有効。
+	ArrayRange<const unsigned char> view(int id);
+	ArrayRange<const unsigned char> view(StringRange name);
 
 private:
 	HMODULE _module;
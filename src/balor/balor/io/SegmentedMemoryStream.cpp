@@ -0,0 +1,338 @@
+﻿#include "SegmentedMemoryStream.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <utility>
+
+#define BOOST_DATE_TIME_NO_LIB
+#define BOOST_THREAD_NO_LIB
+#include <boost/thread.hpp>
+
+#include <balor/system/windows.hpp> // IsBadWritePtr, IsBadReadPtrのassertの為だけに必要
+#include <balor/test/verify.hpp>
+#include <balor/Singleton.hpp>
+
+
+namespace balor {
+	namespace io {
+
+using boost::mutex;
+using std::max;
+using std::min;
+using std::swap;
+using std::vector;
+
+
+namespace {
+class GlobalPool {
+	friend Singleton<GlobalPool>;
+
+	GlobalPool() {}
+	~GlobalPool() {}
+
+public:
+	SegmentedMemoryStream::Pool pool;
+};
+} // namespace
+
+
+
+struct SegmentedMemoryStream::Pool::Impl {
+	mutex chunksMutex;
+	vector<unsigned char*> chunks;
+};
+
+
+SegmentedMemoryStream::Pool::Pool(int chunkSize, __int64 maxRetainedSize)
+	: _chunkSize(chunkSize), _maxRetainedSize(maxRetainedSize), _impl(new Impl()) {
+	assert("Non positive chunkSize" && 0 < chunkSize);
+	assert("Negative maxRetainedSize" && 0 <= maxRetainedSize);
+}
+
+
+SegmentedMemoryStream::Pool::~Pool() {
+	trim();
+}
+
+
+unsigned char* SegmentedMemoryStream::Pool::allocate() {
+	{
+		mutex::scoped_lock lock(_impl->chunksMutex);
+		if (!_impl->chunks.empty()) {
+			unsigned char* chunk = _impl->chunks.back();
+			_impl->chunks.pop_back();
+			return chunk;
+		}
+	}
+	return new unsigned char[_chunkSize];
+}
+
+
+int SegmentedMemoryStream::Pool::chunkSize() const {
+	return _chunkSize;
+}
+
+
+void SegmentedMemoryStream::Pool::deallocate(unsigned char* chunk) {
+	assert("Null chunk" && chunk);
+	{
+		mutex::scoped_lock lock(_impl->chunksMutex);
+		if (static_cast<__int64>(_impl->chunks.size() + 1) * _chunkSize <= _maxRetainedSize) {
+			_impl->chunks.push_back(chunk);
+			return;
+		}
+	}
+	delete [] chunk;
+}
+
+
+SegmentedMemoryStream::Pool& SegmentedMemoryStream::Pool::global() {
+	return Singleton<GlobalPool>::get().pool;
+}
+
+
+__int64 SegmentedMemoryStream::Pool::maxRetainedSize() const {
+	return _maxRetainedSize;
+}
+
+
+int SegmentedMemoryStream::Pool::retainedCount() const {
+	mutex::scoped_lock lock(_impl->chunksMutex);
+	return _impl->chunks.size();
+}
+
+
+void SegmentedMemoryStream::Pool::trim() {
+	vector<unsigned char*> chunks;
+	{
+		mutex::scoped_lock lock(_impl->chunksMutex);
+		chunks.swap(_impl->chunks);
+	}
+	for (auto i = chunks.begin(), end = chunks.end(); i != end; ++i) {
+		delete [] *i;
+	}
+}
+
+
+
+SegmentedMemoryStream::SegmentedMemoryStream(SegmentedMemoryStream::Pool& pool)
+	: _pool(&pool), _chunkSize(pool.chunkSize()), _length(0), _position(0) {
+}
+
+
+SegmentedMemoryStream::SegmentedMemoryStream(SegmentedMemoryStream&& value)
+	: _pool(value._pool), _chunkSize(value._chunkSize), _chunks(std::move(value._chunks)), _length(value._length), _position(value._position) {
+	value._pool = nullptr;
+	value._chunks.clear();
+	value._length = 0;
+	value._position = 0;
+}
+
+
+SegmentedMemoryStream::~SegmentedMemoryStream() {
+	for (auto i = _chunks.begin(), end = _chunks.end(); i != end; ++i) {
+		_pool->deallocate(*i);
+	}
+}
+
+
+SegmentedMemoryStream& SegmentedMemoryStream::operator=(SegmentedMemoryStream&& value) {
+	if (this != &value) {
+		swap(_pool, value._pool);
+		swap(_chunkSize, value._chunkSize);
+		swap(_chunks, value._chunks);
+		swap(_length, value._length);
+		swap(_position, value._position);
+	}
+	return *this;
+}
+
+
+__int64 SegmentedMemoryStream::capacity() const {
+	return static_cast<__int64>(_chunks.size()) * _chunkSize;
+}
+
+
+ArrayRange<const unsigned char> SegmentedMemoryStream::chunk(int index) const {
+	assert("Invalid SegmentedMemoryStream" && _pool);
+	assert("index out of range" && 0 <= index);
+	assert("index out of range" && index < chunkCount());
+
+	const __int64 first = static_cast<__int64>(index) * _chunkSize;
+	return ArrayRange<const unsigned char>(_chunks[index], static_cast<int>(min(static_cast<__int64>(_chunkSize), _length - first)));
+}
+
+
+int SegmentedMemoryStream::chunkCount() const {
+	return static_cast<int>((_length + _chunkSize - 1) / _chunkSize);
+}
+
+
+int SegmentedMemoryStream::chunkSize() const {
+	return _chunkSize;
+}
+
+
+void SegmentedMemoryStream::flush() {
+	// 何もしない
+}
+
+
+__int64 SegmentedMemoryStream::length() const {
+	return _length;
+}
+
+
+void SegmentedMemoryStream::length(__int64 value) {
+	assert("Invalid SegmentedMemoryStream" && _pool);
+	assert("Negative length" && 0 <= value);
+
+	if (_length < value) {
+		reserve(value);
+		for (__int64 i = _length; i < value;) { // 借りたチャンクの中身は不定なので 0 で埋める
+			const int offset = static_cast<int>(i % _chunkSize);
+			const int count = static_cast<int>(min(static_cast<__int64>(_chunkSize - offset), value - i));
+			std::memset(_chunks[static_cast<std::size_t>(i / _chunkSize)] + offset, 0, count);
+			i += count;
+		}
+	} else {
+		const std::size_t usedCount = static_cast<std::size_t>((value + _chunkSize - 1) / _chunkSize);
+		while (usedCount < _chunks.size()) {
+			_pool->deallocate(_chunks.back());
+			_chunks.pop_back();
+		}
+	}
+	_length = value;
+}
+
+
+SegmentedMemoryStream::Pool& SegmentedMemoryStream::pool() const {
+	assert("Invalid SegmentedMemoryStream" && _pool);
+	return *_pool;
+}
+
+
+__int64 SegmentedMemoryStream::position() const {
+	return _position;
+}
+
+
+void SegmentedMemoryStream::position(__int64 value) {
+	assert("Invalid SegmentedMemoryStream" && _pool);
+	assert("Negative position" && 0 <= value);
+
+	_position = max(static_cast<__int64>(0), value);
+}
+
+
+int SegmentedMemoryStream::read(void* buffer, int offset, int count) {
+	assert("Invalid SegmentedMemoryStream" && _pool);
+	assert("Null buffer" && buffer);
+	assert("Negative offset" && 0 <= offset);
+	assert("Negative count" && 0 <= count);
+	assert("buffer is bad write pointer" && !IsBadWritePtr(static_cast<unsigned char*>(buffer) + offset, count));
+
+	if (_length <= _position) {
+		return 0;
+	}
+	const int readCount = static_cast<int>(min(static_cast<__int64>(count), _length - _position));
+	unsigned char* destination = static_cast<unsigned char*>(buffer) + offset;
+	for (int i = 0; i < readCount;) {
+		const int chunkOffset = static_cast<int>(_position % _chunkSize);
+		const int copyCount = min(_chunkSize - chunkOffset, readCount - i);
+		std::memcpy(destination + i, _chunks[static_cast<std::size_t>(_position / _chunkSize)] + chunkOffset, copyCount);
+		_position += copyCount;
+		i += copyCount;
+	}
+	return readCount;
+}
+
+
+bool SegmentedMemoryStream::readable() const {
+	return true;
+}
+
+
+void SegmentedMemoryStream::reserve(__int64 value) {
+	const std::size_t count = static_cast<std::size_t>((value + _chunkSize - 1) / _chunkSize);
+	if (_chunks.size() < count) {
+		_chunks.reserve(max(count, _chunks.size() * 2)); // push_back で例外が出てチャンクがリークしないように先に場所を作る
+		while (_chunks.size() < count) {
+			_chunks.push_back(_pool->allocate());
+		}
+	}
+}
+
+
+__int64 SegmentedMemoryStream::skip(__int64 offset) {
+	assert("Invalid SegmentedMemoryStream" && _pool);
+
+	const __int64 oldPosition = _position;
+	_position = max(static_cast<__int64>(0), oldPosition + offset);
+	return _position - oldPosition;
+}
+
+
+std::vector<unsigned char> SegmentedMemoryStream::toContiguous() const {
+	assert("Invalid SegmentedMemoryStream" && _pool);
+	assert("length too large for contiguous memory" && static_cast<unsigned __int64>(_length) <= vector<unsigned char>().max_size());
+
+	vector<unsigned char> result(static_cast<std::size_t>(_length));
+	std::size_t first = 0;
+	for (int i = 0, end = chunkCount(); i < end; ++i) {
+		const auto range = chunk(i);
+		std::memcpy(result.data() + first, range.begin(), range.length());
+		first += range.length();
+	}
+	return result;
+}
+
+
+void SegmentedMemoryStream::write(const void* buffer, int offset, int count) {
+	assert("Invalid SegmentedMemoryStream" && _pool);
+	assert("Null buffer" && buffer);
+	assert("Negative offset" && 0 <= offset);
+	assert("Negative count" && 0 <= count);
+	assert("buffer is bad read pointer" && !IsBadReadPtr(buffer, offset + count));
+
+	if (!count) {
+		return;
+	}
+	const __int64 newPosition = _position + count;
+	if (_length < newPosition) {
+		if (_length < _position) {
+			length(_position);
+		}
+		reserve(newPosition);
+	}
+	const unsigned char* source = static_cast<const unsigned char*>(buffer) + offset;
+	for (int i = 0; i < count;) {
+		const int chunkOffset = static_cast<int>(_position % _chunkSize);
+		const int copyCount = min(_chunkSize - chunkOffset, count - i);
+		std::memcpy(_chunks[static_cast<std::size_t>(_position / _chunkSize)] + chunkOffset, source + i, copyCount);
+		_position += copyCount;
+		i += copyCount;
+	}
+	_length = max(_length, newPosition);
+}
+
+
+bool SegmentedMemoryStream::writable() const {
+	return true;
+}
+
+
+void SegmentedMemoryStream::writeTo(Stream& stream) const {
+	assert("Invalid SegmentedMemoryStream" && _pool);
+	assert("Can't write to self" && &stream != this);
+
+	for (int i = 0, end = chunkCount(); i < end; ++i) {
+		const auto range = chunk(i);
+		stream.write(range.begin(), 0, range.length());
+	}
+}
+
+
+
+	}
+}
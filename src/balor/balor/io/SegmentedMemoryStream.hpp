@@ -0,0 +1,131 @@
+﻿#pragma once
+
+#include <memory>
+#include <vector>
+
+#include <balor/io/Stream.hpp>
+#include <balor/ArrayRange.hpp>
+#include <balor/NonCopyable.hpp>
+
+
+namespace balor {
+	namespace io {
+
+
+
+/**
+ * 固定長のチャンクをつないでデータを保持するメモリストリーム。
+ *
+ * MemoryStream は一つの連続したバッファを持ち、拡張する度にバッファ全体を確保し直してコピーするので、大きなデータでは一時的に倍近くのメモリを使い、長さも int の範囲に制限される。
+ * SegmentedMemoryStream はデータを Pool から借りた同じ大きさのチャンクに分けて保持するので、拡張してもコピーは発生せず、長さと位置は __int64 の範囲で扱える。
+ * チャンクは破棄や length 関数で縮めた時に Pool に返され、次のストリームで再利用される。Pool は複数のスレッドから同時に使える。
+ * chunk 関数でチャンクのメモリをコピーせずに参照できる。連続したメモリが必要な場合だけ toContiguous 関数でコピーする。
+ * データの終わりより後ろに位置を移動して書き込むと、間は 0 で埋められる。
+ * Pool はそれを使うストリームより後に破棄すること。
+ *
+ * <h3>・サンプルコード</h3>
+ * <pre><code>
+	SegmentedMemoryStream stream;
+	FileStream file(L"huge.bin", FileStream::Mode::open, FileStream::Access::read);
+	char buffer[64 * 1024];
+	for (int count = file.read(buffer, 0, sizeof(buffer)); count; count = file.read(buffer, 0, sizeof(buffer))) {
+		stream.write(buffer, 0, count);
+	}
+
+	unsigned int sum = 0;
+	for (int i = 0, end = stream.chunkCount(); i < end; ++i) { // チャンクのメモリを直接読む
+		auto chunk = stream.chunk(i);
+		for (auto j = chunk.begin(), jend = chunk.end(); j != jend; ++j) {
+			sum += *j;
+		}
+	}
+ * </code></pre>
+ */
+class SegmentedMemoryStream : public Stream {
+public:
+	/// チャンクを再利用する為に保持するプール。複数のスレッドから同時に使える。
+	class Pool : private ::balor::NonCopyable {
+	public:
+		/// チャンクのバイト数と、返されたチャンクを保持しておく最大のバイト数を指定して作成する。
+		explicit Pool(int chunkSize = 64 * 1024, __int64 maxRetainedSize = 64 * 1024 * 1024);
+		/// 保持しているチャンクを解放する。
+		~Pool();
+
+	public:
+		/// チャンクを一つ借りる。保持しているチャンクが無ければ新しく確保する。中身は不定。
+		unsigned char* allocate();
+		/// チャンクのバイト数。
+		int chunkSize() const;
+		/// 借りていたチャンクを返す。保持する最大のバイト数を越える分は解放する。
+		void deallocate(unsigned char* chunk);
+		/// ライブラリ全体で共有するプール。
+		static Pool& global();
+		/// 返されたチャンクを保持しておく最大のバイト数。
+		__int64 maxRetainedSize() const;
+		/// 保持しているチャンクの数。
+		int retainedCount() const;
+		/// 保持しているチャンクを全て解放する。
+		void trim();
+
+	private:
+		struct Impl;
+
+		int _chunkSize;
+		__int64 _maxRetainedSize;
+		std::unique_ptr<Impl> _impl;
+	};
+
+	// オーバーロード関数のオーバーライド用
+	using Stream::read;
+	using Stream::write;
+
+public:
+	/// チャンクを借りるプールを指定して作成する。
+	explicit SegmentedMemoryStream(SegmentedMemoryStream::Pool& pool = Pool::global());
+	SegmentedMemoryStream(SegmentedMemoryStream&& value);
+	/// チャンクを全てプールに返す。
+	virtual ~SegmentedMemoryStream();
+
+	SegmentedMemoryStream& operator=(SegmentedMemoryStream&& value);
+
+public:
+	/// 確保しているチャンクのバイト数の合計。
+	__int64 capacity() const;
+	/// index 番目のチャンクのデータをコピーせずに返す。最後のチャンクはデータの終わりまでの範囲になる。書き込んでもチャンクのメモリは移動しないが、length で縮めると無効になる。
+	ArrayRange<const unsigned char> chunk(int index) const;
+	/// データを保持しているチャンクの数。
+	int chunkCount() const;
+	/// チャンクのバイト数。
+	int chunkSize() const;
+	virtual void flush();
+	virtual __int64 length() const;
+	/// データの長さを変更する。伸ばした部分は 0 で埋め、縮めて不要になったチャンクはプールに返す。
+	void length(__int64 value);
+	/// チャンクを借りているプール。
+	SegmentedMemoryStream::Pool& pool() const;
+	virtual __int64 position() const;
+	virtual void position(__int64 value);
+	virtual int read(void* buffer, int offset, int count);
+	virtual bool readable() const;
+	virtual __int64 skip(__int64 offset);
+	/// データ全体を一つの連続したメモリにコピーして返す。
+	std::vector<unsigned char> toContiguous() const;
+	virtual void write(const void* buffer, int offset, int count);
+	virtual bool writable() const;
+	/// データ全体をチャンクごとに stream に書き込む。位置は変わらない。
+	void writeTo(Stream& stream) const;
+
+private:
+	void reserve(__int64 value);
+
+	Pool* _pool;
+	int _chunkSize;
+	std::vector<unsigned char*> _chunks;
+	__int64 _length;
+	__int64 _position;
+};
+
+
+
+	}
+}
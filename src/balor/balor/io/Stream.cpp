@@ -1,9 +1,118 @@
 ﻿#include "Stream.hpp"
 
+#include <cstdint>
+#include <exception>
+#include <vector>
+
+#define BOOST_DATE_TIME_NO_LIB
+#define BOOST_THREAD_NO_LIB
+#include <boost/thread.hpp>
+
+#include <balor/test/verify.hpp>
+
 
 namespace balor {
 	namespace io {
 
+using boost::condition_variable;
+using boost::mutex;
+using boost::thread;
+using std::exception_ptr;
+using std::vector;
+
+
+namespace {
+const int copyAlignment = 4096; // copyTo のバッファをページ境界に揃える
+
+
+/// count バイトになるか終わりに達するまで読み込みを繰り返す。
+int readFully(Stream& stream, unsigned char* buffer, int count) {
+	int total = 0;
+	while (total < count) {
+		const int readCount = stream.read(buffer, total, count - total);
+		if (!readCount) {
+			break;
+		}
+		total += readCount;
+	}
+	return total;
+}
+
+
+/// copyTo の書き込みを行うスレッド。書き込んでいる間に呼び出し元のスレッドが次のバッファを読み込む。
+class OverlappedWriter : private NonCopyable {
+public:
+	explicit OverlappedWriter(Stream& stream) : _stream(stream), _buffer(nullptr), _count(0), _exit(false), _thread([this] () { run(); }) {
+	}
+	/// 書き込み中のバッファがあれば書き終わるのを待ってからスレッドを終了する。
+	~OverlappedWriter() {
+		{
+			mutex::scoped_lock lock(_mutex);
+			_exit = true;
+		}
+		_condition.notify_all();
+		_thread.join();
+	}
+
+	/// 前のバッファを書き終わるのを待ってから buffer の書き込みを始める。
+	void write(const unsigned char* buffer, int count) {
+		wait();
+		{
+			mutex::scoped_lock lock(_mutex);
+			_buffer = buffer;
+			_count = count;
+		}
+		_condition.notify_all();
+	}
+
+	/// 書き終わるのを待つ。書き込みが例外を投げていれば投げ直す。
+	void wait() {
+		mutex::scoped_lock lock(_mutex);
+		while (_buffer) {
+			_condition.wait(lock);
+		}
+		if (_error) {
+			exception_ptr error = _error;
+			_error = exception_ptr();
+			std::rethrow_exception(error);
+		}
+	}
+
+private:
+	void run() {
+		mutex::scoped_lock lock(_mutex);
+		for (;;) {
+			while (!_buffer && !_exit) {
+				_condition.wait(lock);
+			}
+			if (!_buffer) {
+				return;
+			}
+			lock.unlock();
+			exception_ptr error;
+			try {
+				_stream.write(_buffer, 0, _count);
+			} catch (...) {
+				error = std::current_exception();
+			}
+			lock.lock();
+			_buffer = nullptr;
+			_error = error;
+			_condition.notify_all();
+		}
+	}
+
+	Stream& _stream;
+	mutex _mutex;
+	condition_variable _condition;
+	const unsigned char* _buffer;
+	int _count;
+	bool _exit;
+	exception_ptr _error;
+	thread _thread; // 他のメンバーの初期化が終わってから開始する
+};
+} // namespace
+
 
 
 Stream::Stream() {
@@ -14,6 +123,37 @@ Stream::~Stream() {
 }
 
 
+__int64 Stream::copyTo(Stream& destination, int bufferSize) {
+	assert("Can't copy to self" && &destination != this);
+	assert("Non positive bufferSize" && 0 < bufferSize);
+	assert("read unsupported" && readable());
+	assert("write unsupported" && destination.writable());
+
+	const int stride = (bufferSize + copyAlignment - 1) / copyAlignment * copyAlignment;
+	vector<unsigned char> memory(static_cast<std::size_t>(stride) * 2 + copyAlignment);
+	unsigned char* buffers[2];
+	buffers[0] = memory.data() + (copyAlignment - reinterpret_cast<std::uintptr_t>(memory.data()) % copyAlignment) % copyAlignment;
+	buffers[1] = buffers[0] + stride;
+
+	int count = readFully(*this, buffers[0], bufferSize);
+	if (count < bufferSize) { // 一度で読み終わったならスレッドを使わない
+		if (count) {
+			destination.write(buffers[0], 0, count);
+		}
+		return count;
+	}
+	__int64 total = 0;
+	OverlappedWriter writer(destination);
+	for (int current = 0; count; current ^= 1) {
+		writer.write(buffers[current], count);
+		total += count;
+		count = count < bufferSize ? 0 : readFully(*this, buffers[current ^ 1], bufferSize);
+	}
+	writer.wait();
+	return total;
+}
+
+
 int Stream::read() {
 	unsigned char byte;
 	if (0 < read(&byte, 0, 1)) {
@@ -24,11 +164,41 @@ int Stream::read() {
 }
 
 
+int Stream::readv(ArrayRange<const Stream::Slice> slices) {
+	for (auto i = slices.begin(), end = slices.end(); i != end; ++i) {
+		assert("Null slice buffer" && (i->buffer || !i->count));
+		assert("Negative slice count" && 0 <= i->count);
+	}
+	int total = 0;
+	for (auto i = slices.begin(), end = slices.end(); i != end; ++i) {
+		const int count = i->count ? read(i->buffer, 0, i->count) : 0;
+		total += count;
+		if (count < i->count) {
+			break;
+		}
+	}
+	return total;
+}
+
+
 void Stream::write(unsigned char value) {
 	write(&value, 0, 1);
 }
 
 
+void Stream::writev(ArrayRange<const Stream::ConstSlice> slices) {
+	for (auto i = slices.begin(), end = slices.end(); i != end; ++i) {
+		assert("Null slice buffer" && (i->buffer || !i->count));
+		assert("Negative slice count" && 0 <= i->count);
+	}
+	for (auto i = slices.begin(), end = slices.end(); i != end; ++i) {
+		if (i->count) {
+			write(i->buffer, 0, i->count);
+		}
+	}
+}
+
+
 
 	}
 }
\ No newline at end of file
@@ -1,5 +1,6 @@
 ﻿#pragma once
 
+#include <balor/ArrayRange.hpp>
 #include <balor/NonCopyable.hpp>
 
 
@@ -10,13 +11,52 @@ namespace balor {
 
 /**
  * バイナリストリームを表す抽象クラス。
+ *
+ * readv, writev 関数は複数のバッファをまとめて読み書きする。ヘッダと本体のように別々のバッファにあるデータを一時バッファに連結せずに一度に書き込める。
+ * 既定の実装は read, write を順に呼ぶだけなので、派生クラスはより効率の良い方法があればオーバーライドする。
+ * copyTo 関数は現在位置から終わりまでを別のストリームにコピーする。既定の実装は二つのバッファを交互に使い、一方に読み込んでいる間にもう一方を別のスレッドで書き込む。
+ *
+ * <h3>・サンプルコード</h3>
+ * <pre><code>
+	FileStream file(L"records.bin", FileStream::Mode::append, FileStream::Access::write);
+	const char payload[] = "hello";
+	const int length = sizeof(payload);
+	Stream::ConstSlice slices[] = {
+		Stream::ConstSlice(&length, 0, sizeof(length)),
+		Stream::ConstSlice(payload, 0, sizeof(payload)),
+	};
+	file.writev(slices); // 長さと本体を一度に書き込む
+ * </code></pre>
  */
 class Stream : private NonCopyable {
+public:
+	/// readv で読み込むバッファの範囲。
+	struct Slice {
+		Slice() : buffer(nullptr), count(0) {}
+		Slice(void* buffer, int offset, int count) : buffer(static_cast<char*>(buffer) + offset), count(count) {}
+
+		void* buffer;
+		int count;
+	};
+
+	/// writev で書き込むバッファの範囲。
+	struct ConstSlice {
+		ConstSlice() : buffer(nullptr), count(0) {}
+		ConstSlice(const void* buffer, int offset, int count) : buffer(static_cast<const char*>(buffer) + offset), count(count) {}
+		ConstSlice(const Slice& slice) : buffer(slice.buffer), count(slice.count) {}
+
+		const void* buffer;
+		int count;
+	};
+
 protected:
 	Stream();
 	virtual ~Stream();
 
 public:
+	/// 現在位置から終わりまで読み出して destination に書き込み、コピーしたバイト数を返す。bufferSize は一度に読み書きするバイト数。
+	/// 一度の読み込みで終わらない場合は読み込みと書き込みを別のスレッドで並行して行う。
+	virtual __int64 copyTo(Stream& destination, int bufferSize = 1024 * 1024);
 	/// ストリームのバッファをフラッシュ（同期）する。
 	virtual void flush() = 0;
 	/// ストリームの長さ。
@@ -30,6 +70,8 @@ public:
 	virtual int read(void* buffer, int offset, int count) = 0;
 	/// 読み出し可能かどうか。
 	virtual bool readable() const = 0;
+	/// slices に順に読み出して、実際に読み出したバイト数の合計を返す。読み出したバイト数が slice の大きさに満たなければそこで止める。
+	virtual int readv(ArrayRange<const Stream::Slice> slices);
 	/// 現在位置から指定したバイト数分移動する。
 	virtual __int64 skip(__int64 offset) = 0;
 	/// １バイト書き込む。
@@ -38,6 +80,8 @@ public:
 	virtual void write(const void* buffer, int offset, int count) = 0;
 	/// 書き込み可能かどうか。
 	virtual bool writable() const = 0;
+	/// slices を順に全て書き込む。
+	virtual void writev(ArrayRange<const Stream::ConstSlice> slices);
 };
 
 
@@ -0,0 +1,199 @@
+﻿#include "StringTable.hpp"
+
+#include <atomic>
+#include <climits>
+#include <map>
+#include <utility>
+#include <vector>
+#define BOOST_DATE_TIME_NO_LIB
+#define BOOST_THREAD_NO_LIB
+#include <boost/thread/mutex.hpp>
+
+#include <balor/system/windows.hpp>
+#include <balor/test/verify.hpp>
+
+
+namespace balor {
+	namespace io {
+
+using std::atomic;
+using std::map;
+using std::move;
+using std::pair;
+using std::unique_ptr;
+using std::vector;
+using boost::mutex;
+using namespace balor::locale;
+
+
+namespace {
+const int stringsPerBlock = 16;
+const int blockCount = (USHRT_MAX + 1) / stringsPerBlock;
+
+
+/// デコードした一つのブロック。
+struct Block {
+	vector<wchar_t> buffer; // ヌル終端した文字列を並べたもの
+	int offsets[stringsPerBlock];
+	int lengths[stringsPerBlock];
+};
+
+
+const Block notFoundBlock = Block(); // ブロックが無かったことを覚えておく
+
+
+const Block* loadBlock(HMODULE module, const Locale& locale, int blockId) {
+	const wchar_t* const name = MAKEINTRESOURCEW(blockId + 1);
+	HRSRC resource = nullptr;
+	if (locale != Locale::invariant()) {
+		resource = FindResourceExW(module, reinterpret_cast<LPCWSTR>(RT_STRING), name, LANGIDFROMLCID(locale.id()));
+	}
+	if (!resource) {
+		resource = FindResourceW(module, name, reinterpret_cast<LPCWSTR>(RT_STRING));
+	}
+	if (!resource) {
+		return &notFoundBlock;
+	}
+	HGLOBAL const global = LoadResource(module, resource);
+	assert("Failed to LoadResource" && global);
+	const wchar_t* i = static_cast<const wchar_t*>(LockResource(global));
+	assert("Failed to LockResource" && i);
+	const wchar_t* const end = i + SizeofResource(module, resource) / sizeof(wchar_t);
+
+	// 各文字列は長さの WORD に続くヌル終端しない文字列
+	unique_ptr<Block> block(new Block());
+	block->buffer.reserve(end - i);
+	for (int index = 0; index < stringsPerBlock; ++index) {
+		int length = i < end ? *i++ : 0;
+		if (end - i < length) {
+			length = end - i;
+		}
+		block->offsets[index] = block->buffer.size();
+		block->lengths[index] = length;
+		block->buffer.insert(block->buffer.end(), i, i + length);
+		block->buffer.push_back(L'\0');
+		i += length;
+	}
+	return block.release();
+}
+
+
+mutex& getSharedMutex() {
+	static mutex sharedMutex; // これはスレッド同士で衝突さえしなければDLLごとに実体を持って良い。
+	return sharedMutex;
+}
+
+
+mutex& sharedMutex = getSharedMutex(); // マルチスレッドになるまえに初期化されることを保証する
+
+
+typedef map<pair<HMODULE, int>, unique_ptr<StringTable> > SharedTables;
+
+
+SharedTables& getSharedTables() {
+	static SharedTables sharedTables; // プロセスが終わるまで破棄しない
+	return sharedTables;
+}
+
+
+SharedTables& sharedTables = getSharedTables(); // マルチスレッドになるまえに初期化されることを保証する
+
+
+BOOL CALLBACK enumBlocksProc(HMODULE , LPCWSTR , LPWSTR name, LONG_PTR param) {
+	if (IS_INTRESOURCE(name)) {
+		const int id = (reinterpret_cast<ULONG_PTR>(name) - 1) * stringsPerBlock;
+		try {
+			reinterpret_cast<StringTable*>(param)->getString(id);
+		} catch (StringTable::NotFoundException& ) { // 空の文字列でもブロックはデコードしている
+		}
+	}
+	return TRUE;
+}
+} // namespace
+
+
+
+struct StringTable::Impl {
+	Impl() {
+		for (int i = 0; i < blockCount; ++i) {
+			blocks[i] = nullptr;
+		}
+	}
+	~Impl() {
+		for (int i = 0; i < blockCount; ++i) {
+			const Block* block = blocks[i];
+			if (block != &notFoundBlock) {
+				delete block;
+			}
+		}
+	}
+
+	atomic<const Block*> blocks[blockCount]; // 一度設定したら変更しないのでロックせずに読める
+};
+
+
+
+StringTable::StringTable(HMODULE module, const Locale& locale) : _module(module), _locale(locale), _impl(new Impl()) {
+	if (!_module) {
+		_module = GetModuleHandleW(nullptr);
+		assert(_module);
+	}
+}
+
+
+StringTable::~StringTable() {
+}
+
+
+String StringTable::getString(int id) {
+	assert("Invalid resource id" && 0 <= id && id <= USHRT_MAX);
+
+	atomic<const Block*>& entry = _impl->blocks[id / stringsPerBlock];
+	const Block* block = entry.load(std::memory_order_acquire);
+	if (!block) {
+		const Block* loaded = loadBlock(_module, _locale, id / stringsPerBlock);
+		if (entry.compare_exchange_strong(block, loaded, std::memory_order_acq_rel)) {
+			block = loaded;
+		} else if (loaded != &notFoundBlock) { // 他のスレッドが先にデコードした
+			delete loaded;
+		}
+	}
+	if (block == &notFoundBlock || !block->lengths[id % stringsPerBlock]) {
+		throw NotFoundException();
+	}
+	return String::refer(block->buffer.data() + block->offsets[id % stringsPerBlock], block->lengths[id % stringsPerBlock]);
+}
+
+
+StringTable::Locale StringTable::locale() const {
+	return _locale;
+}
+
+
+StringTable::HMODULE StringTable::module() const {
+	return _module;
+}
+
+
+void StringTable::preload() {
+	EnumResourceNamesW(_module, reinterpret_cast<LPCWSTR>(RT_STRING), enumBlocksProc, reinterpret_cast<LONG_PTR>(this));
+}
+
+
+StringTable& StringTable::shared(HMODULE module, const Locale& locale) {
+	if (!module) {
+		module = GetModuleHandleW(nullptr);
+		assert(module);
+	}
+	mutex::scoped_lock lock(sharedMutex);
+	unique_ptr<StringTable>& table = sharedTables[std::make_pair(module, locale.id())];
+	if (!table) {
+		table.reset(new StringTable(module, locale));
+	}
+	return *table;
+}
+
+
+
+	}
+}
@@ -0,0 +1,68 @@
+﻿#pragma once
+
+#include <memory>
+
+#include <balor/io/Resource.hpp>
+#include <balor/locale/Locale.hpp>
+#include <balor/NonCopyable.hpp>
+#include <balor/String.hpp>
+
+struct HINSTANCE__;
+
+
+namespace balor {
+	namespace io {
+
+
+
+/**
+ * STRINGTABLE リソースの文字列をブロックごとにデコードしてキャッシュする。
+ *
+ * STRINGTABLE リソースは ID を 16 個ずつのブロックにまとめて格納している。ブロック内の ID を初めて取得したときにブロック全体をヌル終端の文字列にデコードし、
+ * 以降の getString はデコードした文字列を String::refer で返すのでメモリを割り当てない。返した String はこの StringTable が破棄されるまで有効。
+ * shared 関数で取得する StringTable はプロセスが終わるまで破棄しないので、Resource::getString(int) はこれを使う。
+ * ロケールを指定した場合はその言語のブロックを探し、見つからなければ LoadString と同じ方法で言語を選んで探す。
+ * LoadString と同じく空の文字列は見つからなかったものとして扱う。
+ * 複数のスレッドから同時に使える。
+ *
+ * <h3>・サンプルコード</h3>
+ * <pre><code>
+	StringTable& table = StringTable::shared(nullptr, Locale(L"en-US"));
+	String title = table.getString(IDS_TITLE); // 二回目以降はメモリを割り当てない
+ * </code></pre>
+ */
+class StringTable : private NonCopyable {
+public:
+	typedef ::HINSTANCE__* HMODULE;
+	typedef ::balor::locale::Locale Locale;
+	typedef Resource::NotFoundException NotFoundException;
+
+public:
+	/// モジュールとロケールから作成。module が nullptr なら実行ファイルのモジュール。
+	explicit StringTable(HMODULE module = nullptr, const Locale& locale = Locale::invariant());
+	~StringTable();
+
+public:
+	/// id の文字列をデコードした文字列への参照として返す。見つからなければ NotFoundException を投げる。
+	String getString(int id);
+	/// ロケール。
+	Locale locale() const;
+	/// モジュール。
+	HMODULE module() const;
+	/// モジュールにある全てのブロックを先にデコードする。
+	void preload();
+	/// モジュールとロケールごとに共有する StringTable を返す。プロセスが終わるまで破棄しない。
+	static StringTable& shared(HMODULE module, const Locale& locale);
+
+private:
+	struct Impl;
+
+	HMODULE _module;
+	Locale _locale;
+	std::unique_ptr<Impl> _impl;
+};
+
+
+
+	}
+}
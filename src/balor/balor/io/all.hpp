@@ -10,13 +10,30 @@ namespace io {
 }
 }
 
+#include <balor/io/AsyncFile.hpp>
+#include <balor/io/BinaryReader.hpp>
+#include <balor/io/BinaryWriter.hpp>
+#include <balor/io/BufferedStream.hpp>
+#include <balor/io/CachedDirectory.hpp>
+#include <balor/io/CompressStream.hpp>
+#include <balor/io/DecompressStream.hpp>
+#include <balor/io/DirectoryWalker.hpp>
+#include <balor/io/DirectoryWatcher.hpp>
 #include <balor/io/Drive.hpp>
 #include <balor/io/File.hpp>
 #include <balor/io/FileStream.hpp>
+#include <balor/io/HashingStream.hpp>
+#include <balor/io/MappedFile.hpp>
 #include <balor/io/MemoryStream.hpp>
+#include <balor/io/PrefetchStream.hpp>
 #include <balor/io/Registry.hpp>
+#include <balor/io/RegistryBatch.hpp>
+#include <balor/io/RegistryFile.hpp>
+#include <balor/io/RegistrySnapshot.hpp>
 #include <balor/io/Resource.hpp>
+#include <balor/io/SegmentedMemoryStream.hpp>
 #include <balor/io/Stream.hpp>
+#include <balor/io/StringTable.hpp>
 //#include <balor/io/StreamToIStream.hpp> // Objbase.h をインクルードしている
 
 #include <balor/link.hpp>
@@ -50,7 +50,7 @@ const VS_FIXEDFILEINFO* getVersionInfo(const unsigned char* _buffer) {
 
 
 void makeAppPath(const FileVersionInfo& info, File& file, File::Special special, bool useProductVersion) {
-	StringBuffer _buffer(const_cast<wchar_t*>(file.path()), File::maxPath);
+	StringBuffer _buffer;
 	_buffer += String::refer(File::getSpecial(special));
 	const String companyName = info.companyName();
 	if (0 < companyName.length()) {
@@ -69,7 +69,7 @@ void makeAppPath(const FileVersionInfo& info, File& file, File::Special special,
 			_buffer += productVersion;
 		}
 	}
-	file.resetPathLength();
+	file.path(_buffer);
 	file.createDirectory();
 }
 
@@ -0,0 +1,107 @@
+﻿#include "InvokeQueue.hpp"
+
+#include <chrono>
+#include <utility>
+
+#include <balor/test/verify.hpp>
+#include <balor/scopeExit.hpp>
+
+
+namespace balor {
+	namespace system {
+
+using std::memory_order_acquire;
+using std::memory_order_acq_rel;
+using std::memory_order_relaxed;
+using std::memory_order_release;
+using std::move;
+namespace chrono = std::chrono;
+
+
+
+InvokeQueue::InvokeQueue() : _head(&_stub), _tail(&_stub), _signaled(false) {
+	_stub.next.store(nullptr, memory_order_relaxed);
+}
+
+
+InvokeQueue::~InvokeQueue() {
+	while (Node* node = pop()) {
+		delete node;
+	}
+}
+
+
+bool InvokeQueue::empty() const {
+	return _tail->next.load(memory_order_acquire) == nullptr && _head.load(memory_order_acquire) == _tail;
+}
+
+
+bool InvokeQueue::push(Function function) {
+	assert("Empty function" && function);
+
+	Node* node = new Node;
+	node->function = move(function);
+	push(node);
+	return !_signaled.exchange(true, memory_order_acq_rel); // 既に誰かが起こしていれば起こさない
+}
+
+
+bool InvokeQueue::run(int timeBudget) {
+	_signaled.store(false); // これ以降に push されたら実行スレッドはもう一度起こされる
+
+	const auto deadline = chrono::steady_clock::now() + chrono::milliseconds(timeBudget);
+	for (int count = 1; ; ++count) {
+		Node* node = pop();
+		if (!node) {
+			return false;
+		}
+		scopeExit([&] () {
+			delete node;
+		});
+		node->function();
+		if (0 <= timeBudget && (count & 0x0f) == 0 && deadline <= chrono::steady_clock::now()) { // 時刻の取得も安くはないので何個かおきに調べる
+			break;
+		}
+	}
+	return !empty() && !_signaled.exchange(true, memory_order_acq_rel);
+}
+
+
+void InvokeQueue::push(Node* node) {
+	node->next.store(nullptr, memory_order_relaxed);
+	Node* previous = _head.exchange(node, memory_order_acq_rel);
+	previous->next.store(node, memory_order_release); // この間 pop からは node が見えないが、push の戻り値で実行スレッドが起こされるのはこの後になる
+}
+
+
+InvokeQueue::Node* InvokeQueue::pop() {
+	Node* tail = _tail;
+	Node* next = tail->next.load(memory_order_acquire);
+	if (tail == &_stub) {
+		if (!next) {
+			return nullptr;
+		}
+		_tail = next;
+		tail = next;
+		next = next->next.load(memory_order_acquire);
+	}
+	if (next) {
+		_tail = next;
+		return tail;
+	}
+	if (tail != _head.load(memory_order_acquire)) { // 他のスレッドが push の途中
+		return nullptr;
+	}
+	push(&_stub);
+	next = tail->next.load(memory_order_acquire);
+	if (next) {
+		_tail = next;
+		return tail;
+	}
+	return nullptr;
+}
+
+
+
+	}
+}
@@ -0,0 +1,72 @@
+﻿#pragma once
+
+#include <atomic>
+#include <functional>
+
+#include <balor/NonCopyable.hpp>
+
+
+namespace balor {
+	namespace system {
+
+
+
+/**
+ * 複数のスレッドから関数を追加し、一つのスレッドでまとめて実行するロックフリーのキュー（MPSC）。
+ *
+ * push 関数はキューが空の状態から最初に追加した時だけ true を返すので、その時だけ実行するスレッドを起こせば良い。
+ * 実行するスレッドは run 関数でキューが空になるか指定時間が経過するまで関数を実行する。
+ * run 関数が true を返した場合は実行しきれなかった関数が残っているので、再び自分を起こす必要がある。
+ * Windows API に依存しないので、メッセージループ以外の実行スレッドにも使える。
+ *
+ * <h3>・サンプルコード</h3>
+ * <pre><code>
+	InvokeQueue queue;
+	if (queue.push([&] () { ++count; })) {
+		wakeUp(); // 実行スレッドを起こす
+	}
+
+	// 実行スレッド
+	while (queue.run(10)) { // 10 ミリ秒ごとに他の処理に制御を戻す
+		doOtherWork();
+	}
+ * </code></pre>
+ */
+class InvokeQueue : private NonCopyable {
+public:
+	typedef std::function<void ()> Function;
+
+public:
+	InvokeQueue();
+	/// 実行されずに残った関数は破棄する。
+	~InvokeQueue();
+
+public:
+	/// 実行待ちの関数が無いかどうか。実行スレッドからのみ正確な値が得られる。
+	bool empty() const;
+	/// 関数を追加する。どのスレッドから呼んでも良い。実行スレッドを起こす必要がある場合は true を返す。
+	bool push(Function function);
+	/// キューが空になるか timeBudget ミリ秒経過するまで関数を実行する。timeBudget が負の場合は時間制限しない。
+	/// 実行しきれずに関数が残っていて、実行スレッドを起こす必要がある場合は true を返す。同時に複数のスレッドから呼んではならない。
+	/// 関数が例外を投げた場合はそのまま伝播するので、残りの関数を実行するには再び run を呼ぶこと。
+	bool run(int timeBudget = -1);
+
+private:
+	struct Node {
+		std::atomic<Node*> next;
+		Function function;
+	};
+
+	void push(Node* node);
+	Node* pop();
+
+	std::atomic<Node*> _head;
+	Node* _tail;
+	Node _stub;
+	std::atomic<bool> _signaled;
+};
+
+
+
+	}
+}
@@ -0,0 +1,756 @@
+﻿#include "Metrics.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <climits>
+#include <cmath>
+#include <cstdint>
+#include <ctime>
+#include <exception>
+#include <map>
+#include <new>
+#include <string>
+#include <utility>
+#define BOOST_DATE_TIME_NO_LIB
+#define BOOST_THREAD_NO_LIB
+#include <boost/thread.hpp>
+
+#include <balor/io/Stream.hpp>
+#include <balor/locale/Charset.hpp>
+#include <balor/system/windows.hpp>
+#include <balor/test/verify.hpp>
+#include <balor/Singleton.hpp>
+#include <balor/String.hpp>
+
+#include <intrin.h>
+#include <psapi.h>
+#pragma comment(lib, "psapi.lib")
+
+
+namespace balor {
+	namespace system {
+
+using std::atomic;
+using std::exception_ptr;
+using std::map;
+using std::string;
+using std::unique_ptr;
+using boost::condition_variable;
+using boost::mutex;
+using boost::thread;
+
+
+namespace {
+const int shardCount = 16;
+const int cacheLineSize = 64;
+const int subBucketBits = 4; // ２の累乗ごとの区間を 16 等分する
+const int subBucketCount = 1 << subBucketBits;
+const int bucketCount = (63 - subBucketBits + 1) * subBucketCount; // 0 以上の __int64 の最上位ビットは 62 まで
+
+
+__declspec(thread) int currentShard = -1; // 現在のスレッドが記録するシャード
+
+
+atomic<int>& getNextShard() {
+	static atomic<int> nextShard(0);
+	return nextShard;
+}
+
+
+atomic<int>& nextShard = getNextShard(); // マルチスレッドになるまえに初期化されることを保証する
+
+
+/// 現在のスレッドのシャード。スレッドが最初に記録した時に順番に割り振る。
+inline int shardIndex() {
+	int index = currentShard;
+	if (index < 0) {
+		index = nextShard.fetch_add(1, std::memory_order_relaxed) % shardCount;
+		currentShard = index;
+	}
+	return index;
+}
+
+
+inline int highestBit(unsigned __int64 value) {
+	unsigned long index = 0;
+#if defined(_WIN64)
+	_BitScanReverse64(&index, value);
+#else
+	if (value >> 32) {
+		_BitScanReverse(&index, static_cast<unsigned long>(value >> 32));
+		return static_cast<int>(index) + 32;
+	}
+	_BitScanReverse(&index, static_cast<unsigned long>(value));
+#endif
+	return static_cast<int>(index);
+}
+
+
+/// 値が入るバケット。subBucketCount 未満の値はそのまま、それ以上は最上位ビットの区間と続く subBucketBits ビットで決まる。
+inline int bucketIndex(__int64 value) {
+	if (value < subBucketCount) {
+		return static_cast<int>(value);
+	}
+	const int shift = highestBit(static_cast<unsigned __int64>(value)) - subBucketBits;
+	return (shift + 1) * subBucketCount + static_cast<int>(value >> shift) - subBucketCount;
+}
+
+
+/// バケットに入る値の最大値。
+inline __int64 bucketUpperBound(int index) {
+	if (index < subBucketCount) {
+		return index;
+	}
+	const int shift = index / subBucketCount - 1;
+	const __int64 lower = static_cast<__int64>(subBucketCount + index % subBucketCount) << shift;
+	return lower + ((static_cast<__int64>(1) << shift) - 1);
+}
+
+
+struct Metric {
+	struct Kind {
+		enum _enum {
+			counter   = 0,
+			gauge     = 1,
+			histogram = 2,
+		};
+	};
+
+	Metric(Kind::_enum kind, StringRange name) : kind(kind), name(name.c_str(), name.length()) {}
+	virtual ~Metric() {}
+
+	const Kind::_enum kind;
+	const String name;
+};
+
+
+/// シャードごとの記録。スレッドが shardCount より多ければ同じシャードを共有するので atomic 変数で更新する。
+struct HistogramShard {
+	HistogramShard() : sum(0), min(LLONG_MAX), max(0) {
+		for (int i = 0; i < bucketCount; ++i) {
+			buckets[i].store(0, std::memory_order_relaxed);
+		}
+	}
+
+	atomic<__int64> sum; // 記録した数はバケットの合計なので持たない
+	atomic<__int64> min;
+	atomic<__int64> max;
+	atomic<__int64> buckets[bucketCount];
+};
+
+
+class GlobalMetrics {
+	friend Singleton<GlobalMetrics>;
+
+	GlobalMetrics() {}
+	~GlobalMetrics() {}
+
+public:
+	Metrics metrics;
+};
+
+
+string toUtf8(const String& value) {
+	return locale::Charset::utf8().encode(value);
+}
+
+
+/// 現在時刻を ISO 8601 形式の UTC で。
+string currentTime() {
+	const auto now = std::chrono::system_clock::now();
+	const std::time_t seconds = std::chrono::system_clock::to_time_t(now);
+	const int milliseconds = static_cast<int>(std::chrono::duration_cast<std::chrono::milliseconds>(now.time_since_epoch()).count() % 1000);
+	std::tm utc;
+	verify(!gmtime_s(&utc, &seconds));
+	char buffer[64];
+	const int length = sprintf_s(buffer, sizeof(buffer), "%04d-%02d-%02dT%02d:%02d:%02d.%03dZ"
+		, utc.tm_year + 1900, utc.tm_mon + 1, utc.tm_mday, utc.tm_hour, utc.tm_min, utc.tm_sec, milliseconds);
+	return string(buffer, length);
+}
+
+
+void appendNumber(string& text, __int64 value) {
+	char buffer[32];
+	const int length = sprintf_s(buffer, sizeof(buffer), "%lld", static_cast<long long>(value));
+	text.append(buffer, length);
+}
+
+
+void appendNumber(string& text, double value) {
+	char buffer[64];
+	const int length = sprintf_s(buffer, sizeof(buffer), "%.3f", value);
+	text.append(buffer, length);
+}
+
+
+/// 区切り文字、引用符、改行を含む CSV の値を引用符で囲む。
+void appendCsvString(string& text, const string& value) {
+	if (value.find_first_of(",\"\r\n") == string::npos) {
+		text += value;
+		return;
+	}
+	text += '"';
+	for (auto i = value.begin(), end = value.end(); i != end; ++i) {
+		if (*i == '"') {
+			text += '"';
+		}
+		text += *i;
+	}
+	text += '"';
+}
+
+
+void appendJsonString(string& text, const string& value) {
+	text += '"';
+	for (auto i = value.begin(), end = value.end(); i != end; ++i) {
+		const unsigned char c = static_cast<unsigned char>(*i);
+		switch (c) {
+			case '"'  : text += "\\\""; break;
+			case '\\' : text += "\\\\"; break;
+			case '\n' : text += "\\n"; break;
+			case '\r' : text += "\\r"; break;
+			case '\t' : text += "\\t"; break;
+			default : {
+				if (c < 0x20) {
+					char buffer[8];
+					const int length = sprintf_s(buffer, sizeof(buffer), "\\u%04x", c);
+					text.append(buffer, length);
+				} else {
+					text += *i;
+				}
+			}
+		}
+	}
+	text += '"';
+}
+
+
+const char* kindName(Metric::Kind::_enum kind) {
+	switch (kind) {
+		case Metric::Kind::counter : return "counter";
+		case Metric::Kind::gauge   : return "gauge";
+		default                    : return "histogram";
+	}
+}
+
+
+const int percentileCount = 4;
+const double percentiles[percentileCount] = {50, 90, 99, 99.9};
+const char* const percentileNames[percentileCount] = {"p50", "p90", "p99", "p999"};
+
+
+} // namespace
+
+
+
+struct Metrics::Counter::Data : public Metric {
+	explicit Data(StringRange name) : Metric(Kind::counter, name) {
+		// 各シャードを別々のキャッシュラインに置く
+		const auto address = reinterpret_cast<std::uintptr_t>(storage);
+		cells = reinterpret_cast<char*>((address + cacheLineSize - 1) & ~static_cast<std::uintptr_t>(cacheLineSize - 1));
+		for (int i = 0; i < shardCount; ++i) {
+			new (cells + i * cacheLineSize) atomic<__int64>(0);
+		}
+	}
+
+	atomic<__int64>& cell(int index) {
+		return *reinterpret_cast<atomic<__int64>*>(cells + index * cacheLineSize);
+	}
+
+	char storage[cacheLineSize * (shardCount + 1)];
+	char* cells;
+};
+
+
+struct Metrics::Gauge::Data : public Metric {
+	explicit Data(StringRange name) : Metric(Kind::gauge, name), value(0) {}
+
+	atomic<__int64> value;
+};
+
+
+struct Metrics::Histogram::Data : public Metric {
+	explicit Data(StringRange name) : Metric(Kind::histogram, name) {
+		for (int i = 0; i < shardCount; ++i) {
+			shards[i].store(nullptr, std::memory_order_relaxed);
+		}
+	}
+	~Data() {
+		for (int i = 0; i < shardCount; ++i) {
+			delete shards[i].load(std::memory_order_relaxed);
+		}
+	}
+
+	HistogramShard& shard(int index) {
+		HistogramShard* result = shards[index].load(std::memory_order_acquire);
+		if (!result) {
+			unique_ptr<HistogramShard> created(new HistogramShard());
+			if (shards[index].compare_exchange_strong(result, created.get(), std::memory_order_acq_rel)) {
+				result = created.release();
+			} // 失敗すれば result に他のスレッドが作成したシャードが入る
+		}
+		return *result;
+	}
+
+	atomic<HistogramShard*> shards[shardCount];
+};
+
+
+struct Metrics::Impl {
+	Impl() : reporting(false), stopRequested(false) {}
+
+	template<typename T>
+	T* find(StringRange name, Metric::Kind::_enum kind) {
+		assert("Empty name" && !name.empty());
+
+		mutex::scoped_lock lock(guard);
+		unique_ptr<Metric>& metric = metrics[String(name.c_str(), name.length())];
+		if (!metric) {
+			metric.reset(new T(name));
+		} else if (metric->kind != kind) {
+			throw NameConflictException();
+		}
+		return static_cast<T*>(metric.get());
+	}
+
+	void report(io::Stream& stream, Format format, bool collectProcess) {
+		for (bool header = true; ; header = false) {
+			bool stopping = false;
+			{
+				mutex::scoped_lock lock(reportGuard);
+				reportCondition.timed_wait(lock, boost::posix_time::milliseconds(interval), [&] () {
+					return stopRequested;
+				});
+				stopping = stopRequested;
+			}
+			write(stream, format, collectProcess, header); // 止める時も最後に書き出す
+			if (stopping) {
+				return;
+			}
+		}
+	}
+
+	void write(io::Stream& stream, Format format, bool collectProcess, bool header) {
+		try {
+			if (collectProcess) {
+				owner->collectProcess();
+			}
+			if (format == Format::csv) {
+				owner->writeCsv(stream, header);
+			} else {
+				owner->writeJson(stream);
+			}
+		} catch (...) {
+			mutex::scoped_lock lock(reportGuard);
+			if (!reportException) {
+				reportException = std::current_exception();
+			}
+		}
+	}
+
+	Metrics* owner;
+	mutable mutex guard;
+	map<String, unique_ptr<Metric> > metrics;
+
+	mutex reportGuard;
+	condition_variable reportCondition;
+	thread reportThread;
+	bool reporting;
+	bool stopRequested;
+	int interval;
+	exception_ptr reportException;
+};
+
+
+
+HistogramSnapshot::HistogramSnapshot() : _count(0), _sum(0), _min(0), _max(0) {
+}
+
+
+__int64 HistogramSnapshot::count() const {
+	return _count;
+}
+
+
+__int64 HistogramSnapshot::max() const {
+	return _max;
+}
+
+
+double HistogramSnapshot::mean() const {
+	return _count ? static_cast<double>(_sum) / _count : 0;
+}
+
+
+__int64 HistogramSnapshot::min() const {
+	return _min;
+}
+
+
+__int64 HistogramSnapshot::percentile(double percent) const {
+	assert("percent out of range" && 0 <= percent);
+	assert("percent out of range" && percent <= 100);
+
+	if (!_count) {
+		return 0;
+	}
+	const __int64 rank = std::max(static_cast<__int64>(1), static_cast<__int64>(std::ceil(percent / 100 * _count)));
+	__int64 total = 0;
+	for (int i = 0, end = static_cast<int>(_buckets.size()); i < end; ++i) {
+		total += _buckets[i];
+		if (rank <= total) {
+			return std::max(_min, std::min(bucketUpperBound(i), _max));
+		}
+	}
+	assert(false);
+	return _max;
+}
+
+
+__int64 HistogramSnapshot::sum() const {
+	return _sum;
+}
+
+
+
+Metrics::Counter::Counter() : _data(nullptr) {
+}
+
+
+Metrics::Counter::Counter(Data* data) : _data(data) {
+}
+
+
+void Metrics::Counter::add(__int64 value) {
+	assert("Null Counter" && _data);
+	_data->cell(shardIndex()).fetch_add(value, std::memory_order_relaxed);
+}
+
+
+const wchar_t* Metrics::Counter::name() const {
+	assert("Null Counter" && _data);
+	return _data->name.c_str();
+}
+
+
+__int64 Metrics::Counter::value() const {
+	assert("Null Counter" && _data);
+	__int64 result = 0;
+	for (int i = 0; i < shardCount; ++i) {
+		result += _data->cell(i).load(std::memory_order_relaxed);
+	}
+	return result;
+}
+
+
+Metrics::Counter::operator bool() const {
+	return _data != nullptr;
+}
+
+
+
+Metrics::Gauge::Gauge() : _data(nullptr) {
+}
+
+
+Metrics::Gauge::Gauge(Data* data) : _data(data) {
+}
+
+
+void Metrics::Gauge::add(__int64 value) {
+	assert("Null Gauge" && _data);
+	_data->value.fetch_add(value, std::memory_order_relaxed);
+}
+
+
+const wchar_t* Metrics::Gauge::name() const {
+	assert("Null Gauge" && _data);
+	return _data->name.c_str();
+}
+
+
+__int64 Metrics::Gauge::value() const {
+	assert("Null Gauge" && _data);
+	return _data->value.load(std::memory_order_relaxed);
+}
+
+
+void Metrics::Gauge::value(__int64 value) {
+	assert("Null Gauge" && _data);
+	_data->value.store(value, std::memory_order_relaxed);
+}
+
+
+Metrics::Gauge::operator bool() const {
+	return _data != nullptr;
+}
+
+
+
+Metrics::Histogram::Histogram() : _data(nullptr) {
+}
+
+
+Metrics::Histogram::Histogram(Data* data) : _data(data) {
+}
+
+
+const wchar_t* Metrics::Histogram::name() const {
+	assert("Null Histogram" && _data);
+	return _data->name.c_str();
+}
+
+
+void Metrics::Histogram::record(__int64 value) {
+	assert("Null Histogram" && _data);
+	assert("Negative value" && 0 <= value);
+
+	HistogramShard& shard = _data->shard(shardIndex());
+	shard.buckets[bucketIndex(value)].fetch_add(1, std::memory_order_relaxed);
+	shard.sum.fetch_add(value, std::memory_order_relaxed);
+	__int64 current = shard.min.load(std::memory_order_relaxed);
+	while (value < current && !shard.min.compare_exchange_weak(current, value, std::memory_order_relaxed)) {
+	}
+	current = shard.max.load(std::memory_order_relaxed);
+	while (current < value && !shard.max.compare_exchange_weak(current, value, std::memory_order_relaxed)) {
+	}
+}
+
+
+HistogramSnapshot Metrics::Histogram::snapshot() const {
+	assert("Null Histogram" && _data);
+
+	HistogramSnapshot result;
+	result._buckets.resize(bucketCount, 0);
+	__int64 min = LLONG_MAX;
+	for (int i = 0; i < shardCount; ++i) {
+		const HistogramShard* shard = _data->shards[i].load(std::memory_order_acquire);
+		if (!shard) {
+			continue;
+		}
+		for (int j = 0; j < bucketCount; ++j) {
+			const __int64 count = shard->buckets[j].load(std::memory_order_relaxed);
+			result._buckets[j] += count;
+			result._count += count;
+		}
+		result._sum += shard->sum.load(std::memory_order_relaxed);
+		min = std::min(min, shard->min.load(std::memory_order_relaxed));
+		result._max = std::max(result._max, shard->max.load(std::memory_order_relaxed));
+	}
+	result._min = result._count ? min : 0;
+	return result;
+}
+
+
+Metrics::Histogram::operator bool() const {
+	return _data != nullptr;
+}
+
+
+
+bool Metrics::Format::_validate(Format value) {
+	return csv <= value && value <= json;
+}
+
+
+
+Metrics::Metrics() : _impl(new Impl()) {
+	_impl->owner = this;
+}
+
+
+Metrics::~Metrics() {
+	try {
+		stopReport();
+	} catch (...) {
+	}
+}
+
+
+void Metrics::collectProcess() {
+	const HANDLE process = GetCurrentProcess();
+	FILETIME creationTime;
+	FILETIME exitTime;
+	FILETIME kernelTime;
+	FILETIME userTime;
+	if (GetProcessTimes(process, &creationTime, &exitTime, &kernelTime, &userTime)) {
+		// FILETIME は 100 ナノ秒単位
+		gauge(L"process.userTime").value(((static_cast<__int64>(userTime.dwHighDateTime) << 32) | userTime.dwLowDateTime) / 10000);
+		gauge(L"process.kernelTime").value(((static_cast<__int64>(kernelTime.dwHighDateTime) << 32) | kernelTime.dwLowDateTime) / 10000);
+	}
+	PROCESS_MEMORY_COUNTERS memory;
+	if (GetProcessMemoryInfo(process, &memory, sizeof(memory))) {
+		gauge(L"process.workingSet").value(memory.WorkingSetSize);
+	}
+	IO_COUNTERS io;
+	if (GetProcessIoCounters(process, &io)) {
+		gauge(L"process.readBytes").value(io.ReadTransferCount);
+		gauge(L"process.writeBytes").value(io.WriteTransferCount);
+		gauge(L"process.readCount").value(io.ReadOperationCount);
+		gauge(L"process.writeCount").value(io.WriteOperationCount);
+	}
+}
+
+
+Metrics::Counter Metrics::counter(StringRange name) {
+	return Counter(_impl->find<Counter::Data>(name, Metric::Kind::counter));
+}
+
+
+Metrics::Gauge Metrics::gauge(StringRange name) {
+	return Gauge(_impl->find<Gauge::Data>(name, Metric::Kind::gauge));
+}
+
+
+Metrics& Metrics::global() {
+	return Singleton<GlobalMetrics>::get().metrics;
+}
+
+
+Metrics::Histogram Metrics::histogram(StringRange name) {
+	return Histogram(_impl->find<Histogram::Data>(name, Metric::Kind::histogram));
+}
+
+
+void Metrics::startReport(io::Stream& stream, Metrics::Format format, int interval, bool collectProcess) {
+	assert("Invalid Metrics::Format" && Format::_validate(format));
+	assert("Invalid interval" && 0 < interval);
+	assert("Already reporting" && !_impl->reporting);
+
+	_impl->stopRequested = false;
+	_impl->interval = interval;
+	_impl->reportException = exception_ptr();
+	io::Stream* const target = &stream;
+	Impl* const impl = _impl.get();
+	_impl->reportThread = thread([impl, target, format, collectProcess] () {
+		impl->report(*target, format, collectProcess);
+	});
+	_impl->reporting = true;
+}
+
+
+void Metrics::stopReport() {
+	if (!_impl->reporting) {
+		return;
+	}
+	{
+		mutex::scoped_lock lock(_impl->reportGuard);
+		_impl->stopRequested = true;
+		_impl->reportCondition.notify_all();
+	}
+	_impl->reportThread.join();
+	_impl->reporting = false;
+
+	exception_ptr exception = _impl->reportException;
+	_impl->reportException = exception_ptr();
+	if (exception) {
+		std::rethrow_exception(exception);
+	}
+}
+
+
+void Metrics::writeCsv(io::Stream& stream, bool header) const {
+	string text;
+	if (header) {
+		text += "time,name,kind,value,count,min,max,mean";
+		for (int i = 0; i < percentileCount; ++i) {
+			text += ',';
+			text += percentileNames[i];
+		}
+		text += "\r\n";
+	}
+	const string time = currentTime();
+	{
+		mutex::scoped_lock lock(_impl->guard);
+		for (auto i = _impl->metrics.begin(), end = _impl->metrics.end(); i != end; ++i) {
+			Metric* const metric = i->second.get();
+			text += time;
+			text += ',';
+			appendCsvString(text, toUtf8(metric->name));
+			text += ',';
+			text += kindName(metric->kind);
+			text += ',';
+			switch (metric->kind) {
+				case Metric::Kind::counter : {
+					appendNumber(text, Counter(static_cast<Counter::Data*>(metric)).value());
+					text += ",,,,,,,,";
+				} break;
+				case Metric::Kind::gauge : {
+					appendNumber(text, Gauge(static_cast<Gauge::Data*>(metric)).value());
+					text += ",,,,,,,,";
+				} break;
+				case Metric::Kind::histogram : {
+					const HistogramSnapshot snapshot = Histogram(static_cast<Histogram::Data*>(metric)).snapshot();
+					text += ',';
+					appendNumber(text, snapshot.count());
+					text += ',';
+					appendNumber(text, snapshot.min());
+					text += ',';
+					appendNumber(text, snapshot.max());
+					text += ',';
+					appendNumber(text, snapshot.mean());
+					for (int j = 0; j < percentileCount; ++j) {
+						text += ',';
+						appendNumber(text, snapshot.percentile(percentiles[j]));
+					}
+				} break;
+			}
+			text += "\r\n";
+		}
+	}
+	stream.write(text.data(), 0, static_cast<int>(text.length()));
+}
+
+
+void Metrics::writeJson(io::Stream& stream) const {
+	string text;
+	const string time = currentTime();
+	{
+		mutex::scoped_lock lock(_impl->guard);
+		for (auto i = _impl->metrics.begin(), end = _impl->metrics.end(); i != end; ++i) {
+			Metric* const metric = i->second.get();
+			text += "{\"time\":\"";
+			text += time;
+			text += "\",\"name\":";
+			appendJsonString(text, toUtf8(metric->name));
+			text += ",\"kind\":\"";
+			text += kindName(metric->kind);
+			text += '"';
+			switch (metric->kind) {
+				case Metric::Kind::counter : {
+					text += ",\"value\":";
+					appendNumber(text, Counter(static_cast<Counter::Data*>(metric)).value());
+				} break;
+				case Metric::Kind::gauge : {
+					text += ",\"value\":";
+					appendNumber(text, Gauge(static_cast<Gauge::Data*>(metric)).value());
+				} break;
+				case Metric::Kind::histogram : {
+					const HistogramSnapshot snapshot = Histogram(static_cast<Histogram::Data*>(metric)).snapshot();
+					text += ",\"count\":";
+					appendNumber(text, snapshot.count());
+					text += ",\"min\":";
+					appendNumber(text, snapshot.min());
+					text += ",\"max\":";
+					appendNumber(text, snapshot.max());
+					text += ",\"mean\":";
+					appendNumber(text, snapshot.mean());
+					for (int j = 0; j < percentileCount; ++j) {
+						text += ",\"";
+						text += percentileNames[j];
+						text += "\":";
+						appendNumber(text, snapshot.percentile(percentiles[j]));
+					}
+				} break;
+			}
+			text += "}\r\n";
+		}
+	}
+	stream.write(text.data(), 0, static_cast<int>(text.length()));
+}
+
+
+
+	}
+}
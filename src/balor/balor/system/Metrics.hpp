@@ -0,0 +1,229 @@
+﻿#pragma once
+
+#include <memory>
+#include <vector>
+
+#include <balor/Enum.hpp>
+#include <balor/Exception.hpp>
+#include <balor/NonCopyable.hpp>
+#include <balor/StringRange.hpp>
+
+namespace balor {
+	namespace io {
+		class Stream;
+	}
+}
+
+
+namespace balor {
+	namespace system {
+
+
+
+class HistogramSnapshot;
+
+
+
+/**
+ * プログラム自身を計測する名前付きのカウンター、ゲージ、ヒストグラムを管理する。
+ *
+ * PerformanceCounter が OS のカウンターを読むのに対して、こちらはアプリケーションのコードから値を記録する。
+ * counter, gauge, histogram 関数は名前で検索してハンドルを返す。同じ名前なら同じメトリクスを指すので、ハンドルは関数の外に保持しておき記録の度に検索しないこと。
+ * カウンターとヒストグラムの値はスレッドごとに割り振ったシャードに分けて atomic 変数に加えるので、多数のスレッドから同時に記録してもキャッシュラインを奪い合わない。
+ * 記録はロックもメモリ割り当ても行わず数ナノ秒で終わる。値を読む時に全てのシャードを合計する。
+ * ヒストグラムは HDR ヒストグラムと同じく２の累乗ごとの区間を 16 等分したバケットで、0 から __int64 の最大値までを固定のメモリで記録する。
+ * writeCsv, writeJson 関数は全てのメトリクスを集計して UTF-8 で書き出す。startReport 関数は別のスレッドで一定時間ごとに集計して書き出す。
+ * collectProcess 関数は GetProcessTimes, GetProcessMemoryInfo, GetProcessIoCounters で読んだプロセスの CPU 時間、ワーキングセット、I/O を "process." で始まるゲージに設定する。
+ * 一度作成したメトリクスは Metrics を破棄するまで削除されない。
+ *
+ * <h3>・サンプルコード</h3>
+ * <pre><code>
+	Metrics& metrics = Metrics::global();
+	Metrics::Counter requests = metrics.counter(L"server.requests");
+	Metrics::Histogram latency = metrics.histogram(L"server.latency");
+
+	FileStream file(L"metrics.csv", FileStream::Mode::create, FileStream::Access::write);
+	metrics.startReport(file, Metrics::Format::csv, 10000); // 10 秒ごとに書き出す
+	...
+	requests.add(); // どのスレッドから呼んでも良い
+	latency.record(elapsedMicroseconds);
+	...
+	metrics.stopReport();
+ * </code></pre>
+ */
+class Metrics : private NonCopyable {
+public:
+	/// 書き出す形式。
+	struct Format {
+		enum _enum {
+			csv  = 0, /// 一行目がヘッダで、一行に一つのメトリクスを書き出す CSV。
+			json = 1, /// 一行に一つのメトリクスを書き出す JSON オブジェクト。
+		};
+		BALOR_NAMED_ENUM_MEMBERS(Format);
+	};
+
+	/// 同じ名前で種類の違うメトリクスが既に作成されている。
+	class NameConflictException : public Exception {};
+
+
+	/// 単調に増えるカウンター。値はスレッドごとのシャードに分けて加える。
+	class Counter {
+	public:
+		/// どのメトリクスも指さないハンドルを作成。
+		Counter();
+
+	public:
+		/// 値を加える。どのスレッドから呼んでも良い。
+		void add(__int64 value = 1);
+		/// メトリクスの名前。
+		const wchar_t* name() const;
+		/// 全てのシャードの合計。
+		__int64 value() const;
+
+	public:
+		/// メトリクスを指していれば true。
+		operator bool() const;
+
+	private:
+		friend Metrics;
+		struct Data;
+
+		explicit Counter(Data* data);
+
+		Data* _data;
+	};
+
+
+	/// 最後に設定した値を保持するゲージ。
+	/// 現在値は一つしか無いのでシャードに分けない。頻繁に変わる値はカウンターかヒストグラムを使うこと。
+	class Gauge {
+	public:
+		/// どのメトリクスも指さないハンドルを作成。
+		Gauge();
+
+	public:
+		/// 値を加える。どのスレッドから呼んでも良い。
+		void add(__int64 value);
+		/// メトリクスの名前。
+		const wchar_t* name() const;
+		/// 現在の値。
+		__int64 value() const;
+		void value(__int64 value);
+
+	public:
+		/// メトリクスを指していれば true。
+		operator bool() const;
+
+	private:
+		friend Metrics;
+		struct Data;
+
+		explicit Gauge(Data* data);
+
+		Data* _data;
+	};
+
+
+	/// 値の分布を記録するヒストグラム。値はスレッドごとのシャードに分けて記録する。シャードは最初に記録した時に作成する。
+	class Histogram {
+	public:
+		/// どのメトリクスも指さないハンドルを作成。
+		Histogram();
+
+	public:
+		/// メトリクスの名前。
+		const wchar_t* name() const;
+		/// 0 以上の値を記録する。どのスレッドから呼んでも良い。
+		void record(__int64 value);
+		/// 全てのシャードを集計する。記録中に集計した場合は sum, min, max が count に含まれない記録の値を含むことがある。
+		HistogramSnapshot snapshot() const;
+
+	public:
+		/// メトリクスを指していれば true。
+		operator bool() const;
+
+	private:
+		friend Metrics;
+		struct Data;
+
+		explicit Histogram(Data* data);
+
+		Data* _data;
+	};
+
+public:
+	/// メトリクスの無い状態で作成。
+	Metrics();
+	/// startReport 関数で書き出していれば stopReport 関数を呼ぶ。例外は無視する。
+	~Metrics();
+
+public:
+	/// プロセスの CPU 時間（ミリ秒）、ワーキングセット（バイト）、読み書きしたバイト数と回数をゲージに設定する。
+	/// ゲージの名前は process.userTime, process.kernelTime, process.workingSet, process.readBytes, process.writeBytes, process.readCount, process.writeCount。
+	/// 読めなかった値は設定しない。
+	void collectProcess();
+	/// 名前のカウンター。無ければ作成する。
+	Metrics::Counter counter(StringRange name);
+	/// 名前のゲージ。無ければ作成する。
+	Metrics::Gauge gauge(StringRange name);
+	/// ライブラリ全体で共有するメトリクス。
+	static Metrics& global();
+	/// 名前のヒストグラム。無ければ作成する。
+	Metrics::Histogram histogram(StringRange name);
+	/// 別のスレッドで interval ミリ秒ごとに全てのメトリクスを集計して stream に書き出す。
+	/// collectProcess が true なら書き出す前に collectProcess 関数を呼ぶ。stream は stopReport 関数を呼ぶまで破棄してはならない。
+	void startReport(io::Stream& stream, Metrics::Format format, int interval, bool collectProcess = true);
+	/// 最後にもう一度書き出してからスレッドを止める。書き出しで例外が発生していれば投げ直す。
+	void stopReport();
+	/// 全てのメトリクスを名前順に集計して CSV 形式で書き出す。
+	/// 列は time,name,kind,value,count,min,max,mean,p50,p90,p99,p999 で、カウンターとゲージは value、ヒストグラムは count 以降の列を書く。
+	void writeCsv(io::Stream& stream, bool header = true) const;
+	/// 全てのメトリクスを名前順に集計して一行に一つずつ JSON オブジェクトで書き出す。
+	void writeJson(io::Stream& stream) const;
+
+private:
+	struct Impl;
+
+	std::unique_ptr<Impl> _impl;
+};
+
+
+
+/**
+ * Metrics::Histogram を集計した値。
+ *
+ * 値は記録した値が入るバケットの上限で返すので、１以上の値の相対誤差は 1/16 以下になる。count, sum, min, max は正確な値。
+ */
+class HistogramSnapshot {
+public:
+	/// 何も記録していない集計値を作成。
+	HistogramSnapshot();
+
+public:
+	/// 記録した値の数。
+	__int64 count() const;
+	/// 記録した値の最大値。記録が無ければ 0。
+	__int64 max() const;
+	/// 記録した値の平均値。記録が無ければ 0。
+	double mean() const;
+	/// 記録した値の最小値。記録が無ければ 0。
+	__int64 min() const;
+	/// percent（0 ～ 100）パーセンタイルの値。記録が無ければ 0。
+	__int64 percentile(double percent) const;
+	/// 記録した値の合計。
+	__int64 sum() const;
+
+private:
+	friend Metrics::Histogram;
+
+	std::vector<__int64> _buckets;
+	__int64 _count;
+	__int64 _sum;
+	__int64 _min;
+	__int64 _max;
+};
+
+
+
+	}
+}
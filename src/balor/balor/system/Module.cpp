@@ -1,6 +1,7 @@
 ﻿#include "Module.hpp"
 
 #include <utility>
+#include <vector>
 
 #include <balor/io/File.hpp>
 #include <balor/system/windows.hpp>
@@ -13,6 +14,7 @@ namespace balor {
 
 using std::move;
 using std::swap;
+using std::vector;
 using namespace balor::io;
 
 
@@ -61,10 +63,16 @@ File Module::directory() const {
 
 
 File Module::file() const {
-	File file;
-	verify(GetModuleFileNameW(_handle, const_cast<wchar_t*>(file.path()), File::maxPath));
-	file.resetPathLength();
-	return file;
+	vector<wchar_t> path(MAX_PATH);
+	for (;;) { // パスがバッファに収まらなければ切り詰めてバッファのサイズを返すので、返り値がバッファのサイズより小さくなるまで広げる
+		const DWORD length = GetModuleFileNameW(_handle, path.data(), static_cast<DWORD>(path.size()));
+		verify(length);
+		if (length < path.size()) {
+			break;
+		}
+		path.resize(path.size() * 2);
+	}
+	return File(path.data());
 }
 
 
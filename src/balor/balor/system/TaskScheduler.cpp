@@ -0,0 +1,326 @@
+﻿#include "TaskScheduler.hpp"
+
+#include <algorithm>
+#include <deque>
+#include <vector>
+
+#define BOOST_DATE_TIME_NO_LIB
+#define BOOST_THREAD_NO_LIB
+#include <boost/thread.hpp>
+
+#include <balor/test/verify.hpp>
+#include <balor/Singleton.hpp>
+
+
+namespace balor {
+	namespace system {
+
+using boost::condition_variable;
+using boost::mutex;
+using boost::thread;
+using std::deque;
+using std::exception_ptr;
+using std::move;
+using std::vector;
+
+
+namespace {
+const int priorityCount = 3;
+
+__declspec(thread) TaskScheduler* currentScheduler = nullptr; // 現在のスレッドがワーカーであるスケジューラー
+__declspec(thread) int currentWorkerIndex = -1;
+
+
+class GlobalScheduler {
+	friend Singleton<GlobalScheduler>;
+
+	GlobalScheduler() {}
+	~GlobalScheduler() {}
+
+public:
+	TaskScheduler scheduler;
+};
+} // namespace
+
+
+
+CancellationToken::CancellationToken() : _canceled(std::make_shared<std::atomic<bool> >(false)) {
+}
+
+
+void CancellationToken::cancel() {
+	_canceled->store(true, std::memory_order_release);
+}
+
+
+bool CancellationToken::canceled() const {
+	return _canceled->load(std::memory_order_acquire);
+}
+
+
+void CancellationToken::throwIfCanceled() const {
+	if (canceled()) {
+		throw TaskScheduler::CanceledException();
+	}
+}
+
+
+
+namespace detail {
+struct TaskStateBase::Impl {
+	mutable mutex stateMutex;
+	mutable condition_variable condition;
+};
+
+
+TaskStateBase::TaskStateBase(CancellationToken token) : _impl(new Impl()), _done(false), _token(move(token)) {
+}
+
+
+TaskStateBase::~TaskStateBase() {
+}
+
+
+void TaskStateBase::complete(exception_ptr exception) {
+	vector<std::function<void ()> > continuations;
+	{
+		mutex::scoped_lock lock(_impl->stateMutex);
+		assert("Already completed" && !done());
+		_exception = exception;
+		_done.store(true, std::memory_order_release);
+		continuations.swap(_continuations);
+	}
+	_impl->condition.notify_all();
+	for (auto i = continuations.begin(), end = continuations.end(); i != end; ++i) {
+		(*i)();
+	}
+}
+
+
+void TaskStateBase::continueWith(std::function<void ()> function) {
+	assert("Empty function" && function);
+	{
+		mutex::scoped_lock lock(_impl->stateMutex);
+		if (!done()) {
+			_continuations.push_back(move(function));
+			return;
+		}
+	}
+	function();
+}
+
+
+bool TaskStateBase::done() const {
+	return _done.load(std::memory_order_acquire);
+}
+
+
+void TaskStateBase::rethrow() const {
+	assert("Not completed" && done());
+	if (_exception) {
+		std::rethrow_exception(_exception);
+	}
+}
+
+
+const CancellationToken& TaskStateBase::token() const {
+	return _token;
+}
+
+
+void TaskStateBase::wait() const {
+	if (done()) {
+		return;
+	}
+	if (currentScheduler) { // ワーカーがブロックするとタスクの中でタスクを待つうちにワーカーが尽きるので、待つ間は他のタスクを実行する
+		while (!done()) {
+			if (!currentScheduler->runPending()) {
+				mutex::scoped_lock lock(_impl->stateMutex);
+				if (!done()) { // 新しく追加されたタスクに気付けるように短い間隔で起きる
+					_impl->condition.timed_wait(lock, boost::posix_time::milliseconds(1));
+				}
+			}
+		}
+		return;
+	}
+	mutex::scoped_lock lock(_impl->stateMutex);
+	while (!done()) {
+		_impl->condition.wait(lock);
+	}
+}
+} // namespace detail
+
+
+
+struct TaskScheduler::Impl {
+	struct Worker : private NonCopyable {
+		mutex queueMutex;
+		deque<Function> queues[priorityCount]; // 自分で追加したタスク。自分は後ろから取り出し、他のワーカーは前から盗む
+		deque<Function> inboxes[priorityCount]; // ワーカースレッド以外から追加したタスク。追加した順に前から取り出す
+	};
+
+	bool popLocal(int index, Function& function) {
+		Worker& worker = *workers[index];
+		mutex::scoped_lock lock(worker.queueMutex);
+		for (int priority = priorityCount - 1; 0 <= priority; --priority) {
+			auto& queue = worker.queues[priority];
+			if (!queue.empty()) {
+				function = move(queue.back());
+				queue.pop_back();
+				return true;
+			}
+			auto& inbox = worker.inboxes[priority];
+			if (!inbox.empty()) {
+				function = move(inbox.front());
+				inbox.pop_front();
+				return true;
+			}
+		}
+		return false;
+	}
+
+	bool steal(int index, Function& function) {
+		const int count = static_cast<int>(workers.size());
+		for (int priority = priorityCount - 1; 0 <= priority; --priority) { // 他のワーカーの高い優先度のタスクを先に盗む
+			for (int i = 1; i < count; ++i) {
+				Worker& victim = *workers[(index + i) % count];
+				mutex::scoped_lock lock(victim.queueMutex);
+				auto& inbox = victim.inboxes[priority];
+				if (!inbox.empty()) {
+					function = move(inbox.front());
+					inbox.pop_front();
+					return true;
+				}
+				auto& queue = victim.queues[priority];
+				if (!queue.empty()) {
+					function = move(queue.front());
+					queue.pop_front();
+					return true;
+				}
+			}
+		}
+		return false;
+	}
+
+	bool runOne(int index) {
+		Function function;
+		if (popLocal(index, function) || steal(index, function)) {
+			pendingCount.fetch_sub(1);
+			function();
+			return true;
+		}
+		return false;
+	}
+
+	void run(TaskScheduler* scheduler, int index) {
+		currentScheduler = scheduler;
+		currentWorkerIndex = index;
+		for ( ; ; ) {
+			if (runOne(index)) {
+				continue;
+			}
+			mutex::scoped_lock lock(sleepMutex);
+			sleepingCount.fetch_add(1);
+			if (0 < pendingCount.load()) { // sleepingCount を増やした後に調べるので post からの通知を取りこぼさない
+				sleepingCount.fetch_sub(1);
+				continue;
+			}
+			if (stopping) {
+				sleepingCount.fetch_sub(1);
+				return;
+			}
+			sleepCondition.wait(lock);
+			sleepingCount.fetch_sub(1);
+		}
+	}
+
+	vector<std::unique_ptr<Worker> > workers;
+	vector<std::unique_ptr<thread> > threads;
+	mutex sleepMutex;
+	condition_variable sleepCondition;
+	std::atomic<int> pendingCount;
+	std::atomic<int> sleepingCount;
+	std::atomic<unsigned int> nextWorker;
+	bool stopping;
+};
+
+
+
+bool TaskScheduler::Priority::_validate(Priority value) {
+	return low <= value && value <= high;
+}
+
+
+TaskScheduler::TaskScheduler(int threadCount) : _impl(new Impl()) {
+	if (threadCount <= 0) {
+		threadCount = std::max(1, static_cast<int>(thread::hardware_concurrency()));
+	}
+	_impl->pendingCount.store(0);
+	_impl->sleepingCount.store(0);
+	_impl->nextWorker.store(0);
+	_impl->stopping = false;
+	for (int i = 0; i < threadCount; ++i) {
+		_impl->workers.push_back(std::unique_ptr<Impl::Worker>(new Impl::Worker()));
+	}
+	for (int i = 0; i < threadCount; ++i) {
+		TaskScheduler* scheduler = this;
+		_impl->threads.push_back(std::unique_ptr<thread>(new thread([scheduler, i] () {
+			scheduler->_impl->run(scheduler, i);
+		})));
+	}
+}
+
+
+TaskScheduler::~TaskScheduler() {
+	{
+		mutex::scoped_lock lock(_impl->sleepMutex);
+		_impl->stopping = true;
+	}
+	_impl->sleepCondition.notify_all();
+	for (auto i = _impl->threads.begin(), end = _impl->threads.end(); i != end; ++i) {
+		(*i)->join();
+	}
+}
+
+
+TaskScheduler& TaskScheduler::global() {
+	return Singleton<GlobalScheduler>::get().scheduler;
+}
+
+
+void TaskScheduler::post(Function function, TaskScheduler::Priority priority) {
+	assert("Empty function" && function);
+	assert("Invalid priority" && Priority::_validate(priority));
+
+	if (currentScheduler == this) {
+		Impl::Worker& worker = *_impl->workers[currentWorkerIndex];
+		mutex::scoped_lock lock(worker.queueMutex);
+		worker.queues[priority].push_back(move(function));
+	} else { // ワーカースレッド以外からは順番に割り振る
+		const int index = static_cast<int>(_impl->nextWorker.fetch_add(1) % threadCount());
+		Impl::Worker& worker = *_impl->workers[index];
+		mutex::scoped_lock lock(worker.queueMutex);
+		worker.inboxes[priority].push_back(move(function));
+	}
+	_impl->pendingCount.fetch_add(1);
+	if (0 < _impl->sleepingCount.load()) {
+		mutex::scoped_lock lock(_impl->sleepMutex);
+		_impl->sleepCondition.notify_one();
+	}
+}
+
+
+int TaskScheduler::threadCount() const {
+	return static_cast<int>(_impl->workers.size());
+}
+
+
+bool TaskScheduler::runPending() {
+	assert("Not a worker thread" && currentScheduler == this);
+	return _impl->runOne(currentWorkerIndex);
+}
+
+
+
+	}
+}
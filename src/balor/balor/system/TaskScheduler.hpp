@@ -0,0 +1,257 @@
+﻿#pragma once
+
+#include <atomic>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <balor/Enum.hpp>
+#include <balor/Exception.hpp>
+#include <balor/NonCopyable.hpp>
+#include <balor/test/noMacroAssert.hpp>
+
+
+namespace balor {
+	namespace system {
+
+
+
+/**
+ * タスクのキャンセルを通知する。コピーしたトークンは同じ状態を共有する。
+ */
+class CancellationToken {
+public:
+	/// キャンセルされていない新しいトークンを作成する。
+	CancellationToken();
+
+public:
+	/// キャンセルする。どのスレッドから呼んでも良い。
+	void cancel();
+	/// キャンセルされたかどうか。
+	bool canceled() const;
+	/// キャンセルされていたら TaskScheduler::CanceledException を投げる。長い処理の途中で呼んで処理を打ち切る。
+	void throwIfCanceled() const;
+
+private:
+	std::shared_ptr<std::atomic<bool> > _canceled;
+};
+
+
+
+class TaskScheduler;
+
+
+namespace detail {
+/// Task の型に依存しない共有状態。
+class TaskStateBase : private NonCopyable {
+public:
+	TaskStateBase(CancellationToken token);
+	virtual ~TaskStateBase();
+
+public:
+	/// 完了させて待っているスレッドを起こし、継続を実行する。
+	void complete(std::exception_ptr exception);
+	/// 完了したら function を実行する。既に完了していれば直ちに実行する。複数の継続を登録した場合は登録した順に実行する。
+	void continueWith(std::function<void ()> function);
+	bool done() const;
+	/// 完了しているなら例外を投げ直す。
+	void rethrow() const;
+	const CancellationToken& token() const;
+	/// 完了を待つ。ワーカースレッドから呼んだ場合はブロックせずに、そのスケジューラーの他のタスクを実行しながら待つ。
+	void wait() const;
+
+private:
+	struct Impl;
+
+	std::unique_ptr<Impl> _impl;
+	std::atomic<bool> _done;
+	std::exception_ptr _exception;
+	std::vector<std::function<void ()> > _continuations;
+	CancellationToken _token;
+};
+
+
+template<typename T>
+class TaskState : public TaskStateBase {
+public:
+	TaskState(CancellationToken token) : TaskStateBase(token) {}
+
+	template<typename Function> void run(Function& function) { value.reset(new T(function())); }
+
+	std::unique_ptr<T> value;
+};
+
+
+template<>
+class TaskState<void> : public TaskStateBase {
+public:
+	TaskState(CancellationToken token) : TaskStateBase(token) {}
+
+	template<typename Function> void run(Function& function) { function(); }
+};
+} // namespace detail
+
+
+
+/**
+ * TaskScheduler::run で実行したタスクの結果を表す。コピーしたタスクは同じ状態を共有する。
+ *
+ * thenOn 関数は Executor::invoke(std::function<void ()>, bool) を持つ任意のクラス、例えば balor::gui::Control を受け取り、
+ * タスクが完了したら継続をそのコントロールのメッセージループのスレッドで実行する。
+ * 参照を受け取る thenOn は executor のアドレスだけを保持するので、executor は継続の invoke が終わるまで破棄してはならない。
+ * executor の寿命を保証できない場合は std::weak_ptr を受け取る thenOn を使う。
+ */
+template<typename T>
+class Task {
+public:
+	typedef typename std::add_lvalue_reference<T>::type Reference;
+
+public:
+	/// 空のタスクを作成。
+	Task() {}
+	explicit Task(std::shared_ptr<detail::TaskState<T> > state) : _state(std::move(state)) {}
+
+public:
+	/// タスクをキャンセルする。実行前ならば実行されずに CanceledException で完了する。
+	void cancel() { _state->token().cancel(); }
+	/// 完了したかどうか。
+	bool done() const { return _state->done(); }
+	/// 完了を待って結果を返す。タスクが例外を投げていればその例外を投げ直す。
+	/// ワーカースレッドから呼んだ場合は待っている間に他のタスクを実行するので、タスクの中で別のタスクを待ってもワーカーが枯渇しない。
+	Reference get() const {
+		_state->wait();
+		_state->rethrow();
+		return getValue(static_cast<T*>(nullptr));
+	}
+	/// 完了したら continuation(Task&) を executor のスレッドで実行する。一つのタスクに複数の継続を登録しても良い。
+	/// executor はタスクが完了して継続を invoke するまで破棄してはならない。
+	template<typename Executor, typename Continuation>
+	void thenOn(Executor& executor, Continuation continuation) {
+		::balor::test::noMacroAssert(_state != nullptr);
+		auto task = *this;
+		auto executorPointer = &executor;
+		_state->continueWith([task, executorPointer, continuation] () {
+			executorPointer->invoke([task, continuation] () mutable {
+				continuation(task);
+			}, false);
+		});
+	}
+	/// 完了したら continuation(Task&) を executor のスレッドで実行する。完了した時点で executor が破棄されていれば継続は実行しない。
+	template<typename Executor, typename Continuation>
+	void thenOn(std::weak_ptr<Executor> executor, Continuation continuation) {
+		::balor::test::noMacroAssert(_state != nullptr);
+		::balor::test::noMacroAssert(!executor.expired());
+		auto task = *this;
+		_state->continueWith([task, executor, continuation] () {
+			if (auto executorPointer = executor.lock()) {
+				executorPointer->invoke([task, continuation] () mutable {
+					continuation(task);
+				}, false);
+			}
+		});
+	}
+	/// タスクが空でなければ true。
+	explicit operator bool() const { return _state != nullptr; }
+
+private:
+	template<typename U> U& getValue(U* ) const { return *_state->value; }
+	void getValue(void* ) const {}
+
+	std::shared_ptr<detail::TaskState<T> > _state;
+};
+
+
+
+/**
+ * ワークスティーリングするスレッドプールでタスクを実行する。
+ *
+ * 各ワーカースレッドはタスクの優先度ごとに両端キューを持ち、ワーカースレッドから追加したタスクは自分のキューに積む。
+ * 自分のキューが空になったワーカーは他のワーカーのキューの反対側からタスクを盗む。
+ * ワーカースレッド以外から追加したタスクは順番にワーカーの受付キューに割り振り、同じ優先度なら追加した順に実行する。
+ * 優先度の高いタスクは低いタスクよりも先に取り出される。
+ * Windows API に依存しないので、UI スレッドを持たないプログラムでも使える。
+ *
+ * <h3>・サンプルコード</h3>
+ * <pre><code>
+	Frame frame(L"TaskScheduler Sample");
+	Panel panel(frame, 0, 0, 400, 400);
+
+	auto task = TaskScheduler::global().run([] () {
+		return Bitmap(L"image.png"); // ワーカースレッドで読み込む
+	});
+	task.thenOn(frame, [&] (Task<Bitmap>& task) { // frame のメッセージループで実行される
+		panel.brush(Brush(task.get()));
+	});
+
+	frame.runMessageLoop();
+ * </code></pre>
+ */
+class TaskScheduler : private NonCopyable {
+	friend detail::TaskStateBase;
+
+public:
+	typedef std::function<void ()> Function;
+
+	/// タスクの優先度。
+	struct Priority {
+		enum _enum {
+			low    = 0, /// 他に実行するタスクが無い時に実行する。
+			normal = 1, /// 普通。
+			high   = 2, /// 優先して実行する。
+		};
+		BALOR_NAMED_ENUM_MEMBERS(Priority);
+	};
+
+	/// タスクが実行前にキャンセルされた。または CancellationToken::throwIfCanceled が投げた。
+	class CanceledException : public Exception {};
+
+public:
+	/// スレッド数を指定して作成する。0 以下の場合は論理 CPU 数になる。
+	explicit TaskScheduler(int threadCount = 0);
+	/// 残っているタスクを全て実行してからスレッドを終了する。
+	~TaskScheduler();
+
+public:
+	/// ライブラリ全体で共有するスケジューラー。
+	static TaskScheduler& global();
+	/// 関数を実行待ちに追加する。どのスレッドから呼んでも良い。function は例外を投げてはならない。
+	void post(Function function, TaskScheduler::Priority priority = Priority::normal);
+	/// 関数をタスクとして実行し、結果を Task で返す。function は例外を投げても良い。
+	template<typename Function>
+	Task<typename std::result_of<Function()>::type> run(Function function, TaskScheduler::Priority priority = Priority::normal, CancellationToken token = CancellationToken()) {
+		typedef typename std::result_of<Function()>::type Result;
+		auto state = std::make_shared<detail::TaskState<Result> >(token);
+		post([state, function] () mutable {
+			if (state->token().canceled()) {
+				state->complete(std::make_exception_ptr(CanceledException()));
+				return;
+			}
+			try {
+				state->run(function);
+			} catch (...) {
+				state->complete(std::current_exception());
+				return;
+			}
+			state->complete(std::exception_ptr());
+		}, priority);
+		return Task<Result>(state);
+	}
+	/// ワーカースレッドの数。
+	int threadCount() const;
+
+private:
+	/// 現在のワーカースレッドから実行待ちのタスクを一つ取り出して実行する。実行するタスクが無ければ false を返す。
+	bool runPending();
+
+	struct Impl;
+
+	std::unique_ptr<Impl> _impl;
+};
+
+
+
+	}
+}
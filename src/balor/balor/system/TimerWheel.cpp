@@ -0,0 +1,468 @@
+﻿#include "TimerWheel.hpp"
+
+#include <climits>
+#include <utility>
+#include <intrin.h>
+
+#include <balor/test/verify.hpp>
+#include <balor/scopeExit.hpp>
+
+
+namespace balor {
+	namespace system {
+
+using std::move;
+
+
+namespace {
+const int levelCount = 4;
+const int slotBits = 6;
+const int slotCount = 1 << slotBits;
+const int slotMask = slotCount - 1;
+const int overflowSlot = levelCount * slotCount; // levelCount * slotBits ビットの範囲に収まらないタイマー
+const int levelShifts[] = {0, slotBits, slotBits * 2, slotBits * 3, slotBits * 4};
+
+
+int findFirstBit(unsigned __int64 mask) {
+	assert(mask);
+	unsigned long index;
+	if (_BitScanForward(&index, static_cast<unsigned long>(mask))) {
+		return static_cast<int>(index);
+	}
+	_BitScanForward(&index, static_cast<unsigned long>(mask >> 32));
+	return static_cast<int>(index) + 32;
+}
+
+
+/// first 以上 last 以下で末尾の 0 ビットが最も多い値。満了時刻をそろえて同じ tick にまとめる。
+__int64 coalesce(__int64 first, __int64 last) {
+	__int64 result = last;
+	while (first < last) {
+		const __int64 next = result & (result - 1);
+		if (next < first) {
+			break;
+		}
+		result = next;
+	}
+	return result;
+}
+} // namespace
+
+
+
+TimerWheel::Timer::Timer()
+	: _wheel(nullptr)
+	, _interval(1000)
+	, _tolerance(0)
+	, _oneShot(false)
+	, _started(false)
+	, _paused(false)
+	, _slot(-1)
+	, _expiration(0)
+	, _due(0)
+	, _remaining(0) {
+	previous = this;
+	next = this;
+}
+
+
+TimerWheel::Timer::Timer(Timer&& value)
+	: _wheel(move(value._wheel))
+	, _interval(move(value._interval))
+	, _tolerance(move(value._tolerance))
+	, _oneShot(move(value._oneShot))
+	, _started(move(value._started))
+	, _paused(move(value._paused))
+	, _slot(-1)
+	, _expiration(move(value._expiration))
+	, _due(move(value._due))
+	, _remaining(move(value._remaining))
+	, _onRun(move(value._onRun)) {
+	assert("Invalid rvalue" && !_started); // ホイールのリストに繋がっているので start 中に move はダメ
+	previous = this;
+	next = this;
+	value._wheel = nullptr;
+}
+
+
+TimerWheel::Timer::Timer(TimerWheel& wheel, int interval, Listener<Timer::Run&> onRun)
+	: _wheel(&wheel)
+	, _interval(interval)
+	, _tolerance(0)
+	, _oneShot(false)
+	, _started(false)
+	, _paused(false)
+	, _slot(-1)
+	, _expiration(0)
+	, _due(0)
+	, _remaining(0)
+	, _onRun(move(onRun)) {
+	assert("Invalid interval" && 0 < interval);
+	previous = this;
+	next = this;
+}
+
+
+TimerWheel::Timer::~Timer() {
+	if (_wheel) {
+		stop();
+	}
+}
+
+
+TimerWheel::Timer& TimerWheel::Timer::operator=(Timer&& value) {
+	if (&value != this) {
+		this->~Timer();
+		new (this) Timer(move(value));
+	}
+	return *this;
+}
+
+
+int TimerWheel::Timer::interval() const {
+	return _interval;
+}
+
+
+void TimerWheel::Timer::interval(int value) {
+	assert("Invalid interval" && 0 < value);
+	if (value != interval()) {
+		_interval = value;
+		if (paused()) {
+			_remaining = value;
+		} else if (started()) {
+			stop();
+			start();
+		}
+	}
+}
+
+
+Listener<TimerWheel::Timer::Run&>& TimerWheel::Timer::onRun() {
+	return _onRun;
+}
+
+
+bool TimerWheel::Timer::oneShot() const {
+	return _oneShot;
+}
+
+
+void TimerWheel::Timer::oneShot(bool value) {
+	_oneShot = value;
+}
+
+
+void TimerWheel::Timer::pause() {
+	if (_started && !_paused) {
+		_remaining = _expiration - _wheel->now();
+		if (_remaining < 0) {
+			_remaining = 0;
+		}
+		_wheel->unlink(*this);
+		_paused = true;
+	}
+}
+
+
+bool TimerWheel::Timer::paused() const {
+	return _paused;
+}
+
+
+void TimerWheel::Timer::resume() {
+	if (_paused) {
+		_expiration = _wheel->now() + _remaining;
+		_paused = false;
+		_wheel->schedule(*this);
+	}
+}
+
+
+void TimerWheel::Timer::start() {
+	assert("Null wheel" && wheel());
+	if (!_started) {
+		_expiration = _wheel->now() + _interval;
+		_started = true;
+		_paused = false;
+		_wheel->schedule(*this);
+	}
+}
+
+
+bool TimerWheel::Timer::started() const {
+	return _started;
+}
+
+
+void TimerWheel::Timer::stop() {
+	if (_started) {
+		if (!_paused) {
+			_wheel->unlink(*this);
+		}
+		_started = false;
+		_paused = false;
+	}
+}
+
+
+int TimerWheel::Timer::tolerance() const {
+	return _tolerance;
+}
+
+
+void TimerWheel::Timer::tolerance(int value) {
+	assert("Negative tolerance" && 0 <= value);
+	_tolerance = value;
+}
+
+
+TimerWheel* TimerWheel::Timer::wheel() const {
+	return _wheel;
+}
+
+
+
+TimerWheel::TimerWheel(Clock clock, int resolution, Function onReschedule)
+	: _clock(move(clock))
+	, _resolution(resolution)
+	, _onReschedule(move(onReschedule))
+	, _tick(0)
+	, _notified(-1)
+	, _advancing(0) {
+	assert("Empty clock" && _clock);
+	assert("Invalid resolution" && 0 < resolution);
+	for (int i = 0; i < levelCount; ++i) {
+		_occupied[i] = 0;
+	}
+	for (int i = 0; i <= overflowSlot; ++i) {
+		_slots[i].previous = &_slots[i];
+		_slots[i].next = &_slots[i];
+	}
+	_tick = now() / _resolution;
+}
+
+
+TimerWheel::~TimerWheel() {
+	for (int i = 0; i <= overflowSlot; ++i) { // 残っているタイマーは停止する
+		Node& list = _slots[i];
+		while (list.next != &list) {
+			Timer& timer = static_cast<Timer&>(*list.next);
+			unlink(timer);
+			timer._started = false;
+		}
+	}
+}
+
+
+void TimerWheel::advance() {
+	const __int64 target = now() / _resolution;
+	++_advancing;
+	scopeExit([&] () {
+		--_advancing;
+	});
+	for (__int64 tick = nextEventTick(); 0 <= tick && tick <= target; tick = nextEventTick()) {
+		process(tick);
+	}
+	if (_tick <= target) { // 次のイベントまでにタイマーは無いので飛ばして良い
+		_tick = target + 1;
+	}
+	_notified = -1;
+}
+
+
+int TimerWheel::nextExpiration() {
+	__int64 tick = earliestDue(overflowSlot); // 溢れたタイマーは稀なので全て調べる
+	for (int level = 0; level < levelCount; ++level) { // 各階層の最初のスロットの中で最も早く満了するタイマー
+		const int index = static_cast<int>((_tick >> levelShifts[level]) & slotMask);
+		const unsigned __int64 mask = _occupied[level] & (~0ULL << index);
+		if (mask) {
+			const __int64 due = earliestDue((level << slotBits) | findFirstBit(mask));
+			if (tick < 0 || due < tick) {
+				tick = due;
+			}
+		}
+	}
+	if (0 <= tick && tick < _tick) {
+		tick = _tick;
+	}
+	_notified = tick;
+	if (tick < 0) {
+		return -1;
+	}
+	const __int64 result = tick * _resolution - now();
+	return result < 0 ? 0 : (INT_MAX < result ? INT_MAX : static_cast<int>(result));
+}
+
+
+__int64 TimerWheel::now() const {
+	return _clock();
+}
+
+
+int TimerWheel::resolution() const {
+	return _resolution;
+}
+
+
+void TimerWheel::link(Timer& timer, int slot) {
+	Node& list = _slots[slot];
+	timer.previous = list.previous;
+	timer.next = &list;
+	list.previous->next = &timer;
+	list.previous = &timer;
+	timer._slot = slot;
+	if (slot < overflowSlot) {
+		_occupied[slot >> slotBits] |= 1ULL << (slot & slotMask);
+	}
+}
+
+
+void TimerWheel::unlink(Timer& timer) {
+	timer.previous->next = timer.next;
+	timer.next->previous = timer.previous;
+	timer.previous = &timer;
+	timer.next = &timer;
+	const int slot = timer._slot;
+	if (0 <= slot && slot < overflowSlot) {
+		const Node& list = _slots[slot];
+		if (list.next == &list) {
+			_occupied[slot >> slotBits] &= ~(1ULL << (slot & slotMask));
+		}
+	}
+	timer._slot = -1;
+}
+
+
+void TimerWheel::schedule(Timer& timer) {
+	const __int64 first = (timer._expiration + _resolution - 1) / _resolution;
+	const __int64 last = (timer._expiration + timer._tolerance) / _resolution;
+	const __int64 due = first < last ? coalesce(first, last) : first;
+	timer._due = due;
+	place(timer, due);
+	if (!_advancing && (_notified < 0 || due < _notified)) {
+		_notified = due;
+		if (_onReschedule) {
+			_onReschedule();
+		}
+	}
+}
+
+
+void TimerWheel::place(Timer& timer, __int64 due) {
+	if (due < _tick) {
+		due = _tick;
+	}
+	const __int64 difference = due ^ _tick;
+	for (int level = 0; level < levelCount; ++level) {
+		if (!(difference >> levelShifts[level + 1])) { // 上位のビットが _tick と同じ最も下の階層に入れる
+			link(timer, (level << slotBits) | static_cast<int>((due >> levelShifts[level]) & slotMask));
+			return;
+		}
+	}
+	link(timer, overflowSlot);
+}
+
+
+__int64 TimerWheel::earliestDue(int slot) const {
+	const Node& list = _slots[slot];
+	__int64 result = -1;
+	for (const Node* i = list.next; i != &list; i = i->next) {
+		const __int64 due = static_cast<const Timer*>(i)->_due;
+		if (result < 0 || due < result) {
+			result = due;
+		}
+	}
+	return result;
+}
+
+
+__int64 TimerWheel::nextEventTick() const {
+	__int64 result = -1;
+	for (int level = 0; level < levelCount; ++level) {
+		const int shift = levelShifts[level];
+		const int index = static_cast<int>((_tick >> shift) & slotMask);
+		const unsigned __int64 mask = _occupied[level] & (~0ULL << index);
+		if (mask) { // 下の階層ならばその tick で満了、上の階層ならばその tick で下の階層に移す
+			__int64 tick = ((_tick >> levelShifts[level + 1]) << levelShifts[level + 1]) + (static_cast<__int64>(findFirstBit(mask)) << shift);
+			if (tick < _tick) {
+				tick = _tick;
+			}
+			if (result < 0 || tick < result) {
+				result = tick;
+			}
+		}
+	}
+	const Node& overflow = _slots[overflowSlot];
+	if (overflow.next != &overflow) { // 最上位の階層が一周したら入れ直す
+		const int shift = levelShifts[levelCount];
+		const __int64 tick = ((_tick + (1LL << shift) - 1) >> shift) << shift;
+		if (result < 0 || tick < result) {
+			result = tick;
+		}
+	}
+	return result;
+}
+
+
+void TimerWheel::process(__int64 tick) {
+	_tick = tick;
+	Node moving;
+	auto moveList = [&] (int slot) { // slot のタイマーを全て moving に移す
+		Node& list = _slots[slot];
+		while (list.next != &list) {
+			Timer& timer = static_cast<Timer&>(*list.next);
+			unlink(timer);
+			timer.previous = moving.previous;
+			timer.next = &moving;
+			moving.previous->next = &timer;
+			moving.previous = &timer;
+		}
+	};
+
+	moving.previous = &moving;
+	moving.next = &moving;
+	if (!(tick & ((1LL << levelShifts[levelCount]) - 1))) { // 最上位の階層が一周したら溢れたタイマーを入れ直す
+		moveList(overflowSlot);
+	}
+	for (int level = levelCount - 1; 0 < level; --level) { // 上の階層から順に一つ下の階層に移す
+		const int slot = (level << slotBits) | static_cast<int>((tick >> levelShifts[level]) & slotMask);
+		if (_occupied[level] & (1ULL << (slot & slotMask))) {
+			moveList(slot);
+		}
+	}
+	while (moving.next != &moving) {
+		Timer& timer = static_cast<Timer&>(*moving.next);
+		const __int64 due = timer._due;
+		unlink(timer);
+		place(timer, due);
+	}
+
+	const int slot = static_cast<int>(tick & slotMask);
+	if (_occupied[0] & (1ULL << slot)) {
+		moveList(slot);
+	}
+	_tick = tick + 1;
+	const __int64 current = now();
+	while (moving.next != &moving) { // onRun の中で他のタイマーを停止しても moving から外れるだけ
+		Timer& timer = static_cast<Timer&>(*moving.next);
+		unlink(timer);
+		if (timer._oneShot) {
+			timer._started = false;
+		} else {
+			__int64 expiration = timer._expiration + timer._interval;
+			if (expiration < current) {
+				expiration += (current - expiration + timer._interval - 1) / timer._interval * timer._interval;
+			}
+			timer._expiration = expiration;
+			schedule(timer);
+		}
+		Timer::Run event(timer);
+		timer.onRun()(event);
+	}
+}
+
+
+
+	}
+}
@@ -0,0 +1,145 @@
+﻿#pragma once
+
+#include <functional>
+
+#include <balor/Event.hpp>
+#include <balor/Listener.hpp>
+#include <balor/NonCopyable.hpp>
+
+
+namespace balor {
+	namespace system {
+
+
+
+/**
+ * 多数の軽量なタイマーを一つの時計で駆動する階層型タイミングホイール。
+ *
+ * 時刻は clock 関数が返すミリ秒で表し、advance() を呼ぶとその時刻までに満了したタイマーの onRun イベントを発生させる。
+ * タイマーの開始、停止、一時停止、再開はタイマーの数によらず定数時間で終わる。
+ * nextExpiration() が返す時間が経つまでに advance() を呼べばタイマーは遅れない。balor::gui::TimerService はこれを OS のタイマー一つで行う。
+ * Windows API に依存せず、clock を差し替えれば実時間を待たずにテストできる。
+ * スレッドセーフではないので、タイマーの操作と advance() は同じスレッドで行うこと。
+ * TimerWheel は全てのタイマーより後に破棄すること。
+ *
+ * <h3>・サンプルコード</h3>
+ * <pre><code>
+	__int64 now = 0;
+	TimerWheel wheel([&] () { return now; });
+
+	TimerWheel::Timer timer(wheel, 100, [&] (TimerWheel::Timer::Run& ) {
+		Debug::writeLine(L"100 ミリ秒ごとに発生");
+	});
+	timer.start();
+
+	now += 100;
+	wheel.advance(); // onRun が発生する
+ * </code></pre>
+ */
+class TimerWheel : private NonCopyable {
+private:
+	struct Node {
+		Node* previous;
+		Node* next;
+	};
+
+public:
+	/// 現在時刻をミリ秒で返す関数。値は減ってはならない。
+	typedef std::function<__int64 ()> Clock;
+	typedef std::function<void ()> Function;
+
+	/// TimerWheel で駆動するタイマー。
+	class Timer : private Node, private NonCopyable {
+		friend TimerWheel;
+	public:
+		/// タイマーのイベントクラス。
+		typedef EventWithSender<Timer> Run;
+
+	public:
+		/// 空のタイマーを作成。
+		Timer();
+		Timer(Timer&& value);
+		/// 駆動する TimerWheel、実行間隔、onRun イベントから作成。
+		Timer(TimerWheel& wheel, int interval, Listener<Timer::Run&> onRun = Listener<Timer::Run&>());
+		~Timer();
+		Timer& operator=(Timer&& value);
+
+	public:
+		/// onRun の実行間隔（ミリ秒）。開始中に変更すると新しい間隔で開始し直す。
+		int interval() const;
+		void interval(int value);
+		/// interval ごとに発生するイベント。
+		Listener<Timer::Run&>& onRun();
+		/// 一度だけ onRun を発生させて停止するかどうか。初期値は false。
+		bool oneShot() const;
+		void oneShot(bool value);
+		/// 残り時間を保持して一時停止する。
+		void pause();
+		/// 一時停止中かどうか。一時停止中も started() は true を返す。
+		bool paused() const;
+		/// 一時停止した時の残り時間で再開する。
+		void resume();
+		/// タイマーを開始する。
+		void start();
+		/// 開始済みかどうか。初期値は false。
+		bool started() const;
+		/// タイマーを停止する。
+		void stop();
+		/// onRun を遅らせても良い時間（ミリ秒）。近い時刻に満了する他のタイマーとまとめて発生させて起床回数を減らす。初期値は 0。
+		int tolerance() const;
+		void tolerance(int value);
+		/// タイマーを駆動する TimerWheel。
+		TimerWheel* wheel() const;
+
+	private:
+		TimerWheel* _wheel;
+		int _interval;
+		int _tolerance;
+		bool _oneShot;
+		bool _started;
+		bool _paused;
+		int _slot;
+		__int64 _expiration;
+		__int64 _due;
+		__int64 _remaining;
+		Listener<Timer::Run&> _onRun;
+	};
+
+public:
+	/// 時計、時刻の分解能（ミリ秒）、開始したタイマーがこれまでの nextExpiration() より早く満了する時に呼ぶ関数から作成。
+	TimerWheel(Clock clock, int resolution = 1, Function onReschedule = Function());
+	~TimerWheel();
+
+public:
+	/// 現在時刻までに満了したタイマーの onRun イベントを発生させる。満了を逃した周期はまとめて一回になる。
+	void advance();
+	/// 次に advance() を呼ぶべきまでの時間（ミリ秒）。開始しているタイマーが無ければ -1。
+	int nextExpiration();
+	/// clock が返す現在時刻。
+	__int64 now() const;
+	/// 時刻の分解能（ミリ秒）。
+	int resolution() const;
+
+private:
+	void link(Timer& timer, int slot);
+	void unlink(Timer& timer);
+	void schedule(Timer& timer);
+	void place(Timer& timer, __int64 due);
+	__int64 earliestDue(int slot) const;
+	__int64 nextEventTick() const;
+	void process(__int64 tick);
+
+	Clock _clock;
+	int _resolution;
+	Function _onReschedule;
+	__int64 _tick;
+	__int64 _notified;
+	int _advancing;
+	unsigned __int64 _occupied[4];
+	Node _slots[4 * 64 + 1]; // 最後は溢れたタイマー
+};
+
+
+
+	}
+}
@@ -17,10 +17,14 @@ namespace system {
 #include <balor/system/Console.hpp>
 #include <balor/system/EnvironmentVariable.hpp>
 #include <balor/system/FileVersionInfo.hpp>
+#include <balor/system/InvokeQueue.hpp>
+#include <balor/system/Metrics.hpp>
 #include <balor/system/Module.hpp>
 #include <balor/system/PerformanceCounter.hpp>
 #include <balor/system/Process.hpp>
 #include <balor/system/System.hpp>
+#include <balor/system/TaskScheduler.hpp>
+#include <balor/system/TimerWheel.hpp>
 #include <balor/system/Version.hpp>
 //#include <balor/system/windows.hpp> // windows.h のインクルード用
 
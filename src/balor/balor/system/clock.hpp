@@ -0,0 +1,39 @@
+﻿#pragma once
+
+// ライブラリ内部で経過時間を計る高分解能のカウンタ。cpp ファイルからのみ include する。
+
+#include <balor/system/windows.hpp>
+
+
+namespace balor {
+	namespace system {
+		namespace detail {
+
+
+
+/// QueryPerformanceCounter の値。
+inline __int64 getTicks() {
+	LARGE_INTEGER counter;
+	QueryPerformanceCounter(&counter);
+	return counter.QuadPart;
+}
+
+
+/// getTicks の一秒あたりの値。
+inline double getTicksPerSecond() {
+	LARGE_INTEGER frequency;
+	QueryPerformanceFrequency(&frequency);
+	return static_cast<double>(frequency.QuadPart);
+}
+
+
+/// 任意の時点からの秒数。差分だけを使う。
+inline double getSeconds() {
+	return getTicks() / getTicksPerSecond();
+}
+
+
+
+		}
+	}
+}
@@ -0,0 +1,616 @@
+﻿#include "AsyncLogger.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <exception>
+#include <string>
+#include <utility>
+#include <vector>
+
+#define BOOST_DATE_TIME_NO_LIB
+#define BOOST_THREAD_NO_LIB
+#include <boost/thread.hpp>
+
+#include <balor/io/File.hpp>
+#include <balor/io/FileStream.hpp>
+#include <balor/locale/Charset.hpp>
+#include <balor/system/windows.hpp>
+#include <balor/test/Debug.hpp>
+#include <balor/test/verify.hpp>
+#include <balor/String.hpp>
+
+
+namespace balor {
+	namespace test {
+
+using std::atomic;
+using std::exception_ptr;
+using std::move;
+using std::string;
+using std::unique_ptr;
+using std::vector;
+using boost::condition_variable;
+using boost::mutex;
+using boost::thread;
+using namespace balor::io;
+using namespace balor::locale;
+
+
+namespace {
+__declspec(thread) unsigned int cachedLoggerId = 0; // 現在のスレッドが最後に書き込んだロガー
+__declspec(thread) void* cachedRing = nullptr;
+
+const int flushInterval = 10; // スレッドがリングを読み出す間隔（ミリ秒）
+const unsigned int wrapMarker = 0xFFFFFFFF;
+const unsigned int wideFlag = 1;
+const unsigned int lineFlag = 2;
+
+
+atomic<unsigned int>& getNextLoggerId() {
+	static atomic<unsigned int> nextLoggerId(1);
+	return nextLoggerId;
+}
+
+
+atomic<unsigned int>& nextLoggerId = getNextLoggerId(); // マルチスレッドになるまえに初期化されることを保証する
+
+
+/// リング上のメッセージの先頭。メッセージの長さが wrapMarker ならリングの残りを飛ばして先頭に戻る。
+struct Header {
+	unsigned int size;
+	unsigned int flags;
+	__int64 time; // FILETIME
+};
+
+
+unsigned int alignRecord(unsigned int size) {
+	return (size + 7) & ~7U;
+}
+
+
+/// 一つの書き込みスレッドと出力スレッドの間のリング。head は書き込みスレッドだけが、tail は出力スレッドだけが進める。
+struct Ring {
+	Ring(int capacity, DWORD threadId, HANDLE thread)
+		: buffer(capacity)
+		, capacity(capacity)
+		, threadId(threadId)
+		, thread(thread)
+		, head(0)
+		, overflowCount(0)
+		, tail(0)
+		, dropped(0)
+		, lineStart(true) {
+	}
+	~Ring() {
+		verify(CloseHandle(thread));
+	}
+
+	vector<unsigned char> buffer;
+	const unsigned int capacity;
+	const DWORD threadId;
+	const HANDLE thread; // スレッドの終了を調べるのと、スレッドIDを使い回させないために持っておく
+	char headPadding[64];
+	atomic<unsigned int> head;
+	unsigned int overflowCount; // 書き込みスレッドだけが使う
+	char tailPadding[64];
+	atomic<unsigned int> tail;
+	atomic<unsigned int> dropped; // 出力スレッドが読み出して０に戻す
+	bool lineStart; // 出力スレッドだけが使う
+};
+
+
+/// リングから読み出した一つのメッセージ。バイト列は Unicode なら変換してヌル終端した状態で置き場に持つ。
+struct Entry {
+	__int64 time;
+	DWORD threadId;
+	unsigned int flags;
+	int offset;
+	int length;
+	bool lineStart;
+};
+
+
+/// 出力スレッド自身が書き込んだメッセージ。リングを通さずに次の出力に回す。
+struct Deferred {
+	__int64 time;
+	unsigned int flags;
+	string message;
+};
+
+
+__int64 getFileTime() {
+	FILETIME fileTime;
+	GetSystemTimeAsFileTime(&fileTime);
+	return (static_cast<__int64>(fileTime.dwHighDateTime) << 32) | fileTime.dwLowDateTime;
+}
+
+
+bool entryTimeLess(const Entry& lhs, const Entry& rhs) {
+	return lhs.time < rhs.time;
+}
+} // namespace
+
+
+
+struct AsyncLogger::Impl {
+	Impl(AsyncLogger* owner, StringRange filePath, OverflowPolicy overflowPolicy, int bufferSize, __int64 maxFileSize, int maxFileCount)
+		: owner(owner)
+		, id(nextLoggerId++)
+		, filePath(filePath)
+		, overflowPolicy(overflowPolicy)
+		, bufferSize(bufferSize)
+		, maxFileSize(maxFileSize)
+		, maxFileCount(maxFileCount)
+		, sampleInterval(16)
+		, droppedCount(0)
+		, waiting(0)
+		, wakeRequested(false)
+		, exit(false)
+		, flushRequested(0)
+		, flushCompleted(0)
+		, workerThreadId(0)
+		, workerLineStart(true)
+		, fileLength(0)
+		, charset(Charset::default())
+		, worker([this] () { run(); }) {
+	}
+
+	~Impl() {
+		{
+			mutex::scoped_lock lock(guard);
+			exit = true;
+			condition.notify_all();
+		}
+		worker.join();
+	}
+
+	/// 現在のスレッドのリングを返す。初めて書き込むスレッドならリングを作成する。
+	Ring* currentRing() {
+		if (cachedLoggerId == id) {
+			return static_cast<Ring*>(cachedRing);
+		}
+		const DWORD threadId = GetCurrentThreadId();
+		Ring* ring = nullptr;
+		mutex::scoped_lock lock(guard);
+		for (auto i = rings.begin(), end = rings.end(); i != end; ++i) {
+			if ((*i)->threadId == threadId) {
+				ring = i->get();
+				break;
+			}
+		}
+		if (!ring) {
+			HANDLE thread = nullptr;
+			verify(DuplicateHandle(GetCurrentProcess(), GetCurrentThread(), GetCurrentProcess(), &thread, SYNCHRONIZE, FALSE, 0));
+			rings.push_back(unique_ptr<Ring>(new Ring(bufferSize, threadId, thread)));
+			ring = rings.back().get();
+		}
+		cachedLoggerId = id;
+		cachedRing = ring;
+		return ring;
+	}
+
+	/// メッセージを現在のスレッドのリングにコピーする。
+	void push(const void* message, int size, unsigned int flags) {
+		const __int64 time = getFileTime();
+		if (GetCurrentThreadId() == workerThreadId.load(std::memory_order_relaxed)) { // onWrite のリスナーが書き込んだ。自分のリングが空くのを待つと戻ってこられない
+			defer(time, message, size, flags);
+			return;
+		}
+		Ring* const ring = currentRing();
+		const int maxSize = bufferSize / 2 - static_cast<int>(sizeof(Header));
+		if (maxSize < size) {
+			size = (flags & wideFlag) ? maxSize & ~1 : maxSize;
+		}
+		const unsigned int need = alignRecord(sizeof(Header) + size);
+		for (;;) {
+			const unsigned int head = ring->head.load(std::memory_order_relaxed);
+			const unsigned int offset = head & (ring->capacity - 1);
+			const unsigned int contiguous = ring->capacity - offset;
+			const unsigned int total = need <= contiguous ? need : contiguous + need;
+			if (total <= ring->capacity - (head - ring->tail.load(std::memory_order_acquire))) {
+				unsigned char* buffer = ring->buffer.data();
+				unsigned int start = offset;
+				if (contiguous < need) { // 末尾に入らないので先頭に戻る
+					reinterpret_cast<Header*>(buffer + offset)->size = wrapMarker;
+					start = 0;
+				}
+				Header* const header = reinterpret_cast<Header*>(buffer + start);
+				header->size = size;
+				header->flags = flags;
+				header->time = time;
+				std::memcpy(buffer + start + sizeof(Header), message, size);
+				ring->head.store(head + total, std::memory_order_release);
+				return;
+			}
+			if (!waitForSpace(ring, total)) {
+				ring->dropped.fetch_add(1, std::memory_order_relaxed);
+				droppedCount.fetch_add(1, std::memory_order_relaxed);
+				return;
+			}
+		}
+	}
+
+	/// OverflowPolicy に従ってリングに total バイトの空きができるまで待つ。捨てる場合は false を返す。
+	bool waitForSpace(Ring* ring, unsigned int total) {
+		switch (overflowPolicy) {
+			case OverflowPolicy::drop   : return false;
+			case OverflowPolicy::block  : break;
+			case OverflowPolicy::sample : {
+				if (++ring->overflowCount % sampleInterval.load(std::memory_order_relaxed)) {
+					return false;
+				}
+			} break;
+		}
+		mutex::scoped_lock lock(guard);
+		++waiting;
+		wakeRequested = true;
+		condition.notify_all();
+		while (ring->capacity - (ring->head.load(std::memory_order_relaxed) - ring->tail.load()) < total) {
+			drained.wait(lock);
+		}
+		--waiting;
+		return true;
+	}
+
+	/// 出力スレッドが書き込んだメッセージを次の出力まで取っておく。
+	void defer(__int64 time, const void* message, int size, unsigned int flags) {
+		Deferred entry;
+		entry.time = time;
+		entry.flags = flags;
+		if (flags & wideFlag) {
+			entry.message = charset.encode(StringRange(static_cast<const wchar_t*>(message), size / static_cast<int>(sizeof(wchar_t))));
+		} else {
+			entry.message.assign(static_cast<const char*>(message), size);
+		}
+		deferred.push_back(move(entry));
+	}
+
+	/// 出力スレッド。
+	void run() {
+		workerThreadId.store(GetCurrentThreadId());
+		vector<Ring*> current;
+		for (;;) {
+			unsigned __int64 ticket = 0;
+			bool exiting = false;
+			{
+				mutex::scoped_lock lock(guard);
+				if (!wakeRequested && !exit && flushRequested == flushCompleted) {
+					condition.timed_wait(lock, boost::posix_time::milliseconds(flushInterval));
+				}
+				wakeRequested = false;
+				ticket = flushRequested;
+				exiting = exit;
+				current.clear();
+				for (auto i = rings.begin(), end = rings.end(); i != end; ++i) {
+					current.push_back(i->get());
+				}
+			}
+
+			for (auto i = current.begin(), end = current.end(); i != end; ++i) {
+				drain(**i);
+			}
+			for (int pass = 0; pass < (exiting ? 2 : 1); ++pass) { // 終了する時はリスナーが最後に書き込んだメッセージも出力する
+				for (auto i = deferred.begin(), end = deferred.end(); i != end; ++i) {
+					addEntry(workerThreadId.load(), workerLineStart, i->time, i->flags, i->message.c_str(), static_cast<int>(i->message.length()));
+				}
+				deferred.clear();
+				try {
+					output();
+				} catch (...) {
+					file = FileStream();
+					mutex::scoped_lock lock(guard);
+					error = std::current_exception();
+				}
+				entries.clear();
+				payload.clear();
+			}
+
+			{
+				mutex::scoped_lock lock(guard);
+				flushCompleted = ticket;
+				for (auto i = rings.begin(); i != rings.end(); ) { // 終了したスレッドの空のリングを片付ける
+					Ring& ring = **i;
+					if (ring.head.load() == ring.tail.load() && !ring.dropped.load() && WaitForSingleObject(ring.thread, 0) == WAIT_OBJECT_0) {
+						i = rings.erase(i);
+					} else {
+						++i;
+					}
+				}
+				drained.notify_all();
+			}
+			if (exiting) {
+				break;
+			}
+		}
+	}
+
+	/// リングのメッセージを置き場に移してリングを空ける。
+	void drain(Ring& ring) {
+		const unsigned int head = ring.head.load(std::memory_order_acquire);
+		unsigned int tail = ring.tail.load(std::memory_order_relaxed);
+		const unsigned char* const buffer = ring.buffer.data();
+		while (tail != head) {
+			const unsigned int offset = tail & (ring.capacity - 1);
+			const Header& header = *reinterpret_cast<const Header*>(buffer + offset);
+			if (header.size == wrapMarker) {
+				tail += ring.capacity - offset;
+				continue;
+			}
+			const char* const message = reinterpret_cast<const char*>(buffer + offset + sizeof(Header));
+			if (header.flags & wideFlag) {
+				const string encoded = charset.encode(StringRange(reinterpret_cast<const wchar_t*>(message), static_cast<int>(header.size / sizeof(wchar_t))));
+				addEntry(ring.threadId, ring.lineStart, header.time, header.flags, encoded.c_str(), static_cast<int>(encoded.length()));
+			} else {
+				addEntry(ring.threadId, ring.lineStart, header.time, header.flags, message, header.size);
+			}
+			tail += alignRecord(sizeof(Header) + header.size);
+		}
+		ring.tail.store(tail);
+		if (waiting.load()) {
+			mutex::scoped_lock lock(guard);
+			drained.notify_all();
+		}
+
+		const unsigned int dropped = ring.dropped.exchange(0);
+		if (dropped) {
+			char message[64];
+			const int length = sprintf_s(message, "%u messages dropped", dropped);
+			addEntry(ring.threadId, ring.lineStart, getFileTime(), lineFlag, message, length);
+		}
+	}
+
+	void addEntry(DWORD threadId, bool& lineStart, __int64 time, unsigned int flags, const char* message, int length) {
+		Entry entry;
+		entry.time = time;
+		entry.threadId = threadId;
+		entry.flags = flags;
+		entry.offset = static_cast<int>(payload.size());
+		entry.length = length;
+		entry.lineStart = lineStart;
+		entries.push_back(entry);
+		payload.insert(payload.end(), message, message + length);
+		payload.push_back('\0');
+		lineStart = (flags & lineFlag) || (length && message[length - 1] == '\n');
+	}
+
+	/// 置き場のメッセージを時刻順に並べてまとめて出力する。
+	void output() {
+		if (entries.empty()) {
+			return;
+		}
+		std::stable_sort(entries.begin(), entries.end(), entryTimeLess);
+
+		text.clear();
+		lines.clear();
+		for (auto i = entries.begin(), end = entries.end(); i != end; ++i) {
+			const char* const message = payload.data() + i->offset;
+			text.append(message, i->length);
+			if (i->flags & lineFlag) {
+				text += '\n';
+			}
+			if (filePath.empty()) {
+				continue;
+			}
+			if (i->lineStart) {
+				ULARGE_INTEGER time;
+				time.QuadPart = i->time;
+				FILETIME utc;
+				utc.dwLowDateTime = time.LowPart;
+				utc.dwHighDateTime = time.HighPart;
+				FILETIME local;
+				SYSTEMTIME system;
+				verify(FileTimeToLocalFileTime(&utc, &local));
+				verify(FileTimeToSystemTime(&local, &system));
+				char prefix[64];
+				const int length = sprintf_s(prefix, "%04d-%02d-%02d %02d:%02d:%02d.%03d [%u] "
+					, system.wYear, system.wMonth, system.wDay, system.wHour, system.wMinute, system.wSecond, system.wMilliseconds, i->threadId);
+				lines.append(prefix, length);
+			}
+			lines.append(message, i->length);
+			if (i->flags & lineFlag) {
+				lines += "\r\n";
+			}
+		}
+
+		OutputDebugStringA(text.c_str());
+		if (Debug::asyncLogger() == owner) {
+			Listener<ByteStringRange>& onWrite = Debug::onWrite();
+			if (onWrite) {
+				for (auto i = entries.begin(), end = entries.end(); i != end; ++i) {
+					onWrite(ByteStringRange(payload.data() + i->offset, i->length));
+					if (i->flags & lineFlag) {
+						onWrite("\n");
+					}
+				}
+			}
+		}
+		if (!lines.empty()) {
+			writeFile(lines.data(), static_cast<int>(lines.length()));
+		}
+	}
+
+	/// ファイルに書き込む。maxFileSize を超えるならファイルを切り替える。
+	void writeFile(const char* data, int size) {
+		if (!file) {
+			file = FileStream(filePath, FileStream::Mode::append, FileStream::Access::write, FileStream::Share::read);
+			fileLength = file.length();
+		}
+		if (fileLength && maxFileSize < fileLength + size) {
+			file = FileStream();
+			rotate();
+			file = FileStream(filePath, FileStream::Mode::append, FileStream::Access::write, FileStream::Share::read);
+			fileLength = 0;
+		}
+		file.write(data, 0, size);
+		fileLength += size;
+	}
+
+	/// filePath.(n) を filePath.(n + 1) にずらして、maxFileCount 個を超えるファイルを削除する。
+	void rotate() {
+		File oldest(String() + filePath + L"." + (maxFileCount - 1));
+		if (maxFileCount == 1) {
+			oldest.path(filePath);
+		}
+		if (oldest.exists()) {
+			oldest.remove();
+		}
+		for (int i = maxFileCount - 2; 0 <= i; --i) {
+			File source(i ? String() + filePath + L"." + i : filePath);
+			if (source.exists()) {
+				source.moveTo(String() + filePath + L"." + (i + 1));
+			}
+		}
+	}
+
+	AsyncLogger* const owner;
+	const unsigned int id;
+	const String filePath;
+	const OverflowPolicy overflowPolicy;
+	const int bufferSize;
+	const __int64 maxFileSize;
+	const int maxFileCount;
+	atomic<int> sampleInterval;
+	atomic<__int64> droppedCount;
+	atomic<int> waiting; // リングが空くのを待っているスレッドの数
+
+	mutex guard;
+	condition_variable condition; // 出力スレッドを起こす
+	condition_variable drained; // 出力スレッドがリングを読み出した
+	vector<unique_ptr<Ring> > rings;
+	bool wakeRequested;
+	bool exit;
+	unsigned __int64 flushRequested;
+	unsigned __int64 flushCompleted;
+	exception_ptr error;
+	atomic<DWORD> workerThreadId;
+
+	// 以下は出力スレッドだけが使う
+	vector<Deferred> deferred;
+	bool workerLineStart;
+	vector<Entry> entries;
+	vector<char> payload;
+	string text;
+	string lines;
+	FileStream file;
+	__int64 fileLength;
+	Charset charset;
+
+	thread worker; // 他のメンバーを初期化してから開始する
+};
+
+
+
+bool AsyncLogger::OverflowPolicy::_validate(OverflowPolicy value) {
+	return drop <= value && value <= sample;
+}
+
+
+
+AsyncLogger::AsyncLogger(StringRange filePath, AsyncLogger::OverflowPolicy overflowPolicy, int bufferSize, __int64 maxFileSize, int maxFileCount) {
+	assert("Invalid AsyncLogger::OverflowPolicy" && OverflowPolicy::_validate(overflowPolicy));
+	assert("bufferSize out of range" && 64 <= bufferSize);
+	assert("bufferSize out of range" && bufferSize <= 0x40000000);
+	assert("maxFileSize out of range" && 0 < maxFileSize);
+	assert("maxFileCount out of range" && 0 < maxFileCount);
+
+	int capacity = 64;
+	while (capacity < bufferSize) {
+		capacity *= 2;
+	}
+	_impl.reset(new Impl(this, filePath, overflowPolicy, capacity, maxFileSize, maxFileCount));
+}
+
+
+AsyncLogger::~AsyncLogger() {
+	if (Debug::asyncLogger() == this) { // onWrite イベントを呼んでから解除する
+		try {
+			flush();
+		} catch (...) {
+		}
+		Debug::asyncLogger(nullptr);
+	}
+}
+
+
+int AsyncLogger::bufferSize() const {
+	return _impl->bufferSize;
+}
+
+
+__int64 AsyncLogger::droppedCount() const {
+	return _impl->droppedCount.load();
+}
+
+
+const wchar_t* AsyncLogger::filePath() const {
+	return _impl->filePath.c_str();
+}
+
+
+void AsyncLogger::flush() {
+	Impl& impl = *_impl;
+	mutex::scoped_lock lock(impl.guard);
+	const unsigned __int64 ticket = ++impl.flushRequested;
+	impl.condition.notify_all();
+	while (impl.flushCompleted < ticket) {
+		impl.drained.wait(lock);
+	}
+	if (impl.error) {
+		exception_ptr error = impl.error;
+		impl.error = exception_ptr();
+		std::rethrow_exception(error);
+	}
+}
+
+
+__int64 AsyncLogger::maxFileSize() const {
+	return _impl->maxFileSize;
+}
+
+
+int AsyncLogger::maxFileCount() const {
+	return _impl->maxFileCount;
+}
+
+
+AsyncLogger::OverflowPolicy AsyncLogger::overflowPolicy() const {
+	return _impl->overflowPolicy;
+}
+
+
+int AsyncLogger::sampleInterval() const {
+	return _impl->sampleInterval.load();
+}
+
+
+void AsyncLogger::sampleInterval(int value) {
+	assert("sampleInterval out of range" && 0 < value);
+	_impl->sampleInterval.store(value);
+}
+
+
+void AsyncLogger::write(ByteStringRange message) {
+	_impl->push(message.c_str(), message.length(), 0);
+}
+
+
+void AsyncLogger::write(StringRange message) {
+	_impl->push(message.c_str(), message.length() * static_cast<int>(sizeof(wchar_t)), wideFlag);
+}
+
+
+void AsyncLogger::writeLine(ByteStringRange message) {
+	_impl->push(message.c_str(), message.length(), lineFlag);
+}
+
+
+void AsyncLogger::writeLine(StringRange message) {
+	_impl->push(message.c_str(), message.length() * static_cast<int>(sizeof(wchar_t)), wideFlag | lineFlag);
+}
+
+
+
+	}
+}
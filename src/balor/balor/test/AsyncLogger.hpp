@@ -0,0 +1,89 @@
+﻿#pragma once
+
+#include <memory>
+
+#include <balor/Enum.hpp>
+#include <balor/NonCopyable.hpp>
+#include <balor/StringRange.hpp>
+
+
+namespace balor {
+	namespace test {
+
+
+
+/**
+ * 書き込んだメッセージを別のスレッドでまとめてファイルとデバッグ出力に書き出すロガー。
+ *
+ * 書き込むスレッドごとにロックしないリングバッファを持ち、write 関数はメッセージと時刻をリングにコピーするだけで戻る。
+ * スレッドは一定時間ごとか flush 関数が呼ばれた時に全てのリングを読み出し、時刻順に並べて書式化してから、ファイルへは一度の書き込み、デバッグ出力へは一度の OutputDebugString でまとめて出力する。
+ * ファイルの各行の先頭には「2013-01-23 12:34:56.789 [スレッドID] 」の形式で書き込んだ時刻とスレッドを付ける。Unicode のメッセージはシステムの既定の文字コードに変換する。
+ * ファイルが maxFileSize バイトを超える時は filePath.1, filePath.2 … と名前をずらして新しいファイルに切り替え、maxFileCount 個を超えた古いファイルは削除する。
+ * リングが一杯の時の動作は OverflowPolicy で選ぶ。捨てたメッセージの数はファイルにも出力する。
+ * Debug::asyncLogger 関数で設定すると Debug::write と Debug::writeLine の出力を引き受ける。onWrite イベントのリスナーが書き込んだメッセージはリングを通さずに次の出力に回すので、リングが一杯でも待たない。
+ * ファイルへの書き込みで発生した例外は次の flush 関数で投げ直す。
+ * デストラクタはそれまでに書き込んだメッセージを全て出力してからスレッドを止める。破棄するまでに他のスレッドからの書き込みを終えておくこと。
+ *
+ * <h3>・サンプルコード</h3>
+ * <pre><code>
+	AsyncLogger logger(L"application.log", AsyncLogger::OverflowPolicy::block);
+	Debug::asyncLogger(&logger);
+	Debug::writeLine(L"started"); // 呼んだスレッドではコピーするだけ
+	...
+	Debug::asyncLogger(nullptr);
+ * </code></pre>
+ */
+class AsyncLogger : private NonCopyable {
+public:
+	/// リングが一杯の時の動作。
+	struct OverflowPolicy {
+		enum _enum {
+			drop   = 0, /// メッセージを捨てる。
+			block  = 1, /// リングが空くまで待つ。
+			sample = 2, /// sampleInterval 回に一回だけリングが空くまで待ち、それ以外は捨てる。
+		};
+		BALOR_NAMED_ENUM_MEMBERS(OverflowPolicy);
+	};
+
+public:
+	/// 出力するファイルパス、リングが一杯の時の動作、スレッドごとのリングのバイト数、ファイルを切り替えるバイト数と残すファイルの数から作成してスレッドを開始する。
+	/// filePath が空文字列ならデバッグ出力だけ行う。bufferSize は２の累乗に切り上げる。一つのメッセージは bufferSize の半分を超える部分を切り捨てる。
+	explicit AsyncLogger(StringRange filePath = L"", AsyncLogger::OverflowPolicy overflowPolicy = OverflowPolicy::drop, int bufferSize = 64 * 1024, __int64 maxFileSize = 16 * 1024 * 1024, int maxFileCount = 4);
+	/// 書き込んだメッセージを全て出力してからスレッドを止める。Debug::asyncLogger に設定されていれば解除する。
+	~AsyncLogger();
+
+public:
+	/// スレッドごとのリングのバイト数。
+	int bufferSize() const;
+	/// リングが一杯で捨てたメッセージの数。
+	__int64 droppedCount() const;
+	/// 出力するファイルパス。
+	const wchar_t* filePath() const;
+	/// 呼ぶ前に書き込んだメッセージを全て出力するまで待つ。ファイルへの書き込みで例外が発生していれば投げ直す。
+	void flush();
+	/// ファイルを切り替えるバイト数。
+	__int64 maxFileSize() const;
+	/// 残すファイルの数。
+	int maxFileCount() const;
+	/// リングが一杯の時の動作。
+	AsyncLogger::OverflowPolicy overflowPolicy() const;
+	/// OverflowPolicy::sample で待つ間隔。初期値は 16。
+	int sampleInterval() const;
+	void sampleInterval(int value);
+	/// メッセージを書き込む。
+	void write(ByteStringRange message);
+	void write(StringRange message);
+	/// 改行を追加してメッセージを書き込む。
+	void writeLine(ByteStringRange message);
+	void writeLine(StringRange message);
+
+private:
+	struct Impl;
+
+	std::unique_ptr<Impl> _impl;
+};
+
+
+
+	}
+}
@@ -0,0 +1,613 @@
+﻿#include "Benchmark.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <regex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <balor/io/Stream.hpp>
+#include <balor/system/clock.hpp>
+#include <balor/test/Debug.hpp>
+#include <balor/test/verify.hpp>
+#include <balor/Singleton.hpp>
+
+#include <crtdbg.h>
+
+
+namespace balor {
+	namespace test {
+
+using std::atomic;
+using std::map;
+using std::string;
+using std::vector;
+using system::detail::getTicks;
+using system::detail::getTicksPerSecond;
+
+
+namespace {
+struct Registered {
+	Registered() : function(nullptr), functionName(nullptr) {}
+	Registered(Benchmark::Function function, const char* functionName, const int* sizes, int sizeCount)
+		: function(function), functionName(functionName), sizes(sizes, sizes + sizeCount) {}
+
+	Benchmark::Function function;
+	const char* functionName;
+	vector<int> sizes;
+};
+
+
+class GlobalBenchmarks {
+	friend Singleton<GlobalBenchmarks>;
+
+	GlobalBenchmarks() {}
+	~GlobalBenchmarks() {}
+
+public:
+	map<string, map<int, Registered> > functionMap;
+};
+
+
+atomic<bool>& getMeasuring() {
+	static atomic<bool> measuring(false);
+	return measuring;
+}
+
+
+atomic<__int64>& getAllocationCount() {
+	static atomic<__int64> allocationCount(0);
+	return allocationCount;
+}
+
+
+atomic<__int64>& getAllocationBytes() {
+	static atomic<__int64> allocationBytes(0);
+	return allocationBytes;
+}
+
+
+// マルチスレッドになるまえに初期化されることを保証する
+atomic<bool>& measuring = getMeasuring();
+atomic<__int64>& allocationCount = getAllocationCount();
+atomic<__int64>& allocationBytes = getAllocationBytes();
+const volatile void* volatile escapedAddress = nullptr;
+
+
+#if defined(_DEBUG)
+_CRT_ALLOC_HOOK previousAllocHook = nullptr;
+
+
+int __cdecl allocHook(int allocType, void* userData, size_t size, int blockType, long requestNumber, const unsigned char* fileName, int lineNumber) {
+	if ((allocType == _HOOK_ALLOC || allocType == _HOOK_REALLOC) && blockType != _CRT_BLOCK) { // CRT 内部の割り当ては数えない
+		Benchmark::countAllocation(size);
+	}
+	return previousAllocHook ? previousAllocHook(allocType, userData, size, blockType, requestNumber, fileName, lineNumber) : TRUE;
+}
+#endif
+
+
+/// 昇順に並べたサンプルの percent パーセンタイル（最も近い順位）。
+double percentile(const vector<double>& sorted, double percent) {
+	const int rank = static_cast<int>(std::ceil(percent / 100 * sorted.size()));
+	return sorted[std::max(rank, 1) - 1];
+}
+
+
+void appendNumber(string& text, double value) {
+	char buffer[64];
+	const int length = sprintf_s(buffer, sizeof(buffer), "%.3f", value);
+	text.append(buffer, length);
+}
+
+
+void appendNumber(string& text, __int64 value) {
+	char buffer[32];
+	const int length = sprintf_s(buffer, sizeof(buffer), "%lld", static_cast<long long>(value));
+	text.append(buffer, length);
+}
+
+
+void appendJsonString(string& text, const string& value) {
+	text += '"';
+	for (auto i = value.begin(), end = value.end(); i != end; ++i) {
+		if (*i == '"' || *i == '\\') {
+			text += '\\';
+		}
+		text += *i;
+	}
+	text += '"';
+}
+
+
+/// writeJson 関数の出力を読む為の JSON パーサ。オブジェクト、配列、文字列、数値、true, false, null を読める。
+class JsonReader {
+public:
+	JsonReader(const string& text) : _current(text.c_str()), _end(text.c_str() + text.length()) {}
+
+	bool atEnd() {
+		skipSpaces();
+		return _current == _end;
+	}
+
+	/// 次の文字が c なら読み飛ばして true を返す。
+	bool accept(char c) {
+		skipSpaces();
+		if (_current != _end && *_current == c) {
+			++_current;
+			return true;
+		}
+		return false;
+	}
+
+	void expect(char c) {
+		if (!accept(c)) {
+			throw Benchmark::FormatException();
+		}
+	}
+
+	string readString() {
+		expect('"');
+		string result;
+		for (;;) {
+			if (_current == _end) {
+				throw Benchmark::FormatException();
+			}
+			const char c = *_current++;
+			if (c == '"') {
+				return result;
+			}
+			if (c == '\\') {
+				if (_current == _end) {
+					throw Benchmark::FormatException();
+				}
+				const char escaped = *_current++;
+				switch (escaped) {
+					case 'n' : result += '\n'; break;
+					case 'r' : result += '\r'; break;
+					case 't' : result += '\t'; break;
+					case 'u' : { // 名前に制御文字は含めないので ASCII の範囲だけ扱う
+						if (_end - _current < 4) {
+							throw Benchmark::FormatException();
+						}
+						result += static_cast<char>(std::strtol(string(_current, _current + 4).c_str(), nullptr, 16));
+						_current += 4;
+					} break;
+					default : result += escaped; break;
+				}
+			} else {
+				result += c;
+			}
+		}
+	}
+
+	double readNumber() {
+		skipSpaces();
+		const string number(_current, std::min(_end, _current + 64));
+		char* numberEnd = nullptr;
+		const double result = std::strtod(number.c_str(), &numberEnd);
+		if (numberEnd == number.c_str()) {
+			throw Benchmark::FormatException();
+		}
+		_current += numberEnd - number.c_str();
+		return result;
+	}
+
+	/// 値を読み飛ばす。
+	void skipValue() {
+		skipSpaces();
+		if (_current != _end && *_current == '"') {
+			readString();
+		} else if (accept('{')) {
+			if (!accept('}')) {
+				do {
+					readString();
+					expect(':');
+					skipValue();
+				} while (accept(','));
+				expect('}');
+			}
+		} else if (accept('[')) {
+			if (!accept(']')) {
+				do {
+					skipValue();
+				} while (accept(','));
+				expect(']');
+			}
+		} else if (acceptWord("true") || acceptWord("false") || acceptWord("null")) {
+		} else {
+			readNumber();
+		}
+	}
+
+private:
+	bool acceptWord(const char* word) {
+		const int length = static_cast<int>(std::strlen(word));
+		if (length <= _end - _current && std::equal(word, word + length, _current)) {
+			_current += length;
+			return true;
+		}
+		return false;
+	}
+
+	void skipSpaces() {
+		while (_current != _end && (*_current == ' ' || *_current == '\t' || *_current == '\r' || *_current == '\n')) {
+			++_current;
+		}
+	}
+
+	const char* _current;
+	const char* _end;
+};
+} // namespace
+
+
+
+Benchmark::FunctionRegister::FunctionRegister(Benchmark::Function function, const char* functionName, const char* fileName, int line) {
+	Benchmark::registerBenchmark(function, functionName, fileName, line);
+}
+
+
+
+Benchmark::Result::Result()
+	: size(-1)
+	, iterationCount(0)
+	, sampleCount(0)
+	, rejectedCount(0)
+	, mean(0)
+	, median(0)
+	, p99(0)
+	, min(0)
+	, max(0)
+	, standardDeviation(0)
+	, allocationCount(0)
+	, allocationBytes(0) {
+}
+
+
+
+Benchmark::Comparison::Comparison() : size(-1), baseline(0), current(0), ratio(0), regressed(false) {
+}
+
+
+
+Benchmark::Benchmark(int size, __int64 iterationCount)
+	: _size(size)
+	, _iterationCount(iterationCount)
+	, _remainingCount(0)
+	, _started(false)
+	, _finished(false)
+	, _startTime(0)
+	, _endTime(0)
+	, _allocationCount(0)
+	, _allocationBytes(0) {
+}
+
+
+void Benchmark::countAllocation(std::size_t size) {
+	if (measuring.load(std::memory_order_relaxed)) {
+		allocationCount.fetch_add(1, std::memory_order_relaxed);
+		allocationBytes.fetch_add(static_cast<__int64>(size), std::memory_order_relaxed);
+	}
+}
+
+
+vector<Benchmark::Comparison> Benchmark::compare(const vector<Result>& baseline, const vector<Result>& current, double threshold) {
+	assert("Negative threshold" && 0 <= threshold);
+
+	vector<Comparison> results;
+	for (auto i = current.begin(), end = current.end(); i != end; ++i) {
+		for (auto j = baseline.begin(), jend = baseline.end(); j != jend; ++j) {
+			if (j->name == i->name && j->size == i->size) {
+				Comparison comparison;
+				comparison.name = i->name;
+				comparison.size = i->size;
+				comparison.baseline = j->median;
+				comparison.current = i->median;
+				comparison.ratio = 0 < j->median ? i->median / j->median : 1;
+				comparison.regressed = 1 + threshold < comparison.ratio;
+				results.push_back(comparison);
+				break;
+			}
+		}
+	}
+	return results;
+}
+
+
+void Benchmark::escape(const volatile void* address) {
+	escapedAddress = address;
+	if (address) {
+		*static_cast<const volatile char*>(address); // 少なくとも先頭のバイトはメモリに書き込まれている必要がある
+	}
+}
+
+
+bool Benchmark::next() {
+	if (!_started) {
+		_started = true;
+		_remainingCount = _iterationCount - 1;
+		const __int64 count = allocationCount.load(std::memory_order_relaxed);
+		const __int64 bytes = allocationBytes.load(std::memory_order_relaxed);
+		_allocationCount = count;
+		_allocationBytes = bytes;
+		_startTime = getTicks(); // 割り当ての記録は計測に含めない
+		return 0 < _iterationCount;
+	}
+	if (!_finished) {
+		_endTime = getTicks();
+		_finished = true;
+		_allocationCount = allocationCount.load(std::memory_order_relaxed) - _allocationCount;
+		_allocationBytes = allocationBytes.load(std::memory_order_relaxed) - _allocationBytes;
+	}
+	return false;
+}
+
+
+vector<Benchmark::Result> Benchmark::readJson(io::Stream& stream) {
+	const int length = static_cast<int>(stream.length() - stream.position());
+	string text(length, '\0');
+	int total = 0;
+	while (total < length) {
+		const int readCount = stream.read(&text[0], total, length - total);
+		if (!readCount) {
+			break;
+		}
+		total += readCount;
+	}
+	text.resize(total);
+
+	vector<Result> results;
+	JsonReader reader(text);
+	reader.expect('{');
+	if (!reader.accept('}')) {
+		do {
+			const string key = reader.readString();
+			reader.expect(':');
+			if (key != "benchmarks") {
+				reader.skipValue();
+				continue;
+			}
+			reader.expect('[');
+			if (reader.accept(']')) {
+				continue;
+			}
+			do {
+				Result result;
+				reader.expect('{');
+				if (!reader.accept('}')) {
+					do {
+						const string name = reader.readString();
+						reader.expect(':');
+						if (name == "name") {
+							result.name = reader.readString();
+						} else if (name == "size") {
+							result.size = static_cast<int>(reader.readNumber());
+						} else if (name == "iterations") {
+							result.iterationCount = static_cast<__int64>(reader.readNumber());
+						} else if (name == "samples") {
+							result.sampleCount = static_cast<int>(reader.readNumber());
+						} else if (name == "rejected") {
+							result.rejectedCount = static_cast<int>(reader.readNumber());
+						} else if (name == "mean") {
+							result.mean = reader.readNumber();
+						} else if (name == "median") {
+							result.median = reader.readNumber();
+						} else if (name == "p99") {
+							result.p99 = reader.readNumber();
+						} else if (name == "min") {
+							result.min = reader.readNumber();
+						} else if (name == "max") {
+							result.max = reader.readNumber();
+						} else if (name == "stddev") {
+							result.standardDeviation = reader.readNumber();
+						} else if (name == "allocations") {
+							result.allocationCount = reader.readNumber();
+						} else if (name == "allocatedBytes") {
+							result.allocationBytes = reader.readNumber();
+						} else {
+							reader.skipValue();
+						}
+					} while (reader.accept(','));
+					reader.expect('}');
+				}
+				results.push_back(result);
+			} while (reader.accept(','));
+			reader.expect(']');
+		} while (reader.accept(','));
+		reader.expect('}');
+	}
+	if (!reader.atEnd()) {
+		throw FormatException();
+	}
+	return results;
+}
+
+
+void Benchmark::registerBenchmark(Benchmark::Function function, const char* functionName, const char* fileName, int line, const int* sizes, int sizeCount) {
+	assert("Null function" && function);
+	assert("Null functionName" && functionName);
+	assert("Negative sizeCount" && 0 <= sizeCount);
+	assert("Null sizes" && (sizes || !sizeCount));
+
+	Singleton<GlobalBenchmarks>::get().functionMap[fileName][line] = Registered(function, functionName, sizes, sizeCount);
+}
+
+
+vector<Benchmark::Result> Benchmark::run(const char* pattern, int sampleCount, double sampleTime, double warmupTime) {
+	assert("Invalid sampleCount" && 0 < sampleCount);
+	assert("Invalid sampleTime" && 0 < sampleTime);
+	assert("Negative warmupTime" && 0 <= warmupTime);
+
+	GlobalBenchmarks& global = Singleton<GlobalBenchmarks>::get();
+	const bool hasPattern = pattern && *pattern != '\0';
+	std::regex regexPattern;
+	if (hasPattern) {
+		regexPattern = std::regex(pattern, std::regex::icase);
+	}
+	const double ticksPerSecond = getTicksPerSecond();
+#if defined(_DEBUG)
+	previousAllocHook = _CrtSetAllocHook(allocHook);
+#endif
+
+	vector<Result> results;
+	try {
+		for (auto i = global.functionMap.begin(), end = global.functionMap.end(); i != end; ++i) {
+			for (auto j = i->second.begin(), jend = i->second.end(); j != jend; ++j) {
+				const Registered& registered = j->second;
+				if (hasPattern && !std::regex_search(i->first, regexPattern) && !std::regex_search(registered.functionName, regexPattern)) {
+					continue;
+				}
+				vector<int> sizes = registered.sizes;
+				if (sizes.empty()) {
+					sizes.push_back(-1);
+				}
+				for (auto size = sizes.begin(), sizeEnd = sizes.end(); size != sizeEnd; ++size) {
+					__int64 sampleAllocationCount = 0;
+					__int64 sampleAllocationBytes = 0;
+					auto measure = [&] (__int64 iterationCount) -> double { // 一回の計測にかかった秒数
+						Benchmark benchmark(*size, iterationCount);
+						measuring.store(true, std::memory_order_relaxed);
+						registered.function(benchmark);
+						measuring.store(false, std::memory_order_relaxed);
+						assert("Benchmark function must loop while running() returns true" && benchmark._finished);
+						sampleAllocationCount = benchmark._allocationCount;
+						sampleAllocationBytes = benchmark._allocationBytes;
+						return (benchmark._endTime - benchmark._startTime) / ticksPerSecond;
+					};
+
+					// 一回の計測が sampleTime 秒以上になるまで繰り返し回数を増やす
+					__int64 iterationCount = 1;
+					const double calibrationStart = getTicks() / ticksPerSecond;
+					for (;;) {
+						const double seconds = measure(iterationCount);
+						if (sampleTime <= seconds || 1000000000 <= iterationCount) {
+							break;
+						}
+						const double scale = 0 < seconds ? sampleTime * 1.2 / seconds : 100;
+						iterationCount = std::max(iterationCount + 1, static_cast<__int64>(iterationCount * std::min(scale, 100.0)));
+					}
+					// キャッシュや分岐予測を温める
+					while (getTicks() / ticksPerSecond - calibrationStart < warmupTime) {
+						measure(iterationCount);
+					}
+
+					Result result;
+					result.name = registered.functionName;
+					result.size = *size;
+					result.iterationCount = iterationCount;
+					result.sampleCount = sampleCount;
+					vector<double> samples(sampleCount);
+					__int64 totalAllocationCount = 0;
+					__int64 totalAllocationBytes = 0;
+					for (int k = 0; k < sampleCount; ++k) {
+						samples[k] = measure(iterationCount) * 1000000000 / iterationCount;
+						totalAllocationCount += sampleAllocationCount;
+						totalAllocationBytes += sampleAllocationBytes;
+					}
+					const double totalIterationCount = static_cast<double>(iterationCount) * sampleCount;
+					result.allocationCount = totalAllocationCount / totalIterationCount;
+					result.allocationBytes = totalAllocationBytes / totalIterationCount;
+
+					std::sort(samples.begin(), samples.end());
+					result.min = samples.front();
+					result.max = samples.back();
+					result.median = sampleCount % 2 ? samples[sampleCount / 2] : (samples[sampleCount / 2 - 1] + samples[sampleCount / 2]) / 2;
+					result.p99 = percentile(samples, 99);
+					// 四分位範囲の 1.5 倍を超えて外れたサンプルは割り込みやコンテキストスイッチの影響として除く
+					const double first = percentile(samples, 25);
+					const double third = percentile(samples, 75);
+					const double lower = first - (third - first) * 1.5;
+					const double upper = third + (third - first) * 1.5;
+					double sum = 0;
+					int count = 0;
+					for (auto k = samples.begin(), kend = samples.end(); k != kend; ++k) {
+						if (lower <= *k && *k <= upper) {
+							sum += *k;
+							++count;
+						}
+					}
+					result.rejectedCount = sampleCount - count;
+					result.mean = sum / count;
+					double squareSum = 0;
+					for (auto k = samples.begin(), kend = samples.end(); k != kend; ++k) {
+						if (lower <= *k && *k <= upper) {
+							squareSum += (*k - result.mean) * (*k - result.mean);
+						}
+					}
+					result.standardDeviation = std::sqrt(squareSum / count);
+					results.push_back(result);
+
+					char buffer[512];
+					sprintf_s(buffer, sizeof(buffer), "%s%s%s: median %.1f ns, mean %.1f ns, p99 %.1f ns, %.2f allocs, %.1f bytes (%d x %lld, rejected %d)\n"
+						, result.name.c_str(), 0 <= result.size ? "/" : "", 0 <= result.size ? std::to_string(result.size).c_str() : ""
+						, result.median, result.mean, result.p99, result.allocationCount, result.allocationBytes
+						, result.sampleCount, static_cast<long long>(result.iterationCount), result.rejectedCount);
+					Debug::write(buffer);
+				}
+			}
+		}
+	} catch (...) {
+		measuring.store(false, std::memory_order_relaxed);
+#if defined(_DEBUG)
+		_CrtSetAllocHook(previousAllocHook);
+#endif
+		throw;
+	}
+#if defined(_DEBUG)
+	_CrtSetAllocHook(previousAllocHook);
+#endif
+	return results;
+}
+
+
+int Benchmark::size() const {
+	return _size;
+}
+
+
+void Benchmark::writeJson(io::Stream& stream, const vector<Result>& results) {
+	string text = "{\"benchmarks\":[";
+	for (auto i = results.begin(), end = results.end(); i != end; ++i) {
+		text += i == results.begin() ? "\r\n" : ",\r\n";
+		text += "{\"name\":";
+		appendJsonString(text, i->name);
+		text += ",\"size\":";
+		appendNumber(text, static_cast<__int64>(i->size));
+		text += ",\"iterations\":";
+		appendNumber(text, i->iterationCount);
+		text += ",\"samples\":";
+		appendNumber(text, static_cast<__int64>(i->sampleCount));
+		text += ",\"rejected\":";
+		appendNumber(text, static_cast<__int64>(i->rejectedCount));
+		text += ",\"mean\":";
+		appendNumber(text, i->mean);
+		text += ",\"median\":";
+		appendNumber(text, i->median);
+		text += ",\"p99\":";
+		appendNumber(text, i->p99);
+		text += ",\"min\":";
+		appendNumber(text, i->min);
+		text += ",\"max\":";
+		appendNumber(text, i->max);
+		text += ",\"stddev\":";
+		appendNumber(text, i->standardDeviation);
+		text += ",\"allocations\":";
+		appendNumber(text, i->allocationCount);
+		text += ",\"allocatedBytes\":";
+		appendNumber(text, i->allocationBytes);
+		text += "}";
+	}
+	text += "\r\n]}\r\n";
+	stream.write(text.data(), 0, static_cast<int>(text.length()));
+}
+
+
+
+	}
+}
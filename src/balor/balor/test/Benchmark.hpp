@@ -0,0 +1,179 @@
+﻿#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include <balor/Exception.hpp>
+#include <balor/NonCopyable.hpp>
+
+namespace balor {
+	namespace io {
+		class Stream;
+	}
+}
+
+
+namespace balor {
+	namespace test {
+
+
+
+/**
+ * マイクロベンチマークを登録して実行する。
+ *
+ * BALOR_BENCHMARK マクロでベンチマーク関数を登録し、関数の中では benchmark.running() が true の間だけ計測したい処理を繰り返す。ループの前の準備は計測に含まれない。
+ * BALOR_BENCHMARK_SIZES マクロはサイズの一覧を指定して登録し、サイズごとに計測する。関数の中では benchmark.size() でサイズを得る。
+ * Benchmark::run() 関数は各ベンチマークについて、一回の計測（サンプル）が sampleTime 秒以上になるように繰り返し回数を調整し、warmupTime 秒の空回しの後に sampleCount 回計測する。
+ * 結果は一回あたりのナノ秒で、中央値、99 パーセンタイル、四分位範囲の 1.5 倍を超えて外れたサンプルを除いた平均値と標準偏差を求め、Debug::write() 関数で出力する。
+ * メモリ割り当ての回数とバイト数も一回あたりで数える。デバッグ版の CRT では _CrtSetAllocHook で自動的に数え、それ以外では置き換えた operator new やアロケータから countAllocation 関数を呼ぶと数える。
+ * writeJson 関数で結果を保存し、次回の実行結果と compare 関数で比較すれば性能の劣化を検出できる。
+ *
+ * <h3>・サンプルコード</h3>
+ * <pre><code>
+	BALOR_BENCHMARK_SIZES(stringBufferAppend, 16, 256, 4096) {
+		const String source(L'a', benchmark.size());
+		while (benchmark.running()) {
+			StringBuffer buffer;
+			buffer += source;
+			Benchmark::doNotOptimize(buffer);
+		}
+	}
+
+	auto results = Benchmark::run();
+	FileStream baseline(L"baseline.json", FileStream::Mode::open);
+	auto comparisons = Benchmark::compare(Benchmark::readJson(baseline), results, 0.1);
+	for (auto i = comparisons.begin(), end = comparisons.end(); i != end; ++i) {
+		if (i->regressed) {
+			... // 中央値が基準より 10% 以上遅くなった
+		}
+	}
+ * </code></pre>
+ */
+class Benchmark : private NonCopyable {
+public:
+	typedef void (*Function)(Benchmark& benchmark);
+
+	/// registerBenchmark を呼ぶためだけのクラス。BALOR_BENCHMARK マクロ内で使われる。
+	class FunctionRegister {
+	public:
+		FunctionRegister(Benchmark::Function function, const char* functionName, const char* fileName, int line);
+		template<int Size> FunctionRegister(Benchmark::Function function, const char* functionName, const char* fileName, int line, const int (&sizes)[Size]) {
+			Benchmark::registerBenchmark(function, functionName, fileName, line, sizes, Size);
+		}
+	};
+
+	/// 一つのベンチマークのサイズごとの計測結果。時間の単位は一回あたりのナノ秒。
+	struct Result {
+		Result();
+
+		/// 関数名。
+		std::string name;
+		/// BALOR_BENCHMARK_SIZES で指定したサイズ。指定していなければ -1。
+		int size;
+		/// 一回のサンプルで繰り返した回数。
+		__int64 iterationCount;
+		/// サンプルの数。
+		int sampleCount;
+		/// 平均値から除いたサンプルの数。
+		int rejectedCount;
+		double mean;
+		double median;
+		double p99;
+		double min;
+		double max;
+		double standardDeviation;
+		/// 一回あたりのメモリ割り当ての回数。
+		double allocationCount;
+		/// 一回あたりに割り当てたバイト数。
+		double allocationBytes;
+	};
+
+	/// 基準の結果との比較。
+	struct Comparison {
+		Comparison();
+
+		std::string name;
+		int size;
+		/// 基準の中央値。
+		double baseline;
+		/// 今回の中央値。
+		double current;
+		/// current / baseline。
+		double ratio;
+		/// ratio が 1 + threshold を超えた。
+		bool regressed;
+	};
+
+	/// readJson 関数で読んだ JSON の形式が正しくない。
+	class FormatException : public Exception {};
+
+public:
+	/// 計測ループの中で数えたメモリ割り当てに追加する。どのスレッドから呼んでも良い。計測中でなければ何もしない。
+	static void countAllocation(std::size_t size);
+	/// 基準の結果と今回の結果を名前とサイズで対応させ、中央値を比較する。中央値が基準の 1 + threshold 倍を超えていれば regressed が true になる。
+	static std::vector<Benchmark::Comparison> compare(const std::vector<Benchmark::Result>& baseline, const std::vector<Benchmark::Result>& current, double threshold = 0.1);
+	/// value の計算結果が使われたことにしてコンパイラの最適化で計算が消されないようにする。
+	template<typename T> static void doNotOptimize(const T& value) {
+		escape(&value);
+	}
+	/// writeJson 関数で書き出した結果を読む。
+	static std::vector<Benchmark::Result> readJson(io::Stream& stream);
+	/// ベンチマーク関数を登録する。BALOR_BENCHMARK マクロ内で使われる。
+	static void registerBenchmark(Benchmark::Function function, const char* functionName, const char* fileName, int line, const int* sizes = nullptr, int sizeCount = 0);
+	/// 名前かファイル名が pattern で示される正規表現に一致するベンチマークを全て実行して結果を返す。
+	static std::vector<Benchmark::Result> run(const char* pattern = "", int sampleCount = 50, double sampleTime = 0.001, double warmupTime = 0.05);
+	/// 結果を UTF-8 の JSON で書き出す。
+	static void writeJson(io::Stream& stream, const std::vector<Benchmark::Result>& results);
+
+public:
+	/// 計測ループを続けるなら true。最初の呼び出しで計測を始め、false を返す時に計測を終える。
+	bool running() {
+		if (0 < _remainingCount) {
+			--_remainingCount;
+			return true;
+		}
+		return next();
+	}
+	/// BALOR_BENCHMARK_SIZES で指定したサイズ。指定していなければ -1。
+	int size() const;
+
+private:
+	Benchmark(int size, __int64 iterationCount);
+
+	static void escape(const volatile void* address);
+	bool next();
+
+	int _size;
+	__int64 _iterationCount;
+	__int64 _remainingCount;
+	bool _started;
+	bool _finished;
+	__int64 _startTime;
+	__int64 _endTime;
+	__int64 _allocationCount;
+	__int64 _allocationBytes;
+};
+
+
+// ベンチマークコードで使用するマクロ関数群。
+
+
+/// ベンチマーク関数を登録しつつ、定義する。関数の引数は ::balor::test::Benchmark& benchmark。
+#define BALOR_BENCHMARK(functionName) \
+void functionName(::balor::test::Benchmark& benchmark);\
+::balor::test::Benchmark::FunctionRegister functionName##BenchmarkRegister(functionName, #functionName, __FILE__, __LINE__);\
+void functionName(::balor::test::Benchmark& benchmark)
+
+
+/// サイズの一覧を指定してベンチマーク関数を登録しつつ、定義する。サイズごとに計測する。
+#define BALOR_BENCHMARK_SIZES(functionName, ...) \
+void functionName(::balor::test::Benchmark& benchmark);\
+const int functionName##BenchmarkSizes[] = {__VA_ARGS__};\
+::balor::test::Benchmark::FunctionRegister functionName##BenchmarkRegister(functionName, #functionName, __FILE__, __LINE__, functionName##BenchmarkSizes);\
+void functionName(::balor::test::Benchmark& benchmark)
+
+
+
+	}
+}
@@ -1,25 +1,28 @@
 ﻿#include "Debug.hpp"
 
+#include <atomic>
 #include <ctime>
+
 #define BOOST_DATE_TIME_NO_LIB
 #define BOOST_THREAD_NO_LIB
-#include <boost/thread/mutex.hpp>
+#include <boost/thread.hpp>
 
 #include <balor/io/File.hpp>
 #include <balor/locale/Charset.hpp>
 #include <balor/system/FileVersionInfo.hpp>
 #include <balor/system/Module.hpp>
 #include <balor/system/windows.hpp>
+#include <balor/test/AsyncLogger.hpp>
+#include <balor/test/StackTrace.hpp>
 #include <balor/test/UnhandledException.hpp>
 #include <balor/test/verify.hpp>
-#include <balor/scopeExit.hpp>
+#include <balor/NonCopyable.hpp>
 #include <balor/Singleton.hpp>
 #include <balor/String.hpp>
 #include <balor/StringBuffer.hpp>
 
 #include <dbghelp.h>
 #pragma comment(lib, "dbghelp.lib")
-#include <tlhelp32.h>
 
 
 namespace balor {
@@ -27,7 +30,6 @@ namespace balor {
 
 
 using std::move;
-using boost::mutex;
 using namespace balor::io;
 using namespace balor::locale;
 using namespace balor::system;
@@ -42,6 +44,9 @@ class Global {
 		message[0] = L'\0';
 		failedMessage[0] = L'\0';
 		showMessageBox = false;
+		asyncLogger = nullptr;
+		asyncLoggerUsers = 0;
+		asyncLoggerWaiters = 0;
 	}
 	~Global() {
 	}
@@ -52,6 +57,45 @@ public:
 	wchar_t failedMessage[128];
 	bool showMessageBox;
 	Listener<ByteStringRange> onWrite;
+	std::atomic<AsyncLogger*> asyncLogger;
+	std::atomic<int> asyncLoggerUsers; // asyncLogger を読んで使っている途中のスレッドの数
+	std::atomic<int> asyncLoggerWaiters; // asyncLoggerUsers が０になるのを待っているスレッドの数
+	boost::mutex asyncLoggerMutex;
+	boost::condition_variable asyncLoggerReleased;
+};
+
+
+/// 使い終わるまで Debug::asyncLogger(value) を戻らせないようにして asyncLogger を読む。
+class AsyncLoggerReference : private NonCopyable {
+public:
+	explicit AsyncLoggerReference(Global& global) : _global(global), _logger(nullptr) {
+		if (!global.asyncLogger.load()) { // logger が無ければ数えない。ここで読んだ値は使わないので差し替えと競合しても構わない
+			return;
+		}
+		++global.asyncLoggerUsers; // 数えてから読み直すので、差し替えた後に古い値を読んだスレッドは必ず数えられている
+		_logger = global.asyncLogger.load();
+		if (!_logger) {
+			release();
+		}
+	}
+	~AsyncLoggerReference() {
+		if (_logger) {
+			release();
+		}
+	}
+
+	AsyncLogger* get() const { return _logger; }
+
+private:
+	void release() {
+		if (--_global.asyncLoggerUsers == 0 && _global.asyncLoggerWaiters.load()) { // 差し替えて待っているスレッドを起こす
+			boost::mutex::scoped_lock lock(_global.asyncLoggerMutex);
+			_global.asyncLoggerReleased.notify_all();
+		}
+	}
+
+	Global& _global;
+	AsyncLogger* _logger;
 };
 
 
@@ -121,6 +165,27 @@ LONG WINAPI createMiniDumpExceptionHandler(EXCEPTION_POINTERS* exceptions) { //
 
 
 
+AsyncLogger* Debug::asyncLogger() {
+	return Singleton<Global>::get().asyncLogger.load();
+}
+
+
+void Debug::asyncLogger(AsyncLogger* value) {
+	Global& global = Singleton<Global>::get();
+	global.asyncLogger.store(value);
+	if (!global.asyncLoggerUsers.load()) {
+		return;
+	}
+	// 古い logger に書き込んでいる途中のスレッドを待ってから戻り、破棄できるようにする
+	++global.asyncLoggerWaiters; // 数えてから確かめるので、最後に使い終えたスレッドは必ず待っていることに気付く
+	boost::mutex::scoped_lock lock(global.asyncLoggerMutex);
+	while (global.asyncLoggerUsers.load()) {
+		global.asyncLoggerReleased.wait(lock);
+	}
+	--global.asyncLoggerWaiters;
+}
+
+
 bool Debug::createDumpFile(EXCEPTION_POINTERS* exceptions, StringRange filePath, bool showMessageBox, StringRange message, StringRange failedMessage) {
 	if (filePath.empty()) {
 		filePath = Singleton<Global>::get().filePath;
@@ -232,157 +297,21 @@ Listener<ByteStringRange>& Debug::onWrite() {
 }
 
 
-#pragma warning(push)
-#pragma warning(disable : 4740) // インライン asm コードの内部または外部のフローは、グローバルな最適化を抑制します
-#pragma warning(disable : 4748) // /GS 関数での最適化が無効にされているため、パラメーターおよびローカル変数をローカルのバッファー オーバーランから保護できません。
-String Debug::stackTrace() {
-	struct StackTraceMutex {
-		mutex mutex;
-	};
-	mutex::scoped_lock lock(Singleton<StackTraceMutex>::get().mutex); // Dbghelpライブラリの関数はスレッドセーフではないのでロックする
-
-	// 参考URL http://wiki.encom.bz/index.php/%E3%82%B9%E3%82%BF%E3%83%83%E3%82%AF%E3%83%88%E3%83%AC%E3%83%BC%E3%82%B9%E3%82%92%E8%A1%A8%E7%A4%BA%E3%81%99%E3%82%8B
-	// シンボルハンドラの初期化
-	const HANDLE process = GetCurrentProcess();
-	verify(SymInitialize(process, nullptr, TRUE));
-	scopeExit([&] () {
-		verify(SymCleanup(process));
-	});
-
-	{// モジュールの読み込み
-		const DWORD processId = GetCurrentProcessId();
-		const HANDLE snapshot = CreateToolhelp32Snapshot(TH32CS_SNAPMODULE, processId);
-		assert(snapshot != INVALID_HANDLE_VALUE);
-		scopeExit([&] () {
-			verify(CloseHandle(snapshot));
-		});
-
-		MODULEENTRY32W entry;
-		ZeroMemory(&entry, sizeof(entry));
-		entry.dwSize = sizeof(entry);
-
-		if (Module32FirstW(snapshot, &entry)) {
-			do {
-				// pdbファイルが見つからなければ失敗することは普通にあるのでエラーチェックしなくとも良い
-				SymLoadModuleExW(process, nullptr, entry.szExePath, entry.szModule, reinterpret_cast<DWORD64>(entry.modBaseAddr), entry.modBaseSize, nullptr, 0);
-			} while (Module32NextW(snapshot, &entry));
-		}
-	}
-
-    // 現スレッドのコンテキストの取得
-	const HANDLE thread = GetCurrentThread();
-	CONTEXT context;
-	ZeroMemory(&context, sizeof(context));
-	context.ContextFlags = CONTEXT_FULL;
-
-#if defined(_M_IX86)
-	__asm    call(x);
-	__asm x: pop eax;
-	__asm    mov context.Eip, eax;
-	__asm    mov context.Ebp, ebp;
-	__asm    mov context.Esp, esp;
-#else // for Windows 64-bit editions
-	RtlCaptureContext(&context);
-#endif
-
-
-	// スタックフレーム構造体の初期化
-	STACKFRAME64 stackFrame;
-	ZeroMemory(&stackFrame, sizeof(stackFrame));
-#if defined(_M_IX86)
-	stackFrame.AddrPC.Offset    = context.Eip;
-	stackFrame.AddrPC.Mode      = AddrModeFlat;
-	stackFrame.AddrFrame.Offset = context.Ebp;
-	stackFrame.AddrFrame.Mode   = AddrModeFlat;
-	stackFrame.AddrStack.Offset = context.Esp;
-	stackFrame.AddrStack.Mode   = AddrModeFlat;
-	DWORD machineType = IMAGE_FILE_MACHINE_I386;
-#elif defined(_M_AMD64)
-	stackFrame.AddrPC.Offset    = context.Rip;
-	stackFrame.AddrPC.Mode      = AddrModeFlat;
-	stackFrame.AddrFrame.Offset = context.Rbp;
-	stackFrame.AddrFrame.Mode   = AddrModeFlat;
-	stackFrame.AddrStack.Offset = context.Rsp;
-	stackFrame.AddrStack.Mode   = AddrModeFlat;
-	DWORD machineType = IMAGE_FILE_MACHINE_AMD64;
-#elif defined(_M_IA64)
-	stackFrame.AddrPC.Offset     = context.StIIP;
-	stackFrame.AddrPC.Mode       = AddrModeFlat;
-	stackFrame.AddrStack.Offset  = context.IntSp;
-	stackFrame.AddrStack.Mode    = AddrModeFlat;
-	stackFrame.AddrBStore.Offset = context.RsBSP;
-	stackFrame.AddrBStore.Mode   = AddrModeFlat;
-	DWORD machineType = IMAGE_FILE_MACHINE_IA64;
-#else
-#error "Not Supported."
-#endif
-
-
-	// スタックトレースの作成
-	if (!StackWalk64(machineType, process, thread, &stackFrame, &context, nullptr, nullptr, nullptr, nullptr)) { // この関数（stackTrace）のスタック情報を飛ばす
-		return String();
-	}
-	StringBuffer result(512);
-	for (;;) {
-		if (!StackWalk64(machineType, process, thread, &stackFrame, &context, nullptr, nullptr, nullptr, nullptr)) {
-			break;
-		}
-
-		if ((stackFrame.AddrPC.Offset == stackFrame.AddrReturn.Offset) // エンドレスになるので終了
-		 || (stackFrame.AddrPC.Offset == 0)) { // 不正なスタックフレーム
-			break;
-		}
-
-		{// モジュール名の取得
-			IMAGEHLP_MODULEW64 module;
-			ZeroMemory(&module, sizeof(module));
-			module.SizeOfStruct = sizeof(module);
-			if (SymGetModuleInfoW64(process, stackFrame.AddrPC.Offset, &module)) {
-				result += module.ModuleName;
-				result += L"!";
-			}
-		}
-
-		// 関数名の取得
-		BYTE buffer[sizeof(SYMBOL_INFOW) + sizeof(wchar_t) * MAX_SYM_NAME];
-		ZeroMemory(buffer, sizeof(buffer));
-		SYMBOL_INFOW* symbol = reinterpret_cast<SYMBOL_INFOW*>(buffer);
-		symbol->SizeOfStruct = sizeof(SYMBOL_INFOW);
-		symbol->MaxNameLen = MAX_SYM_NAME;
-		DWORD64 displacement = 0;
-		if (SymFromAddrW(process, stackFrame.AddrPC.Offset, &displacement, symbol)) {
-			result += symbol->Name;
-
-			DWORD displacement = 0;
-			IMAGEHLP_LINEW64 line;
-			ZeroMemory(&line, sizeof(line));
-			line.SizeOfStruct = sizeof(line);
-			if (SymGetLineFromAddrW64(process, stackFrame.AddrReturn.Offset, &displacement, &line)) {
-				result += L" at ";
-				result += line.FileName;
-				result += L"(";
-				result += line.LineNumber;
-				result += L")";
-			}
-		} else {
-			result += L"<nosymbols>";
-		}
-
-		result += L"\n";
-
-		if (stackFrame.AddrReturn.Offset == 0) { // 最後のスタックフレーム
-			break;
-		}
-	}
-
-	return result;
+__declspec(noinline) String Debug::stackTrace() { // インライン展開されると呼び出し元のフレームを飛ばしてしまう
+	return StackTrace::capture(1).toString(); // この関数のフレームを飛ばす
 }
-#pragma warning(pop)
 
 
 void Debug::write(ByteStringRange message) {
-	OutputDebugStringA(message.c_str());
 	Global& global = Singleton<Global>::get();
+	{
+		AsyncLoggerReference logger(global);
+		if (logger.get()) {
+			logger.get()->write(message);
+			return;
+		}
+	}
+	OutputDebugStringA(message.c_str());
 	if (global.onWrite) {
 		global.onWrite(message);
 	}
@@ -390,8 +319,15 @@ void Debug::write(ByteStringRange message) {
 
 
 void Debug::write(StringRange message) {
-	OutputDebugStringW(message.c_str());
 	Global& global = Singleton<Global>::get();
+	{
+		AsyncLoggerReference logger(global);
+		if (logger.get()) {
+			logger.get()->write(message);
+			return;
+		}
+	}
+	OutputDebugStringW(message.c_str());
 	if (global.onWrite) {
 		global.onWrite(Charset::default().encode(message));
 	}
@@ -399,12 +335,26 @@ void Debug::write(StringRange message) {
 
 
 void Debug::writeLine(ByteStringRange message) {
+	{
+		AsyncLoggerReference logger(Singleton<Global>::get());
+		if (logger.get()) { // 一つのメッセージとして書き込む
+			logger.get()->writeLine(message);
+			return;
+		}
+	}
 	write(message);
 	write("\n");
 }
 
 
 void Debug::writeLine(StringRange message) {
+	{
+		AsyncLoggerReference logger(Singleton<Global>::get());
+		if (logger.get()) { // 一つのメッセージとして書き込む
+			logger.get()->writeLine(message);
+			return;
+		}
+	}
 	write(message);
 	write(L"\n");
 }
@@ -7,6 +7,9 @@ struct _EXCEPTION_POINTERS;
 
 namespace balor {
 class String;
+	namespace test {
+class AsyncLogger;
+	}
 }
 
 
@@ -23,6 +26,13 @@ public:
 	typedef ::_EXCEPTION_POINTERS EXCEPTION_POINTERS;
 
 public:
+	/// write と writeLine の出力を任せる AsyncLogger。設定しない場合は nullptr で、呼んだスレッドで出力する。
+	/// 設定すると呼んだスレッドではメッセージをコピーするだけになり、デバッグ出力と onWrite イベントは logger のスレッドで行う。
+	/// logger は破棄する前に nullptr に戻すこと。AsyncLogger のデストラクタは自身が設定されていれば戻す。
+	/// 設定する関数は古い logger に書き込んでいる途中のスレッドが書き込み終えるまで待ってから戻る。onWrite イベントのリスナーからは設定しないこと。
+	static AsyncLogger* asyncLogger();
+	static void asyncLogger(AsyncLogger* value);
+
 	/// ミニダンプファイルを作成する。
 	/// ファイル名やメッセージを指定しなかった場合は enableCrashDumpHandler 関数で設定された値が使用される。
 	static bool createDumpFile(EXCEPTION_POINTERS* exceptions = nullptr, StringRange filePath = L"", bool showMessageBox = false, StringRange message = L"", StringRange failedMessage = L"");
@@ -87,7 +97,7 @@ public:
 	/// デバッグ出力イベント。設定しない場合は単にデバッグ出力を行う。この関数はスレッドセーフではないので注意。
 	static Listener<ByteStringRange>& onWrite();
 
-	/// スタックトレースを返す。
+	/// スタックトレースを返す。呼び出し元で StackTrace::capture().toString() を呼ぶのと同じで、変換したシンボル名はキャッシュする。
 	/// 開発環境以外で使用する場合は exe ファイルと共に pdf ファイルも配布する必要がある。
 	/// ソースコード情報を取り除いた pdf ファイルの配布が一般的。（リンカー＞デバッグ＞プライベートシンボルの削除）
 	/// この関数を使う場合、Dbghelp.dll は VS2010EE に付属のものでは他 OS 環境でうまく動作しないので注意。最新版をダウンロードしてアプリケーションといっしょに配布する必要がある。
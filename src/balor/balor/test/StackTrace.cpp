@@ -0,0 +1,207 @@
+﻿#include "StackTrace.hpp"
+
+#include <cstring>
+#include <map>
+#include <utility>
+#define BOOST_DATE_TIME_NO_LIB
+#define BOOST_THREAD_NO_LIB
+#include <boost/thread/mutex.hpp>
+
+#include <balor/system/windows.hpp>
+#include <balor/test/verify.hpp>
+#include <balor/scopeExit.hpp>
+#include <balor/String.hpp>
+#include <balor/StringBuffer.hpp>
+
+#include <dbghelp.h>
+#pragma comment(lib, "dbghelp.lib")
+#include <tlhelp32.h>
+
+
+namespace balor {
+	namespace test {
+
+using std::map;
+using std::move;
+using boost::mutex;
+
+
+namespace {
+/// 変換したシンボル名をアドレスごとに保持する。プロセスが終わるまで破棄しない。
+struct SymbolCache {
+	SymbolCache() : initialized(false) {}
+
+	mutex guard; // Dbghelp ライブラリの関数はスレッドセーフではないのでキャッシュと一緒にロックする
+	bool initialized;
+	map<void*, String> names;
+};
+
+
+SymbolCache& getSymbolCache() {
+	static SymbolCache symbolCache;
+	return symbolCache;
+}
+
+
+SymbolCache& symbolCache = getSymbolCache(); // マルチスレッドになるまえに初期化されることを保証する
+
+
+/// プロセスのモジュールをシンボルハンドラに登録する。シンボルは SYMOPT_DEFERRED_LOADS で必要になった時に読み込まれる。
+void loadModules(HANDLE process) {
+	const HANDLE snapshot = CreateToolhelp32Snapshot(TH32CS_SNAPMODULE, GetCurrentProcessId());
+	if (snapshot == INVALID_HANDLE_VALUE) {
+		return;
+	}
+	scopeExit([&] () {
+		verify(CloseHandle(snapshot));
+	});
+
+	MODULEENTRY32W entry;
+	ZeroMemory(&entry, sizeof(entry));
+	entry.dwSize = sizeof(entry);
+	if (Module32FirstW(snapshot, &entry)) {
+		do {
+			// 登録済みのモジュールや pdb ファイルが見つからない場合は普通に失敗するのでエラーチェックしなくとも良い
+			SymLoadModuleExW(process, nullptr, entry.szExePath, entry.szModule, reinterpret_cast<DWORD64>(entry.modBaseAddr), entry.modBaseSize, nullptr, 0);
+		} while (Module32NextW(snapshot, &entry));
+	}
+}
+
+
+void symbolizeTo(void* address, StringBuffer& result) {
+	const HANDLE process = GetCurrentProcess();
+	if (!symbolCache.initialized) {
+		SymSetOptions(SymGetOptions() | SYMOPT_DEFERRED_LOADS | SYMOPT_LOAD_LINES | SYMOPT_UNDNAME);
+		verify(SymInitialize(process, nullptr, FALSE));
+		loadModules(process);
+		symbolCache.initialized = true;
+	}
+	// 戻りアドレスは呼び出し命令の次を指しているので１つ戻して呼び出し元の行を探す
+	const DWORD64 offset = reinterpret_cast<DWORD64>(address) - 1;
+	if (!SymGetModuleBase64(process, offset)) { // 初期化した後に読み込まれたモジュール
+		loadModules(process);
+	}
+
+	{// モジュール名の取得
+		IMAGEHLP_MODULEW64 module;
+		ZeroMemory(&module, sizeof(module));
+		module.SizeOfStruct = sizeof(module);
+		if (SymGetModuleInfoW64(process, offset, &module)) {
+			result += module.ModuleName;
+			result += L"!";
+		}
+	}
+
+	// 関数名の取得
+	BYTE buffer[sizeof(SYMBOL_INFOW) + sizeof(wchar_t) * MAX_SYM_NAME];
+	ZeroMemory(buffer, sizeof(buffer));
+	SYMBOL_INFOW* symbol = reinterpret_cast<SYMBOL_INFOW*>(buffer);
+	symbol->SizeOfStruct = sizeof(SYMBOL_INFOW);
+	symbol->MaxNameLen = MAX_SYM_NAME;
+	DWORD64 displacement = 0;
+	if (SymFromAddrW(process, offset, &displacement, symbol)) {
+		result += symbol->Name;
+
+		DWORD lineDisplacement = 0;
+		IMAGEHLP_LINEW64 line;
+		ZeroMemory(&line, sizeof(line));
+		line.SizeOfStruct = sizeof(line);
+		if (SymGetLineFromAddrW64(process, offset, &lineDisplacement, &line)) {
+			result += L" at ";
+			result += line.FileName;
+			result += L"(";
+			result += static_cast<int>(line.LineNumber);
+			result += L")";
+		}
+	} else {
+		result += L"<nosymbols>";
+	}
+}
+} // namespace
+
+
+
+StackTrace::StackTrace() : _frameCount(0), _hash(0) {
+}
+
+
+__declspec(noinline) StackTrace StackTrace::capture(int skipCount) { // インライン展開されると呼び出し元のフレームを飛ばしてしまう
+	assert("Negative skipCount" && 0 <= skipCount);
+
+	StackTrace result;
+	const int captureCount = maxFrameCount - skipCount; // Windows XP では FramesToSkip (skipCount + 1) と FramesToCapture の合計が 63 未満でなければならない
+	if (0 < captureCount) {
+		result._frameCount = CaptureStackBackTrace(skipCount + 1, captureCount, result._frames, nullptr);
+	}
+
+	unsigned int hash = 2166136261U; // FNV-1a
+	for (int i = 0; i < result._frameCount; ++i) {
+		const unsigned char* bytes = reinterpret_cast<const unsigned char*>(&result._frames[i]);
+		for (int j = 0; j < static_cast<int>(sizeof(void*)); ++j) {
+			hash = (hash ^ bytes[j]) * 16777619U;
+		}
+	}
+	result._hash = hash;
+	return result;
+}
+
+
+int StackTrace::frameCount() const {
+	return _frameCount;
+}
+
+
+unsigned int StackTrace::hash() const {
+	return _hash;
+}
+
+
+String StackTrace::symbolize(void* address) {
+	mutex::scoped_lock lock(symbolCache.guard);
+	String& name = symbolCache.names[address];
+	if (name.empty()) {
+		StringBuffer buffer;
+		symbolizeTo(address, buffer);
+		name = move(buffer);
+	}
+	return String::refer(name);
+}
+
+
+String StackTrace::toString() const {
+	StringBuffer buffer(512);
+	toStringToBuffer(buffer);
+	return move(buffer);
+}
+
+
+void StackTrace::toStringToBuffer(StringBuffer& buffer) const {
+	for (int i = 0; i < _frameCount; ++i) {
+		buffer += symbolize(_frames[i]);
+		buffer += L"\n";
+	}
+}
+
+
+void* StackTrace::operator[](int index) const {
+	assert("index out of range" && 0 <= index);
+	assert("index out of range" && index < _frameCount);
+	return _frames[index];
+}
+
+
+bool StackTrace::operator==(const StackTrace& rhs) const {
+	return _hash == rhs._hash
+		&& _frameCount == rhs._frameCount
+		&& std::memcmp(_frames, rhs._frames, sizeof(void*) * _frameCount) == 0;
+}
+
+
+bool StackTrace::operator!=(const StackTrace& rhs) const {
+	return !(*this == rhs);
+}
+
+
+
+	}
+}
@@ -0,0 +1,75 @@
+﻿#pragma once
+
+
+namespace balor {
+class String;
+class StringBuffer;
+}
+
+
+namespace balor {
+	namespace test {
+
+
+
+/**
+ * スタックの戻りアドレスだけを記録したスタックトレース。
+ *
+ * capture 関数は CaptureStackBackTrace でアドレスを配列にコピーするだけなので、メモリ割り当てやロックのプロファイルで呼び出し元ごとに記録しても重くない。
+ * アドレスからシンボル名への変換は toString 関数や symbolize 関数を呼んだ時に行う。
+ * シンボルハンドラは最初の変換で一度だけ初期化し、各モジュールのシンボルは必要になった時に読み込む。変換した結果はアドレスごとにプロセスが終わるまでキャッシュする。
+ * 初期化した後に読み込まれたモジュールのアドレスを変換する時はモジュールを読み込み直す。
+ * 変換した文字列は「モジュール名!関数名 at ファイル名(行番号)」の形式で、シンボルが見つからなければ関数名の代わりに <nosymbols> になる。
+ * 開発環境以外でシンボルを得るには Debug::stackTrace 関数と同じく pdb ファイルと Dbghelp.dll を配布する必要がある。
+ * 変換する関数は複数のスレッドから同時に使える。
+ *
+ * <h3>・サンプルコード</h3>
+ * <pre><code>
+	std::unordered_map<unsigned int, StackTrace> callers; // 割り当てた場所ごとに記録する
+	StackTrace trace = StackTrace::capture();
+	callers[trace.hash()] = trace;
+	...
+	for (auto i = callers.begin(), end = callers.end(); i != end; ++i) {
+		Debug::write(i->second.toString()); // 出力する時にまとめて変換する
+	}
+ * </code></pre>
+ */
+class StackTrace {
+public:
+	/// 記録できるフレームの最大数。Windows XP の CaptureStackBackTrace は飛ばすフレームと記録するフレームの合計が 63 未満でなければならず、
+	/// capture 関数自身のフレームを一つ飛ばすので 61 になる。skipCount を指定するとその分だけ少なくなる。
+	static const int maxFrameCount = 61;
+
+public:
+	/// フレームの無いスタックトレースを作成。
+	StackTrace();
+
+public:
+	/// 現在のスレッドのスタックトレースを記録する。最初のフレームは capture 関数の呼び出し元で、skipCount 個のフレームを更に飛ばす。
+	static StackTrace capture(int skipCount = 0);
+	/// 記録したフレームの数。
+	int frameCount() const;
+	/// フレームのアドレスから計算したハッシュ値。
+	unsigned int hash() const;
+	/// アドレスのシンボル名を返す。二回目以降はキャッシュした文字列への参照を返す。
+	static String symbolize(void* address);
+	/// 各フレームをシンボル名に変換して改行で区切った文字列。Debug::stackTrace と同じ形式。
+	String toString() const;
+	void toStringToBuffer(StringBuffer& buffer) const;
+
+public:
+	/// フレームのアドレス。
+	void* operator[](int index) const;
+	bool operator==(const StackTrace& rhs) const;
+	bool operator!=(const StackTrace& rhs) const;
+
+private:
+	void* _frames[maxFrameCount];
+	int _frameCount;
+	unsigned int _hash;
+};
+
+
+
+	}
+}
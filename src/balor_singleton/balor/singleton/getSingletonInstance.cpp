@@ -1,6 +1,7 @@
 ﻿#include "getSingletonInstance.hpp"
 
-#include <vector>
+#include <atomic>
+#include <cstring>
 
 #define BOOST_DATE_TIME_NO_LIB
 #define BOOST_THREAD_NO_LIB
@@ -18,36 +19,106 @@ using boost::recursive_mutex;
 
 namespace {
 struct Instance {
-	Instance() {}
-	Instance(void* pointer, const type_info& info) : pointer(pointer),/* hashCode(info.hash_code()),*/ info(&info) {}
+	Instance(void* pointer, const type_info& info, size_t hashCode, Instance* next) : pointer(pointer), info(&info), hashCode(hashCode), next(next) {}
 	void* pointer;
-	//size_t hashCode;
 	const type_info* info;
+	size_t hashCode;
+	Instance* next;
+};
+
+
+/// 형 이름으로부터 해시값을 계산한다.
+/// type_info::name 은 이름없는 네임스페이스의 형을 구별할 수 없으므로 VC++ 에서는 장식된 이름(raw_name)을 사용한다.
+/// 같은 형이라면 DLL 이 달라도 같은 문자열이 되므로 해시값도 같아진다. 최종적인 판정은 type_info::operator== 로 한다.
+size_t getHashCode(const type_info& info) {
+	const char* name = info.raw_name();
+#if defined(_WIN64)
+	size_t hashCode = 14695981039346656037ULL; // 64 비트의 FNV-1a
+	const size_t prime = 1099511628211ULL;
+#else
+	size_t hashCode = 2166136261U; // 32 비트의 FNV-1a
+	const size_t prime = 16777619U;
+#endif
+	for (; *name; ++name) {
+		hashCode ^= static_cast<unsigned char>(*name);
+		hashCode *= prime;
+	}
+	return hashCode;
+}
+
+
+/**
+ * 해시 인덱스 붙은 인스턴스 등록부.
+ *
+ * 버킷은 단방향 리스트로 앞쪽에만 추가하고 삭제하지 않으므로, 읽기는 락을 걸지 않고 acquire 로드로 따라가기만 하면 된다.
+ * 추가는 instancesMutex 의 락 안에서만 하고 release 스토어로 공개하므로, 읽는 쪽에서 완성되지 않은 Instance 가 보이는 일은 없다.
+ */
+class Instances {
+public:
+	enum { bucketCount = 1024 }; // 2 의 거듭제곱일 것
+
+	Instances() {
+		for (int i = 0; i < bucketCount; ++i) {
+			buckets[i].store(nullptr, memory_order_relaxed);
+		}
+	}
+	~Instances() {
+		for (int i = 0; i < bucketCount; ++i) {
+			Instance* instance = buckets[i].load(memory_order_relaxed);
+			while (instance) {
+				Instance* next = instance->next;
+				delete instance;
+				instance = next;
+			}
+		}
+	}
+
+	void* find(const type_info& info, size_t hashCode) const {
+		for (const Instance* i = buckets[hashCode & (bucketCount - 1)].load(memory_order_acquire); i; i = i->next) {
+			if (i->hashCode == hashCode && info == *(i->info)) { // 이미 등록된 인스턴스를 발견하였다
+				return i->pointer;
+			}
+		}
+		return nullptr;
+	}
+
+	/// instancesMutex 의 락 안에서 호출할 것.
+	void add(void* pointer, const type_info& info, size_t hashCode) {
+		atomic<Instance*>& bucket = buckets[hashCode & (bucketCount - 1)];
+		Instance* instance = new Instance(pointer, info, hashCode, bucket.load(memory_order_relaxed));
+		bucket.store(instance, memory_order_release);
+	}
+
+private:
+	atomic<Instance*> buckets[bucketCount];
 };
 
-typedef vector<Instance> Instances;
 
 Instances instances; // DLL이 프로세스에 attach 되기 전에 초기화 되어야 한다 http://msdn.microsoft.com/ja-jp/library/988ye33t(VS.80).aspx
-recursive_mutex instancesMutex; // DLL이 프로세스에 attatch 되기 전에 초기화 되어햐 한다
+recursive_mutex instancesMutex; // DLL이 프로세스에 attatch 되기 전에 초기화 되어햐 한다. 인스턴스 작성 중에 다른 형의 싱글톤을 작성할 수 있도록 recursive_mutex 로 한다
 } // namespace
 
 
 
 BALOR_SINGLETON_API void* getSingletonInstance(const type_info& info, void* (*createInstanceFunction)()) {
+	const size_t hashCode = getHashCode(info);
+	void* instance = instances.find(info, hashCode); // 등록된 후라면 락은 걸지 않는다
+	if (instance) {
+		return instance;
+	}
+
 	recursive_mutex::scoped_lock lock(instancesMutex);
-	for (auto i = instances.begin(), end = instances.end(); i != end; ++i) {
-		//if (info.hash_code() == i->hashCode) { // 이미 등록된 인스턴스를 발견하였다
-		if (info == *(i->info)) { // 이미 등록된 인스턴스를 발견하였다
-			return i->pointer;
-		}
+	instance = instances.find(info, hashCode); // 락을 기다리는 동안 다른 스레드가 등록했을지도 모른다
+	if (instance) {
+		return instance;
 	}
-	// 발견하지 못해서 새로운 인스턴스 등록 
+	// 발견하지 못해서 새로운 인스턴스 등록
 	void* newInstance = (*createInstanceFunction)();
-	instances.push_back(Instance(newInstance, info));
+	instances.add(newInstance, info, hashCode);
 	return newInstance;
 }
 
 
 
 	}
-}
\ No newline at end of file
+}
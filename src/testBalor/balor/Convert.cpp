@@ -5,6 +5,7 @@
 #include <limits>
 
 #include <balor/locale/Locale.hpp>
+#include <balor/test/Benchmark.hpp>
 #include <balor/test/UnitTest.hpp>
 #include <balor/String.hpp>
 #include <balor/StringBuffer.hpp>
@@ -19,6 +20,7 @@ using std::move;
 using std::wstring;
 using namespace balor::locale;
 using namespace balor::Convert;
+using balor::test::Benchmark;
 using tools::floatEquals;
 
 
@@ -1387,6 +1389,36 @@ testCase(cleanup) {
 }
 
 
+BALOR_BENCHMARK(benchmarkConvertIntToString) {
+	int value = 0;
+	while (benchmark.running()) {
+		String result = to<String>(++value);
+		Benchmark::doNotOptimize(result);
+	}
+}
+
+
+BALOR_BENCHMARK(benchmarkConvertIntToStringBuffer) { // 버퍼를 재사용하면 메모리 할당이 없다
+	StringBuffer buffer(64);
+	int value = 0;
+	while (benchmark.running()) {
+		buffer.length(0);
+		to<StringBuffer>(buffer, ++value);
+		Benchmark::doNotOptimize(buffer);
+	}
+}
+
+
+BALOR_BENCHMARK(benchmarkConvertStringToInt) {
+	const String source = L"1234567";
+	int result = 0;
+	while (benchmark.running()) {
+		result += to<int>(source);
+	}
+	Benchmark::doNotOptimize(result);
+}
+
+
 
 	}
 }
\ No newline at end of file
@@ -2,8 +2,15 @@
 
 #include <balor/testSingleton.hpp> // testBalorDll
 
+#include <atomic>
+#include <vector>
+#include <boost/thread.hpp>
+#include <boost/thread/barrier.hpp>
+
 #include <balor/io/File.hpp>
 #include <balor/system/Module.hpp>
+#include <balor/system/windows.hpp>
+#include <balor/test/Benchmark.hpp>
 #include <balor/test/UnitTest.hpp>
 #include <balor/String.hpp>
 
@@ -12,8 +19,53 @@ namespace balor {
 	namespace testSingleton {
 
 
+using boost::barrier;
+using boost::thread;
+using std::atomic;
+using std::vector;
 using namespace balor::io;
 using namespace balor::system;
+using namespace balor::test;
+
+
+namespace {
+struct Anonymous { // 다른 번역 단위의 같은 이름의 형과 구별되어야 한다
+	Anonymous() : value(7) {}
+	int value;
+};
+
+
+template<int N> struct Tag {
+	int value;
+};
+
+
+atomic<int> raceTagCreatedCount(0);
+
+
+template<int N> struct RaceTag { // getMultiThreadFirstRegistration 에서 처음으로 등록된다
+	RaceTag() { ++raceTagCreatedCount; }
+	int value;
+};
+
+
+template<template<int> class TagType, int N> struct TagGetter {
+	static void get(vector<void*>& pointers) {
+		TagGetter<TagType, N - 1>::get(pointers);
+		pointers.push_back(&Singleton<TagType<N> >::get());
+	}
+};
+
+
+template<template<int> class TagType> struct TagGetter<TagType, 0> {
+	static void get(vector<void*>& pointers) {
+		pointers.push_back(&Singleton<TagType<0> >::get());
+	}
+};
+
+
+const int tagCount = 300;
+} // namespace
 
 
 testCase(get) {
@@ -42,6 +94,84 @@ testCase(get) {
 }
 
 
+testCase(getAnonymousNamespaceType) {
+	testAssert(Singleton<Anonymous>::get().value == 7);
+	testAssert(&Singleton<Anonymous>::get() == &Singleton<Anonymous>::get());
+	testAssert(static_cast<void*>(&Singleton<Anonymous>::get()) != static_cast<void*>(&Singleton<int>::get()));
+}
+
+
+testCase(getMultiThread) {
+	vector<void*> pointers;
+	TagGetter<Tag, tagCount - 1>::get(pointers); // 등록이 끝난 형의 취득은 락을 걸지 않는다
+
+	const int threadCount = 8;
+	vector<vector<void*> > results(threadCount);
+	{
+		vector<thread*> threads;
+		for (int i = 0; i < threadCount; ++i) {
+			vector<void*>& result = results[i];
+			threads.push_back(new thread([&result] () {
+				for (int j = 0; j < 100; ++j) {
+					result.clear();
+					TagGetter<Tag, tagCount - 1>::get(result);
+				}
+			}));
+		}
+		for (auto i = threads.begin(), end = threads.end(); i != end; ++i) {
+			(*i)->join();
+			delete *i;
+		}
+	}
+	for (auto i = results.begin(), end = results.end(); i != end; ++i) {
+		testAssert(*i == pointers);
+	}
+}
+
+
+testCase(getMultiThreadFirstRegistration) { // 아직 등록되지 않은 같은 형을 여러 스레드에서 동시에 취득한다
+	const int threadCount = 8;
+	vector<vector<void*> > results(threadCount);
+	{
+		barrier startBarrier(threadCount);
+		vector<thread*> threads;
+		for (int i = 0; i < threadCount; ++i) {
+			vector<void*>& result = results[i];
+			threads.push_back(new thread([&result, &startBarrier] () {
+				startBarrier.wait(); // 모든 스레드가 모이고 나서 동시에 등록을 시작한다
+				TagGetter<RaceTag, tagCount - 1>::get(result);
+			}));
+		}
+		for (auto i = threads.begin(), end = threads.end(); i != end; ++i) {
+			(*i)->join();
+			delete *i;
+		}
+	}
+	testAssert(raceTagCreatedCount == tagCount); // 형마다 한번만 작성되었다
+	testAssert(results[0].size() == tagCount);
+	for (auto i = results.begin(), end = results.end(); i != end; ++i) {
+		testAssert(*i == results[0]);
+	}
+
+	vector<void*> pointers;
+	TagGetter<RaceTag, tagCount - 1>::get(pointers); // 등록된 후의 취득도 같은 인스턴스를 반환한다
+	testAssert(pointers == results[0]);
+	testAssert(raceTagCreatedCount == tagCount);
+}
+
+
+BALOR_BENCHMARK(benchmarkSingletonGet) { // 등록된 후의 수백개의 형의 취득 시간. 처음의 등록은 한 번뿐이므로 계측하지 않는다
+	vector<void*> pointers;
+	pointers.reserve(tagCount);
+	TagGetter<Tag, tagCount - 1>::get(pointers);
+	while (benchmark.running()) {
+		pointers.clear();
+		TagGetter<Tag, tagCount - 1>::get(pointers);
+	}
+	testAssert(pointers.size() == tagCount);
+}
+
+
 
 	}
 }
\ No newline at end of file
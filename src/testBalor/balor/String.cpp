@@ -10,6 +10,7 @@
 
 #include <balor/locale/Charset.hpp>
 #include <balor/locale/Locale.hpp>
+#include <balor/test/Benchmark.hpp>
 #include <balor/test/UnitTest.hpp>
 
 
@@ -23,6 +24,7 @@ using std::vector;
 using std::wstring;
 using namespace boost::assign;
 using namespace balor::locale;
+using balor::test::Benchmark;
 
 
 
@@ -3767,6 +3769,26 @@ testCase(operatorMoreEqual) {
 }
 
 
+BALOR_BENCHMARK_SIZES(benchmarkStringCopy, 16, 256, 4096) {
+	const String source(L'a', benchmark.size());
+	while (benchmark.running()) {
+		String copy = source;
+		Benchmark::doNotOptimize(copy);
+	}
+}
+
+
+BALOR_BENCHMARK_SIZES(benchmarkStringEquals, 16, 256, 4096) {
+	const String lhs(L'a', benchmark.size());
+	const String rhs(L'a', benchmark.size());
+	bool result = true;
+	while (benchmark.running()) {
+		result &= String::equals(lhs, rhs);
+	}
+	Benchmark::doNotOptimize(result);
+}
+
+
 
 	}
 }
\ No newline at end of file
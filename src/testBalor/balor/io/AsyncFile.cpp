@@ -0,0 +1,325 @@
+﻿#include <balor/io/AsyncFile.hpp>
+
+#include <atomic>
+#include <exception>
+#include <functional>
+#include <utility>
+#include <vector>
+
+#include <balor/io/File.hpp>
+#include <balor/io/FileStream.hpp>
+#include <balor/system/windows.hpp>
+#include <balor/test/Benchmark.hpp>
+#include <balor/test/UnitTest.hpp>
+#include <balor/scopeExit.hpp>
+#include <balor/String.hpp>
+
+
+namespace balor {
+	namespace io {
+		namespace testAsyncFile {
+
+
+using std::exception_ptr;
+using std::move;
+using std::vector;
+using namespace balor::system;
+using namespace balor::test;
+
+
+namespace {
+const wchar_t testDirectoryName[] = L"testBalor_io_AsyncFile_4nq8wz1ye6kc3rb0tm5gxh7s";
+File getTestDirectory() {
+	File dir(File::getSpecial(File::Special::temporary), testDirectoryName);
+	if (dir.exists()) {
+		dir.remove(true);
+	}
+	dir.createDirectory();
+	return dir;
+}
+
+
+void removeTestDirectory() {
+	File(File::getSpecial(File::Special::temporary), testDirectoryName).remove(true);
+}
+
+
+unsigned char valueAt(__int64 position) {
+	return static_cast<unsigned char>((position * 7) ^ (position >> 8));
+}
+
+
+File createDataFile(const File& dir, StringRange name, int size) {
+	File file(dir, name);
+	vector<unsigned char> data(size);
+	for (int i = 0; i < size; ++i) {
+		data[i] = valueAt(i);
+	}
+	auto stream = file.create();
+	if (size) {
+		stream.write(data.data(), 0, size);
+	}
+	return file;
+}
+
+
+bool isValid(const vector<unsigned char>& buffer, int offset, int count, __int64 position) {
+	for (int i = 0; i < count; ++i) {
+		if (buffer[offset + i] != valueAt(position + i)) {
+			return false;
+		}
+	}
+	return true;
+}
+
+
+/// blockCount 개의 블록의 위치. random 이 true 면 겹치기도 하는 무작위 위치
+vector<__int64> blockPositions(int blockSize, int blockCount, bool random) {
+	vector<__int64> positions(blockCount);
+	unsigned int seed = 12345;
+	for (int i = 0; i < blockCount; ++i) {
+		if (random) {
+			seed = seed * 1103515245 + 12345;
+			positions[i] = static_cast<__int64>((seed >> 8) % blockCount) * blockSize;
+		} else {
+			positions[i] = static_cast<__int64>(i) * blockSize;
+		}
+	}
+	return positions;
+}
+
+
+/// 항상 queueDepth 개의 요구를 발행한 상태로 positions 의 블록을 모두 읽는다. buffer 는 blockSize * queueDepth 바이트
+void readBlocks(AsyncFile& file, const vector<__int64>& positions, int blockSize, int queueDepth, vector<char>& buffer) {
+	const int blockCount = static_cast<int>(positions.size());
+	std::atomic<int> next(0);
+	std::function<void (int)> issue;
+	issue = [&] (int slot) { // 완료하면 콜백 함수 안에서 같은 버퍼로 다음을 발행하므로 발행 중인 요구의 수는 유지된다
+		const int index = next++;
+		if (index < blockCount) {
+			file.readAsync(positions[index], buffer.data(), slot * blockSize, blockSize, [&, slot] (int , exception_ptr ) {
+				issue(slot);
+			});
+		}
+	};
+	for (int i = 0; i < queueDepth; ++i) {
+		issue(i);
+	}
+	file.wait();
+}
+} // namespace
+
+
+
+testCase(construct) {
+	scopeExit(&removeTestDirectory);
+	File dir = getTestDirectory();
+	File file = createDataFile(dir, L"data.bin", 100);
+
+	// 무효한 파라미터
+	testAssertionFailed(AsyncFile(L"", FileStream::Mode::open));
+	testAssertionFailed(AsyncFile(file.path(), FileStream::Mode::append));
+	testAssertionFailed(AsyncFile(file.path(), FileStream::Mode::open, FileStream::Access::_enum(-1)));
+
+	// 존재하지 않는 파일
+	testThrow(AsyncFile(File(dir, L"notFound.bin").path(), FileStream::Mode::open), AsyncFile::NotFoundException);
+	// 이미 파일이 존재한다
+	testThrow(AsyncFile(file.path(), FileStream::Mode::create, FileStream::Access::write), AsyncFile::AlreadyExistsException);
+	{// 접근 공유를 할 수 없다
+		FileStream stream(file.path(), FileStream::Mode::open, FileStream::Access::read, FileStream::Share::none);
+		testThrow(AsyncFile(file.path(), FileStream::Mode::open), AsyncFile::SharingViolationException);
+	}
+
+	{// 널 핸들
+		AsyncFile nullFile;
+		testAssert(!nullFile);
+		testAssert(nullFile.pendingCount() == 0);
+		testNoThrow(nullFile.wait());
+		char buffer[1];
+		testAssertionFailed(nullFile.readAsync(0, buffer, 0, 1));
+	}
+	{
+		AsyncFile asyncFile(file.path(), FileStream::Mode::open);
+		testAssert(asyncFile);
+		testAssert(asyncFile.length() == 100);
+		testAssert(asyncFile.pendingCount() == 0);
+	}
+	{// 새로 작성
+		AsyncFile asyncFile(File(dir, L"new.bin").path(), FileStream::Mode::create, FileStream::Access::readWrite);
+		testAssert(asyncFile.length() == 0);
+	}
+	testAssert(File(dir, L"new.bin").exists());
+}
+
+
+testCase(moveConstructAndAssignment) {
+	scopeExit(&removeTestDirectory);
+	File dir = getTestDirectory();
+	File file = createDataFile(dir, L"data.bin", 100);
+
+	AsyncFile source(file.path(), FileStream::Mode::open);
+	AsyncFile::HANDLE handle = source;
+	AsyncFile moved = move(source);
+	testAssert(!source);
+	testAssert(moved == handle);
+
+	vector<unsigned char> buffer(100);
+	auto task = moved.readAsync(0, buffer.data(), 0, 100);
+	AsyncFile assigned;
+	assigned = move(moved); // 발행중인 요구는 이동한 곳에서 기다린다
+	testAssert(!moved);
+	testAssert(assigned == handle);
+	assigned.wait();
+	testAssert(task.done());
+	testAssert(task.get() == 100);
+	testAssert(isValid(buffer, 0, 100, 0));
+}
+
+
+testCase(readAsync) {
+	scopeExit(&removeTestDirectory);
+	File dir = getTestDirectory();
+	const int size = 100000;
+	File file = createDataFile(dir, L"data.bin", size);
+	AsyncFile asyncFile(file.path(), FileStream::Mode::open);
+	vector<unsigned char> buffer(size + 10);
+
+	// 무효한 파라미터
+	testAssertionFailed(asyncFile.readAsync(-1, buffer.data(), 0, 1));
+	testAssertionFailed(asyncFile.readAsync(0, nullptr, 0, 1));
+	testAssertionFailed(asyncFile.readAsync(0, buffer.data(), -1, 1));
+	testAssertionFailed(asyncFile.readAsync(0, buffer.data(), 0, -1));
+	testAssertionFailed(asyncFile.readAsync(0, buffer.data(), 0, 1, AsyncFile::Callback()));
+
+	{// Task 로 결과를 받는다
+		auto task0 = asyncFile.readAsync(0, buffer.data(), 0, 1000);
+		auto task1 = asyncFile.readAsync(50000, buffer.data(), 1000, 2000);
+		auto task2 = asyncFile.readAsync(size - 1, buffer.data(), 3000, 1);
+		testAssert(task0.get() == 1000);
+		testAssert(task1.get() == 2000);
+		testAssert(task2.get() == 1);
+		testAssert(isValid(buffer, 0, 1000, 0));
+		testAssert(isValid(buffer, 1000, 2000, 50000));
+		testAssert(isValid(buffer, 3000, 1, size - 1));
+	}
+	{// 콜백 함수로 결과를 받는다
+		std::atomic<int> total(0);
+		std::atomic<int> errorCount(0);
+		for (int i = 0; i < 10; ++i) {
+			asyncFile.readAsync(i * 10000, buffer.data(), i * 10000, 10000, [&] (int transferred, exception_ptr error) {
+				total += transferred;
+				if (error) {
+					++errorCount;
+				}
+			});
+		}
+		asyncFile.wait();
+		testAssert(asyncFile.pendingCount() == 0);
+		testAssert(total == size);
+		testAssert(errorCount == 0);
+		testAssert(isValid(buffer, 0, size, 0));
+	}
+	{// 파일의 끝을 넘는다
+		testAssert(asyncFile.readAsync(size - 10, buffer.data(), 0, 100).get() == 10);
+		testAssert(isValid(buffer, 0, 10, size - 10));
+		testAssert(asyncFile.readAsync(size, buffer.data(), 0, 100).get() == 0);
+		testAssert(asyncFile.readAsync(size + 1000, buffer.data(), 0, 100).get() == 0);
+	}
+	// 0 바이트
+	testAssert(asyncFile.readAsync(0, buffer.data(), 0, 0).get() == 0);
+}
+
+
+testCase(writeAsync) {
+	scopeExit(&removeTestDirectory);
+	File dir = getTestDirectory();
+	File file(dir, L"data.bin");
+	const int blockSize = 4096;
+	const int blockCount = 64;
+	vector<unsigned char> data(blockSize * blockCount);
+	for (int i = 0, end = data.size(); i < end; ++i) {
+		data[i] = valueAt(i);
+	}
+
+	{
+		AsyncFile asyncFile(file.path(), FileStream::Mode::create, FileStream::Access::readWrite);
+		vector<Task<void> > tasks;
+		for (int i = blockCount - 1; 0 <= i; --i) { // 뒤에서부터 써도 된다
+			tasks.push_back(asyncFile.writeAsync(i * blockSize, data.data(), i * blockSize, blockSize));
+		}
+		for (auto i = tasks.begin(), end = tasks.end(); i != end; ++i) {
+			testNoThrow(i->get());
+		}
+		testAssert(asyncFile.length() == blockSize * blockCount);
+		testNoThrow(asyncFile.flush());
+
+		vector<unsigned char> buffer(blockSize * blockCount);
+		testAssert(asyncFile.readAsync(0, buffer.data(), 0, buffer.size()).get() == blockSize * blockCount);
+		testAssert(isValid(buffer, 0, buffer.size(), 0));
+	}
+	{// 읽기 전용 파일에 쓴다
+		AsyncFile asyncFile(file.path(), FileStream::Mode::open, FileStream::Access::read);
+		auto task = asyncFile.writeAsync(0, data.data(), 0, 100);
+		testThrow(task.get(), AsyncFile::TransferFailedException);
+	}
+	{// 파일 끝의 뒤에 쓴다
+		AsyncFile asyncFile(file.path(), FileStream::Mode::open, FileStream::Access::readWrite);
+		testNoThrow(asyncFile.writeAsync(blockSize * blockCount + 100, data.data(), 0, 100).get());
+		testAssert(asyncFile.length() == blockSize * blockCount + 200);
+	}
+}
+
+
+testCase(manyRequests) { // 완료를 기다리지 않고 많은 요구를 발행한다
+	scopeExit(&removeTestDirectory);
+	File dir = getTestDirectory();
+	const int blockSize = 512;
+	const int blockCount = 2000;
+	File file = createDataFile(dir, L"data.bin", blockSize * blockCount);
+	vector<unsigned char> buffer(blockSize * blockCount);
+	std::atomic<int> total(0);
+	{
+		AsyncFile asyncFile(file.path(), FileStream::Mode::open);
+		for (int i = 0; i < blockCount; ++i) {
+			asyncFile.readAsync(i * blockSize, buffer.data(), i * blockSize, blockSize, [&] (int transferred, exception_ptr ) {
+				total += transferred;
+			});
+		}
+	} // 소멸자에서 완료를 기다린다
+	testAssert(total == blockSize * blockCount);
+	testAssert(isValid(buffer, 0, buffer.size(), 0));
+}
+
+
+// 동시에 발행하는 요구의 수와 처리량. 사이즈는 동시에 발행하는 요구의 수
+// 파일은 작성 직후라서 시스템 캐시에 있으므로 요구를 처리하는 오버헤드의 측정이 된다
+BALOR_BENCHMARK_SIZES(benchmarkAsyncFileSequential, 1, 4, 16, 64) { // 64KB 블록 256 개를 순서대로 읽는다
+	scopeExit(&removeTestDirectory);
+	const int blockSize = 64 * 1024;
+	const vector<__int64> positions = blockPositions(blockSize, 256, false);
+	File file = createDataFile(getTestDirectory(), L"data.bin", blockSize * 256);
+	AsyncFile asyncFile(file.path(), FileStream::Mode::open);
+	vector<char> buffer(blockSize * benchmark.size());
+	while (benchmark.running()) {
+		readBlocks(asyncFile, positions, blockSize, benchmark.size(), buffer);
+	}
+}
+
+
+BALOR_BENCHMARK_SIZES(benchmarkAsyncFileRandom, 1, 4, 16, 64) { // 4KB 블록 256 개를 무작위 위치에서 읽는다
+	scopeExit(&removeTestDirectory);
+	const int blockSize = 4096;
+	const vector<__int64> positions = blockPositions(blockSize, 256, true);
+	File file = createDataFile(getTestDirectory(), L"data.bin", blockSize * 256);
+	AsyncFile asyncFile(file.path(), FileStream::Mode::open);
+	vector<char> buffer(blockSize * benchmark.size());
+	while (benchmark.running()) {
+		readBlocks(asyncFile, positions, blockSize, benchmark.size(), buffer);
+	}
+}
+
+
+
+		}
+	}
+}
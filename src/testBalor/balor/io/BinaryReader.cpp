@@ -0,0 +1,294 @@
+﻿#include <balor/io/BinaryReader.hpp>
+
+#include <cstring>
+#include <utility>
+#include <vector>
+
+#include <balor/io/BinaryWriter.hpp>
+#include <balor/io/CompressStream.hpp>
+#include <balor/io/DecompressStream.hpp>
+#include <balor/io/MemoryStream.hpp>
+#include <balor/system/windows.hpp>
+#include <balor/test/Benchmark.hpp>
+#include <balor/test/UnitTest.hpp>
+#include <balor/String.hpp>
+
+
+namespace balor {
+	namespace io {
+		namespace testBinaryReader {
+
+
+using std::move;
+using std::vector;
+using balor::test::Benchmark;
+typedef BinaryReader::ByteOrder ByteOrder;
+typedef BinaryReader::Encoding Encoding;
+
+
+namespace {
+const int benchmarkRecordCount = 1024;
+
+
+void writeBenchmarkRecords(Stream& stream) {
+	BinaryWriter writer(stream);
+	for (int i = 0; i < benchmarkRecordCount; ++i) {
+		writer.writeInt32(i);
+		writer.writeFloat(static_cast<float>(i));
+		writer.writeInt64(i);
+	}
+}
+} // namespace
+
+
+
+testCase(construct) {
+	char buffer[] = "\x01\x02\x03\x04";
+	MemoryStream memory(buffer, 0, 4, false);
+
+	// 무효한 파라미터
+	testAssertionFailed(BinaryReader reader(memory, ByteOrder::_enum(-1)));
+	testAssertionFailed(BinaryReader reader(memory, ByteOrder::littleEndian, 15));
+
+	{
+		BinaryReader reader(memory, ByteOrder::bigEndian, 16);
+		testAssert(&reader.stream() == &memory);
+		testAssert(reader.byteOrder() == ByteOrder::bigEndian);
+		testAssert(reader.bufferSize() == 16);
+		testAssert(reader.readByte() == 1);
+		testAssert(memory.position() == 4); // 버퍼에 읽어 들인다
+		reader.sync();
+		testAssert(memory.position() == 1); // 읽다 남은 만큼 되돌린다
+		testAssert(reader.readByte() == 2);
+		testAssert(memory.position() == 4);
+	}
+	testAssert(memory.position() == 4); // 소멸자는 되돌리지 않는다
+
+	memory.position(1);
+	{// move
+		BinaryReader source(memory);
+		BinaryReader reader = move(source);
+		testAssert(reader.readByte() == 2);
+		source = move(reader);
+		testAssertionFailed(reader.sync());
+		testAssert(source.readByte() == 3);
+		source.sync();
+	}
+	testAssert(memory.position() == 3);
+
+	{// 되돌릴 수 없는 스트림도 소멸자에서 skip 하지 않는다
+		MemoryStream compressed;
+		{
+			CompressStream writer(compressed, 16);
+			writer.write(buffer, 0, 4);
+		}
+		compressed.position(0);
+		DecompressStream decompress(compressed, false);
+		{
+			BinaryReader reader(decompress);
+			testAssert(reader.readByte() == 1);
+		}
+		testAssert(decompress.position() == 4);
+	}
+}
+
+
+testCase(roundTrip) {
+	const ByteOrder byteOrders[] = {ByteOrder::littleEndian, ByteOrder::bigEndian};
+	for (int i = 0; i < 2; ++i) {
+		MemoryStream memory;
+		{
+			BinaryWriter writer(memory, byteOrders[i], 16);
+			writer.writeByte(0xab);
+			writer.writeInt16(-2);
+			writer.writeUInt16(0xfedc);
+			writer.writeInt32(-3);
+			writer.writeUInt32(0xfedcba98);
+			writer.writeInt64(-4);
+			writer.writeUInt64(0xfedcba9876543210ULL);
+			writer.writeFloat(1.5f);
+			writer.writeDouble(-0.25);
+			const __int64 varInts[] = {0, 1, -1, 63, 64, -64, -65, 0x7fffffffffffffffLL, -0x7fffffffffffffffLL - 1};
+			for (int j = 0; j < 9; ++j) {
+				writer.writeVarInt(varInts[j]);
+				writer.writeVarUInt(static_cast<unsigned __int64>(varInts[j]));
+			}
+			writer.writeString(L"");
+			writer.writeString(L"abc\x00e9\x3042\xd83d\xde00");
+			writer.writeString(L"abc\x00e9\x3042\xd83d\xde00", Encoding::utf16);
+			writer.writeString(String(L'x', 100)); // 버퍼보다 큰 문자열
+			vector<short> shorts(33);
+			for (int j = 0; j < 33; ++j) {
+				shorts[j] = static_cast<short>(j * 1000 - 16000);
+			}
+			writer.writeArray<short>(shorts);
+			vector<double> doubles(20, 3.25);
+			writer.writeArray<double>(doubles);
+		}
+
+		memory.position(0);
+		BinaryReader reader(memory, byteOrders[i], 16);
+		testAssert(reader.readByte() == 0xab);
+		testAssert(reader.readInt16() == -2);
+		testAssert(reader.readUInt16() == 0xfedc);
+		testAssert(reader.readInt32() == -3);
+		testAssert(reader.readUInt32() == 0xfedcba98);
+		testAssert(reader.readInt64() == -4);
+		testAssert(reader.readUInt64() == 0xfedcba9876543210ULL);
+		testAssert(reader.readFloat() == 1.5f);
+		testAssert(reader.readDouble() == -0.25);
+		const __int64 varInts[] = {0, 1, -1, 63, 64, -64, -65, 0x7fffffffffffffffLL, -0x7fffffffffffffffLL - 1};
+		for (int j = 0; j < 9; ++j) {
+			testAssert(reader.readVarInt() == varInts[j]);
+			testAssert(reader.readVarUInt() == static_cast<unsigned __int64>(varInts[j]));
+		}
+		testAssert(reader.readString() == L"");
+		testAssert(reader.readString() == L"abc\x00e9\x3042\xd83d\xde00");
+		testAssert(reader.readString(Encoding::utf16) == L"abc\x00e9\x3042\xd83d\xde00");
+		testAssert(reader.readString() == String(L'x', 100));
+		vector<short> shorts(33);
+		reader.readArray<short>(shorts);
+		for (int j = 0; j < 33; ++j) {
+			testAssert(shorts[j] == static_cast<short>(j * 1000 - 16000));
+		}
+		vector<double> doubles(20);
+		reader.readArray<double>(doubles);
+		testAssert(doubles == vector<double>(20, 3.25));
+		testThrow(reader.readByte(), BinaryReader::EndOfStreamException);
+	}
+}
+
+
+testCase(readAndSkip) {
+	vector<unsigned char> data(1000);
+	for (int i = 0; i < 1000; ++i) {
+		data[i] = static_cast<unsigned char>(i);
+	}
+	MemoryStream memory(data.data(), 0, data.size(), false);
+	BinaryReader reader(memory, ByteOrder::littleEndian, 16);
+	unsigned char buffer[1000];
+
+	// 무효한 파라미터
+	testAssertionFailed(reader.read(nullptr, 0, 1));
+	testAssertionFailed(reader.read(buffer, -1, 1));
+	testAssertionFailed(reader.read(buffer, 0, -1));
+	testAssertionFailed(reader.skip(-1));
+
+	testAssert(reader.readByte() == 0);
+	testAssert(reader.read(buffer, 0, 5) == 5);
+	testAssert(buffer[0] == 1 && buffer[4] == 5);
+	testAssert(reader.read(buffer, 0, 100) == 100); // 버퍼보다 크다
+	testAssert(buffer[0] == 6 && buffer[99] == 105);
+	reader.skip(3);
+	testAssert(reader.readByte() == 109);
+	reader.skip(500);
+	testAssert(reader.readByte() == static_cast<unsigned char>(610));
+	testAssert(reader.read(buffer, 0, 1000) == 389);
+	testAssert(reader.read(buffer, 0, 1) == 0);
+	reader.skip(1);
+	testThrow(reader.readByte(), BinaryReader::EndOfStreamException);
+}
+
+
+testCase(formatError) {
+	{// 데이터가 모자라다
+		char buffer[] = "\x01\x02\x03";
+		MemoryStream memory(buffer, 0, 3, false);
+		BinaryReader reader(memory);
+		testThrow(reader.readUInt32(), BinaryReader::EndOfStreamException);
+	}
+	{// 64 비트에 들어가지 않는 가변길이 정수
+		char buffer[] = "\xff\xff\xff\xff\xff\xff\xff\xff\xff\x02";
+		MemoryStream memory(buffer, 0, 10, false);
+		BinaryReader reader(memory);
+		testThrow(reader.readVarUInt(), BinaryReader::FormatException);
+	}
+	{// 10 바이트를 넘는 가변길이 정수
+		char buffer[] = "\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff\x00";
+		MemoryStream memory(buffer, 0, 11, false);
+		BinaryReader reader(memory);
+		testThrow(reader.readVarInt(), BinaryReader::FormatException);
+	}
+	{// 10 바이트째에 부호 비트 이외의 비트가 있는 부호있는 가변길이 정수
+		char buffer[] = "\x80\x80\x80\x80\x80\x80\x80\x80\x80\x01";
+		MemoryStream memory(buffer, 0, 10, false);
+		BinaryReader reader(memory);
+		testThrow(reader.readVarInt(), BinaryReader::FormatException);
+	}
+	{// 10 바이트째는 0x00 이나 0x7f 만
+		char buffer[] = "\xff\xff\xff\xff\xff\xff\xff\xff\xff\x00\x80\x80\x80\x80\x80\x80\x80\x80\x80\x7f";
+		MemoryStream memory(buffer, 0, 20, false);
+		BinaryReader reader(memory);
+		testAssert(reader.readVarInt() == 0x7fffffffffffffffLL);
+		testAssert(reader.readVarInt() == static_cast<__int64>(0x8000000000000000ULL));
+	}
+	{// 도중에 끊긴 가변길이 정수
+		char buffer[] = "\x80\x80";
+		MemoryStream memory(buffer, 0, 2, false);
+		BinaryReader reader(memory);
+		testThrow(reader.readVarUInt(), BinaryReader::EndOfStreamException);
+	}
+	{// 문자열의 바이트 수가 데이터보다 길다
+		char buffer[] = "\x05" "abc";
+		MemoryStream memory(buffer, 0, 4, false);
+		BinaryReader reader(memory);
+		testThrow(reader.readString(), BinaryReader::EndOfStreamException);
+	}
+	{// UTF-16 의 바이트 수가 홀수
+		char buffer[] = "\x03" "abc";
+		MemoryStream memory(buffer, 0, 4, false);
+		BinaryReader reader(memory);
+		testThrow(reader.readString(Encoding::utf16), BinaryReader::FormatException);
+	}
+	{// UTF-8 로서 올바르지 않은 바이트는 U+FFFD 로 치환한다
+		char buffer[] = "\x05" "a\x80\xe3\x81" "b";
+		MemoryStream memory(buffer, 0, 6, false);
+		BinaryReader reader(memory);
+		testAssert(reader.readString() == L"a\xfffd\xfffd" L"b");
+	}
+}
+
+
+// 필드마다 Stream::read 를 부르는 경우와 BinaryReader 의 비교. 한 번에 benchmarkRecordCount 개의 레코드를 읽는다
+BALOR_BENCHMARK(benchmarkBinaryReaderStreamRead) {
+	MemoryStream memory;
+	writeBenchmarkRecords(memory);
+	Stream& stream = memory;
+	__int64 sum = 0;
+	while (benchmark.running()) {
+		memory.position(0);
+		for (int i = 0; i < benchmarkRecordCount; ++i) {
+			int value;
+			float position;
+			__int64 id;
+			stream.read(&value, 0, sizeof(value));
+			stream.read(&position, 0, sizeof(position));
+			stream.read(&id, 0, sizeof(id));
+			sum += value + id;
+		}
+	}
+	Benchmark::doNotOptimize(sum);
+}
+
+
+BALOR_BENCHMARK(benchmarkBinaryReaderRead) {
+	MemoryStream memory;
+	writeBenchmarkRecords(memory);
+	__int64 sum = 0;
+	while (benchmark.running()) {
+		memory.position(0);
+		BinaryReader reader(memory);
+		for (int i = 0; i < benchmarkRecordCount; ++i) {
+			const int value = reader.readInt32();
+			reader.readFloat();
+			sum += value + reader.readInt64();
+		}
+	}
+	Benchmark::doNotOptimize(sum);
+}
+
+
+
+		}
+	}
+}
@@ -0,0 +1,261 @@
+﻿#include <balor/io/BinaryWriter.hpp>
+
+#include <cstring>
+#include <utility>
+#include <vector>
+
+#include <balor/io/MemoryStream.hpp>
+#include <balor/system/windows.hpp>
+#include <balor/test/Benchmark.hpp>
+#include <balor/test/UnitTest.hpp>
+#include <balor/String.hpp>
+
+
+namespace balor {
+	namespace io {
+		namespace testBinaryWriter {
+
+
+using std::move;
+using std::vector;
+typedef BinaryWriter::ByteOrder ByteOrder;
+typedef BinaryWriter::Encoding Encoding;
+
+
+namespace {
+bool equals(const MemoryStream& stream, const char* expected, int length) {
+	return stream.length() == length && std::memcmp(stream.buffer(), expected, length) == 0;
+}
+} // namespace
+
+
+
+testCase(construct) {
+	MemoryStream memory;
+
+	// 무효한 파라미터
+	testAssertionFailed(BinaryWriter writer(memory, ByteOrder::_enum(-1)));
+	testAssertionFailed(BinaryWriter writer(memory, ByteOrder::littleEndian, 15));
+	{
+		char buffer[4];
+		MemoryStream readOnly(buffer, false);
+		testAssertionFailed(BinaryWriter writer(readOnly));
+	}
+
+	{
+		BinaryWriter writer(memory, ByteOrder::bigEndian, 64);
+		testAssert(&writer.stream() == &memory);
+		testAssert(writer.byteOrder() == ByteOrder::bigEndian);
+		testAssert(writer.bufferSize() == 64);
+		writer.byteOrder(ByteOrder::littleEndian);
+		testAssert(writer.byteOrder() == ByteOrder::littleEndian);
+		testAssertionFailed(writer.byteOrder(ByteOrder::_enum(-1)));
+		writer.writeByte(1);
+		testAssert(memory.length() == 0); // 버퍼에 쌓인다
+	}
+	testAssert(memory.length() == 1); // 소멸자로 써낸다
+
+	{// 써내기에 실패해도 소멸자는 예외를 던지지 않는다
+		char buffer[4];
+		MemoryStream fixed(buffer);
+		{
+			BinaryWriter writer(fixed, ByteOrder::littleEndian, 16);
+			for (int i = 0; i < 8; ++i) {
+				writer.writeByte(1);
+			}
+			testThrow(writer.flush(), MemoryStream::BufferOverrunException);
+			for (int i = 0; i < 8; ++i) {
+				writer.writeByte(1);
+			}
+		}
+	}
+
+	{// move
+		MemoryStream memory2;
+		BinaryWriter source(memory2);
+		source.writeByte(2);
+		BinaryWriter writer = move(source);
+		testAssert(&writer.stream() == &memory2);
+		source = move(writer);
+		source.flush();
+		testAssert(memory2.length() == 1);
+	}
+}
+
+
+testCase(fixedWidth) {
+	{// 리틀 엔디안
+		MemoryStream memory;
+		{
+			BinaryWriter writer(memory);
+			writer.writeByte(0x01);
+			writer.writeInt16(0x0203);
+			writer.writeUInt16(0xfffe);
+			writer.writeInt32(0x04050607);
+			writer.writeUInt32(0x08090a0b);
+			writer.writeInt64(-2);
+			writer.writeUInt64(0x1122334455667788ULL);
+			writer.writeFloat(1.0f);
+			writer.writeDouble(-2.0);
+		}
+		const char expected[] = "\x01" "\x03\x02" "\xfe\xff" "\x07\x06\x05\x04" "\x0b\x0a\x09\x08"
+			"\xfe\xff\xff\xff\xff\xff\xff\xff" "\x88\x77\x66\x55\x44\x33\x22\x11" "\x00\x00\x80\x3f" "\x00\x00\x00\x00\x00\x00\x00\xc0";
+		testAssert(equals(memory, expected, sizeof(expected) - 1));
+	}
+	{// 빅 엔디안
+		MemoryStream memory;
+		{
+			BinaryWriter writer(memory, ByteOrder::bigEndian);
+			writer.writeInt16(0x0203);
+			writer.writeInt32(0x04050607);
+			writer.writeUInt64(0x1122334455667788ULL);
+			writer.writeFloat(1.0f);
+		}
+		const char expected[] = "\x02\x03" "\x04\x05\x06\x07" "\x11\x22\x33\x44\x55\x66\x77\x88" "\x3f\x80\x00\x00";
+		testAssert(equals(memory, expected, sizeof(expected) - 1));
+	}
+}
+
+
+testCase(varInt) {
+	{// 부호 없음
+		MemoryStream memory;
+		{
+			BinaryWriter writer(memory);
+			writer.writeVarUInt(0);
+			writer.writeVarUInt(127);
+			writer.writeVarUInt(128);
+			writer.writeVarUInt(624485);
+			writer.writeVarUInt(0xffffffffffffffffULL);
+		}
+		const char expected[] = "\x00" "\x7f" "\x80\x01" "\xe5\x8e\x26" "\xff\xff\xff\xff\xff\xff\xff\xff\xff\x01";
+		testAssert(equals(memory, expected, sizeof(expected) - 1));
+	}
+	{// 부호 있음
+		MemoryStream memory;
+		{
+			BinaryWriter writer(memory);
+			writer.writeVarInt(0);
+			writer.writeVarInt(-1);
+			writer.writeVarInt(63);
+			writer.writeVarInt(64);
+			writer.writeVarInt(-64);
+			writer.writeVarInt(-65);
+			writer.writeVarInt(-123456);
+		}
+		const char expected[] = "\x00" "\x7f" "\x3f" "\xc0\x00" "\x40" "\xbf\x7f" "\xc0\xbb\x78";
+		testAssert(equals(memory, expected, sizeof(expected) - 1));
+	}
+}
+
+
+testCase(writeString) {
+	MemoryStream memory;
+	{
+		BinaryWriter writer(memory);
+
+		// 무효한 파라미터
+		testAssertionFailed(writer.writeString(L"", Encoding::_enum(-1)));
+
+		writer.writeString(L"");
+		writer.writeString(L"a\x00e9\x3042");
+		writer.writeString(L"\xd83d\xde00"); // 서로게이트 페어는 4 바이트
+		writer.writeString(L"a\x3042", Encoding::utf16);
+		writer.byteOrder(ByteOrder::bigEndian);
+		writer.writeString(L"a\x3042", Encoding::utf16);
+	}
+	const char expected[] = "\x00" "\x06" "a" "\xc3\xa9" "\xe3\x81\x82" "\x04\xf0\x9f\x98\x80" "\x04" "a\x00\x42\x30" "\x04" "\x00" "a\x30\x42";
+	testAssert(equals(memory, expected, sizeof(expected) - 1));
+}
+
+
+testCase(writeArray) {
+	vector<unsigned int> values;
+	for (unsigned int i = 0; i < 1000; ++i) {
+		values.push_back(i * 0x01020304);
+	}
+	const ByteOrder byteOrders[] = {ByteOrder::littleEndian, ByteOrder::bigEndian};
+	for (int i = 0; i < 2; ++i) {
+		MemoryStream memory;
+		{
+			BinaryWriter writer(memory, byteOrders[i], 100); // 버퍼보다 큰 배열
+			writer.writeByte(0); // 정렬되어 있지 않은 위치
+			writer.writeArray<unsigned int>(values);
+		}
+		testAssert(memory.length() == 1 + 4000);
+		memory.position(1);
+		MemoryStream expected;
+		{
+			BinaryWriter writer(expected, byteOrders[i]);
+			for (int j = 0; j < 1000; ++j) {
+				writer.writeUInt32(values[j]);
+			}
+		}
+		testAssert(std::memcmp(static_cast<const char*>(memory.buffer()) + 1, expected.buffer(), 4000) == 0);
+	}
+
+	{// swapByteOrder
+		const unsigned char source[] = {1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16, 17, 18, 19, 20, 21, 22, 23, 24};
+		unsigned char destination[24];
+		BinaryWriter::swapByteOrder(destination, source, 12, 2);
+		testAssert(destination[0] == 2 && destination[1] == 1 && destination[22] == 24 && destination[23] == 23);
+		BinaryWriter::swapByteOrder(destination, source, 6, 4);
+		testAssert(destination[0] == 4 && destination[3] == 1 && destination[20] == 24 && destination[23] == 21);
+		BinaryWriter::swapByteOrder(destination, source, 3, 8);
+		testAssert(destination[0] == 8 && destination[7] == 1 && destination[16] == 24 && destination[23] == 17);
+		BinaryWriter::swapByteOrder(destination, destination, 3, 8); // 같은 버퍼
+		testAssert(std::memcmp(destination, source, 24) == 0);
+		testAssertionFailed(BinaryWriter::swapByteOrder(destination, source, 1, 3));
+	}
+}
+
+
+// 필드마다 Stream::write 를 부르는 경우와 BinaryWriter 의 비교. 한 번에 1024 개의 레코드를 쓴다
+BALOR_BENCHMARK(benchmarkBinaryWriterStreamWrite) {
+	const int count = 1024;
+	MemoryStream memory(count * 16);
+	Stream& stream = memory;
+	while (benchmark.running()) {
+		memory.position(0);
+		for (int i = 0; i < count; ++i) {
+			const int value = i;
+			const float position = static_cast<float>(i);
+			const __int64 id = i;
+			stream.write(&value, 0, sizeof(value));
+			stream.write(&position, 0, sizeof(position));
+			stream.write(&id, 0, sizeof(id));
+		}
+	}
+}
+
+
+BALOR_BENCHMARK(benchmarkBinaryWriterWrite) {
+	const int count = 1024;
+	MemoryStream memory(count * 16);
+	while (benchmark.running()) {
+		memory.position(0);
+		BinaryWriter writer(memory);
+		for (int i = 0; i < count; ++i) {
+			writer.writeInt32(i);
+			writer.writeFloat(static_cast<float>(i));
+			writer.writeInt64(i);
+		}
+	}
+}
+
+
+BALOR_BENCHMARK(benchmarkBinaryWriterSwapArray) { // 64KB 의 double 배열을 빅 엔디안으로 쓴다
+	const vector<double> values(8 * 1024);
+	MemoryStream memory(values.size() * 8);
+	while (benchmark.running()) {
+		memory.position(0);
+		BinaryWriter writer(memory, ByteOrder::bigEndian, 64 * 1024);
+		writer.writeArray<double>(values);
+	}
+}
+
+
+
+		}
+	}
+}
@@ -0,0 +1,351 @@
+﻿#include <balor/io/BufferedStream.hpp>
+
+#include <utility>
+#include <vector>
+
+#include <balor/io/File.hpp>
+#include <balor/io/FileStream.hpp>
+#include <balor/io/MemoryStream.hpp>
+#include <balor/system/windows.hpp>
+#include <balor/test/Benchmark.hpp>
+#include <balor/test/UnitTest.hpp>
+#include <balor/scopeExit.hpp>
+#include <balor/String.hpp>
+
+
+namespace balor {
+	namespace io {
+		namespace testBufferedStream {
+
+
+using std::move;
+using std::vector;
+using namespace balor::test;
+
+
+namespace {
+const wchar_t testDirectoryName[] = L"testBalor_io_BufferedStream_3kd8fj2ns0vq7xl1mz9ap4ru";
+File getTestDirectory() {
+	File dir(File::getSpecial(File::Special::temporary), testDirectoryName);
+	if (dir.exists()) {
+		dir.remove(true);
+	}
+	dir.createDirectory();
+	return dir;
+}
+
+
+void removeTestDirectory() {
+	File(File::getSpecial(File::Special::temporary), testDirectoryName).remove(true);
+}
+
+
+class CountingStream : public MemoryStream { // read, write 의 호출 횟수를 센다
+public:
+	using Stream::read;
+	using Stream::write;
+
+	CountingStream() : readCount(0), writeCount(0) {}
+	virtual int read(void* buffer, int offset, int count) {
+		++readCount;
+		return MemoryStream::read(buffer, offset, count);
+	}
+	virtual void write(const void* buffer, int offset, int count) {
+		++writeCount;
+		MemoryStream::write(buffer, offset, count);
+	}
+
+	int readCount;
+	int writeCount;
+};
+
+
+void writeSequence(Stream& stream, int count) {
+	for (int i = 0; i < count; ++i) {
+		stream.write(static_cast<unsigned char>(i));
+	}
+	stream.position(0);
+}
+
+
+File createBenchmarkFile(const File& dir) {
+	File file(dir, L"data.bin");
+	const int size = 1024 * 1024;
+	vector<unsigned char> data(size);
+	for (int i = 0; i < size; ++i) {
+		data[i] = static_cast<unsigned char>(i * 7);
+	}
+	auto stream = file.create();
+	stream.write(data.data(), 0, size);
+	return file;
+}
+} // namespace
+
+
+
+testCase(construct) {
+	MemoryStream base;
+
+	// 무효한 파라미터
+	testAssertionFailed(BufferedStream(base, 0));
+
+	BufferedStream stream(base, 16);
+	testAssert(&stream.stream() == &base);
+	testAssert(stream.bufferSize() == 16);
+	testAssert(stream.readable());
+	testAssert(stream.writable());
+	testAssert(stream.position() == 0);
+	testAssert(stream.length() == 0);
+}
+
+
+testCase(moveConstructAndAssignment) {
+	MemoryStream base;
+	writeSequence(base, 10);
+	BufferedStream stream0(base, 4);
+	testAssert(stream0.readByte() == 0);
+
+	BufferedStream stream1 = move(stream0);
+	testAssertionFailed(stream0.position());
+	testAssert(stream1.readByte() == 1);
+
+	MemoryStream otherBase;
+	BufferedStream stream2(otherBase, 4);
+	stream2 = move(stream1);
+	testAssert(&stream2.stream() == &base);
+	testAssert(stream2.readByte() == 2);
+}
+
+
+testCase(destruct) {
+	{// 쓰기 버퍼를 써낸다
+		MemoryStream base;
+		{
+			BufferedStream stream(base, 16);
+			stream.write("abc", 0, 3);
+			testAssert(base.length() == 0);
+		}
+		testAssert(base.length() == 3);
+		testAssert(base.position() == 3);
+	}
+	{// 읽다 남은 만큼 원래 스트림의 위치를 되돌린다
+		MemoryStream base;
+		writeSequence(base, 10);
+		{
+			BufferedStream stream(base, 16);
+			testAssert(stream.readByte() == 0);
+			testAssert(stream.readByte() == 1);
+			testAssert(base.position() == 10);
+		}
+		testAssert(base.position() == 2);
+	}
+}
+
+
+testCase(flush) {
+	CountingStream base;
+	BufferedStream stream(base, 16);
+	stream.write("abc", 0, 3);
+	testAssert(base.writeCount == 0);
+	stream.flush();
+	testAssert(base.writeCount == 1);
+	testAssert(base.length() == 3);
+	stream.flush();
+	testAssert(base.writeCount == 1);
+}
+
+
+testCase(lengthAndPosition) {
+	MemoryStream base;
+	writeSequence(base, 100);
+	BufferedStream stream(base, 16);
+
+	// 무효한 파라미터
+	testAssertionFailed(stream.position(-1));
+
+	testAssert(stream.length() == 100);
+	testAssert(stream.readByte() == 0);
+	testAssert(stream.position() == 1);
+
+	// 읽기 버퍼 안에서의 이동은 원래 스트림에 접근하지 않는다
+	stream.position(10);
+	testAssert(base.position() == 16);
+	testAssert(stream.readByte() == 10);
+	stream.position(0);
+	testAssert(stream.readByte() == 0);
+
+	// 버퍼 밖으로 이동
+	stream.position(50);
+	testAssert(stream.position() == 50);
+	testAssert(stream.readByte() == 50);
+
+	// 써내지 않은 데이터도 길이에 포함한다
+	stream.position(98);
+	stream.write("abcd", 0, 4);
+	testAssert(stream.position() == 102);
+	testAssert(stream.length() == 102);
+	testAssert(base.length() == 100);
+	stream.position(0);
+	testAssert(base.length() == 102);
+	testAssert(stream.readByte() == 0);
+}
+
+
+testCase(read) {
+	CountingStream base;
+	writeSequence(base, 100);
+	BufferedStream stream(base, 16);
+	unsigned char buffer[64] = {0};
+
+	// 무효한 파라미터
+	testAssertionFailed(stream.read(nullptr, 0, 1));
+	testAssertionFailed(stream.read(buffer, -1, 1));
+	testAssertionFailed(stream.read(buffer, 0, -1));
+
+	// 작은 읽기는 한 번의 읽기로 정리한다
+	base.readCount = 0;
+	for (int i = 0; i < 16; ++i) {
+		testAssert(stream.read() == i);
+	}
+	testAssert(base.readCount == 1);
+	testAssert(stream.read(buffer, 1, 3) == 3);
+	testAssert(buffer[1] == 16 && buffer[2] == 17 && buffer[3] == 18);
+	testAssert(base.readCount == 2);
+
+	// 버퍼의 나머지와 새로 채운 버퍼에 걸친 읽기
+	testAssert(stream.read(buffer, 0, 20) == 20);
+	testAssert(buffer[0] == 19 && buffer[19] == 38);
+	testAssert(base.readCount == 3);
+
+	// 버퍼보다 큰 읽기는 직접 읽는다
+	testAssert(stream.read(buffer, 0, 40) == 40);
+	testAssert(buffer[0] == 39 && buffer[39] == 78);
+	testAssert(stream.position() == 79);
+
+	// 끝에 도달
+	testAssert(stream.read(buffer, 0, 64) == 21);
+	testAssert(stream.read(buffer, 0, 64) == 0);
+	testAssert(stream.readByte() == -1);
+	testAssert(stream.read() == -1);
+}
+
+
+testCase(skip) {
+	MemoryStream base;
+	writeSequence(base, 100);
+	BufferedStream stream(base, 16);
+
+	testAssert(stream.readByte() == 0);
+	testAssert(stream.skip(4) == 4);
+	testAssert(stream.readByte() == 5);
+	testAssert(stream.skip(-3) == -3);
+	testAssert(stream.readByte() == 3);
+	testAssert(base.position() == 16);
+
+	// 버퍼 밖으로 이동
+	testAssert(stream.skip(40) == 40);
+	testAssert(stream.position() == 44);
+	testAssert(stream.readByte() == 44);
+	testAssert(stream.skip(-45) == -45);
+	testAssert(stream.readByte() == 0);
+
+	// 쓰기 중의 이동
+	stream.position(10);
+	stream.write("ab", 0, 2);
+	testAssert(stream.skip(3) == 3);
+	testAssert(stream.position() == 15);
+	testAssert(stream.readByte() == 15);
+	stream.position(10);
+	testAssert(stream.readByte() == 'a');
+	testAssert(stream.readByte() == 'b');
+}
+
+
+testCase(write) {
+	CountingStream base;
+	BufferedStream stream(base, 16);
+	unsigned char buffer[64];
+	for (int i = 0; i < 64; ++i) {
+		buffer[i] = static_cast<unsigned char>(i);
+	}
+
+	// 무효한 파라미터
+	testAssertionFailed(stream.write(nullptr, 0, 1));
+	testAssertionFailed(stream.write(buffer, -1, 1));
+	testAssertionFailed(stream.write(buffer, 0, -1));
+
+	// 작은 쓰기는 한 번의 쓰기로 정리한다
+	for (int i = 0; i < 16; ++i) {
+		stream.writeByte(static_cast<unsigned char>(i));
+	}
+	testAssert(base.writeCount == 0);
+	stream.write(static_cast<unsigned char>(16));
+	testAssert(base.writeCount == 1);
+	testAssert(base.length() == 16);
+
+	// 버퍼보다 큰 쓰기는 직접 쓴다
+	stream.write(buffer, 17, 40);
+	testAssert(base.writeCount == 3);
+	testAssert(base.length() == 57);
+	stream.flush();
+	base.position(0);
+	for (int i = 0; i < 57; ++i) {
+		testAssert(base.read() == i);
+	}
+
+	// 읽기에서 쓰기로 전환
+	MemoryStream base1;
+	writeSequence(base1, 10);
+	{
+		BufferedStream stream1(base1, 16);
+		testAssert(stream1.readByte() == 0);
+		testAssert(stream1.readByte() == 1);
+		stream1.writeByte('x');
+		testAssert(stream1.readByte() == 3);
+	}
+	base1.position(2);
+	testAssert(base1.read() == 'x');
+	testAssert(base1.length() == 10);
+}
+
+
+// 1 바이트씩 읽기. FileStream 직접과 BufferedStream 경유의 비교
+BALOR_BENCHMARK(benchmarkBufferedStreamFileStreamRead) {
+	scopeExit(&removeTestDirectory);
+	File file = createBenchmarkFile(getTestDirectory());
+	auto stream = file.openRead();
+	int sum = 0;
+	while (benchmark.running()) {
+		const int c = stream.read();
+		if (c == -1) {
+			stream.position(0);
+		} else {
+			sum += c;
+		}
+	}
+	Benchmark::doNotOptimize(sum);
+}
+
+
+BALOR_BENCHMARK(benchmarkBufferedStreamReadByte) {
+	scopeExit(&removeTestDirectory);
+	File file = createBenchmarkFile(getTestDirectory());
+	auto fileStream = file.openRead();
+	BufferedStream stream(fileStream);
+	int sum = 0;
+	while (benchmark.running()) {
+		const int c = stream.readByte();
+		if (c == -1) {
+			stream.position(0);
+		} else {
+			sum += c;
+		}
+	}
+	Benchmark::doNotOptimize(sum);
+}
+
+
+
+		}
+	}
+}
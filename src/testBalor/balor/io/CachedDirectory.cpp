@@ -0,0 +1,208 @@
+﻿#include <balor/io/CachedDirectory.hpp>
+
+#include <vector>
+#include <boost/thread.hpp>
+
+#include <balor/io/DirectoryWalker.hpp>
+#include <balor/io/File.hpp>
+#include <balor/io/FileStream.hpp>
+#include <balor/system/windows.hpp>
+#include <balor/test/UnitTest.hpp>
+#include <balor/scopeExit.hpp>
+#include <balor/String.hpp>
+
+
+namespace balor {
+	namespace io {
+		namespace testCachedDirectory {
+
+using std::vector;
+
+
+namespace {
+const wchar_t testDirectoryName[] = L"testBalor_io_CachedDirectory_q3n8vd1kz6ye0r5t";
+const wchar_t outsideDirectoryName[] = L"testBalor_io_CachedDirectory_outside_m2c7hx4w";
+File getTestDirectory() {
+	File dir(File::getSpecial(File::Special::temporary), testDirectoryName);
+	if (dir.exists()) {
+		dir.remove(true);
+	}
+	dir.createDirectory();
+	return dir.fullPathFile();
+}
+
+
+void removeTestDirectory() {
+	File(File::getSpecial(File::Special::temporary), testDirectoryName).remove(true);
+	File outside(File::getSpecial(File::Special::temporary), outsideDirectoryName);
+	if (outside.exists()) {
+		outside.remove(true);
+	}
+}
+
+
+void createTree(const File& dir) { // a/b/c 의 3 단계 디렉토리에 각각 파일 5 개씩
+	File sub = dir;
+	for (int i = 0; i < 3; ++i) {
+		sub = File(sub, String() + static_cast<wchar_t>(L'a' + i));
+		sub.createDirectory();
+		for (int j = 0; j < 5; ++j) {
+			File(sub, String() + L"file" + j).create();
+		}
+	}
+}
+
+
+template<typename Predicate>
+bool waitUntil(Predicate predicate) { // 최대 5 초 기다린다
+	for (int i = 0; i < 500; ++i) {
+		if (predicate()) {
+			return true;
+		}
+		Sleep(10);
+	}
+	return false;
+}
+
+
+bool contains(const CachedDirectory& cache, const File& file) {
+	File::Info info;
+	return cache.find(file.path(), info);
+}
+} // namespace
+
+
+
+testCase(construct) {
+	scopeExit(&removeTestDirectory);
+	File dir = getTestDirectory();
+	createTree(dir);
+	File(dir, L"top").create();
+
+	// 무효한 파라미터
+	testAssertionFailed(CachedDirectory cache((File())));
+	testAssertionFailed(CachedDirectory cache(dir, true, -1));
+
+	// 존재하지 않는 디렉토리
+	testThrow(CachedDirectory cache(File(dir, L"notFound")), File::NotFoundException);
+
+	{// 처음에 모두 열거한다
+		CachedDirectory cache(dir);
+		testAssert(String::equals(cache.directory().path(), dir.path()));
+		testAssert(cache.size() == 19);
+		testAssert(cache.rescanCount() == 0);
+		const auto infos = cache.infos();
+		testAssert(infos.size() == 19);
+		for (int i = 1, end = infos.size(); i < end; ++i) { // 경로 순서로 정렬되어 있다
+			testAssert(String::compare(infos[i - 1].file().path(), infos[i].file().path()) < 0);
+		}
+		File::Info info;
+		testAssert(cache.find(File(dir, L"a").path(), info));
+		testAssert(info.isDirectory());
+		testAssert(!cache.find(File(dir, L"none").path(), info));
+	}
+	{// 직하만
+		CachedDirectory cache(dir, false);
+		testAssert(cache.size() == 2);
+		testAssert(contains(cache, File(dir, L"a")));
+		testAssert(contains(cache, File(dir, L"top")));
+	}
+}
+
+
+testCase(update) {
+	scopeExit(&removeTestDirectory);
+	File dir = getTestDirectory();
+	createTree(dir);
+	int updateCount = 0;
+	bool rescanned = false;
+	CachedDirectory* sender = nullptr;
+	boost::mutex mutex;
+	CachedDirectory cache(dir, true, 20, [&] (CachedDirectory::Update& e) { // 감시 스레드에서 불린다
+		boost::mutex::scoped_lock lock(mutex);
+		++updateCount;
+		rescanned = rescanned || e.rescanned();
+		sender = &e.sender();
+	});
+	const int initialSize = cache.size();
+
+	// 작성과 변경
+	File file(dir, L"new.txt");
+	{
+		auto stream = file.create();
+		stream.write("abcde", 0, 5);
+	}
+	testAssert(waitUntil([&] () -> bool {
+		File::Info info;
+		return cache.find(file.path(), info) && info.length() == 5;
+	}));
+	testAssert(cache.size() == initialSize + 1);
+
+	// 이름을 바꾼 디렉토리 아래는 다시 열거하지 않고 경로를 바꾼다
+	File a(dir, L"a");
+	File z(dir, L"z");
+	a.moveTo(z);
+	testAssert(waitUntil([&] () { return contains(cache, File(z, L"b\\c\\file4")); }));
+	testAssert(!contains(cache, File(a, L"b\\c\\file4")));
+	testAssert(!contains(cache, a));
+	testAssert(contains(cache, z));
+	testAssert(cache.size() == initialSize + 1);
+
+	// 밖에서 옮겨 온 디렉토리는 아래를 열거한다
+	File outside(File::getSpecial(File::Special::temporary), outsideDirectoryName);
+	if (outside.exists()) {
+		outside.remove(true);
+	}
+	outside.createDirectory();
+	createTree(outside);
+	File moved(dir, L"moved");
+	outside.moveTo(moved);
+	testAssert(waitUntil([&] () { return contains(cache, File(moved, L"a\\b\\c\\file0")); }));
+	testAssert(waitUntil([&] () { return cache.size() == initialSize + 1 + 19; }));
+
+	// 디렉토리를 삭제하면 아래도 지운다
+	z.remove(true);
+	testAssert(waitUntil([&] () { return !contains(cache, z); }));
+	testAssert(waitUntil([&] () { return cache.size() == 1 + 19; }));
+
+	// 파일 삭제
+	file.remove();
+	testAssert(waitUntil([&] () { return !contains(cache, file); }));
+
+	// 전체를 다시 열거한 결과와 일치한다
+	testAssert(waitUntil([&] () { return cache.size() == 19; }));
+	DirectoryWalker walker(dir);
+	File::Info info;
+	int count = 0;
+	while (walker.next(info)) {
+		File::Info cached;
+		testAssert(cache.find(info.file().path(), cached));
+		testAssert(cached.isDirectory() == info.isDirectory());
+		testAssert(cached.length() == info.length());
+		++count;
+	}
+	testAssert(count == cache.size());
+	testAssert(cache.rescanCount() == 0);
+	boost::mutex::scoped_lock lock(mutex);
+	testAssert(0 < updateCount);
+	testAssert(!rescanned);
+	testAssert(sender == &cache);
+}
+
+
+testCase(rescan) {
+	scopeExit(&removeTestDirectory);
+	File dir = getTestDirectory();
+	createTree(dir);
+	CachedDirectory cache(dir);
+	const int size = cache.size();
+	cache.rescan();
+	testAssert(cache.rescanCount() == 1);
+	testAssert(cache.size() == size);
+}
+
+
+
+		}
+	}
+}
@@ -0,0 +1,324 @@
+﻿#include <balor/io/CompressStream.hpp>
+
+#include <cstring>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include <balor/io/DecompressStream.hpp>
+#include <balor/io/MemoryStream.hpp>
+#include <balor/system/TaskScheduler.hpp>
+#include <balor/system/windows.hpp>
+#include <balor/test/Benchmark.hpp>
+#include <balor/test/UnitTest.hpp>
+#include <balor/String.hpp>
+
+
+namespace balor {
+	namespace io {
+		namespace testCompressStream {
+
+
+using std::move;
+using std::vector;
+using balor::system::Task;
+using balor::system::TaskScheduler;
+
+
+namespace {
+vector<unsigned char> createText(int size) { // 압축하기 쉬운 데이터
+	const char words[] = "balor stream compress block index thread ";
+	vector<unsigned char> data(size);
+	unsigned int seed = 1;
+	for (int i = 0; i < size; ++i) {
+		seed = seed * 1103515245 + 12345;
+		data[i] = (seed >> 24) % 16 ? words[(i + (i >> 10)) % (sizeof(words) - 1)] : static_cast<unsigned char>(seed >> 16);
+	}
+	return data;
+}
+
+
+vector<unsigned char> createRandom(int size) { // 압축할 수 없는 데이터
+	vector<unsigned char> data(size);
+	unsigned int seed = 12345;
+	for (int i = 0; i < size; ++i) {
+		seed = seed * 1103515245 + 12345;
+		data[i] = static_cast<unsigned char>(seed >> 16);
+	}
+	return data;
+}
+
+
+vector<unsigned char> compress(const vector<unsigned char>& data, int blockSize, int threadCount) {
+	MemoryStream memory;
+	{
+		CompressStream stream(memory, blockSize, threadCount);
+		if (!data.empty()) {
+			stream.write(data.data(), 0, data.size());
+		}
+	}
+	const unsigned char* buffer = static_cast<const unsigned char*>(memory.buffer());
+	return vector<unsigned char>(buffer, buffer + memory.length());
+}
+
+
+vector<unsigned char> decompress(vector<unsigned char>& compressed, bool loadIndex) {
+	MemoryStream memory(compressed.data(), 0, compressed.size(), false);
+	DecompressStream stream(memory, loadIndex);
+	vector<unsigned char> result;
+	unsigned char buffer[1000];
+	for (int count = stream.read(buffer, 0, sizeof(buffer)); count; count = stream.read(buffer, 0, sizeof(buffer))) {
+		result.insert(result.end(), buffer, buffer + count);
+	}
+	return result;
+}
+
+
+class WriteFailedException {};
+
+
+class FailingStream : public MemoryStream { // failing 이 true 이면 쓰기에 실패한다
+public:
+	FailingStream() : failing(false) {}
+
+	using MemoryStream::write;
+	virtual void write(const void* buffer, int offset, int count) {
+		if (failing) {
+			throw WriteFailedException();
+		}
+		MemoryStream::write(buffer, offset, count);
+	}
+	virtual void writev(ArrayRange<const Stream::ConstSlice> slices) {
+		if (failing) {
+			throw WriteFailedException();
+		}
+		MemoryStream::writev(slices);
+	}
+
+	bool failing;
+};
+} // namespace
+
+
+
+testCase(construct) {
+	MemoryStream memory;
+
+	// 무효한 파라미터
+	testAssertionFailed(CompressStream stream(memory, 0));
+	testAssertionFailed(CompressStream stream(memory, CompressStream::maxBlockSize + 1));
+	testAssertionFailed(CompressStream stream(memory, 1024, 0));
+	{
+		unsigned char buffer[16];
+		MemoryStream readOnly(buffer, false);
+		testAssertionFailed(CompressStream stream(readOnly));
+	}
+
+	{// 헤더를 쓴다
+		CompressStream stream(memory, 1024, 2);
+		testAssert(&stream.stream() == &memory);
+		testAssert(stream.blockSize() == 1024);
+		testAssert(stream.threadCount() == 2);
+		testAssert(!stream.readable());
+		testAssert(stream.writable());
+		testAssert(stream.position() == 0);
+		testAssert(memory.length() == 12);
+		testAssert(std::memcmp(memory.buffer(), "BLZ4", 4) == 0);
+		testAssert(!stream.finished());
+	}
+	// 소멸자로 finish 한다
+	testAssert(std::memcmp(static_cast<const char*>(memory.buffer()) + memory.length() - 4, "BLZI", 4) == 0);
+
+	{// move
+		MemoryStream memory2;
+		CompressStream source(memory2);
+		CompressStream stream = move(source);
+		testAssert(&stream.stream() == &memory2);
+		source = move(stream);
+		testAssert(&source.stream() == &memory2);
+	}
+}
+
+
+testCase(compressBlock) {
+	vector<unsigned char> text = createText(10000);
+	vector<unsigned char> compressed(CompressStream::maxCompressedLength(text.size()));
+	const int length = CompressStream::compressBlock(text, compressed);
+	testAssert(0 < length && length < static_cast<int>(text.size()) / 2);
+	vector<unsigned char> result(text.size());
+	DecompressStream::decompressBlock(ArrayRange<const unsigned char>(compressed.data(), length), result);
+	testAssert(result == text);
+
+	// 압축할 수 없는 데이터도 maxCompressedLength 에 들어간다
+	vector<unsigned char> random = createRandom(10000);
+	vector<unsigned char> randomCompressed(CompressStream::maxCompressedLength(random.size()));
+	const int randomLength = CompressStream::compressBlock(random, randomCompressed);
+	testAssert(0 < randomLength);
+	DecompressStream::decompressBlock(ArrayRange<const unsigned char>(randomCompressed.data(), randomLength), result);
+	testAssert(result == random);
+
+	// 출력처가 부족하다
+	testAssert(CompressStream::compressBlock(random, ArrayRange<unsigned char>(randomCompressed.data(), 5000)) == 0);
+
+	{// 짧은 데이터와 같은 바이트의 반복
+		for (int size = 0; size < 40; ++size) {
+			vector<unsigned char> data(size, 'a');
+			vector<unsigned char> buffer(CompressStream::maxCompressedLength(size));
+			const int length = CompressStream::compressBlock(data, buffer);
+			testAssert(0 < length);
+			vector<unsigned char> result(size);
+			DecompressStream::decompressBlock(ArrayRange<const unsigned char>(buffer.data(), length), result);
+			testAssert(result == data);
+		}
+	}
+
+	// 무효한 파라미터
+	testAssertionFailed(CompressStream::maxCompressedLength(-1));
+}
+
+
+testCase(roundTrip) {
+	vector<unsigned char> text = createText(300 * 1000);
+	vector<unsigned char> random = createRandom(300 * 1000);
+
+	{// 압축하기 쉬운 데이터
+		vector<unsigned char> compressed = compress(text, 64 * 1024, 1);
+		testAssert(compressed.size() < text.size() / 2);
+		testAssert(decompress(compressed, true) == text);
+		testAssert(decompress(compressed, false) == text);
+	}
+	{// 압축할 수 없는 데이터는 그대로 기록하므로 거의 늘어나지 않는다
+		vector<unsigned char> compressed = compress(random, 64 * 1024, 1);
+		testAssert(compressed.size() < random.size() + 200);
+		testAssert(decompress(compressed, true) == random);
+		testAssert(decompress(compressed, false) == random);
+	}
+	{// 빈 데이터
+		vector<unsigned char> empty;
+		vector<unsigned char> compressed = compress(empty, 1024, 1);
+		testAssert(decompress(compressed, true).empty());
+		testAssert(decompress(compressed, false).empty());
+	}
+	{// 병렬로 압축해도 결과는 같다
+		vector<unsigned char> single = compress(text, 16 * 1024, 1);
+		vector<unsigned char> parallel = compress(text, 16 * 1024, 4);
+		testAssert(single == parallel);
+		vector<unsigned char> randomParallel = compress(random, 16 * 1024, 3);
+		testAssert(decompress(randomParallel, true) == random);
+	}
+	{// 1 바이트씩 써도 같다
+		MemoryStream memory;
+		{
+			CompressStream stream(memory, 1000, 2);
+			for (int i = 0; i < 10000; ++i) {
+				stream.write(text.data(), i, 1);
+			}
+		}
+		vector<unsigned char> compressed(static_cast<unsigned char*>(memory.buffer()), static_cast<unsigned char*>(memory.buffer()) + memory.length());
+		testAssert(decompress(compressed, true) == vector<unsigned char>(text.begin(), text.begin() + 10000));
+	}
+}
+
+
+testCase(flushAndFinish) {
+	vector<unsigned char> text = createText(5000);
+	MemoryStream memory;
+	CompressStream stream(memory, 4096);
+	stream.write(text.data(), 0, 1000);
+	testAssert(stream.position() == 1000);
+	testAssert(stream.length() == 1000);
+	testAssert(memory.length() == 12);
+
+	// flush 는 쓰는 도중의 블록을 짧은 블록으로 쓴다
+	stream.flush();
+	testAssert(12 < memory.length());
+	stream.write(text.data(), 1000, 4000);
+	testAssertionFailed(stream.position(0));
+	testNoThrow(stream.position(5000));
+	testAssertionFailed(stream.skip(1));
+	testAssertionFailed(stream.read());
+	stream.finish();
+	testAssert(stream.finished());
+	testAssert(!stream.writable());
+	testAssertionFailed(stream.write(text.data(), 0, 1));
+	testAssertionFailed(stream.finish());
+	testAssert(stream.compressedLength() == memory.length());
+	testAssert(stream.originalLength() == 5000);
+
+	memory.position(0);
+	DecompressStream reader(memory);
+	testAssert(reader.blockCount() == 2); // 1000, 4000
+	vector<unsigned char> result(5000);
+	testAssert(reader.read(result.data(), 0, 5000) == 5000);
+	testAssert(result == text);
+}
+
+
+testCase(destruct) {
+	vector<unsigned char> text = createText(5000);
+	FailingStream memory;
+	{// 데스트럭터는 finish 에 실패해도 예외를 던지지 않는다
+		std::unique_ptr<CompressStream> stream(new CompressStream(memory, 4096));
+		stream->write(text.data(), 0, 1000);
+		memory.failing = true;
+		testNoThrow(stream.reset());
+	}
+	{// finish 의 예외는 그대로 전달된다
+		memory.failing = false;
+		CompressStream stream(memory, 4096);
+		stream.write(text.data(), 0, 1000);
+		memory.failing = true;
+		testThrow(stream.finish(), WriteFailedException);
+		testAssert(stream.finished());
+	}
+}
+
+
+testCase(fromWorkerThreads) {
+	// 모든 워커 스레드가 병렬 압축을 기다려도 교착 상태가 되지 않는다
+	vector<unsigned char> text = createText(256 * 1024);
+	const int count = TaskScheduler::global().threadCount() * 2;
+	vector<Task<vector<unsigned char> > > tasks;
+	for (int i = 0; i < count; ++i) {
+		tasks.push_back(TaskScheduler::global().run([&text] () {
+			return compress(text, 16 * 1024, 4);
+		}));
+	}
+	const vector<unsigned char> expected = compress(text, 16 * 1024, 1);
+	for (auto i = tasks.begin(), end = tasks.end(); i != end; ++i) {
+		testAssert(i->get() == expected);
+	}
+}
+
+
+testCase(counters) {
+	vector<unsigned char> text = createText(1024 * 1024);
+	MemoryStream memory;
+	CompressStream stream(memory, 64 * 1024, 2);
+	testAssert(stream.ratio() == 0);
+	stream.write(text.data(), 0, text.size());
+	stream.finish();
+	testAssert(stream.originalLength() == static_cast<__int64>(text.size()));
+	testAssert(stream.compressedLength() == memory.length());
+	testAssert(0 < stream.ratio() && stream.ratio() < 0.5);
+	testAssert(0 < stream.seconds());
+	testAssert(0 < stream.throughput());
+}
+
+
+BALOR_BENCHMARK_SIZES(benchmarkCompressStream, 1, 2, 4, 8) { // 4MB 를 압축한다. 사이즈는 병렬 수
+	static const vector<unsigned char> text = createText(4 * 1024 * 1024); // 벤치마크 함수는 여러 번 호출된다
+	MemoryStream memory(6 * 1024 * 1024);
+	while (benchmark.running()) {
+		memory.position(0);
+		CompressStream stream(memory, CompressStream::defaultBlockSize, benchmark.size());
+		stream.write(text.data(), 0, text.size());
+		stream.finish();
+	}
+}
+
+
+
+		}
+	}
+}
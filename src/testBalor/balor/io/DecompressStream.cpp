@@ -0,0 +1,281 @@
+﻿#include <balor/io/DecompressStream.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <utility>
+#include <vector>
+
+#include <balor/io/CompressStream.hpp>
+#include <balor/io/MemoryStream.hpp>
+#include <balor/system/windows.hpp>
+#include <balor/test/Benchmark.hpp>
+#include <balor/test/UnitTest.hpp>
+#include <balor/String.hpp>
+
+
+namespace balor {
+	namespace io {
+		namespace testDecompressStream {
+
+
+using std::move;
+using std::vector;
+using balor::test::Benchmark;
+
+
+namespace {
+vector<unsigned char> createData(int size) { // 압축하기 쉬운 데이터
+	const char words[] = "decompress random access block index ";
+	vector<unsigned char> data(size);
+	unsigned int seed = 7;
+	for (int i = 0; i < size; ++i) {
+		seed = seed * 1103515245 + 12345;
+		data[i] = (seed >> 24) % 8 ? words[(i + (i >> 12)) % (sizeof(words) - 1)] : static_cast<unsigned char>(seed >> 16);
+	}
+	return data;
+}
+
+
+vector<unsigned char> compress(const vector<unsigned char>& data, int blockSize) {
+	MemoryStream memory;
+	{
+		CompressStream stream(memory, blockSize, 2);
+		stream.write(data.data(), 0, data.size());
+	}
+	const unsigned char* buffer = static_cast<const unsigned char*>(memory.buffer());
+	return vector<unsigned char>(buffer, buffer + memory.length());
+}
+
+
+const vector<unsigned char>& getBenchmarkData() { // 벤치마크 함수는 여러 번 호출되므로 압축은 한 번만 한다
+	static const vector<unsigned char> compressed = compress(createData(8 * 1024 * 1024), CompressStream::defaultBlockSize);
+	return compressed;
+}
+} // namespace
+
+
+
+testCase(construct) {
+	vector<unsigned char> data = createData(10000);
+	vector<unsigned char> compressed = compress(data, 4096);
+
+	{// 색인을 읽어 들인다
+		MemoryStream memory(compressed.data(), 0, compressed.size(), false);
+		DecompressStream stream(memory);
+		testAssert(&stream.stream() == &memory);
+		testAssert(stream.indexed());
+		testAssert(stream.blockSize() == 4096);
+		testAssert(stream.blockCount() == 3);
+		testAssert(stream.length() == 10000);
+		testAssert(stream.position() == 0);
+		testAssert(stream.readable());
+		testAssert(!stream.writable());
+		testAssertionFailed(stream.write("a", 0, 1));
+	}
+	{// 색인을 읽어 들이지 않는다
+		MemoryStream memory(compressed.data(), 0, compressed.size(), false);
+		DecompressStream stream(memory, false);
+		testAssert(!stream.indexed());
+		testAssert(stream.blockSize() == 4096);
+		testAssertionFailed(stream.length());
+		testAssertionFailed(stream.blockCount());
+	}
+	{// 앞에 다른 데이터가 있는 스트림
+		MemoryStream memory;
+		memory.write("prefix", 0, 6);
+		{
+			CompressStream stream(memory, 4096);
+			stream.write(data.data(), 0, data.size());
+		}
+		memory.position(6);
+		DecompressStream stream(memory);
+		testAssert(stream.length() == 10000);
+		stream.position(9000);
+		unsigned char buffer[1000];
+		testAssert(stream.read(buffer, 0, 1000) == 1000);
+		testAssert(std::memcmp(buffer, data.data() + 9000, 1000) == 0);
+	}
+	{// move
+		MemoryStream memory(compressed.data(), 0, compressed.size(), false);
+		DecompressStream source(memory);
+		DecompressStream stream = move(source);
+		testAssert(stream.length() == 10000);
+		source = move(stream);
+		testAssert(source.length() == 10000);
+	}
+}
+
+
+testCase(formatError) {
+	vector<unsigned char> data = createData(10000);
+	vector<unsigned char> compressed = compress(data, 4096);
+
+	{// 헤더가 틀리다
+		vector<unsigned char> broken = compressed;
+		broken[0] = 'X';
+		MemoryStream memory(broken.data(), 0, broken.size(), false);
+		testThrow(DecompressStream stream(memory), DecompressStream::FormatException);
+	}
+	{// 종단이 틀리다
+		vector<unsigned char> broken = compressed;
+		broken.back() = 'X';
+		MemoryStream memory(broken.data(), 0, broken.size(), false);
+		testThrow(DecompressStream stream(memory), DecompressStream::FormatException);
+		memory.position(0);
+		testNoThrow(DecompressStream stream(memory, false));
+	}
+	{// 도중에 끊겼다
+		MemoryStream memory(compressed.data(), 0, 100, false);
+		testThrow(DecompressStream stream(memory), DecompressStream::FormatException);
+		memory.position(0);
+		DecompressStream stream(memory, false);
+		unsigned char buffer[10000];
+		testThrow(stream.read(buffer, 0, sizeof(buffer)), DecompressStream::FormatException);
+	}
+	{// 블록의 내용이 망가졌다
+		vector<unsigned char> broken = compressed;
+		for (int i = 20; i < 200; ++i) {
+			broken[i] = 0xff;
+		}
+		MemoryStream memory(broken.data(), 0, broken.size(), false);
+		DecompressStream stream(memory);
+		unsigned char buffer[10000];
+		testThrow(stream.read(buffer, 0, sizeof(buffer)), DecompressStream::FormatException);
+	}
+
+	{// decompressBlock 의 출력처의 크기가 맞지 않는다
+		vector<unsigned char> block(CompressStream::maxCompressedLength(data.size()));
+		const int length = CompressStream::compressBlock(data, block);
+		ArrayRange<const unsigned char> source(block.data(), length);
+		vector<unsigned char> result(data.size() + 1);
+		testThrow(DecompressStream::decompressBlock(source, result), DecompressStream::FormatException);
+		testThrow(DecompressStream::decompressBlock(source, ArrayRange<unsigned char>(result.data(), data.size() - 1)), DecompressStream::FormatException);
+		testNoThrow(DecompressStream::decompressBlock(source, ArrayRange<unsigned char>(result.data(), data.size())));
+		// 끊긴 데이터
+		for (int i = 0; i < length; ++i) {
+			testThrow(DecompressStream::decompressBlock(ArrayRange<const unsigned char>(block.data(), i), ArrayRange<unsigned char>(result.data(), data.size())), DecompressStream::FormatException);
+		}
+		// 범위 밖을 참조하는 오프셋
+		const unsigned char invalidOffset[] = {0x14, 'a', 0x10, 0x00, 0x00};
+		testThrow(DecompressStream::decompressBlock(invalidOffset, result), DecompressStream::FormatException);
+	}
+}
+
+
+testCase(positionAndSkip) {
+	vector<unsigned char> data = createData(100 * 1000);
+	vector<unsigned char> compressed = compress(data, 4096);
+	MemoryStream memory(compressed.data(), 0, compressed.size(), false);
+	DecompressStream stream(memory);
+	testAssert(stream.blockCount() == 25);
+	unsigned char buffer[5000];
+
+	// 무효한 파라미터
+	testAssertionFailed(stream.position(-1));
+	testAssertionFailed(stream.position(100001));
+
+	// 임의의 위치로 이동한다
+	const int positions[] = {50000, 0, 4095, 4096, 99999, 12345, 95000};
+	for (int i = 0; i < 7; ++i) {
+		stream.position(positions[i]);
+		testAssert(stream.position() == positions[i]);
+		const int count = stream.read(buffer, 0, sizeof(buffer));
+		testAssert(count == std::min(5000, 100000 - positions[i]));
+		testAssert(std::memcmp(buffer, data.data() + positions[i], count) == 0);
+		testAssert(stream.position() == positions[i] + count);
+	}
+	// 끝
+	stream.position(100000);
+	testAssert(stream.read(buffer, 0, 1) == 0);
+	stream.position(10);
+	testAssert(stream.read(buffer, 0, 1) == 1 && buffer[0] == data[10]);
+
+	// skip
+	stream.position(1000);
+	testAssert(stream.skip(20000) == 20000);
+	testAssert(stream.position() == 21000);
+	testAssert(stream.skip(-15000) == -15000);
+	testAssert(stream.read(buffer, 0, 100) == 100);
+	testAssert(std::memcmp(buffer, data.data() + 6000, 100) == 0);
+	testAssert(stream.skip(-10000) == -6100);
+	testAssert(stream.position() == 0);
+	testAssert(stream.skip(200000) == 100000);
+	testAssert(stream.position() == 100000);
+
+	// 이동한 블록만 전개한다
+	const __int64 originalLength = stream.originalLength();
+	stream.position(70000);
+	stream.read(buffer, 0, 10);
+	testAssert(stream.originalLength() == originalLength + 4096);
+}
+
+
+testCase(positionWithoutIndex) {
+	vector<unsigned char> data = createData(100 * 1000);
+	vector<unsigned char> compressed = compress(data, 4096);
+	MemoryStream memory(compressed.data(), 0, compressed.size(), false);
+	DecompressStream stream(memory, false);
+	unsigned char buffer[100];
+
+	stream.position(5000);
+	testAssert(stream.read(buffer, 0, 100) == 100);
+	testAssert(std::memcmp(buffer, data.data() + 5000, 100) == 0);
+	testAssertionFailed(stream.position(0));
+	testAssertionFailed(stream.skip(-1));
+	testAssert(stream.skip(50000) == 50000);
+	testAssert(stream.position() == 55100);
+	testAssert(stream.read(buffer, 0, 100) == 100);
+	testAssert(std::memcmp(buffer, data.data() + 55100, 100) == 0);
+	testAssert(stream.skip(100000) == 100000 - 55200);
+	testAssert(stream.read(buffer, 0, 100) == 0);
+	testAssert(stream.skip(1) == 0);
+}
+
+
+testCase(counters) {
+	vector<unsigned char> data = createData(1024 * 1024);
+	vector<unsigned char> compressed = compress(data, 64 * 1024);
+	MemoryStream memory(compressed.data(), 0, compressed.size(), false);
+	DecompressStream stream(memory, false);
+	vector<unsigned char> result(data.size());
+	testAssert(stream.read(result.data(), 0, result.size()) == static_cast<int>(result.size()));
+	testAssert(stream.read(result.data(), 0, 1) == 0);
+	testAssert(stream.originalLength() == static_cast<__int64>(data.size()));
+	testAssert(stream.compressedLength() < static_cast<__int64>(compressed.size())); // 색인은 읽지 않는다
+	testAssert(0 < stream.seconds());
+	testAssert(0 < stream.throughput());
+}
+
+
+BALOR_BENCHMARK(benchmarkDecompressStreamSequential) { // 64KB 씩 순차 전개한다
+	const vector<unsigned char>& compressed = getBenchmarkData();
+	MemoryStream memory(const_cast<unsigned char*>(compressed.data()), 0, compressed.size(), false);
+	DecompressStream stream(memory);
+	vector<unsigned char> buffer(64 * 1024);
+	while (benchmark.running()) {
+		if (!stream.read(buffer.data(), 0, buffer.size())) {
+			stream.position(0);
+		}
+	}
+}
+
+
+BALOR_BENCHMARK(benchmarkDecompressStreamRandom) { // 4KB 랜덤 액세스
+	const vector<unsigned char>& compressed = getBenchmarkData();
+	MemoryStream memory(const_cast<unsigned char*>(compressed.data()), 0, compressed.size(), false);
+	DecompressStream stream(memory);
+	const __int64 length = stream.originalLength();
+	vector<unsigned char> buffer(4096);
+	unsigned int seed = 1;
+	while (benchmark.running()) {
+		seed = seed * 1103515245 + 12345;
+		stream.position((seed >> 8) % (length - 4096));
+		stream.read(buffer.data(), 0, 4096);
+	}
+}
+
+
+
+		}
+	}
+}
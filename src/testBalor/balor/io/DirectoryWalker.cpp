@@ -0,0 +1,281 @@
+﻿#include <balor/io/DirectoryWalker.hpp>
+
+#include <algorithm>
+#include <vector>
+
+#include <balor/io/File.hpp>
+#include <balor/io/FileStream.hpp>
+#include <balor/system/windows.hpp>
+#include <balor/test/Benchmark.hpp>
+#include <balor/test/UnitTest.hpp>
+#include <balor/scopeExit.hpp>
+#include <balor/String.hpp>
+
+
+namespace balor {
+	namespace io {
+		namespace testDirectoryWalker {
+
+using std::vector;
+using balor::test::Benchmark;
+
+
+namespace {
+const wchar_t testDirectoryName[] = L"testBalor_io_DirectoryWalker_4k2jd9sl0vma81bq";
+File getTestDirectory() {
+	File dir(File::getSpecial(File::Special::temporary), testDirectoryName);
+	if (dir.exists()) {
+		dir.remove(true);
+	}
+	dir.createDirectory();
+	return dir;
+}
+
+
+void removeTestDirectory() {
+	File(File::getSpecial(File::Special::temporary), testDirectoryName).remove(true);
+}
+
+
+void createTree(const File& dir) { // a/b/c 의 3 단계 디렉토리에 각각 파일 5 개씩
+	File sub = dir;
+	for (int i = 0; i < 3; ++i) {
+		sub = File(sub, String() + static_cast<wchar_t>(L'a' + i));
+		sub.createDirectory();
+		for (int j = 0; j < 5; ++j) {
+			auto stream = File(sub, String() + L"file" + j + (j % 2 ? L".txt" : L".bin")).create();
+			vector<char> data(i * 100 + j);
+			if (!data.empty()) {
+				stream.write(data.data(), 0, data.size());
+			}
+		}
+	}
+}
+
+
+vector<File::Info> walkAll(DirectoryWalker& walker) {
+	vector<File::Info> result;
+	File::Info info;
+	while (walker.next(info)) {
+		result.push_back(info);
+	}
+	return result;
+}
+
+
+int countDirectories(const vector<File::Info>& infos) {
+	int result = 0;
+	for (auto i = infos.begin(), end = infos.end(); i != end; ++i) {
+		if (i->isDirectory()) {
+			++result;
+		}
+	}
+	return result;
+}
+
+
+class BenchmarkTree { // 벤치마크 함수는 여러 번 호출되므로 디렉토리 10 개에 파일 100 개씩 한 번만 만들고 종료할 때 지운다
+public:
+	static const File& get() {
+		static const BenchmarkTree tree;
+		return tree.dir;
+	}
+
+private:
+	BenchmarkTree() : dir(File::getSpecial(File::Special::temporary), L"testBalor_io_DirectoryWalker_benchmark_7hq3ne5rw0cz") {
+		if (dir.exists()) {
+			dir.remove(true);
+		}
+		dir.createDirectory();
+		for (int i = 0; i < 10; ++i) {
+			File sub(dir, String() + L"dir" + i);
+			sub.createDirectory();
+			for (int j = 0; j < 100; ++j) {
+				File(sub, String() + L"file" + j).create();
+			}
+		}
+	}
+	~BenchmarkTree() {
+		dir.remove(true);
+	}
+
+	File dir;
+};
+} // namespace
+
+
+
+testCase(construct) {
+	scopeExit(&removeTestDirectory);
+	File dir = getTestDirectory();
+
+	// 무효한 파라미터
+	testAssertionFailed(DirectoryWalker walker((File())));
+	testAssertionFailed(DirectoryWalker walker(dir, L"*", DirectoryWalker::Filter(), -1));
+	testAssertionFailed(DirectoryWalker walker(dir, L"*", DirectoryWalker::Filter(), 1, 0));
+
+	// 존재하지 않는 디렉토리
+	testThrow(DirectoryWalker walker(File(dir, L"notFound")), File::NotFoundException);
+	// 디렉토리가 아니다
+	File(dir, L"file").create();
+	testThrow(DirectoryWalker walker(File(dir, L"file")), File::NotFoundException);
+	File(dir, L"file").remove();
+
+	{// 빈 디렉토리
+		DirectoryWalker walker(dir, L"*", DirectoryWalker::Filter(), 2);
+		File::Info info;
+		testAssert(!walker.next(info));
+		testAssert(!walker.next(info));
+	}
+}
+
+
+testCase(next) {
+	scopeExit(&removeTestDirectory);
+	File dir = getTestDirectory();
+	createTree(dir);
+
+	for (int threadCount = 0; threadCount < 4; ++threadCount) {
+		DirectoryWalker walker(dir, L"*", DirectoryWalker::Filter(), threadCount);
+		const auto infos = walkAll(walker);
+		testAssert(infos.size() == 18);
+		testAssert(countDirectories(infos) == 3);
+		for (auto i = infos.begin(), end = infos.end(); i != end; ++i) { // 열거할 때 얻은 정보가 파일의 정보와 일치한다
+			testAssert(i->file().exists());
+			testAssert(i->isDirectory() == i->file().isDirectory());
+			testAssert(i->attributes() == i->file().attributes());
+			testAssert(0 < i->lastWriteTime());
+			if (i->isDirectory()) {
+				testAssert(i->length() == 0);
+			} else {
+				testAssert(i->length() == i->file().openRead().length());
+			}
+		}
+	}
+}
+
+
+testCase(pattern) {
+	scopeExit(&removeTestDirectory);
+	File dir = getTestDirectory();
+	createTree(dir);
+
+	{// 디렉토리는 패턴에 일치하지 않아도 아래를 열거한다
+		DirectoryWalker walker(dir, L"*.txt");
+		const auto infos = walkAll(walker);
+		testAssert(infos.size() == 6);
+		for (auto i = infos.begin(), end = infos.end(); i != end; ++i) {
+			testAssert(i->file().extension() == L".txt");
+		}
+	}
+	{// 패턴에 일치하는 디렉토리
+		DirectoryWalker walker(dir, L"?");
+		const auto infos = walkAll(walker);
+		testAssert(infos.size() == 3);
+		testAssert(countDirectories(infos) == 3);
+	}
+	{// 일치하는 것이 없다
+		DirectoryWalker walker(dir, L"*.none");
+		testAssert(walkAll(walker).empty());
+	}
+}
+
+
+testCase(filter) {
+	scopeExit(&removeTestDirectory);
+	File dir = getTestDirectory();
+	createTree(dir);
+
+	{// 디렉토리를 제외하면 아래도 열거하지 않는다
+		DirectoryWalker walker(dir, L"*", [&] (const File::Info& info) -> bool {
+			return info.file().name() != L"b";
+		}, 3);
+		const auto infos = walkAll(walker);
+		testAssert(infos.size() == 6);
+		testAssert(countDirectories(infos) == 1);
+	}
+	{// 파일의 크기로 거른다
+		DirectoryWalker walker(dir, L"*", [&] (const File::Info& info) -> bool {
+			return info.isDirectory() || 200 <= info.length();
+		}, 3);
+		const auto infos = walkAll(walker);
+		testAssert(infos.size() == 8);
+	}
+	{// 필터가 던진 예외는 그때까지의 결과 후에 next 로 던진다
+		DirectoryWalker walker(dir, L"*", [&] (const File::Info& info) -> bool {
+			if (info.file().name() == L"c") {
+				throw File::AccessDeniedException();
+			}
+			return true;
+		}, 2);
+		testThrow(walkAll(walker), File::AccessDeniedException);
+		File::Info info;
+		testAssert(!walker.next(info));
+	}
+}
+
+
+testCase(boundedQueue) {
+	scopeExit(&removeTestDirectory);
+	File dir = getTestDirectory();
+	for (int i = 0; i < 8; ++i) {
+		File sub(dir, String() + L"dir" + i);
+		sub.createDirectory();
+		for (int j = 0; j < 100; ++j) {
+			File(sub, String() + L"file" + j).create();
+		}
+	}
+
+	{// 결과를 하나씩만 보관해도 모두 열거할 수 있다
+		DirectoryWalker walker(dir, L"*", DirectoryWalker::Filter(), 4, 1);
+		testAssert(walkAll(walker).size() == 808);
+	}
+	{// 도중에 중지
+		DirectoryWalker walker(dir, L"*", DirectoryWalker::Filter(), 4, 1);
+		File::Info info;
+		testAssert(walker.next(info));
+		walker.cancel();
+		testAssert(!walker.next(info));
+	}
+	{// 다 꺼내지 않고 파기한다
+		DirectoryWalker walker(dir, L"*", DirectoryWalker::Filter(), 4, 1);
+		File::Info info;
+		testAssert(walker.next(info));
+	}
+}
+
+
+// 열거한 후에 속성과 크기를 하나씩 얻는 방법과 비교한다
+BALOR_BENCHMARK(benchmarkDirectoryWalkerGetFiles) {
+	const File& dir = BenchmarkTree::get();
+	while (benchmark.running()) {
+		__int64 total = 0;
+		const auto files = dir.getFiles(L"?*", true);
+		for (auto i = files.begin(), end = files.end(); i != end; ++i) {
+			if (!(i->attributes() & File::Attributes::directory)) {
+				total += i->openRead().length();
+			}
+		}
+		Benchmark::doNotOptimize(total);
+	}
+}
+
+
+BALOR_BENCHMARK(benchmarkDirectoryWalkerNext) {
+	const File& dir = BenchmarkTree::get();
+	while (benchmark.running()) {
+		__int64 total = 0;
+		DirectoryWalker walker(dir);
+		File::Info info;
+		while (walker.next(info)) {
+			total += info.length();
+		}
+		Benchmark::doNotOptimize(total);
+	}
+}
+
+
+
+		}
+	}
+}
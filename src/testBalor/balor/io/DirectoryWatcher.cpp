@@ -0,0 +1,275 @@
+﻿#include <balor/io/DirectoryWatcher.hpp>
+
+#include <vector>
+#include <boost/thread.hpp>
+
+#include <balor/io/File.hpp>
+#include <balor/io/FileStream.hpp>
+#include <balor/system/windows.hpp>
+#include <balor/test/UnitTest.hpp>
+#include <balor/scopeExit.hpp>
+#include <balor/String.hpp>
+
+
+namespace balor {
+	namespace io {
+		namespace testDirectoryWatcher {
+
+using std::vector;
+typedef DirectoryWatcher::Action Action;
+
+
+namespace {
+const wchar_t testDirectoryName[] = L"testBalor_io_DirectoryWatcher_7fk2mz0q9xw1p4cd";
+File getTestDirectory() {
+	File dir(File::getSpecial(File::Special::temporary), testDirectoryName);
+	if (dir.exists()) {
+		dir.remove(true);
+	}
+	dir.createDirectory();
+	return dir.fullPathFile();
+}
+
+
+void removeTestDirectory() {
+	File(File::getSpecial(File::Special::temporary), testDirectoryName).remove(true);
+}
+
+
+struct Recorder { // 통지된 변경을 모은다
+	Recorder() : count(0), overflowed(false) {}
+
+	Listener<DirectoryWatcher::Changes&> listener() {
+		return [&] (DirectoryWatcher::Changes& e) {
+			boost::mutex::scoped_lock lock(mutex);
+			changes.insert(changes.end(), e.changes().begin(), e.changes().end());
+			++count;
+			overflowed = overflowed || e.overflowed();
+		};
+	}
+
+	bool contains(Action action, const File& file) {
+		boost::mutex::scoped_lock lock(mutex);
+		for (auto i = changes.begin(), end = changes.end(); i != end; ++i) {
+			if (i->action() == action && String::equals(i->file().path(), file.path())) {
+				return true;
+			}
+		}
+		return false;
+	}
+
+	bool containsFile(const File& file) {
+		boost::mutex::scoped_lock lock(mutex);
+		for (auto i = changes.begin(), end = changes.end(); i != end; ++i) {
+			if (String::equals(i->file().path(), file.path()) || String::equals(i->oldFile().path(), file.path())) {
+				return true;
+			}
+		}
+		return false;
+	}
+
+	bool wait(Action action, const File& file) { // 통지될 때까지 최대 5 초 기다린다
+		for (int i = 0; i < 500; ++i) {
+			if (contains(action, file)) {
+				return true;
+			}
+			Sleep(10);
+		}
+		return false;
+	}
+
+	boost::mutex mutex;
+	vector<DirectoryWatcher::Change> changes;
+	int count;
+	bool overflowed;
+};
+} // namespace
+
+
+
+testCase(construct) {
+	scopeExit(&removeTestDirectory);
+	File dir = getTestDirectory();
+
+	// 무효한 파라미터
+	testAssertionFailed(DirectoryWatcher watcher(File(), true, 0, Listener<DirectoryWatcher::Changes&>()));
+	testAssertionFailed(DirectoryWatcher watcher(dir, true, -1, Listener<DirectoryWatcher::Changes&>()));
+
+	// 존재하지 않는 디렉토리
+	testThrow(DirectoryWatcher watcher(File(dir, L"notFound"), true, 0, Listener<DirectoryWatcher::Changes&>()), File::NotFoundException);
+
+	{// 변경이 없으면 통지하지 않는다
+		Recorder recorder;
+		DirectoryWatcher watcher(dir, false, 10, recorder.listener());
+		testAssert(String::equals(watcher.directory().path(), dir.path()));
+		testAssert(!watcher.recursive());
+		testAssert(watcher.delay() == 10);
+		Sleep(50);
+		testAssert(recorder.count == 0);
+	}
+}
+
+
+testCase(changes) {
+	scopeExit(&removeTestDirectory);
+	File dir = getTestDirectory();
+	Recorder recorder;
+	DirectoryWatcher watcher(dir, true, 20, recorder.listener());
+
+	// 작성
+	File file(dir, L"a.txt");
+	file.create();
+	testAssert(recorder.wait(Action::added, file));
+
+	// 변경
+	{
+		auto stream = file.openWrite();
+		stream.write("abc", 0, 3);
+	}
+	testAssert(recorder.wait(Action::modified, file));
+
+	// 이름 변경
+	File renamed(dir, L"b.txt");
+	file.moveTo(renamed);
+	testAssert(recorder.wait(Action::renamed, renamed));
+	{
+		boost::mutex::scoped_lock lock(recorder.mutex);
+		for (auto i = recorder.changes.begin(), end = recorder.changes.end(); i != end; ++i) {
+			if (i->action() == Action::renamed) {
+				testAssert(String::equals(i->oldFile().path(), file.path()));
+			}
+		}
+	}
+
+	// 삭제
+	renamed.remove();
+	testAssert(recorder.wait(Action::removed, renamed));
+	testAssert(!recorder.overflowed);
+}
+
+
+testCase(coalesce) {
+	scopeExit(&removeTestDirectory);
+	File dir = getTestDirectory();
+	Recorder recorder;
+	DirectoryWatcher watcher(dir, true, 200, recorder.listener());
+
+	// 작성하고 바로 삭제한 파일은 통지하지 않는다
+	File temporary(dir, L"temporary");
+	{
+		auto stream = temporary.create();
+		stream.write("abc", 0, 3);
+	}
+	temporary.remove();
+	// 여러 번 변경해도 하나로 정리된다
+	File file(dir, L"file");
+	for (int i = 0; i < 10; ++i) {
+		auto stream = file.openAppend();
+		stream.write("abc", 0, 3);
+	}
+	testAssert(recorder.wait(Action::added, file));
+	testAssert(!recorder.containsFile(temporary));
+	boost::mutex::scoped_lock lock(recorder.mutex);
+	testAssert(recorder.count == 1);
+	testAssert(recorder.changes.size() == 1);
+}
+
+
+testCase(coalesceRename) {
+	scopeExit(&removeTestDirectory);
+	File dir = getTestDirectory();
+	Recorder recorder;
+	DirectoryWatcher watcher(dir, true, 200, recorder.listener());
+
+	// 작성하고 바로 이름을 바꾼 파일은 바꾼 후의 이름의 작성이 된다
+	File created(dir, L"created");
+	created.create();
+	File createdRenamed(dir, L"createdRenamed");
+	created.moveTo(createdRenamed);
+	// 이름을 연속으로 바꾸면 처음 이름에서의 변경이 된다
+	File first(dir, L"first");
+	first.create();
+	testAssert(recorder.wait(Action::added, createdRenamed));
+	testAssert(recorder.wait(Action::added, first));
+	File second(dir, L"second");
+	File third(dir, L"third");
+	first.moveTo(second);
+	second.moveTo(third);
+	testAssert(recorder.wait(Action::renamed, third));
+
+	boost::mutex::scoped_lock lock(recorder.mutex);
+	testAssert(recorder.changes.size() == 3);
+	testAssert(recorder.changes[2].action() == Action::renamed);
+	testAssert(String::equals(recorder.changes[2].oldFile().path(), first.path()));
+	for (auto i = recorder.changes.begin(), end = recorder.changes.end(); i != end; ++i) {
+		testAssert(!String::equals(i->file().path(), created.path()));
+		testAssert(!String::equals(i->file().path(), second.path()));
+	}
+}
+
+
+testCase(longPath) { // 248 문자 이상의 디렉토리도 감시할 수 있다
+	scopeExit(&removeTestDirectory);
+	File dir = getTestDirectory();
+	File longDir(dir, String(L'd', 240).c_str());
+	longDir.createDirectory();
+	testAssert(248 <= longDir.pathLength());
+	Recorder recorder;
+	DirectoryWatcher watcher(longDir, false, 20, recorder.listener());
+	File file(longDir, L"a.txt");
+	file.create();
+	testAssert(recorder.wait(Action::added, file));
+}
+
+
+testCase(recursive) {
+	scopeExit(&removeTestDirectory);
+	File dir = getTestDirectory();
+	Recorder recorder;
+	Recorder topRecorder;
+	DirectoryWatcher watcher(dir, true, 20, recorder.listener());
+	DirectoryWatcher topWatcher(dir, false, 20, topRecorder.listener());
+
+	// 새로 만든 디렉토리 아래도 감시한다
+	File sub(dir, L"sub");
+	sub.createDirectory();
+	File subFile(sub, L"file");
+	subFile.create();
+	testAssert(recorder.wait(Action::added, sub));
+	testAssert(recorder.wait(Action::added, subFile));
+
+	// 이름을 바꾼 디렉토리 아래의 변경은 새 경로로 통지한다
+	File renamed(dir, L"renamed");
+	sub.moveTo(renamed);
+	testAssert(recorder.wait(Action::renamed, renamed));
+	File renamedFile(renamed, L"file2");
+	renamedFile.create();
+	testAssert(recorder.wait(Action::added, renamedFile));
+
+	// 직하만 감시하는 경우는 서브 디렉토리 아래의 변경을 통지하지 않는다
+	File marker(dir, L"marker");
+	marker.create();
+	testAssert(topRecorder.wait(Action::added, marker));
+	testAssert(topRecorder.contains(Action::added, sub));
+	testAssert(!topRecorder.containsFile(subFile));
+	testAssert(!topRecorder.containsFile(renamedFile));
+}
+
+
+testCase(destroyWithPendingChanges) {
+	scopeExit(&removeTestDirectory);
+	File dir = getTestDirectory();
+	Recorder recorder;
+	{
+		DirectoryWatcher watcher(dir, true, 10000, recorder.listener());
+		File(dir, L"file").create();
+		Sleep(50);
+	}
+	testAssert(recorder.count == 0); // 모아둔 변경은 통지하지 않고 버린다
+}
+
+
+
+		}
+	}
+}
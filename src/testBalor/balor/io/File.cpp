@@ -1,5 +1,6 @@
 ﻿#include <balor/io/File.hpp>
 
+#include <algorithm>
 #include <utility>
 #include <vector>
 
@@ -121,8 +122,16 @@ testCase(constructAndAssignment) {
 		File file(L"");
 		testAssert(!file.exists());
 	}
-	{// 너무 긴 패스
-		testThrow(File file(String(L'a', MAX_PATH)), File::PathTooLongException);
+	{// MAX_PATH 보다 긴 패스
+		const String path(L'a', MAX_PATH * 2);
+		File file(path);
+		testAssert(file.pathLength() == MAX_PATH * 2);
+		testAssert(file == path);
+		File file2 = file;
+		testAssert(file2 == path);
+		file2 = File(L"abc");
+		testAssert(file2 == L"abc");
+		testAssert(file == path);
 	}
 	{// 패스의 move
 		File file(L"c:\\abc");
@@ -291,6 +300,97 @@ testCase(copyTo) {
 }
 
 
+testCase(copyToWithProgress) {
+	scopeExit(&removeTestDirectory);
+	File dir = getTestDirectory();
+
+	// 테스트 데이터 작성
+	File source(dir, L"source");
+	File sub(source, L"sub");
+	sub.createDirectory();
+	File(source, L"empty").createDirectory();
+	vector<char> data(3 * 1024 * 1024 + 5);
+	for (int i = 0, end = data.size(); i < end; ++i) {
+		data[i] = static_cast<char>(i * 13);
+	}
+	__int64 total = 0;
+	for (int i = 0; i < 8; ++i) {
+		auto stream = File(i % 2 ? sub : source, String() + L"file" + i).create();
+		const int size = i == 7 ? data.size() : i * 100000;
+		stream.write(data.data(), 0, size);
+		total += size;
+	}
+
+	// 무효한 파라미터
+	testAssertionFailed(source.copyTo(L"", false, File::CopyProgress()));
+	testAssertionFailed(source.copyTo(File(dir, L"dest0"), false, File::CopyProgress(), 0));
+
+	{// 병렬로 복사
+		File dest(dir, L"dest0");
+		vector<__int64> reports;
+		source.copyTo(dest, false, [&] (__int64 copied, __int64 totalBytes) {
+			testAssert(totalBytes == total);
+			reports.push_back(copied);
+		}, 3);
+		testAssert(2 <= reports.size());
+		testAssert(reports.front() == 0);
+		testAssert(reports.back() == total);
+		for (int i = 1, end = reports.size(); i < end; ++i) {
+			testAssert(reports[i - 1] <= reports[i]);
+		}
+		testAssert(File(dest, L"empty").isDirectory());
+		for (int i = 0; i < 8; ++i) {
+			File file(i % 2 ? File(dest, L"sub") : dest, String() + L"file" + i);
+			testAssert(file.exists());
+			auto stream = file.openRead();
+			const int size = i == 7 ? data.size() : i * 100000;
+			testAssert(stream.length() == size);
+			vector<char> buffer(size + 1);
+			testAssert(stream.read(buffer.data(), 0, size + 1) == size);
+			testAssert(std::equal(buffer.begin(), buffer.begin() + size, data.begin()));
+		}
+
+		// 복사처가 이미 존재한다(덮어 쓰기 지정 없음)
+		testThrow(source.copyTo(dest, false, File::CopyProgress()), File::AlreadyExistsException);
+	}
+
+	{// 하나의 스레드로 복사
+		File dest(dir, L"dest1");
+		__int64 last = -1;
+		source.copyTo(dest, false, [&] (__int64 copied, __int64 ) {
+			testAssert(last <= copied);
+			last = copied;
+		}, 1);
+		testAssert(last == total);
+		testAssert(File(File(dest, L"sub"), L"file7").openRead().length() == data.size());
+	}
+
+	{// progress 가 예외를 던지면 중단한다
+		class CanceledException {};
+		testThrow(source.copyTo(File(dir, L"dest2"), false, [&] (__int64 copied, __int64 ) {
+			if (copied) {
+				throw CanceledException();
+			}
+		}, 3), CanceledException);
+		testThrow(source.copyTo(File(dir, L"dest3"), false, [&] (__int64 copied, __int64 ) {
+			if (copied) {
+				throw CanceledException();
+			}
+		}, 1), CanceledException);
+	}
+
+	{// 파일 하나의 복사
+		File dest(dir, L"file7");
+		__int64 last = 0;
+		File(sub, L"file7").copyTo(dest, false, [&] (__int64 copied, __int64 ) {
+			last = copied;
+		});
+		testAssert(last == data.size());
+		testAssert(dest.openRead().length() == data.size());
+	}
+}
+
+
 //testCase(create) { // testCase(open) 에서 테스트
 //}
 
@@ -539,6 +639,86 @@ testCase(getSpecial) {
 }
 
 
+testCase(info) {
+	scopeExit(&removeTestDirectory);
+	File dir = getTestDirectory();
+
+	File file0(dir, L"file0.txt");
+	{
+		auto stream = file0.create();
+		stream.write("abcde", 0, 5);
+	}
+	File sub0(dir, L"sub0");
+	sub0.createDirectory();
+
+	// 존재하지 않는 파일
+	testThrow(File(dir, L"file1.txt").info(), File::NotFoundException);
+	testThrow(File(dir, L"hoge\\file2.txt").info(), File::NotFoundException);
+
+	{// 파일의 정보
+		const auto info = file0.info();
+		testAssert(info.file() == file0);
+		testAssert(info.exists());
+		testAssert(!info.isDirectory());
+		testAssert(info.attributes() == file0.attributes());
+		testAssert(info.length() == 5);
+		testAssert(0 < info.creationTime());
+		testAssert(0 < info.lastAccessTime());
+		testAssert(0 < info.lastWriteTime());
+	}
+	{// 디렉토리의 정보
+		const auto info = sub0.info();
+		testAssert(info.exists());
+		testAssert(info.isDirectory());
+		testAssert(info.attributes() == sub0.attributes());
+		testAssert(info.length() == 0);
+	}
+	{// 스냅샷은 파일이 바뀌어도 변하지 않는다
+		const auto info = file0.info();
+		file0.remove();
+		testAssert(info.exists());
+		testAssert(info.length() == 5);
+	}
+}
+
+
+testCase(infos) {
+	scopeExit(&removeTestDirectory);
+	File dir = getTestDirectory();
+
+	vector<File> files;
+	for (int i = 0; i < 100; ++i) {
+		File file(dir, String() + L"file" + i);
+		if (i % 3) {
+			auto stream = file.create();
+			vector<char> data(i);
+			stream.write(data.data(), 0, i);
+		}
+		files.push_back(file);
+	}
+
+	// 무효한 파라미터
+	testAssertionFailed(File::infos(files, 0));
+
+	// 빈 배열
+	testAssert(File::infos(vector<File>()).empty());
+
+	for (int threadCount = 1; threadCount < 10; threadCount += 4) {
+		const auto infos = File::infos(files, threadCount);
+		testAssert(infos.size() == files.size());
+		for (int i = 0; i < 100; ++i) { // 순서대로 돌려준다
+			testAssert(infos[i].file() == files[i]);
+			testAssert(infos[i].exists() == (i % 3 != 0));
+			testAssert(infos[i].length() == (i % 3 ? i : 0));
+		}
+	}
+
+	// 무효한 패스
+	const wchar_t* paths[] = {L"abc", L"c::\\abc"};
+	testThrow(File::infos(paths), File::InvalidPathException);
+}
+
+
 testCase(isDirectory) {
 	scopeExit(&removeTestDirectory);
 	File dir = getTestDirectory();
@@ -742,6 +922,49 @@ testCase(open) {
 #pragma warning(pop)
 
 
+testCase(longPath) {
+	scopeExit(&removeTestDirectory);
+	File dir = getTestDirectory();
+
+	File sub = dir; // MAX_PATH 보다 긴 패스의 디렉토리 계층
+	while (sub.pathLength() < MAX_PATH + 100) {
+		sub = File(sub, String(L'd', 50));
+	}
+	testAssert(!sub.exists());
+	sub.createDirectory();
+	testAssert(sub.exists());
+	testAssert(sub.isDirectory());
+
+	File file(sub, L"file.txt");
+	{
+		auto stream = file.create();
+		stream.write("abc", 0, 3);
+	}
+	testAssert(file.exists());
+	testAssert(file.info().length() == 3);
+	testAssert(file.openRead().length() == 3);
+	testAssert(file.fullPathFile() == file);
+	testAssert(file.parent() == sub);
+	testAssert(file.name() == L"file.txt");
+
+	file.remove();
+	testAssert(!file.exists());
+
+	// 재귀적으로 삭제
+	File(dir, String(L'd', 50)).remove(true);
+	testAssert(!sub.exists());
+
+	{// CreateDirectoryW 는 MAX_PATH 보다 짧아도 248 문자 이상이면 실패한다
+		File shortSub(dir, String(L'e', 250 - dir.pathLength() - 1));
+		testAssert(shortSub.pathLength() == 250);
+		shortSub.createDirectory();
+		testAssert(shortSub.isDirectory());
+		shortSub.remove();
+		testAssert(!shortSub.exists());
+	}
+}
+
+
 testCase(path) {
 	testAssert(File(L"abc") == L"abc");
 }
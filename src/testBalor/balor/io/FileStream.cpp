@@ -1,8 +1,11 @@
 ﻿#include <balor/io/FileStream.hpp>
 
+#include <algorithm>
+#include <cstring>
 #include <utility>
 
 #include <balor/io/File.hpp>
+#include <balor/io/MemoryStream.hpp>
 #include <balor/system/windows.hpp>
 #include <balor/test/HandleLeakChecker.hpp>
 #include <balor/test/UnitTest.hpp>
@@ -275,6 +278,61 @@ testCase(moveConstructAndAssignment) {
 }
 
 
+testCase(copyTo) {
+	scopeExit(&removeTestDirectory);
+	File dir = getTestDirectory();
+	vector<char> data(3 * 1024 * 1024 + 5);
+	for (int i = 0, end = data.size(); i < end; ++i) {
+		data[i] = static_cast<char>(i * 7);
+	}
+	File file0(dir, L"file0.txt");
+	{
+		auto stream = file0.create();
+		stream.write(data.data(), 0, data.size());
+	}
+
+	// 무효한 파라미터
+	auto source = file0.openRead();
+	FileStream nullStream;
+	testAssertionFailed(nullStream.copyTo(source));
+	testAssertionFailed(source.copyTo(source));
+	testAssertionFailed(source.copyTo(nullStream, 0));
+
+	{// 파일에서 파일로
+		File file1(dir, L"file1.txt");
+		auto destination = file1.create();
+		destination.write("ab", 0, 2);
+		source.position(5);
+		testAssert(source.copyTo(destination) == data.size() - 5);
+		testAssert(source.position() == data.size());
+		testAssert(destination.position() == data.size() - 3);
+		testAssert(destination.length() == data.size() - 3);
+		destination.position(0);
+		vector<char> buffer(data.size());
+		testAssert(destination.read(buffer.data(), 0, buffer.size()) == data.size() - 3);
+		testAssert(std::memcmp(buffer.data(), "ab", 2) == 0);
+		testAssert(std::equal(data.begin() + 5, data.end(), buffer.begin() + 2));
+	}
+	{// 추가 쓰기 모드의 파일로
+		File file2(dir, L"file2.txt");
+		{
+			auto stream = file2.create();
+			stream.write("ab", 0, 2);
+		}
+		auto destination = file2.openAppend();
+		source.position(0);
+		testAssert(source.copyTo(destination) == data.size());
+		testAssert(destination.length() == data.size() + 2);
+	}
+	{// 파일 이외로
+		MemoryStream destination;
+		source.position(1);
+		testAssert(source.copyTo(destination, 4096) == data.size() - 1);
+		testAssert(std::equal(data.begin() + 1, data.end(), static_cast<char*>(destination.buffer())));
+	}
+}
+
+
 testCase(destruct) {
 	scopeExit(&removeTestDirectory);
 	File dir = getTestDirectory();
@@ -452,6 +510,60 @@ testCase(read) {
 //}
 
 
+testCase(readvAndWritev) {
+	scopeExit(&removeTestDirectory);
+	File dir = getTestDirectory();
+	File file0(dir, L"file0.txt");
+	auto stream0 = file0.create();
+	auto stream1 = move(stream0);
+
+	// 무효한 파라미터
+	char buffer0[4] = {0};
+	char buffer1[8] = {0};
+	Stream::Slice nullSlices[] = {Stream::Slice(buffer0, 0, 2), Stream::Slice()};
+	Stream::ConstSlice nullConstSlices[] = {Stream::ConstSlice(nullptr, 0, 1)};
+	Stream::ConstSlice negativeSlices[] = {Stream::ConstSlice("ab", 0, -1)};
+	testAssertionFailed(stream0.readv(nullSlices));
+	testAssertionFailed(stream1.writev(nullConstSlices));
+	testAssertionFailed(stream1.writev(negativeSlices));
+
+	// 작은 쓰기와 읽기
+	Stream::ConstSlice slices[] = {Stream::ConstSlice("ab", 0, 2), Stream::ConstSlice("0123", 1, 3), Stream::ConstSlice("", 0, 0)};
+	stream1.writev(slices);
+	testAssert(stream1.position() == 5);
+	testAssert(stream1.length() == 5);
+	stream1.position(0);
+	Stream::Slice readSlices[] = {Stream::Slice(buffer0, 0, 3), Stream::Slice(buffer1, 1, 4)};
+	testAssert(stream1.readv(readSlices) == 5);
+	testAssert(String::equals(buffer0, "ab1"));
+	testAssert(String::equals(buffer1 + 1, "23"));
+	testAssert(stream1.position() == 5);
+	testAssert(stream1.readv(readSlices) == 0);
+
+	// 큰 쓰기와 읽기
+	vector<char> large0(20000);
+	vector<char> large1(30000);
+	for (int i = 0, end = large0.size(); i < end; ++i) {
+		large0[i] = static_cast<char>(i);
+	}
+	for (int i = 0, end = large1.size(); i < end; ++i) {
+		large1[i] = static_cast<char>(i * 7);
+	}
+	Stream::ConstSlice largeSlices[] = {Stream::ConstSlice(large0.data(), 0, large0.size()), Stream::ConstSlice(large1.data(), 0, large1.size())};
+	stream1.position(0);
+	stream1.writev(largeSlices);
+	testAssert(stream1.length() == 50000);
+	testAssert(stream1.position() == 50000);
+	vector<char> read0(large0.size());
+	vector<char> read1(large1.size() + 100);
+	Stream::Slice largeReadSlices[] = {Stream::Slice(read0.data(), 0, read0.size()), Stream::Slice(read1.data(), 0, read1.size())};
+	stream1.position(0);
+	testAssert(stream1.readv(largeReadSlices) == 50000);
+	testAssert(std::equal(large0.begin(), large0.end(), read0.begin()));
+	testAssert(std::equal(large1.begin(), large1.end(), read1.begin()));
+}
+
+
 testCase(skip) {
 	scopeExit(&removeTestDirectory);
 	File dir = getTestDirectory();
@@ -0,0 +1,240 @@
+﻿#include <balor/io/HashingStream.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <utility>
+#include <vector>
+
+#include <balor/io/MemoryStream.hpp>
+#include <balor/system/windows.hpp>
+#include <balor/test/Benchmark.hpp>
+#include <balor/test/UnitTest.hpp>
+#include <balor/String.hpp>
+
+
+namespace balor {
+	namespace io {
+		namespace testHashingStream {
+
+
+using std::move;
+using std::vector;
+using balor::test::Benchmark;
+typedef HashingStream::Algorithm Algorithm;
+
+
+namespace {
+vector<unsigned char> createData(int size) {
+	vector<unsigned char> data(size);
+	unsigned int seed = 1;
+	for (int i = 0; i < size; ++i) {
+		seed = seed * 1103515245 + 12345;
+		data[i] = static_cast<unsigned char>(seed >> 16);
+	}
+	return data;
+}
+
+
+ArrayRange<const unsigned char> toRange(const char* string) {
+	return ArrayRange<const unsigned char>(reinterpret_cast<const unsigned char*>(string), std::strlen(string));
+}
+
+
+unsigned int referenceCrc32c(const unsigned char* data, int length) { // 1 비트씩 계산하는 검증용 구현
+	unsigned int crc = 0xffffffff;
+	for (int i = 0; i < length; ++i) {
+		crc ^= data[i];
+		for (int j = 0; j < 8; ++j) {
+			crc = crc & 1 ? (crc >> 1) ^ 0x82f63b78 : crc >> 1;
+		}
+	}
+	return ~crc;
+}
+} // namespace
+
+
+
+testCase(crc32c) {
+	// 알려진 값 (RFC 3720)
+	testAssert(HashingStream::crc32c(toRange("")) == 0);
+	testAssert(HashingStream::crc32c(toRange("123456789")) == 0xe3069283);
+	vector<unsigned char> zeros(32, 0x00);
+	testAssert(HashingStream::crc32c(zeros) == 0x8a9136aa);
+	vector<unsigned char> ones(32, 0xff);
+	testAssert(HashingStream::crc32c(ones) == 0x62a8ab43);
+
+	// 정렬되어 있지 않은 위치와 여러 가지 길이. 병렬 계산의 경계를 넘는 길이도 포함한다
+	vector<unsigned char> data = createData(70000);
+	const int lengths[] = {1, 7, 8, 9, 255, 767, 768, 769, 1000, 24575, 24576, 24577, 30000, 69990};
+	for (int offset = 0; offset < 9; ++offset) {
+		for (int i = 0; i < sizeof(lengths) / sizeof(lengths[0]); ++i) {
+			ArrayRange<const unsigned char> range(data.data() + offset, lengths[i]);
+			testAssert(HashingStream::crc32c(range) == referenceCrc32c(range.begin(), range.length()));
+		}
+	}
+
+	// 이어서 계산한다
+	const unsigned int whole = HashingStream::crc32c(data);
+	for (int split = 0; split < 70000; split += 6999) {
+		const unsigned int first = HashingStream::crc32c(ArrayRange<const unsigned char>(data.data(), split));
+		testAssert(HashingStream::crc32c(ArrayRange<const unsigned char>(data.data() + split, data.size() - split), first) == whole);
+	}
+}
+
+
+testCase(xxhash64) {
+	// 알려진 값
+	testAssert(HashingStream::xxhash64(toRange("")) == 0xef46db3751d8e999ULL);
+	testAssert(HashingStream::xxhash64(toRange("a")) == 0xd24ec4f1a98c6e5bULL);
+	testAssert(HashingStream::xxhash64(toRange("abc")) == 0x44bc2cf5ad770999ULL);
+	testAssert(HashingStream::xxhash64(toRange("Nobody inspects the spammish repetition")) == 0xfbcea83c8a378bf1ULL);
+
+	// 시드
+	testAssert(HashingStream::xxhash64(toRange("abc"), 1) != HashingStream::xxhash64(toRange("abc")));
+	testAssert(HashingStream::xxhash64(toRange("abc"), 1) == HashingStream::xxhash64(toRange("abc"), 1));
+}
+
+
+testCase(construct) {
+	MemoryStream memory;
+
+	// 무효한 파라미터
+	testAssertionFailed(HashingStream stream(memory, Algorithm::_enum(-1)));
+
+	{
+		HashingStream stream(memory);
+		testAssert(&stream.stream() == &memory);
+		testAssert(stream.algorithm() == Algorithm::crc32c);
+		testAssert(stream.seed() == 0);
+		testAssert(stream.hash() == 0);
+		testAssert(stream.hashedLength() == 0);
+		testAssert(stream.readable());
+		testAssert(stream.writable());
+	}
+	{
+		HashingStream stream(memory, Algorithm::xxhash64, 5);
+		testAssert(stream.algorithm() == Algorithm::xxhash64);
+		testAssert(stream.seed() == 5);
+		testAssert(stream.hash() == HashingStream::xxhash64(toRange(""), 5));
+	}
+	{// move
+		HashingStream source(memory, Algorithm::xxhash64);
+		source.write("abc", 0, 3);
+		HashingStream stream = move(source);
+		testAssert(&stream.stream() == &memory);
+		testAssert(stream.hash() == HashingStream::xxhash64(toRange("abc")));
+		source = move(stream);
+		testAssert(source.hashedLength() == 3);
+	}
+}
+
+
+testCase(readAndWrite) {
+	vector<unsigned char> data = createData(100000);
+	const Algorithm algorithms[] = {Algorithm::crc32c, Algorithm::xxhash64};
+	for (int i = 0; i < 2; ++i) {
+		const Algorithm algorithm = algorithms[i];
+		const unsigned __int64 expected = algorithm == Algorithm::crc32c ? HashingStream::crc32c(data) : HashingStream::xxhash64(data);
+
+		MemoryStream memory;
+		{// 여러 가지 크기로 나누어 써도 한 번에 계산한 값과 같다
+			HashingStream stream(memory, algorithm);
+			int offset = 0;
+			for (int count = 1; offset < static_cast<int>(data.size()); count = count * 3 % 997 + 1) {
+				const int writeCount = std::min(count, static_cast<int>(data.size()) - offset);
+				stream.write(data.data(), offset, writeCount);
+				offset += writeCount;
+			}
+			testAssert(stream.hashedLength() == static_cast<__int64>(data.size()));
+			testAssert(stream.hash() == expected);
+			testAssert(stream.hash() == expected); // 몇 번 불러도 같다
+			testAssert(memory.length() == static_cast<__int64>(data.size()));
+		}
+		{// 읽기
+			memory.position(0);
+			HashingStream stream(memory, algorithm);
+			vector<unsigned char> buffer(1000);
+			while (stream.read(buffer.data(), 0, 777)) {
+			}
+			testAssert(stream.hash() == expected);
+		}
+		{// readv, writev
+			memory.position(0);
+			HashingStream stream(memory, algorithm);
+			vector<unsigned char> buffer(data.size() + 10);
+			const Stream::Slice slices[] = {
+				Stream::Slice(buffer.data(), 0, 33),
+				Stream::Slice(buffer.data(), 33, 50000),
+				Stream::Slice(buffer.data(), 50033, data.size() + 10 - 50033),
+			};
+			testAssert(stream.readv(slices) == static_cast<int>(data.size())); // 마지막 슬라이스는 도중까지
+			testAssert(stream.hash() == expected);
+
+			MemoryStream memory2;
+			HashingStream writer(memory2, algorithm);
+			const Stream::ConstSlice writeSlices[] = {
+				Stream::ConstSlice(data.data(), 0, 5),
+				Stream::ConstSlice(data.data(), 5, 0),
+				Stream::ConstSlice(data.data(), 5, data.size() - 5),
+			};
+			writer.writev(writeSlices);
+			testAssert(writer.hash() == expected);
+		}
+		{// 이동한 범위는 더하지 않는다
+			memory.position(0);
+			HashingStream stream(memory, algorithm);
+			stream.skip(100);
+			stream.position(200);
+			vector<unsigned char> buffer(100);
+			stream.read(buffer.data(), 0, 100);
+			testAssert(stream.hashedLength() == 100);
+			const ArrayRange<const unsigned char> range(data.data() + 200, 100);
+			testAssert(stream.hash() == (algorithm == Algorithm::crc32c ? HashingStream::crc32c(range) : HashingStream::xxhash64(range)));
+
+			// reset
+			stream.reset();
+			testAssert(stream.hashedLength() == 0);
+			testAssert(stream.hash() == (algorithm == Algorithm::crc32c ? 0 : HashingStream::xxhash64(toRange(""))));
+		}
+	}
+}
+
+
+// ArrayRange 를 직접 계산하는 속도와 HashingStream 을 경유하는 속도. 사이즈는 한 번에 계산하는 바이트 수
+BALOR_BENCHMARK_SIZES(benchmarkHashingStreamCrc32c, 64, 4096, 1024 * 1024) {
+	const vector<unsigned char> data = createData(benchmark.size());
+	unsigned int crc = 0;
+	while (benchmark.running()) {
+		crc = HashingStream::crc32c(data, crc);
+	}
+	Benchmark::doNotOptimize(crc);
+}
+
+
+BALOR_BENCHMARK_SIZES(benchmarkHashingStreamXxhash64, 64, 4096, 1024 * 1024) {
+	const vector<unsigned char> data = createData(benchmark.size());
+	unsigned __int64 xxhash = 0;
+	unsigned __int64 seed = 0;
+	while (benchmark.running()) {
+		xxhash ^= HashingStream::xxhash64(data, seed++);
+	}
+	Benchmark::doNotOptimize(xxhash);
+}
+
+
+BALOR_BENCHMARK_SIZES(benchmarkHashingStreamWrite, 64, 4096, 1024 * 1024) { // MemoryStream 에 쓰면서 crc32c 를 계산한다
+	const vector<unsigned char> data = createData(benchmark.size());
+	MemoryStream memory(data.size());
+	HashingStream stream(memory, Algorithm::crc32c);
+	while (benchmark.running()) {
+		stream.position(0);
+		stream.write(data.data(), 0, data.size());
+	}
+	Benchmark::doNotOptimize(stream.hash());
+}
+
+
+
+		}
+	}
+}
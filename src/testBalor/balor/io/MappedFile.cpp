@@ -0,0 +1,361 @@
+﻿#include <balor/io/MappedFile.hpp>
+
+#include <utility>
+#include <vector>
+
+#include <balor/io/File.hpp>
+#include <balor/io/FileStream.hpp>
+#include <balor/system/windows.hpp>
+#include <balor/test/Benchmark.hpp>
+#include <balor/test/UnitTest.hpp>
+#include <balor/scopeExit.hpp>
+#include <balor/String.hpp>
+
+
+namespace balor {
+	namespace io {
+		namespace testMappedFile {
+
+
+using std::move;
+using std::vector;
+using namespace balor::test;
+
+
+namespace {
+const wchar_t testDirectoryName[] = L"testBalor_io_MappedFile_7qm2xv9rk4ws1dz6hb3pe0nt";
+File getTestDirectory() {
+	File dir(File::getSpecial(File::Special::temporary), testDirectoryName);
+	if (dir.exists()) {
+		dir.remove(true);
+	}
+	dir.createDirectory();
+	return dir;
+}
+
+
+void removeTestDirectory() {
+	File(File::getSpecial(File::Special::temporary), testDirectoryName).remove(true);
+}
+
+
+unsigned char valueAt(__int64 position) {
+	return static_cast<unsigned char>((position * 7) ^ (position >> 8));
+}
+
+
+File createDataFile(const File& dir, StringRange name, int size) {
+	File file(dir, name);
+	vector<unsigned char> data(size);
+	for (int i = 0; i < size; ++i) {
+		data[i] = valueAt(i);
+	}
+	auto stream = file.create();
+	if (size) {
+		stream.write(data.data(), 0, size);
+	}
+	return file;
+}
+} // namespace
+
+
+
+testCase(construct) {
+	scopeExit(&removeTestDirectory);
+	File dir = getTestDirectory();
+
+	// 무효한 파라미터
+	testAssertionFailed(MappedFile(L""));
+	testAssertionFailed(MappedFile(L"a", MappedFile::Hint::_enum(-1)));
+
+	{// 존재하지 않는 파일
+		testThrow(MappedFile(File(dir, L"notFound.bin").path()), MappedFile::NotFoundException);
+	}
+	{// 빈 파일
+		File file = createDataFile(dir, L"empty.bin", 0);
+		MappedFile mapped(file.path());
+		testAssert(mapped);
+		testAssert(mapped.length() == 0);
+		MappedFile::View view = mapped.view();
+		testAssert(view.empty());
+		testAssert(view.begin() == view.end());
+	}
+	{// 파일을 연 채로 다른 핸들에서 읽을 수 있다
+		File file = createDataFile(dir, L"data.bin", 100);
+		MappedFile mapped(file.path(), MappedFile::Hint::sequential);
+		testAssert(mapped.length() == 100);
+		testNoThrow(FileStream(file.path(), FileStream::Mode::open, FileStream::Access::read, FileStream::Share::read));
+	}
+	{// 널 핸들
+		MappedFile mapped;
+		testAssert(!mapped);
+		testAssertionFailed(mapped.length());
+	}
+}
+
+
+testCase(moveConstructAndAssignment) {
+	scopeExit(&removeTestDirectory);
+	File dir = getTestDirectory();
+	File file = createDataFile(dir, L"data.bin", 100);
+
+	MappedFile source(file.path());
+	MappedFile mapped0 = move(source);
+	testAssert(!source);
+	testAssert(mapped0);
+	testAssert(mapped0.length() == 100);
+
+	MappedFile mapped1;
+	mapped1 = move(mapped0);
+	testAssert(!mapped0);
+	testAssert(mapped1.length() == 100);
+
+	MappedFile::View view0 = mapped1.view(10, 20);
+	MappedFile::View view1 = move(view0);
+	testAssert(view0.empty());
+	testAssert(view1.length() == 20);
+	testAssert(view1[0] == valueAt(10));
+	view0 = move(view1);
+	testAssert(view1.empty());
+	testAssert(view0[19] == valueAt(29));
+}
+
+
+testCase(view) {
+	scopeExit(&removeTestDirectory);
+	File dir = getTestDirectory();
+	const int granularity = MappedFile::granularity();
+	const int size = granularity * 2 + 100;
+	File file = createDataFile(dir, L"data.bin", size);
+	MappedFile mapped(file.path());
+
+	// 무효한 파라미터
+	testAssertionFailed(mapped.view(-1, 1));
+	testAssertionFailed(mapped.view(0, -1));
+	testAssertionFailed(mapped.view(size - 1, 2));
+	testAssertionFailed(mapped.view(0, 1, MappedFile::Hint::_enum(-1)));
+
+	{// 파일 전체
+		MappedFile::View view = mapped.view(MappedFile::Hint::willNeed);
+		testAssert(view.offset() == 0);
+		testAssert(view.length() == size);
+		testAssert(view.end() - view.begin() == size);
+		bool equal = true;
+		for (int i = 0; i < size; ++i) {
+			equal = equal && view[i] == valueAt(i);
+		}
+		testAssert(equal);
+		testAssertionFailed(view[size]);
+	}
+	{// 할당 단위에 맞지 않는 위치
+		const __int64 offset = granularity + 3;
+		MappedFile::View view = mapped.view(offset, 50, MappedFile::Hint::random);
+		testAssert(view.offset() == offset);
+		testAssert(view.length() == 50);
+		ArrayRange<const unsigned char> range = view;
+		testAssert(range.length() == 50);
+		testAssert(range[0] == valueAt(offset));
+		testAssert(range[49] == valueAt(offset + 49));
+		testNoThrow(view.hint(MappedFile::Hint::sequential));
+	}
+	{// 파일 끝에 걸친 뷰
+		MappedFile::View view = mapped.view(size - 10, 10);
+		testAssert(view[9] == valueAt(size - 1));
+	}
+	{// 길이 0 의 뷰
+		MappedFile::View view = mapped.view(size, 0);
+		testAssert(view.empty());
+		testAssert(view.offset() == size);
+	}
+	{// MappedFile 을 파괴한 후에도 뷰는 유효
+		MappedFile::View view;
+		{
+			MappedFile other(file.path());
+			view = other.view(5, 5);
+		}
+		testAssert(view[0] == valueAt(5));
+	}
+}
+
+
+testCase(streamConstruct) {
+	scopeExit(&removeTestDirectory);
+	File dir = getTestDirectory();
+	File file = createDataFile(dir, L"data.bin", 100);
+	MappedFile mapped(file.path());
+
+	// 무효한 파라미터
+	MappedFile nullFile;
+	testAssertionFailed(MappedFileStream(nullFile, 1));
+	testAssertionFailed(MappedFileStream(mapped, 0));
+	testAssertionFailed(MappedFileStream(mapped, 1, MappedFile::Hint::_enum(-1)));
+
+	MappedFileStream stream(mapped, 1);
+	testAssert(&stream.file() == &mapped);
+	testAssert(stream.windowSize() == MappedFile::granularity());
+	testAssert(stream.readable());
+	testAssert(!stream.writable());
+	testAssertionFailed(stream.write("a", 0, 1));
+	testAssert(stream.length() == 100);
+	testAssert(stream.position() == 0);
+
+	MappedFileStream other = move(stream);
+	testAssertionFailed(stream.position());
+	testAssert(other.read() == valueAt(0));
+	MappedFileStream other2;
+	other2 = move(other);
+	testAssert(other2.read() == valueAt(1));
+}
+
+
+testCase(streamRead) {
+	scopeExit(&removeTestDirectory);
+	File dir = getTestDirectory();
+	const int granularity = MappedFile::granularity();
+	const int size = granularity * 3 + 123;
+	File file = createDataFile(dir, L"data.bin", size);
+	MappedFile mapped(file.path());
+	MappedFileStream stream(mapped, granularity);
+	vector<unsigned char> buffer(size + 10);
+
+	// 무효한 파라미터
+	testAssertionFailed(stream.read(nullptr, 0, 1));
+	testAssertionFailed(stream.read(buffer.data(), -1, 1));
+	testAssertionFailed(stream.read(buffer.data(), 0, -1));
+
+	testAssert(stream.read() == valueAt(0));
+
+	// 윈도우의 경계에 걸친 읽기
+	stream.position(granularity - 2);
+	testAssert(stream.read(buffer.data(), 1, 4) == 4);
+	testAssert(buffer[1] == valueAt(granularity - 2));
+	testAssert(buffer[4] == valueAt(granularity + 1));
+	testAssert(stream.position() == granularity + 2);
+
+	// 복수의 윈도우에 걸친 읽기
+	stream.position(0);
+	testAssert(stream.read(buffer.data(), 0, size + 10) == size);
+	bool equal = true;
+	for (int i = 0; i < size; ++i) {
+		equal = equal && buffer[i] == valueAt(i);
+	}
+	testAssert(equal);
+
+	// 끝에 도달
+	testAssert(stream.read(buffer.data(), 0, 1) == 0);
+	testAssert(stream.read() == -1);
+	stream.position(size + 100);
+	testAssert(stream.read() == -1);
+	testAssert(stream.position() == size + 100);
+}
+
+
+testCase(streamReadView) {
+	scopeExit(&removeTestDirectory);
+	File dir = getTestDirectory();
+	const int granularity = MappedFile::granularity();
+	const int size = granularity * 2 + 10;
+	File file = createDataFile(dir, L"data.bin", size);
+	MappedFile mapped(file.path());
+	MappedFileStream stream(mapped, granularity);
+
+	// 무효한 파라미터
+	testAssertionFailed(stream.readView(-1));
+
+	testAssert(stream.readView(0).empty());
+	auto bytes = stream.readView(10);
+	testAssert(bytes.length() == 10);
+	testAssert(bytes[9] == valueAt(9));
+
+	// 윈도우의 끝을 넘지 않는다
+	bytes = stream.readView(granularity);
+	testAssert(bytes.length() == granularity - 10);
+	testAssert(bytes[0] == valueAt(10));
+	bytes = stream.readView(granularity * 2);
+	testAssert(bytes.length() == granularity);
+	testAssert(bytes[0] == valueAt(granularity));
+	bytes = stream.readView(granularity);
+	testAssert(bytes.length() == 10);
+	testAssert(bytes[9] == valueAt(size - 1));
+	testAssert(stream.readView(1).empty());
+}
+
+
+testCase(streamSkip) {
+	scopeExit(&removeTestDirectory);
+	File dir = getTestDirectory();
+	const int granularity = MappedFile::granularity();
+	File file = createDataFile(dir, L"data.bin", granularity * 2);
+	MappedFile mapped(file.path());
+	MappedFileStream stream(mapped, granularity);
+
+	// 무효한 파라미터
+	testAssertionFailed(stream.position(-1));
+
+	testAssert(stream.skip(5) == 5);
+	testAssert(stream.read() == valueAt(5));
+	testAssert(stream.skip(granularity) == granularity);
+	testAssert(stream.read() == valueAt(granularity + 6));
+	testAssert(stream.skip(-3) == -3);
+	testAssert(stream.read() == valueAt(granularity + 4));
+	testAssert(stream.skip(-granularity * 3) == -(granularity + 5));
+	testAssert(stream.position() == 0);
+	testAssert(stream.skip(granularity * 3) == granularity * 3);
+	testAssert(stream.read() == -1);
+}
+
+
+// 파일 전체의 합계. FileStream::read 와 MappedFile 의 뷰와 MappedFileStream::readView 의 비교. 사이즈는 파일의 바이트 수
+BALOR_BENCHMARK_SIZES(benchmarkMappedFileFileStreamRead, 64 * 1024, 4 * 1024 * 1024) {
+	scopeExit(&removeTestDirectory);
+	File file = createDataFile(getTestDirectory(), L"data.bin", benchmark.size());
+	vector<unsigned char> buffer(64 * 1024);
+	while (benchmark.running()) {
+		unsigned int sum = 0;
+		auto stream = file.openRead();
+		for (int count = stream.read(buffer.data(), 0, buffer.size()); count; count = stream.read(buffer.data(), 0, buffer.size())) {
+			for (int i = 0; i < count; ++i) {
+				sum += buffer[i];
+			}
+		}
+		Benchmark::doNotOptimize(sum);
+	}
+}
+
+
+BALOR_BENCHMARK_SIZES(benchmarkMappedFileView, 64 * 1024, 4 * 1024 * 1024) {
+	scopeExit(&removeTestDirectory);
+	File file = createDataFile(getTestDirectory(), L"data.bin", benchmark.size());
+	while (benchmark.running()) {
+		unsigned int sum = 0;
+		MappedFile mapped(file.path(), MappedFile::Hint::sequential);
+		MappedFile::View view = mapped.view(MappedFile::Hint::sequential);
+		for (auto i = view.begin(), end = view.end(); i != end; ++i) {
+			sum += *i;
+		}
+		Benchmark::doNotOptimize(sum);
+	}
+}
+
+
+BALOR_BENCHMARK_SIZES(benchmarkMappedFileStreamReadView, 64 * 1024, 4 * 1024 * 1024) {
+	scopeExit(&removeTestDirectory);
+	File file = createDataFile(getTestDirectory(), L"data.bin", benchmark.size());
+	while (benchmark.running()) {
+		unsigned int sum = 0;
+		MappedFile mapped(file.path(), MappedFile::Hint::sequential);
+		MappedFileStream stream(mapped, 4 * 1024 * 1024);
+		for (auto bytes = stream.readView(benchmark.size()); !bytes.empty(); bytes = stream.readView(benchmark.size())) {
+			for (auto i = bytes.begin(), end = bytes.end(); i != end; ++i) {
+				sum += *i;
+			}
+		}
+		Benchmark::doNotOptimize(sum);
+	}
+}
+
+
+
+		}
+	}
+}
@@ -281,6 +281,43 @@ testCase(read) {
 //}
 
 
+testCase(readv) {
+	char source[7] = "012345";
+	MemoryStream stream0(source, 0, 6);
+	MemoryStream stream1 = move(stream0);
+
+	// 무효한 파라미터
+	char buffer0[3] = {0};
+	char buffer1[5] = {0};
+	Stream::Slice nullSlices[] = {Stream::Slice(buffer0, 0, 2), Stream::Slice()};
+	testAssertionFailed(stream0.readv(nullSlices));
+	nullSlices[1].count = 1;
+	testAssertionFailed(stream1.readv(nullSlices));
+	Stream::Slice negativeSlices[] = {Stream::Slice(buffer0, 0, -1)};
+	testAssertionFailed(stream1.readv(negativeSlices));
+	nullSlices[1].count = 0;
+	testNoThrow        (stream1.readv(nullSlices));
+
+	// 읽기
+	stream1.position(0);
+	Stream::Slice slices[] = {Stream::Slice(buffer0, 0, 2), Stream::Slice(buffer1, 1, 3)};
+	testAssert(stream1.readv(slices) == 5);
+	testAssert(stream1.position() == 5);
+	testAssert(String::equals(buffer0, "01"));
+	testAssert(String::equals(buffer1 + 1, "234"));
+
+	// 범위 외 읽기
+	stream1.position(1);
+	testAssert(stream1.readv(slices) == 5);
+	stream1.position(3);
+	testAssert(stream1.readv(slices) == 3);
+	testAssert(String::equals(buffer0, "34"));
+	testAssert(String::equals(buffer1 + 1, "545"));
+	testAssert(stream1.readv(slices) == 0);
+	testAssert(stream1.position() == 6);
+}
+
+
 testCase(skip) {
 	char source[5] = "0123";
 	MemoryStream stream0(source, 0, 4);
@@ -365,6 +402,45 @@ testCase(write) {
 //}
 
 
+testCase(writev) {
+	char source[7] = "012345";
+	MemoryStream stream0(source, 0, 6);
+	MemoryStream stream1 = move(stream0);
+	MemoryStream stream2(source, 0, 6, false);
+	MemoryStream stream3(4);
+
+	// 무효한 파라미터
+	Stream::ConstSlice slices[] = {Stream::ConstSlice("ab", 0, 2), Stream::ConstSlice("0123", 1, 2)};
+	Stream::ConstSlice nullSlices[] = {Stream::ConstSlice(nullptr, 0, 1)};
+	Stream::ConstSlice negativeSlices[] = {Stream::ConstSlice("ab", 0, -1)};
+	testAssertionFailed(stream0.writev(slices));
+	testAssertionFailed(stream1.writev(nullSlices));
+	testAssertionFailed(stream1.writev(negativeSlices));
+	testAssertionFailed(stream2.writev(slices));
+	testNoThrow        (stream1.writev(ArrayRange<const Stream::ConstSlice>(slices, 0)));
+
+	// 쓰기
+	char buffer[10] = {0};
+	stream1.position(1);
+	stream1.writev(slices);
+	testAssert(stream1.length() == 6);
+	testAssert(stream1.position() == 5);
+	testAssert(String::equals(source, "0ab125"));
+	testThrow(stream1.writev(slices), MemoryStream::BufferOverrunException);
+	testAssert(stream1.position() == 5);
+
+	// 범위 외 쓰기는 버퍼를 한번만 확장한다
+	Stream::ConstSlice largeSlices[] = {Stream::ConstSlice("0123", 0, 4), Stream::ConstSlice("abcd", 0, 4), Stream::ConstSlice("ABCD", 0, 4), Stream::ConstSlice("xy", 0, 2)};
+	stream3.writev(largeSlices);
+	testAssert(stream3.length() == 14);
+	testAssert(stream3.position() == 14);
+	testAssert(stream3.capacity() == 16);
+	stream3.position(0);
+	stream3.read(buffer, 0, 10);
+	testAssert(String::equals(buffer, "0123abcdAB"));
+}
+
+
 
 		}
 	}
@@ -0,0 +1,300 @@
+﻿#include <balor/io/PrefetchStream.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <utility>
+#include <vector>
+
+#include <balor/io/MemoryStream.hpp>
+#include <balor/system/windows.hpp>
+#include <balor/test/Benchmark.hpp>
+#include <balor/test/UnitTest.hpp>
+#include <balor/Exception.hpp>
+#include <balor/String.hpp>
+
+
+namespace balor {
+	namespace io {
+		namespace testPrefetchStream {
+
+
+using std::move;
+using std::vector;
+using balor::test::Benchmark;
+
+
+namespace {
+class ReadException : public Exception {};
+
+
+/// 읽을 때마다 sleepMilliseconds 만큼 기다리고, failPosition 이후를 읽으려고 하면 ReadException 을 던지는 Stream
+class SlowStream : public Stream {
+public:
+	SlowStream(Stream& stream, int sleepMilliseconds = 0, __int64 failPosition = -1)
+		: _stream(stream), _sleepMilliseconds(sleepMilliseconds), _failPosition(failPosition), readBytes(0), readCount(0) {}
+
+	virtual void flush() { _stream.flush(); }
+	virtual __int64 length() const { return _stream.length(); }
+	virtual __int64 position() const { return _stream.position(); }
+	virtual void position(__int64 value) { _stream.position(value); }
+	using Stream::read;
+	virtual int read(void* buffer, int offset, int count) {
+		if (0 <= _failPosition && _failPosition <= _stream.position()) {
+			throw ReadException();
+		}
+		if (_sleepMilliseconds) {
+			Sleep(_sleepMilliseconds);
+		}
+		++readCount;
+		const int result = _stream.read(buffer, offset, count);
+		readBytes += result;
+		return result;
+	}
+	virtual bool readable() const { return _stream.readable(); }
+	virtual __int64 skip(__int64 offset) { return _stream.skip(offset); }
+	using Stream::write;
+	virtual void write(const void* buffer, int offset, int count) { _stream.write(buffer, offset, count); }
+	virtual bool writable() const { return _stream.writable(); }
+
+private:
+	SlowStream& operator=(const SlowStream&);
+
+	Stream& _stream;
+	int _sleepMilliseconds;
+	__int64 _failPosition;
+public:
+	__int64 readBytes;
+	int readCount;
+};
+
+
+vector<unsigned char> createData(int length) {
+	vector<unsigned char> data(length);
+	for (int i = 0; i < length; ++i) {
+		data[i] = static_cast<unsigned char>(i * 7 + (i >> 8));
+	}
+	return data;
+}
+
+
+/// CPU 를 쓰는 파서 대신. 바이트마다 몇 번의 곱셈을 한다
+unsigned int parse(const unsigned char* i, const unsigned char* end, unsigned int state) {
+	for (; i != end; ++i) {
+		state = (state ^ *i) * 16777619u;
+		state = (state ^ (state >> 13)) * 0x5bd1e995u;
+		state = (state ^ (state >> 15)) * 0x27d4eb2du;
+	}
+	return state;
+}
+} // namespace
+
+
+
+testCase(construct) {
+	MemoryStream memory;
+
+	// 무효한 파라미터
+	testAssertionFailed(PrefetchStream stream(memory, 0));
+	testAssertionFailed(PrefetchStream stream(memory, 1024, 0));
+
+	{
+		PrefetchStream stream(memory, 1024, 3);
+		testAssert(&stream.stream() == &memory);
+		testAssert(stream.blockSize() == 1024);
+		testAssert(stream.blockCount() == 3);
+		testAssert(stream.readable());
+		testAssert(!stream.writable());
+		testAssertionFailed(stream.write("a", 0, 1));
+		testAssert(stream.length() == 0);
+		testAssert(stream.position() == 0);
+		testAssert(stream.read() == -1);
+		testAssert(stream.readBlock().empty());
+		testAssert(stream.seekCount() == 0);
+	}
+
+	{// move
+		vector<unsigned char> data = createData(100);
+		MemoryStream source(data.data(), 0, data.size(), false);
+		PrefetchStream stream0(source, 16);
+		testAssert(stream0.read() == data[0]);
+		PrefetchStream stream1 = move(stream0);
+		testAssert(stream1.read() == data[1]);
+		stream0 = move(stream1);
+		testAssert(stream0.read() == data[2]);
+	}
+}
+
+
+testCase(read) {
+	vector<unsigned char> data = createData(100000);
+	MemoryStream memory(data.data(), 0, data.size(), false);
+	SlowStream slow(memory);
+	{
+		PrefetchStream stream(slow, 1000, 3);
+		testAssert(stream.length() == 100000);
+
+		// 무효한 파라미터
+		unsigned char buffer[5000];
+		testAssertionFailed(stream.read(nullptr, 0, 1));
+		testAssertionFailed(stream.read(buffer, -1, 1));
+		testAssertionFailed(stream.read(buffer, 0, -1));
+
+		const int counts[] = {1, 7, 999, 1000, 1001, 4321, 0};
+		int position = 0;
+		for (int i = 0; position < 100000; ++i) {
+			const int count = std::min(counts[i % 7], 100000 - position);
+			testAssert(stream.read(buffer, 0, count) == count);
+			testAssert(std::memcmp(buffer, data.data() + position, count) == 0);
+			position += count;
+			testAssert(stream.position() == position);
+		}
+		testAssert(stream.read(buffer, 0, 10) == 0);
+		testAssert(stream.read() == -1);
+		testAssert(stream.seekCount() == 0);
+	}
+	testAssert(slow.readBytes == 100000);
+	testAssert(memory.position() == 100000);
+}
+
+
+testCase(readBlock) {
+	vector<unsigned char> data = createData(100000);
+	MemoryStream memory(data.data(), 0, data.size(), false);
+	PrefetchStream stream(memory, 4096, 4);
+
+	testAssert(stream.read() == data[0]);
+	vector<unsigned char> result(1, data[0]);
+	for (auto block = stream.readBlock(); !block.empty(); block = stream.readBlock()) {
+		testAssert(block.length() <= 4096);
+		result.insert(result.end(), block.begin(), block.end());
+		testAssert(stream.position() == static_cast<__int64>(result.size()));
+	}
+	testAssert(result == data);
+	testAssert(stream.readBlock().empty());
+}
+
+
+testCase(positionAndSkip) {
+	vector<unsigned char> data = createData(100000);
+	MemoryStream memory(data.data(), 0, data.size(), false);
+	SlowStream slow(memory);
+	PrefetchStream stream(slow, 1000, 4);
+
+	// 무효한 파라미터
+	testAssertionFailed(stream.position(-1));
+
+	unsigned char buffer[10];
+	testAssert(stream.read(buffer, 0, 10) == 10);
+	stream.position(3); // 링 위의 이동
+	testAssert(stream.read() == data[3]);
+	testAssert(stream.skip(5) == 5);
+	testAssert(stream.read() == data[9]);
+	testAssert(stream.skip(-4) == -4);
+	testAssert(stream.read() == data[6]);
+	testAssert(stream.seekCount() == 0);
+
+	// 링 밖의 이동은 선읽기를 버리고 한 블록으로 줄인다
+	stream.position(50000);
+	testAssert(stream.seekCount() == 1);
+	testAssert(stream.read() == data[50000]);
+	testAssert(stream.length() == 100000); // 스레드가 읽기를 마치는 것을 기다린다
+	testAssert(memory.position() == 51000); // 한 블록만 읽었다
+	testAssert(stream.position() == 50001);
+
+	testAssert(stream.skip(-50001 - 10) == -50001);
+	testAssert(stream.position() == 0);
+	testAssert(stream.seekCount() == 2);
+	testAssert(stream.read() == data[0]);
+
+	// 순서대로 읽으면 다시 blockCount 까지 선읽기를 늘린다
+	vector<unsigned char> rest(99999);
+	testAssert(stream.read(rest.data(), 0, 99999) == 99999);
+	testAssert(std::equal(rest.begin(), rest.end(), data.begin() + 1));
+
+	// 끝을 넘는 위치
+	stream.position(200000);
+	testAssert(stream.position() == 200000);
+	testAssert(stream.read() == -1);
+	stream.position(99990);
+	testAssert(stream.read(buffer, 0, 10) == 10);
+	testAssert(buffer[9] == data[99999]);
+}
+
+
+testCase(readError) {
+	vector<unsigned char> data = createData(1000);
+	MemoryStream memory(data.data(), 0, data.size(), false);
+	SlowStream slow(memory, 0, 250);
+	PrefetchStream stream(slow, 100, 2);
+
+	unsigned char buffer[1000];
+	testAssert(stream.read(buffer, 0, 1000) == 300); // 읽은 데이터를 먼저 돌려준다
+	testAssert(std::memcmp(buffer, data.data(), 300) == 0);
+	testThrow(stream.read(buffer, 0, 1), ReadException);
+
+	// 위치를 옮기면 다시 읽을 수 있다
+	stream.position(10);
+	testAssert(stream.read() == data[10]);
+}
+
+
+testCase(destruct) {
+	vector<unsigned char> data = createData(100000);
+	MemoryStream memory(data.data(), 0, data.size(), false);
+	memory.position(5);
+	{
+		PrefetchStream stream(memory, 1000, 4);
+		testAssert(stream.position() == 5);
+		unsigned char buffer[10];
+		testAssert(stream.read(buffer, 0, 10) == 10);
+		testAssert(buffer[0] == data[5]);
+	}
+	testAssert(memory.position() == 15); // 선읽기한 만큼 되돌린다
+	{
+		PrefetchStream stream(memory, 1000, 4);
+		stream.position(99999);
+		testAssert(stream.read() == data[99999]);
+	}
+	testAssert(memory.position() == 100000);
+}
+
+
+// 읽기에 시간이 걸리는 Stream 을 CPU 를 쓰는 파서로 처리하는 경우의 비교. 한 번에 2MB 를 256KB 블록으로 처리한다
+BALOR_BENCHMARK(benchmarkPrefetchStreamDirect) {
+	const int blockSize = 256 * 1024;
+	vector<unsigned char> data = createData(2 * 1024 * 1024);
+	vector<unsigned char> buffer(blockSize);
+	MemoryStream memory(data.data(), 0, data.size(), false);
+	SlowStream slow(memory, 2); // 블록마다 2 밀리초 걸리는 디스크 대신
+	unsigned int state = 0;
+	while (benchmark.running()) {
+		memory.position(0);
+		for (int count = slow.read(buffer.data(), 0, blockSize); count; count = slow.read(buffer.data(), 0, blockSize)) {
+			state = parse(buffer.data(), buffer.data() + count, state);
+		}
+	}
+	Benchmark::doNotOptimize(state);
+}
+
+
+BALOR_BENCHMARK(benchmarkPrefetchStreamReadBlock) {
+	const int blockSize = 256 * 1024;
+	vector<unsigned char> data = createData(2 * 1024 * 1024);
+	MemoryStream memory(data.data(), 0, data.size(), false);
+	SlowStream slow(memory, 2);
+	unsigned int state = 0;
+	while (benchmark.running()) {
+		memory.position(0);
+		PrefetchStream stream(slow, blockSize, 4);
+		for (auto block = stream.readBlock(); !block.empty(); block = stream.readBlock()) {
+			state = parse(block.begin(), block.end(), state);
+		}
+	}
+	Benchmark::doNotOptimize(state);
+}
+
+
+
+		}
+	}
+}
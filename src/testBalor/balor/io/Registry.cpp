@@ -8,8 +8,11 @@
 #include <boost/assign/std/vector.hpp>
 #pragma warning(pop)
 
+#include <balor/io/RegistryBatch.hpp>
+#include <balor/io/RegistrySnapshot.hpp>
 #include <balor/system/EnvironmentVariable.hpp>
 #include <balor/system/windows.hpp>
+#include <balor/test/Benchmark.hpp>
 #include <balor/test/HandleLeakChecker.hpp>
 #include <balor/test/UnitTest.hpp>
 #include <balor/scopeExit.hpp>
@@ -24,6 +27,7 @@ using std::vector;
 using std::move;
 using namespace boost::assign;
 using namespace balor::system;
+using balor::test::Benchmark;
 
 
 namespace {
@@ -46,6 +50,25 @@ Registry getTestKey() {
 }
 
 
+vector<String> valueNames(int count) {
+	vector<String> names;
+	for (int i = 0; i < count; ++i) {
+		names.push_back(String(L"value") + i);
+	}
+	return names;
+}
+
+
+/// testKey 아래에 direct 키를 만들고 names 의 값을 쓴다
+Registry createBenchmarkValues(Registry& testKey, const vector<String>& names) {
+	Registry key = testKey.createKey(L"direct", true);
+	for (int i = 0, end = static_cast<int>(names.size()); i < end; ++i) {
+		key.setDword(names[i], i);
+	}
+	return key;
+}
+
+
 bool findExistKeyAndValue(const Registry& key) {
 	if (0 < key.valueCount()) {
 		auto names = key.valueNamesIterator();
@@ -144,6 +167,119 @@ testCase(destruct) {
 }
 
 
+// 값마다 레지스트리에 접근하는 경우와 스냅샷, 배치의 비교. 한 번에 1000 개의 값을 처리한다
+BALOR_BENCHMARK(benchmarkRegistrySetDword) {
+	Registry testKey = getTestKey();
+	scopeExit(&testKeyDeleteFunction);
+	const vector<String> names = valueNames(1000);
+	Registry key = testKey.createKey(L"direct", true);
+	while (benchmark.running()) {
+		for (int i = 0; i < 1000; ++i) {
+			key.setDword(names[i], i);
+		}
+	}
+}
+
+
+BALOR_BENCHMARK(benchmarkRegistryCommit) {
+	Registry testKey = getTestKey();
+	scopeExit(&testKeyDeleteFunction);
+	const vector<String> names = valueNames(1000);
+	while (benchmark.running()) {
+		RegistryBatch batch;
+		for (int i = 0; i < 1000; ++i) {
+			batch.setDword(L"batch", names[i], i);
+		}
+		testKey.commit(batch);
+	}
+}
+
+
+BALOR_BENCHMARK(benchmarkRegistryGetDword) {
+	Registry testKey = getTestKey();
+	scopeExit(&testKeyDeleteFunction);
+	const vector<String> names = valueNames(1000);
+	Registry key = createBenchmarkValues(testKey, names);
+	__int64 sum = 0;
+	while (benchmark.running()) {
+		for (int i = 0; i < 1000; ++i) {
+			sum += key.getDword(names[i]);
+		}
+	}
+	Benchmark::doNotOptimize(sum);
+}
+
+
+BALOR_BENCHMARK(benchmarkRegistrySnapshot) { // 스냅샷을 얻어서 값을 얻는다
+	Registry testKey = getTestKey();
+	scopeExit(&testKeyDeleteFunction);
+	const vector<String> names = valueNames(1000);
+	Registry key = createBenchmarkValues(testKey, names);
+	__int64 sum = 0;
+	while (benchmark.running()) {
+		RegistrySnapshot snapshot = key.snapshot();
+		for (int i = 0; i < 1000; ++i) {
+			sum += snapshot.getDword(names[i]);
+		}
+	}
+	Benchmark::doNotOptimize(sum);
+}
+
+
+testCase(commit) {
+	{// 빈 레지스트 키
+		Registry emptyKey;
+		testAssertionFailed(emptyKey.commit(RegistryBatch()));
+	}
+
+	// 테스트 용 레지스트 키 준비
+	Registry testKey = getTestKey();
+	scopeExit(&testKeyDeleteFunction);
+
+	testKey.setString(L"old", L"old");
+	testKey.createKey(L"removed\\child", true).setDword(L"value", 1);
+
+	RegistryBatch batch;
+	batch.setString(L"", L"string", L"test");
+	batch.setDword(L"sub\\deep", L"dword", 1024);
+	batch.setQword(L"sub", L"qword", 0x123456789ABCDEFULL);
+	batch.createKey(L"empty");
+	batch.removeValue(L"", L"old");
+	batch.removeValue(L"notFound", L"value"); // 없는 키의 값 삭제는 무시
+	batch.removeKey(L"removed");
+	testNoThrow(testKey.commit(batch));
+
+	testAssert(testKey.getString(L"string") == L"test");
+	testAssert(testKey.getValueKind(L"old") == Registry::ValueKind::notFound);
+	testAssert(testKey.openKey(L"sub\\deep").getDword(L"dword") == 1024);
+	testAssert(testKey.openKey(L"sub").getQword(L"qword") == 0x123456789ABCDEFULL);
+	testAssert(testKey.openKey(L"empty"));
+	testAssert(!testKey.openKey(L"notFound"));
+	testAssert(!testKey.openKey(L"removed"));
+
+	// 빈 배치는 아무것도 하지 않는다
+	testNoThrow(testKey.commit(RegistryBatch()));
+	testAssert(testKey.getString(L"string") == L"test");
+
+	{// 도중에 실패하면 앞의 변경도 롤백된다
+		RegistryBatch failBatch;
+		failBatch.setString(L"", L"string", L"changed");
+		failBatch.removeValue(L"sub", L"qword");
+		failBatch.setDword(String(L'a', 300), L"dword", 1); // 키 이름이 너무 길다
+		testThrow(testKey.commit(failBatch), Registry::InvalidParameterException);
+		testAssert(testKey.getString(L"string") == L"test");
+		testAssert(testKey.openKey(L"sub").getQword(L"qword") == 0x123456789ABCDEFULL);
+	}
+	{// 삭제된 키에 커밋
+		Registry subKey = testKey.createKey(L"subKey", true);
+		testKey.removeKey(L"subKey");
+		RegistryBatch subBatch;
+		subBatch.setDword(L"", L"dword", 1);
+		testThrow(subKey.commit(subBatch), Registry::KeyDeletedException);
+	}
+}
+
+
 testCase(createKey) {
 	{// 빈 레지스트키
 		Registry emptyKey;
@@ -590,6 +726,58 @@ testCase(setValue) {
 }
 
 
+testCase(snapshot) {
+	{// 빈 레지스트 키
+		Registry emptyKey;
+		testAssertionFailed(emptyKey.snapshot());
+	}
+
+	// 테스트 용 레지스트 키 준비
+	Registry testKey = getTestKey();
+	scopeExit(&testKeyDeleteFunction);
+
+	testKey.setString(L"string", L"test");
+	testKey.setDword(L"dword", 1024);
+	testKey.createKey(L"sub\\deep", true).setQword(L"qword", 0x123456789ABCDEFULL);
+
+	{// 재귀적으로 읽는다
+		RegistrySnapshot snapshot = testKey.snapshot();
+		testAssert(snapshot.valueCount() == 2);
+		testAssert(snapshot.getString(L"STRING") == L"test");
+		testAssert(snapshot.getDword(L"dword") == 1024);
+		testAssert(snapshot.keyCount() == 1);
+		testAssert(snapshot.openKey(L"sub\\deep").getQword(L"qword") == 0x123456789ABCDEFULL);
+
+		// 스냅샷은 레지스트리 변경의 영향을 받지 않는다
+		testKey.setDword(L"dword", 1);
+		testAssert(snapshot.getDword(L"dword") == 1024);
+	}
+	{// 서브키는 읽지 않는다
+		RegistrySnapshot snapshot = testKey.snapshot(false);
+		testAssert(snapshot.valueCount() == 2);
+		testAssert(snapshot.getDword(L"dword") == 1);
+		testAssert(snapshot.keyCount() == 0);
+		testAssert(!snapshot.openKey(L"sub"));
+	}
+	{// 값이 많은 키를 한 번에 읽는다
+		Registry subKey = testKey.createKey(L"many", true);
+		RegistryBatch batch;
+		for (int i = 0; i < 1000; ++i) {
+			batch.setDword(L"", String(L"value") + i, i);
+		}
+		subKey.commit(batch);
+		RegistrySnapshot snapshot = subKey.snapshot();
+		testAssert(snapshot.valueCount() == 1000);
+		testAssert(snapshot.getDword(L"value999") == 999);
+	}
+	{// 삭제된 키
+		Registry subKey = testKey.createKey(L"subKey");
+		testKey.removeKey(L"subKey");
+		testThrow(subKey.snapshot(), Registry::KeyDeletedException);
+	}
+}
+
+
 testCase(valueCount) {
 	{// 빈 레지스트 키
 		Registry emptyKey;
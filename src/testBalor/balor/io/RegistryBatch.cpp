@@ -0,0 +1,177 @@
+﻿#include <balor/io/RegistryBatch.hpp>
+
+#include <cstdint>
+#include <cstring>
+#include <utility>
+#include <vector>
+
+#include <balor/test/UnitTest.hpp>
+#include <balor/String.hpp>
+
+
+namespace balor {
+	namespace io {
+		namespace testRegistryBatch {
+
+
+using std::move;
+using std::vector;
+typedef RegistryBatch::OperationKind OperationKind;
+
+
+
+testCase(constructAndAssignment) {
+	RegistryBatch batch;
+	testAssert(batch.empty());
+	testAssert(batch.size() == 0);
+
+	batch.setDword(L"key", L"value", 1);
+	RegistryBatch batch2 = move(batch);
+	testAssert(batch2.size() == 1);
+	testAssert(batch.empty());
+
+	batch = move(batch2);
+	testAssert(batch.size() == 1);
+	testAssert(batch2.empty());
+}
+
+
+testCase(clear) {
+	RegistryBatch batch;
+	batch.setDword(L"key", L"value", 1);
+	batch.createKey(L"key2");
+	batch.clear();
+	testAssert(batch.empty());
+
+	// clear 후에도 합쳐지지 않고 추가된다
+	batch.setDword(L"key", L"value", 2);
+	testAssert(batch.size() == 1);
+}
+
+
+testCase(createKey) {
+	RegistryBatch batch;
+	// 무효한 파라미터
+	testAssertionFailed(batch.createKey(L"\\key"));
+	testAssertionFailed(batch.createKey(L"key\\"));
+	testAssertionFailed(batch.createKey(L"key\\\\sub"));
+
+	batch.createKey(L"key\\sub");
+	testAssert(batch.size() == 1);
+	testAssert(batch.operations()[0].kind == OperationKind::createKey);
+	testAssert(batch.operations()[0].keyPath == L"key\\sub");
+
+	// 같은 키는 대소문자를 구별하지 않고 한 번만
+	batch.createKey(L"KEY\\Sub");
+	testAssert(batch.size() == 1);
+}
+
+
+testCase(removeKey) {
+	RegistryBatch batch;
+	// 무효한 파라미터
+	testAssertionFailed(batch.removeKey(L""));
+	testAssertionFailed(batch.removeKey(L"key\\"));
+
+	batch.setDword(L"key", L"value", 1);
+	batch.setDword(L"key\\sub", L"value", 1);
+	batch.createKey(L"key\\sub\\deep");
+	batch.setDword(L"keyOther", L"value", 1);
+	batch.setDword(L"", L"value", 1);
+	testAssert(batch.size() == 5);
+
+	// 삭제하는 키 이하의 앞의 변경은 취소된다
+	batch.removeKey(L"KEY");
+	testAssert(batch.size() == 3);
+	testAssert(batch.operations()[0].keyPath == L"keyOther");
+	testAssert(batch.operations()[1].keyPath == L"");
+	testAssert(batch.operations()[2].kind == OperationKind::removeKey);
+	testAssert(batch.operations()[2].keyPath == L"KEY");
+
+	// 삭제 후의 변경은 남는다
+	batch.setDword(L"key", L"value", 2);
+	testAssert(batch.size() == 4);
+	testAssert(batch.operations()[3].kind == OperationKind::setValue);
+
+	// 취소 후에도 같은 값의 변경은 합쳐진다
+	batch.setDword(L"keyOther", L"value", 3);
+	batch.setDword(L"key", L"value", 4);
+	testAssert(batch.size() == 4);
+	std::uint32_t value;
+	std::memcpy(&value, batch.operations()[0].data.data(), sizeof(value));
+	testAssert(value == 3);
+	std::memcpy(&value, batch.operations()[3].data.data(), sizeof(value));
+	testAssert(value == 4);
+}
+
+
+testCase(removeValue) {
+	RegistryBatch batch;
+	batch.setDword(L"key", L"value", 1);
+	batch.removeValue(L"Key", L"VALUE");
+	// 같은 값에 대한 설정을 대체한다
+	testAssert(batch.size() == 1);
+	testAssert(batch.operations()[0].kind == OperationKind::removeValue);
+	testAssert(batch.operations()[0].valueName == L"VALUE");
+	testAssert(batch.operations()[0].data.empty());
+
+	batch.setString(L"key", L"value", L"test");
+	testAssert(batch.size() == 1);
+	testAssert(batch.operations()[0].kind == OperationKind::setValue);
+}
+
+
+testCase(setValue) {
+	RegistryBatch batch;
+	// 무효한 파라미터
+	testAssertionFailed(batch.setBinary(L"key", L"value", vector<unsigned char>(), Registry::ValueKind::_enum(-1)));
+	testAssertionFailed(batch.setString(L"key", L"value", L"test", Registry::ValueKind::binary));
+	testAssertionFailed(batch.setDword(L"key\\", L"value", 1));
+
+	{// binary
+		vector<unsigned char> data(3, 7);
+		batch.setBinary(L"key", L"binary", data);
+		const RegistryBatch::Operation& operation = batch.operations().back();
+		testAssert(operation.kind == OperationKind::setValue);
+		testAssert(operation.valueKind == Registry::ValueKind::binary);
+		testAssert(operation.data == data);
+	}
+	{// dword
+		batch.setDword(L"key", L"dword", 0x01020304);
+		const RegistryBatch::Operation& operation = batch.operations().back();
+		testAssert(operation.valueKind == Registry::ValueKind::dword);
+		testAssert(operation.data.size() == 4);
+		std::uint32_t value;
+		std::memcpy(&value, operation.data.data(), sizeof(value));
+		testAssert(value == 0x01020304);
+	}
+	{// qword
+		batch.setQword(L"key", L"qword", 0x0102030405060708ULL);
+		const RegistryBatch::Operation& operation = batch.operations().back();
+		testAssert(operation.valueKind == Registry::ValueKind::qword);
+		testAssert(operation.data.size() == 8);
+	}
+	{// string 은 종단 널 문자를 포함한다
+		batch.setString(L"key", L"string", L"abc", Registry::ValueKind::expandString);
+		const RegistryBatch::Operation& operation = batch.operations().back();
+		testAssert(operation.valueKind == Registry::ValueKind::expandString);
+		testAssert(operation.data.size() == 4 * sizeof(wchar_t));
+		testAssert(String::equals(reinterpret_cast<const wchar_t*>(operation.data.data()), L"abc"));
+	}
+	testAssert(batch.size() == 4);
+
+	// 같은 값은 대소문자를 구별하지 않고 순서를 유지한 채 대체한다
+	batch.setDword(L"KEY", L"Binary", 5);
+	testAssert(batch.size() == 4);
+	testAssert(batch.operations()[0].valueKind == Registry::ValueKind::dword);
+	testAssert(batch.operations()[0].valueName == L"Binary");
+	// 다른 키의 같은 이름은 별도
+	batch.setDword(L"key2", L"binary", 5);
+	testAssert(batch.size() == 5);
+}
+
+
+
+		}
+	}
+}
@@ -0,0 +1,208 @@
+﻿#include <balor/io/RegistryFile.hpp>
+
+#include <utility>
+#include <vector>
+
+#include <balor/io/File.hpp>
+#include <balor/io/FileStream.hpp>
+#include <balor/io/RegistryBatch.hpp>
+#include <balor/system/windows.hpp>
+#include <balor/test/Benchmark.hpp>
+#include <balor/test/UnitTest.hpp>
+#include <balor/scopeExit.hpp>
+#include <balor/String.hpp>
+
+
+namespace balor {
+	namespace io {
+		namespace testRegistryFile {
+
+
+using std::move;
+using std::vector;
+using balor::test::Benchmark;
+
+
+namespace {
+const wchar_t testDirectoryName[] = L"testBalor_io_RegistryFile_t3k9vq2mw7hz5xd1pc8ry4bn";
+File getTestDirectory() {
+	File dir(File::getSpecial(File::Special::temporary), testDirectoryName);
+	if (dir.exists()) {
+		dir.remove(true);
+	}
+	dir.createDirectory();
+	return dir;
+}
+
+
+void removeTestDirectory() {
+	File(File::getSpecial(File::Special::temporary), testDirectoryName).remove(true);
+}
+
+
+vector<String> valueNames(int count) {
+	vector<String> names;
+	for (int i = 0; i < count; ++i) {
+		names.push_back(String(L"value") + i);
+	}
+	return names;
+}
+
+
+/// names 의 값을 batch 키에 한 번에 쓴다
+void commitValues(const File& path, const vector<String>& names) {
+	RegistryBatch batch;
+	for (int i = 0, end = static_cast<int>(names.size()); i < end; ++i) {
+		batch.setDword(L"batch", names[i], i);
+	}
+	RegistryFile(path).commit(batch);
+}
+} // namespace
+
+
+
+testCase(construct) {
+	File dir = getTestDirectory();
+	scopeExit(&removeTestDirectory);
+
+	// 무효한 파라미터
+	testAssertionFailed(RegistryFile file(L""));
+
+	{// 파일이 없으면 빈 키
+		const File path(dir, L"settings.breg");
+		RegistryFile file(path);
+		testAssert(file.filePath() == path.path());
+		testAssert(file.snapshot().valueCount() == 0);
+		testAssert(file.snapshot().keyCount() == 0);
+		testAssert(!path.exists()); // 커밋할 때까지 만들지 않는다
+	}
+	{// 이동
+		RegistryFile file(File(dir, L"settings.breg"));
+		RegistryFile file2 = move(file);
+		testAssert(file2.filePath() == File(dir, L"settings.breg").path());
+		testAssert(file2.snapshot());
+
+		RegistryFile file3(File(dir, L"other.breg"));
+		file3 = move(file2);
+		testAssert(file3.filePath() == File(dir, L"settings.breg").path());
+	}
+	{// 형식이 잘못된 파일
+		const File path(dir, L"broken.breg");
+		{
+			FileStream stream(path, FileStream::Mode::create, FileStream::Access::write);
+			stream.write("broken", 0, 6);
+		}
+		testThrow(RegistryFile file(path), RegistrySnapshot::FormatException);
+	}
+}
+
+
+testCase(commit) {
+	File dir = getTestDirectory();
+	scopeExit(&removeTestDirectory);
+
+	const File path(dir, L"settings.breg");
+	{// 파일을 새로 만든다
+		RegistryFile file(path);
+		RegistryBatch batch;
+		batch.setString(L"", L"name", L"test");
+		batch.setDword(L"Window", L"Width", 800);
+		batch.setDword(L"Window", L"Height", 600);
+		file.commit(batch);
+		testAssert(path.exists());
+		testAssert(!File(dir, L"settings.breg.tmp").exists());
+		testAssert(file.snapshot().openKey(L"Window").getDword(L"Width") == 800);
+	}
+	{// 다시 읽는다
+		RegistryFile file(path);
+		RegistrySnapshot snapshot = file.snapshot();
+		testAssert(snapshot.getString(L"name") == L"test");
+		testAssert(snapshot.openKey(L"window").getDword(L"height") == 600);
+
+		// 기존 파일을 대체한다
+		RegistryBatch batch;
+		batch.setDword(L"Window", L"Width", 1920);
+		batch.removeValue(L"", L"name");
+		file.commit(batch);
+		testAssert(!File(dir, L"settings.breg.tmp").exists());
+		// 커밋 전의 스냅샷은 변하지 않는다
+		testAssert(snapshot.openKey(L"Window").getDword(L"Width") == 800);
+		testAssert(file.snapshot().openKey(L"Window").getDword(L"Width") == 1920);
+
+		// 빈 배치는 파일을 쓰지 않는다
+		const __int64 length = path.info().length();
+		file.commit(RegistryBatch());
+		testAssert(path.info().length() == length);
+	}
+	{// 다시 읽는다
+		RegistryFile file(path);
+		RegistrySnapshot snapshot = file.snapshot();
+		testAssert(snapshot.getValueKind(L"name") == Registry::ValueKind::notFound);
+		testAssert(snapshot.openKey(L"Window").getDword(L"Width") == 1920);
+		testAssert(snapshot.openKey(L"Window").getDword(L"Height") == 600);
+	}
+}
+
+
+// 값마다 커밋하는 경우와 배치로 한 번에 커밋하는 경우, 스냅샷으로 값을 읽는 속도
+BALOR_BENCHMARK(benchmarkRegistryFileCommitEach) { // 값마다 파일 전체를 쓴다
+	File dir = getTestDirectory();
+	scopeExit(&removeTestDirectory);
+	const vector<String> names = valueNames(200);
+	RegistryFile file(File(dir, L"settings.breg"));
+	int index = 0;
+	while (benchmark.running()) {
+		RegistryBatch batch;
+		batch.setDword(L"each", names[index % 200], index);
+		file.commit(batch);
+		++index;
+	}
+}
+
+
+BALOR_BENCHMARK(benchmarkRegistryFileCommitBatch) { // 1000 개의 값을 한 번에 커밋한다
+	File dir = getTestDirectory();
+	scopeExit(&removeTestDirectory);
+	const vector<String> names = valueNames(1000);
+	RegistryFile file(File(dir, L"settings.breg"));
+	while (benchmark.running()) {
+		RegistryBatch batch;
+		for (int i = 0; i < 1000; ++i) {
+			batch.setDword(L"batch", names[i], i);
+		}
+		file.commit(batch);
+	}
+}
+
+
+BALOR_BENCHMARK(benchmarkRegistryFileLoad) { // 1000 개의 값이 있는 파일을 읽는다
+	File dir = getTestDirectory();
+	scopeExit(&removeTestDirectory);
+	const File path(dir, L"settings.breg");
+	commitValues(path, valueNames(1000));
+	while (benchmark.running()) {
+		Benchmark::doNotOptimize(RegistryFile(path).snapshot().openKey(L"batch").valueCount());
+	}
+}
+
+
+BALOR_BENCHMARK(benchmarkRegistryFileGet) { // 1000 개의 값이 있는 스냅샷에서 하나 얻는다
+	File dir = getTestDirectory();
+	scopeExit(&removeTestDirectory);
+	const File path(dir, L"settings.breg");
+	const vector<String> names = valueNames(1000);
+	commitValues(path, names);
+	RegistrySnapshot key = RegistryFile(path).snapshot().openKey(L"batch");
+	__int64 sum = 0;
+	int index = 0;
+	while (benchmark.running()) {
+		sum += key.getDword(names[index++ % 1000]);
+	}
+	Benchmark::doNotOptimize(sum);
+}
+
+
+
+		}
+	}
+}
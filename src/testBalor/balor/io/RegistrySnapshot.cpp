@@ -0,0 +1,258 @@
+﻿#include <balor/io/RegistrySnapshot.hpp>
+
+#include <utility>
+#include <vector>
+
+#include <balor/io/MemoryStream.hpp>
+#include <balor/io/RegistryBatch.hpp>
+#include <balor/test/UnitTest.hpp>
+#include <balor/String.hpp>
+
+
+namespace balor {
+	namespace io {
+		namespace testRegistrySnapshot {
+
+
+using std::move;
+using std::vector;
+typedef Registry::ValueKind ValueKind;
+
+
+namespace {
+RegistrySnapshot createTestSnapshot() {
+	RegistryBatch batch;
+	batch.setString(L"", L"string", L"test");
+	batch.setDword(L"", L"dword", 1024);
+	batch.setQword(L"", L"qword", 0x123456789ABCDEFULL);
+	batch.setBinary(L"", L"binary", vector<unsigned char>(3, 7));
+	batch.setString(L"", L"multi", String(L"a\0b\0", 4), ValueKind::multiString);
+	batch.setDword(L"Window", L"Width", 800);
+	batch.setDword(L"Window\\Child", L"Height", 600);
+	batch.createKey(L"Empty");
+	return RegistrySnapshot().apply(batch);
+}
+} // namespace
+
+
+
+testCase(constructAndAssignment) {
+	RegistrySnapshot null;
+	testAssert(!null);
+
+	RegistrySnapshot snapshot = createTestSnapshot();
+	testAssert(snapshot);
+
+	// 복사는 트리를 공유한다
+	RegistrySnapshot copy = snapshot;
+	testAssert(copy);
+	testAssert(copy.getDword(L"dword") == 1024);
+
+	RegistrySnapshot moved = move(copy);
+	testAssert(moved);
+	testAssert(!copy);
+
+	copy = moved;
+	testAssert(copy.getDword(L"dword") == 1024);
+	copy = RegistrySnapshot();
+	testAssert(!copy);
+}
+
+
+testCase(apply) {
+	{// null 상태에 적용하면 빈 키가 된다
+		RegistrySnapshot empty = RegistrySnapshot().apply(RegistryBatch());
+		testAssert(empty);
+		testAssert(empty.valueCount() == 0);
+		testAssert(empty.keyCount() == 0);
+	}
+
+	const RegistrySnapshot base = createTestSnapshot();
+	{// 빈 배치는 그대로
+		RegistrySnapshot same = base.apply(RegistryBatch());
+		testAssert(same.getDword(L"dword") == 1024);
+	}
+	{// 변경은 원래 스냅샷에 영향을 주지 않는다
+		RegistryBatch batch;
+		batch.setDword(L"WINDOW", L"WIDTH", 1920);
+		batch.setDword(L"Window", L"Left", 10);
+		batch.removeValue(L"", L"string");
+		batch.removeValue(L"notFound", L"value");
+		batch.removeKey(L"Empty");
+		batch.removeKey(L"notFound\\deep");
+		batch.createKey(L"New\\Deep");
+		RegistrySnapshot next = base.apply(batch);
+
+		testAssert(next.openKey(L"Window").getDword(L"Width") == 1920);
+		testAssert(next.openKey(L"Window").getDword(L"Left") == 10);
+		testAssert(next.openKey(L"Window").valueCount() == 2);
+		testAssert(next.getValueKind(L"string") == ValueKind::notFound);
+		testAssert(!next.openKey(L"Empty"));
+		testAssert(!next.openKey(L"notFound"));
+		testAssert(next.openKey(L"new\\deep"));
+		// 대소문자가 다른 이름으로 설정해도 원래 이름을 유지한다
+		testAssert(next.openKey(L"Window").valueNames()[0] == L"Width");
+
+		testAssert(base.openKey(L"Window").getDword(L"Width") == 800);
+		testAssert(base.openKey(L"Window").valueCount() == 1);
+		testAssert(base.getString(L"string") == L"test");
+		testAssert(base.openKey(L"Empty"));
+		testAssert(!base.openKey(L"New"));
+
+		// 변경하지 않은 서브키는 그대로
+		testAssert(next.openKey(L"Window\\Child").getDword(L"Height") == 600);
+	}
+	{// 키 삭제 후 같은 이름으로 다시 만든다
+		RegistryBatch batch;
+		batch.removeKey(L"Window");
+		batch.setDword(L"Window", L"Top", 5);
+		RegistrySnapshot next = base.apply(batch);
+		testAssert(next.openKey(L"Window").valueCount() == 1);
+		testAssert(next.openKey(L"Window").getDword(L"Top") == 5);
+		testAssert(!next.openKey(L"Window\\Child"));
+	}
+}
+
+
+testCase(getValue) {
+	{// null 상태
+		RegistrySnapshot null;
+		testAssertionFailed(null.getBinary(L"value"));
+		testAssertionFailed(null.getDword(L"value"));
+		testAssertionFailed(null.getQword(L"value"));
+		testAssertionFailed(null.getString(L"value"));
+		testAssertionFailed(null.getValueKind(L"value"));
+	}
+
+	const RegistrySnapshot snapshot = createTestSnapshot();
+	{// binary
+		testThrow(snapshot.getBinary(L"notFound"), RegistrySnapshot::ValueNotFoundException);
+		testAssert(snapshot.getBinary(L"binary") == vector<unsigned char>(3, 7));
+		testAssert(snapshot.getBinary(L"dword").size() == 4);
+	}
+	{// dword
+		testThrow(snapshot.getDword(L"notFound"), RegistrySnapshot::ValueNotFoundException);
+		testThrow(snapshot.getDword(L"qword"), RegistrySnapshot::ValueKindMismatchException);
+		testAssert(snapshot.getDword(L"dword") == 1024);
+		testAssert(snapshot.getDword(L"DWORD") == 1024);
+	}
+	{// qword
+		testThrow(snapshot.getQword(L"notFound"), RegistrySnapshot::ValueNotFoundException);
+		testThrow(snapshot.getQword(L"dword"), RegistrySnapshot::ValueKindMismatchException);
+		testAssert(snapshot.getQword(L"qword") == 0x123456789ABCDEFULL);
+	}
+	{// string
+		testThrow(snapshot.getString(L"notFound"), RegistrySnapshot::ValueNotFoundException);
+		testThrow(snapshot.getString(L"binary"), RegistrySnapshot::ValueKindMismatchException);
+		testAssert(snapshot.getString(L"string") == L"test");
+		testAssert(snapshot.getString(L"multi") == String(L"a\0b\0", 4));
+	}
+	{// 값의 종류
+		testAssert(snapshot.getValueKind(L"string") == ValueKind::string);
+		testAssert(snapshot.getValueKind(L"dword") == ValueKind::dword);
+		testAssert(snapshot.getValueKind(L"qword") == ValueKind::qword);
+		testAssert(snapshot.getValueKind(L"binary") == ValueKind::binary);
+		testAssert(snapshot.getValueKind(L"multi") == ValueKind::multiString);
+		testAssert(snapshot.getValueKind(L"notFound") == ValueKind::notFound);
+	}
+}
+
+
+testCase(keyCountAndNames) {
+	RegistrySnapshot null;
+	testAssertionFailed(null.keyCount());
+	testAssertionFailed(null.keyNames());
+	testAssertionFailed(null.valueCount());
+	testAssertionFailed(null.valueNames());
+
+	const RegistrySnapshot snapshot = createTestSnapshot();
+	testAssert(snapshot.keyCount() == 2);
+	vector<String> keyNames = snapshot.keyNames();
+	testAssert(keyNames.size() == 2);
+	testAssert(keyNames[0] == L"Window");
+	testAssert(keyNames[1] == L"Empty");
+
+	testAssert(snapshot.valueCount() == 5);
+	vector<String> valueNames = snapshot.valueNames();
+	testAssert(valueNames.size() == 5);
+	testAssert(valueNames[0] == L"string");
+	testAssert(valueNames[4] == L"multi");
+}
+
+
+testCase(openKey) {
+	RegistrySnapshot null;
+	testAssertionFailed(null.openKey(L"key"));
+
+	const RegistrySnapshot snapshot = createTestSnapshot();
+	testAssertionFailed(snapshot.openKey(L""));
+
+	testAssert(snapshot.openKey(L"Window").getDword(L"Width") == 800);
+	testAssert(snapshot.openKey(L"window\\child").getDword(L"Height") == 600);
+	testAssert(snapshot.openKey(L"Window").openKey(L"Child").getDword(L"Height") == 600);
+	testAssert(!snapshot.openKey(L"notFound"));
+	testAssert(!snapshot.openKey(L"Window\\notFound"));
+	testAssert(!snapshot.openKey(L"Empty\\notFound"));
+}
+
+
+testCase(readAndWrite) {
+	RegistrySnapshot null;
+	MemoryStream stream;
+	testAssertionFailed(null.write(stream));
+
+	{// 쓴 내용을 읽는다
+		const RegistrySnapshot snapshot = createTestSnapshot();
+		snapshot.write(stream);
+		stream.position(0);
+		RegistrySnapshot read = RegistrySnapshot::read(stream);
+		testAssert(stream.position() == stream.length());
+		testAssert(read.valueNames() == snapshot.valueNames());
+		testAssert(read.keyNames() == snapshot.keyNames());
+		testAssert(read.getString(L"string") == L"test");
+		testAssert(read.getQword(L"qword") == 0x123456789ABCDEFULL);
+		testAssert(read.getBinary(L"binary") == vector<unsigned char>(3, 7));
+		testAssert(read.getValueKind(L"multi") == ValueKind::multiString);
+		testAssert(read.openKey(L"Window\\Child").getDword(L"Height") == 600);
+		testAssert(read.openKey(L"Empty").valueCount() == 0);
+	}
+	{// 잘못된 형식
+		unsigned char badMagic[] = {'B', 'R', 'E', 'X', 1, 0, 0};
+		MemoryStream badMagicStream(badMagic, 0, sizeof(badMagic), false);
+		testThrow(RegistrySnapshot::read(badMagicStream), RegistrySnapshot::FormatException);
+
+		unsigned char badVersion[] = {'B', 'R', 'E', 'G', 2, 0, 0};
+		MemoryStream badVersionStream(badVersion, 0, sizeof(badVersion), false);
+		testThrow(RegistrySnapshot::read(badVersionStream), RegistrySnapshot::FormatException);
+
+		unsigned char empty[] = {'B', 'R', 'E', 'G', 1, 0, 0};
+		MemoryStream emptyStream(empty, 0, sizeof(empty), false);
+		testAssert(RegistrySnapshot::read(emptyStream).valueCount() == 0);
+
+		// 도중에 끊겼다
+		stream.length(static_cast<int>(stream.length() - 1));
+		stream.position(0);
+		testThrow(RegistrySnapshot::read(stream), RegistrySnapshot::FormatException);
+		MemoryStream emptyStream2;
+		testThrow(RegistrySnapshot::read(emptyStream2), RegistrySnapshot::FormatException);
+
+		// 데이터의 바이트 수가 남은 데이터보다 훨씬 크다
+		unsigned char hugeData[] = {'B', 'R', 'E', 'G', 1, 1, 1, 'a', 3, 0xff, 0xff, 0xff, 0xff, 0x07, 1, 2, 3};
+		MemoryStream hugeDataStream(hugeData, 0, sizeof(hugeData), false);
+		testThrow(RegistrySnapshot::read(hugeDataStream), RegistrySnapshot::FormatException);
+
+		// 값의 종류가 범위 밖
+		unsigned char badKind[] = {'B', 'R', 'E', 'G', 1, 1, 1, 'a', 12, 0, 0};
+		MemoryStream badKindStream(badKind, 0, sizeof(badKind), false);
+		testThrow(RegistrySnapshot::read(badKindStream), RegistrySnapshot::FormatException);
+		unsigned char negativeKind[] = {'B', 'R', 'E', 'G', 1, 1, 1, 'a', 0x7f, 0, 0};
+		MemoryStream negativeKindStream(negativeKind, 0, sizeof(negativeKind), false);
+		testThrow(RegistrySnapshot::read(negativeKindStream), RegistrySnapshot::FormatException);
+	}
+}
+
+
+
+		}
+	}
+}
@@ -14,6 +14,7 @@
 #include <balor/system/Module.hpp>
 #include <balor/test/UnitTest.hpp>
 #include <balor/Rectangle.hpp>
+#include <balor/StringBuffer.hpp>
 
 
 namespace balor {
@@ -183,6 +184,56 @@ testCase(getRawData) {
 }
 
 
+testCase(getString) {
+	Resource resource;
+
+	// 찾을 수 없는 리소스
+	testThrow(resource.getString(2000), Resource::NotFoundException);
+
+	{// STRINGTABLE 의 문자열을 참조로 반환한다
+		String string = resource.getString(1000);
+		testAssert(string == L"balor::io::StringTable::test1000");
+		testAssert(string.referred());
+		testAssert(Resource().getString(1000).c_str() == string.c_str());
+		StringBuffer buffer;
+		resource.getStringToBuffer(buffer, 1001);
+		testAssert(String::equals(buffer, L"balor::io::StringTable::test1001"));
+	}
+
+	resource = Resource(Locale(L"en-US"));
+	{// 로컬라이즈 리소스
+		testAssert(resource.getString(1024) == L"balor::io::StringTable::test1024.en-US");
+		// 로컬라이즈 리소스를 찾을 수 없다
+		testAssert(resource.getString(1000) == L"balor::io::StringTable::test1000");
+	}
+}
+
+
+testCase(view) {
+	Resource resource;
+
+	// 찾을 수 없는 리소스
+	testThrow(resource.view(L"balor::io::resource::la0r9840avfjoasdjifao0"), Resource::NotFoundException);
+
+	{// getRawData 와 같은 메모리를 복사하지 않고 참조한다
+		auto data = resource.view(L"balor::io::resource::test00.png");
+		auto stream = resource.getRawData(L"balor::io::resource::test00.png");
+		testAssert(data.size() == stream.length());
+		testAssert(data.begin() == stream.buffer());
+		MemoryStream viewStream(const_cast<unsigned char*>(data.begin()), 0, data.size(), false);
+		Bitmap bitmap(viewStream);
+		testAssert(bitmap.equalsBits(getTestBitmap(Bitmap(30, 40, Bitmap::Format::rgb24bpp))));
+	}
+
+	resource = Resource(Locale(L"en-US"));
+	{// 로컬라이즈 리소스
+		auto data = resource.view(L"balor::io::resource::test04.png");
+		testAssert(data.begin() == resource.getRawData(L"balor::io::resource::test04.png").buffer());
+		testThrow(Resource().view(L"balor::io::resource::test04.png"), Resource::NotFoundException);
+	}
+}
+
+
 
 		}
 	}
@@ -0,0 +1,352 @@
+﻿#include <balor/io/SegmentedMemoryStream.hpp>
+
+#include <cstdio>
+#include <cstring>
+#include <utility>
+#include <vector>
+
+#include <balor/io/MemoryStream.hpp>
+#include <balor/system/windows.hpp>
+#include <balor/test/Benchmark.hpp>
+#include <balor/test/UnitTest.hpp>
+#include <balor/String.hpp>
+
+
+namespace balor {
+	namespace io {
+		namespace testSegmentedMemoryStream {
+
+
+using std::move;
+using std::vector;
+using namespace balor::io;
+
+
+namespace {
+void writeBlocks(Stream& stream, const vector<char>& block, int count) {
+	const int blockSize = static_cast<int>(block.size());
+	for (int i = 0; i < count; i += blockSize) {
+		stream.write(block.data(), 0, blockSize);
+	}
+}
+} // namespace
+
+
+
+testCase(pool) {
+	// 무효한 파라미터
+	testAssertionFailed(SegmentedMemoryStream::Pool(0));
+	testAssertionFailed(SegmentedMemoryStream::Pool(16, -1));
+
+	SegmentedMemoryStream::Pool pool(16, 32);
+	testAssert(pool.chunkSize() == 16);
+	testAssert(pool.maxRetainedSize() == 32);
+	testAssert(pool.retainedCount() == 0);
+	testAssertionFailed(pool.deallocate(nullptr));
+
+	unsigned char* chunk0 = pool.allocate();
+	unsigned char* chunk1 = pool.allocate();
+	unsigned char* chunk2 = pool.allocate();
+	testAssert(chunk0 && chunk1 && chunk2);
+	std::memset(chunk2, 0, 16);
+	pool.deallocate(chunk0);
+	pool.deallocate(chunk1);
+	pool.deallocate(chunk2); // maxRetainedSize 를 넘으므로 해제된다
+	testAssert(pool.retainedCount() == 2);
+
+	// 보관하는 청크를 재사용한다
+	unsigned char* chunk3 = pool.allocate();
+	testAssert(chunk3 == chunk0 || chunk3 == chunk1);
+	testAssert(pool.retainedCount() == 1);
+	pool.deallocate(chunk3);
+
+	pool.trim();
+	testAssert(pool.retainedCount() == 0);
+
+	testAssert(SegmentedMemoryStream::Pool::global().chunkSize() == 64 * 1024);
+}
+
+
+testCase(construct) {
+	{// 기본 생성자
+		SegmentedMemoryStream stream;
+		testAssert(&stream.pool() == &SegmentedMemoryStream::Pool::global());
+		testAssert(stream.chunkSize() == 64 * 1024);
+		testAssert(stream.capacity() == 0);
+		testAssert(stream.chunkCount() == 0);
+		testAssert(stream.length() == 0);
+		testAssert(stream.position() == 0);
+		testAssert(stream.readable());
+		testAssert(stream.writable());
+	}
+	{// 풀 지정
+		SegmentedMemoryStream::Pool pool(16);
+		SegmentedMemoryStream stream(pool);
+		testAssert(&stream.pool() == &pool);
+		testAssert(stream.chunkSize() == 16);
+		stream.write("0123456789abcdefg", 0, 17);
+		testAssert(stream.capacity() == 32);
+		testAssert(stream.chunkCount() == 2);
+	}
+}
+
+
+testCase(moveConstructAndAssignment) {
+	SegmentedMemoryStream::Pool pool(4);
+	SegmentedMemoryStream stream0(pool);
+	stream0.write("012345", 0, 6);
+
+	SegmentedMemoryStream stream1 = move(stream0);
+	testAssert(stream1.length() == 6);
+	testAssert(stream1.position() == 6);
+	testAssert(stream1.capacity() == 8);
+	testAssert(stream0.length() == 0);
+	testAssert(stream0.capacity() == 0);
+	testAssertionFailed(stream0.pool());
+
+	stream0 = move(stream1);
+	testAssert(stream0.length() == 6);
+	testAssert(stream0.position() == 6);
+	testAssert(&stream0.pool() == &pool);
+	testAssertionFailed(stream1.pool());
+}
+
+
+testCase(destruct) {
+	SegmentedMemoryStream::Pool pool(4);
+	{
+		SegmentedMemoryStream stream(pool);
+		stream.write("0123456789", 0, 10);
+		testAssert(pool.retainedCount() == 0);
+	}
+	testAssert(pool.retainedCount() == 3);
+}
+
+
+testCase(chunk) {
+	SegmentedMemoryStream::Pool pool(4);
+	SegmentedMemoryStream stream(pool);
+	stream.write("0123456789", 0, 10);
+
+	// 무효한 파라미터
+	testAssertionFailed(stream.chunk(-1));
+	testAssertionFailed(stream.chunk(3));
+
+	testAssert(stream.chunkCount() == 3);
+	testAssert(stream.chunk(0).length() == 4);
+	testAssert(std::memcmp(stream.chunk(0).begin(), "0123", 4) == 0);
+	testAssert(stream.chunk(1).length() == 4);
+	testAssert(std::memcmp(stream.chunk(1).begin(), "4567", 4) == 0);
+	testAssert(stream.chunk(2).length() == 2);
+	testAssert(std::memcmp(stream.chunk(2).begin(), "89", 2) == 0);
+
+	// 청크의 메모리는 스트림의 데이터 그 자체이고 확장해도 이동하지 않는다
+	const unsigned char* first = stream.chunk(0).begin();
+	stream.write("abcdefgh", 0, 8);
+	testAssert(stream.chunkCount() == 5);
+	testAssert(stream.chunk(0).begin() == first);
+	stream.position(5);
+	stream.write("x", 0, 1);
+	testAssert(stream.chunk(1)[1] == 'x');
+}
+
+
+//testCase(flush) { // 아무것도 하지 않는다
+//}
+
+
+testCase(length) {
+	SegmentedMemoryStream::Pool pool(4);
+	SegmentedMemoryStream stream0(pool);
+	SegmentedMemoryStream stream1 = move(stream0);
+
+	// 무효한 파라미터
+	testAssertionFailed(stream0.length(1));
+	testAssertionFailed(stream1.length(-1));
+
+	// 늘린 부분은 0 으로 채워진다
+	stream1.write("abc", 0, 3);
+	stream1.length(10);
+	testAssert(stream1.length() == 10);
+	testAssert(stream1.capacity() == 12);
+	testAssert(stream1.position() == 3);
+	char buffer[12] = {0};
+	stream1.position(0);
+	testAssert(stream1.read(buffer, 0, 12) == 10);
+	testAssert(std::memcmp(buffer, "abc\0\0\0\0\0\0\0", 10) == 0);
+
+	// 줄이면 필요없는 청크를 풀에 돌려준다
+	stream1.length(5);
+	testAssert(stream1.length() == 5);
+	testAssert(stream1.capacity() == 8);
+	testAssert(pool.retainedCount() == 1);
+	stream1.length(0);
+	testAssert(stream1.capacity() == 0);
+	testAssert(pool.retainedCount() == 3);
+
+	// 풀에서 재사용한 청크도 0 으로 채워진다
+	unsigned char* dirty0 = pool.allocate();
+	unsigned char* dirty1 = pool.allocate();
+	std::memset(dirty0, 'z', 4);
+	std::memset(dirty1, 'z', 4);
+	pool.deallocate(dirty0);
+	pool.deallocate(dirty1);
+	stream1.length(8);
+	stream1.position(0);
+	testAssert(stream1.read(buffer, 0, 12) == 8);
+	testAssert(std::memcmp(buffer, "\0\0\0\0\0\0\0\0", 8) == 0);
+}
+
+
+testCase(positionAndSkip) {
+	SegmentedMemoryStream::Pool pool(4);
+	SegmentedMemoryStream stream0(pool);
+	SegmentedMemoryStream stream1 = move(stream0);
+	stream1.write("0123456789", 0, 10);
+
+	// 무효한 파라미터
+	testAssertionFailed(stream0.position(0));
+	testAssertionFailed(stream1.position(-1));
+	testAssertionFailed(stream0.skip(0));
+
+	// 2GB 를 넘는 위치
+	const __int64 large = 0x180000000LL;
+	stream1.position(large);
+	testAssert(stream1.position() == large);
+	char buffer[4] = {0};
+	testAssert(stream1.read(buffer, 0, 4) == 0);
+	testAssert(stream1.skip(-large) == -large);
+	testAssert(stream1.position() == 0);
+	testAssert(stream1.skip(-1) == 0);
+	testAssert(stream1.skip(6) == 6);
+	testAssert(stream1.read(buffer, 0, 4) == 4);
+	testAssert(std::memcmp(buffer, "6789", 4) == 0);
+}
+
+
+testCase(read) {
+	SegmentedMemoryStream::Pool pool(4);
+	SegmentedMemoryStream stream0(pool);
+	SegmentedMemoryStream stream1 = move(stream0);
+	stream1.write("0123456789", 0, 10);
+	stream1.position(0);
+
+	// 무효한 파라미터
+	char buffer[11] = {0};
+	testAssertionFailed(stream0.read(buffer, 0, 4));
+	testAssertionFailed(stream1.read(nullptr, 0, 4));
+	testAssertionFailed(stream1.read(buffer, -1, 4));
+	testAssertionFailed(stream1.read(buffer, 0, -1));
+	testNoThrow        (stream1.read(buffer, 0, 0));
+
+	// 청크를 넘어서 읽기
+	testAssert(stream1.read(buffer, 0, 3) == 3);
+	testAssert(stream1.read(buffer, 3, 6) == 6);
+	testAssert(stream1.position() == 9);
+	testAssert(String::equals(buffer, "012345678"));
+	testAssert(stream1.read(buffer, 0, 4) == 1);
+	testAssert(stream1.position() == 10);
+	testAssert(stream1.read(buffer, 0, 4) == 0);
+	stream1.position(0);
+	testAssert(stream1.read(buffer, 0, 11) == 10);
+	testAssert(String::equals(buffer, "0123456789"));
+}
+
+
+testCase(toContiguous) {
+	SegmentedMemoryStream::Pool pool(4);
+	SegmentedMemoryStream stream0(pool);
+	SegmentedMemoryStream stream1 = move(stream0);
+
+	// 무효한 파라미터
+	testAssertionFailed(stream0.toContiguous());
+
+	testAssert(stream1.toContiguous().empty());
+	stream1.write("0123456789", 0, 10);
+	vector<unsigned char> result = stream1.toContiguous();
+	testAssert(result.size() == 10);
+	testAssert(std::memcmp(result.data(), "0123456789", 10) == 0);
+	testAssert(stream1.position() == 10);
+}
+
+
+testCase(write) {
+	SegmentedMemoryStream::Pool pool(4);
+	SegmentedMemoryStream stream0(pool);
+	SegmentedMemoryStream stream1 = move(stream0);
+
+	// 무효한 파라미터
+	testAssertionFailed(stream0.write("0123", 0, 4));
+	testAssertionFailed(stream1.write(nullptr, 0, 4));
+	testAssertionFailed(stream1.write("0123", -1, 4));
+	testAssertionFailed(stream1.write("0123", 0, -1));
+	testNoThrow        (stream1.write("0123", 0, 0));
+	testAssert(stream1.capacity() == 0);
+
+	// 청크를 넘어서 쓰기
+	stream1.write("0123456", 1, 6);
+	testAssert(stream1.length() == 6);
+	testAssert(stream1.position() == 6);
+	testAssert(stream1.capacity() == 8);
+	stream1.position(2);
+	stream1.write("abcdefgh", 0, 8);
+	testAssert(stream1.length() == 10);
+	testAssert(stream1.position() == 10);
+	testAssert(stream1.capacity() == 12);
+	testAssert(std::memcmp(stream1.toContiguous().data(), "12abcdefgh", 10) == 0);
+
+	// 끝보다 뒤에 쓰면 사이는 0 으로 채워진다
+	unsigned char* dirty = pool.allocate();
+	std::memset(dirty, 'z', 4);
+	pool.deallocate(dirty);
+	stream1.position(13);
+	stream1.write("xy", 0, 2);
+	testAssert(stream1.length() == 15);
+	testAssert(std::memcmp(stream1.toContiguous().data(), "12abcdefgh\0\0\0xy", 15) == 0);
+}
+
+
+testCase(writeTo) {
+	SegmentedMemoryStream::Pool pool(4);
+	SegmentedMemoryStream stream0(pool);
+	SegmentedMemoryStream stream1 = move(stream0);
+	MemoryStream memoryStream;
+
+	// 무효한 파라미터
+	testAssertionFailed(stream0.writeTo(memoryStream));
+	testAssertionFailed(stream1.writeTo(stream1));
+
+	stream1.write("0123456789", 0, 10);
+	stream1.position(3);
+	stream1.writeTo(memoryStream);
+	testAssert(stream1.position() == 3);
+	testAssert(memoryStream.length() == 10);
+	testAssert(std::memcmp(memoryStream.buffer(), "0123456789", 10) == 0);
+}
+
+
+// MemoryStream 과 4MB 를 쓰는 속도를 비교. 사이즈는 한 번에 쓰는 바이트 수
+// 디버그 버전에서는 재할당으로 늘어나는 할당 바이트 수도 비교할 수 있다
+BALOR_BENCHMARK_SIZES(benchmarkSegmentedMemoryStreamWrite, 256, 64 * 1024) {
+	const vector<char> block(benchmark.size(), 'a');
+	SegmentedMemoryStream::Pool pool(64 * 1024, 0);
+	while (benchmark.running()) {
+		SegmentedMemoryStream stream(pool);
+		writeBlocks(stream, block, 4 * 1024 * 1024);
+	}
+}
+
+
+BALOR_BENCHMARK_SIZES(benchmarkSegmentedMemoryStreamMemoryStreamWrite, 256, 64 * 1024) {
+	const vector<char> block(benchmark.size(), 'a');
+	while (benchmark.running()) {
+		MemoryStream stream;
+		writeBlocks(stream, block, 4 * 1024 * 1024);
+	}
+}
+
+
+
+		}
+	}
+}
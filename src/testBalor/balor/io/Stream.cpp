@@ -1,6 +1,8 @@
 ﻿#include <balor/io/Stream.hpp>
 
+#include <algorithm>
 #include <utility>
+#include <vector>
 
 #include <balor/String.hpp>
 #include <balor/io/MemoryStream.hpp>
@@ -13,9 +15,84 @@ namespace balor {
 
 
 using std::move;
+using std::vector;
 using namespace balor::io;
 
 
+namespace {
+/// readv, writev 를 재정의하지 않는 Stream
+class ForwardStream : public Stream {
+public:
+	ForwardStream(Stream& stream) : _stream(stream), readCount(0), writeCount(0) {}
+
+	virtual void flush() { _stream.flush(); }
+	virtual __int64 length() const { return _stream.length(); }
+	virtual __int64 position() const { return _stream.position(); }
+	virtual void position(__int64 value) { _stream.position(value); }
+	using Stream::read;
+	virtual int read(void* buffer, int offset, int count) { ++readCount; return _stream.read(buffer, offset, count); }
+	virtual bool readable() const { return _stream.readable(); }
+	virtual __int64 skip(__int64 offset) { return _stream.skip(offset); }
+	using Stream::write;
+	virtual void write(const void* buffer, int offset, int count) { ++writeCount; _stream.write(buffer, offset, count); }
+	virtual bool writable() const { return _stream.writable(); }
+
+private:
+	ForwardStream& operator=(const ForwardStream&);
+
+	Stream& _stream;
+public:
+	int readCount;
+	int writeCount;
+};
+} // namespace
+
+
+
+testCase(copyTo) {
+	vector<char> data(100000);
+	for (int i = 0, end = data.size(); i < end; ++i) {
+		data[i] = static_cast<char>(i * 7);
+	}
+	MemoryStream source;
+	source.write(data.data(), 0, data.size());
+	source.position(0);
+
+	// 무효한 파라미터
+	MemoryStream destination;
+	char readOnlyBuffer[4];
+	MemoryStream readOnly(readOnlyBuffer, false);
+	testAssertionFailed(source.copyTo(source));
+	testAssertionFailed(source.copyTo(destination, 0));
+	testAssertionFailed(source.copyTo(readOnly));
+
+	{// 버퍼 하나에 들어간다
+		ForwardStream stream(destination);
+		testAssert(source.copyTo(stream) == 100000);
+		testAssert(source.position() == 100000);
+		testAssert(stream.writeCount == 1);
+		testAssert(destination.length() == 100000);
+		testAssert(std::equal(data.begin(), data.end(), static_cast<char*>(destination.buffer())));
+		testAssert(source.copyTo(stream) == 0);
+		testAssert(stream.writeCount == 1);
+	}
+	{// 읽기와 쓰기를 번갈아 가며 병행한다
+		MemoryStream destination;
+		ForwardStream stream(destination);
+		source.position(10);
+		testAssert(source.copyTo(stream, 4096) == 99990);
+		testAssert(stream.writeCount == 25);
+		testAssert(destination.length() == 99990);
+		testAssert(std::equal(data.begin() + 10, data.end(), static_cast<char*>(destination.buffer())));
+	}
+	{// 쓰기의 예외는 호출한 스레드에서 던진다
+		char buffer[10000];
+		MemoryStream destination(buffer);
+		source.position(0);
+		testThrow(source.copyTo(destination, 4096), MemoryStream::BufferOverrunException);
+	}
+}
+
 
 testCase(readByteAndWriteByte) {
 	MemoryStream stream;
@@ -27,6 +104,36 @@ testCase(readByteAndWriteByte) {
 }
 
 
+testCase(readvAndWritev) {
+	MemoryStream memoryStream;
+	ForwardStream stream(memoryStream);
+
+	// 무효한 파라미터
+	char buffer0[4] = {0};
+	char buffer1[4] = {0};
+	Stream::Slice nullSlices[] = {Stream::Slice(buffer0, 0, 2), Stream::Slice()};
+	nullSlices[1].count = 1;
+	Stream::ConstSlice negativeSlices[] = {Stream::ConstSlice("ab", 0, -1)};
+	testAssertionFailed(stream.readv(nullSlices));
+	testAssertionFailed(stream.writev(negativeSlices));
+
+	// 쓰기
+	Stream::ConstSlice slices[] = {Stream::ConstSlice("ab", 0, 2), Stream::ConstSlice("", 0, 0), Stream::ConstSlice("0123", 1, 3)};
+	stream.writev(slices);
+	testAssert(stream.writeCount == 2);
+	testAssert(memoryStream.length() == 5);
+
+	// 읽기. 짧게 읽으면 거기서 멈춘다
+	stream.position(0);
+	Stream::Slice readSlices[] = {Stream::Slice(buffer0, 0, 3), Stream::Slice(buffer1, 0, 3), Stream::Slice(buffer0, 0, 3)};
+	testAssert(stream.readv(readSlices) == 5);
+	testAssert(stream.readCount == 2);
+	testAssert(String::equals(buffer0, "ab1"));
+	testAssert(String::equals(buffer1, "23"));
+	testAssert(stream.readv(readSlices) == 0);
+}
+
+
 
 		}
 	}
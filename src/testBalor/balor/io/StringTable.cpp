@@ -0,0 +1,140 @@
+﻿#include <balor/io/StringTable.hpp>
+
+#include <vector>
+#define BOOST_DATE_TIME_NO_LIB
+#define BOOST_THREAD_NO_LIB
+#include <boost/thread.hpp>
+
+#include <balor/system/windows.hpp>
+#include <balor/test/Benchmark.hpp>
+#include <balor/test/UnitTest.hpp>
+#include <balor/String.hpp>
+
+
+namespace balor {
+	namespace io {
+		namespace testStringTable {
+
+
+using std::vector;
+using boost::thread;
+using namespace balor::locale;
+using balor::test::Benchmark;
+
+
+
+testCase(construct) {
+	{// 실행 파일의 모듈
+		StringTable table;
+		testAssert(table.module() == GetModuleHandleW(nullptr));
+		testAssert(table.locale() == Locale::invariant());
+	}
+	{
+		StringTable table(GetModuleHandleW(nullptr), Locale(L"en-US"));
+		testAssert(table.module() == GetModuleHandleW(nullptr));
+		testAssert(table.locale() == Locale(L"en-US"));
+	}
+}
+
+
+testCase(getString) {
+	StringTable table;
+
+	// 무효한 파라미터
+	testAssertionFailed(table.getString(-1));
+	testAssertionFailed(table.getString(USHRT_MAX + 1));
+
+	{// 참조로 반환한다
+		String string = table.getString(1000);
+		testAssert(string == L"balor::io::StringTable::test1000");
+		testAssert(string.referred());
+		testAssert(table.getString(1000).c_str() == string.c_str());
+		testAssert(table.getString(1001) == L"balor::io::StringTable::test1001");
+		testAssert(table.getString(1015) == L"balor::io::StringTable::test1015");
+	}
+
+	// 블록은 있지만 문자열이 없다
+	testThrow(table.getString(1002), StringTable::NotFoundException);
+	// 블록이 없다
+	testThrow(table.getString(2000), StringTable::NotFoundException);
+	testThrow(table.getString(2000), StringTable::NotFoundException);
+
+	{// 로케일의 언어를 우선한다
+		StringTable english(nullptr, Locale(L"en-US"));
+		testAssert(english.getString(1024) == L"balor::io::StringTable::test1024.en-US");
+		// 언어의 블록이 없으면 LoadString 과 같은 방법으로 찾는다
+		testAssert(english.getString(1000) == L"balor::io::StringTable::test1000");
+	}
+	{// LoadString 과 같은 결과
+		wchar_t buffer[256];
+		const int length = LoadStringW(GetModuleHandleW(nullptr), 1024, buffer, sizeof(buffer) / sizeof(buffer[0]));
+		testAssert(table.getString(1024) == String(buffer, length));
+	}
+}
+
+
+testCase(preload) {
+	StringTable table;
+	table.preload();
+	testAssert(table.getString(1000) == L"balor::io::StringTable::test1000");
+	testThrow(table.getString(2000), StringTable::NotFoundException);
+}
+
+
+testCase(shared) {
+	StringTable& table = StringTable::shared(nullptr, Locale::invariant());
+	testAssert(table.module() == GetModuleHandleW(nullptr));
+	testAssert(&StringTable::shared(GetModuleHandleW(nullptr), Locale::invariant()) == &table);
+	testAssert(&StringTable::shared(nullptr, Locale(L"en-US")) != &table);
+	testAssert(&StringTable::shared(nullptr, Locale(L"en-US")) == &StringTable::shared(nullptr, Locale(L"en-US")));
+
+	{// 여러 스레드에서 동시에 처음 읽는다
+		StringTable concurrent;
+		vector<String> results(8);
+		vector<thread> threads;
+		for (int i = 0; i < 8; ++i) {
+			threads.push_back(thread([&, i] () {
+				results[i] = concurrent.getString(1001);
+			}));
+		}
+		for (auto i = threads.begin(), end = threads.end(); i != end; ++i) {
+			i->join();
+		}
+		for (int i = 0; i < 8; ++i) {
+			testAssert(results[i].c_str() == results[0].c_str());
+		}
+	}
+}
+
+
+// 매번 LoadString 으로 복사하는 경우와 StringTable 의 참조를 비교
+BALOR_BENCHMARK(benchmarkStringTableLoadString) {
+	HMODULE module = GetModuleHandleW(nullptr);
+	const int ids[] = {1000, 1001, 1015, 1024};
+	int length = 0;
+	int index = 0;
+	while (benchmark.running()) {
+		wchar_t buffer[256];
+		const int loaded = LoadStringW(module, ids[index++ % 4], buffer, sizeof(buffer) / sizeof(buffer[0]));
+		length += String(buffer, loaded).length();
+	}
+	Benchmark::doNotOptimize(length);
+}
+
+
+BALOR_BENCHMARK(benchmarkStringTableGetString) {
+	StringTable& table = StringTable::shared(GetModuleHandleW(nullptr), Locale::invariant());
+	const int ids[] = {1000, 1001, 1015, 1024};
+	int length = 0;
+	int index = 0;
+	while (benchmark.running()) {
+		length += table.getString(ids[index++ % 4]).length();
+	}
+	Benchmark::doNotOptimize(length);
+}
+
+
+
+		}
+	}
+}
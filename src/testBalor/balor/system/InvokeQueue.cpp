@@ -0,0 +1,153 @@
+﻿#include <balor/system/InvokeQueue.hpp>
+
+#include <vector>
+#include <boost/thread.hpp>
+
+#include <balor/system/windows.hpp>
+#include <balor/test/UnitTest.hpp>
+
+
+namespace balor {
+	namespace system {
+		namespace testInvokeQueue {
+
+using boost::condition_variable;
+using boost::mutex;
+using boost::thread;
+using std::vector;
+
+
+
+testCase(pushAndRun) {
+	InvokeQueue queue;
+	testAssert(queue.empty());
+	testAssert(!queue.run());
+
+	// 무효한 파라미터
+	testAssertionFailed(queue.push(InvokeQueue::Function()));
+
+	vector<int> results;
+	testAssert( queue.push([&] () { results.push_back(0); })); // 비어 있을 때만 깨울 필요가 있다
+	testAssert(!queue.push([&] () { results.push_back(1); }));
+	testAssert(!queue.push([&] () { results.push_back(2); }));
+	testAssert(!queue.empty());
+	testAssert(!queue.run());
+	testAssert(queue.empty());
+	testAssert(results.size() == 3);
+	testAssert(results[0] == 0);
+	testAssert(results[1] == 1);
+	testAssert(results[2] == 2);
+
+	// run 후에는 다시 깨울 필요가 있다
+	testAssert( queue.push([&] () { results.push_back(3); }));
+	testAssert(!queue.run());
+	testAssert(results.size() == 4);
+}
+
+
+testCase(runInFunction) {
+	InvokeQueue queue;
+	int count = 0;
+	testAssert(queue.push([&] () {
+		++count;
+		testAssert(queue.push([&] () { ++count; })); // 실행 중에 추가하면 깨울 필요가 있다고 알리지만 같은 run 으로 실행된다
+	}));
+	testAssert(!queue.run());
+	testAssert(count == 2);
+}
+
+
+testCase(timeBudget) {
+	InvokeQueue queue;
+	int count = 0;
+	for (int i = 0; i < 1000; ++i) {
+		queue.push([&] () {
+			++count;
+			Sleep(1);
+		});
+	}
+	testAssert(queue.run(10)); // 시간 내에 끝나지 않았으므로 다시 깨울 필요가 있다
+	testAssert(0 < count && count < 1000);
+	testAssert(!queue.push([&] () { ++count; })); // 이미 깨울 필요가 있다고 알렸다
+	while (queue.run(10)) {
+	}
+	testAssert(count == 1001);
+	testAssert(queue.empty());
+}
+
+
+testCase(destructWithFunctions) {
+	int count = 0;
+	{
+		InvokeQueue queue;
+		queue.push([&] () { ++count; });
+		queue.push([&] () { ++count; });
+	}
+	testAssert(count == 0); // 실행되지 않고 파기된다
+}
+
+
+testCase(stress) { // 복수의 생산자 스레드와 하나의 실행 스레드
+	const int producerCount = 8;
+	const int pushCount = 100000;
+
+	InvokeQueue queue;
+	mutex wakeMutex;
+	condition_variable wakeCondition;
+	bool woken = false;
+	int wakeCount = 0;
+
+	vector<int> lasts(producerCount, -1);
+	bool ordered = true;
+	int total = 0;
+	thread consumer([&] () {
+		while (total < producerCount * pushCount) {
+			{
+				mutex::scoped_lock lock(wakeMutex);
+				while (!woken) {
+					wakeCondition.wait(lock);
+				}
+				woken = false;
+			}
+			while (queue.run(1)) { // 다 실행하지 못했으면 스스로 다시 깨운다
+			}
+		}
+	});
+
+	vector<thread*> producers;
+	for (int i = 0; i < producerCount; ++i) {
+		producers.push_back(new thread([&, i] () {
+			for (int j = 0; j < pushCount; ++j) {
+				const bool wake = queue.push([&, i, j] () {
+					if (lasts[i] + 1 != j) { // 같은 생산자의 함수는 추가된 순서대로 실행된다
+						ordered = false;
+					}
+					lasts[i] = j;
+					++total;
+				});
+				if (wake) {
+					mutex::scoped_lock lock(wakeMutex);
+					++wakeCount;
+					woken = true;
+					wakeCondition.notify_one();
+				}
+			}
+		}));
+	}
+	for (auto i = producers.begin(), end = producers.end(); i != end; ++i) {
+		(*i)->join();
+		delete *i;
+	}
+	consumer.join();
+
+	testAssert(total == producerCount * pushCount);
+	testAssert(ordered);
+	testAssert(queue.empty());
+	testAssert(0 < wakeCount && wakeCount < total); // 추가할 때마다 깨우지는 않는다
+}
+
+
+
+		}
+	}
+}
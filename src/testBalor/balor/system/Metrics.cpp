@@ -0,0 +1,357 @@
+﻿#include <balor/system/Metrics.hpp>
+
+#include <atomic>
+#include <climits>
+#include <string>
+#include <vector>
+#include <boost/thread.hpp>
+
+#include <balor/io/MemoryStream.hpp>
+#include <balor/system/windows.hpp>
+#include <balor/test/Benchmark.hpp>
+#include <balor/test/UnitTest.hpp>
+#include <balor/String.hpp>
+
+#include "../../tools/runContended.hpp"
+
+
+namespace balor {
+	namespace system {
+		namespace testMetrics {
+
+using boost::thread;
+using std::string;
+using std::vector;
+using namespace balor::io;
+using namespace balor::test;
+using tools::runContended;
+
+
+namespace {
+string toString(const MemoryStream& stream) {
+	return string(static_cast<const char*>(stream.buffer()), static_cast<int>(stream.length()));
+}
+
+
+int countLines(const string& text) {
+	int count = 0;
+	for (auto i = text.begin(), end = text.end(); i != end; ++i) {
+		if (*i == '\n') {
+			++count;
+		}
+	}
+	return count;
+}
+} // namespace
+
+
+
+testCase(handle) {
+	Metrics::Counter counter;
+	testAssert(!counter);
+	testAssertionFailed(counter.add());
+	testAssertionFailed(counter.value());
+	Metrics::Gauge gauge;
+	testAssert(!gauge);
+	testAssertionFailed(gauge.value(1));
+	Metrics::Histogram histogram;
+	testAssert(!histogram);
+	testAssertionFailed(histogram.record(1));
+	testAssertionFailed(histogram.snapshot());
+}
+
+
+testCase(counter) {
+	Metrics metrics;
+	// 무효한 파라미터
+	testAssertionFailed(metrics.counter(L""));
+
+	Metrics::Counter counter = metrics.counter(L"requests");
+	testAssert(counter);
+	testAssert(String::equals(counter.name(), L"requests"));
+	testAssert(counter.value() == 0);
+	counter.add();
+	counter.add(10);
+	testAssert(counter.value() == 11);
+
+	// 같은 이름이면 같은 카운터
+	Metrics::Counter same = metrics.counter(L"requests");
+	same.add();
+	testAssert(counter.value() == 12);
+	testAssert(metrics.counter(L"other").value() == 0);
+
+	// 다른 종류의 같은 이름
+	testThrow(metrics.gauge(L"requests"), Metrics::NameConflictException);
+	testThrow(metrics.histogram(L"requests"), Metrics::NameConflictException);
+
+	{// 여러 스레드에서 동시에 더한다
+		vector<thread> threads;
+		for (int i = 0; i < 40; ++i) { // 샤드 수보다 많은 스레드
+			threads.push_back(thread([&] () {
+				for (int j = 0; j < 1000; ++j) {
+					counter.add();
+				}
+			}));
+		}
+		for (auto i = threads.begin(), end = threads.end(); i != end; ++i) {
+			i->join();
+		}
+		testAssert(counter.value() == 12 + 40 * 1000);
+	}
+}
+
+
+testCase(gauge) {
+	Metrics metrics;
+	Metrics::Gauge gauge = metrics.gauge(L"queueLength");
+	testAssert(String::equals(gauge.name(), L"queueLength"));
+	testAssert(gauge.value() == 0);
+	gauge.value(5);
+	testAssert(gauge.value() == 5);
+	gauge.add(-3);
+	testAssert(gauge.value() == 2);
+	testAssert(metrics.gauge(L"queueLength").value() == 2);
+	testThrow(metrics.counter(L"queueLength"), Metrics::NameConflictException);
+}
+
+
+testCase(histogram) {
+	Metrics metrics;
+	Metrics::Histogram histogram = metrics.histogram(L"latency");
+	testAssert(String::equals(histogram.name(), L"latency"));
+	// 무효한 파라미터
+	testAssertionFailed(histogram.record(-1));
+
+	{// 비어 있는 히스토그램
+		HistogramSnapshot snapshot = histogram.snapshot();
+		testAssert(snapshot.count() == 0);
+		testAssert(snapshot.sum() == 0);
+		testAssert(snapshot.min() == 0);
+		testAssert(snapshot.max() == 0);
+		testAssert(snapshot.mean() == 0);
+		testAssert(snapshot.percentile(50) == 0);
+		testAssertionFailed(snapshot.percentile(-1));
+		testAssertionFailed(snapshot.percentile(101));
+	}
+	{// 16 미만의 값은 정확하다
+		for (int i = 0; i < 10; ++i) {
+			histogram.record(i);
+		}
+		HistogramSnapshot snapshot = histogram.snapshot();
+		testAssert(snapshot.count() == 10);
+		testAssert(snapshot.sum() == 45);
+		testAssert(snapshot.min() == 0);
+		testAssert(snapshot.max() == 9);
+		testAssert(snapshot.mean() == 4.5);
+		testAssert(snapshot.percentile(0) == 0);
+		testAssert(snapshot.percentile(50) == 4);
+		testAssert(snapshot.percentile(90) == 8);
+		testAssert(snapshot.percentile(100) == 9);
+	}
+	{// 큰 값의 상대 오차는 1/16 이하
+		Metrics::Histogram large = metrics.histogram(L"large");
+		for (__int64 i = 1; i <= 100000; ++i) {
+			large.record(i * 1000);
+		}
+		HistogramSnapshot snapshot = large.snapshot();
+		testAssert(snapshot.count() == 100000);
+		testAssert(snapshot.min() == 1000);
+		testAssert(snapshot.max() == 100000000);
+		const double percents[] = {1, 50, 90, 99, 99.9};
+		for (int i = 0; i < 5; ++i) {
+			const double expected = percents[i] * 1000000;
+			const __int64 actual = snapshot.percentile(percents[i]);
+			testAssert(expected <= actual);
+			testAssert(actual <= expected * 17 / 16);
+		}
+		testAssert(snapshot.percentile(100) == 100000000);
+	}
+	{// __int64 의 최대값까지 기록할 수 있다
+		Metrics::Histogram huge = metrics.histogram(L"huge");
+		huge.record(LLONG_MAX);
+		huge.record(LLONG_MAX / 3);
+		HistogramSnapshot snapshot = huge.snapshot();
+		testAssert(snapshot.max() == LLONG_MAX);
+		testAssert(snapshot.percentile(100) == LLONG_MAX);
+		testAssert(LLONG_MAX / 3 <= snapshot.percentile(50));
+	}
+	{// 여러 스레드에서 동시에 기록한다
+		Metrics::Histogram shared = metrics.histogram(L"shared");
+		vector<thread> threads;
+		for (int i = 0; i < 40; ++i) {
+			threads.push_back(thread([&, i] () {
+				for (int j = 0; j < 1000; ++j) {
+					shared.record(i);
+				}
+			}));
+		}
+		for (auto i = threads.begin(), end = threads.end(); i != end; ++i) {
+			i->join();
+		}
+		HistogramSnapshot snapshot = shared.snapshot();
+		testAssert(snapshot.count() == 40 * 1000);
+		testAssert(snapshot.sum() == 1000 * (39 * 40 / 2));
+		testAssert(snapshot.min() == 0);
+		testAssert(snapshot.max() == 39);
+	}
+}
+
+
+testCase(collectProcess) {
+	Metrics metrics;
+	metrics.collectProcess();
+	testAssert(0 <= metrics.gauge(L"process.userTime").value());
+	testAssert(0 <= metrics.gauge(L"process.kernelTime").value());
+	testAssert(0 < metrics.gauge(L"process.workingSet").value());
+	testAssert(0 <= metrics.gauge(L"process.readBytes").value());
+	testAssert(0 <= metrics.gauge(L"process.writeBytes").value());
+
+	// 프로세스의 값과 같은 이름은 다른 종류로 쓸 수 없다
+	testThrow(metrics.counter(L"process.workingSet"), Metrics::NameConflictException);
+}
+
+
+testCase(writeCsv) {
+	Metrics metrics;
+	metrics.counter(L"b.count").add(3);
+	metrics.gauge(L"a,gauge").value(-7);
+	Metrics::Histogram histogram = metrics.histogram(L"c.latency");
+	histogram.record(1);
+	histogram.record(3);
+
+	MemoryStream stream;
+	metrics.writeCsv(stream);
+	const string text = toString(stream);
+	testAssert(text.find("time,name,kind,value,count,min,max,mean,p50,p90,p99,p999\r\n") == 0);
+	testAssert(countLines(text) == 4);
+	// 이름 순서로 쓰고 쉼표를 포함하는 이름은 따옴표로 감싼다
+	const auto gauge = text.find(",\"a,gauge\",gauge,-7,,,,,,,,\r\n");
+	const auto counter = text.find(",b.count,counter,3,,,,,,,,\r\n");
+	const auto latency = text.find(",c.latency,histogram,,2,1,3,2.000,1,3,3,3\r\n");
+	testAssert(gauge != string::npos);
+	testAssert(counter != string::npos);
+	testAssert(latency != string::npos);
+	testAssert(gauge < counter);
+	testAssert(counter < latency);
+
+	// 헤더 없음
+	MemoryStream noHeader;
+	metrics.writeCsv(noHeader, false);
+	testAssert(countLines(toString(noHeader)) == 3);
+	testAssert(toString(noHeader).find("time,") == string::npos);
+}
+
+
+testCase(writeJson) {
+	Metrics metrics;
+	metrics.counter(L"count").add(3);
+	metrics.gauge(L"\"quoted\"\\").value(5);
+	metrics.histogram(L"latency").record(10);
+	metrics.counter(L"あ").add();
+
+	MemoryStream stream;
+	metrics.writeJson(stream);
+	const string text = toString(stream);
+	testAssert(countLines(text) == 4);
+	testAssert(text.find("{\"time\":\"") == 0);
+	testAssert(text.find("Z\",\"name\":\"count\",\"kind\":\"counter\",\"value\":3}\r\n") != string::npos);
+	testAssert(text.find("\"name\":\"\\\"quoted\\\"\\\\\",\"kind\":\"gauge\",\"value\":5}\r\n") != string::npos);
+	testAssert(text.find("\"name\":\"latency\",\"kind\":\"histogram\",\"count\":1,\"min\":10,\"max\":10,\"mean\":10.000,\"p50\":10,\"p90\":10,\"p99\":10,\"p999\":10}\r\n") != string::npos);
+	testAssert(text.find("\"name\":\"\xE3\x81\x82\"") != string::npos); // UTF-8
+}
+
+
+testCase(startReportAndStopReport) {
+	Metrics metrics;
+	Metrics::Counter counter = metrics.counter(L"count");
+	// 무효한 파라미터
+	MemoryStream stream;
+	testAssertionFailed(metrics.startReport(stream, Metrics::Format::_enum(-1), 10));
+	testAssertionFailed(metrics.startReport(stream, Metrics::Format::csv, 0));
+
+	// 시작하지 않았으면 아무것도 하지 않는다
+	testNoThrow(metrics.stopReport());
+
+	{// CSV 의 헤더는 처음 한 번만 쓴다
+		metrics.startReport(stream, Metrics::Format::csv, 10, false);
+		testAssertionFailed(metrics.startReport(stream, Metrics::Format::csv, 10));
+		counter.add();
+		Sleep(100);
+		metrics.stopReport();
+		const string text = toString(stream);
+		testAssert(text.find("time,name,kind") == 0);
+		testAssert(text.find("time,name,kind", 1) == string::npos);
+		testAssert(3 <= countLines(text)); // 멈출 때도 쓴다
+		testAssert(text.find(",count,counter,1,") != string::npos);
+		testAssert(text.find("process.") == string::npos);
+	}
+	{// 멈출 때 마지막으로 쓴다
+		MemoryStream json;
+		metrics.startReport(json, Metrics::Format::json, 100000);
+		counter.add();
+		metrics.stopReport();
+		const string text = toString(json);
+		testAssert(text.find("\"name\":\"count\",\"kind\":\"counter\",\"value\":2}") != string::npos);
+		testAssert(text.find("\"name\":\"process.workingSet\"") != string::npos);
+	}
+	{// 쓰기에서 발생한 예외는 stopReport 에서 다시 던진다
+		char buffer[4];
+		MemoryStream small(buffer); // 용량을 넘으면 예외
+		metrics.startReport(small, Metrics::Format::csv, 100000);
+		testThrow(metrics.stopReport(), MemoryStream::BufferOverrunException);
+		testNoThrow(metrics.stopReport());
+	}
+	{// 소멸자에서 멈춘다
+		MemoryStream last;
+		{
+			Metrics local;
+			local.counter(L"local").add();
+			local.startReport(last, Metrics::Format::json, 100000, false);
+		}
+		testAssert(toString(last).find("\"name\":\"local\"") != string::npos);
+	}
+}
+
+
+testCase(global) {
+	Metrics& metrics = Metrics::global();
+	testAssert(&metrics == &Metrics::global());
+	Metrics::Counter counter = metrics.counter(L"testMetrics.global");
+	const __int64 value = counter.value();
+	counter.add();
+	testAssert(Metrics::global().counter(L"testMetrics.global").value() == value + 1);
+}
+
+
+// 샤드로 나눈 카운터와 하나의 atomic 변수의 비교. 사이즈는 동시에 더하는 스레드 수
+BALOR_BENCHMARK_SIZES(benchmarkMetricsCounterAdd, 1, 4) {
+	Metrics metrics;
+	Metrics::Counter counter = metrics.counter(L"benchmark");
+	runContended(benchmark, [&] () {
+		counter.add();
+	});
+}
+
+
+BALOR_BENCHMARK_SIZES(benchmarkMetricsSingleAtomicAdd, 1, 4) {
+	std::atomic<__int64> single(0);
+	runContended(benchmark, [&] () {
+		single.fetch_add(1);
+	});
+}
+
+
+BALOR_BENCHMARK(benchmarkMetricsHistogramRecord) {
+	Metrics metrics;
+	Metrics::Histogram histogram = metrics.histogram(L"benchmarkHistogram");
+	int value = 0;
+	while (benchmark.running()) {
+		histogram.record(value++);
+	}
+}
+
+
+
+		}
+	}
+}
@@ -0,0 +1,306 @@
+﻿#include <balor/system/TaskScheduler.hpp>
+
+#include <algorithm>
+#include <vector>
+#include <boost/thread.hpp>
+
+#include <balor/system/windows.hpp>
+#include <balor/test/Benchmark.hpp>
+#include <balor/test/UnitTest.hpp>
+#include <balor/String.hpp>
+
+#include "../../tools/runContended.hpp"
+
+
+namespace balor {
+	namespace system {
+		namespace testTaskScheduler {
+
+using boost::thread;
+using std::vector;
+using namespace balor::test;
+using tools::runContended;
+
+
+namespace {
+struct Executor { // Control::invoke 의 대역
+	Executor() : count(0) {}
+	void invoke(const std::function<void ()>& function, bool synchronous) {
+		testAssert(!synchronous);
+		++count;
+		function();
+	}
+	int count;
+};
+} // namespace
+
+
+
+testCase(construct) {
+	{
+		TaskScheduler scheduler;
+		testAssert(0 < scheduler.threadCount());
+	}
+	{
+		TaskScheduler scheduler(3);
+		testAssert(scheduler.threadCount() == 3);
+	}
+	testAssert(0 < TaskScheduler::global().threadCount());
+}
+
+
+testCase(run) {
+	TaskScheduler scheduler(4);
+
+	// 무효한 파라미터
+	testAssertionFailed(scheduler.post(TaskScheduler::Function()));
+
+	auto task = scheduler.run([] () { return 42; });
+	testAssert(task.get() == 42);
+	testAssert(task.done());
+
+	auto voidTask = scheduler.run([] () {});
+	testNoThrow(voidTask.get());
+
+	auto stringTask = scheduler.run([] () { return String(L"abc"); });
+	testAssert(stringTask.get() == L"abc");
+
+	// 예외는 get 으로 다시 던진다
+	auto throwTask = scheduler.run([] () -> int { throw 1; });
+	testThrow(throwTask.get(), int);
+}
+
+
+testCase(cancel) {
+	TaskScheduler scheduler(1);
+	boost::mutex mutex;
+	mutex.lock();
+	scheduler.post([&] () { // 워커를 막아둔다
+		mutex.lock();
+		mutex.unlock();
+	});
+
+	CancellationToken token;
+	bool ran = false;
+	auto task = scheduler.run([&] () { ran = true; }, TaskScheduler::Priority::normal, token);
+	auto otherTask = scheduler.run([] () { return 1; });
+	task.cancel();
+	testAssert(token.canceled());
+	mutex.unlock();
+	testThrow(task.get(), TaskScheduler::CanceledException);
+	testAssert(!ran);
+	testAssert(otherTask.get() == 1);
+
+	// 실행 중에 취소를 확인
+	CancellationToken runningToken;
+	auto runningTask = scheduler.run([=] () {
+		for ( ; ; ) {
+			runningToken.throwIfCanceled();
+			Sleep(1);
+		}
+	}, TaskScheduler::Priority::normal, runningToken);
+	Sleep(10);
+	runningToken.cancel();
+	testThrow(runningTask.get(), TaskScheduler::CanceledException);
+}
+
+
+testCase(priority) {
+	TaskScheduler scheduler(1);
+	boost::mutex mutex;
+	mutex.lock();
+	scheduler.post([&] () { // 워커를 막아둔다
+		mutex.lock();
+		mutex.unlock();
+	});
+
+	vector<int> order;
+	scheduler.post([&] () { order.push_back(0); }, TaskScheduler::Priority::low);
+	scheduler.post([&] () { order.push_back(1); }, TaskScheduler::Priority::normal);
+	auto last = scheduler.run([&] () { order.push_back(2); }, TaskScheduler::Priority::high);
+	mutex.unlock();
+	last.get();
+	while (order.size() < 3) {
+		Sleep(1);
+	}
+	testAssert(order[0] == 2);
+	testAssert(order[1] == 1);
+	testAssert(order[2] == 0);
+}
+
+
+testCase(postOrder) { // 워커 스레드 이외에서 추가한 같은 우선도의 태스크는 추가한 순서로 실행한다
+	TaskScheduler scheduler(1);
+	boost::mutex mutex;
+	mutex.lock();
+	scheduler.post([&] () { // 워커를 막아둔다
+		mutex.lock();
+		mutex.unlock();
+	});
+
+	vector<int> order;
+	for (int i = 0; i < 99; ++i) {
+		scheduler.post([&order, i] () { order.push_back(i); });
+	}
+	auto last = scheduler.run([&] () { order.push_back(99); });
+	mutex.unlock();
+	last.get();
+	testAssert(order.size() == 100);
+	for (int i = 0; i < 100; ++i) {
+		testAssert(order[i] == i);
+	}
+}
+
+
+testCase(thenOn) {
+	TaskScheduler scheduler(2);
+	Executor executor;
+	boost::mutex mutex;
+	int result = 0;
+	mutex.lock();
+	auto task = scheduler.run([&] () {
+		mutex.lock();
+		mutex.unlock();
+		return 5;
+	});
+	task.thenOn(executor, [&] (Task<int>& task) {
+		result = task.get();
+	});
+	testAssert(result == 0);
+	mutex.unlock();
+	task.get();
+	while (!executor.count) {
+		Sleep(1);
+	}
+	testAssert(result == 5);
+
+	// 완료된 후에 등록하면 바로 실행한다
+	Executor doneExecutor;
+	task.thenOn(doneExecutor, [&] (Task<int>& task) {
+		result = task.get() * 2;
+	});
+	testAssert(doneExecutor.count == 1);
+	testAssert(result == 10);
+
+	{// 하나의 태스크에 복수의 계속을 등록하면 등록한 순서대로 실행한다
+		Executor multiExecutor;
+		vector<int> order;
+		mutex.lock();
+		auto multiTask = scheduler.run([&] () {
+			mutex.lock();
+			mutex.unlock();
+			return 3;
+		});
+		multiTask.thenOn(multiExecutor, [&] (Task<int>& task) { order.push_back(task.get()); });
+		multiTask.thenOn(multiExecutor, [&] (Task<int>& task) { order.push_back(task.get() * 2); });
+		mutex.unlock();
+		multiTask.get();
+		while (multiExecutor.count < 2) {
+			Sleep(1);
+		}
+		testAssert(order.size() == 2);
+		testAssert(order[0] == 3);
+		testAssert(order[1] == 6);
+	}
+	{// weak_ptr 로 등록하면 완료했을 때 executor 가 파기되어 있으면 계속을 실행하지 않는다
+		auto sharedExecutor = std::make_shared<Executor>();
+		bool called = false;
+		task.thenOn(std::weak_ptr<Executor>(sharedExecutor), [&] (Task<int>& ) { called = true; });
+		testAssert(sharedExecutor->count == 1);
+		testAssert(called);
+
+		called = false;
+		mutex.lock();
+		auto expiredTask = scheduler.run([&] () {
+			mutex.lock();
+			mutex.unlock();
+			return 1;
+		});
+		expiredTask.thenOn(std::weak_ptr<Executor>(sharedExecutor), [&] (Task<int>& ) { called = true; });
+		sharedExecutor.reset();
+		mutex.unlock();
+		expiredTask.get();
+		Sleep(10);
+		testAssert(!called);
+	}
+}
+
+
+testCase(nestedGet) { // 워커 스레드에서 get 으로 기다리는 동안 다른 태스크를 실행하므로 워커가 고갈되지 않는다
+	TaskScheduler scheduler(1);
+	auto outer = scheduler.run([&] () {
+		auto inner = scheduler.run([] () { return 7; });
+		return inner.get() * 2;
+	});
+	testAssert(outer.get() == 14);
+
+	// 재귀적으로 태스크를 나누어도 워커의 수와 관계없이 끝난다
+	TaskScheduler twoScheduler(2);
+	std::function<int (int)> fibonacci = [&] (int n) -> int {
+		if (n < 2) {
+			return n;
+		}
+		auto task = twoScheduler.run([&, n] () { return fibonacci(n - 1); });
+		const int value = fibonacci(n - 2);
+		return task.get() + value;
+	};
+	testAssert(twoScheduler.run([&] () { return fibonacci(16); }).get() == 987);
+}
+
+
+testCase(nestedPost) { // 워커 스레드에서 추가한 태스크는 다른 워커가 훔쳐서 실행한다
+	TaskScheduler scheduler(4);
+	std::atomic<int> count(0);
+	std::function<void (int)> spawn = [&] (int depth) {
+		++count;
+		if (0 < depth) {
+			scheduler.post([&, depth] () { spawn(depth - 1); });
+			scheduler.post([&, depth] () { spawn(depth - 1); });
+		}
+	};
+	scheduler.post([&] () { spawn(14); });
+	while (count.load() < (1 << 15) - 1) {
+		Sleep(1);
+	}
+	testAssert(count.load() == (1 << 15) - 1);
+}
+
+
+testCase(destructWithTasks) { // 소멸자는 남은 태스크를 전부 실행한다
+	std::atomic<int> count(0);
+	{
+		TaskScheduler scheduler(2);
+		for (int i = 0; i < 1000; ++i) {
+			scheduler.post([&] () { ++count; });
+		}
+	}
+	testAssert(count.load() == 1000);
+}
+
+
+BALOR_BENCHMARK(benchmarkTaskSchedulerRunGet) { // run 부터 태스크가 끝나서 get 이 돌아올 때까지의 시간
+	TaskScheduler scheduler(4);
+	while (benchmark.running()) {
+		scheduler.run([] () {}).get();
+	}
+}
+
+
+BALOR_BENCHMARK_SIZES(benchmarkTaskSchedulerPost, 1, 8) { // 복수의 스레드에서 동시에 추가할 때의 비용. 사이즈는 추가하는 스레드 수
+	TaskScheduler scheduler;
+	std::atomic<int> posted(0);
+	std::atomic<int> count(0);
+	runContended(benchmark, [&] () {
+		++posted;
+		scheduler.post([&] () { ++count; });
+	});
+	while (count.load() < posted.load()) { // count 를 참조하는 태스크가 남지 않도록 한다
+		Sleep(0);
+	}
+}
+
+
+
+		}
+	}
+}
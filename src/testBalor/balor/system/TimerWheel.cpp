@@ -0,0 +1,378 @@
+﻿#include <balor/system/TimerWheel.hpp>
+
+#include <memory>
+#include <vector>
+
+#include <balor/system/windows.hpp>
+#include <balor/test/Benchmark.hpp>
+#include <balor/test/UnitTest.hpp>
+
+
+namespace balor {
+	namespace system {
+		namespace testTimerWheel {
+
+using std::move;
+using std::vector;
+using namespace balor::test;
+typedef TimerWheel::Timer Timer;
+
+
+namespace {
+struct FakeClock { // 실제 시간을 기다리지 않고 시각을 진행시킨다
+	FakeClock() : now(0) {}
+	TimerWheel::Clock clock() { return [&] () { return now; }; }
+	__int64 now;
+};
+
+
+/// 1 ~ 60000 밀리초의 흩어진 간격으로 반복하는 타이머를 count 개 시작한다
+vector<Timer> startTimers(TimerWheel& wheel, int count) {
+	vector<Timer> timers;
+	timers.reserve(count);
+	for (int i = 0; i < count; ++i) {
+		timers.push_back(Timer(wheel, 1 + (i * 7919) % 60000, [] (Timer::Run& ) {}));
+		timers.back().start();
+	}
+	return timers;
+}
+} // namespace
+
+
+
+testCase(construct) {
+	FakeClock clock;
+
+	// 무효한 파라미터
+	testAssertionFailed(TimerWheel(TimerWheel::Clock(), 1));
+	testAssertionFailed(TimerWheel(clock.clock(), 0));
+
+	TimerWheel wheel(clock.clock(), 10);
+	testAssert(wheel.resolution() == 10);
+	testAssert(wheel.now() == 0);
+	testAssert(wheel.nextExpiration() == -1);
+
+	{
+		Timer timer;
+		testAssert(!timer.wheel());
+		testAssert(timer.interval() == 1000);
+		testAssert(!timer.started());
+		testAssertionFailed(timer.start());
+	}
+	{
+		testAssertionFailed(Timer(wheel, 0));
+		int count = 0;
+		Timer timer(wheel, 100, [&] (Timer::Run& e) {
+			testAssert(e.sender().wheel() == &wheel);
+			++count;
+		});
+		testAssert(timer.wheel() == &wheel);
+		testAssert(timer.interval() == 100);
+		testAssert(!timer.oneShot());
+		testAssert(timer.tolerance() == 0);
+
+		Timer moved = move(timer);
+		testAssert(moved.wheel() == &wheel);
+		testAssert(!timer.wheel());
+		moved.start();
+		clock.now = 100;
+		wheel.advance();
+		testAssert(count == 1);
+
+		Timer started(wheel, 100);
+		started.start();
+		testAssertionFailed(Timer other(move(started)));
+	}
+}
+
+
+testCase(periodic) {
+	FakeClock clock;
+	TimerWheel wheel(clock.clock());
+	vector<__int64> times;
+	Timer timer(wheel, 100, [&] (Timer::Run& ) {
+		times.push_back(clock.now);
+	});
+	timer.start();
+	testAssert(timer.started());
+	testAssert(wheel.nextExpiration() == 100);
+
+	clock.now = 99;
+	wheel.advance();
+	testAssert(times.empty());
+	clock.now = 100;
+	wheel.advance();
+	testAssert(times.size() == 1);
+	for (clock.now = 101; clock.now <= 400; ++clock.now) {
+		wheel.advance();
+	}
+	testAssert(times.size() == 4);
+	testAssert(times[1] == 200 && times[2] == 300 && times[3] == 400);
+
+	// 놓친 주기는 한 번으로 합친다
+	clock.now = 1050;
+	wheel.advance();
+	testAssert(times.size() == 5);
+	testAssert(wheel.nextExpiration() == 50);
+
+	timer.stop();
+	testAssert(!timer.started());
+	testAssert(wheel.nextExpiration() == -1);
+	clock.now = 2000;
+	wheel.advance();
+	testAssert(times.size() == 5);
+}
+
+
+testCase(oneShot) {
+	FakeClock clock;
+	TimerWheel wheel(clock.clock());
+	int count = 0;
+	Timer timer(wheel, 50, [&] (Timer::Run& ) {
+		++count;
+	});
+	timer.oneShot(true);
+	testAssert(timer.oneShot());
+	timer.start();
+	clock.now = 1000;
+	wheel.advance();
+	testAssert(count == 1);
+	testAssert(!timer.started());
+
+	// onRun 안에서 다시 시작
+	timer.onRun() = [&] (Timer::Run& e) {
+		if (++count < 5) {
+			e.sender().start();
+		}
+	};
+	timer.start();
+	for (int i = 0; i < 10; ++i) {
+		clock.now += 50;
+		wheel.advance();
+	}
+	testAssert(count == 5);
+}
+
+
+testCase(longInterval) { // 계층을 넘나드는 간격과 모든 계층을 넘는 간격
+	FakeClock clock;
+	TimerWheel wheel(clock.clock());
+	const int intervals[] = {1, 63, 64, 65, 4095, 4096, 4097, 262143, 262145, 16777215, 16777216, 16777217, 100000000};
+	const int count = sizeof(intervals) / sizeof(intervals[0]);
+	vector<__int64> firedTimes(count, -1);
+	vector<std::unique_ptr<Timer> > timers;
+	for (int i = 0; i < count; ++i) {
+		timers.push_back(std::unique_ptr<Timer>(new Timer(wheel, intervals[i], [&, i] (Timer::Run& ) {
+			if (firedTimes[i] < 0) {
+				firedTimes[i] = clock.now;
+			}
+		})));
+		timers.back()->oneShot(true);
+		timers.back()->start();
+	}
+	// 다음 만료까지 시계를 건너뛰어도 정확한 시각에 발생한다
+	while (0 <= wheel.nextExpiration()) {
+		clock.now += wheel.nextExpiration();
+		wheel.advance();
+	}
+	for (int i = 0; i < count; ++i) {
+		testAssert(firedTimes[i] == intervals[i]);
+	}
+}
+
+
+testCase(stopInOnRun) { // 같은 tick 의 다른 타이머를 onRun 안에서 정지
+	FakeClock clock;
+	TimerWheel wheel(clock.clock());
+	int count = 0;
+	Timer second(wheel, 100, [&] (Timer::Run& ) {
+		++count;
+	});
+	Timer first(wheel, 100, [&] (Timer::Run& e) {
+		++count;
+		e.sender().stop();
+		second.stop();
+	});
+	first.start();
+	second.start();
+	clock.now = 100;
+	wheel.advance();
+	testAssert(count == 1);
+	testAssert(!first.started());
+	testAssert(!second.started());
+	testAssert(wheel.nextExpiration() == -1);
+}
+
+
+testCase(pauseAndResume) {
+	FakeClock clock;
+	TimerWheel wheel(clock.clock());
+	int count = 0;
+	Timer timer(wheel, 100, [&] (Timer::Run& ) {
+		++count;
+	});
+	timer.pause(); // 시작하지 않았으면 무시
+	testAssert(!timer.paused());
+
+	timer.start();
+	clock.now = 30;
+	timer.pause();
+	testAssert(timer.paused());
+	testAssert(timer.started());
+	clock.now = 1000;
+	wheel.advance();
+	testAssert(count == 0);
+
+	timer.resume(); // 남은 70 밀리초 후에 발생
+	testAssert(!timer.paused());
+	testAssert(wheel.nextExpiration() == 70);
+	clock.now = 1069;
+	wheel.advance();
+	testAssert(count == 0);
+	clock.now = 1070;
+	wheel.advance();
+	testAssert(count == 1);
+
+	timer.pause();
+	timer.stop();
+	testAssert(!timer.started());
+	testAssert(!timer.paused());
+}
+
+
+testCase(interval) {
+	FakeClock clock;
+	TimerWheel wheel(clock.clock());
+	int count = 0;
+	Timer timer(wheel, 100, [&] (Timer::Run& ) {
+		++count;
+	});
+	testAssertionFailed(timer.interval(0));
+	timer.start();
+	clock.now = 50;
+	timer.interval(200); // 지금부터 다시 시작
+	testAssert(wheel.nextExpiration() == 200);
+	clock.now = 250;
+	wheel.advance();
+	testAssert(count == 1);
+}
+
+
+testCase(tolerance) { // 허용 지연 안에서 만료 시각을 맞춰서 기상 횟수를 줄인다
+	FakeClock clock;
+	TimerWheel wheel(clock.clock());
+	testAssertionFailed(Timer(wheel, 10).tolerance(-1));
+
+	vector<__int64> times;
+	vector<std::unique_ptr<Timer> > timers;
+	for (int i = 0; i < 10; ++i) {
+		timers.push_back(std::unique_ptr<Timer>(new Timer(wheel, 1000 + i * 2, [&] (Timer::Run& ) {
+			times.push_back(clock.now);
+		})));
+		timers.back()->tolerance(100);
+		timers.back()->oneShot(true);
+		timers.back()->start();
+	}
+	int wakeCount = 0;
+	while (0 <= wheel.nextExpiration()) {
+		clock.now += wheel.nextExpiration();
+		wheel.advance();
+		++wakeCount;
+	}
+	testAssert(times.size() == 10);
+	testAssert(wakeCount == 1);
+	for (auto i = times.begin(), end = times.end(); i != end; ++i) {
+		testAssert(*i == times.front());
+		testAssert(1018 <= *i && *i <= 1100);
+	}
+}
+
+
+testCase(resolution) {
+	FakeClock clock;
+	TimerWheel wheel(clock.clock(), 16);
+	int count = 0;
+	Timer timer(wheel, 20, [&] (Timer::Run& ) {
+		++count;
+	});
+	timer.start();
+	testAssert(wheel.nextExpiration() == 32); // 분해능의 배수로 올림
+	clock.now = 31;
+	wheel.advance();
+	testAssert(count == 0);
+	clock.now = 32;
+	wheel.advance();
+	testAssert(count == 1);
+}
+
+
+testCase(onReschedule) { // 지금까지의 nextExpiration 보다 빨리 만료하는 타이머를 시작하면 통지한다
+	FakeClock clock;
+	int rescheduleCount = 0;
+	TimerWheel wheel(clock.clock(), 1, [&] () {
+		++rescheduleCount;
+	});
+	Timer slow(wheel, 1000);
+	Timer fast(wheel, 10);
+	Timer slower(wheel, 2000);
+	slow.start();
+	testAssert(rescheduleCount == 1);
+	testAssert(wheel.nextExpiration() == 1000);
+	slower.start();
+	testAssert(rescheduleCount == 1);
+	fast.start();
+	testAssert(rescheduleCount == 2);
+
+	// advance 중에는 통지하지 않는다
+	fast.onRun() = [&] (Timer::Run& ) {
+		Timer(wheel, 1).start();
+	};
+	clock.now = 10;
+	wheel.advance();
+	testAssert(rescheduleCount == 2);
+}
+
+
+testCase(destruct) { // 타이머보다 먼저 파괴하면 타이머를 정지한다
+	FakeClock clock;
+	std::unique_ptr<TimerWheel> wheel(new TimerWheel(clock.clock()));
+	Timer timer(*wheel, 10);
+	timer.start();
+	wheel.reset();
+	testAssert(!timer.started());
+}
+
+
+// 사이즈는 미리 시작해 둔 타이머의 수
+BALOR_BENCHMARK_SIZES(benchmarkTimerWheelStartStop, 1000, 100000) {
+	FakeClock clock;
+	TimerWheel wheel(clock.clock());
+	vector<Timer> timers = startTimers(wheel, benchmark.size());
+	vector<Timer> spares = startTimers(wheel, 1024);
+	for (auto i = spares.begin(), end = spares.end(); i != end; ++i) {
+		i->stop();
+	}
+	int index = 0;
+	while (benchmark.running()) {
+		Timer& timer = spares[index++ & 1023];
+		timer.start();
+		timer.stop();
+	}
+}
+
+
+BALOR_BENCHMARK_SIZES(benchmarkTimerWheelAdvance, 1000, 100000) { // 10 밀리초씩 진행한다
+	FakeClock clock;
+	TimerWheel wheel(clock.clock());
+	vector<Timer> timers = startTimers(wheel, benchmark.size());
+	while (benchmark.running()) {
+		clock.now += 10;
+		wheel.advance();
+	}
+}
+
+
+
+		}
+	}
+}
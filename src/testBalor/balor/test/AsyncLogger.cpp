@@ -0,0 +1,399 @@
+﻿#include <balor/test/AsyncLogger.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <string>
+#include <vector>
+#define BOOST_DATE_TIME_NO_LIB
+#define BOOST_THREAD_NO_LIB
+#include <boost/thread.hpp>
+
+#include <balor/io/File.hpp>
+#include <balor/io/FileStream.hpp>
+#include <balor/system/windows.hpp>
+#include <balor/test/Benchmark.hpp>
+#include <balor/test/Debug.hpp>
+#include <balor/test/UnitTest.hpp>
+#include <balor/scopeExit.hpp>
+#include <balor/String.hpp>
+
+#include "../../tools/runContended.hpp"
+
+
+namespace balor {
+	namespace test {
+		namespace testAsyncLogger {
+
+
+using std::string;
+using std::vector;
+using boost::mutex;
+using boost::thread;
+using namespace balor::io;
+using tools::runContended;
+
+
+namespace {
+const wchar_t testDirectoryName[] = L"testBalor_test_AsyncLogger_m4c8xw2kq9rt6vz1hb5ny7pd";
+File getTestDirectory() {
+	File dir(File::getSpecial(File::Special::temporary), testDirectoryName);
+	if (dir.exists()) {
+		dir.remove(true);
+	}
+	dir.createDirectory();
+	return dir;
+}
+
+
+void removeTestDirectory() {
+	File(File::getSpecial(File::Special::temporary), testDirectoryName).remove(true);
+}
+
+
+string readAll(const File& file) {
+	FileStream stream(file, FileStream::Mode::open, FileStream::Access::read, FileStream::Share::read | FileStream::Share::write);
+	string result(static_cast<int>(stream.length()), '\0');
+	if (!result.empty()) {
+		stream.read(&result[0], 0, static_cast<int>(result.size()));
+	}
+	return result;
+}
+
+
+int countLines(const string& text) {
+	return static_cast<int>(std::count(text.begin(), text.end(), '\n'));
+}
+
+
+const char benchmarkMessage[] = "benchmark message 0123456789";
+const int benchmarkMessageLength = sizeof(benchmarkMessage) - 1;
+} // namespace
+
+
+
+testCase(construct) {
+	File dir = getTestDirectory();
+	scopeExit(&removeTestDirectory);
+
+	// 무효한 파라미터
+	testAssertionFailed(AsyncLogger(L"", AsyncLogger::OverflowPolicy::_enum(-1)));
+	testAssertionFailed(AsyncLogger(L"", AsyncLogger::OverflowPolicy::drop, 63));
+	testAssertionFailed(AsyncLogger(L"", AsyncLogger::OverflowPolicy::drop, 1024, 0));
+	testAssertionFailed(AsyncLogger(L"", AsyncLogger::OverflowPolicy::drop, 1024, 1024, 0));
+
+	{// 기본값
+		AsyncLogger logger;
+		testAssert(String::equals(logger.filePath(), L""));
+		testAssert(logger.overflowPolicy() == AsyncLogger::OverflowPolicy::drop);
+		testAssert(logger.bufferSize() == 64 * 1024);
+		testAssert(logger.maxFileSize() == 16 * 1024 * 1024);
+		testAssert(logger.maxFileCount() == 4);
+		testAssert(logger.sampleInterval() == 16);
+		testAssert(logger.droppedCount() == 0);
+	}
+	{// 버퍼 크기는 2의 거듭제곱으로 올림
+		const File path(dir, L"test.log");
+		AsyncLogger logger(path, AsyncLogger::OverflowPolicy::block, 1000, 4096, 2);
+		testAssert(String::equals(logger.filePath(), path.path()));
+		testAssert(logger.overflowPolicy() == AsyncLogger::OverflowPolicy::block);
+		testAssert(logger.bufferSize() == 1024);
+		testAssert(logger.maxFileSize() == 4096);
+		testAssert(logger.maxFileCount() == 2);
+	}
+	testAssert(!File(dir, L"test.log").exists()); // 쓰지 않으면 파일을 만들지 않는다
+}
+
+
+testCase(sampleInterval) {
+	AsyncLogger logger;
+	testAssertionFailed(logger.sampleInterval(0));
+	logger.sampleInterval(4);
+	testAssert(logger.sampleInterval() == 4);
+}
+
+
+testCase(writeAndFlush) {
+	File dir = getTestDirectory();
+	scopeExit(&removeTestDirectory);
+
+	const File path(dir, L"test.log");
+	{
+		AsyncLogger logger(path);
+		logger.writeLine("first");
+		logger.write(L"sec");
+		logger.write("ond");
+		logger.writeLine(L"");
+		logger.writeLine(String(L'x', 10));
+		logger.flush();
+
+		const string text = readAll(path);
+		testAssert(countLines(text) == 3);
+		testAssert(text.find("first\r\n") != string::npos);
+		testAssert(text.find("second\r\n") != string::npos);
+		testAssert(text.find("xxxxxxxxxx\r\n") != string::npos);
+		// 행의 앞에 시각과 스레드 ID 를 붙인다
+		const string prefix = " [" + std::to_string(static_cast<unsigned __int64>(GetCurrentThreadId())) + "] ";
+		testAssert(text.find(prefix + "first") == 23);
+		testAssert(text.find(prefix + "second") != string::npos);
+		testAssert(text[4] == '-' && text[10] == ' ' && text[13] == ':' && text[19] == '.');
+
+		logger.writeLine("last");
+	}
+	{// 소멸자는 남은 메시지를 출력한다. 기존 파일에 추가한다
+		const string text = readAll(path);
+		testAssert(countLines(text) == 4);
+		testAssert(text.find("last\r\n") != string::npos);
+
+		AsyncLogger logger(path);
+		logger.writeLine("appended");
+		logger.flush();
+		testAssert(readAll(path).find(text) == 0);
+		testAssert(countLines(readAll(path)) == 5);
+	}
+	{// 버퍼의 반을 넘는 부분은 잘라낸다
+		const File truncated(dir, L"truncated.log");
+		AsyncLogger logger(truncated, AsyncLogger::OverflowPolicy::block, 256);
+		logger.writeLine(string(1000, 'a'));
+		logger.flush();
+		const string text = readAll(truncated);
+		testAssert(text.find(string(128 - 16, 'a') + "\r\n") != string::npos);
+		testAssert(text.find(string(128 - 16 + 1, 'a')) == string::npos);
+	}
+}
+
+
+testCase(overflowPolicy) {
+	File dir = getTestDirectory();
+	scopeExit(&removeTestDirectory);
+
+	const int count = 10000;
+	{// block 은 버리지 않는다
+		const File path(dir, L"block.log");
+		AsyncLogger logger(path, AsyncLogger::OverflowPolicy::block, 256);
+		for (int i = 0; i < count; ++i) {
+			logger.writeLine("message");
+		}
+		logger.flush();
+		testAssert(logger.droppedCount() == 0);
+		testAssert(countLines(readAll(path)) == count);
+	}
+	{// drop 은 버퍼가 가득 차면 버리고 버린 수를 출력한다
+		const File path(dir, L"drop.log");
+		AsyncLogger logger(path, AsyncLogger::OverflowPolicy::drop, 256);
+		for (int i = 0; i < count; ++i) {
+			logger.writeLine("message");
+		}
+		logger.flush();
+		testAssert(0 < logger.droppedCount());
+		const string text = readAll(path);
+		testAssert(text.find(" messages dropped\r\n") != string::npos);
+		const int written = static_cast<int>(count - logger.droppedCount());
+		testAssert(countLines(text) > written);
+	}
+	{// sample 은 일정 간격으로 기다린다
+		const File path(dir, L"sample.log");
+		AsyncLogger logger(path, AsyncLogger::OverflowPolicy::sample, 256);
+		logger.sampleInterval(4);
+		for (int i = 0; i < count; ++i) {
+			logger.writeLine("message");
+		}
+		logger.flush();
+		testAssert(0 < logger.droppedCount());
+		// 넘칠 때 4번에 1번은 기다리므로 버린 수는 기다려서 쓴 수의 약 3배 이하
+		const int written = static_cast<int>(count - logger.droppedCount());
+		testAssert(countLines(readAll(path)) > written);
+		testAssert(logger.droppedCount() <= written * 3 + 3);
+	}
+}
+
+
+testCase(rotation) {
+	File dir = getTestDirectory();
+	scopeExit(&removeTestDirectory);
+
+	const File path(dir, L"test.log");
+	AsyncLogger logger(path, AsyncLogger::OverflowPolicy::block, 1024, 100, 3);
+	for (int i = 0; i < 10; ++i) {
+		logger.writeLine(String(L"message") + i);
+		logger.flush();
+	}
+	testAssert(readAll(path).find("message9") != string::npos);
+	testAssert(File(dir, L"test.log.1").exists());
+	testAssert(readAll(File(dir, L"test.log.1")).find("message") != string::npos);
+	testAssert(readAll(File(dir, L"test.log.1")).find("message9") == string::npos);
+	testAssert(File(dir, L"test.log.2").exists());
+	testAssert(!File(dir, L"test.log.3").exists());
+	testAssert(path.info().length() <= 100);
+}
+
+
+testCase(threads) {
+	File dir = getTestDirectory();
+	scopeExit(&removeTestDirectory);
+
+	const File path(dir, L"test.log");
+	const int threadCount = 4;
+	const int count = 1000;
+	{
+		AsyncLogger logger(path, AsyncLogger::OverflowPolicy::block, 1024);
+		vector<thread> threads;
+		for (int i = 0; i < threadCount; ++i) {
+			threads.push_back(thread([&, i] () {
+				for (int j = 0; j < count; ++j) {
+					logger.writeLine("thread" + std::to_string(static_cast<__int64>(i)) + ":" + std::to_string(static_cast<__int64>(j)));
+				}
+			}));
+		}
+		for (auto i = threads.begin(), end = threads.end(); i != end; ++i) {
+			i->join();
+		}
+		logger.flush();
+		testAssert(logger.droppedCount() == 0);
+	}
+	const string text = readAll(path);
+	testAssert(countLines(text) == threadCount * count);
+	for (int i = 0; i < threadCount; ++i) { // 스레드마다 쓴 순서대로 출력한다
+		string::size_type position = 0;
+		for (int j = 0; j < count; ++j) {
+			position = text.find("thread" + std::to_string(static_cast<__int64>(i)) + ":" + std::to_string(static_cast<__int64>(j)) + "\r\n", position);
+			testAssert(position != string::npos);
+		}
+	}
+}
+
+
+testCase(debugAsyncLogger) {
+	File dir = getTestDirectory();
+	scopeExit(&removeTestDirectory);
+
+	testAssert(!Debug::asyncLogger());
+	const File path(dir, L"test.log");
+	{
+		AsyncLogger logger(path);
+		Debug::asyncLogger(&logger);
+		testAssert(Debug::asyncLogger() == &logger);
+		Debug::write(L"balor::test::");
+		Debug::writeLine("AsyncLogger");
+		logger.flush();
+		testAssert(readAll(path).find("balor::test::AsyncLogger\r\n") != string::npos);
+		Debug::asyncLogger(nullptr);
+		testAssert(!Debug::asyncLogger());
+
+		// 소멸자는 설정을 되돌린다
+		Debug::asyncLogger(&logger);
+	}
+	testAssert(!Debug::asyncLogger());
+}
+
+
+testCase(writeFromListener) {
+	File dir = getTestDirectory();
+	scopeExit(&removeTestDirectory);
+
+	// onWrite 의 리스너는 logger 의 스레드에서 불린다. 리스너가 링이 넘칠 만큼 써도 교착 상태가 되지 않는다
+	const File path(dir, L"test.log");
+	const Listener<ByteStringRange> saved = Debug::onWrite();
+	scopeExit([&] () {
+		Debug::onWrite() = saved;
+	});
+	{
+		AsyncLogger logger(path, AsyncLogger::OverflowPolicy::block, 64);
+		Debug::asyncLogger(&logger);
+		Debug::onWrite() = [&] (ByteStringRange message) {
+			if (string(message.c_str(), message.length()) == "trigger") {
+				for (int i = 0; i < 100; ++i) {
+					Debug::writeLine("from listener");
+				}
+			}
+		};
+		Debug::writeLine("trigger");
+		logger.flush();
+		logger.flush(); // 리스너가 쓴 메시지는 다음 출력에 포함된다
+		testAssert(logger.droppedCount() == 0);
+		Debug::asyncLogger(nullptr);
+	}
+	const string text = readAll(path);
+	testAssert(text.find("trigger\r\n") != string::npos);
+	string::size_type position = 0;
+	int count = 0;
+	while ((position = text.find("from listener\r\n", position)) != string::npos) {
+		++position;
+		++count;
+	}
+	testAssert(count == 100);
+}
+
+
+testCase(replaceWhileWriting) {
+	File dir = getTestDirectory();
+	scopeExit(&removeTestDirectory);
+
+	// 다른 스레드가 쓰는 도중에 설정을 바꾸고 이전 logger 를 파기해도 파기된 logger 에 쓰지 않는다
+	const File path(dir, L"test.log");
+	const Listener<ByteStringRange> saved = Debug::onWrite();
+	scopeExit([&] () {
+		Debug::onWrite() = saved;
+	});
+	Debug::onWrite() = [] (ByteStringRange ) {}; // logger 가 없는 사이에 쓴 메시지는 테스트 로그에 남기지 않는다
+	std::atomic<bool> stop(false);
+	vector<thread> threads;
+	for (int i = 0; i < 4; ++i) {
+		threads.push_back(thread([&] () {
+			while (!stop.load()) {
+				Debug::writeLine("message");
+			}
+		}));
+	}
+	scopeExit([&] () {
+		stop.store(true);
+		for (auto i = threads.begin(), end = threads.end(); i != end; ++i) {
+			i->join();
+		}
+	});
+	for (int i = 0; i < 100; ++i) {
+		AsyncLogger logger(path, AsyncLogger::OverflowPolicy::block, 256);
+		Debug::asyncLogger(&logger);
+		testAssert(Debug::asyncLogger() == &logger);
+	}
+	testAssert(!Debug::asyncLogger());
+}
+
+
+// 뮤텍스로 보호한 파일에 쓰는 경우와 비교한 메시지당 시간. 사이즈는 동시에 쓰는 스레드 수
+BALOR_BENCHMARK_SIZES(benchmarkAsyncLoggerMutexFile, 1, 4) {
+	File dir = getTestDirectory();
+	scopeExit(&removeTestDirectory);
+	FileStream stream(File(dir, L"sync.log"), FileStream::Mode::createAlways, FileStream::Access::write);
+	mutex streamMutex;
+	runContended(benchmark, [&] () {
+		mutex::scoped_lock lock(streamMutex);
+		stream.write(benchmarkMessage, 0, benchmarkMessageLength);
+		stream.write("\r\n", 0, 2);
+	});
+}
+
+
+BALOR_BENCHMARK_SIZES(benchmarkAsyncLoggerDrop, 1, 4) {
+	File dir = getTestDirectory();
+	scopeExit(&removeTestDirectory);
+	AsyncLogger logger(File(dir, L"drop.log"), AsyncLogger::OverflowPolicy::drop, 1024 * 1024);
+	runContended(benchmark, [&] () {
+		logger.writeLine(ByteStringRange(benchmarkMessage, benchmarkMessageLength));
+	});
+}
+
+
+BALOR_BENCHMARK_SIZES(benchmarkAsyncLoggerBlock, 1, 4) {
+	File dir = getTestDirectory();
+	scopeExit(&removeTestDirectory);
+	AsyncLogger logger(File(dir, L"block.log"), AsyncLogger::OverflowPolicy::block, 1024 * 1024);
+	runContended(benchmark, [&] () {
+		logger.writeLine(ByteStringRange(benchmarkMessage, benchmarkMessageLength));
+	});
+}
+
+
+
+		}
+	}
+}
@@ -0,0 +1,253 @@
+﻿#include <balor/test/Benchmark.hpp>
+
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <balor/io/MemoryStream.hpp>
+#include <balor/system/windows.hpp>
+#include <balor/test/UnitTest.hpp>
+
+
+namespace balor {
+	namespace test {
+		namespace testBenchmark {
+
+
+using std::string;
+using std::vector;
+using namespace balor::io;
+
+
+namespace {
+int setupCount = 0;
+__int64 loopCount = 0;
+vector<int> measuredSizes;
+int slowCallCount = 0;
+
+
+Benchmark::Result makeResult(const char* name, int size, double median) {
+	Benchmark::Result result;
+	result.name = name;
+	result.size = size;
+	result.median = median;
+	return result;
+}
+} // namespace
+
+
+// 이 파일의 벤치마크는 아래의 테스트 케이스에서 실행한다
+BALOR_BENCHMARK(benchmarkHarnessLoop) {
+	++setupCount; // 계측에 포함되지 않는다
+	while (benchmark.running()) {
+		++loopCount;
+	}
+	testAssert(!benchmark.running());
+	testAssert(benchmark.size() == -1);
+}
+
+
+BALOR_BENCHMARK_SIZES(benchmarkHarnessSizes, 1, 8, 64) {
+	measuredSizes.push_back(benchmark.size());
+	vector<char> buffer(benchmark.size());
+	while (benchmark.running()) {
+		Benchmark::doNotOptimize(buffer[benchmark.size() - 1]);
+	}
+}
+
+
+BALOR_BENCHMARK(benchmarkHarnessAllocation) {
+	Benchmark::countAllocation(1000); // 계측 밖에서는 세지 않는다
+	while (benchmark.running()) {
+		Benchmark::countAllocation(16);
+	}
+	Benchmark::countAllocation(1000);
+}
+
+
+BALOR_BENCHMARK(benchmarkHarnessOutlier) {
+	bool slow = ++slowCallCount % 8 == 0;
+	while (benchmark.running()) {
+		if (slow) { // 가끔 끼어든 처리처럼 한 번만 느려진다
+			Sleep(10);
+			slow = false;
+		}
+	}
+}
+
+
+
+testCase(run) {
+	// 무효한 파라미터
+	testAssertionFailed(Benchmark::run("^benchmarkHarnessLoop$", 0));
+	testAssertionFailed(Benchmark::run("^benchmarkHarnessLoop$", 5, 0));
+	testAssertionFailed(Benchmark::run("^benchmarkHarnessLoop$", 5, 0.001, -1));
+
+	{// 일치하는 벤치마크가 없다
+		vector<Benchmark::Result> results = Benchmark::run("^noSuchBenchmark$");
+		testAssert(results.empty());
+	}
+	{// 반복 횟수를 조정하여 계측한다
+		setupCount = 0;
+		loopCount = 0;
+		vector<Benchmark::Result> results = Benchmark::run("^benchmarkHarnessLoop$", 5, 0.0001, 0);
+		testAssert(results.size() == 1);
+		const Benchmark::Result& result = results[0];
+		testAssert(result.name == "benchmarkHarnessLoop");
+		testAssert(result.size == -1);
+		testAssert(1 < result.iterationCount);
+		testAssert(result.sampleCount == 5);
+		testAssert(0 <= result.rejectedCount && result.rejectedCount < 5);
+		testAssert(result.min <= result.median && result.median <= result.max);
+		testAssert(result.min <= result.mean && result.mean <= result.max);
+		testAssert(result.p99 == result.max);
+		testAssert(0 <= result.standardDeviation);
+		testAssert(result.allocationCount == 0);
+		testAssert(5 < setupCount); // 조정하는 동안에도 호출된다
+		testAssert(result.iterationCount * 5 < loopCount);
+	}
+}
+
+
+testCase(sizes) {
+	measuredSizes.clear();
+	vector<Benchmark::Result> results = Benchmark::run("^benchmarkHarnessSizes$", 3, 0.0001, 0);
+	testAssert(results.size() == 3);
+	testAssert(results[0].size == 1);
+	testAssert(results[1].size == 8);
+	testAssert(results[2].size == 64);
+	for (int i = 0; i < 3; ++i) {
+		testAssert(results[i].name == "benchmarkHarnessSizes");
+		testAssert(results[i].sampleCount == 3);
+	}
+	testAssert(measuredSizes.front() == 1);
+	testAssert(measuredSizes.back() == 64);
+}
+
+
+testCase(countAllocation) {
+	// 계측하지 않을 때는 세지 않는다
+	testNoThrow(Benchmark::countAllocation(16));
+
+	vector<Benchmark::Result> results = Benchmark::run("^benchmarkHarnessAllocation$", 5, 0.0001, 0);
+	testAssert(results.size() == 1);
+	testAssert(results[0].allocationCount == 1);
+	testAssert(results[0].allocationBytes == 16);
+}
+
+
+testCase(outlier) {
+	slowCallCount = 0;
+	vector<Benchmark::Result> results = Benchmark::run("^benchmarkHarnessOutlier$", 24, 0.001, 0);
+	testAssert(results.size() == 1);
+	const Benchmark::Result& result = results[0];
+	testAssert(1 <= result.rejectedCount);
+	testAssert(result.mean * 2 < result.max); // 느린 샘플은 평균에 포함하지 않는다
+	testAssert(result.median * 2 < result.max);
+}
+
+
+testCase(writeJsonAndReadJson) {
+	vector<Benchmark::Result> results;
+	results.push_back(makeResult("first", -1, 12.5));
+	results.push_back(makeResult("second \"quoted\"", 256, 1000.25));
+	results[1].iterationCount = 12345;
+	results[1].sampleCount = 50;
+	results[1].rejectedCount = 2;
+	results[1].mean = 1001.5;
+	results[1].p99 = 1100;
+	results[1].min = 990;
+	results[1].max = 1200;
+	results[1].standardDeviation = 3.25;
+	results[1].allocationCount = 1;
+	results[1].allocationBytes = 512;
+
+	MemoryStream stream;
+	Benchmark::writeJson(stream, results);
+	const string text(static_cast<const char*>(stream.buffer()), static_cast<int>(stream.length()));
+	testAssert(text.find("{\"benchmarks\":[") == 0);
+	testAssert(text.find("\"name\":\"second \\\"quoted\\\"\",\"size\":256,\"iterations\":12345,") != string::npos);
+
+	stream.position(0);
+	vector<Benchmark::Result> read = Benchmark::readJson(stream);
+	testAssert(read.size() == 2);
+	testAssert(read[0].name == "first");
+	testAssert(read[0].size == -1);
+	testAssert(read[0].median == 12.5);
+	testAssert(read[1].name == "second \"quoted\"");
+	testAssert(read[1].size == 256);
+	testAssert(read[1].iterationCount == 12345);
+	testAssert(read[1].sampleCount == 50);
+	testAssert(read[1].rejectedCount == 2);
+	testAssert(read[1].mean == 1001.5);
+	testAssert(read[1].median == 1000.25);
+	testAssert(read[1].p99 == 1100);
+	testAssert(read[1].min == 990);
+	testAssert(read[1].max == 1200);
+	testAssert(read[1].standardDeviation == 3.25);
+	testAssert(read[1].allocationCount == 1);
+	testAssert(read[1].allocationBytes == 512);
+
+	{// 모르는 키는 무시한다
+		const char json[] = "{\"version\":[1,{\"a\":null}],\"benchmarks\":[{\"name\":\"x\",\"unit\":\"ns\",\"median\":3,\"flag\":true}]}";
+		MemoryStream other(const_cast<char*>(json), 0, sizeof(json) - 1, false);
+		vector<Benchmark::Result> read = Benchmark::readJson(other);
+		testAssert(read.size() == 1);
+		testAssert(read[0].name == "x");
+		testAssert(read[0].median == 3);
+	}
+	{// 빈 결과
+		MemoryStream empty;
+		Benchmark::writeJson(empty, vector<Benchmark::Result>());
+		empty.position(0);
+		testAssert(Benchmark::readJson(empty).empty());
+	}
+	{// 형식이 잘못되었다
+		const char* const invalids[] = {"", "[]", "{\"benchmarks\":[{\"name\":\"x\"}", "{\"benchmarks\":[{\"median\":abc}]}", "{} {}"};
+		for (int i = 0; i < 5; ++i) {
+			MemoryStream invalid(const_cast<char*>(invalids[i]), 0, static_cast<int>(std::strlen(invalids[i])), false);
+			testThrow(Benchmark::readJson(invalid), Benchmark::FormatException);
+		}
+	}
+}
+
+
+testCase(compare) {
+	vector<Benchmark::Result> baseline;
+	baseline.push_back(makeResult("a", -1, 100));
+	baseline.push_back(makeResult("b", 16, 100));
+	baseline.push_back(makeResult("b", 256, 100));
+	baseline.push_back(makeResult("removed", -1, 100));
+	vector<Benchmark::Result> current;
+	current.push_back(makeResult("a", -1, 105));
+	current.push_back(makeResult("b", 16, 115));
+	current.push_back(makeResult("b", 256, 50));
+	current.push_back(makeResult("added", -1, 100));
+
+	// 무효한 파라미터
+	testAssertionFailed(Benchmark::compare(baseline, current, -0.1));
+
+	vector<Benchmark::Comparison> comparisons = Benchmark::compare(baseline, current, 0.1);
+	testAssert(comparisons.size() == 3); // 한쪽에만 있는 결과는 비교하지 않는다
+	testAssert(comparisons[0].name == "a");
+	testAssert(comparisons[0].baseline == 100);
+	testAssert(comparisons[0].current == 105);
+	testAssert(comparisons[0].ratio == 1.05);
+	testAssert(!comparisons[0].regressed);
+	testAssert(comparisons[1].name == "b");
+	testAssert(comparisons[1].size == 16);
+	testAssert(comparisons[1].regressed);
+	testAssert(comparisons[2].size == 256);
+	testAssert(comparisons[2].ratio == 0.5);
+	testAssert(!comparisons[2].regressed);
+
+	// 기준을 엄격하게
+	comparisons = Benchmark::compare(baseline, current, 0.01);
+	testAssert(comparisons[0].regressed);
+}
+
+
+
+		}
+	}
+}
@@ -0,0 +1,164 @@
+﻿#include <balor/test/StackTrace.hpp>
+
+#include <vector>
+#define BOOST_DATE_TIME_NO_LIB
+#define BOOST_THREAD_NO_LIB
+#include <boost/thread.hpp>
+
+#include <balor/system/windows.hpp>
+#include <balor/test/Benchmark.hpp>
+#include <balor/test/Debug.hpp>
+#include <balor/test/UnitTest.hpp>
+#include <balor/String.hpp>
+#include <balor/StringBuffer.hpp>
+
+
+namespace balor {
+	namespace test {
+		namespace testStackTrace {
+
+
+using std::vector;
+using boost::thread;
+
+
+namespace {
+volatile int captureCount = 0;
+volatile int repeatCount = 2; // 루프를 펼쳐서 호출 위치가 달라지지 않도록 한다
+
+
+__declspec(noinline) StackTrace captureInFunction(int skipCount) {
+	StackTrace result = StackTrace::capture(skipCount);
+	++captureCount; // 꼬리 호출 최적화로 이 함수의 프레임이 사라지지 않도록 한다
+	return result;
+}
+
+
+__declspec(noinline) StackTrace captureInDepth(int depth, int skipCount) {
+	StackTrace result = 0 < depth ? captureInDepth(depth - 1, skipCount) : StackTrace::capture(skipCount);
+	++captureCount;
+	return result;
+}
+} // namespace
+
+
+
+testCase(construct) {
+	StackTrace trace;
+	testAssert(trace.frameCount() == 0);
+	testAssert(trace.toString().empty());
+	testAssertionFailed(trace[0]);
+	testAssert(trace == StackTrace());
+}
+
+
+testCase(capture) {
+	// 무효한 파라미터
+	testAssertionFailed(StackTrace::capture(-1));
+
+	StackTrace trace = StackTrace::capture();
+	testAssert(0 < trace.frameCount());
+	testAssert(trace.frameCount() <= StackTrace::maxFrameCount);
+	testAssertionFailed(trace[-1]);
+	testAssertionFailed(trace[trace.frameCount()]);
+
+	{// 호출한 함수가 첫 번째 프레임이 된다
+		StackTrace inner = captureInFunction(0);
+		testAssert(inner.frameCount() == trace.frameCount() + 1);
+		testAssert(StackTrace::symbolize(inner[0]).contains(L"captureInFunction"));
+		StackTrace skipped = captureInFunction(1);
+		testAssert(skipped.frameCount() == trace.frameCount());
+		testAssert(skipped[0] != inner[0]);
+		testAssert(skipped[1] == inner[2]);
+	}
+	{// 깊은 스택은 maxFrameCount 까지, skipCount 를 지정하면 그만큼 적게 기록한다
+		testAssert(captureInDepth(100, 0).frameCount() == StackTrace::maxFrameCount);
+		testAssert(captureInDepth(100, 5).frameCount() == StackTrace::maxFrameCount - 5);
+	}
+	{// 같은 위치에서 기록하면 같은 스택
+		vector<StackTrace> traces;
+		for (int i = 0; i < repeatCount; ++i) {
+			traces.push_back(captureInFunction(0));
+		}
+		testAssert(traces[0] == traces[1]);
+		testAssert(traces[0].hash() == traces[1].hash());
+		testAssert(traces[0] != captureInFunction(0));
+		testAssert(traces[0] != trace);
+	}
+	{// 너무 많이 건너뛰면 빈 스택
+		StackTrace empty = StackTrace::capture(1000);
+		testAssert(empty.frameCount() == 0);
+	}
+}
+
+
+testCase(symbolize) {
+	StackTrace trace = StackTrace::capture();
+	String name = StackTrace::symbolize(trace[0]);
+	testAssert(name.startsWith(L"testBalor!balor::test::testStackTrace::symbolize"));
+	testAssert(name.contains(L"StackTrace.cpp("));
+
+	// 두 번째부터는 캐시를 참조한다
+	String cached = StackTrace::symbolize(trace[0]);
+	testAssert(cached == name);
+	testAssert(cached.c_str() == name.c_str());
+
+	// 심볼이 없는 주소
+	testAssert(StackTrace::symbolize(reinterpret_cast<void*>(16)).contains(L"<nosymbols>"));
+
+	{// 여러 스레드에서 동시에 변환한다
+		vector<String> results(8);
+		vector<thread> threads;
+		for (int i = 0; i < 8; ++i) {
+			threads.push_back(thread([&, i] () {
+				results[i] = StackTrace::symbolize(trace[1]);
+			}));
+		}
+		for (auto i = threads.begin(), end = threads.end(); i != end; ++i) {
+			i->join();
+		}
+		for (int i = 1; i < 8; ++i) {
+			testAssert(results[i].c_str() == results[0].c_str());
+		}
+	}
+}
+
+
+testCase(toStringAndToStringToBuffer) {
+	StackTrace trace = StackTrace::capture();
+	String string = trace.toString();
+	testAssert(string.startsWith(L"testBalor!balor::test::testStackTrace::toStringAndToStringToBuffer"));
+	testAssert(string.contains(L"testBalor!balor::test::UnitTest::run"));
+	int lineCount = 0;
+	for (int i = 0, end = string.length(); i < end; ++i) {
+		if (string[i] == L'\n') {
+			++lineCount;
+		}
+	}
+	testAssert(lineCount == trace.frameCount());
+
+	StringBuffer buffer;
+	buffer += L"abc";
+	trace.toStringToBuffer(buffer);
+	testAssert(String::equals(buffer, String(L"abc") + string));
+}
+
+
+BALOR_BENCHMARK(benchmarkStackTraceCapture) { // 기록만 하는 경우
+	while (benchmark.running()) {
+		Benchmark::doNotOptimize(StackTrace::capture().hash());
+	}
+}
+
+
+BALOR_BENCHMARK(benchmarkDebugStackTrace) { // 매번 문자열로 변환하는 Debug::stackTrace (심볼은 캐시된다)
+	while (benchmark.running()) {
+		Benchmark::doNotOptimize(Debug::stackTrace());
+	}
+}
+
+
+
+		}
+	}
+}
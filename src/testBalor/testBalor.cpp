@@ -1,10 +1,15 @@
 ﻿#include <functional>
+#include <string>
+#include <vector>
 
 #include <balor/gui/MessageBox.hpp>
 #include <balor/io/File.hpp>
 #include <balor/io/FileStream.hpp>
+#include <balor/locale/Charset.hpp>
 #include <balor/system/Console.hpp>
 #include <balor/system/Module.hpp>
+#include <balor/system/System.hpp>
+#include <balor/test/Benchmark.hpp>
 #include <balor/test/Debug.hpp>
 #include <balor/test/UnhandledException.hpp>
 #include <balor/test/UnitTest.hpp>
@@ -14,7 +19,10 @@
 #include <windows.h>
 
 
+using std::string;
+using std::vector;
 using namespace balor::io;
+using namespace balor::locale;
 using namespace balor::system;
 using namespace balor::test;
 using namespace balor;
@@ -34,6 +42,59 @@ int debugReportHook(int /*reportType*/, char* message, int* /*returnValue*/) {
 }
 
 
+// testBalor.exe /benchmark [패턴] [/baseline] 으로 실행하면 단위 테스트 대신 이름이나 파일명이 패턴에 일치하는 벤치마크를 실행한다.
+// 결과는 benchmarkResults.json 에 쓰고, benchmarkBaseline.json 이 있으면 중앙값을 비교하여 10% 넘게 느려진 벤치마크를 보고한다.
+// /baseline 을 붙이면 결과를 benchmarkBaseline.json 에 기준으로 기록한다. 기준은 같은 컴퓨터에서 기록한 것이어야 비교할 의미가 있다.
+bool runBenchmarks() {
+	if (System::commandLineArgCount() < 2 || !String::equals(System::getCommandLineArg(1), L"/benchmark", true)) {
+		return false;
+	}
+	string pattern;
+	bool recordBaseline = false;
+	for (int i = 2, end = System::commandLineArgCount(); i < end; ++i) {
+		const String arg = System::getCommandLineArg(i);
+		if (String::equals(arg, L"/baseline", true)) {
+			recordBaseline = true;
+		} else {
+			pattern = Charset::default().encode(arg);
+		}
+	}
+
+	const vector<Benchmark::Result> results = Benchmark::run(pattern.c_str());
+	{
+		auto stream = File(Module::current().directory(), L"benchmarkResults.json").create();
+		Benchmark::writeJson(stream, results);
+	}
+	File baselineFile(Module::current().directory(), L"benchmarkBaseline.json");
+	if (recordBaseline) {
+		auto stream = baselineFile.create();
+		Benchmark::writeJson(stream, results);
+		Debug::writeLine(L"benchmarkBaseline.json 에 기준을 기록했다");
+		return true;
+	}
+	if (!baselineFile.exists()) {
+		Debug::writeLine(L"benchmarkBaseline.json 이 없으므로 비교하지 않는다");
+		return true;
+	}
+	vector<Benchmark::Result> baseline;
+	{
+		auto stream = baselineFile.openRead();
+		baseline = Benchmark::readJson(stream);
+	}
+	const vector<Benchmark::Comparison> comparisons = Benchmark::compare(baseline, results);
+	int regressedCount = 0;
+	for (auto i = comparisons.begin(), end = comparisons.end(); i != end; ++i) {
+		if (i->regressed) {
+			++regressedCount;
+			Debug::writeLine(String() + L"regressed: " + Charset::default().decode(i->name) + (0 <= i->size ? String() + L"/" + i->size : String())
+				+ L" " + static_cast<int>(i->baseline) + L" ns -> " + static_cast<int>(i->current) + L" ns (" + static_cast<int>(i->ratio * 100) + L"%)");
+		}
+	}
+	Debug::writeLine(String() + L"benchmark: " + static_cast<int>(comparisons.size()) + L" compared, " + regressedCount + L" regressed");
+	return true;
+}
+
+
 int APIENTRY _tWinMain(HINSTANCE //instance
 					  ,HINSTANCE //prevInstance
 					  ,LPTSTR    //commandLine
@@ -53,8 +114,10 @@ int APIENTRY _tWinMain(HINSTANCE //instance
 			Console::write(message);
 		};
 
-		UnitTest::run();
-		//UnitTest::run("listener");
+		if (!runBenchmarks()) {
+			UnitTest::run();
+			//UnitTest::run("listener");
+		}
 	} catch (UnhandledException& ) {
 	}
 
@@ -0,0 +1,41 @@
+﻿#pragma once
+
+#include <atomic>
+#include <vector>
+#define BOOST_DATE_TIME_NO_LIB
+#define BOOST_THREAD_NO_LIB
+#include <boost/thread.hpp>
+
+#include <balor/test/Benchmark.hpp>
+
+
+namespace tools {
+
+
+
+/// benchmark.size() - 1 개의 스레드가 function 을 계속 호출하는 동안 계측 루프에서 function 을 호출한다. 사이즈는 동시에 호출하는 스레드 수
+template<typename Function> void runContended(::balor::test::Benchmark& benchmark, Function function) {
+	std::atomic<bool> stopping(false);
+	boost::barrier started(benchmark.size());
+	std::vector<boost::thread> threads;
+	for (int i = 1; i < benchmark.size(); ++i) {
+		threads.push_back(boost::thread([&] () {
+			started.wait();
+			while (!stopping.load(std::memory_order_relaxed)) {
+				function();
+			}
+		}));
+	}
+	started.wait();
+	while (benchmark.running()) {
+		function();
+	}
+	stopping.store(true);
+	for (auto i = threads.begin(), end = threads.end(); i != end; ++i) {
+		i->join();
+	}
+}
+
+
+
+}